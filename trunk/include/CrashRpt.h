@@ -481,6 +481,7 @@ CRASHRPTAPI(int)
 #define CR_INST_SHOW_ADDITIONAL_INFO_FIELDS	 0x200000 //!< Makes "Your E-mail" and "Describe what you were doing when the problem occurred" fields of Error Report dialog always visible.
 #define CR_INST_ALLOW_ATTACH_MORE_FILES		 0x400000 //!< Adds an ability for user to attach more files to crash report by clicking "Attach More File(s)" item from context menu of Error Report Details dialog.
 #define CR_INST_AUTO_THREAD_HANDLERS         0x800000 //!< If this flag is set, installs exception handlers for newly created threads automatically.
+#define CR_INST_SHA256_DIGEST               0x1000000 //!< Calculate SHA-256 hash of the error report archive in addition to MD5 hash.
 
 /*! \ingroup CrashRptStructs
 *  \struct CR_INSTALL_INFOW()
@@ -622,6 +623,11 @@ CRASHRPTAPI(int)
 *        <td> <b>Available since v.1.4.2</b> Specifying this flag results in automatic installation of all available exception handlers to
 *             all threads that will be created in the future. This flag only works if CrashRpt is compiled as a DLL, it does 
 *             not work if you compile CrashRpt as static library.
+*
+*    <tr><td> \ref CR_INST_SHA256_DIGEST     
+*        <td> <b>Available since v.1.4.3</b> Specifying this flag makes CrashRpt calculate the SHA-256 hash of the ZIP archive
+*             in addition to the MD5 hash. The hash is calculated while the archive is written, saved to the <i>.sha256</i> file 
+*             next to the archive and sent in the 'sha256' parameter of HTTP request. By default only the MD5 hash is calculated.
 *   </table>
 *
 *   \b pszPrivacyPolicyURL [in, optional] 
@@ -972,6 +978,7 @@ CRASHRPTAPI(int)
 #define CR_AF_FILE_MUST_EXIST     0 //!< Function will fail if file doesn't exist at the moment of function call.
 #define CR_AF_MISSING_FILE_OK     2 //!< Do not fail if file is missing (assume it will be created later).
 #define CR_AF_ALLOW_DELETE        4 //!< If this flag is specified, the file will be deletable from context menu of Error Report Details dialog.
+#define CR_AF_SNAPSHOT            8 //!< Take a snapshot of an append-only file (a log) instead of copying it.
 
 /*! \ingroup CrashRptAPI  
 *  \brief Adds a file to crash report.
@@ -1012,12 +1019,20 @@ CRASHRPTAPI(int)
 *
 *       - \ref CR_AF_ALLOW_DELETE        If this flag is specified, the user will be able to delete the file from error report using context menu of Error Report Details dialog.
 *
+*       - \ref CR_AF_SNAPSHOT            On crash, the \b CrashSender.exe process will record the size of the file
+*                                       and include only that much of it into the report, without copying the data.
+*                                       The file is hard-linked into the error report folder when possible.
+*                                       Use this flag for large logs the application only appends to; if the file
+*                                       may be truncated or rewritten, use \ref CR_AF_MAKE_FILE_COPY instead.
+*                                       This flag takes precedence over \ref CR_AF_MAKE_FILE_COPY.
+*
 *    If you do not use error report delivery (\ref CR_INST_DONT_SEND_REPORT flag) or if you use postponed error report delivery 
 *    (if you specify \ref CR_INST_SEND_QUEUED_REPORTS flag) 
 *    you must also specify the \ref CR_AF_MAKE_FILE_COPY as \a dwFlags parameter value. This will
 *    guarantee that a snapshot of your file at the moment of crash is taken and saved to the error report folder.
 *    The error report folder is a folder where files included into the crash report are stored
-*    until they are sent to recipient.
+*    until they are sent to recipient. A \ref CR_AF_SNAPSHOT snapshot is kept in the error report
+*    folder only if the file could be hard-linked (the folder is on the same volume as the file).
 *
 *    This function fails if \a pszFile doesn't exist at the moment of function call, 
 *    unless you specify \ref CR_AF_MISSING_FILE_OK flag. 
@@ -1051,6 +1066,11 @@ CRASHRPTAPI(int)
 *  crAddFile2(_T("C:\\Program Files (x86)\MyApp\\*.txt"), 
 *      NULL, _T("TXT file"), CR_AF_MAKE_FILE_COPY);
 *
+*  // Add large trace logs. At the moment of crash, their sizes are 
+*  // recorded; data written after the crash are not included.
+*  crAddFile2(_T("C:\\Program Files (x86)\MyApp\\trace*.log"), 
+*      NULL, _T("Trace log"), CR_AF_SNAPSHOT);
+*
 *  \endcode
 *
 *  \sa crAddFile2W(), crAddFile2A(), crAddFile2()
@@ -1216,6 +1236,8 @@ CRASHRPTAPI(int)
 #define CR_AV_QUALITY_BEST    8  //!< The best encoding quality, the largest file size.
 #define CR_AV_NO_GUI         16  //!< Do not display the notification dialog.
 #define CR_AV_ALLOW_DELETE   32  //!< If this flag is specified, the file will be deletable from context menu of Error Report Details dialog.
+#define CR_AV_NO_COMPRESSION 64  //!< Do not compress recorded frames in memory (uses more memory, but less CPU time while recording).
+#define CR_AV_CODEC_VP8     128  //!< Encode the video with VP8 codec to a WebM file instead of OGG Theora.
 
 /*! \ingroup CrashRptAPI  
 *  \brief Allows to record what happened before crash to a video file and include the file to crash report.
@@ -1246,6 +1268,11 @@ CRASHRPTAPI(int)
 *
 *   - use the \ref CR_AV_ALLOW_DELETE to allow the user to delete the recorded video file from error report using context menu of Error Report Details dialog.
 *
+*   - use the \ref CR_AV_NO_COMPRESSION to keep recorded frames uncompressed in memory.
+*
+*   - use the \ref CR_AV_CODEC_VP8 to encode the video with VP8 codec (.webm file). By default,
+*     the video is encoded with OGG Theora codec (.ogg file).
+*
 *  The main application window is a window that has a caption (\b WS_CAPTION), system menu (\b WS_SYSMENU) and
 *  the \b WS_EX_APPWINDOW extended style. If CrashRpt doesn't find such a window, it considers the first found process window as
 *  the main window.
@@ -1259,6 +1286,12 @@ CRASHRPTAPI(int)
 *  milliseconds interval between subsequent video frames. If \b nDuration and\or \b nFrameInterval
 *  are set to zero (0), the default implementation-defined duration and frame interval are used.
 *
+*  Frames are kept in memory until the video is encoded, no temporary files are written while
+*  recording. Each frame is losslessly compressed unless \ref CR_AV_NO_COMPRESSION is specified.
+*  If the frames take more than 256 MB of memory, the oldest ones are dropped and the video is shorter.
+*  When the crash report is sent, frames are composed and color-converted by a thread per processor
+*  while the encoder compresses the frames already prepared.
+*
 *  The \b pDesiredFrameSize parameter allows to define the desired video frame size.
 *  Frame width and height must be a multiple of 16 (OGG Theora video codec's requirement). 
 *  If they are not, they are modified automatically to be a multiple of 16.
@@ -1354,6 +1387,11 @@ CRASHRPTAPI(int)
 *  User-added properties are listed under \<CustomProps\> tag of the XML file.
 *  In the XML file properties are ordered by names in alphabetic order.
 *
+*  Adding a property with the same name again replaces its value. Properties, files and
+*  registry keys added to the report share memory of limited size; if there is not 
+*  enough memory for the value, this function fails and only the beginning of the value
+*  may be included.
+*
 *  The following example shows how to add information about the amount of free disk space 
 *  to the crash description XML file:
 *
@@ -1394,6 +1432,63 @@ CRASHRPTAPI(int)
 #define crAddProperty crAddPropertyA
 #endif //UNICODE
 
+/*! \ingroup CrashRptAPI  
+*  \brief Records a breadcrumb (a short note about recent application activity) to be included into the crash report. 
+* 
+*  \return This function returns zero if succeeded. Use crGetLastErrorMsg() to retrieve the error message on fail.
+*
+*  \param[in] pszCategory   Category of the breadcrumb (for example, "net" or "ui"), optional.
+*  \param[in] pszMessage    Message, required.
+*  
+*  \remarks 
+*
+*  Use this function to record what the application was doing shortly before a crash.
+*  Breadcrumbs are listed under \<Breadcrumbs\> tag of the crash description XML file, 
+*  ordered by time. 
+*
+*  Each thread has its own ring of the most recent breadcrumbs (128 records) in memory
+*  shared with CrashSender.exe, so nothing is copied at crash time. Recording takes no
+*  lock and costs tens of nanoseconds, so it may be called from frequently executed code. 
+*  Up to 64 threads may record breadcrumbs at the same time; a thread frees its ring when 
+*  it calls crUninstallFromCurrentThread() or exits (if CrashRpt is used as a DLL). The 
+*  category and the message share 232 bytes: the category is truncated to 64 bytes, the 
+*  message gets the rest (at least 84 wide characters or 168 multi-byte characters).
+*
+*  On success, this function doesn't update the last error message.
+*
+*  \code
+*  crAddBreadcrumb(_T("net"), _T("Connecting to update server"));
+*  \endcode
+*
+*  \sa
+*   crAddProperty(), crAddFile2()
+*/
+
+CRASHRPTAPI(int)
+  crAddBreadcrumbW(
+  LPCWSTR pszCategory,
+  LPCWSTR pszMessage
+  );
+
+/*! \ingroup CrashRptAPI
+*  \copydoc crAddBreadcrumbW()
+*/
+
+CRASHRPTAPI(int)
+  crAddBreadcrumbA(
+  LPCSTR pszCategory,
+  LPCSTR pszMessage
+  );
+
+/*! \brief Character set-independent mapping of crAddBreadcrumbW() and crAddBreadcrumbA() functions. 
+*  \ingroup CrashRptAPI
+*/
+#ifdef UNICODE
+#define crAddBreadcrumb crAddBreadcrumbW
+#else
+#define crAddBreadcrumb crAddBreadcrumbA
+#endif //UNICODE
+
 // Flags that can be passed to crAddRegKey() function
 #define CR_AR_ALLOW_DELETE   0x1  //!< If this flag is specified, the file will be deletable from context menu of Error Report Details dialog.
 
@@ -50,6 +50,10 @@ typedef int CrpHandle;
 
 /*! \defgroup CrashRptProbeAPI CrashRptProbe Functions*/
 
+/* Flags of crpOpenErrorReport() function. */
+
+#define CRP_OPEN_DUMP_TO_TEMP_FILE 0x1 //!< Inflate the minidump into a temporary file whatever its size.
+
 /*! \ingroup CrashRptProbeAPI
 *  \brief Opens a zipped crash report file.
 *
@@ -58,7 +62,7 @@ typedef int CrpHandle;
 *  \param[in] pszFileName Zipped report file name.
 *  \param[in] pszMd5Hash String containing MD5 hash for the ZIP file data.
 *  \param[in] pszSymSearchPath Symbol files (PDB) search path.
-*  \param[in] dwFlags Flags, reserved for future use.
+*  \param[in] dwFlags Flags.
 *  \param[out] phReport Handle to the opened crash report.
 *
 *  \remarks
@@ -73,6 +77,8 @@ typedef int CrpHandle;
 *  \a pszMd5Hash is a string containing the MD5 hash calculated for \a pszFileName. The MD5
 *  hash is a sequence of 16 characters being used for integrity checks. 
 *  If this parameter is NULL, integrity check is not performed.
+*  Since v.1.4.3, this parameter may also contain the SHA-256 hash (a sequence of 64 hexadecimal digits)
+*  saved when the report was created with \ref CR_INST_SHA256_DIGEST flag.
 *
 *  If the error report is delivered by HTTP, the MD5 hash can be extracted by server-side script from the
 *  'md5' parameter. When the error report is delivered by email, the MD5 hash is attached to the mail message.
@@ -86,7 +92,10 @@ typedef int CrpHandle;
 *  Symbol files are required for crash report processing. They contain various information used by the debugger.
 *  For more information about saving symbol files, see \ref preparing_to_software_release.
 *
-*  \a dwFlags is currently not used, should be zero.
+*  \a dwFlags can be zero or \ref CRP_OPEN_DUMP_TO_TEMP_FILE. Minidumps up to 256 MB are inflated into
+*  memory, larger ones into a temporary file that is mapped into memory and deleted when the report is
+*  closed. The flag makes small minidumps go to a temporary file too, which saves memory when many
+*  reports are opened at once.
 *
 *  \a phReport parameter receives the handle to the opened crash report. If the function fails,
 *  this parameter becomes zero. 
@@ -97,7 +106,7 @@ typedef int CrpHandle;
 *      do not present, it assumes the report was generated by CrashRpt v1.0. In such case it searches for
 *      any file having *.dmp or *.xml extension and assumes these are valid XML and DMP file.
 *    - It extracts and loads the XML file and checks its structure.
-*    - It extracts the minidump file to the temporary location.
+*    - It extracts the minidump file into memory or to the temporary location.
 *
 *  On failure, use crpGetLastErrorMsg() function to get the last error message.
 *
@@ -118,7 +127,7 @@ crpOpenErrorReportW(
                     __in LPCWSTR pszFileName,
                     __in_opt LPCWSTR pszMd5Hash,
                     __in_opt LPCWSTR pszSymSearchPath,
-                    __reserved DWORD dwFlags,
+                    __in DWORD dwFlags,
                     __out CrpHandle* phReport
                     );
 
@@ -132,7 +141,7 @@ crpOpenErrorReportA(
                     __in LPCSTR pszFileName,
                     __in_opt LPCSTR pszMd5Hash,
                     __in_opt LPCSTR pszSymSearchPath,  
-                    __reserved DWORD dwFlags,
+                    __in DWORD dwFlags,
                     __out CrpHandle* phReport
                     );
 
@@ -172,10 +181,12 @@ crpCloseErrorReport(
 #define CRP_TBL_XMLDESC_MISC _T("XmlDescMisc")                //!< Table: Miscellaneous info contained in crash description XML file. 
 #define CRP_TBL_XMLDESC_FILE_ITEMS _T("XmlDescFileItems")     //!< Table: The list of file items contained in error report.
 #define CRP_TBL_XMLDESC_CUSTOM_PROPS _T("XmlDescCustomProps") //!< Table: The list of application-defined properties (available since v.1.2.1).
+#define CRP_TBL_XMLDESC_BREADCRUMBS _T("XmlDescBreadcrumbs") //!< Table: Recent application events added with crAddBreadcrumb(), oldest first.
 #define CRP_TBL_MDMP_MISC    _T("MdmpMisc")    //!< Table: Miscellaneous info contained in crash minidump file.  
 #define CRP_TBL_MDMP_MODULES _T("MdmpModules") //!< Table: The list of loaded modules.
 #define CRP_TBL_MDMP_THREADS _T("MdmpThreads") //!< Table: The list of threads.
 #define CRP_TBL_MDMP_LOAD_LOG _T("MdmpLoadLog") //!< Table: Minidump loading log.
+#define CRP_TBL_MDMP_BUCKET  _T("MdmpBucket")  //!< Table: Crash bucket (signature of the exception thread stack).
 
 /* Meta information */
 
@@ -214,6 +225,12 @@ crpCloseErrorReport(
 #define CRP_COL_PROPERTY_NAME   _T("PropertyName")     //!< Column: Name of the application-defined property.
 #define CRP_COL_PROPERTY_VALUE  _T("PropertyValue")    //!< Column: Value of the application-defined property.
 
+// Column IDs of the CRP_XMLDESC_BREADCRUMBS table
+#define CRP_COL_BREADCRUMB_TIME      _T("BreadcrumbTime")     //!< Column: Time (UTC) when the breadcrumb was added, YYYY-MM-DDThh:mm:ss.sssZ.
+#define CRP_COL_BREADCRUMB_THREAD_ID _T("BreadcrumbThreadID") //!< Column: ID of the thread that added the breadcrumb.
+#define CRP_COL_BREADCRUMB_CATEGORY  _T("BreadcrumbCategory") //!< Column: Breadcrumb category.
+#define CRP_COL_BREADCRUMB_MESSAGE   _T("BreadcrumbMessage")  //!< Column: Breadcrumb message.
+
 // Column IDs of the CRP_MDMP_MISC table
 #define CRP_COL_CPU_ARCHITECTURE _T("CPUArchitecture") //!< Column: Processor architecture.
 #define CRP_COL_CPU_COUNT        _T("CPUCount")        //!< Column: Number of processors.
@@ -252,6 +269,11 @@ crpCloseErrorReport(
 // Column IDs of the CRP_MDMP_LOAD_LOG table
 #define CRP_COL_LOAD_LOG_ENTRY _T("LoadLogEntry")   //!< Column: A entry of the minidump loading log.
 
+// Column IDs of the CRP_MDMP_BUCKET table
+#define CRP_COL_BUCKET_ID          _T("BucketID")         //!< Column: Crash bucket ID, 16 hexadecimal digits.
+#define CRP_COL_BUCKET_SIGNATURE   _T("BucketSignature")  //!< Column: Normalized top frames (module!symbol) separated by new line.
+#define CRP_COL_BUCKET_FRAME_COUNT _T("BucketFrameCount") //!< Column: Number of frames in bucket signature.
+
 /*! \ingroup CrashRptProbeAPI
 *  \brief Retrieves a string property from crash report.
 *  \return This function returns zero on success, with one exception (see Remarks for more information).
@@ -346,6 +368,353 @@ crpGetPropertyA(
 #define crpGetProperty crpGetPropertyA
 #endif //UNICODE
 
+/*! \ingroup CrashRptProbeAPI
+*  \brief Converts table and column names into integer IDs.
+*  \return This function returns zero on success.
+*
+*  \param[in]  lpszTableId Table name, or NULL.
+*  \param[in]  lpszColumnId Column name, or NULL.
+*  \param[out] pnTableId Receives the integer table ID.
+*  \param[out] pnColumnId Receives the integer column ID.
+*
+*  \remarks
+*
+*  Use this function to look up table and column names once and then retrieve properties 
+*  with crpGetPropertyValue(), which doesn't need to compare strings on each call. This is 
+*  useful when many properties are retrieved from many error reports.
+*
+*  \a lpszTableId is the name of the table, for example \ref CRP_TBL_MDMP_MODULES. Stack trace
+*  tables (\c STACK0, \c STACK1 and so on) are supported as well. If this parameter is NULL, 
+*  \a pnTableId is not changed.
+*
+*  \a lpszColumnId is the name of the column, for example \ref CRP_COL_MODULE_NAME, or
+*  \ref CRP_META_ROW_COUNT. If this parameter is NULL, \a pnColumnId is not changed.
+*
+*  The IDs do not depend on the error report and remain valid while CrashRptProbe.dll is loaded. 
+*  They should not be stored between program runs. The function fails if the name is unknown.
+*
+*  If this function fails, use crpGetLastErrorMsg() function to get the error message.
+*
+*  \note
+*  The crpGetPropertyIdW() and crpGetPropertyIdA() are wide character and multibyte 
+*  character versions of crpGetPropertyId(). 
+*
+*  \sa
+*    crpGetPropertyValue(), crpGetProperty()
+*/ 
+
+CRASHRPTPROBE_API(int) 
+crpGetPropertyIdW(
+                  LPCWSTR lpszTableId,
+                  LPCWSTR lpszColumnId,
+                  __out_opt PINT pnTableId,
+                  __out_opt PINT pnColumnId
+                  );
+
+/*! \ingroup CrashRptProbeAPI
+*  \copydoc crpGetPropertyIdW()
+*
+*/
+
+CRASHRPTPROBE_API(int) 
+crpGetPropertyIdA(
+                  LPCSTR lpszTableId,
+                  LPCSTR lpszColumnId,
+                  __out_opt PINT pnTableId,
+                  __out_opt PINT pnColumnId
+                  );
+
+/*! \brief Character set-independent mapping of crpGetPropertyIdW() and crpGetPropertyIdA() functions. 
+*  \ingroup CrashRptProbeAPI
+*/
+
+#ifdef UNICODE
+#define crpGetPropertyId crpGetPropertyIdW
+#else
+#define crpGetPropertyId crpGetPropertyIdA
+#endif //UNICODE
+
+/* Types of values returned by crpGetPropertyValue() function. */
+
+#define CRP_VALUE_INT    1 //!< Property value is an integer.
+#define CRP_VALUE_STRING 2 //!< Property value is a string.
+
+/*! \ingroup CrashRptProbeAPI
+*  \struct CrpPropertyValue
+*  \brief Typed property value returned by crpGetPropertyValue().
+*
+*  \remarks
+*
+*  \a nType is either \ref CRP_VALUE_INT or \ref CRP_VALUE_STRING.
+*
+*  \a nValue is the value of an integer property. For example, for \ref CRP_COL_EXCPTRS_EXCEPTION_CODE
+*     it is the exception code, without the text description that crpGetProperty() appends.
+*     For \ref CRP_COL_THREAD_STACK_TABLEID it is the integer ID of the stack trace table.
+*
+*  \a pszValue points to the value of a string property. The string is not copied; it belongs to 
+*     the error report and remains valid until the report is closed with crpCloseErrorReport().
+*
+*  \a cchLength is the length of the string value in characters.
+*/
+
+typedef struct tagCrpPropertyValue
+{
+    INT nType;         //!< Type of the value.
+    LONGLONG nValue;   //!< Integer value.
+    LPCWSTR pszValue;  //!< String value.
+    ULONG cchLength;   //!< Length of the string value in characters.
+}
+CrpPropertyValue;
+
+/*! \ingroup CrashRptProbeAPI
+*  \brief Retrieves a typed property value by integer table and column IDs.
+*  \return This function returns zero on success, or a negative value on failure.
+*
+*  \param[in]  hReport Handle to the previously opened crash report.
+*  \param[in]  nTableId Table ID returned by crpGetPropertyId().
+*  \param[in]  nColumnId Column ID returned by crpGetPropertyId().
+*  \param[in]  nRowIndex Index of the row in the table.
+*  \param[out] pValue Receives the property value.
+*
+*  \remarks
+*
+*  This function is a faster alternative to crpGetProperty(). Table and column are identified 
+*  by integers, integer properties are returned without conversion to text, and string properties
+*  are returned without copying.
+*
+*  To get the number of rows in a table, pass the ID of \ref CRP_META_ROW_COUNT column. Unlike 
+*  crpGetProperty(), this function returns zero and the row count is placed to \a pValue->nValue.
+*
+*  The function returns the same error codes as crpGetProperty() does.
+*
+*  If this function fails, use crpGetLastErrorMsg() function to get the error message.
+*
+*  \sa
+*    crpGetPropertyId(), crpGetProperty()
+*/ 
+
+CRASHRPTPROBE_API(int) 
+crpGetPropertyValue(
+                    CrpHandle hReport,
+                    INT nTableId,
+                    INT nColumnId,
+                    INT nRowIndex,
+                    __out CrpPropertyValue* pValue
+                    );
+
+/* Output formats of crpExportTables() function. */
+
+#define CRP_EXPORT_JSONL  1 //!< JSON Lines: one JSON object per table row.
+#define CRP_EXPORT_CSV    2 //!< Comma-separated values, one line per table row.
+#define CRP_EXPORT_BINARY 3 //!< Compact length-prefixed binary records.
+
+/* Flags of crpExportTables() function. */
+
+#define CRP_EXPORT_HEADER 0x1 //!< Start CSV output with a line of column names.
+
+/*! \ingroup CrashRptProbeAPI
+*  \brief Receives data written by crpExportTables().
+*  \return The function should return TRUE to continue the export or FALSE to abort it.
+*
+*  \param[in] pData Pointer to the encoded data.
+*  \param[in] cbData Size of data in bytes.
+*  \param[in] pUserParam User-defined parameter passed to crpExportTables().
+*
+*  \remarks
+*
+*  The data is passed in large blocks; a block may end in the middle of a row.
+*/
+
+typedef BOOL (CALLBACK *PFNCRPEXPORTCALLBACK)(LPCVOID pData, ULONG cbData, LPVOID pUserParam);
+
+/*! \ingroup CrashRptProbeAPI
+*  \brief Writes complete tables of the error report in a single pass.
+*  \return This function returns zero on success, or a negative value on failure.
+*
+*  \param[in] hReport Handle to the previously opened crash report.
+*  \param[in] lpszTableId Table to export, or NULL to export all tables.
+*  \param[in] nFormat Output format.
+*  \param[in] dwFlags Flags.
+*  \param[in] pfnCallback Function receiving the output data.
+*  \param[in] pUserParam User-defined parameter passed to \a pfnCallback.
+*
+*  \remarks
+*
+*  This function is a faster alternative to calling crpGetProperty() for each cell of a table.
+*  Rows are encoded in the given format and passed to \a pfnCallback.
+*
+*  \a lpszTableId is the name of the table, for example \ref CRP_TBL_MDMP_MODULES, or the name of a
+*     stack trace table, for example "STACK0". Pass "STACK" to export stack trace tables of all threads.
+*     If this parameter is NULL, all the tables are exported, including stack traces of all threads.
+*
+*  \a nFormat is one of the following:
+*    - \ref CRP_EXPORT_JSONL  Each row is a JSON object on its own line. The object contains "report"
+*         (the crash GUID), "table" and "row" (the zero-based row index) members followed by the
+*         columns of the table.
+*    - \ref CRP_EXPORT_CSV  Each row is a line containing the crash GUID, the table name, the row
+*         index and the columns of the table. Because all lines must have the same columns, 
+*         \a lpszTableId can't be NULL for this format.
+*    - \ref CRP_EXPORT_BINARY  Each record starts with 32-bit record length and a record type byte:
+*         'R' (crash GUID), 'T' (table name and column names, each prefixed with 16-bit length) or
+*         'W' (32-bit row index followed by cells). A cell is a type byte (0 - null, 1 - integer,
+*         2 - string) followed by 64-bit integer or by 32-bit length and the string.
+*         All integers are little-endian.
+*
+*  \a dwFlags can be zero or \ref CRP_EXPORT_HEADER. The header line is useful for the first report
+*     when exporting many reports to the same CSV file.
+*
+*  Strings are encoded in UTF-8. Integer properties are written as numbers, without the text
+*  descriptions that crpGetProperty() appends. Properties that are not available in this report are
+*  written as null (an empty CSV field). Tables that are not available are skipped.
+*
+*  If the callback returns FALSE, the function stops and returns -3.
+*
+*  If this function fails, use crpGetLastErrorMsg() function to get the error message.
+*
+*  \note
+*    The crpExportTablesW() and crpExportTablesA() are wide character and multibyte 
+*    character versions of crpExportTables(). 
+*
+*  \sa
+*    crpExportTablesW(), crpExportTablesA(), crpExportTables(), crpGetProperty()
+*/ 
+
+CRASHRPTPROBE_API(int) 
+crpExportTablesW(
+                 CrpHandle hReport,
+                 __in_opt LPCWSTR lpszTableId,
+                 INT nFormat,
+                 DWORD dwFlags,
+                 PFNCRPEXPORTCALLBACK pfnCallback,
+                 __in_opt LPVOID pUserParam
+                 );
+
+/*! \ingroup CrashRptProbeAPI
+*  \copydoc crpExportTablesW()
+*/
+
+CRASHRPTPROBE_API(int) 
+crpExportTablesA(
+                 CrpHandle hReport,
+                 __in_opt LPCSTR lpszTableId,
+                 INT nFormat,
+                 DWORD dwFlags,
+                 PFNCRPEXPORTCALLBACK pfnCallback,
+                 __in_opt LPVOID pUserParam
+                 );
+
+/*! \brief Character set-independent mapping of crpExportTablesW() and crpExportTablesA() functions. 
+*  \ingroup CrashRptProbeAPI
+*/
+
+#ifdef UNICODE
+#define crpExportTables crpExportTablesW
+#else
+#define crpExportTables crpExportTablesA
+#endif //UNICODE
+
+/*! \ingroup CrashRptProbeAPI
+*  \brief Opens the persistent cache of resolved symbols.
+*  \return This function returns zero on success, or a negative value on failure.
+*
+*  \param[in] lpszFileName Name of the cache file.
+*
+*  \remarks
+*
+*  Resolving stack frames with dbghelp is the most expensive part of opening a minidump. When the
+*  same crash of the same build is reported many times, the same addresses are resolved again and 
+*  again. The symbol cache stores the resolved symbol name, offset in symbol, source file and line
+*  keyed by module build (PDB signature and age, or image time stamp and size) and the address 
+*  relative to module base. Stack frames found in the cache are not resolved with dbghelp at all.
+*
+*  The cache file is memory-mapped and is shared by all reports opened after this call. New symbols
+*  are written to the file by crpCloseSymbolCache(), so the cache persists between runs. 
+*  If the file doesn't exist, it is created on close. If the file is not a valid cache file,
+*  it is ignored and is overwritten on close. Several processes may use the same cache file:
+*  on close, the new symbols are merged with the symbols other processes have written since.
+*
+*  Symbol files of a module are loaded only when they are needed, that is, when a stack walk
+*  passes the module and a frame isn't found in the cache. The symbol load status of other
+*  modules is "Symbols not loaded yet.".
+*
+*  Only symbols resolved from matching PDB files are cached.
+*
+*  Call this function before opening error reports, and don't call it while reports are being
+*  processed by other threads.
+*
+*  If this function fails, use crpGetLastErrorMsg() function to get the error message.
+*
+*  \note
+*    The crpOpenSymbolCacheW() and crpOpenSymbolCacheA() are wide character and multibyte 
+*    character versions of crpOpenSymbolCache(). 
+*
+*  \sa
+*    crpCloseSymbolCache(), crpGetSymbolCacheStats()
+*/ 
+
+CRASHRPTPROBE_API(int) 
+crpOpenSymbolCacheW(
+                    __in LPCWSTR lpszFileName
+                    );
+
+/*! \ingroup CrashRptProbeAPI
+*  \copydoc crpOpenSymbolCacheW()
+*/
+
+CRASHRPTPROBE_API(int) 
+crpOpenSymbolCacheA(
+                    __in LPCSTR lpszFileName
+                    );
+
+/*! \brief Character set-independent mapping of crpOpenSymbolCacheW() and crpOpenSymbolCacheA() functions. 
+*  \ingroup CrashRptProbeAPI
+*/
+
+#ifdef UNICODE
+#define crpOpenSymbolCache crpOpenSymbolCacheW
+#else
+#define crpOpenSymbolCache crpOpenSymbolCacheA
+#endif //UNICODE
+
+/*! \ingroup CrashRptProbeAPI
+*  \brief Writes new symbols to the cache file and closes the symbol cache.
+*  \return This function returns zero on success, or a negative value on failure.
+*
+*  \remarks
+*
+*  Call this function after all error reports are closed. If the cache is not opened,
+*  the function does nothing and returns zero.
+*
+*  \sa
+*    crpOpenSymbolCache(), crpGetSymbolCacheStats()
+*/ 
+
+CRASHRPTPROBE_API(int) 
+crpCloseSymbolCache();
+
+/*! \ingroup CrashRptProbeAPI
+*  \brief Returns statistics of the symbol cache.
+*  \return This function returns zero on success, or a negative value if the cache is not opened.
+*
+*  \param[out] pulHits Receives the number of stack frames found in the cache.
+*  \param[out] pulMisses Receives the number of stack frames not found in the cache.
+*  \param[out] pulEntries Receives the number of entries in the cache.
+*
+*  \remarks
+*
+*  Any of the parameters may be NULL. The hit rate is \a pulHits/(\a pulHits+\a pulMisses).
+*
+*  \sa
+*    crpOpenSymbolCache(), crpCloseSymbolCache()
+*/ 
+
+CRASHRPTPROBE_API(int) 
+crpGetSymbolCacheStats(
+                       __out_opt PULONG64 pulHits,
+                       __out_opt PULONG64 pulMisses,
+                       __out_opt PULONG64 pulEntries
+                       );
+
 /*! \ingroup CrashRptProbeAPI
 *  \brief Extracts a file from the opened error report.
 *  \return This function returns zero if succeeded.
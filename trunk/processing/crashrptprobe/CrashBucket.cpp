@@ -0,0 +1,447 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "CrashBucket.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+// Bucket index file signature ('BCKT') and format version
+#define BUCKETIDX_SIGNATURE 0x544b4342
+#define BUCKETIDX_VERSION   1
+
+// Modules whose frames at the top of the stack are not part of the signature:
+// exception dispatching, C run-time error handling and CrashRpt itself.
+// Compared with the beginning of the lowercase module name.
+static const char* g_aNoiseModules[] =
+{
+    "ntdll.",
+    "kernel32.",
+    "kernelbase.",
+    "msvcr",
+    "msvcp",
+    "ucrtbase",
+    "vcruntime",
+    "crashrpt"
+};
+
+// The same for symbols of C run-time linked statically into the application
+static const char* g_aNoiseSymbols[] =
+{
+    "_CxxThrowException",
+    "RaiseException",
+    "abort",
+    "raise",
+    "terminate",
+    "_purecall",
+    "_invalid_parameter",
+    "_invoke_watson",
+    "__report_gsfailure"
+};
+
+CCrashSignature::CCrashSignature(int nMaxFrames)
+{
+    m_nMaxFrames = nMaxFrames>0?nMaxFrames:CRASHSIG_DEFAULT_FRAMES;
+    m_uFirst = std::string::npos;
+}
+
+void CCrashSignature::Reset()
+{
+    m_asFrames.clear();
+    m_uFirst = std::string::npos;
+}
+
+void CCrashSignature::AddFrame(const char* szModuleName, const char* szSymbolName)
+{
+    // Frames below the signature don't matter, don't waste time on them
+    if(m_uFirst!=std::string::npos && m_asFrames.size()-m_uFirst>=(size_t)m_nMaxFrames)
+        return;
+
+    std::string sFrame = NormalizeFrame(szModuleName, szSymbolName);
+
+    // Recursion and frames of inlined helpers resolved to the same function
+    // would make the signature depend on the recursion depth and the build
+    if(!m_asFrames.empty() && m_asFrames.back()==sFrame)
+        return;
+
+    if(m_uFirst==std::string::npos && !IsNoiseFrame(sFrame))
+        m_uFirst = m_asFrames.size();
+
+    m_asFrames.push_back(sFrame);
+}
+
+std::string CCrashSignature::NormalizeFrame(const char* szModuleName, const char* szSymbolName)
+{
+    std::string sFrame;
+
+    // Module file name without path, lowercase
+    const char* szModule = szModuleName!=NULL?szModuleName:"";
+    const char* p;
+    for(p=szModule; *p!=0; p++)
+    {
+        if(*p=='\\' || *p=='/')
+            szModule = p+1;
+    }
+    for(p=szModule; *p!=0; p++)
+    {
+        char ch = *p;
+        if(ch>='A' && ch<='Z')
+            ch = (char)(ch-'A'+'a');
+        sFrame += ch;
+    }
+    if(sFrame.empty())
+        sFrame = "?";
+
+    sFrame += '!';
+
+    // Symbol name. Unknown symbols are reduced to the module, since their
+    // addresses differ from build to build.
+    const char* szSymbol = szSymbolName!=NULL?szSymbolName:"";
+    if(*szSymbol==0)
+    {
+        sFrame += '?';
+        return sFrame;
+    }
+
+    // Compiler-generated lambda names contain a hash, like <lambda_5d1a0e44c4a4...>
+    static const char szLambda[] = "<lambda_";
+    const size_t uLambdaLen = sizeof(szLambda)-1;
+    for(p=szSymbol; *p!=0; )
+    {
+        if(strncmp(p, szLambda, uLambdaLen)==0)
+        {
+            const char* q = p+uLambdaLen;
+            while(isxdigit((unsigned char)*q))
+                q++;
+            if(*q=='>')
+            {
+                sFrame += "<lambda>";
+                p = q+1;
+                continue;
+            }
+        }
+
+        sFrame += *p;
+        p++;
+    }
+
+    // Trailing spaces
+    while(!sFrame.empty() && sFrame[sFrame.length()-1]==' ')
+        sFrame.erase(sFrame.length()-1);
+
+    return sFrame;
+}
+
+bool CCrashSignature::IsNoiseFrame(const std::string& sFrame)
+{
+    size_t i;
+    for(i=0; i<sizeof(g_aNoiseModules)/sizeof(g_aNoiseModules[0]); i++)
+    {
+        if(sFrame.compare(0, strlen(g_aNoiseModules[i]), g_aNoiseModules[i])==0)
+            return true;
+    }
+
+    std::string::size_type pos = sFrame.find('!');
+    if(pos==std::string::npos)
+        return false;
+
+    for(i=0; i<sizeof(g_aNoiseSymbols)/sizeof(g_aNoiseSymbols[0]); i++)
+    {
+        if(sFrame.compare(pos+1, std::string::npos, g_aNoiseSymbols[i])==0)
+            return true;
+    }
+
+    return false;
+}
+
+int CCrashSignature::Build(std::string& sSignature, std::string& sBucketId) const
+{
+    sSignature.clear();
+    sBucketId.clear();
+
+    // Skip noise frames at the top of the stack, unless there is nothing else
+    size_t uFirst = m_uFirst!=std::string::npos?m_uFirst:0;
+
+    int nCount = 0;
+    size_t i;
+    for(i=uFirst; i<m_asFrames.size() && nCount<m_nMaxFrames; i++, nCount++)
+    {
+        if(nCount!=0)
+            sSignature += '\n';
+        sSignature += m_asFrames[i];
+    }
+
+    if(nCount==0)
+        return 0;
+
+    // 64-bit FNV-1a hash of the signature
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(i=0; i<sSignature.length(); i++)
+    {
+        h ^= (uint8_t)sSignature[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    char szBucketId[17];
+    sprintf(szBucketId, "%08x%08x", (uint32_t)(h>>32), (uint32_t)(h&0xFFFFFFFF));
+    sBucketId = szBucketId;
+
+    return nCount;
+}
+
+// Opens a file by UTF-8 name
+static FILE* OpenFileUtf8(const std::string& sFileName, const char* szMode)
+{
+#ifdef _WIN32
+    int nLen = MultiByteToWideChar(CP_UTF8, 0, sFileName.c_str(), -1, NULL, 0);
+    if(nLen<=0)
+        return NULL;
+    std::vector<wchar_t> aName(nLen);
+    MultiByteToWideChar(CP_UTF8, 0, sFileName.c_str(), -1, &aName[0], nLen);
+    wchar_t szWideMode[8] = L"";
+    size_t i;
+    for(i=0; szMode[i]!=0 && i<7; i++)
+        szWideMode[i] = szMode[i];
+    szWideMode[i] = 0;
+    return _wfopen(&aName[0], szWideMode);
+#else
+    return fopen(sFileName.c_str(), szMode);
+#endif
+}
+
+// Replaces a file with another one
+static bool ReplaceFileUtf8(const std::string& sFrom, const std::string& sTo)
+{
+#ifdef _WIN32
+    std::vector<wchar_t> aFrom(sFrom.length()+1);
+    std::vector<wchar_t> aTo(sTo.length()+1);
+    if(0==MultiByteToWideChar(CP_UTF8, 0, sFrom.c_str(), -1, &aFrom[0], (int)aFrom.size()) ||
+        0==MultiByteToWideChar(CP_UTF8, 0, sTo.c_str(), -1, &aTo[0], (int)aTo.size()))
+        return false;
+    return MoveFileExW(&aFrom[0], &aTo[0], MOVEFILE_REPLACE_EXISTING)!=FALSE;
+#else
+    return rename(sFrom.c_str(), sTo.c_str())==0;
+#endif
+}
+
+static void AppendU32(std::string& sOut, uint32_t u)
+{
+    sOut += (char)(u&0xFF);
+    sOut += (char)((u>>8)&0xFF);
+    sOut += (char)((u>>16)&0xFF);
+    sOut += (char)(u>>24);
+}
+
+static void AppendString(std::string& sOut, const std::string& s)
+{
+    AppendU32(sOut, (uint32_t)s.length());
+    sOut += s;
+}
+
+// Reads a little-endian 32-bit integer, returns false if there is not enough data
+static bool ReadU32(const std::string& sData, size_t& uPos, uint32_t& u)
+{
+    if(sData.length()-uPos<4)
+        return false;
+    const unsigned char* p = (const unsigned char*)sData.data()+uPos;
+    u = p[0] | (p[1]<<8) | (p[2]<<16) | ((uint32_t)p[3]<<24);
+    uPos += 4;
+    return true;
+}
+
+static bool ReadString(const std::string& sData, size_t& uPos, std::string& s)
+{
+    uint32_t uLen = 0;
+    if(!ReadU32(sData, uPos, uLen) || sData.length()-uPos<uLen)
+        return false;
+    s.assign(sData, uPos, uLen);
+    uPos += uLen;
+    return true;
+}
+
+int CBucketIndex::Open(const char* szFileName)
+{
+    Close();
+
+    if(szFileName==NULL)
+        return BUCKETIDX_ERR_INVALID_FILE;
+
+    m_sFileName = szFileName;
+
+    FILE* f = OpenFileUtf8(m_sFileName, "rb");
+    if(f==NULL)
+        return BUCKETIDX_OK; // No index yet
+
+    std::string sData;
+    char buff[64*1024];
+    size_t uRead;
+    while((uRead=fread(buff, 1, sizeof(buff), f))>0)
+        sData.append(buff, uRead);
+    fclose(f);
+
+    size_t uPos = 0;
+    uint32_t uSignature = 0;
+    uint32_t uVersion = 0;
+    uint32_t uCount = 0;
+    if(!ReadU32(sData, uPos, uSignature) || uSignature!=BUCKETIDX_SIGNATURE ||
+        !ReadU32(sData, uPos, uVersion) || uVersion!=BUCKETIDX_VERSION ||
+        !ReadU32(sData, uPos, uCount))
+        return BUCKETIDX_ERR_INVALID_FILE;
+
+    uint32_t i;
+    for(i=0; i<uCount; i++)
+    {
+        CrashBucket b;
+        if(!ReadU32(sData, uPos, b.m_uCount) ||
+            !ReadString(sData, uPos, b.m_sBucketId) ||
+            !ReadString(sData, uPos, b.m_sSignature) ||
+            !ReadString(sData, uPos, b.m_sFirstSeen) ||
+            !ReadString(sData, uPos, b.m_sLastSeen) ||
+            !ReadString(sData, uPos, b.m_sReport))
+        {
+            m_Buckets.clear();
+            return BUCKETIDX_ERR_INVALID_FILE;
+        }
+
+        m_Buckets[b.m_sBucketId] = b;
+    }
+
+    if(uPos!=sData.length())
+    {
+        m_Buckets.clear();
+        return BUCKETIDX_ERR_INVALID_FILE;
+    }
+
+    return BUCKETIDX_OK;
+}
+
+int CBucketIndex::Save()
+{
+    if(m_sFileName.empty())
+        return BUCKETIDX_ERR_WRITE_FILE;
+
+    std::string sData;
+    AppendU32(sData, BUCKETIDX_SIGNATURE);
+    AppendU32(sData, BUCKETIDX_VERSION);
+    AppendU32(sData, (uint32_t)m_Buckets.size());
+
+    std::map<std::string, CrashBucket>::const_iterator it;
+    for(it=m_Buckets.begin(); it!=m_Buckets.end(); it++)
+    {
+        const CrashBucket& b = it->second;
+        AppendU32(sData, b.m_uCount);
+        AppendString(sData, b.m_sBucketId);
+        AppendString(sData, b.m_sSignature);
+        AppendString(sData, b.m_sFirstSeen);
+        AppendString(sData, b.m_sLastSeen);
+        AppendString(sData, b.m_sReport);
+    }
+
+    // Write to a temporary file and replace the index with it, so the index
+    // is not lost if writing fails
+    std::string sTmpFileName = m_sFileName+".tmp";
+    FILE* f = OpenFileUtf8(sTmpFileName, "wb");
+    if(f==NULL)
+        return BUCKETIDX_ERR_WRITE_FILE;
+
+    bool bWritten = fwrite(sData.data(), 1, sData.length(), f)==sData.length();
+    bWritten = fclose(f)==0 && bWritten;
+
+    if(!bWritten || !ReplaceFileUtf8(sTmpFileName, m_sFileName))
+    {
+        remove(sTmpFileName.c_str());
+        return BUCKETIDX_ERR_WRITE_FILE;
+    }
+
+    return BUCKETIDX_OK;
+}
+
+void CBucketIndex::Close()
+{
+    m_sFileName.clear();
+    m_Buckets.clear();
+}
+
+uint32_t CBucketIndex::AddReport(const std::string& sBucketId, const std::string& sSignature,
+                                 const std::string& sReport, const std::string& sCrashTime)
+{
+    CrashBucket& b = m_Buckets[sBucketId];
+    if(b.m_uCount==0)
+    {
+        b.m_sBucketId = sBucketId;
+        b.m_sSignature = sSignature;
+        b.m_sReport = sReport;
+    }
+
+    b.m_uCount++;
+
+    // ISO 8601 times of the same format are ordered as strings
+    if(!sCrashTime.empty())
+    {
+        if(b.m_sFirstSeen.empty() || sCrashTime<b.m_sFirstSeen)
+            b.m_sFirstSeen = sCrashTime;
+        if(b.m_sLastSeen.empty() || sCrashTime>b.m_sLastSeen)
+            b.m_sLastSeen = sCrashTime;
+    }
+
+    return b.m_uCount;
+}
+
+bool CBucketIndex::Find(const std::string& sBucketId, CrashBucket& Bucket) const
+{
+    std::map<std::string, CrashBucket>::const_iterator it = m_Buckets.find(sBucketId);
+    if(it==m_Buckets.end())
+        return false;
+
+    Bucket = it->second;
+    return true;
+}
+
+// Orders buckets by report count, the largest first
+static bool CompareBuckets(const CrashBucket& a, const CrashBucket& b)
+{
+    if(a.m_uCount!=b.m_uCount)
+        return a.m_uCount>b.m_uCount;
+    return a.m_sBucketId<b.m_sBucketId;
+}
+
+void CBucketIndex::GetBuckets(std::vector<CrashBucket>& aBuckets) const
+{
+    aBuckets.clear();
+    aBuckets.reserve(m_Buckets.size());
+
+    std::map<std::string, CrashBucket>::const_iterator it;
+    for(it=m_Buckets.begin(); it!=m_Buckets.end(); it++)
+        aBuckets.push_back(it->second);
+
+    std::sort(aBuckets.begin(), aBuckets.end(), CompareBuckets);
+}
+
+size_t CBucketIndex::GetBucketCount() const
+{
+    return m_Buckets.size();
+}
+
+uint64_t CBucketIndex::GetReportCount() const
+{
+    uint64_t uTotal = 0;
+    std::map<std::string, CrashBucket>::const_iterator it;
+    for(it=m_Buckets.begin(); it!=m_Buckets.end(); it++)
+        uTotal += it->second.m_uCount;
+    return uTotal;
+}
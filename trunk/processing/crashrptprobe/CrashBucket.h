@@ -0,0 +1,130 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: CrashBucket.h
+// Description: Crash signature bucketing. CCrashSignature reduces a stack trace to the
+// normalized top frames (module!symbol, no offsets), so crashes of the same bug land in
+// the same bucket regardless of build. CBucketIndex keeps per-bucket statistics on disk.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int8  uint8_t;
+typedef unsigned __int32 uint32_t;
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// Default number of frames in the crash signature
+#define CRASHSIG_DEFAULT_FRAMES 5
+
+// class CCrashSignature
+// Builds the crash signature from stack frames, top frame first.
+class CCrashSignature
+{
+public:
+
+    CCrashSignature(int nMaxFrames=CRASHSIG_DEFAULT_FRAMES);
+
+    // Removes all frames
+    void Reset();
+
+    // Adds the next stack frame. Module and symbol names are UTF-8, either may be
+    // empty if unknown. Consecutive frames with the same normalized name are merged.
+    void AddFrame(const char* szModuleName, const char* szSymbolName);
+
+    // Makes the signature of the frames added. Leading frames of exception dispatching,
+    // C run-time and CrashRpt itself are skipped, the next frames up to the maximum
+    // number are joined with '\n'. The bucket ID is the hash of the signature, 16 hex digits.
+    // Returns the number of frames in the signature; if zero, both strings are empty.
+    int Build(std::string& sSignature, std::string& sBucketId) const;
+
+    // Returns normalized frame name: lowercase module file name without path, '!'
+    // and the symbol name without build-specific parts (like lambda hashes).
+    static std::string NormalizeFrame(const char* szModuleName, const char* szSymbolName);
+
+    // Returns true if the normalized frame is exception dispatching or error handling code
+    static bool IsNoiseFrame(const std::string& sFrame);
+
+private:
+
+    int m_nMaxFrames;                 // Maximum number of frames in signature
+    std::vector<std::string> m_asFrames; // Normalized frames
+    size_t m_uFirst;                  // Index of the first frame that is not noise, or npos
+};
+
+// Error codes returned by CBucketIndex methods
+enum BucketIndexError
+{
+    BUCKETIDX_OK = 0,               // Success
+    BUCKETIDX_ERR_INVALID_FILE = 1, // Not a bucket index file, or the file is truncated
+    BUCKETIDX_ERR_WRITE_FILE = 2    // Couldn't write the file
+};
+
+// Statistics of a crash bucket
+struct CrashBucket
+{
+    CrashBucket()
+    {
+        m_uCount = 0;
+    }
+
+    std::string m_sBucketId;  // Bucket ID (hash of signature)
+    std::string m_sSignature; // Normalized top frames joined with '\n'
+    uint32_t m_uCount;        // Number of reports in the bucket
+    std::string m_sFirstSeen; // The earliest crash time (UTC, ISO 8601), or empty
+    std::string m_sLastSeen;  // The latest crash time (UTC, ISO 8601), or empty
+    std::string m_sReport;    // Representative report (the first one added)
+};
+
+// class CBucketIndex
+// On-disk index of crash buckets keyed by bucket ID. The whole index is loaded
+// on Open() and is rewritten on Save(). The class is not thread-safe.
+class CBucketIndex
+{
+public:
+
+    // Opens the index file (UTF-8 file name). A missing file is not an error, the
+    // index is empty then. An invalid file is ignored and is overwritten on Save().
+    int Open(const char* szFileName);
+
+    // Writes the index to the file
+    int Save();
+
+    // Removes all buckets and forgets the file name
+    void Close();
+
+    // Adds a report to its bucket, creating the bucket if needed. The crash time
+    // is UTC time in ISO 8601 format (may be empty). Returns the number of reports
+    // in the bucket.
+    uint32_t AddReport(const std::string& sBucketId, const std::string& sSignature,
+        const std::string& sReport, const std::string& sCrashTime);
+
+    // Looks up the bucket by ID
+    bool Find(const std::string& sBucketId, CrashBucket& Bucket) const;
+
+    // Returns all buckets, the largest first
+    void GetBuckets(std::vector<CrashBucket>& aBuckets) const;
+
+    // Returns the number of buckets
+    size_t GetBucketCount() const;
+
+    // Returns the number of reports in all buckets
+    uint64_t GetReportCount() const;
+
+private:
+
+    std::string m_sFileName;                    // Index file name (UTF-8)
+    std::map<std::string, CrashBucket> m_Buckets; // <bucket_id, bucket> pairs
+};
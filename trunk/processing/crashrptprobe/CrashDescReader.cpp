@@ -16,7 +16,6 @@ be found in the Authors.txt file in the root of the source tree.
 #include "stdafx.h"
 #include "CrashRpt.h"
 #include "CrashDescReader.h"
-#include "tinyxml.h"
 #include "Utility.h"
 #include "strconv.h"
 
@@ -35,9 +34,8 @@ CCrashDescReader::~CCrashDescReader()
 
 int CCrashDescReader::Load(CString sFileName)
 {
-    TiXmlDocument doc;
+    CXmlPullParser parser;
     FILE* f = NULL;
-    strconv_t strconv;
 
     if(m_bLoaded)
         return 1; // already loaded
@@ -52,385 +50,243 @@ int CCrashDescReader::Load(CString sFileName)
     if(f==NULL)
         return -1; // File can't be opened
 
-    // Open XML document  
-    bool bLoaded = doc.LoadFile(f);
-    if(!bLoaded)
-    {
-        fclose(f);
+    // Read XML document  
+    bool bRead = parser.Open(f);
+    fclose(f);
+    if(!bRead)
         return -2; // XML is corrupted
-    }
 
-    TiXmlHandle hDoc(&doc);
-
-    TiXmlHandle hRoot = hDoc.FirstChild("CrashRpt").ToElement();
-    if(hRoot.ToElement()==NULL)
-    {
-        if(LoadXmlv10(hDoc)==0)
-        {
-            fclose(f);
-            return 0;
-        }  
+    return LoadXml(parser);
+}
 
-        return -3; // Invalid XML structure
-    }
+int CCrashDescReader::Load(const char* pXmlData, size_t uSize)
+{
+    CXmlPullParser parser;
 
-    // Get generator version
+    if(m_bLoaded)
+        return 1; // already loaded
 
-    const char* szCrashRptVersion = hRoot.ToElement()->Attribute("version");
-    if(szCrashRptVersion!=NULL)
-    {
-        m_dwGeneratorVersion = atoi(szCrashRptVersion);
-    }
+    if(pXmlData==NULL)
+        return -1; // No data
 
-    // Get CrashGUID
-    TiXmlHandle hCrashGUID = hRoot.ToElement()->FirstChild("CrashGUID");
-    if(hCrashGUID.ToElement())
-    {    
-        TiXmlText* pTextElem = hCrashGUID.FirstChild().Text();     
-        if(pTextElem)
-        {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sCrashGUID = strconv.utf82t(text);    
-        }    
-    }
+    // The parser normalizes new lines the same way TiXmlDocument::LoadFile() did, 
+    // so text values are the same as if the XML were loaded from file.
+    parser.Open(pXmlData, uSize);
 
-    // Get AppName
-    TiXmlHandle hAppName = hRoot.ToElement()->FirstChild("AppName");
-    if(hAppName.ToElement())
-    {    
-        TiXmlText* pTextElem = hAppName.FirstChild().Text();     
-        if(pTextElem)
-        {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sAppName = strconv.utf82t(text);        
-        }
-    }
+    return LoadXml(parser);
+}
 
-    // Get AppVersion
-    TiXmlHandle hAppVersion = hRoot.ToElement()->FirstChild("AppVersion");
-    if(hAppVersion.ToElement())
-    {    
-        TiXmlText* pTextElem = hAppVersion.FirstChild().Text();     
-        if(pTextElem)
-        {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sAppVersion = strconv.utf82t(text);    
-        }
-    }
+int CCrashDescReader::LoadXml(CXmlPullParser& parser)
+{
+    strconv_t strconv;
 
-    // Get ImageName
-    TiXmlHandle hImageName = hRoot.ToElement()->FirstChild("ImageName");
-    if(hImageName.ToElement())
-    {    
-        TiXmlText* pTextElem = hImageName.FirstChild().Text();     
-        if(pTextElem)
+    // Find the root element
+    for(;;)
+    {
+        if(!parser.ReadChildElement(-1))
         {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sImageName = strconv.utf82t(text);        
-        }
-    }
+            if(parser.GetNodeType()==XML_NODE_ERROR)
+                return -2; // XML is corrupted
 
-    // Get OperatingSystem
-    TiXmlHandle hOperatingSystem = hRoot.ToElement()->FirstChild("OperatingSystem");
-    if(hOperatingSystem.ToElement())
-    {    
-        TiXmlText* pTextElem = hOperatingSystem.FirstChild().Text();     
-        if(pTextElem)
-        {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sOperatingSystem = strconv.utf82t(text);        
+            return -3; // Invalid XML structure
         }
-    }
 
-    // Get GeoLocation
-    TiXmlHandle hGeoLocation = hRoot.ToElement()->FirstChild("GeoLocation");
-    if(hGeoLocation.ToElement())
-    {    
-        TiXmlText* pTextElem = hGeoLocation.FirstChild().Text();     
-        if(pTextElem)
-        {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sGeoLocation = strconv.utf82t(text);        
-        }
-    }
+        if(strcmp(parser.GetName(), "CrashRpt")==0)
+            break;
 
-    // Get OSIs64Bit
-    m_bOSIs64Bit = FALSE;
-    TiXmlHandle hOSIs64Bit = hRoot.ToElement()->FirstChild("OSIs64Bit");
-    if(hOSIs64Bit.ToElement())
-    {    
-        TiXmlText* pTextElem = hOSIs64Bit.FirstChild().Text();     
-        if(pTextElem)
-        {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_bOSIs64Bit = atoi(text);        
-        }
+        if(strcmp(parser.GetName(), "Exception")==0)
+            return LoadXmlv10(parser);
     }
 
-    // Get SystemTimeUTC
-    TiXmlHandle hSystemTimeUTC = hRoot.ToElement()->FirstChild("SystemTimeUTC");
-    if(hSystemTimeUTC.ToElement())
-    {    
-        TiXmlText* pTextElem = hSystemTimeUTC.FirstChild().Text();     
-        if(pTextElem)
-        {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sSystemTimeUTC = strconv.utf82t(text);        
-        }
-    }
+    // Get generator version
 
-    // Get ExceptionType
-    TiXmlHandle hExceptionType = hRoot.ToElement()->FirstChild("ExceptionType");
-    if(hExceptionType.ToElement())
-    {    
-        TiXmlText* pTextElem = hExceptionType.FirstChild().Text();     
-        if(pTextElem)
-        {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_dwExceptionType = atoi(text);        
-        }
+    const char* szCrashRptVersion = parser.GetAttribute("version");
+    if(szCrashRptVersion!=NULL)
+    {
+        m_dwGeneratorVersion = atoi(szCrashRptVersion);
     }
 
-    // Get UserEmail
-    TiXmlHandle hUserEmail = hRoot.ToElement()->FirstChild("UserEmail");
-    if(hUserEmail.ToElement())
-    {    
-        TiXmlText* pTextElem = hUserEmail.FirstChild().Text();     
-        if(pTextElem)
-        {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sUserEmail = strconv.utf82t(text);    
-        }
-    }
+    m_bOSIs64Bit = FALSE;
 
-    // Get ProblemDecription
-    TiXmlHandle hProblemDescription = hRoot.ToElement()->FirstChild("ProblemDescription");
-    if(hProblemDescription.ToElement())
+    // Walk the children of the root element in a single pass
+    int nRootDepth = parser.GetDepth();
+    while(parser.ReadChildElement(nRootDepth))
     {
-        TiXmlText* pTextElem = hProblemDescription.FirstChild().Text();     
-        if(pTextElem)
+        const char* szName = parser.GetName();
+
+        if(strcmp(szName, "CrashGUID")==0)
+            m_sCrashGUID = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "AppName")==0)
+            m_sAppName = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "AppVersion")==0)
+            m_sAppVersion = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "ImageName")==0)
+            m_sImageName = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "OperatingSystem")==0)
+            m_sOperatingSystem = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "GeoLocation")==0)
+            m_sGeoLocation = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "OSIs64Bit")==0)
+            m_bOSIs64Bit = atoi(parser.ReadElementText());
+        else if(strcmp(szName, "SystemTimeUTC")==0)
+            m_sSystemTimeUTC = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "ExceptionType")==0)
+            m_dwExceptionType = atoi(parser.ReadElementText());
+        else if(strcmp(szName, "UserEmail")==0)
+            m_sUserEmail = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "ProblemDescription")==0)
+            m_sProblemDescription = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "ExceptionCode")==0)
+            m_dwExceptionCode = atoi(parser.ReadElementText());
+        else if(strcmp(szName, "FPESubcode")==0)
+            m_dwFPESubcode = atoi(parser.ReadElementText());
+        else if(strcmp(szName, "InvParamExpression")==0)
+            m_sInvParamExpression = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "InvParamFunction")==0)
+            m_sInvParamFunction = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "InvParamFile")==0)
+            m_sInvParamFile = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "InvParamLine")==0)
+            m_dwInvParamLine = atoi(parser.ReadElementText());
+        else if(strcmp(szName, "GUIResourceCount")==0)
+            m_sGUIResourceCount = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "OpenHandleCount")==0)
+            m_sOpenHandleCount = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "MemoryUsageKbytes")==0)
+            m_sMemoryUsageKbytes = strconv.utf82t(parser.ReadElementText());
+        else if(strcmp(szName, "FileList")==0 || 
+            strcmp(szName, "FileItems")==0) // This may work for reports generated by v1.2.1
         {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sProblemDescription = strconv.utf82t(text);    
-        }
-    }
-
-    // Get ExceptionCode (for SEH exceptions only)
-    if(m_dwExceptionType==CR_SEH_EXCEPTION)
-    {    
-        TiXmlHandle hExceptionCode = hRoot.ToElement()->FirstChild("ExceptionCode");
-        if(hExceptionCode.ToElement())
-        {      
-            TiXmlText* pTextElem = hExceptionCode.FirstChild().Text();     
-            if(pTextElem)
+            // Get file items list
+            while(parser.ReadChildElement(nRootDepth+1))
             {
-                const char* text = pTextElem->Value();
-                if(text)
-                    m_dwExceptionCode = atoi(text);    
-            }
-        }
-    }
+                if(strcmp(parser.GetName(), "FileItem")!=0)
+                    continue;
 
-    // Get FPESubcode (for FPE exceptions only)
-    if(m_dwExceptionType==CR_CPP_SIGFPE)
-    {    
-        TiXmlHandle hFPESubcode = hRoot.ToElement()->FirstChild("FPESubcode");
-        if(hFPESubcode.ToElement())
-        {      
-            TiXmlText* pTextElem = hFPESubcode.FirstChild().Text();     
-            if(pTextElem)
-            {
-                const char* text = pTextElem->Value();
-                if(text)
-                    m_dwFPESubcode = atoi(text);          
-            }
-        }
-    }
+                const char* szFileName = parser.GetAttribute("name");
+                const char* szFileDescription = parser.GetAttribute("description");
 
-    // Get InvParamExpression, InvParamFunction, InvParamFile, InvParamLine 
-    // (for invalid parameter exceptions only)
-    if(m_dwExceptionType==CR_CPP_INVALID_PARAMETER)
-    {    
-        TiXmlHandle hInvParamExpression = hRoot.ToElement()->FirstChild("InvParamExpression");
-        if(hInvParamExpression.ToElement())
-        {      
-            TiXmlText* pTextElem = hInvParamExpression.FirstChild().Text();     
-            if(pTextElem)
-            {
-                const char* text = pTextElem->Value();
-                if(text)
-                    m_sInvParamExpression = strconv.utf82t(text);          
-            }
-        }
+                CString sFileName, sFileDescription;
+                if(szFileName!=NULL)
+                    sFileName = strconv.utf82t(szFileName);    
+                if(szFileDescription!=NULL)
+                    sFileDescription = strconv.utf82t(szFileDescription);    
 
-        TiXmlHandle hInvParamFunction = hRoot.ToElement()->FirstChild("InvParamFunction");
-        if(hInvParamFunction.ToElement())
-        {      
-            TiXmlText* pTextElem = hInvParamFunction.FirstChild().Text();     
-            if(pTextElem)
-            {
-                const char* text = pTextElem->Value();
-                if(text)
-                    m_sInvParamFunction = strconv.utf82t(text);          
+                m_aFileItems[sFileName]=sFileDescription;
             }
         }
-
-        TiXmlHandle hInvParamFile = hRoot.ToElement()->FirstChild("InvParamFile");
-        if(hInvParamFile.ToElement())
-        {      
-            TiXmlText* pTextElem = hInvParamFile.FirstChild().Text();     
-            if(pTextElem)
+        else if(strcmp(szName, "CustomProps")==0)
+        {
+            // Get custom property list
+            while(parser.ReadChildElement(nRootDepth+1))
             {
-                const char* text = pTextElem->Value();
-                if(text)
-                    m_sInvParamFile = strconv.utf82t(text);          
-            }
-        }
+                if(strcmp(parser.GetName(), "Prop")!=0)
+                    continue;
 
-        TiXmlHandle hInvParamLine = hRoot.ToElement()->FirstChild("InvParamLine");
-        if(hInvParamLine.ToElement())
-        {      
-            TiXmlText* pTextElem = hInvParamLine.FirstChild().Text();     
-            if(pTextElem)
-            {
-                const char* text = pTextElem->Value();
-                if(text)
-                    m_dwInvParamLine = atoi(text);          
-            }
-        }
-    }
+                const char* szPropName = parser.GetAttribute("name");
+                const char* szValue = parser.GetAttribute("value");
 
-    // Get GUI resource count
-    TiXmlHandle hGUIResourceCount = hRoot.ToElement()->FirstChild("GUIResourceCount");
-    if(hGUIResourceCount.ToElement())
-    {      
-        TiXmlText* pTextElem = hGUIResourceCount.FirstChild().Text();     
-        if(pTextElem)
-        {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sGUIResourceCount = strconv.utf82t(text);          
-        }
-    }
+                CString sName, sValue;
+                if(szPropName!=NULL)
+                    sName = strconv.utf82t(szPropName);    
+                if(szValue!=NULL)
+                    sValue = strconv.utf82t(szValue);    
 
-    // Get open handle count
-    TiXmlHandle hOpenHandleCount = hRoot.ToElement()->FirstChild("OpenHandleCount");
-    if(hOpenHandleCount.ToElement())
-    {      
-        TiXmlText* pTextElem = hOpenHandleCount.FirstChild().Text();     
-        if(pTextElem)
-        {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sOpenHandleCount = strconv.utf82t(text);          
+                m_aCustomProps[sName]=sValue;
+            }
         }
-    }
-
-    // Get memory usage in KB
-    TiXmlHandle hMemoryUsageKbytes = hRoot.ToElement()->FirstChild("MemoryUsageKbytes");
-    if(hMemoryUsageKbytes.ToElement())
-    {      
-        TiXmlText* pTextElem = hMemoryUsageKbytes.FirstChild().Text();     
-        if(pTextElem)
+        else if(strcmp(szName, "Breadcrumbs")==0)
         {
-            const char* text = pTextElem->Value();
-            if(text)
-                m_sMemoryUsageKbytes = strconv.utf82t(text);          
+            // Get breadcrumbs (they are written oldest first)
+            while(parser.ReadChildElement(nRootDepth+1))
+            {
+                if(strcmp(parser.GetName(), "Breadcrumb")!=0)
+                    continue;
+
+                const char* szTime = parser.GetAttribute("time");
+                const char* szThread = parser.GetAttribute("thread");
+                const char* szCategory = parser.GetAttribute("category");
+                const char* szMessage = parser.GetAttribute("message");
+
+                Breadcrumb bc;
+                if(szTime!=NULL)
+                    bc.m_sTime = strconv.utf82t(szTime);
+                if(szThread!=NULL)
+                    bc.m_sThreadId = strconv.utf82t(szThread);
+                if(szCategory!=NULL)
+                    bc.m_sCategory = strconv.utf82t(szCategory);
+                if(szMessage!=NULL)
+                    bc.m_sMessage = strconv.utf82t(szMessage);
+
+                m_aBreadcrumbs.push_back(bc);
+            }
         }
     }
 
-    // Get file items list
-    TiXmlHandle hFileList = hRoot.ToElement()->FirstChild("FileList");
-    if(!hFileList.ToElement())
-    {
-        // This may work for reports generated by v1.2.1
-        hFileList = hRoot.ToElement()->FirstChild("FileItems");
-    }
-    if(hFileList.ToElement())
-    {
-        TiXmlHandle hFileItem = hFileList.ToElement()->FirstChild("FileItem");
-        while(hFileItem.ToElement())
-        {
-            const char* szFileName = hFileItem.ToElement()->Attribute("name");
-            const char* szFileDescription = hFileItem.ToElement()->Attribute("description");
-
-            CString sFileName, sFileDescription;
-            if(szFileName!=NULL)
-                sFileName = strconv.utf82t(szFileName);    
-            if(szFileName!=NULL)
-                sFileDescription = strconv.utf82t(szFileDescription);    
+    // Check the rest of the document is well-formed
+    while(parser.ReadChildElement(-1));
+    if(parser.GetNodeType()==XML_NODE_ERROR)
+        return -2; // XML is corrupted
 
-            m_aFileItems[sFileName]=sFileDescription;
+    // ExceptionCode is used for SEH exceptions only
+    if(m_dwExceptionType!=CR_SEH_EXCEPTION)
+        m_dwExceptionCode = 0;
 
-            hFileItem = hFileItem.ToElement()->NextSibling();
-        }
-    }
+    // FPESubcode is used for FPE exceptions only
+    if(m_dwExceptionType!=CR_CPP_SIGFPE)
+        m_dwFPESubcode = 0;
 
-    // Get custom property list
-    TiXmlHandle hCustomProps = hRoot.ToElement()->FirstChild("CustomProps");
-    if(hCustomProps.ToElement())
+    // InvParamExpression, InvParamFunction, InvParamFile, InvParamLine 
+    // are used for invalid parameter exceptions only
+    if(m_dwExceptionType!=CR_CPP_INVALID_PARAMETER)
     {
-        TiXmlHandle hProp = hCustomProps.ToElement()->FirstChild("Prop");
-        while(hProp.ToElement())
-        {
-            const char* szName = hProp.ToElement()->Attribute("name");
-            const char* szValue = hProp.ToElement()->Attribute("value");
-
-            CString sName, sValue;
-            if(szName!=NULL)
-                sName = strconv.utf82t(szName);    
-            if(szValue!=NULL)
-                sValue = strconv.utf82t(szValue);    
-
-            m_aCustomProps[sName]=sValue;
-
-            hProp = hProp.ToElement()->NextSibling();
-        }
+        m_sInvParamExpression.Empty();
+        m_sInvParamFunction.Empty();
+        m_sInvParamFile.Empty();
+        m_dwInvParamLine = 0;
     }
 
-    fclose(f);
-
     // OK  
     m_bLoaded = true;
     return 0;
 }
 
-int CCrashDescReader::LoadXmlv10(TiXmlHandle hDoc)
+int CCrashDescReader::LoadXmlv10(CXmlPullParser& parser)
 {
-    TiXmlHandle hRoot = hDoc.FirstChild("Exception").ToElement();
-    if(hRoot.ToElement()==NULL)
+    // The parser is at the start tag of the Exception root element
+
+    const char* szImageName = parser.GetAttribute("ModuleName");
+    bool bExceptionRecord = false;
+
+    // Get ExceptionRecord element
+
+    int nRootDepth = parser.GetDepth();
+    while(parser.ReadChildElement(nRootDepth))
     {
-        return -3; // Invalid XML structure
+        if(!bExceptionRecord && strcmp(parser.GetName(), "ExceptionRecord")==0)
+        {
+            bExceptionRecord = true;
+
+            // Some reports have the module name in ExceptionRecord
+            if(szImageName==NULL)
+                szImageName = parser.GetAttribute("ModuleName");
+        }
     }
 
+    // Check the rest of the document is well-formed
+    while(parser.ReadChildElement(-1));
+    if(parser.GetNodeType()==XML_NODE_ERROR)
+        return -2; // XML is corrupted
+
     // Set CrashRpt version to 1000
 
     m_dwGeneratorVersion = 1000;
 
-    // Get ExceptionRecord element
-
-    TiXmlHandle hExceptionRecord = hRoot.FirstChild("ExceptionRecord").ToElement();
-
-    if(hExceptionRecord.ToElement()!=NULL)
+    if(bExceptionRecord && szImageName!=NULL)
     {
-        const char* szImageName = hRoot.ToElement()->Attribute("ModuleName");
-        if(szImageName!=NULL)
-        {
-            m_sImageName = szImageName;
+        m_sImageName = szImageName;
 
-            m_sAppName = Utility::GetBaseFileName(szImageName);
-        }
+        m_sAppName = Utility::GetBaseFileName(m_sImageName);
     }  
 
     // OK
@@ -16,7 +16,8 @@ be found in the Authors.txt file in the root of the source tree.
 #pragma once
 #include "stdafx.h"
 #include <map>
-#include "tinyxml.h"
+#include <vector>
+#include "XmlStream.h"
 
 class CCrashDescReader
 {
@@ -25,8 +26,12 @@ public:
     CCrashDescReader();
     ~CCrashDescReader();
 
+    // Loads crash description from XML file
     int Load(CString sFileName);
 
+    // Loads crash description from XML data in memory (e.g. inflated from ZIP)
+    int Load(const char* pXmlData, size_t uSize);
+
     bool m_bLoaded;
 
     DWORD m_dwGeneratorVersion;
@@ -60,8 +65,20 @@ public:
     std::map<CString, CString> m_aFileItems;
     std::map<CString, CString> m_aCustomProps;
 
+    // A breadcrumb (recent application event)
+    struct Breadcrumb
+    {
+        CString m_sTime;
+        CString m_sThreadId;
+        CString m_sCategory;
+        CString m_sMessage;
+    };
+
+    std::vector<Breadcrumb> m_aBreadcrumbs;
+
 private:
 
-    int LoadXmlv10(TiXmlHandle hDoc);
+    int LoadXml(CXmlPullParser& parser);
+    int LoadXmlv10(CXmlPullParser& parser);
 };
 
@@ -19,10 +19,12 @@ be found in the Authors.txt file in the root of the source tree.
 #include <map>
 #include "CrashDescReader.h"
 #include "MinidumpReader.h"
-#include "md5.h"
+#include "ReportDigest.h"
 #include "Utility.h"
 #include "strconv.h"
 #include "unzip.h"
+#include "TableExporter.h"
+#include "SymbolCache.h"
 
 CComAutoCriticalSection g_crp_cs; // Critical section for thread-safe accessing error messages
 std::map<DWORD, CString> g_crp_sErrorMsg; // Last error messages for each calling thread.
@@ -56,31 +58,57 @@ struct CrpReportData
         m_hZip = 0;
         m_pDescReader = NULL;
         m_pDmpReader = NULL;
+        m_pMiniDumpData = NULL;
+        m_uMiniDumpSize = 0;
+        m_hMiniDumpMapping = NULL;
     }
 
     unzFile m_hZip; // Handle to the ZIP archive
     CCrashDescReader* m_pDescReader; // Pointer to the crash description reader object
     CMiniDumpReader* m_pDmpReader;   // Pointer to the minidump reader object
-    CString m_sMiniDumpTempName;     // The name of the tmp file to store extracted minidump in
+    LPVOID m_pMiniDumpData;          // Minidump inflated from ZIP
+    size_t m_uMiniDumpSize;          // Size of minidump data in bytes
+    HANDLE m_hMiniDumpMapping;       // Temporary file mapping holding the minidump, or NULL
     CString m_sSymSearchPath;        // Symbol files search path
     std::vector<CString> m_ContainedFiles;
 };
 
 // The list of opened handles
 std::map<int, CrpReportData> g_OpenedHandles;
+int g_nNextHandle = 1; // The value of the next handle to be opened
+CComAutoCriticalSection g_crp_handles_cs; // Protects the list of opened handles
+
+// Cache of resolved symbols shared by all opened reports. It is opened and
+// closed by crpOpenSymbolCache() and crpCloseSymbolCache() when no reports are processed.
+CSymbolCache g_SymCache;
+BOOL g_bSymCacheOpened = FALSE;
+
+// FindReportData
+// Looks up the report data by handle. Returns NULL if the handle is invalid.
+// Reports may be opened and closed by other threads concurrently.
+CrpReportData* FindReportData(CrpHandle hReport)
+{
+    CComCritSecLock<CComAutoCriticalSection> lock(g_crp_handles_cs);
+
+    std::map<int, CrpReportData>::iterator it = g_OpenedHandles.find(hReport);
+    if(it==g_OpenedHandles.end())
+        return NULL;
+
+    // Map nodes are not moved on insertion/removal of other elements, so 
+    // the pointer stays valid until this handle is closed.
+    return &it->second;
+}
 
 
-// CalcFileMD5Hash
-// Calculates the MD5 hash for the given file
-int CalcFileMD5Hash(CString sFileName, CString& sMD5Hash)
+// CalcFileHash
+// Calculates the MD5 hash or the SHA-256 hash for the given file
+int CalcFileHash(CString sFileName, bool bSHA256, CString& sHash)
 {  
     crpSetErrorMsg(_T("Unspecified error."));
 
-    BYTE buff[512];
-    MD5 md5;
-    MD5_CTX md5_ctx;
-    unsigned char md5_hash[16];
+    CReportDigest digest;
     FILE* f = NULL;
+    strconv_t strconv;
 
 #if _MSC_VER<1400
     f = _tfopen(sFileName, _T("rb"));
@@ -94,27 +122,17 @@ int CalcFileMD5Hash(CString sFileName, CString& sMD5Hash)
         return -1; // Couldn't open ZIP file
     }
 
-    md5.MD5Init(&md5_ctx);
+    // Read the file in large blocks
+    bool bHashed = digest.HashFile(f, bSHA256);
+    fclose(f);
 
-    while(!feof(f))
+    if(!bHashed)
     {
-        size_t count = fread(buff, 1, 512, f);
-        if(count>0)
-        {
-            md5.MD5Update(&md5_ctx, buff, (unsigned int)count);
-        }
+        crpSetErrorMsg(_T("Couldn't read ZIP file."));
+        return -1;
     }
 
-    fclose(f);
-    md5.MD5Final(md5_hash, &md5_ctx);
-
-    int i;
-    for(i=0; i<16; i++)
-    {
-        CString number;
-        number.Format(_T("%02x"), md5_hash[i]);
-        sMD5Hash += number;
-    } 
+    sHash = strconv.a2t(bSHA256 ? digest.GetSHA256Hash().c_str() : digest.GetMD5Hash().c_str());
 
     crpSetErrorMsg(_T("Success."));
     return 0;
@@ -174,6 +192,155 @@ cleanup:
     return status;
 }
 
+// Minidumps larger than this are inflated into a temporary file mapping. Batch
+// processing opens reports from many threads, and anonymous memory of several
+// multi-GB dumps could exhaust the commit limit.
+#define CRP_MAX_MEMORY_DUMP_SIZE (256*1024*1024)
+
+// CreateTempFileMapping
+// Creates a temporary file of the given size and maps it into memory. The file
+// is deleted when the mapping is closed. Returns the mapping handle or NULL.
+HANDLE CreateTempFileMapping(size_t uSize, LPVOID* ppView)
+{
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMapping = NULL;
+    ULARGE_INTEGER uliSize;
+
+    *ppView = NULL;
+
+    // Dirty pages are written to the file, not to the pagefile; the temporary
+    // attribute lets them stay in the cache while there is enough memory.
+    CString sTempFile = Utility::getTempFileName();
+    hFile = CreateFile(sTempFile, GENERIC_READ|GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_TEMPORARY|FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if(hFile==INVALID_HANDLE_VALUE)
+        goto cleanup;
+
+    // One extra byte avoids an empty mapping, which can't be created
+    uliSize.QuadPart = (ULONGLONG)uSize+1;
+    hMapping = CreateFileMapping(hFile, NULL, PAGE_READWRITE, uliSize.HighPart, uliSize.LowPart, NULL);
+    if(hMapping==NULL)
+        goto cleanup;
+
+    *ppView = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, 0);
+    if(*ppView==NULL)
+    {
+        CloseHandle(hMapping);
+        hMapping = NULL;
+    }
+
+cleanup:
+
+    // The mapping keeps the file open until it is closed
+    if(hFile!=INVALID_HANDLE_VALUE)
+        CloseHandle(hFile);
+
+    return hMapping;
+}
+
+// FreeUnzippedData
+// Frees the data returned by UnzipFileToMemory()
+void FreeUnzippedData(LPVOID pData, HANDLE hMapping)
+{
+    if(hMapping!=NULL)
+    {
+        if(pData!=NULL)
+            UnmapViewOfFile(pData);
+        CloseHandle(hMapping);
+    }
+    else if(pData!=NULL)
+        VirtualFree(pData, 0, MEM_RELEASE);
+}
+
+// UnzipFileToMemory
+// Inflates a ZIP item into a newly allocated memory region. If phMapping is not
+// NULL, items larger than uMaxMemorySize are inflated into a temporary file
+// mapping returned in *phMapping. The data must be freed with FreeUnzippedData().
+int UnzipFileToMemory(unzFile hZip, const char* szFileName, LPVOID* ppData, size_t* puSize,
+                      size_t uMaxMemorySize, HANDLE* phMapping)
+{
+    int status = -1;
+    int zr = 0;
+    int open_file_res = UNZ_END_OF_LIST_OF_FILE;
+    unz_file_info64 fi;
+    LPBYTE pData = NULL;
+    HANDLE hMapping = NULL;
+    size_t uSize = 0;
+    size_t uRead = 0;
+
+    *ppData = NULL;
+    *puSize = 0;
+    if(phMapping!=NULL)
+        *phMapping = NULL;
+
+    zr = unzLocateFile(hZip, szFileName, 1);
+    if(zr!=UNZ_OK)
+        return -1;
+
+    zr = unzGetCurrentFileInfo64(hZip, &fi, NULL, 0, NULL, 0, NULL, 0);
+    if(zr!=UNZ_OK)
+        goto cleanup;
+
+    // ZIP64 items may be larger than the address space of a 32-bit process
+    if(fi.uncompressed_size>=(ZPOS64_T)(size_t)-1)
+        goto cleanup;
+
+    // The uncompressed size is known in advance, so the item is inflated
+    // right into its final location: a temporary file mapping for large items,
+    // otherwise page-aligned anonymous memory. One extra byte is allocated to
+    // avoid zero-sized allocation.
+    uSize = (size_t)fi.uncompressed_size;
+    if(phMapping!=NULL && uSize>uMaxMemorySize)
+    {
+        hMapping = CreateTempFileMapping(uSize, (LPVOID*)&pData);
+        if(hMapping==NULL)
+            goto cleanup;
+    }
+    else
+    {
+        pData = (LPBYTE)VirtualAlloc(NULL, uSize+1, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+        if(pData==NULL)
+            goto cleanup;
+    }
+
+    open_file_res = unzOpenCurrentFile(hZip);
+    if(open_file_res!=UNZ_OK)
+        goto cleanup;
+
+    while(uRead<uSize)
+    {
+        unsigned uChunk = (unsigned)min(uSize-uRead, (size_t)0x10000000);
+        int read_len = unzReadCurrentFile(hZip, pData+uRead, uChunk);
+        if(read_len<=0)
+            goto cleanup; // Truncated or corrupted item
+
+        uRead += read_len;
+    }
+
+    // Closing the item verifies CRC when all data has been read
+    zr = unzCloseCurrentFile(hZip);
+    open_file_res = UNZ_END_OF_LIST_OF_FILE;
+    if(zr!=UNZ_OK)
+        goto cleanup;
+
+    *ppData = pData;
+    *puSize = uSize;
+    if(phMapping!=NULL)
+        *phMapping = hMapping;
+    pData = NULL;
+    hMapping = NULL;
+    status = 0;
+
+cleanup:
+
+    if(open_file_res==UNZ_OK)
+        unzCloseCurrentFile(hZip);
+
+    FreeUnzippedData(pData, hMapping);
+
+    return status;
+}
+
 CRASHRPTPROBE_API(int)
 crpOpenErrorReportW(
                     LPCWSTR pszFileName,
@@ -182,8 +349,6 @@ crpOpenErrorReportW(
                     DWORD dwFlags,
                     CrpHandle* pHandle)
 {   
-    UNREFERENCED_PARAMETER(dwFlags);
-
     int status = -1;
     int nNewHandle = 0;
     CrpReportData report_data;  
@@ -193,7 +358,7 @@ crpOpenErrorReportW(
     char szXmlFileName[1024]="";
     char szDmpFileName[1024]="";
     char szFileName[1024]="";
-    CString sCalculatedMD5Hash;
+    CString sCalculatedHash;
     CString sAppName;
     strconv_t strconv;
 
@@ -203,6 +368,8 @@ crpOpenErrorReportW(
     report_data.m_sSymSearchPath = pszSymSearchPath;
     report_data.m_pDescReader = new CCrashDescReader;
     report_data.m_pDmpReader = new CMiniDumpReader;
+    if(g_bSymCacheOpened)
+        report_data.m_pDmpReader->SetSymbolCache(&g_SymCache);
 
     // Check dbghelp.dll version
     if(!report_data.m_pDmpReader->CheckDbgHelpApiVersion())
@@ -214,19 +381,26 @@ crpOpenErrorReportW(
     // Check ZIP integrity
     if(pszMd5Hash!=NULL)
     {
-        int result = CalcFileMD5Hash(pszFileName, sCalculatedMD5Hash);
+        // Either MD5 hash or SHA-256 hash (64 hex digits) may be given
+        CString sExpectedHash = pszMd5Hash;
+        sExpectedHash.Trim();
+        bool bSHA256 = sExpectedHash.GetLength()==REPORT_DIGEST_SHA256_LEN;
+
+        int result = CalcFileHash(pszFileName, bSHA256, sCalculatedHash);
         if(result!=0)
             goto exit;
 
-        if(sCalculatedMD5Hash.CompareNoCase(pszMd5Hash)!=0)
+        if(sCalculatedHash.CompareNoCase(sExpectedHash)!=0)
         {  
-            crpSetErrorMsg(_T("File might be corrupted, because MD5 hash is wrong."));
+            crpSetErrorMsg(bSHA256 ? _T("File might be corrupted, because SHA-256 hash is wrong.") :
+                _T("File might be corrupted, because MD5 hash is wrong."));
             goto exit; // Invalid hash
         }
     }
 
-    // Open ZIP archive
-    report_data.m_hZip = unzOpen((const char*)pszFileName);
+    // Open ZIP archive. The 64-bit file functions take a wide file name and
+    // read archives with ZIP64 extensions (reports larger than 4 GB).
+    report_data.m_hZip = unzOpen64(pszFileName);
     if(report_data.m_hZip==NULL)
     {
         crpSetErrorMsg(_T("Error opening ZIP archive."));
@@ -291,17 +465,17 @@ crpOpenErrorReportW(
     // Load crash description data
     if(xml_find_res==UNZ_OK)
     {
-        CString sTempFile = Utility::getTempFileName();
-        zr = UnzipFile(report_data.m_hZip, szXmlFileName, sTempFile);
+        LPVOID pXmlData = NULL;
+        size_t uXmlSize = 0;
+        zr = UnzipFileToMemory(report_data.m_hZip, szXmlFileName, &pXmlData, &uXmlSize, 0, NULL);
         if(zr!=0)
         {
             crpSetErrorMsg(_T("Error extracting ZIP item."));
-            Utility::RecycleFile(sTempFile, TRUE);
             goto exit; // Can't unzip ZIP element
         }
 
-        int result = report_data.m_pDescReader->Load(sTempFile);    
-        DeleteFile(sTempFile);
+        int result = report_data.m_pDescReader->Load((const char*)pXmlData, uXmlSize);    
+        FreeUnzippedData(pXmlData, NULL);
         if(result!=0)
         {
             crpSetErrorMsg(_T("Crash description file is not a valid XML file."));
@@ -309,19 +483,19 @@ crpOpenErrorReportW(
         }    
     }  
 
-    // Extract minidump file
+    // Extract minidump file. It is kept in memory (or in a temporary file mapping,
+    // if it is large) until the report is closed.
     if(dmp_find_res==UNZ_OK)
     {
-        CString sTempFile = Utility::getTempFileName();
-        zr = UnzipFile(report_data.m_hZip, szDmpFileName, sTempFile);
+        size_t uMaxMemorySize = (dwFlags&CRP_OPEN_DUMP_TO_TEMP_FILE)?0:CRP_MAX_MEMORY_DUMP_SIZE;
+        zr = UnzipFileToMemory(report_data.m_hZip, szDmpFileName, 
+            &report_data.m_pMiniDumpData, &report_data.m_uMiniDumpSize, 
+            uMaxMemorySize, &report_data.m_hMiniDumpMapping);
         if(zr!=0)
         {
-            Utility::RecycleFile(sTempFile, TRUE);
             crpSetErrorMsg(_T("Error extracting ZIP item."));
             goto exit; // Can't unzip ZIP element
         }
-
-        report_data.m_sMiniDumpTempName = sTempFile;
     } 
 
     if(report_data.m_pDescReader->m_dwGeneratorVersion==1000)
@@ -335,12 +509,11 @@ crpOpenErrorReportW(
             report_data.m_pDescReader->m_sImageName.IsEmpty())
         {
             // Load minidump right now
-            int nLoad = report_data.m_pDmpReader->Open(report_data.m_sMiniDumpTempName, 
-                report_data.m_sSymSearchPath);
+            int nLoad = report_data.m_pDmpReader->Open(report_data.m_pMiniDumpData, 
+                report_data.m_uMiniDumpSize, report_data.m_sSymSearchPath);
             if(nLoad!=0)
             {
                 crpSetErrorMsg(_T("Error opening minidump file."));
-                Utility::RecycleFile(report_data.m_sMiniDumpTempName, TRUE);
                 goto exit; 
             }
 
@@ -407,8 +580,10 @@ crpOpenErrorReportW(
     }
 
     // Add handle to the list of opened handles
-    nNewHandle = (int)g_OpenedHandles.size()+1;
+    g_crp_handles_cs.Lock();
+    nNewHandle = g_nNextHandle++;
     g_OpenedHandles[nNewHandle] = report_data;
+    g_crp_handles_cs.Unlock();
     *pHandle = nNewHandle;
 
     crpSetErrorMsg(_T("Success."));
@@ -420,7 +595,7 @@ exit:
     {
         delete report_data.m_pDescReader;
         delete report_data.m_pDmpReader;
-        Utility::RecycleFile(report_data.m_sMiniDumpTempName, TRUE);
+        FreeUnzippedData(report_data.m_pMiniDumpData, report_data.m_hMiniDumpMapping);
 
         if(report_data.m_hZip!=0) 
             unzClose(report_data.m_hZip);
@@ -453,320 +628,763 @@ crpCloseErrorReport(
 {
     crpSetErrorMsg(_T("Unspecified error."));
 
-    // Look for such handle
+    // Look for such handle and remove it from the list of opened handles
+    CrpReportData report_data;
+    g_crp_handles_cs.Lock();
     std::map<int, CrpReportData>::iterator it = g_OpenedHandles.find(handle);
-    if(it==g_OpenedHandles.end())
+    if(it!=g_OpenedHandles.end())
+    {
+        report_data = it->second;
+        g_OpenedHandles.erase(it);
+    }
+    g_crp_handles_cs.Unlock();
+
+    if(report_data.m_pDescReader==NULL)
     {
         crpSetErrorMsg(_T("Invalid handle specified."));
         return 1;
     }
 
-    delete it->second.m_pDescReader;
-    delete it->second.m_pDmpReader;
-    Utility::RecycleFile(it->second.m_sMiniDumpTempName, TRUE);
-
-    if(it->second.m_hZip)
-        unzClose(it->second.m_hZip);
+    delete report_data.m_pDescReader;
+    delete report_data.m_pDmpReader; // Unmaps minidump data, so it can be freed now
+    FreeUnzippedData(report_data.m_pMiniDumpData, report_data.m_hMiniDumpMapping);
 
-    // Remove from the list of opened handles
-    g_OpenedHandles.erase(it);
+    if(report_data.m_hZip)
+        unzClose(report_data.m_hZip);
 
     // OK.
     crpSetErrorMsg(_T("Success."));
     return 0;
 }
 
-int ParseDynTableId(CString sTableId, int& index)
+// Table IDs are interned into these integers by crpGetPropertyId()
+enum CrpTableId
 {
-    if(sTableId.Left(5)=="STACK")
-    {
-        CString sIndex = sTableId.Mid(5);
-        index = _ttoi(sIndex.GetBuffer(0));
-        return 0;
-    }
+    CRP_TID_UNKNOWN = 0,
+    CRP_TID_XMLDESC_MISC,
+    CRP_TID_XMLDESC_FILE_ITEMS,
+    CRP_TID_XMLDESC_CUSTOM_PROPS,
+    CRP_TID_XMLDESC_BREADCRUMBS,
+    CRP_TID_MDMP_MISC,
+    CRP_TID_MDMP_MODULES,
+    CRP_TID_MDMP_THREADS,
+    CRP_TID_MDMP_LOAD_LOG,
+    CRP_TID_MDMP_BUCKET,
+    CRP_TID_STACK = 0x10000 // STACK<n> table has ID CRP_TID_STACK+n
+};
 
-    return -1;
-}
+// Column IDs are interned into these integers by crpGetPropertyId()
+enum CrpColumnId
+{
+    CRP_CID_UNKNOWN = 0,
+    CRP_CID_ROW_COUNT,
+    CRP_CID_CRASHRPT_VERSION,
+    CRP_CID_CRASH_GUID,
+    CRP_CID_APP_NAME,
+    CRP_CID_APP_VERSION,
+    CRP_CID_IMAGE_NAME,
+    CRP_CID_OPERATING_SYSTEM,
+    CRP_CID_SYSTEM_TIME_UTC,
+    CRP_CID_EXCEPTION_TYPE,
+    CRP_CID_EXCEPTION_CODE,
+    CRP_CID_INVPARAM_FUNCTION,
+    CRP_CID_INVPARAM_EXPRESSION,
+    CRP_CID_INVPARAM_FILE,
+    CRP_CID_INVPARAM_LINE,
+    CRP_CID_FPE_SUBCODE,
+    CRP_CID_USER_EMAIL,
+    CRP_CID_PROBLEM_DESCRIPTION,
+    CRP_CID_MEMORY_USAGE_KBYTES,
+    CRP_CID_GUI_RESOURCE_COUNT,
+    CRP_CID_OPEN_HANDLE_COUNT,
+    CRP_CID_OS_IS_64BIT,
+    CRP_CID_GEO_LOCATION,
+    CRP_CID_FILE_ITEM_NAME,
+    CRP_CID_FILE_ITEM_DESCRIPTION,
+    CRP_CID_PROPERTY_NAME,
+    CRP_CID_PROPERTY_VALUE,
+    CRP_CID_CPU_ARCHITECTURE,
+    CRP_CID_CPU_COUNT,
+    CRP_CID_PRODUCT_TYPE,
+    CRP_CID_OS_VER_MAJOR,
+    CRP_CID_OS_VER_MINOR,
+    CRP_CID_OS_VER_BUILD,
+    CRP_CID_OS_VER_CSD,
+    CRP_CID_EXCPTRS_EXCEPTION_CODE,
+    CRP_CID_EXCEPTION_ADDRESS,
+    CRP_CID_EXCEPTION_THREAD_ROWID,
+    CRP_CID_EXCEPTION_THREAD_STACK_MD5,
+    CRP_CID_EXCEPTION_MODULE_ROWID,
+    CRP_CID_MODULE_NAME,
+    CRP_CID_MODULE_IMAGE_NAME,
+    CRP_CID_MODULE_BASE_ADDRESS,
+    CRP_CID_MODULE_SIZE,
+    CRP_CID_MODULE_LOADED_PDB_NAME,
+    CRP_CID_MODULE_LOADED_IMAGE_NAME,
+    CRP_CID_MODULE_SYM_LOAD_STATUS,
+    CRP_CID_THREAD_ID,
+    CRP_CID_THREAD_STACK_TABLEID,
+    CRP_CID_STACK_MODULE_ROWID,
+    CRP_CID_STACK_SYMBOL_NAME,
+    CRP_CID_STACK_OFFSET_IN_SYMBOL,
+    CRP_CID_STACK_SOURCE_FILE,
+    CRP_CID_STACK_SOURCE_LINE,
+    CRP_CID_STACK_ADDR_PC_OFFSET,
+    CRP_CID_LOAD_LOG_ENTRY,
+    CRP_CID_BUCKET_ID,
+    CRP_CID_BUCKET_SIGNATURE,
+    CRP_CID_BUCKET_FRAME_COUNT,
+    CRP_CID_BREADCRUMB_TIME,
+    CRP_CID_BREADCRUMB_THREAD_ID,
+    CRP_CID_BREADCRUMB_CATEGORY,
+    CRP_CID_BREADCRUMB_MESSAGE
+};
 
-CRASHRPTPROBE_API(int)
-crpGetPropertyW(
-                CrpHandle hReport,
-                LPCWSTR lpszTableId, 
-                LPCWSTR lpszColumnId,
-                INT nRowIndex,
-                LPWSTR lpszBuffer,
-                ULONG cchBuffSize,
-                PULONG pcchCount)
+// Table or column name and its interned ID
+struct CrpPropName
 {
-    crpSetErrorMsg(_T("Unspecified error."));
+    LPCTSTR m_szName;
+    int m_nId;
+};
 
-    // Set default output values
-    if(lpszBuffer!=NULL && cchBuffSize>=1)
-        lpszBuffer[0] = 0; // Empty buffer
-    if(pcchCount!=NULL)
-        *pcchCount = 0;  
+CrpPropName g_TableNames[] =
+{
+    {CRP_TBL_XMLDESC_MISC, CRP_TID_XMLDESC_MISC},
+    {CRP_TBL_XMLDESC_FILE_ITEMS, CRP_TID_XMLDESC_FILE_ITEMS},
+    {CRP_TBL_XMLDESC_CUSTOM_PROPS, CRP_TID_XMLDESC_CUSTOM_PROPS},
+    {CRP_TBL_XMLDESC_BREADCRUMBS, CRP_TID_XMLDESC_BREADCRUMBS},
+    {CRP_TBL_MDMP_MISC, CRP_TID_MDMP_MISC},
+    {CRP_TBL_MDMP_MODULES, CRP_TID_MDMP_MODULES},
+    {CRP_TBL_MDMP_THREADS, CRP_TID_MDMP_THREADS},
+    {CRP_TBL_MDMP_LOAD_LOG, CRP_TID_MDMP_LOAD_LOG},
+    {CRP_TBL_MDMP_BUCKET, CRP_TID_MDMP_BUCKET}
+};
 
-    LPCWSTR pszPropVal = NULL;
-    const int BUFF_SIZE = 4096; 
-    TCHAR szBuff[BUFF_SIZE]; // Internal buffer to store property value
-    strconv_t strconv; // String convertor object
+CrpPropName g_ColumnNames[] =
+{
+    {CRP_META_ROW_COUNT, CRP_CID_ROW_COUNT},
+    {CRP_COL_CRASHRPT_VERSION, CRP_CID_CRASHRPT_VERSION},
+    {CRP_COL_CRASH_GUID, CRP_CID_CRASH_GUID},
+    {CRP_COL_APP_NAME, CRP_CID_APP_NAME},
+    {CRP_COL_APP_VERSION, CRP_CID_APP_VERSION},
+    {CRP_COL_IMAGE_NAME, CRP_CID_IMAGE_NAME},
+    {CRP_COL_OPERATING_SYSTEM, CRP_CID_OPERATING_SYSTEM},
+    {CRP_COL_SYSTEM_TIME_UTC, CRP_CID_SYSTEM_TIME_UTC},
+    {CRP_COL_EXCEPTION_TYPE, CRP_CID_EXCEPTION_TYPE},
+    {CRP_COL_EXCEPTION_CODE, CRP_CID_EXCEPTION_CODE},
+    {CRP_COL_INVPARAM_FUNCTION, CRP_CID_INVPARAM_FUNCTION},
+    {CRP_COL_INVPARAM_EXPRESSION, CRP_CID_INVPARAM_EXPRESSION},
+    {CRP_COL_INVPARAM_FILE, CRP_CID_INVPARAM_FILE},
+    {CRP_COL_INVPARAM_LINE, CRP_CID_INVPARAM_LINE},
+    {CRP_COL_FPE_SUBCODE, CRP_CID_FPE_SUBCODE},
+    {CRP_COL_USER_EMAIL, CRP_CID_USER_EMAIL},
+    {CRP_COL_PROBLEM_DESCRIPTION, CRP_CID_PROBLEM_DESCRIPTION},
+    {CRP_COL_MEMORY_USAGE_KBYTES, CRP_CID_MEMORY_USAGE_KBYTES},
+    {CRP_COL_GUI_RESOURCE_COUNT, CRP_CID_GUI_RESOURCE_COUNT},
+    {CRP_COL_OPEN_HANDLE_COUNT, CRP_CID_OPEN_HANDLE_COUNT},
+    {CRP_COL_OS_IS_64BIT, CRP_CID_OS_IS_64BIT},
+    {CRP_COL_GEO_LOCATION, CRP_CID_GEO_LOCATION},
+    {CRP_COL_FILE_ITEM_NAME, CRP_CID_FILE_ITEM_NAME},
+    {CRP_COL_FILE_ITEM_DESCRIPTION, CRP_CID_FILE_ITEM_DESCRIPTION},
+    {CRP_COL_PROPERTY_NAME, CRP_CID_PROPERTY_NAME},
+    {CRP_COL_PROPERTY_VALUE, CRP_CID_PROPERTY_VALUE},
+    {CRP_COL_CPU_ARCHITECTURE, CRP_CID_CPU_ARCHITECTURE},
+    {CRP_COL_CPU_COUNT, CRP_CID_CPU_COUNT},
+    {CRP_COL_PRODUCT_TYPE, CRP_CID_PRODUCT_TYPE},
+    {CRP_COL_OS_VER_MAJOR, CRP_CID_OS_VER_MAJOR},
+    {CRP_COL_OS_VER_MINOR, CRP_CID_OS_VER_MINOR},
+    {CRP_COL_OS_VER_BUILD, CRP_CID_OS_VER_BUILD},
+    {CRP_COL_OS_VER_CSD, CRP_CID_OS_VER_CSD},
+    {CRP_COL_EXCPTRS_EXCEPTION_CODE, CRP_CID_EXCPTRS_EXCEPTION_CODE},
+    {CRP_COL_EXCEPTION_ADDRESS, CRP_CID_EXCEPTION_ADDRESS},
+    {CRP_COL_EXCEPTION_THREAD_ROWID, CRP_CID_EXCEPTION_THREAD_ROWID},
+    {CRP_COL_EXCEPTION_THREAD_STACK_MD5, CRP_CID_EXCEPTION_THREAD_STACK_MD5},
+    {CRP_COL_EXCEPTION_MODULE_ROWID, CRP_CID_EXCEPTION_MODULE_ROWID},
+    {CRP_COL_MODULE_NAME, CRP_CID_MODULE_NAME},
+    {CRP_COL_MODULE_IMAGE_NAME, CRP_CID_MODULE_IMAGE_NAME},
+    {CRP_COL_MODULE_BASE_ADDRESS, CRP_CID_MODULE_BASE_ADDRESS},
+    {CRP_COL_MODULE_SIZE, CRP_CID_MODULE_SIZE},
+    {CRP_COL_MODULE_LOADED_PDB_NAME, CRP_CID_MODULE_LOADED_PDB_NAME},
+    {CRP_COL_MODULE_LOADED_IMAGE_NAME, CRP_CID_MODULE_LOADED_IMAGE_NAME},
+    {CRP_COL_MODULE_SYM_LOAD_STATUS, CRP_CID_MODULE_SYM_LOAD_STATUS},
+    {CRP_COL_THREAD_ID, CRP_CID_THREAD_ID},
+    {CRP_COL_THREAD_STACK_TABLEID, CRP_CID_THREAD_STACK_TABLEID},
+    {CRP_COL_STACK_MODULE_ROWID, CRP_CID_STACK_MODULE_ROWID},
+    {CRP_COL_STACK_SYMBOL_NAME, CRP_CID_STACK_SYMBOL_NAME},
+    {CRP_COL_STACK_OFFSET_IN_SYMBOL, CRP_CID_STACK_OFFSET_IN_SYMBOL},
+    {CRP_COL_STACK_SOURCE_FILE, CRP_CID_STACK_SOURCE_FILE},
+    {CRP_COL_STACK_SOURCE_LINE, CRP_CID_STACK_SOURCE_LINE},
+    {CRP_COL_STACK_ADDR_PC_OFFSET, CRP_CID_STACK_ADDR_PC_OFFSET},
+    {CRP_COL_LOAD_LOG_ENTRY, CRP_CID_LOAD_LOG_ENTRY},
+    {CRP_COL_BUCKET_ID, CRP_CID_BUCKET_ID},
+    {CRP_COL_BUCKET_SIGNATURE, CRP_CID_BUCKET_SIGNATURE},
+    {CRP_COL_BUCKET_FRAME_COUNT, CRP_CID_BUCKET_FRAME_COUNT},
+    {CRP_COL_BREADCRUMB_TIME, CRP_CID_BREADCRUMB_TIME},
+    {CRP_COL_BREADCRUMB_THREAD_ID, CRP_CID_BREADCRUMB_THREAD_ID},
+    {CRP_COL_BREADCRUMB_CATEGORY, CRP_CID_BREADCRUMB_CATEGORY},
+    {CRP_COL_BREADCRUMB_MESSAGE, CRP_CID_BREADCRUMB_MESSAGE}
+};
 
-    // Validate input parameters
-    if( lpszTableId==NULL ||
-        lpszColumnId==NULL ||
-        nRowIndex<0 || // Check we have non-negative row index
-        (lpszBuffer==NULL && cchBuffSize!=0) || // Check that we have a valid buffer
-        (lpszBuffer!=NULL && cchBuffSize==0)
-        )
+// CPropNameIndex
+// Maps table and column names to their interned IDs. The index is filled
+// when the DLL is loaded and is read-only after that, so no locking is needed.
+class CPropNameIndex
+{
+public:
+
+    CPropNameIndex()
     {
-        crpSetErrorMsg(_T("Invalid argument specified."));
-        return -1;
+        int i;
+        for(i=0; i<(int)(sizeof(g_TableNames)/sizeof(g_TableNames[0])); i++)
+            m_Tables[g_TableNames[i].m_szName] = g_TableNames[i].m_nId;
+        for(i=0; i<(int)(sizeof(g_ColumnNames)/sizeof(g_ColumnNames[0])); i++)
+            m_Columns[g_ColumnNames[i].m_szName] = g_ColumnNames[i].m_nId;
     }
 
-    std::map<int, CrpReportData>::iterator it = g_OpenedHandles.find(hReport);
-    if(it==g_OpenedHandles.end())
+    // Returns table ID or CRP_TID_UNKNOWN
+    int FindTable(LPCWSTR pszTableId) const
     {
-        crpSetErrorMsg(_T("Invalid handle specified."));
-        return -1;
+        // Stack trace tables are named STACK<n>, where n is the thread's ROWID
+        if(wcsncmp(pszTableId, L"STACK", 5)==0)
+        {
+            int nIndex = _wtoi(pszTableId+5);
+            if(nIndex<0 || nIndex>=0x7FFFFFFF-CRP_TID_STACK)
+                return CRP_TID_UNKNOWN;
+            return CRP_TID_STACK+nIndex;
+        }
+
+        std::map<CString, int>::const_iterator it = m_Tables.find(CString(pszTableId));
+        return it!=m_Tables.end()?it->second:CRP_TID_UNKNOWN;
+    }
+
+    // Returns column ID or CRP_CID_UNKNOWN
+    int FindColumn(LPCWSTR pszColumnId) const
+    {
+        std::map<CString, int>::const_iterator it = m_Columns.find(CString(pszColumnId));
+        return it!=m_Columns.end()?it->second:CRP_CID_UNKNOWN;
+    }
+
+private:
+
+    std::map<CString, int> m_Tables;  // <table_name, table_id> pairs
+    std::map<CString, int> m_Columns; // <column_name, column_id> pairs
+};
+
+CPropNameIndex g_PropNameIndex;
+
+// How an integer property is converted to text
+enum CrpValueFormat
+{
+    CRP_FMT_UDEC,           // Unsigned decimal
+    CRP_FMT_DEC,            // Signed decimal
+    CRP_FMT_HEX,            // 0x-prefixed hexadecimal
+    CRP_FMT_HEX_NOPREFIX,   // Hexadecimal without prefix
+    CRP_FMT_STACK_TABLEID   // ID of stack trace table (STACK<n>)
+};
+
+// Typed property value returned by GetPropertyValue()
+struct CrpPropValue
+{
+    CrpPropValue()
+    {
+        m_nType = CRP_VALUE_STRING;
+        m_nValue = 0;
+        m_pszValue = L"";
+        m_nFormat = CRP_FMT_UDEC;
+        m_pszSuffix = NULL;
+        m_bFormatMsg = FALSE;
     }
 
-    CCrashDescReader* pDescReader = it->second.m_pDescReader;
-    CMiniDumpReader* pDmpReader = it->second.m_pDmpReader;
+    int m_nType;          // CRP_VALUE_INT or CRP_VALUE_STRING
+    LONGLONG m_nValue;    // Integer value
+    LPCWSTR m_pszValue;   // String value; points into report data (the library is built with UNICODE)
+    int m_nFormat;        // Text format of integer value
+    LPCTSTR m_pszSuffix;  // Description appended to the text of integer value, or NULL
+    BOOL m_bFormatMsg;    // Append system error message for the integer value to its text?
+};
+
+// Sets integer value of the property
+void SetIntValue(CrpPropValue& val, LONGLONG nValue, int nFormat=CRP_FMT_UDEC, LPCTSTR pszSuffix=NULL)
+{
+    val.m_nType = CRP_VALUE_INT;
+    val.m_nValue = nValue;
+    val.m_nFormat = nFormat;
+    val.m_pszSuffix = pszSuffix;
+}
+
+// Sets string value of the property
+void SetStringValue(CrpPropValue& val, LPCWSTR pszValue)
+{
+    val.m_nType = CRP_VALUE_STRING;
+    val.m_pszValue = pszValue;
+}
+
+// GetPropertyValue
+// Looks up a property by interned table and column IDs. Integer properties are
+// not converted to text here; use FormatPropertyValue() for that. Returns zero or
+// (for CRP_CID_ROW_COUNT) the number of rows on success, negative value on error.
+int GetPropertyValue(CrpReportData* pReportData, int nTableId, int nColumnId,
+                     int nRowIndex, CrpPropValue& val)
+{
+    CCrashDescReader* pDescReader = pReportData->m_pDescReader;
+    CMiniDumpReader* pDmpReader = pReportData->m_pDmpReader;
+    int nStackThread = nTableId>=CRP_TID_STACK?nTableId-CRP_TID_STACK:-1;
 
-    CString sTableId = lpszTableId;
-    CString sColumnId = lpszColumnId;
-    int nDynTableIndex = -1;
-    // nDynTable will be equal to 0 if a stack trace table is queired
-    int nDynTable = ParseDynTableId(sTableId, nDynTableIndex);
+    if(nTableId==CRP_TID_UNKNOWN)
+    {
+        crpSetErrorMsg(_T("Invalid table ID specified."));
+        return -3;
+    }
 
     // Check if we need to load minidump file to be able to get the property
-    if(sTableId.Compare(CRP_TBL_MDMP_MISC)==0 ||
-        sTableId.Compare(CRP_TBL_MDMP_MODULES)==0 ||
-        sTableId.Compare(CRP_TBL_MDMP_THREADS)==0 ||
-        sTableId.Compare(CRP_TBL_MDMP_LOAD_LOG)==0 ||
-        nDynTable==0 ||
-        (pDescReader->m_dwGeneratorVersion==1000 && sTableId.Compare(CRP_TBL_XMLDESC_MISC)==0) )
-    {     
+    if(nTableId==CRP_TID_MDMP_MISC ||
+        nTableId==CRP_TID_MDMP_MODULES ||
+        nTableId==CRP_TID_MDMP_THREADS ||
+        nTableId==CRP_TID_MDMP_LOAD_LOG ||
+        nTableId==CRP_TID_MDMP_BUCKET ||
+        nStackThread>=0 ||
+        (pDescReader->m_dwGeneratorVersion==1000 && nTableId==CRP_TID_XMLDESC_MISC) )
+    {
         // Load the minidump
-        int nOpen = pDmpReader->Open(it->second.m_sMiniDumpTempName, it->second.m_sSymSearchPath);
+        int nOpen = pDmpReader->Open(pReportData->m_pMiniDumpData,
+            pReportData->m_uMiniDumpSize, pReportData->m_sSymSearchPath);
 		if(nOpen!=0)
         {
             crpSetErrorMsg(_T("Could not open minidump file."));
-            return -3;    
+            return -3;
         }
-		
+
         // Walk the stack if this is needed to get the property
-        if(nDynTable==0)
+        if(nStackThread>=0)
         {
-            pDmpReader->StackWalk(pDmpReader->m_DumpData.m_Threads[nDynTableIndex].m_dwThreadId);
-        }   
-    }  
+            if(nStackThread>=(int)pDmpReader->m_DumpData.m_Threads.size())
+            {
+                crpSetErrorMsg(_T("Invalid table ID specified."));
+                return -3;
+            }
 
-    if(sTableId.Compare(CRP_TBL_XMLDESC_MISC)==0)
+            pDmpReader->StackWalk(pDmpReader->m_DumpData.m_Threads[nStackThread].m_dwThreadId);
+        }
+    }
+
+    if(nTableId==CRP_TID_XMLDESC_MISC)
     {
         // This table contains single row.
         if(nRowIndex!=0)
         {
             crpSetErrorMsg(_T("Invalid row index specified."));
-            return -4;    
+            return -4;
         }
 
-        if(sColumnId.Compare(CRP_META_ROW_COUNT)==0)
-        {    
-            return 1; // return row count in this table
-        }  
-        else if(sColumnId.Compare(CRP_COL_CRASHRPT_VERSION)==0)
-        {    
-            _ULTOT_S(pDescReader->m_dwGeneratorVersion, szBuff, BUFF_SIZE, 10);
-            pszPropVal = szBuff;
-        }  
-        else if(sColumnId.Compare(CRP_COL_CRASH_GUID)==0)
-        { 
-            // We do not support crash GUIDs for older version of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion==1000)
+        // Some columns are not supported for older versions of CrashRpt
+        DWORD dwMinVersion = 0;
+        switch(nColumnId)
+        {
+        case CRP_CID_CRASH_GUID:
+        case CRP_CID_OPERATING_SYSTEM:
+        case CRP_CID_SYSTEM_TIME_UTC:
+        case CRP_CID_EXCEPTION_TYPE:
+        case CRP_CID_EXCEPTION_CODE:
+        case CRP_CID_FPE_SUBCODE:
+        case CRP_CID_USER_EMAIL:
+        case CRP_CID_PROBLEM_DESCRIPTION:
+            dwMinVersion = 1001;
+            break;
+        case CRP_CID_GUI_RESOURCE_COUNT:
+        case CRP_CID_OPEN_HANDLE_COUNT:
+        case CRP_CID_MEMORY_USAGE_KBYTES:
+            dwMinVersion = 1201;
+            break;
+        case CRP_CID_OS_IS_64BIT:
+        case CRP_CID_GEO_LOCATION:
+            dwMinVersion = 1207;
+            break;
+        case CRP_CID_INVPARAM_FUNCTION:
+        case CRP_CID_INVPARAM_EXPRESSION:
+        case CRP_CID_INVPARAM_FILE:
+        case CRP_CID_INVPARAM_LINE:
+            if(pDescReader->m_dwExceptionType!=CR_CPP_INVALID_PARAMETER)
             {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
+                crpSetErrorMsg(_T("This property is supported for invalid parameter errors only."));
                 return -3;
             }
-            pszPropVal = strconv.t2w(pDescReader->m_sCrashGUID);    
+            break;
         }
-        else if(sColumnId.Compare(CRP_COL_APP_NAME)==0)
+
+        if(pDescReader->m_dwGeneratorVersion<dwMinVersion)
         {
-            pszPropVal = strconv.t2w(pDescReader->m_sAppName);    
+            crpSetErrorMsg(_T("Invalid column ID is specified."));
+            return -3;
         }
-        else if(sColumnId.Compare(CRP_COL_APP_VERSION)==0)
-        {      
-            pszPropVal = strconv.t2w(pDescReader->m_sAppVersion);    
+
+        switch(nColumnId)
+        {
+        case CRP_CID_ROW_COUNT:
+            return 1; // return row count in this table
+        case CRP_CID_CRASHRPT_VERSION:
+            SetIntValue(val, pDescReader->m_dwGeneratorVersion);
+            break;
+        case CRP_CID_CRASH_GUID:
+            SetStringValue(val, pDescReader->m_sCrashGUID);
+            break;
+        case CRP_CID_APP_NAME:
+            SetStringValue(val, pDescReader->m_sAppName);
+            break;
+        case CRP_CID_APP_VERSION:
+            SetStringValue(val, pDescReader->m_sAppVersion);
+            break;
+        case CRP_CID_IMAGE_NAME:
+            SetStringValue(val, pDescReader->m_sImageName);
+            break;
+        case CRP_CID_OPERATING_SYSTEM:
+            SetStringValue(val, pDescReader->m_sOperatingSystem);
+            break;
+        case CRP_CID_SYSTEM_TIME_UTC:
+            SetStringValue(val, pDescReader->m_sSystemTimeUTC);
+            break;
+        case CRP_CID_INVPARAM_FUNCTION:
+            SetStringValue(val, pDescReader->m_sInvParamFunction);
+            break;
+        case CRP_CID_INVPARAM_EXPRESSION:
+            SetStringValue(val, pDescReader->m_sInvParamExpression);
+            break;
+        case CRP_CID_INVPARAM_FILE:
+            SetStringValue(val, pDescReader->m_sInvParamFile);
+            break;
+        case CRP_CID_INVPARAM_LINE:
+            SetIntValue(val, pDescReader->m_dwInvParamLine);
+            break;
+        case CRP_CID_EXCEPTION_TYPE:
+            SetIntValue(val, pDescReader->m_dwExceptionType, CRP_FMT_UDEC,
+                exctypes[pDescReader->m_dwExceptionType]);
+            break;
+        case CRP_CID_EXCEPTION_CODE:
+            SetIntValue(val, pDescReader->m_dwExceptionCode, CRP_FMT_HEX_NOPREFIX);
+            val.m_bFormatMsg = TRUE;
+            break;
+        case CRP_CID_FPE_SUBCODE:
+            SetIntValue(val, pDescReader->m_dwFPESubcode);
+            break;
+        case CRP_CID_USER_EMAIL:
+            SetStringValue(val, pDescReader->m_sUserEmail);
+            break;
+        case CRP_CID_PROBLEM_DESCRIPTION:
+            SetStringValue(val, pDescReader->m_sProblemDescription);
+            break;
+        case CRP_CID_GUI_RESOURCE_COUNT:
+            SetStringValue(val, pDescReader->m_sGUIResourceCount);
+            break;
+        case CRP_CID_OPEN_HANDLE_COUNT:
+            SetStringValue(val, pDescReader->m_sOpenHandleCount);
+            break;
+        case CRP_CID_MEMORY_USAGE_KBYTES:
+            SetStringValue(val, pDescReader->m_sMemoryUsageKbytes);
+            break;
+        case CRP_CID_OS_IS_64BIT:
+            SetIntValue(val, pDescReader->m_bOSIs64Bit, CRP_FMT_DEC);
+            break;
+        case CRP_CID_GEO_LOCATION:
+            SetStringValue(val, pDescReader->m_sGeoLocation);
+            break;
+        default:
+            crpSetErrorMsg(_T("Invalid column ID specified."));
+            return -2;
         }
-        else if(sColumnId.Compare(CRP_COL_IMAGE_NAME)==0)
+    }
+    else if(nTableId==CRP_TID_XMLDESC_FILE_ITEMS)
+    {
+        int nRowCount = pDescReader->m_dwGeneratorVersion==1000?
+            (int)pReportData->m_ContainedFiles.size():(int)pDescReader->m_aFileItems.size();
+
+        if(nRowIndex>=nRowCount)
         {
-            pszPropVal = strconv.t2w(pDescReader->m_sImageName);    
+            crpSetErrorMsg(_T("Invalid row index specified."));
+            return -4;
         }
-        else if(sColumnId.Compare(CRP_COL_OPERATING_SYSTEM)==0)
+
+        if(nColumnId==CRP_CID_ROW_COUNT)
         {
-            // We do not support this property for older version of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion==1000)
-            {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
-            }
-            pszPropVal = strconv.t2w(pDescReader->m_sOperatingSystem);    
+            return nRowCount;
         }
-        else if(sColumnId.Compare(CRP_COL_SYSTEM_TIME_UTC)==0)
+        else if(nColumnId==CRP_CID_FILE_ITEM_NAME ||
+            nColumnId==CRP_CID_FILE_ITEM_DESCRIPTION)
         {
-            // We do not support this property for older version of CrashRpt
             if(pDescReader->m_dwGeneratorVersion==1000)
             {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
+                if(nColumnId==CRP_CID_FILE_ITEM_NAME)
+                    SetStringValue(val, pReportData->m_ContainedFiles[nRowIndex]);
+                else
+                    SetStringValue(val, L"");
             }
-            pszPropVal = strconv.t2w(pDescReader->m_sSystemTimeUTC);    
-        }
-        else if(sColumnId.Compare(CRP_COL_INVPARAM_FUNCTION)==0)
-        {  
-            if(pDescReader->m_dwExceptionType!=CR_CPP_INVALID_PARAMETER)
+            else
             {
-                crpSetErrorMsg(_T("This property is supported for invalid parameter errors only."));
-                return -3;
+                std::map<CString, CString>::iterator it = pDescReader->m_aFileItems.begin();
+                int i;
+                for(i=0; i<nRowIndex; i++) it++;
+
+                if(nColumnId==CRP_CID_FILE_ITEM_NAME)
+                    SetStringValue(val, it->first);
+                else
+                    SetStringValue(val, it->second);
             }
-            pszPropVal = strconv.t2w(pDescReader->m_sInvParamFunction);    
         }
-        else if(sColumnId.Compare(CRP_COL_INVPARAM_EXPRESSION)==0)
-        {  
-            if(pDescReader->m_dwExceptionType!=CR_CPP_INVALID_PARAMETER)
-            {
-                crpSetErrorMsg(_T("This property is supported for invalid parameter errors only."));
-                return -3;
-            }
-            pszPropVal = strconv.t2w(pDescReader->m_sInvParamExpression);    
+        else
+        {
+            crpSetErrorMsg(_T("Invalid column ID specified."));
+            return -2;
         }
-        else if(sColumnId.Compare(CRP_COL_INVPARAM_FILE)==0)
-        {      
-            if(pDescReader->m_dwExceptionType!=CR_CPP_INVALID_PARAMETER)
-            {
-                crpSetErrorMsg(_T("This property is supported for invalid parameter errors only."));
-                return -3;
-            }
-            pszPropVal = strconv.t2w(pDescReader->m_sInvParamFile);    
+    }
+    else if(nTableId==CRP_TID_XMLDESC_CUSTOM_PROPS)
+    {
+        if(pDescReader->m_dwGeneratorVersion<1201)
+        {
+            crpSetErrorMsg(_T("Invalid table ID specified."));
+            return -3;
         }
-        else if(sColumnId.Compare(CRP_COL_INVPARAM_LINE)==0)
+
+        if(nRowIndex>=(int)pDescReader->m_aCustomProps.size())
         {
-            if(pDescReader->m_dwExceptionType!=CR_CPP_INVALID_PARAMETER)
-            {
-                crpSetErrorMsg(_T("This property is supported for invalid parameter errors only."));
-                return -3;
-            }
-            _ULTOT_S(pDescReader->m_dwInvParamLine, szBuff, BUFF_SIZE, 10);
-            pszPropVal = szBuff;            
+            crpSetErrorMsg(_T("Invalid row index specified."));
+            return -4;
         }
-        else if(sColumnId.Compare(CRP_COL_EXCEPTION_TYPE)==0)
+
+        if(nColumnId==CRP_CID_ROW_COUNT)
         {
-            // We do not support this property for older version of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion==1000)
-            {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
-            }
-            _ULTOT_S(pDescReader->m_dwExceptionType, szBuff, BUFF_SIZE, 10);
-            _TCSCAT_S(szBuff, BUFF_SIZE, _T(" "));
-            _TCSCAT_S(szBuff, BUFF_SIZE, exctypes[pDescReader->m_dwExceptionType]);
-            pszPropVal = szBuff;            
+            return (int)pDescReader->m_aCustomProps.size();
         }
-        else if(sColumnId.Compare(CRP_COL_EXCEPTION_CODE)==0)
-        { 
-            // We do not support this property for older version of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion==1000)
+        else if(nColumnId==CRP_CID_PROPERTY_NAME ||
+            nColumnId==CRP_CID_PROPERTY_VALUE)
+        {
+            std::map<CString, CString>::iterator it = pDescReader->m_aCustomProps.begin();
+            int i;
+            for(i=0; i<nRowIndex; i++) it++;
+
+            if(nColumnId==CRP_CID_PROPERTY_NAME)
+                SetStringValue(val, it->first);
+            else
+                SetStringValue(val, it->second);
+        }
+        else
+        {
+            crpSetErrorMsg(_T("Invalid column ID specified."));
+            return -2;
+        }
+    }
+    else if(nTableId==CRP_TID_XMLDESC_BREADCRUMBS)
+    {
+        if(nRowIndex>=(int)pDescReader->m_aBreadcrumbs.size())
+        {
+            crpSetErrorMsg(_T("Invalid row index specified."));
+            return -4;
+        }
+
+        CCrashDescReader::Breadcrumb& bc = pDescReader->m_aBreadcrumbs[nRowIndex];
+
+        switch(nColumnId)
+        {
+        case CRP_CID_ROW_COUNT:
+            return (int)pDescReader->m_aBreadcrumbs.size();
+        case CRP_CID_BREADCRUMB_TIME:
+            SetStringValue(val, bc.m_sTime);
+            break;
+        case CRP_CID_BREADCRUMB_THREAD_ID:
+            SetStringValue(val, bc.m_sThreadId);
+            break;
+        case CRP_CID_BREADCRUMB_CATEGORY:
+            SetStringValue(val, bc.m_sCategory);
+            break;
+        case CRP_CID_BREADCRUMB_MESSAGE:
+            SetStringValue(val, bc.m_sMessage);
+            break;
+        default:
+            crpSetErrorMsg(_T("Invalid column ID specified."));
+            return -2;
+        }
+    }
+    else if(nTableId==CRP_TID_MDMP_MISC)
+    {
+        MdmpData& dd = pDmpReader->m_DumpData;
+
+        if(nRowIndex!=0)
+        {
+            crpSetErrorMsg(_T("Invalid index specified."));
+            return -4;
+        }
+
+        if(!pDmpReader->m_bReadExceptionStream &&
+            (nColumnId==CRP_CID_EXCPTRS_EXCEPTION_CODE ||
+            nColumnId==CRP_CID_EXCEPTION_ADDRESS ||
+            nColumnId==CRP_CID_EXCEPTION_THREAD_ROWID ||
+            nColumnId==CRP_CID_EXCEPTION_MODULE_ROWID ||
+            nColumnId==CRP_CID_EXCEPTION_THREAD_STACK_MD5))
+        {
+            crpSetErrorMsg(_T("There is no exception information in minidump file."));
+            return -3;
+        }
+
+        switch(nColumnId)
+        {
+        case CRP_CID_ROW_COUNT:
+            return 1; // there is 1 row in this table
+        case CRP_CID_CPU_ARCHITECTURE:
             {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
+                LPCTSTR szDescription = _T("unknown processor type");
+                if(dd.m_uProcessorArchitecture==PROCESSOR_ARCHITECTURE_AMD64)
+                    szDescription = _T("x64 (AMD or Intel)");
+                if(dd.m_uProcessorArchitecture==PROCESSOR_ARCHITECTURE_IA32_ON_WIN64)
+                    szDescription = _T("WOW");
+                if(dd.m_uProcessorArchitecture==PROCESSOR_ARCHITECTURE_IA64)
+                    szDescription = _T("Intel Itanium Processor Family (IPF)");
+                if(dd.m_uProcessorArchitecture==PROCESSOR_ARCHITECTURE_INTEL)
+                    szDescription = _T("x86");
+                SetIntValue(val, dd.m_uProcessorArchitecture, CRP_FMT_UDEC, szDescription);
             }
-            _ULTOT_S(pDescReader->m_dwExceptionCode, szBuff, BUFF_SIZE, 16);
-            _TCSCAT_S(szBuff, BUFF_SIZE, _T(" "));
-            CString msg = Utility::FormatErrorMsg(pDescReader->m_dwExceptionCode);
-            _TCSCAT_S(szBuff, BUFF_SIZE, msg);
-            pszPropVal = szBuff;    
-        }
-        else if(sColumnId.Compare(CRP_COL_FPE_SUBCODE)==0)
-        { 
-            // We do not support this property for older version of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion==1000)
+            break;
+        case CRP_CID_CPU_COUNT:
+            SetIntValue(val, dd.m_uchNumberOfProcessors);
+            break;
+        case CRP_CID_PRODUCT_TYPE:
             {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
+                LPCTSTR szDescription = _T("unknown product type");
+                if(dd.m_uchProductType==VER_NT_DOMAIN_CONTROLLER)
+                    szDescription = _T("domain controller");
+                if(dd.m_uchProductType==VER_NT_SERVER)
+                    szDescription = _T("server");
+                if(dd.m_uchProductType==VER_NT_WORKSTATION)
+                    szDescription = _T("workstation");
+                SetIntValue(val, dd.m_uchProductType, CRP_FMT_UDEC, szDescription);
             }
-            _ULTOT_S(pDescReader->m_dwFPESubcode, szBuff, BUFF_SIZE, 10);
-            pszPropVal = szBuff;        
-        }    
-        else if(sColumnId.Compare(CRP_COL_USER_EMAIL)==0)
-        {
-            // We do not support this property for older version of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion==1000)
+            break;
+        case CRP_CID_OS_VER_MAJOR:
+            SetIntValue(val, dd.m_ulVerMajor);
+            break;
+        case CRP_CID_OS_VER_MINOR:
+            SetIntValue(val, dd.m_ulVerMinor);
+            break;
+        case CRP_CID_OS_VER_BUILD:
+            SetIntValue(val, dd.m_ulVerBuild);
+            break;
+        case CRP_CID_OS_VER_CSD:
+            SetStringValue(val, dd.m_sCSDVer);
+            break;
+        case CRP_CID_EXCPTRS_EXCEPTION_CODE:
+            SetIntValue(val, dd.m_uExceptionCode, CRP_FMT_HEX);
+            val.m_bFormatMsg = TRUE;
+            break;
+        case CRP_CID_EXCEPTION_ADDRESS:
+            SetIntValue(val, dd.m_uExceptionAddress, CRP_FMT_HEX);
+            break;
+        case CRP_CID_EXCEPTION_THREAD_ROWID:
+            SetIntValue(val, pDmpReader->GetThreadRowIdByThreadId(dd.m_uExceptionThreadId), CRP_FMT_DEC);
+            break;
+        case CRP_CID_EXCEPTION_MODULE_ROWID:
+            SetIntValue(val, pDmpReader->GetModuleRowIdByAddress(dd.m_uExceptionAddress), CRP_FMT_DEC);
+            break;
+        case CRP_CID_EXCEPTION_THREAD_STACK_MD5:
             {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
+                int nThreadROWID = pDmpReader->GetThreadRowIdByThreadId(dd.m_uExceptionThreadId);
+                if(nThreadROWID>=0)
+                {
+                    pDmpReader->StackWalk(dd.m_Threads[nThreadROWID].m_dwThreadId);
+                    SetStringValue(val, dd.m_Threads[nThreadROWID].m_sStackTraceMD5);
+                }
+                else
+                    SetStringValue(val, L"");
             }
-            pszPropVal = strconv.t2w(pDescReader->m_sUserEmail);    
+            break;
+        default:
+            crpSetErrorMsg(_T("Invalid column ID specified."));
+            return -2;
         }
-        else if(sColumnId.Compare(CRP_COL_PROBLEM_DESCRIPTION)==0)
+    }
+    else if(nTableId==CRP_TID_MDMP_MODULES)
+    {
+        if(nRowIndex>=(int)pDmpReader->m_DumpData.m_Modules.size())
         {
-            // We do not support this property for older version of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion==1000)
-            {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
-            }
-            pszPropVal = strconv.t2w(pDescReader->m_sProblemDescription);    
+            crpSetErrorMsg(_T("Invalid index specified."));
+            return -4;
         }
-        else if(sColumnId.Compare(CRP_COL_GUI_RESOURCE_COUNT)==0)
+
+        if(nColumnId==CRP_CID_ROW_COUNT)
+            return (int)pDmpReader->m_DumpData.m_Modules.size();
+
+        MdmpModule& m = pDmpReader->m_DumpData.m_Modules[nRowIndex];
+        switch(nColumnId)
         {
-            // We do not support this property for older versions of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion<1201)
-            {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
-            }
-            pszPropVal = strconv.t2w(pDescReader->m_sGUIResourceCount);    
+        case CRP_CID_MODULE_NAME:
+            SetStringValue(val, m.m_sModuleName);
+            break;
+        case CRP_CID_MODULE_IMAGE_NAME:
+            SetStringValue(val, m.m_sImageName);
+            break;
+        case CRP_CID_MODULE_BASE_ADDRESS:
+            SetIntValue(val, m.m_uBaseAddr, CRP_FMT_HEX);
+            break;
+        case CRP_CID_MODULE_SIZE:
+            SetIntValue(val, m.m_uImageSize);
+            break;
+        case CRP_CID_MODULE_LOADED_PDB_NAME:
+            SetStringValue(val, m.m_sLoadedPdbName);
+            break;
+        case CRP_CID_MODULE_LOADED_IMAGE_NAME:
+            SetStringValue(val, m.m_sLoadedImageName);
+            break;
+        case CRP_CID_MODULE_SYM_LOAD_STATUS:
+            if(m.m_bImageUnmatched)
+                SetStringValue(val, L"No matching binary found.");
+            else if(m.m_bSymbolsDeferred)
+                SetStringValue(val, L"Symbols not loaded yet.");
+            else if(m.m_bPdbUnmatched)
+                SetStringValue(val, L"No matching PDB file found.");
+            else if(m.m_bNoSymbolInfo)
+                SetStringValue(val, L"No symbols loaded.");
+            else
+                SetStringValue(val, L"Symbols loaded.");
+            break;
+        default:
+            crpSetErrorMsg(_T("Invalid column ID specified."));
+            return -2;
         }
-        else if(sColumnId.Compare(CRP_COL_OPEN_HANDLE_COUNT)==0)
+    }
+    else if(nTableId==CRP_TID_MDMP_THREADS)
+    {
+        if(nRowIndex>=(int)pDmpReader->m_DumpData.m_Threads.size())
         {
-            // We do not support this property for older versions of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion<1201)
-            {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
-            }
-            pszPropVal = strconv.t2w(pDescReader->m_sOpenHandleCount);    
+            crpSetErrorMsg(_T("Invalid row index specified."));
+            return -4;
         }
-        else if(sColumnId.Compare(CRP_COL_MEMORY_USAGE_KBYTES)==0)
+
+        switch(nColumnId)
         {
-            // We do not support this property for older versions of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion<1201)
-            {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
-            }
-            pszPropVal = strconv.t2w(pDescReader->m_sMemoryUsageKbytes);    
+        case CRP_CID_ROW_COUNT:
+            return (int)pDmpReader->m_DumpData.m_Threads.size();
+        case CRP_CID_THREAD_ID:
+            SetIntValue(val, pDmpReader->m_DumpData.m_Threads[nRowIndex].m_dwThreadId, CRP_FMT_HEX);
+            break;
+        case CRP_CID_THREAD_STACK_TABLEID:
+            // The integer value is the interned ID of the STACK<n> table
+            SetIntValue(val, CRP_TID_STACK+nRowIndex, CRP_FMT_STACK_TABLEID);
+            break;
+        default:
+            crpSetErrorMsg(_T("Invalid column ID specified."));
+            return -2;
         }
-        else if(sColumnId.Compare(CRP_COL_OS_IS_64BIT)==0)
+    }
+    else if(nTableId==CRP_TID_MDMP_LOAD_LOG)
+    {
+        if(nRowIndex>=(int)pDmpReader->m_DumpData.m_LoadLog.size())
         {
-            // We do not support this property for older versions of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion<1207)
-            {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
-            }
-            _STPRINTF_S(szBuff, BUFF_SIZE, L"%d", pDescReader->m_bOSIs64Bit);    
-            pszPropVal = szBuff;      
+            crpSetErrorMsg(_T("Invalid row index specified."));
+            return -4;
         }
-        else if(sColumnId.Compare(CRP_COL_GEO_LOCATION)==0)
+
+        if(nColumnId==CRP_CID_ROW_COUNT)
         {
-            // We do not support this property for older versions of CrashRpt
-            if(pDescReader->m_dwGeneratorVersion<1207)
-            {
-                crpSetErrorMsg(_T("Invalid column ID is specified."));
-                return -3;
-            }
-            pszPropVal = strconv.t2w(pDescReader->m_sGeoLocation);    
+            return (int)pDmpReader->m_DumpData.m_LoadLog.size();
+        }
+        else if(nColumnId==CRP_CID_LOAD_LOG_ENTRY)
+        {
+            SetStringValue(val, pDmpReader->m_DumpData.m_LoadLog[nRowIndex]);
         }
         else
         {
@@ -774,445 +1392,674 @@ crpGetPropertyW(
             return -2;
         }
     }
-    else if(sTableId.Compare(CRP_TBL_XMLDESC_FILE_ITEMS)==0)
+    else if(nTableId==CRP_TID_MDMP_BUCKET)
     {
-        if(pDescReader->m_dwGeneratorVersion==1000)
+        // This table contains single row describing the crash bucket of the
+        // exception thread. There are no rows if there is no exception info.
+        MdmpData& dd = pDmpReader->m_DumpData;
+        int nThreadROWID = -1;
+        if(pDmpReader->m_bReadExceptionStream)
+            nThreadROWID = pDmpReader->GetThreadRowIdByThreadId(dd.m_uExceptionThreadId);
+
+        if(nColumnId==CRP_CID_ROW_COUNT)
+            return nThreadROWID>=0?1:0;
+
+        if(nThreadROWID<0)
         {
-            if(nRowIndex>=(int)it->second.m_ContainedFiles.size())
-            {
-                crpSetErrorMsg(_T("Invalid row index specified."));
-                return -4;    
-            }
+            crpSetErrorMsg(_T("There is no exception information in minidump file."));
+            return -3;
         }
-        else
+
+        if(nRowIndex!=0)
         {
-            if(nRowIndex>=(int)pDescReader->m_aFileItems.size())
-            {
-                crpSetErrorMsg(_T("Invalid row index specified."));
-                return -4;    
-            }
+            crpSetErrorMsg(_T("Invalid index specified."));
+            return -4;
         }
 
-        if(sColumnId.Compare(CRP_META_ROW_COUNT)==0)
+        MdmpThread& thread = dd.m_Threads[nThreadROWID];
+        pDmpReader->StackWalk(thread.m_dwThreadId);
+
+        switch(nColumnId)
         {
-            if(pDescReader->m_dwGeneratorVersion==1000)
-                return (int)it->second.m_ContainedFiles.size();
-            return (int)pDescReader->m_aFileItems.size();
+        case CRP_CID_BUCKET_ID:
+            SetStringValue(val, thread.m_sBucketId);
+            break;
+        case CRP_CID_BUCKET_SIGNATURE:
+            SetStringValue(val, thread.m_sBucketSignature);
+            break;
+        case CRP_CID_BUCKET_FRAME_COUNT:
+            SetIntValue(val, thread.m_nBucketFrameCount);
+            break;
+        default:
+            crpSetErrorMsg(_T("Invalid column ID specified."));
+            return -2;
         }
-        else if( sColumnId.Compare(CRP_COL_FILE_ITEM_NAME)==0 || 
-            sColumnId.Compare(CRP_COL_FILE_ITEM_DESCRIPTION)==0 )
-        { 
-            if(pDescReader->m_dwGeneratorVersion==1000)
-            {
-                if(sColumnId.Compare(CRP_COL_FILE_ITEM_NAME)==0)
-                    pszPropVal = strconv.t2w(it->second.m_ContainedFiles[nRowIndex]);            
-                else
-                    pszPropVal = _T("");
-            }
-            else
-            {
-                std::map<CString, CString>::iterator it = pDescReader->m_aFileItems.begin();
-                int i;
-                for(i=0; i<nRowIndex; i++) it++;
+    }
+    else if(nStackThread>=0)
+    {
+        MdmpThread& thread = pDmpReader->m_DumpData.m_Threads[nStackThread];
 
-                if(sColumnId.Compare(CRP_COL_FILE_ITEM_NAME)==0)
-                    pszPropVal = strconv.t2w(it->first);    
-                else
-                    pszPropVal = strconv.t2w(it->second);    
-            }
+        // Ensure we walked the stack for this thread
+        assert(thread.m_bStackWalk);
+
+        if(nRowIndex>=(int)thread.m_StackTrace.size())
+        {
+            crpSetErrorMsg(_T("Invalid index specified."));
+            return -4;
         }
-        else
+
+        if(nColumnId==CRP_CID_ROW_COUNT)
+            return (int)thread.m_StackTrace.size();
+
+        MdmpStackFrame& frame = thread.m_StackTrace[nRowIndex];
+        switch(nColumnId)
         {
+        case CRP_CID_STACK_OFFSET_IN_SYMBOL:
+            SetIntValue(val, frame.m_dw64OffsInSymbol, CRP_FMT_HEX);
+            break;
+        case CRP_CID_STACK_ADDR_PC_OFFSET:
+            SetIntValue(val, frame.m_dwAddrPCOffset, CRP_FMT_HEX);
+            break;
+        case CRP_CID_STACK_SOURCE_LINE:
+            SetIntValue(val, (ULONG)frame.m_nSrcLineNumber);
+            break;
+        case CRP_CID_STACK_MODULE_ROWID:
+            SetIntValue(val, frame.m_nModuleRowID, CRP_FMT_DEC);
+            break;
+        case CRP_CID_STACK_SYMBOL_NAME:
+            SetStringValue(val, frame.m_sSymbolName);
+            break;
+        case CRP_CID_STACK_SOURCE_FILE:
+            SetStringValue(val, frame.m_sSrcFileName);
+            break;
+        default:
             crpSetErrorMsg(_T("Invalid column ID specified."));
             return -2;
         }
     }
-    else if(sTableId.Compare(CRP_TBL_XMLDESC_CUSTOM_PROPS)==0)
+    else
     {
-        if(pDescReader->m_dwGeneratorVersion<1201)
+        crpSetErrorMsg(_T("Invalid table ID specified."));
+        return -3;
+    }
+
+    return 0;
+}
+
+// FormatPropertyValue
+// Converts the property value to text the same way crpGetPropertyW() always did.
+// Returns pointer to the text, which is either the string value or szBuff.
+LPCWSTR FormatPropertyValue(const CrpPropValue& val, LPWSTR szBuff, int nBuffSize)
+{
+    if(val.m_nType==CRP_VALUE_STRING)
+        return val.m_pszValue;
+
+    switch(val.m_nFormat)
+    {
+    case CRP_FMT_DEC:
+        _STPRINTF_S(szBuff, nBuffSize, L"%I64d", val.m_nValue);
+        break;
+    case CRP_FMT_HEX:
+        _STPRINTF_S(szBuff, nBuffSize, L"0x%I64x", val.m_nValue);
+        break;
+    case CRP_FMT_HEX_NOPREFIX:
+        _STPRINTF_S(szBuff, nBuffSize, L"%I64x", val.m_nValue);
+        break;
+    case CRP_FMT_STACK_TABLEID:
+        _STPRINTF_S(szBuff, nBuffSize, L"STACK%d", (int)(val.m_nValue-CRP_TID_STACK));
+        break;
+    default:
+        _STPRINTF_S(szBuff, nBuffSize, L"%I64u", val.m_nValue);
+        break;
+    }
+
+    if(val.m_pszSuffix!=NULL)
+    {
+        _TCSCAT_S(szBuff, nBuffSize, _T(" "));
+        _TCSCAT_S(szBuff, nBuffSize, val.m_pszSuffix);
+    }
+
+    if(val.m_bFormatMsg)
+    {
+        _TCSCAT_S(szBuff, nBuffSize, _T(" "));
+        CString msg = Utility::FormatErrorMsg((DWORD)val.m_nValue);
+        _TCSCAT_S(szBuff, nBuffSize, msg);
+    }
+
+    return szBuff;
+}
+
+CRASHRPTPROBE_API(int)
+crpGetPropertyW(
+                CrpHandle hReport,
+                LPCWSTR lpszTableId,
+                LPCWSTR lpszColumnId,
+                INT nRowIndex,
+                LPWSTR lpszBuffer,
+                ULONG cchBuffSize,
+                PULONG pcchCount)
+{
+    crpSetErrorMsg(_T("Unspecified error."));
+
+    // Set default output values
+    if(lpszBuffer!=NULL && cchBuffSize>=1)
+        lpszBuffer[0] = 0; // Empty buffer
+    if(pcchCount!=NULL)
+        *pcchCount = 0;
+
+    LPCWSTR pszPropVal = NULL;
+    const int BUFF_SIZE = 4096;
+    WCHAR szBuff[BUFF_SIZE]; // Internal buffer to store formatted integer property
+    CrpPropValue val;
+
+    // Validate input parameters
+    if( lpszTableId==NULL ||
+        lpszColumnId==NULL ||
+        nRowIndex<0 || // Check we have non-negative row index
+        (lpszBuffer==NULL && cchBuffSize!=0) || // Check that we have a valid buffer
+        (lpszBuffer!=NULL && cchBuffSize==0)
+        )
+    {
+        crpSetErrorMsg(_T("Invalid argument specified."));
+        return -1;
+    }
+
+    CrpReportData* pReportData = FindReportData(hReport);
+    if(pReportData==NULL)
+    {
+        crpSetErrorMsg(_T("Invalid handle specified."));
+        return -1;
+    }
+
+    // Names are resolved through the same index as crpGetPropertyId() uses
+    int nResult = GetPropertyValue(pReportData,
+        g_PropNameIndex.FindTable(lpszTableId),
+        g_PropNameIndex.FindColumn(lpszColumnId), nRowIndex, val);
+    if(nResult!=0)
+        return nResult; // Error or row count
+
+    pszPropVal = FormatPropertyValue(val, szBuff, BUFF_SIZE);
+
+    // Check the provided buffer size
+    if(lpszBuffer==NULL || cchBuffSize==0)
+    {
+        // User wants us to get the required length of the buffer
+        if(pcchCount!=NULL)
         {
-            crpSetErrorMsg(_T("Invalid table ID specified."));
-            return -3;    
+            *pcchCount = pszPropVal!=NULL?(ULONG)wcslen(pszPropVal):0;
+        }
+    }
+    else
+    {
+        // User wants us to return the property value
+        ULONG uRequiredLen = pszPropVal!=NULL?(ULONG)wcslen(pszPropVal):0;
+        if(uRequiredLen>(cchBuffSize))
+        {
+            crpSetErrorMsg(_T("Buffer is too small."));
+            return uRequiredLen;
         }
 
-        if(nRowIndex>=(int)pDescReader->m_aCustomProps.size())
+        // Copy the property to the buffer
+        if(pszPropVal!=NULL)
+            WCSCPY_S(lpszBuffer, cchBuffSize, pszPropVal);
+
+        if(pcchCount!=NULL)
         {
-            crpSetErrorMsg(_T("Invalid row index specified."));
-            return -4;    
+            *pcchCount = uRequiredLen;
         }
+    }
+
+    // Done.
+    crpSetErrorMsg(_T("Success."));
+    return 0;
+}
 
-        if(sColumnId.Compare(CRP_META_ROW_COUNT)==0)
+CRASHRPTPROBE_API(int)
+crpGetPropertyIdW(
+                  LPCWSTR lpszTableId,
+                  LPCWSTR lpszColumnId,
+                  PINT pnTableId,
+                  PINT pnColumnId)
+{
+    crpSetErrorMsg(_T("Unspecified error."));
+
+    if(pnTableId!=NULL)
+        *pnTableId = CRP_TID_UNKNOWN;
+    if(pnColumnId!=NULL)
+        *pnColumnId = CRP_CID_UNKNOWN;
+
+    if(lpszTableId!=NULL)
+    {
+        int nTableId = g_PropNameIndex.FindTable(lpszTableId);
+        if(nTableId==CRP_TID_UNKNOWN)
         {
-            return (int)pDescReader->m_aCustomProps.size();
+            crpSetErrorMsg(_T("Invalid table ID specified."));
+            return -3;
         }
-        else if( sColumnId.Compare(CRP_COL_PROPERTY_NAME)==0 || 
-            sColumnId.Compare(CRP_COL_PROPERTY_VALUE)==0 )
-        { 
-            std::map<CString, CString>::iterator it = pDescReader->m_aCustomProps.begin();
-            int i;
-            for(i=0; i<nRowIndex; i++) it++;
 
-            if(sColumnId.Compare(CRP_COL_PROPERTY_NAME)==0)
-                pszPropVal = strconv.t2w(it->first);    
-            else
-                pszPropVal = strconv.t2w(it->second);          
-        }
-        else
-        {
-            crpSetErrorMsg(_T("Invalid column ID specified."));
-            return -2;
-        }
-    }
-    else if(sTableId.Compare(CRP_TBL_MDMP_MISC)==0)
-    {
-        if(nRowIndex!=0)
-        {
-            crpSetErrorMsg(_T("Invalid index specified."));
-            return -4;    
-        }
+        if(pnTableId!=NULL)
+            *pnTableId = nTableId;
+    }
+
+    if(lpszColumnId!=NULL)
+    {
+        int nColumnId = g_PropNameIndex.FindColumn(lpszColumnId);
+        if(nColumnId==CRP_CID_UNKNOWN)
+        {
+            crpSetErrorMsg(_T("Invalid column ID specified."));
+            return -2;
+        }
+
+        if(pnColumnId!=NULL)
+            *pnColumnId = nColumnId;
+    }
+
+    crpSetErrorMsg(_T("Success."));
+    return 0;
+}
+
+CRASHRPTPROBE_API(int)
+crpGetPropertyIdA(
+                  LPCSTR lpszTableId,
+                  LPCSTR lpszColumnId,
+                  PINT pnTableId,
+                  PINT pnColumnId)
+{
+    strconv_t strconv;
+    return crpGetPropertyIdW(
+        strconv.a2w(lpszTableId),
+        strconv.a2w(lpszColumnId),
+        pnTableId,
+        pnColumnId);
+}
+
+CRASHRPTPROBE_API(int)
+crpGetPropertyValue(
+                    CrpHandle hReport,
+                    INT nTableId,
+                    INT nColumnId,
+                    INT nRowIndex,
+                    CrpPropertyValue* pValue)
+{
+    crpSetErrorMsg(_T("Unspecified error."));
+
+    CrpPropValue val;
+
+    if(pValue==NULL || nRowIndex<0)
+    {
+        crpSetErrorMsg(_T("Invalid argument specified."));
+        return -1;
+    }
+
+    memset(pValue, 0, sizeof(CrpPropertyValue));
+
+    CrpReportData* pReportData = FindReportData(hReport);
+    if(pReportData==NULL)
+    {
+        crpSetErrorMsg(_T("Invalid handle specified."));
+        return -1;
+    }
+
+    int nResult = GetPropertyValue(pReportData, nTableId, nColumnId, nRowIndex, val);
+    if(nResult<0)
+        return nResult;
+
+    if(nColumnId==CRP_CID_ROW_COUNT)
+    {
+        // Row count is returned as integer value
+        SetIntValue(val, nResult);
+    }
+
+    pValue->nType = val.m_nType;
+    if(val.m_nType==CRP_VALUE_INT)
+    {
+        pValue->nValue = val.m_nValue;
+    }
+    else
+    {
+        pValue->pszValue = val.m_pszValue;
+        pValue->cchLength = (ULONG)wcslen(val.m_pszValue);
+    }
+
+    crpSetErrorMsg(_T("Success."));
+    return 0;
+}
+
+// Columns of the tables in the order they are exported
+const int g_aXmlDescMiscColumns[] =
+{
+    CRP_CID_CRASHRPT_VERSION, CRP_CID_CRASH_GUID, CRP_CID_APP_NAME, CRP_CID_APP_VERSION,
+    CRP_CID_IMAGE_NAME, CRP_CID_OPERATING_SYSTEM, CRP_CID_SYSTEM_TIME_UTC, 
+    CRP_CID_EXCEPTION_TYPE, CRP_CID_EXCEPTION_CODE, CRP_CID_INVPARAM_FUNCTION, 
+    CRP_CID_INVPARAM_EXPRESSION, CRP_CID_INVPARAM_FILE, CRP_CID_INVPARAM_LINE, 
+    CRP_CID_FPE_SUBCODE, CRP_CID_USER_EMAIL, CRP_CID_PROBLEM_DESCRIPTION, 
+    CRP_CID_MEMORY_USAGE_KBYTES, CRP_CID_GUI_RESOURCE_COUNT, CRP_CID_OPEN_HANDLE_COUNT, 
+    CRP_CID_OS_IS_64BIT, CRP_CID_GEO_LOCATION
+};
+
+const int g_aXmlDescFileItemsColumns[] =
+{
+    CRP_CID_FILE_ITEM_NAME, CRP_CID_FILE_ITEM_DESCRIPTION
+};
+
+const int g_aXmlDescCustomPropsColumns[] =
+{
+    CRP_CID_PROPERTY_NAME, CRP_CID_PROPERTY_VALUE
+};
+
+const int g_aXmlDescBreadcrumbsColumns[] =
+{
+    CRP_CID_BREADCRUMB_TIME, CRP_CID_BREADCRUMB_THREAD_ID, CRP_CID_BREADCRUMB_CATEGORY,
+    CRP_CID_BREADCRUMB_MESSAGE
+};
+
+const int g_aMdmpMiscColumns[] =
+{
+    CRP_CID_CPU_ARCHITECTURE, CRP_CID_CPU_COUNT, CRP_CID_PRODUCT_TYPE, 
+    CRP_CID_OS_VER_MAJOR, CRP_CID_OS_VER_MINOR, CRP_CID_OS_VER_BUILD, CRP_CID_OS_VER_CSD, 
+    CRP_CID_EXCPTRS_EXCEPTION_CODE, CRP_CID_EXCEPTION_ADDRESS, CRP_CID_EXCEPTION_THREAD_ROWID,
+    CRP_CID_EXCEPTION_THREAD_STACK_MD5, CRP_CID_EXCEPTION_MODULE_ROWID
+};
+
+const int g_aMdmpModulesColumns[] =
+{
+    CRP_CID_MODULE_NAME, CRP_CID_MODULE_IMAGE_NAME, CRP_CID_MODULE_BASE_ADDRESS,
+    CRP_CID_MODULE_SIZE, CRP_CID_MODULE_LOADED_PDB_NAME, CRP_CID_MODULE_LOADED_IMAGE_NAME,
+    CRP_CID_MODULE_SYM_LOAD_STATUS
+};
+
+const int g_aMdmpThreadsColumns[] =
+{
+    CRP_CID_THREAD_ID, CRP_CID_THREAD_STACK_TABLEID
+};
+
+const int g_aMdmpLoadLogColumns[] =
+{
+    CRP_CID_LOAD_LOG_ENTRY
+};
+
+const int g_aMdmpBucketColumns[] =
+{
+    CRP_CID_BUCKET_ID, CRP_CID_BUCKET_SIGNATURE, CRP_CID_BUCKET_FRAME_COUNT
+};
+
+const int g_aStackColumns[] =
+{
+    CRP_CID_STACK_MODULE_ROWID, CRP_CID_STACK_SYMBOL_NAME, CRP_CID_STACK_OFFSET_IN_SYMBOL,
+    CRP_CID_STACK_SOURCE_FILE, CRP_CID_STACK_SOURCE_LINE, CRP_CID_STACK_ADDR_PC_OFFSET
+};
+
+// Describes columns of a table for export
+struct CrpTableSchema
+{
+    int m_nTableId;
+    const int* m_pColumns;
+    int m_nColumnCount;
+};
+
+#define CRP_SCHEMA(table_id, columns) {table_id, columns, sizeof(columns)/sizeof(columns[0])}
+
+// Tables exported by crpExportTables() when no table is specified. Stack
+// trace tables are exported after these ones.
+const CrpTableSchema g_ExportSchema[] =
+{
+    CRP_SCHEMA(CRP_TID_XMLDESC_MISC, g_aXmlDescMiscColumns),
+    CRP_SCHEMA(CRP_TID_XMLDESC_FILE_ITEMS, g_aXmlDescFileItemsColumns),
+    CRP_SCHEMA(CRP_TID_XMLDESC_CUSTOM_PROPS, g_aXmlDescCustomPropsColumns),
+    CRP_SCHEMA(CRP_TID_XMLDESC_BREADCRUMBS, g_aXmlDescBreadcrumbsColumns),
+    CRP_SCHEMA(CRP_TID_MDMP_MISC, g_aMdmpMiscColumns),
+    CRP_SCHEMA(CRP_TID_MDMP_MODULES, g_aMdmpModulesColumns),
+    CRP_SCHEMA(CRP_TID_MDMP_THREADS, g_aMdmpThreadsColumns),
+    CRP_SCHEMA(CRP_TID_MDMP_LOAD_LOG, g_aMdmpLoadLogColumns),
+    CRP_SCHEMA(CRP_TID_MDMP_BUCKET, g_aMdmpBucketColumns)
+};
+
+// WideToUtf8
+// Converts a wide-char string to UTF-8. The output string is reused between 
+// calls to avoid memory allocation for every cell.
+void WideToUtf8(LPCWSTR pszValue, int nLength, std::string& sOut)
+{
+    sOut.clear();
+    if(nLength==0)
+        return;
+
+    // At most 3 bytes are needed for one UTF-16 code unit
+    sOut.resize(nLength*3);
+    int nBytes = WideCharToMultiByte(CP_UTF8, 0, pszValue, nLength, &sOut[0], (int)sOut.size(), NULL, NULL);
+    sOut.resize(nBytes>0?nBytes:0);
+}
+
+// GetTableName
+// Returns the name of the table by interned table ID.
+CString GetTableName(int nTableId)
+{
+    if(nTableId>=CRP_TID_STACK)
+    {
+        CString sName;
+        sName.Format(_T("STACK%d"), nTableId-CRP_TID_STACK);
+        return sName;
+    }
+
+    int i;
+    for(i=0; i<(int)(sizeof(g_TableNames)/sizeof(g_TableNames[0])); i++)
+    {
+        if(g_TableNames[i].m_nId==nTableId)
+            return g_TableNames[i].m_szName;
+    }
+
+    return CString();
+}
+
+// ExportWrite
+// Passes the encoded data from CTableExporter to the user callback.
+struct CrpExportParam
+{
+    PFNCRPEXPORTCALLBACK m_pfnCallback;
+    LPVOID m_pUserParam;
+};
+
+bool ExportWrite(const void* pData, size_t uSize, void* pParam)
+{
+    CrpExportParam* p = (CrpExportParam*)pParam;
+    return p->m_pfnCallback(pData, (ULONG)uSize, p->m_pUserParam)!=FALSE;
+}
+
+// ExportTable
+// Writes all rows of a table. Properties are taken by interned IDs without
+// converting integers to text. Tables that are empty or not available in this
+// report are skipped, cells that are not available are exported as null.
+// Returns zero on success, negative value if the output callback has failed.
+int ExportTable(CrpReportData* pReportData, CTableExporter& exporter, 
+                int nTableId, const int* pColumns, int nColumnCount)
+{
+    CrpPropValue val;
+    std::vector<std::string> asColumns;
+    std::string sUtf8;
+    WCHAR szBuff[64];
+    int nRow;
+    int i;
 
-        if(sColumnId.Compare(CRP_META_ROW_COUNT)==0)
-        {
-            return 1; // there is 1 row in this table
-        }
-        else if(sColumnId.Compare(CRP_COL_CPU_ARCHITECTURE)==0)
-        {
-            _ULTOT_S(pDmpReader->m_DumpData.m_uProcessorArchitecture, szBuff, BUFF_SIZE, 10);
-            _TCSCAT_S(szBuff, BUFF_SIZE, _T(" "));
-
-            TCHAR* szDescription = _T("unknown processor type");
-            if(pDmpReader->m_DumpData.m_uProcessorArchitecture==PROCESSOR_ARCHITECTURE_AMD64)
-                szDescription = _T("x64 (AMD or Intel)");
-            if(pDmpReader->m_DumpData.m_uProcessorArchitecture==PROCESSOR_ARCHITECTURE_IA32_ON_WIN64)
-                szDescription = _T("WOW");
-            if(pDmpReader->m_DumpData.m_uProcessorArchitecture==PROCESSOR_ARCHITECTURE_IA64)
-                szDescription = _T("Intel Itanium Processor Family (IPF)");
-            if(pDmpReader->m_DumpData.m_uProcessorArchitecture==PROCESSOR_ARCHITECTURE_INTEL)
-                szDescription = _T("x86");
-
-            _TCSCAT_S(szBuff, BUFF_SIZE, szDescription);
-
-            pszPropVal = szBuff;        
-        }
-        else if(sColumnId.Compare(CRP_COL_CPU_COUNT)==0)
-        {
-            _ULTOT_S(pDmpReader->m_DumpData.m_uchNumberOfProcessors, szBuff, BUFF_SIZE, 10);
-            pszPropVal = szBuff;        
-        }
-        else if(sColumnId.Compare(CRP_COL_PRODUCT_TYPE)==0)
-        {
-            _ULTOT_S(pDmpReader->m_DumpData.m_uchProductType, szBuff, BUFF_SIZE, 10);
-            _TCSCAT_S(szBuff, BUFF_SIZE, _T(" "));
+    int nRowCount = GetPropertyValue(pReportData, nTableId, CRP_CID_ROW_COUNT, 0, val);
+    if(nRowCount<=0)
+        return 0;
 
-            TCHAR* szDescription = _T("unknown product type");
-            if(pDmpReader->m_DumpData.m_uchProductType==VER_NT_DOMAIN_CONTROLLER)
-                szDescription = _T("domain controller");
-            if(pDmpReader->m_DumpData.m_uchProductType==VER_NT_SERVER)
-                szDescription = _T("server");
-            if(pDmpReader->m_DumpData.m_uchProductType==VER_NT_WORKSTATION)
-                szDescription = _T("workstation");
+    for(i=0; i<nColumnCount; i++)
+    {
+        // Column names are stored in the order of column IDs
+        assert(g_ColumnNames[pColumns[i]-1].m_nId==pColumns[i]);
+        LPCWSTR pszName = g_ColumnNames[pColumns[i]-1].m_szName;
+        WideToUtf8(pszName, (int)wcslen(pszName), sUtf8);
+        asColumns.push_back(sUtf8);
+    }
 
-            _TCSCAT_S(szBuff, BUFF_SIZE, szDescription);
+    CString sTableName = GetTableName(nTableId);
+    WideToUtf8(sTableName, sTableName.GetLength(), sUtf8);
+    exporter.BeginTable(sUtf8, asColumns);
 
-            pszPropVal = szBuff;        
-        }
-        else if(sColumnId.Compare(CRP_COL_OS_VER_MAJOR)==0)
-        {      
-            _ULTOT_S(pDmpReader->m_DumpData.m_ulVerMajor, szBuff, BUFF_SIZE, 10);
-            pszPropVal = szBuff;        
-        }
-        else if(sColumnId.Compare(CRP_COL_OS_VER_MINOR)==0)
-        {
-            _ULTOT_S(pDmpReader->m_DumpData.m_ulVerMinor, szBuff, BUFF_SIZE, 10);
-            pszPropVal = szBuff;        
-        }
-        else if(sColumnId.Compare(CRP_COL_OS_VER_BUILD)==0)
+    for(nRow=0; nRow<nRowCount; nRow++)
+    {
+        exporter.BeginRow(nRow);
+
+        for(i=0; i<nColumnCount; i++)
         {
-            _ULTOT_S(pDmpReader->m_DumpData.m_ulVerBuild, szBuff, BUFF_SIZE, 10);
-            pszPropVal = szBuff;        
-        }
-        else if(sColumnId.Compare(CRP_COL_OS_VER_CSD)==0)
-        {      
-            pszPropVal = strconv.t2w(pDmpReader->m_DumpData.m_sCSDVer);    
-        }
-        else if(sColumnId.Compare(CRP_COL_EXCPTRS_EXCEPTION_CODE)==0)
-        { 
-            if(!pDmpReader->m_bReadExceptionStream)
-            {
-                crpSetErrorMsg(_T("There is no exception information in minidump file."));
-                return -3;
-            }
-            _STPRINTF_S(szBuff, BUFF_SIZE, _T("0x%x"), pDmpReader->m_DumpData.m_uExceptionCode); 
-            _TCSCAT_S(szBuff, BUFF_SIZE, _T(" "));
-            CString msg = Utility::FormatErrorMsg(pDmpReader->m_DumpData.m_uExceptionCode);
-            _TCSCAT_S(szBuff, BUFF_SIZE, msg);
-            pszPropVal = szBuff;
-        }
-        else if(sColumnId.Compare(CRP_COL_EXCEPTION_ADDRESS)==0)
-        {  
-            if(!pDmpReader->m_bReadExceptionStream)
-            {
-                crpSetErrorMsg(_T("There is no exception information in minidump file."));
-                return -3;
-            }
-            _STPRINTF_S(szBuff, BUFF_SIZE, _T("0x%I64x"), pDmpReader->m_DumpData.m_uExceptionAddress); 
-            pszPropVal = szBuff;
-        }
-        else if(sColumnId.Compare(CRP_COL_EXCEPTION_THREAD_ROWID)==0)
-        {  
-            if(!pDmpReader->m_bReadExceptionStream)
-            {
-                crpSetErrorMsg(_T("There is no exception information in minidump file."));
-                return -3;
-            }
-            _STPRINTF_S(szBuff, BUFF_SIZE, _T("%d"), pDmpReader->GetThreadRowIdByThreadId(pDmpReader->m_DumpData.m_uExceptionThreadId)); 
-            pszPropVal = szBuff;
-        }
-        else if(sColumnId.Compare(CRP_COL_EXCEPTION_MODULE_ROWID)==0)
-        {  
-            if(!pDmpReader->m_bReadExceptionStream)
+            CrpPropValue cell;
+            if(GetPropertyValue(pReportData, nTableId, pColumns[i], nRow, cell)!=0)
             {
-                crpSetErrorMsg(_T("There is no exception information in minidump file."));
-                return -3;
+                exporter.AddNull();
             }
-            _STPRINTF_S(szBuff, BUFF_SIZE, _T("%d"), pDmpReader->GetModuleRowIdByAddress(pDmpReader->m_DumpData.m_uExceptionAddress)); 
-            pszPropVal = szBuff;
-        }
-        else if(sColumnId.Compare(CRP_COL_EXCEPTION_THREAD_STACK_MD5)==0)
-        {  
-            if(!pDmpReader->m_bReadExceptionStream)
+            else if(cell.m_nType==CRP_VALUE_INT && cell.m_nFormat!=CRP_FMT_STACK_TABLEID)
             {
-                crpSetErrorMsg(_T("There is no exception information in minidump file."));
-                return -3;
+                exporter.AddInt(cell.m_nValue, cell.m_nFormat==CRP_FMT_DEC);
             }
-            int nThreadROWID = pDmpReader->GetThreadRowIdByThreadId(pDmpReader->m_DumpData.m_uExceptionThreadId);
-            if(nThreadROWID>=0)
+            else
             {
-                pDmpReader->StackWalk(pDmpReader->m_DumpData.m_Threads[nThreadROWID].m_dwThreadId);
-                CString sMD5 = pDmpReader->m_DumpData.m_Threads[nThreadROWID].m_sStackTraceMD5;        
-                _STPRINTF_S(szBuff, BUFF_SIZE, _T("%s"), sMD5.GetBuffer(0));         
+                // Stack table IDs are exported by name, the same way tables are named
+                LPCWSTR pszValue = FormatPropertyValue(cell, szBuff, 64);
+                WideToUtf8(pszValue, (int)wcslen(pszValue), sUtf8);
+                exporter.AddString(sUtf8.c_str(), sUtf8.size());
             }
-            pszPropVal = szBuff;      
-        }
-        else
-        {
-            crpSetErrorMsg(_T("Invalid column ID specified."));
-            return -2;
         }
+
+        exporter.EndRow();
+
+        if(exporter.IsFailed())
+            return -1;
     }
-    else if(sTableId.Compare(CRP_TBL_MDMP_MODULES)==0)
-    {  
-        if(nRowIndex>=(int)pDmpReader->m_DumpData.m_Modules.size())
-        {
-            crpSetErrorMsg(_T("Invalid index specified."));
-            return -4;    
-        }
 
-        if(sColumnId.Compare(CRP_META_ROW_COUNT)==0)
-        {
-            return (int)pDmpReader->m_DumpData.m_Modules.size();
-        }
-        else if(sColumnId.Compare(CRP_COL_MODULE_NAME)==0)
-        {      
-            pszPropVal = strconv.t2w(pDmpReader->m_DumpData.m_Modules[nRowIndex].m_sModuleName);    
-        }
-        else if(sColumnId.Compare(CRP_COL_MODULE_IMAGE_NAME)==0)
-        {      
-            pszPropVal = strconv.t2w(pDmpReader->m_DumpData.m_Modules[nRowIndex].m_sImageName);    
-        }
-        else if(sColumnId.Compare(CRP_COL_MODULE_BASE_ADDRESS)==0)
-        {      
-            _STPRINTF_S(szBuff, BUFF_SIZE, _T("0x%I64x"), pDmpReader->m_DumpData.m_Modules[nRowIndex].m_uBaseAddr); 
-            pszPropVal = szBuff;
-        }
-        else if(sColumnId.Compare(CRP_COL_MODULE_SIZE)==0)
-        {
-            _STPRINTF_S(szBuff, BUFF_SIZE, _T("%I64u"), pDmpReader->m_DumpData.m_Modules[nRowIndex].m_uImageSize); 
-            pszPropVal = szBuff;
-        }
-        else if(sColumnId.Compare(CRP_COL_MODULE_LOADED_PDB_NAME)==0)
-        {
-            pszPropVal = strconv.t2w(pDmpReader->m_DumpData.m_Modules[nRowIndex].m_sLoadedPdbName);          
-        }
-        else if(sColumnId.Compare(CRP_COL_MODULE_LOADED_IMAGE_NAME)==0)
-        {
-            pszPropVal = strconv.t2w(pDmpReader->m_DumpData.m_Modules[nRowIndex].m_sLoadedImageName);          
-        }
-        else if(sColumnId.Compare(CRP_COL_MODULE_SYM_LOAD_STATUS)==0)
-        {
-            CString sSymLoadStatus;
-            MdmpModule m = pDmpReader->m_DumpData.m_Modules[nRowIndex];
-            if(m.m_bImageUnmatched)
-                sSymLoadStatus = _T("No matching binary found.");          
-            else if(m.m_bPdbUnmatched)
-                sSymLoadStatus = _T("No matching PDB file found.");          
-            else
-            {
-                if(m.m_bNoSymbolInfo)            
-                    sSymLoadStatus = _T("No symbols loaded.");          
-                else
-                    sSymLoadStatus = _T("Symbols loaded.");          
-            }
+    return 0;
+}
 
-#if _MSC_VER < 1400
-            _tcscpy(szBuff, sSymLoadStatus.GetBuffer(0));
-#else
-            _tcscpy_s(szBuff, BUFF_SIZE, sSymLoadStatus.GetBuffer(0));
-#endif
+// ExportStackTables
+// Writes stack trace tables of all threads.
+int ExportStackTables(CrpReportData* pReportData, CTableExporter& exporter)
+{
+    CrpPropValue val;
+    int nThreadCount = GetPropertyValue(pReportData, CRP_TID_MDMP_THREADS, CRP_CID_ROW_COUNT, 0, val);
+    int i;
 
-            pszPropVal = strconv.t2w(szBuff);          
-        }    
-        else
-        {
-            crpSetErrorMsg(_T("Invalid column ID specified."));
-            return -2;
-        }
+    for(i=0; i<nThreadCount; i++)
+    {
+        if(0!=ExportTable(pReportData, exporter, CRP_TID_STACK+i, 
+            g_aStackColumns, sizeof(g_aStackColumns)/sizeof(g_aStackColumns[0])))
+            return -1;
     }
-    else if(sTableId.Compare(CRP_TBL_MDMP_THREADS)==0)
-    {  
-        if(nRowIndex>=(int)pDmpReader->m_DumpData.m_Threads.size())
-        {
-            crpSetErrorMsg(_T("Invalid row index specified."));
-            return -4;    
-        }
 
-        if(sColumnId.Compare(CRP_META_ROW_COUNT)==0)
-        {
-            return (int)pDmpReader->m_DumpData.m_Threads.size();
-        }
-        else if(sColumnId.Compare(CRP_COL_THREAD_ID)==0)
-        {
-            _STPRINTF_S(szBuff, BUFF_SIZE, _T("0x%x"), pDmpReader->m_DumpData.m_Threads[nRowIndex].m_dwThreadId); 
-            pszPropVal = szBuff;
-        }
-        else if(sColumnId.Compare(CRP_COL_THREAD_STACK_TABLEID)==0)
-        {
-            _STPRINTF_S(szBuff, BUFF_SIZE, _T("STACK%d"), nRowIndex); 
-            pszPropVal = szBuff;
-        }    
-        else
-        {
-            crpSetErrorMsg(_T("Invalid column ID specified."));
-            return -2;
-        }
+    return 0;
+}
 
-    }  
-    else if(sTableId.Compare(CRP_TBL_MDMP_LOAD_LOG)==0)
-    {  
-        if(nRowIndex>=(int)pDmpReader->m_DumpData.m_LoadLog.size())
-        {
-            crpSetErrorMsg(_T("Invalid row index specified."));
-            return -4;    
-        }
+CRASHRPTPROBE_API(int)
+crpExportTablesW(
+                 CrpHandle hReport,
+                 LPCWSTR lpszTableId,
+                 INT nFormat,
+                 DWORD dwFlags,
+                 PFNCRPEXPORTCALLBACK pfnCallback,
+                 LPVOID pUserParam)
+{
+    crpSetErrorMsg(_T("Unspecified error."));
 
-        if(sColumnId.Compare(CRP_META_ROW_COUNT)==0)
-        {
-            return (int)pDmpReader->m_DumpData.m_LoadLog.size();
-        }
-        else if(sColumnId.Compare(CRP_COL_LOAD_LOG_ENTRY)==0)
-        {
-            _TCSCPY_S(szBuff, BUFF_SIZE, pDmpReader->m_DumpData.m_LoadLog[nRowIndex]); 
-            pszPropVal = szBuff;
-        }
-        else
-        {
-            crpSetErrorMsg(_T("Invalid column ID specified."));
-            return -2;
-        }
+    CrpPropValue val;
+    std::string sReportId;
+    int nTableId = CRP_TID_UNKNOWN;
+    BOOL bAllStacks = FALSE;
+    int nResult = 0;
+    int i;
 
-    }  
-    else if(nDynTable==0)
+    // CSV output can contain only tables having the same columns
+    if(pfnCallback==NULL || 
+        !CTableExporter::IsValidFormat(nFormat) ||
+        (nFormat==CRP_EXPORT_CSV && lpszTableId==NULL))
     {
-        int nEntryIndex = nDynTableIndex;
-
-        // Ensure we walked the stack for this thread
-        assert(pDmpReader->m_DumpData.m_Threads[nEntryIndex].m_bStackWalk);
+        crpSetErrorMsg(_T("Invalid argument specified."));
+        return -1;
+    }
 
-        if(nRowIndex>=(int)pDmpReader->m_DumpData.m_Threads[nEntryIndex].m_StackTrace.size())
-        {
-            crpSetErrorMsg(_T("Invalid index specified."));
-            return -4;    
-        }
+    CrpReportData* pReportData = FindReportData(hReport);
+    if(pReportData==NULL)
+    {
+        crpSetErrorMsg(_T("Invalid handle specified."));
+        return -1;
+    }
 
-        if(sColumnId.Compare(CRP_META_ROW_COUNT)==0)
-        {
-            return (int)pDmpReader->m_DumpData.m_Threads[nEntryIndex].m_StackTrace.size();
-        }
-        else if(sColumnId.Compare(CRP_COL_STACK_OFFSET_IN_SYMBOL)==0)
-        {      
-            _STPRINTF_S(szBuff, BUFF_SIZE, _T("0x%I64x"), pDmpReader->m_DumpData.m_Threads[nEntryIndex].m_StackTrace[nRowIndex].m_dw64OffsInSymbol);      
-            pszPropVal = szBuff;                  
-        }
-        else if(sColumnId.Compare(CRP_COL_STACK_ADDR_PC_OFFSET)==0)
-        {       
-            _STPRINTF_S(szBuff, BUFF_SIZE, _T("0x%I64x"), pDmpReader->m_DumpData.m_Threads[nEntryIndex].m_StackTrace[nRowIndex].m_dwAddrPCOffset);
-            pszPropVal = szBuff;                
-        }
-        else if(sColumnId.Compare(CRP_COL_STACK_SOURCE_LINE)==0)
-        {       
-            _ULTOT_S(pDmpReader->m_DumpData.m_Threads[nEntryIndex].m_StackTrace[nRowIndex].m_nSrcLineNumber, szBuff, BUFF_SIZE, 10);
-            pszPropVal = szBuff;                
-        }  
-        else if(sColumnId.Compare(CRP_COL_STACK_MODULE_ROWID)==0)
-        {  
-            _LTOT_S(pDmpReader->m_DumpData.m_Threads[nEntryIndex].m_StackTrace[nRowIndex].m_nModuleRowID, szBuff, BUFF_SIZE, 10);
-            pszPropVal = szBuff;       
-        }
-        else if(sColumnId.Compare(CRP_COL_STACK_SYMBOL_NAME)==0)
-        {      
-            pszPropVal = strconv.t2w(pDmpReader->m_DumpData.m_Threads[nEntryIndex].m_StackTrace[nRowIndex].m_sSymbolName);    
-        }
-        else if(sColumnId.Compare(CRP_COL_STACK_SOURCE_FILE)==0)
-        {      
-            pszPropVal = strconv.t2w(pDmpReader->m_DumpData.m_Threads[nEntryIndex].m_StackTrace[nRowIndex].m_sSrcFileName);    
-        }
-        else
+    if(lpszTableId!=NULL)
+    {
+        // STACK without a number means stack trace tables of all threads
+        bAllStacks = wcscmp(lpszTableId, L"STACK")==0;
+        nTableId = g_PropNameIndex.FindTable(lpszTableId);
+        if(!bAllStacks && nTableId==CRP_TID_UNKNOWN)
         {
-            crpSetErrorMsg(_T("Invalid column ID specified."));
+            crpSetErrorMsg(_T("Invalid table ID specified."));
             return -2;
         }
     }
-    else
-    {
-        crpSetErrorMsg(_T("Invalid table ID specified."));
-        return -3;
-    }
 
+    CrpExportParam param;
+    param.m_pfnCallback = pfnCallback;
+    param.m_pUserParam = pUserParam;
 
-    // Check the provided buffer size
-    if(lpszBuffer==NULL || cchBuffSize==0)
+    CTableExporter exporter(nFormat, (dwFlags&CRP_EXPORT_HEADER)!=0, ExportWrite, &param);
+
+    // Rows are identified by crash GUID (not available in v1.0 reports)
+    if(0==GetPropertyValue(pReportData, CRP_TID_XMLDESC_MISC, CRP_CID_CRASH_GUID, 0, val))
+        WideToUtf8(val.m_pszValue, (int)wcslen(val.m_pszValue), sReportId);
+    exporter.BeginReport(sReportId);
+
+    if(lpszTableId==NULL || bAllStacks)
     {
-        // User wants us to get the required length of the buffer
-        if(pcchCount!=NULL)
+        for(i=0; lpszTableId==NULL && i<(int)(sizeof(g_ExportSchema)/sizeof(g_ExportSchema[0])); i++)
         {
-            *pcchCount = pszPropVal!=NULL?(ULONG)wcslen(pszPropVal):0;
+            nResult = ExportTable(pReportData, exporter, g_ExportSchema[i].m_nTableId,
+                g_ExportSchema[i].m_pColumns, g_ExportSchema[i].m_nColumnCount);
+            if(nResult!=0)
+                goto cleanup;
         }
+
+        nResult = ExportStackTables(pReportData, exporter);
+    }
+    else if(nTableId>=CRP_TID_STACK)
+    {
+        nResult = ExportTable(pReportData, exporter, nTableId, 
+            g_aStackColumns, sizeof(g_aStackColumns)/sizeof(g_aStackColumns[0]));
     }
     else
     {
-        // User wants us to return the property value 
-        ULONG uRequiredLen = pszPropVal!=NULL?(ULONG)wcslen(pszPropVal):0;
-        if(uRequiredLen>(cchBuffSize))
+        for(i=0; i<(int)(sizeof(g_ExportSchema)/sizeof(g_ExportSchema[0])); i++)
         {
-            crpSetErrorMsg(_T("Buffer is too small."));
-            return uRequiredLen;
+            if(g_ExportSchema[i].m_nTableId==nTableId)
+            {
+                nResult = ExportTable(pReportData, exporter, nTableId,
+                    g_ExportSchema[i].m_pColumns, g_ExportSchema[i].m_nColumnCount);
+                break;
+            }
         }
+    }
 
-        // Copy the property to the buffer
-        if(pszPropVal!=NULL)
-            WCSCPY_S(lpszBuffer, cchBuffSize, pszPropVal);
+cleanup:
 
-        if(pcchCount!=NULL)
-        {
-            *pcchCount = uRequiredLen;
-        }
+    if(nResult!=0 || !exporter.Flush())
+    {
+        crpSetErrorMsg(_T("Export callback has failed."));
+        return -3;
     }
 
-    // Done.
     crpSetErrorMsg(_T("Success."));
     return 0;
 }
 
+CRASHRPTPROBE_API(int)
+crpExportTablesA(
+                 CrpHandle hReport,
+                 LPCSTR lpszTableId,
+                 INT nFormat,
+                 DWORD dwFlags,
+                 PFNCRPEXPORTCALLBACK pfnCallback,
+                 LPVOID pUserParam)
+{
+    strconv_t strconv;
+    return crpExportTablesW(hReport, strconv.a2w(lpszTableId), nFormat, 
+        dwFlags, pfnCallback, pUserParam);
+}
+
 CRASHRPTPROBE_API(int)
 crpGetPropertyA(
                 CrpHandle hReport,
@@ -1263,14 +2110,14 @@ crpExtractFileW(
     int zr;  
     unzFile hZip = 0;
 
-    std::map<int, CrpReportData>::iterator it = g_OpenedHandles.find(hReport);
-    if(it==g_OpenedHandles.end())
+    CrpReportData* pReportData = FindReportData(hReport);
+    if(pReportData==NULL)
     {
         crpSetErrorMsg(_T("Invalid handle specified."));
         return -1;
     }
 
-    hZip = it->second.m_hZip;
+    hZip = pReportData->m_hZip;
 
     zr = unzLocateFile(hZip, strconv.w2a(lpszFileName), 1);
     if(zr!=UNZ_OK)
@@ -1316,6 +2163,95 @@ crpExtractFileA(
     return crpExtractFileW(hReport, pwszFileName, pwszFileSaveAs, bOverwriteExisting);
 }
 
+CRASHRPTPROBE_API(int)
+crpOpenSymbolCacheW(
+                    LPCWSTR lpszFileName)
+{
+    crpSetErrorMsg(_T("Unspecified error."));
+
+    if(lpszFileName==NULL)
+    {
+        crpSetErrorMsg(_T("Invalid argument specified."));
+        return -1;
+    }
+
+    strconv_t strconv;
+    int nOpen = g_SymCache.Open(strconv.w2utf8(lpszFileName));
+    if(nOpen!=SYMCACHE_OK && nOpen!=SYMCACHE_ERR_INVALID_FILE)
+    {
+        // An invalid file is not an error, it is overwritten on close
+        g_SymCache.Close();
+        g_bSymCacheOpened = FALSE;
+        crpSetErrorMsg(_T("Couldn't open symbol cache file."));
+        return -2;
+    }
+
+    g_bSymCacheOpened = TRUE;
+
+    crpSetErrorMsg(_T("Success."));
+    return 0;
+}
+
+CRASHRPTPROBE_API(int)
+crpOpenSymbolCacheA(
+                    LPCSTR lpszFileName)
+{
+    strconv_t strconv;
+    LPCWSTR pwszFileName = strconv.a2w(lpszFileName);
+
+    return crpOpenSymbolCacheW(pwszFileName);
+}
+
+CRASHRPTPROBE_API(int)
+crpCloseSymbolCache()
+{
+    crpSetErrorMsg(_T("Unspecified error."));
+
+    if(!g_bSymCacheOpened)
+    {
+        crpSetErrorMsg(_T("Success."));
+        return 0;
+    }
+
+    int nSave = g_SymCache.Save();
+    g_SymCache.Close();
+    g_bSymCacheOpened = FALSE;
+
+    if(nSave!=SYMCACHE_OK)
+    {
+        crpSetErrorMsg(_T("Couldn't write symbol cache file."));
+        return -1;
+    }
+
+    crpSetErrorMsg(_T("Success."));
+    return 0;
+}
+
+CRASHRPTPROBE_API(int)
+crpGetSymbolCacheStats(
+                       PULONG64 pulHits,
+                       PULONG64 pulMisses,
+                       PULONG64 pulEntries)
+{
+    crpSetErrorMsg(_T("Unspecified error."));
+
+    if(!g_bSymCacheOpened)
+    {
+        crpSetErrorMsg(_T("Symbol cache is not opened."));
+        return -1;
+    }
+
+    if(pulHits!=NULL)
+        *pulHits = g_SymCache.GetHitCount();
+    if(pulMisses!=NULL)
+        *pulMisses = g_SymCache.GetMissCount();
+    if(pulEntries!=NULL)
+        *pulEntries = g_SymCache.GetEntryCount();
+
+    crpSetErrorMsg(_T("Success."));
+    return 0;
+}
+
 CRASHRPTPROBE_API(int)
 crpGetLastErrorMsgW(
                     LPWSTR pszBuffer, 
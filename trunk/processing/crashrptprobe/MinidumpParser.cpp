@@ -0,0 +1,725 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "MinidumpParser.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Minidump signature ('MDMP') and format version
+#define MDMP_SIGNATURE 0x504d444d
+#define MDMP_VERSION   0xa793
+
+// Size of on-disk minidump structures
+#define MDMP_HEADER_SIZE            32
+#define MDMP_DIR_ENTRY_SIZE         12
+#define MDMP_SYSTEM_INFO_SIZE       56
+#define MDMP_EXCEPTION_STREAM_SIZE  168
+#define MDMP_MODULE_SIZE            108
+#define MDMP_THREAD_SIZE            48
+#define MDMP_MEMORY_DESC_SIZE       16
+#define MDMP_MEMORY_DESC64_SIZE     16
+#define MDMP_FIXED_FILE_INFO_SIZE   52
+
+// CodeView 7.0 record signature ('RSDS')
+#define MDMP_CV_SIGNATURE_RSDS 0x53445352
+
+// Minidumps are always little-endian. These helpers read fields byte by byte,
+// so they work regardless of data alignment and host byte order.
+
+static uint16_t ReadU16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1]<<8));
+}
+
+static uint32_t ReadU32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24);
+}
+
+static uint64_t ReadU64(const uint8_t* p)
+{
+    return (uint64_t)ReadU32(p) | ((uint64_t)ReadU32(p+4)<<32);
+}
+
+static MdmpLocation ReadLocation(const uint8_t* p)
+{
+    MdmpLocation loc;
+    loc.m_uDataSize = ReadU32(p);
+    loc.m_uRva = ReadU32(p+4);
+    return loc;
+}
+
+CMiniDumpParser::CMiniDumpParser()
+{
+    m_pData = NULL;
+    m_uSize = 0;
+#ifdef _WIN32
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hFileMapping = NULL;
+#else
+    m_fd = -1;
+#endif
+    m_bMapped = false;
+}
+
+CMiniDumpParser::~CMiniDumpParser()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+int CMiniDumpParser::OpenFile(const char* szFileName)
+{
+    // Convert UTF-8 file name to UTF-16
+    int nLen = MultiByteToWideChar(CP_UTF8, 0, szFileName, -1, NULL, 0);
+    if(nLen<=0)
+        return MDMP_ERR_OPEN_FILE;
+    std::vector<wchar_t> aFileName(nLen);
+    MultiByteToWideChar(CP_UTF8, 0, szFileName, -1, &aFileName[0], nLen);
+    return OpenFile(&aFileName[0]);
+}
+
+int CMiniDumpParser::OpenFile(const wchar_t* szFileName)
+{
+    Close();
+
+    m_hFile = CreateFileW(szFileName, FILE_GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, 0, NULL);
+    if(m_hFile==INVALID_HANDLE_VALUE)
+    {
+        Close();
+        return MDMP_ERR_OPEN_FILE;
+    }
+
+    LARGE_INTEGER liFileSize;
+    if(!GetFileSizeEx(m_hFile, &liFileSize) || liFileSize.QuadPart==0 ||
+        (unsigned __int64)liFileSize.QuadPart>(size_t)-1)
+    {
+        Close();
+        return MDMP_ERR_MAP_FILE;
+    }
+
+    m_hFileMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(m_hFileMapping==NULL)
+    {
+        Close();
+        return MDMP_ERR_MAP_FILE;
+    }
+
+    m_pData = (const uint8_t*)MapViewOfFile(m_hFileMapping, FILE_MAP_READ, 0, 0, 0);
+    if(m_pData==NULL)
+    {
+        Close();
+        return MDMP_ERR_MAP_FILE;
+    }
+
+    m_uSize = (size_t)liFileSize.QuadPart;
+    m_bMapped = true;
+
+    int nResult = ReadDirectory();
+    if(nResult!=MDMP_OK)
+        Close();
+    return nResult;
+}
+
+#else
+
+int CMiniDumpParser::OpenFile(const char* szFileName)
+{
+    Close();
+
+    m_fd = open(szFileName, O_RDONLY);
+    if(m_fd<0)
+    {
+        Close();
+        return MDMP_ERR_OPEN_FILE;
+    }
+
+    struct stat st;
+    if(fstat(m_fd, &st)!=0 || st.st_size==0 ||
+        (uint64_t)st.st_size>(uint64_t)(size_t)-1)
+    {
+        Close();
+        return MDMP_ERR_MAP_FILE;
+    }
+
+    void* pView = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if(pView==MAP_FAILED)
+    {
+        Close();
+        return MDMP_ERR_MAP_FILE;
+    }
+
+    m_pData = (const uint8_t*)pView;
+    m_uSize = (size_t)st.st_size;
+    m_bMapped = true;
+
+    int nResult = ReadDirectory();
+    if(nResult!=MDMP_OK)
+        Close();
+    return nResult;
+}
+
+#endif
+
+int CMiniDumpParser::Attach(const void* pData, size_t uSize)
+{
+    Close();
+
+    if(pData==NULL || uSize==0)
+        return MDMP_ERR_INVALID_HEADER;
+
+    m_pData = (const uint8_t*)pData;
+    m_uSize = uSize;
+    m_bMapped = false;
+
+    int nResult = ReadDirectory();
+    if(nResult!=MDMP_OK)
+        Close();
+    return nResult;
+}
+
+void CMiniDumpParser::Close()
+{
+#ifdef _WIN32
+    if(m_bMapped && m_pData!=NULL)
+        UnmapViewOfFile(m_pData);
+
+    if(m_hFileMapping!=NULL)
+    {
+        CloseHandle(m_hFileMapping);
+        m_hFileMapping = NULL;
+    }
+
+    if(m_hFile!=INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+#else
+    if(m_bMapped && m_pData!=NULL)
+        munmap((void*)m_pData, m_uSize);
+
+    if(m_fd>=0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+#endif
+
+    m_pData = NULL;
+    m_uSize = 0;
+    m_bMapped = false;
+    m_aDirectory.clear();
+    m_StreamIndex.clear();
+}
+
+bool CMiniDumpParser::IsOpened() const
+{
+    return m_pData!=NULL;
+}
+
+const uint8_t* CMiniDumpParser::GetData() const
+{
+    return m_pData;
+}
+
+size_t CMiniDumpParser::GetSize() const
+{
+    return m_uSize;
+}
+
+const std::vector<MdmpDirEntry>& CMiniDumpParser::GetDirectory() const
+{
+    return m_aDirectory;
+}
+
+const uint8_t* CMiniDumpParser::GetBlock(uint64_t uRva, uint64_t uSize) const
+{
+    if(m_pData==NULL || uRva>m_uSize || uSize>m_uSize-uRva)
+        return NULL; // Out of file bounds
+
+    return m_pData+(size_t)uRva;
+}
+
+int CMiniDumpParser::ReadDirectory()
+{
+    const uint8_t* pHeader = GetBlock(0, MDMP_HEADER_SIZE);
+    if(pHeader==NULL)
+        return MDMP_ERR_INVALID_HEADER;
+
+    uint32_t uSignature = ReadU32(pHeader);
+    uint32_t uVersion = ReadU32(pHeader+4);
+    uint32_t uNumberOfStreams = ReadU32(pHeader+8);
+    uint32_t uStreamDirectoryRva = ReadU32(pHeader+12);
+
+    if(uSignature!=MDMP_SIGNATURE || (uVersion&0xFFFF)!=MDMP_VERSION)
+        return MDMP_ERR_INVALID_HEADER;
+
+    const uint8_t* pDir = GetBlock(uStreamDirectoryRva, (uint64_t)uNumberOfStreams*MDMP_DIR_ENTRY_SIZE);
+    if(pDir==NULL)
+        return MDMP_ERR_INVALID_HEADER;
+
+    m_aDirectory.reserve(uNumberOfStreams);
+
+    uint32_t i;
+    for(i=0; i<uNumberOfStreams; i++)
+    {
+        const uint8_t* pEntry = pDir+i*MDMP_DIR_ENTRY_SIZE;
+
+        MdmpDirEntry entry;
+        entry.m_uStreamType = ReadU32(pEntry);
+        entry.m_Location = ReadLocation(pEntry+4);
+        m_aDirectory.push_back(entry);
+
+        // Like dbghelp, use the first stream of each type. Unused entries
+        // (type 0) are skipped.
+        if(entry.m_uStreamType!=0 &&
+            m_StreamIndex.find(entry.m_uStreamType)==m_StreamIndex.end())
+            m_StreamIndex[entry.m_uStreamType] = m_aDirectory.size()-1;
+    }
+
+    return MDMP_OK;
+}
+
+int CMiniDumpParser::FindStream(uint32_t uStreamType, const uint8_t** ppStream, uint32_t* puStreamSize) const
+{
+    *ppStream = NULL;
+    *puStreamSize = 0;
+
+    std::map<uint32_t, size_t>::const_iterator it = m_StreamIndex.find(uStreamType);
+    if(it==m_StreamIndex.end())
+        return MDMP_ERR_NO_STREAM;
+
+    const MdmpLocation& loc = m_aDirectory[it->second].m_Location;
+    const uint8_t* pStream = GetBlock(loc.m_uRva, loc.m_uDataSize);
+    if(pStream==NULL)
+        return MDMP_ERR_CORRUPTED;
+
+    *ppStream = pStream;
+    *puStreamSize = loc.m_uDataSize;
+    return MDMP_OK;
+}
+
+int CMiniDumpParser::ReadString(uint32_t uRva, std::wstring& sOut) const
+{
+    sOut.clear();
+
+    const uint8_t* pLength = GetBlock(uRva, 4);
+    if(pLength==NULL)
+        return MDMP_ERR_CORRUPTED;
+
+    // Length is in bytes and does not include the terminating zero
+    uint32_t uLength = ReadU32(pLength);
+    const uint8_t* pBuffer = GetBlock((uint64_t)uRva+4, uLength);
+    if(pBuffer==NULL)
+        return MDMP_ERR_CORRUPTED;
+
+    uint32_t uCount = uLength/2;
+    sOut.reserve(uCount);
+
+    uint32_t i;
+    for(i=0; i<uCount; i++)
+    {
+        uint32_t ch = ReadU16(pBuffer+i*2);
+
+        // Stop on embedded terminator, like dbghelp-based code did
+        if(ch==0)
+            break;
+
+        if(sizeof(wchar_t)==4 && ch>=0xD800 && ch<=0xDBFF && i+1<uCount)
+        {
+            // Decode UTF-16 surrogate pair into a single UTF-32 character
+            uint32_t ch2 = ReadU16(pBuffer+(i+1)*2);
+            if(ch2>=0xDC00 && ch2<=0xDFFF)
+            {
+                ch = 0x10000 + ((ch-0xD800)<<10) + (ch2-0xDC00);
+                i++;
+            }
+        }
+
+        sOut += (wchar_t)ch;
+    }
+
+    return MDMP_OK;
+}
+
+int CMiniDumpParser::ReadSysInfoStream(MdmpSysInfoRecord& SysInfo) const
+{
+    const uint8_t* pStream = NULL;
+    uint32_t uStreamSize = 0;
+
+    int nResult = FindStream(MDMP_SYSTEM_INFO_STREAM, &pStream, &uStreamSize);
+    if(nResult!=MDMP_OK)
+        return nResult;
+
+    if(uStreamSize<MDMP_SYSTEM_INFO_SIZE)
+        return MDMP_ERR_CORRUPTED;
+
+    SysInfo.m_uProcessorArchitecture = ReadU16(pStream);
+    SysInfo.m_uchNumberOfProcessors = pStream[6];
+    SysInfo.m_uchProductType = pStream[7];
+    SysInfo.m_ulVerMajor = ReadU32(pStream+8);
+    SysInfo.m_ulVerMinor = ReadU32(pStream+12);
+    SysInfo.m_ulVerBuild = ReadU32(pStream+16);
+    SysInfo.m_ulPlatformId = ReadU32(pStream+20);
+
+    // A missing service pack string is not fatal
+    ReadString(ReadU32(pStream+24), SysInfo.m_sCSDVer);
+
+    return MDMP_OK;
+}
+
+int CMiniDumpParser::ReadExceptionStream(MdmpExceptionRecord& Exception) const
+{
+    const uint8_t* pStream = NULL;
+    uint32_t uStreamSize = 0;
+
+    int nResult = FindStream(MDMP_EXCEPTION_STREAM, &pStream, &uStreamSize);
+    if(nResult!=MDMP_OK)
+        return nResult;
+
+    if(uStreamSize<MDMP_EXCEPTION_STREAM_SIZE)
+        return MDMP_ERR_CORRUPTED;
+
+    // ThreadId and alignment are followed by MINIDUMP_EXCEPTION record
+    Exception.m_uThreadId = ReadU32(pStream);
+    Exception.m_uExceptionCode = ReadU32(pStream+8);
+    Exception.m_uExceptionFlags = ReadU32(pStream+12);
+    Exception.m_uExceptionAddress = ReadU64(pStream+24);
+    Exception.m_ThreadContext = ReadLocation(pStream+160);
+    Exception.m_pThreadContext = GetBlock(Exception.m_ThreadContext.m_uRva,
+        Exception.m_ThreadContext.m_uDataSize);
+
+    return MDMP_OK;
+}
+
+void CMiniDumpParser::ReadCodeViewRecord(const MdmpLocation& loc, MdmpModuleRecord& m) const
+{
+    // CodeView 7.0 record layout: 'RSDS' signature, GUID (16 bytes), age, zero-terminated PDB name
+    const uint8_t* pCv = GetBlock(loc.m_uRva, loc.m_uDataSize);
+    if(pCv==NULL || loc.m_uDataSize<24 || ReadU32(pCv)!=MDMP_CV_SIGNATURE_RSDS)
+        return;
+
+    memcpy(m.m_uchPdbGuid, pCv+4, 16);
+    m.m_uPdbAge = ReadU32(pCv+20);
+
+    const char* szName = (const char*)pCv+24;
+    size_t uMaxLen = loc.m_uDataSize-24;
+    size_t uLen = 0;
+    while(uLen<uMaxLen && szName[uLen]!=0)
+        uLen++;
+    m.m_sPdbName.assign(szName, uLen);
+
+    m.m_bHasPdbInfo = true;
+}
+
+int CMiniDumpParser::ReadModuleListStream(std::vector<MdmpModuleRecord>& aModules) const
+{
+    const uint8_t* pStream = NULL;
+    uint32_t uStreamSize = 0;
+
+    int nResult = FindStream(MDMP_MODULE_LIST_STREAM, &pStream, &uStreamSize);
+    if(nResult!=MDMP_OK)
+        return nResult;
+
+    if(uStreamSize<4)
+        return MDMP_ERR_CORRUPTED;
+
+    uint32_t uNumberOfModules = ReadU32(pStream);
+    if((uint64_t)uNumberOfModules*MDMP_MODULE_SIZE>uStreamSize-4)
+        return MDMP_ERR_CORRUPTED;
+
+    aModules.reserve(aModules.size()+uNumberOfModules);
+
+    uint32_t i;
+    for(i=0; i<uNumberOfModules; i++)
+    {
+        const uint8_t* pModule = pStream+4+i*MDMP_MODULE_SIZE;
+
+        MdmpModuleRecord m;
+        m.m_uBaseAddr = ReadU64(pModule);
+        m.m_uImageSize = ReadU32(pModule+8);
+        m.m_uCheckSum = ReadU32(pModule+12);
+        m.m_uTimeDateStamp = ReadU32(pModule+16);
+        ReadString(ReadU32(pModule+20), m.m_sImageName);
+
+        const uint8_t* pVersionInfo = pModule+24;
+        uint32_t* pField = &m.m_VersionInfo.dwSignature;
+        int j;
+        for(j=0; j<MDMP_FIXED_FILE_INFO_SIZE/4; j++)
+            pField[j] = ReadU32(pVersionInfo+j*4);
+        m.m_uVersionInfoRva = (uint32_t)(pVersionInfo-m_pData);
+
+        ReadCodeViewRecord(ReadLocation(pModule+76), m);
+
+        aModules.push_back(m);
+    }
+
+    return MDMP_OK;
+}
+
+int CMiniDumpParser::ReadThreadListStream(std::vector<MdmpThreadRecord>& aThreads) const
+{
+    const uint8_t* pStream = NULL;
+    uint32_t uStreamSize = 0;
+
+    int nResult = FindStream(MDMP_THREAD_LIST_STREAM, &pStream, &uStreamSize);
+    if(nResult!=MDMP_OK)
+        return nResult;
+
+    if(uStreamSize<4)
+        return MDMP_ERR_CORRUPTED;
+
+    uint32_t uThreadCount = ReadU32(pStream);
+    if((uint64_t)uThreadCount*MDMP_THREAD_SIZE>uStreamSize-4)
+        return MDMP_ERR_CORRUPTED;
+
+    aThreads.reserve(aThreads.size()+uThreadCount);
+
+    uint32_t i;
+    for(i=0; i<uThreadCount; i++)
+    {
+        const uint8_t* pThread = pStream+4+i*MDMP_THREAD_SIZE;
+
+        MdmpThreadRecord t;
+        t.m_uThreadId = ReadU32(pThread);
+        t.m_uTeb = ReadU64(pThread+16);
+        t.m_uStackStart = ReadU64(pThread+24);
+        t.m_Stack = ReadLocation(pThread+32);
+        t.m_ThreadContext = ReadLocation(pThread+40);
+        t.m_pThreadContext = GetBlock(t.m_ThreadContext.m_uRva, t.m_ThreadContext.m_uDataSize);
+
+        aThreads.push_back(t);
+    }
+
+    return MDMP_OK;
+}
+
+int CMiniDumpParser::ReadMemoryListStream(std::vector<MdmpMemRangeRecord>& aMemRanges) const
+{
+    const uint8_t* pStream = NULL;
+    uint32_t uStreamSize = 0;
+
+    int nResult = FindStream(MDMP_MEMORY_LIST_STREAM, &pStream, &uStreamSize);
+    if(nResult!=MDMP_OK)
+        return nResult;
+
+    if(uStreamSize<4)
+        return MDMP_ERR_CORRUPTED;
+
+    uint32_t uNumberOfMemRanges = ReadU32(pStream);
+    if((uint64_t)uNumberOfMemRanges*MDMP_MEMORY_DESC_SIZE>uStreamSize-4)
+        return MDMP_ERR_CORRUPTED;
+
+    aMemRanges.reserve(aMemRanges.size()+uNumberOfMemRanges);
+
+    uint32_t i;
+    for(i=0; i<uNumberOfMemRanges; i++)
+    {
+        const uint8_t* pMemDesc = pStream+4+i*MDMP_MEMORY_DESC_SIZE;
+        MdmpLocation loc = ReadLocation(pMemDesc+8);
+
+        MdmpMemRangeRecord mr;
+        mr.m_uStartOfMemoryRange = ReadU64(pMemDesc);
+        mr.m_uDataSize = loc.m_uDataSize;
+        mr.m_pStartPtr = GetBlock(loc.m_uRva, loc.m_uDataSize);
+        if(mr.m_pStartPtr==NULL)
+            continue; // Skip ranges truncated by incomplete write
+
+        aMemRanges.push_back(mr);
+    }
+
+    return MDMP_OK;
+}
+
+int CMiniDumpParser::ReadMemory64ListStream(std::vector<MdmpMemRangeRecord>& aMemRanges) const
+{
+    const uint8_t* pStream = NULL;
+    uint32_t uStreamSize = 0;
+
+    int nResult = FindStream(MDMP_MEMORY64_LIST_STREAM, &pStream, &uStreamSize);
+    if(nResult!=MDMP_OK)
+        return nResult;
+
+    if(uStreamSize<16)
+        return MDMP_ERR_CORRUPTED;
+
+    uint64_t uNumberOfMemRanges = ReadU64(pStream);
+    uint64_t uBaseRva = ReadU64(pStream+8);
+    if(uNumberOfMemRanges>(uint64_t)(uStreamSize-16)/MDMP_MEMORY_DESC64_SIZE)
+        return MDMP_ERR_CORRUPTED;
+
+    aMemRanges.reserve(aMemRanges.size()+(size_t)uNumberOfMemRanges);
+
+    // Range data is stored contiguously starting at BaseRva
+    uint64_t uRva = uBaseRva;
+    uint64_t i;
+    for(i=0; i<uNumberOfMemRanges; i++)
+    {
+        const uint8_t* pMemDesc = pStream+16+(size_t)i*MDMP_MEMORY_DESC64_SIZE;
+
+        MdmpMemRangeRecord mr;
+        mr.m_uStartOfMemoryRange = ReadU64(pMemDesc);
+        mr.m_uDataSize = ReadU64(pMemDesc+8);
+        mr.m_pStartPtr = GetBlock(uRva, mr.m_uDataSize);
+        if(mr.m_pStartPtr==NULL)
+            break; // All subsequent ranges are out of file bounds too
+
+        aMemRanges.push_back(mr);
+        uRva += mr.m_uDataSize;
+    }
+
+    return MDMP_OK;
+}
+
+//-----------------------------------------------------------------------------
+// CMdmpMemoryIndex
+//-----------------------------------------------------------------------------
+
+// Orders memory ranges by starting address. The original position is used to
+// keep the order of ranges having the same address.
+struct MdmpMemRangeLess
+{
+    MdmpMemRangeLess(const std::vector<MdmpMemRangeRecord>& aRanges)
+        : m_aRanges(aRanges)
+    {
+    }
+
+    bool operator()(size_t a, size_t b) const
+    {
+        if(m_aRanges[a].m_uStartOfMemoryRange!=m_aRanges[b].m_uStartOfMemoryRange)
+            return m_aRanges[a].m_uStartOfMemoryRange<m_aRanges[b].m_uStartOfMemoryRange;
+        return a<b;
+    }
+
+    const std::vector<MdmpMemRangeRecord>& m_aRanges;
+};
+
+// Compares range starting address with an address (used for binary search)
+static bool MdmpAddressLess(uint64_t uAddress, const MdmpMemRangeRecord& mr)
+{
+    return uAddress<mr.m_uStartOfMemoryRange;
+}
+
+void CMdmpMemoryIndex::Build(const std::vector<MdmpMemRangeRecord>& aRanges)
+{
+    m_aRanges.clear();
+    m_aRanges.reserve(aRanges.size());
+
+    std::vector<size_t> aOrder(aRanges.size());
+    size_t i;
+    for(i=0; i<aOrder.size(); i++)
+        aOrder[i] = i;
+    std::sort(aOrder.begin(), aOrder.end(), MdmpMemRangeLess(aRanges));
+
+    // Cut overlapping parts, so each address belongs to a single range. The
+    // range starting at the lower address wins.
+    uint64_t uCoveredEnd = 0;
+    bool bAnyRange = false;
+    for(i=0; i<aOrder.size(); i++)
+    {
+        MdmpMemRangeRecord mr = aRanges[aOrder[i]];
+        if(mr.m_uDataSize==0 || mr.m_pStartPtr==NULL)
+            continue;
+
+        uint64_t uEnd = mr.m_uStartOfMemoryRange+mr.m_uDataSize;
+        if(uEnd<mr.m_uStartOfMemoryRange)
+            uEnd = (uint64_t)-1; // Wraps around the address space
+
+        if(bAnyRange && mr.m_uStartOfMemoryRange<uCoveredEnd)
+        {
+            if(uEnd<=uCoveredEnd)
+                continue; // Completely covered by previous ranges
+
+            uint64_t uSkip = uCoveredEnd-mr.m_uStartOfMemoryRange;
+            mr.m_uStartOfMemoryRange = uCoveredEnd;
+            mr.m_uDataSize -= uSkip;
+            mr.m_pStartPtr += uSkip;
+        }
+
+        m_aRanges.push_back(mr);
+        uCoveredEnd = uEnd;
+        bAnyRange = true;
+    }
+}
+
+void CMdmpMemoryIndex::Clear()
+{
+    m_aRanges.clear();
+}
+
+size_t CMdmpMemoryIndex::GetRangeCount() const
+{
+    return m_aRanges.size();
+}
+
+size_t CMdmpMemoryIndex::FindRangePos(uint64_t uAddress) const
+{
+    // Find the first range starting after the address; the range preceding
+    // it is the only one that may contain the address.
+    std::vector<MdmpMemRangeRecord>::const_iterator it = 
+        std::upper_bound(m_aRanges.begin(), m_aRanges.end(), uAddress, MdmpAddressLess);
+    if(it==m_aRanges.begin())
+        return m_aRanges.size();
+    --it;
+
+    if(uAddress-it->m_uStartOfMemoryRange>=it->m_uDataSize)
+        return m_aRanges.size(); // The address is in a gap between ranges
+
+    return it-m_aRanges.begin();
+}
+
+const MdmpMemRangeRecord* CMdmpMemoryIndex::FindRange(uint64_t uAddress) const
+{
+    size_t uPos = FindRangePos(uAddress);
+    if(uPos==m_aRanges.size())
+        return NULL;
+    return &m_aRanges[uPos];
+}
+
+size_t CMdmpMemoryIndex::Read(uint64_t uAddress, void* pBuffer, size_t uSize) const
+{
+    size_t uPos = FindRangePos(uAddress);
+    size_t uBytesRead = 0;
+
+    while(uPos<m_aRanges.size() && uBytesRead<uSize)
+    {
+        const MdmpMemRangeRecord& mr = m_aRanges[uPos];
+        uint64_t uOffs = uAddress-mr.m_uStartOfMemoryRange;
+        uint64_t uAvail = mr.m_uDataSize-uOffs;
+        size_t uCount = uSize-uBytesRead;
+        if(uAvail<uCount)
+            uCount = (size_t)uAvail;
+
+        memcpy((uint8_t*)pBuffer+uBytesRead, mr.m_pStartPtr+(size_t)uOffs, uCount);
+        uBytesRead += uCount;
+        uAddress += uCount;
+
+        // Continue only if the next range is adjacent to this one
+        uPos++;
+        if(uPos<m_aRanges.size() && m_aRanges[uPos].m_uStartOfMemoryRange!=uAddress)
+            break;
+    }
+
+    return uBytesRead;
+}
@@ -0,0 +1,320 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: MinidumpParser.h
+// Description: Portable minidump stream parser. Reads the stream directory and the
+// system info, exception, module, thread and memory streams without using dbghelp.
+// Also provides a sorted index of memory ranges for fast memory reads during stack
+// walking. Only the parsing is portable: the records are turned into MdmpData by
+// CMiniDumpReader, which needs dbghelp for symbols and stack walking, so
+// CrashRptProbe and crprober still run on Windows only. On other platforms the
+// parser can be used directly, e.g. to inspect dumps written by the Linux handler.
+
+#pragma once
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int8  uint8_t;
+typedef unsigned __int16 uint16_t;
+typedef unsigned __int32 uint32_t;
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// Minidump stream types (see MINIDUMP_STREAM_TYPE in dbghelp.h)
+enum MdmpStreamType
+{
+    MDMP_THREAD_LIST_STREAM   = 3,
+    MDMP_MODULE_LIST_STREAM   = 4,
+    MDMP_MEMORY_LIST_STREAM   = 5,
+    MDMP_EXCEPTION_STREAM     = 6,
+    MDMP_SYSTEM_INFO_STREAM   = 7,
+    MDMP_MEMORY64_LIST_STREAM = 9
+};
+
+// Error codes returned by CMiniDumpParser methods
+enum MdmpParseError
+{
+    MDMP_OK = 0,                 // Success
+    MDMP_ERR_OPEN_FILE = 1,      // Couldn't open the file
+    MDMP_ERR_MAP_FILE = 2,       // Couldn't memory-map the file
+    MDMP_ERR_INVALID_HEADER = 3, // Not a minidump or truncated header
+    MDMP_ERR_NO_STREAM = 4,      // The requested stream is not present
+    MDMP_ERR_CORRUPTED = 5       // The stream references data outside of the file
+};
+
+// Location of a data block inside of the minidump file.
+struct MdmpLocation
+{
+    MdmpLocation()
+    {
+        m_uDataSize = 0;
+        m_uRva = 0;
+    }
+
+    uint32_t m_uDataSize; // Size of data in bytes
+    uint32_t m_uRva;      // Offset from the beginning of file
+};
+
+// Entry of the minidump stream directory
+struct MdmpDirEntry
+{
+    uint32_t m_uStreamType;   // Stream type (one of MdmpStreamType)
+    MdmpLocation m_Location;  // Where the stream data resides
+};
+
+// Fixed version info of a module (layout of VS_FIXEDFILEINFO)
+struct MdmpFixedFileInfo
+{
+    uint32_t dwSignature;
+    uint32_t dwStrucVersion;
+    uint32_t dwFileVersionMS;
+    uint32_t dwFileVersionLS;
+    uint32_t dwProductVersionMS;
+    uint32_t dwProductVersionLS;
+    uint32_t dwFileFlagsMask;
+    uint32_t dwFileFlags;
+    uint32_t dwFileOS;
+    uint32_t dwFileType;
+    uint32_t dwFileSubtype;
+    uint32_t dwFileDateMS;
+    uint32_t dwFileDateLS;
+};
+
+// Contents of the MINIDUMP_SYSTEM_INFO stream
+struct MdmpSysInfoRecord
+{
+    MdmpSysInfoRecord()
+    {
+        m_uProcessorArchitecture = 0;
+        m_uchNumberOfProcessors = 0;
+        m_uchProductType = 0;
+        m_ulVerMajor = 0;
+        m_ulVerMinor = 0;
+        m_ulVerBuild = 0;
+        m_ulPlatformId = 0;
+    }
+
+    uint16_t m_uProcessorArchitecture; // CPU architecture
+    uint8_t  m_uchNumberOfProcessors;  // Number of processors
+    uint8_t  m_uchProductType;         // Type of machine (workstation, server, ...)
+    uint32_t m_ulVerMajor;             // OS major version number
+    uint32_t m_ulVerMinor;             // OS minor version number
+    uint32_t m_ulVerBuild;             // OS build number
+    uint32_t m_ulPlatformId;           // OS platform
+    std::wstring m_sCSDVer;            // The latest service pack installed
+};
+
+// Contents of the MINIDUMP_EXCEPTION_STREAM stream
+struct MdmpExceptionRecord
+{
+    MdmpExceptionRecord()
+    {
+        m_uThreadId = 0;
+        m_uExceptionCode = 0;
+        m_uExceptionFlags = 0;
+        m_uExceptionAddress = 0;
+        m_pThreadContext = NULL;
+    }
+
+    uint32_t m_uThreadId;          // ID of the thread that caused the exception
+    uint32_t m_uExceptionCode;     // Structured exception's code
+    uint32_t m_uExceptionFlags;    // Exception flags
+    uint64_t m_uExceptionAddress;  // Exception address
+    MdmpLocation m_ThreadContext;  // Location of the thread context (CONTEXT structure)
+    const uint8_t* m_pThreadContext; // Pointer to the thread context data, or NULL
+};
+
+// A module from the MINIDUMP_MODULE_LIST stream
+struct MdmpModuleRecord
+{
+    MdmpModuleRecord()
+    {
+        m_uBaseAddr = 0;
+        m_uImageSize = 0;
+        m_uCheckSum = 0;
+        m_uTimeDateStamp = 0;
+        memset(&m_VersionInfo, 0, sizeof(m_VersionInfo));
+        m_uVersionInfoRva = 0;
+        m_bHasPdbInfo = false;
+        memset(m_uchPdbGuid, 0, sizeof(m_uchPdbGuid));
+        m_uPdbAge = 0;
+    }
+
+    uint64_t m_uBaseAddr;       // Base address
+    uint32_t m_uImageSize;      // Size of module
+    uint32_t m_uCheckSum;       // Image checksum
+    uint32_t m_uTimeDateStamp;  // Image time stamp
+    std::wstring m_sImageName;  // Full image name, as stored in minidump
+    MdmpFixedFileInfo m_VersionInfo; // Version info
+    uint32_t m_uVersionInfoRva; // Offset of the version info in minidump file
+    bool m_bHasPdbInfo;         // true if a CodeView (RSDS) record was found
+    uint8_t m_uchPdbGuid[16];   // PDB signature GUID
+    uint32_t m_uPdbAge;         // PDB age
+    std::string m_sPdbName;     // PDB file name (UTF-8), as stored in CodeView record
+};
+
+// A thread from the MINIDUMP_THREAD_LIST stream
+struct MdmpThreadRecord
+{
+    MdmpThreadRecord()
+    {
+        m_uThreadId = 0;
+        m_uTeb = 0;
+        m_uStackStart = 0;
+        m_pThreadContext = NULL;
+    }
+
+    uint32_t m_uThreadId;         // Thread ID
+    uint64_t m_uTeb;              // Thread environment block address
+    uint64_t m_uStackStart;       // Lowest address of the captured stack memory
+    MdmpLocation m_Stack;         // Location of the captured stack memory
+    MdmpLocation m_ThreadContext; // Location of the thread context (CONTEXT structure)
+    const uint8_t* m_pThreadContext; // Pointer to the thread context data, or NULL
+};
+
+// A memory range from the MINIDUMP_MEMORY_LIST or MINIDUMP_MEMORY64_LIST stream
+struct MdmpMemRangeRecord
+{
+    uint64_t m_uStartOfMemoryRange; // Starting address
+    uint64_t m_uDataSize;           // Size of data
+    const uint8_t* m_pStartPtr;     // Pointer to the memrange data stored in minidump
+};
+
+// class CMiniDumpParser
+// Reads minidump streams directly from a memory-mapped file or from a memory buffer.
+// All pointers returned by this class point into the mapped data and remain valid
+// until Close() is called.
+class CMiniDumpParser
+{
+public:
+
+    // Constructor
+    CMiniDumpParser();
+
+    // Destructor
+    ~CMiniDumpParser();
+
+    // Memory-maps the minidump file and reads the stream directory.
+    // The file name is UTF-8 on POSIX systems.
+    int OpenFile(const char* szFileName);
+
+#ifdef _WIN32
+    // Memory-maps the minidump file and reads the stream directory.
+    int OpenFile(const wchar_t* szFileName);
+#endif
+
+    // Reads the stream directory of a minidump that is already in memory. The caller
+    // owns the buffer and must keep it alive while the parser is used.
+    int Attach(const void* pData, size_t uSize);
+
+    // Unmaps the file and releases all resources.
+    void Close();
+
+    // Returns true if a minidump is opened.
+    bool IsOpened() const;
+
+    // Returns pointer to the beginning of minidump data.
+    const uint8_t* GetData() const;
+
+    // Returns size of minidump data in bytes.
+    size_t GetSize() const;
+
+    // Returns the stream directory.
+    const std::vector<MdmpDirEntry>& GetDirectory() const;
+
+    // Looks for a stream of the given type.
+    int FindStream(uint32_t uStreamType, const uint8_t** ppStream, uint32_t* puStreamSize) const;
+
+    // Reads a MINIDUMP_STRING by its RVA.
+    int ReadString(uint32_t uRva, std::wstring& sOut) const;
+
+    // Reads the MINIDUMP_SYSTEM_INFO stream.
+    int ReadSysInfoStream(MdmpSysInfoRecord& SysInfo) const;
+
+    // Reads the MINIDUMP_EXCEPTION_STREAM stream.
+    int ReadExceptionStream(MdmpExceptionRecord& Exception) const;
+
+    // Reads the MINIDUMP_MODULE_LIST stream.
+    int ReadModuleListStream(std::vector<MdmpModuleRecord>& aModules) const;
+
+    // Reads the MINIDUMP_THREAD_LIST stream.
+    int ReadThreadListStream(std::vector<MdmpThreadRecord>& aThreads) const;
+
+    // Reads the MINIDUMP_MEMORY_LIST stream.
+    int ReadMemoryListStream(std::vector<MdmpMemRangeRecord>& aMemRanges) const;
+
+    // Reads the MINIDUMP_MEMORY64_LIST stream (present in full-memory dumps).
+    int ReadMemory64ListStream(std::vector<MdmpMemRangeRecord>& aMemRanges) const;
+
+private:
+
+    // Validates the header and reads the stream directory.
+    int ReadDirectory();
+
+    // Returns pointer to the data block or NULL if it doesn't fit into the file.
+    const uint8_t* GetBlock(uint64_t uRva, uint64_t uSize) const;
+
+    // Reads the CodeView record of a module.
+    void ReadCodeViewRecord(const MdmpLocation& loc, MdmpModuleRecord& m) const;
+
+    const uint8_t* m_pData;     // Pointer to the beginning of minidump data
+    size_t m_uSize;             // Size of minidump data
+    std::vector<MdmpDirEntry> m_aDirectory; // Stream directory
+    std::map<uint32_t, size_t> m_StreamIndex; // <stream_type, dir_entry_index> pairs
+
+#ifdef _WIN32
+    void* m_hFile;              // Handle to the opened file
+    void* m_hFileMapping;       // Handle to the file mapping object
+#else
+    int m_fd;                   // Descriptor of the opened file
+#endif
+    bool m_bMapped;             // true if m_pData is our own mapped view
+};
+
+// class CMdmpMemoryIndex
+// Sorted index of minidump memory ranges. Allows to find the range containing
+// an address in O(log n) time and to read memory blocks spanning several
+// adjacent ranges.
+class CMdmpMemoryIndex
+{
+public:
+
+    // Builds the index. Ranges are sorted by address; overlapping parts are
+    // trimmed, so each address belongs to a single range.
+    void Build(const std::vector<MdmpMemRangeRecord>& aRanges);
+
+    // Removes all ranges from the index.
+    void Clear();
+
+    // Returns the number of indexed ranges.
+    size_t GetRangeCount() const;
+
+    // Returns the range containing the address, or NULL if the address is not
+    // captured in minidump.
+    const MdmpMemRangeRecord* FindRange(uint64_t uAddress) const;
+
+    // Copies up to uSize bytes starting at uAddress. Reading continues into the
+    // next range if it starts right where the previous one ends. Returns the number
+    // of bytes copied (0 if the address is not captured).
+    size_t Read(uint64_t uAddress, void* pBuffer, size_t uSize) const;
+
+private:
+
+    // Returns position of the range containing the address or m_aRanges.size().
+    size_t FindRangePos(uint64_t uAddress) const;
+
+    std::vector<MdmpMemRangeRecord> m_aRanges; // Sorted non-overlapping ranges
+};
@@ -15,7 +15,9 @@ be found in the Authors.txt file in the root of the source tree.
 #include "strconv.h"
 #include "md5.h"
 
-CMiniDumpReader* g_pMiniDumpReader = NULL;
+// dbghelp functions are single-threaded, so calls made by different
+// CMiniDumpReader objects are serialized with this lock.
+CComAutoCriticalSection g_dbghelp_cs;
 
 // Callback function prototypes
 
@@ -49,9 +51,8 @@ CMiniDumpReader::CMiniDumpReader()
     m_bReadModuleListStream = FALSE;
     m_bReadMemoryListStream = FALSE;
     m_bReadThreadListStream = FALSE;
-    m_hFileMiniDump = INVALID_HANDLE_VALUE;
-    m_hFileMapping = NULL;
     m_pMiniDumpStartPtr = NULL;  
+    m_pSymCache = NULL;
 }
 
 CMiniDumpReader::~CMiniDumpReader()
@@ -59,10 +60,13 @@ CMiniDumpReader::~CMiniDumpReader()
     Close();
 }
 
+void CMiniDumpReader::SetSymbolCache(CSymbolCache* pSymCache)
+{
+    m_pSymCache = pSymCache;
+}
+
 int CMiniDumpReader::Open(CString sFileName, CString sSymSearchPath)
 {  
-    static DWORD dwProcessID = 0;
-
     if(m_bLoaded)
     {
 		// Already loaded
@@ -72,61 +76,67 @@ int CMiniDumpReader::Open(CString sFileName, CString sSymSearchPath)
     m_sFileName = sFileName;
     m_sSymSearchPath = sSymSearchPath;
 
-    m_hFileMiniDump = CreateFile(
-        sFileName, 
-        FILE_GENERIC_READ, 
-        0, 
-        NULL, 
-        OPEN_EXISTING, 
-        NULL, 
-        NULL);
-
-    if(m_hFileMiniDump==INVALID_HANDLE_VALUE)
+    // Map the file and read the stream directory. Streams are parsed by
+    // CMiniDumpParser, we use dbghelp for symbol loading and stack walking only.
+    strconv_t strconv;
+    int nParse = m_Parser.OpenFile(strconv.t2w(sFileName));
+    if(nParse!=MDMP_OK)
     {
         Close();
-        return 1;
+        return nParse==MDMP_ERR_OPEN_FILE?1:(nParse==MDMP_ERR_MAP_FILE?2:3);
     }
 
-    m_hFileMapping = CreateFileMapping(
-        m_hFileMiniDump, 
-        NULL, 
-        PAGE_READONLY, 
-        0, 
-        0, 
-        0);
+    return LoadStreams();
+}
 
-    if(m_hFileMapping==NULL)
+int CMiniDumpReader::Open(LPCVOID pData, size_t uSize, CString sSymSearchPath)
+{  
+    if(m_bLoaded)
     {
-        Close();
-        return 2;
+		// Already loaded
+        return 0;
     }
 
-    m_pMiniDumpStartPtr = MapViewOfFile(
-        m_hFileMapping, 
-        FILE_MAP_READ, 
-        0, 
-        0, 
-        0);
+    m_sFileName.Empty();
+    m_sSymSearchPath = sSymSearchPath;
 
-    if(m_pMiniDumpStartPtr==NULL)
-    {    
+    // Read the stream directory right from the buffer, no file is involved
+    int nParse = m_Parser.Attach(pData, uSize);
+    if(nParse!=MDMP_OK)
+    {
         Close();
         return 3;
     }
 
-    m_DumpData.m_hProcess = (HANDLE)(++dwProcessID);  
+    return LoadStreams();
+}
 
+int CMiniDumpReader::LoadStreams()
+{
+    strconv_t strconv;
+
+    m_pMiniDumpStartPtr = (LPVOID)m_Parser.GetData();
+
+    // dbghelp identifies a symbol session by process handle. Use the address of 
+    // this object as a fake handle: it is unique among opened readers, and the
+    // stack walk callbacks use it to find the reader.
+    m_DumpData.m_hProcess = (HANDLE)this;  
+
+    CComCritSecLock<CComAutoCriticalSection> lock(g_dbghelp_cs);
+
+    // Symbols are not loaded until a reference is made requiring the symbols be loaded.
+    // Most modules are never on a walked stack, and the frames found in the symbol
+    // cache don't need symbols, so most PDB files are never loaded.
     DWORD dwOptions = 0;
-    //dwOptions |= SYMOPT_DEFERRED_LOADS; // Symbols are not loaded until a reference is made requiring the symbols be loaded.
+    dwOptions |= SYMOPT_DEFERRED_LOADS;
     dwOptions |= SYMOPT_EXACT_SYMBOLS; // Do not load an unmatched .pdb file. 
     dwOptions |= SYMOPT_FAIL_CRITICAL_ERRORS; // Do not display system dialog boxes when there is a media failure such as no media in a drive.
     dwOptions |= SYMOPT_UNDNAME; // All symbols are presented in undecorated form.   
     SymSetOptions(dwOptions);
 
-    strconv_t strconv;
     BOOL bSymInit = SymInitializeW(
         m_DumpData.m_hProcess,
-        strconv.t2w(sSymSearchPath), 
+        strconv.t2w(m_sSymSearchPath), 
         FALSE);
 
     if(!bSymInit)
@@ -141,6 +151,8 @@ int CMiniDumpReader::Open(CString sFileName, CString sSymSearchPath)
     SymRegisterCallbackProc64,
     (ULONG64)this);*/
 
+    lock.Unlock();
+
     m_bReadSysInfoStream = !ReadSysInfoStream();  
     m_bReadModuleListStream = !ReadModuleListStream();
     m_bReadThreadListStream = !ReadThreadListStream();
@@ -217,24 +229,14 @@ int CMiniDumpReader::Open(CString sFileName, CString sSymSearchPath)
 
 void CMiniDumpReader::Close()
 {
-    UnmapViewOfFile(m_pMiniDumpStartPtr);
-
-    if(m_hFileMapping!=NULL)
-    {
-        CloseHandle(m_hFileMapping);
-    }
-
-    if(m_hFileMiniDump!=INVALID_HANDLE_VALUE)
-    {
-        CloseHandle(m_hFileMiniDump);
-		m_hFileMiniDump = INVALID_HANDLE_VALUE;
-    }
-
+    m_Parser.Close();
     m_pMiniDumpStartPtr = NULL;
 
-    if(m_DumpData.m_hProcess!=NULL)
+    if(m_DumpData.m_hProcess!=NULL && m_DumpData.m_hProcess!=INVALID_HANDLE_VALUE)
     {
+        CComCritSecLock<CComAutoCriticalSection> lock(g_dbghelp_cs);
         SymCleanup(m_DumpData.m_hProcess);
+        m_DumpData.m_hProcess = NULL;
     }
 }
 
@@ -246,6 +248,7 @@ BOOL CMiniDumpReader::CheckDbgHelpApiVersion()
     CompiledApiVer.MinorVersion = 1;
     CompiledApiVer.Revision = 11;    
     CompiledApiVer.Reserved = 0;
+    CComCritSecLock<CComAutoCriticalSection> lock(g_dbghelp_cs);
     LPAPI_VERSION pActualApiVer = ImagehlpApiVersionEx(&CompiledApiVer);    
     if(CompiledApiVer.MajorVersion!=pActualApiVer->MajorVersion ||
         CompiledApiVer.MinorVersion!=pActualApiVer->MinorVersion ||
@@ -257,95 +260,27 @@ BOOL CMiniDumpReader::CheckDbgHelpApiVersion()
     return TRUE;
 }
 
-// Extracts a UNICODE string stored in minidump file by its relative address
-CString CMiniDumpReader::GetMinidumpString(LPVOID start_addr, RVA rva)
-{
-    MINIDUMP_STRING* pms = (MINIDUMP_STRING*)((LPBYTE)start_addr+rva);
-    //CString sModule = CString(pms->Buffer, pms->Length);
-    CString sModule = pms->Buffer;  
-    return sModule;
-}
-
 int CMiniDumpReader::ReadSysInfoStream()
 {
-    LPVOID pStreamStart = NULL;
-    ULONG uStreamSize = 0;
-    MINIDUMP_DIRECTORY* pmd = NULL;
-    BOOL bRead = FALSE;
+    MdmpSysInfoRecord SysInfo;
+    if(m_Parser.ReadSysInfoStream(SysInfo)!=MDMP_OK)
+        return 1;
 
-    bRead = MiniDumpReadDumpStream(m_pMiniDumpStartPtr, SystemInfoStream, 
-        &pmd, &pStreamStart, &uStreamSize);
-
-    if(bRead)
-    {
-        MINIDUMP_SYSTEM_INFO* pSysInfo = (MINIDUMP_SYSTEM_INFO*)pStreamStart;
-
-        m_DumpData.m_uProcessorArchitecture = pSysInfo->ProcessorArchitecture;
-        m_DumpData.m_uchNumberOfProcessors = pSysInfo->NumberOfProcessors;
-        m_DumpData.m_uchProductType = pSysInfo->ProductType;
-        m_DumpData.m_ulVerMajor = pSysInfo->MajorVersion;
-        m_DumpData.m_ulVerMinor = pSysInfo->MinorVersion;
-        m_DumpData.m_ulVerBuild = pSysInfo->BuildNumber;
-        m_DumpData.m_sCSDVer = GetMinidumpString(m_pMiniDumpStartPtr, pSysInfo->CSDVersionRva);
-
-        // Clean up
-        pStreamStart = NULL;
-        uStreamSize = 0;    
-        pmd = NULL;
-    }
-    else 
-    {
-        return 1;    
-    }
+    m_DumpData.m_uProcessorArchitecture = SysInfo.m_uProcessorArchitecture;
+    m_DumpData.m_uchNumberOfProcessors = SysInfo.m_uchNumberOfProcessors;
+    m_DumpData.m_uchProductType = SysInfo.m_uchProductType;
+    m_DumpData.m_ulVerMajor = SysInfo.m_ulVerMajor;
+    m_DumpData.m_ulVerMinor = SysInfo.m_ulVerMinor;
+    m_DumpData.m_ulVerBuild = SysInfo.m_ulVerBuild;
+    m_DumpData.m_sCSDVer = SysInfo.m_sCSDVer.c_str();
 
     return 0;
 }
 
 int CMiniDumpReader::ReadExceptionStream()
 {
-    LPVOID pStreamStart = NULL;
-    ULONG uStreamSize = 0;
-    MINIDUMP_DIRECTORY* pmd = NULL;
-    BOOL bRead = FALSE;
-
-    bRead = MiniDumpReadDumpStream(
-        m_pMiniDumpStartPtr, 
-        ExceptionStream, 
-        &pmd, 
-        &pStreamStart, 
-        &uStreamSize);
-
-    if(bRead)
-    {
-        MINIDUMP_EXCEPTION_STREAM* pExceptionStream = (MINIDUMP_EXCEPTION_STREAM*)pStreamStart;
-        if(pExceptionStream!=NULL && 
-            uStreamSize>=sizeof(MINIDUMP_EXCEPTION_STREAM))
-        {
-            m_DumpData.m_uExceptionThreadId = pExceptionStream->ThreadId;
-            m_DumpData.m_uExceptionCode = pExceptionStream->ExceptionRecord.ExceptionCode;
-            m_DumpData.m_uExceptionAddress = pExceptionStream->ExceptionRecord.ExceptionAddress;          
-            m_DumpData.m_pExceptionThreadContext = 
-                (CONTEXT*)(((LPBYTE)m_pMiniDumpStartPtr)+pExceptionStream->ThreadContext.Rva);      
-
-            CString sMsg;
-            int nExcModuleRowID = GetModuleRowIdByAddress(m_DumpData.m_uExceptionAddress);
-            if(nExcModuleRowID>=0)
-            {
-                sMsg.Format(_T("Unhandled exception at 0x%I64x in %s: 0x%x : %s"),
-                    m_DumpData.m_uExceptionAddress,
-                    m_DumpData.m_Modules[nExcModuleRowID].m_sModuleName,
-                    m_DumpData.m_uExceptionCode,
-                    _T("Exception description.")
-                    );
-            }
-            else
-            {
-
-            }
-            m_DumpData.m_LoadLog.push_back(sMsg);
-        }    
-    }
-    else
+    MdmpExceptionRecord Exception;
+    if(m_Parser.ReadExceptionStream(Exception)!=MDMP_OK)
     {
         CString sMsg;
         sMsg = _T("No exception information found in minidump.");
@@ -353,120 +288,154 @@ int CMiniDumpReader::ReadExceptionStream()
         return 1;
     }
 
+    m_DumpData.m_uExceptionThreadId = Exception.m_uThreadId;
+    m_DumpData.m_uExceptionCode = Exception.m_uExceptionCode;
+    m_DumpData.m_uExceptionAddress = Exception.m_uExceptionAddress;          
+    m_DumpData.m_pExceptionThreadContext = (CONTEXT*)Exception.m_pThreadContext;      
+
+    CString sMsg;
+    int nExcModuleRowID = GetModuleRowIdByAddress(m_DumpData.m_uExceptionAddress);
+    if(nExcModuleRowID>=0)
+    {
+        sMsg.Format(_T("Unhandled exception at 0x%I64x in %s: 0x%x : %s"),
+            m_DumpData.m_uExceptionAddress,
+            m_DumpData.m_Modules[nExcModuleRowID].m_sModuleName,
+            m_DumpData.m_uExceptionCode,
+            _T("Exception description.")
+            );
+    }
+    m_DumpData.m_LoadLog.push_back(sMsg);
+
     return 0;
 }
 
 int CMiniDumpReader::ReadModuleListStream()
 {
-    LPVOID pStreamStart = NULL;
-    ULONG uStreamSize = 0;
-    MINIDUMP_DIRECTORY* pmd = NULL;
-    BOOL bRead = FALSE;
     strconv_t strconv;
 
-    bRead = MiniDumpReadDumpStream(
-        m_pMiniDumpStartPtr, 
-        ModuleListStream, 
-        &pmd, 
-        &pStreamStart, 
-        &uStreamSize);
+    std::vector<MdmpModuleRecord> aModules;
+    if(m_Parser.ReadModuleListStream(aModules)!=MDMP_OK)
+        return 1;
 
-    if(bRead)
+    size_t i;
+    for(i=0; i<aModules.size(); i++)
     {
-        MINIDUMP_MODULE_LIST* pModuleStream = (MINIDUMP_MODULE_LIST*)pStreamStart;
-        if(pModuleStream!=NULL)
-        {
-            ULONG32 uNumberOfModules = pModuleStream->NumberOfModules;
-            ULONG32 i;
-            for(i=0; i<uNumberOfModules; i++)
-            {
-                MINIDUMP_MODULE* pModule = 
-                    (MINIDUMP_MODULE*)((LPBYTE)pModuleStream->Modules+i*sizeof(MINIDUMP_MODULE));
-
-                CString sModuleName = GetMinidumpString(m_pMiniDumpStartPtr, pModule->ModuleNameRva);               
-                LPCWSTR szModuleName = strconv.t2w(sModuleName);
-                DWORD64 dwBaseAddr = pModule->BaseOfImage;
-                DWORD64 dwImageSize = pModule->SizeOfImage;
-
-                CString sShortModuleName = sModuleName;
-                int pos = -1;
-                pos = sModuleName.ReverseFind('\\');
-                if(pos>=0)
-                    sShortModuleName = sShortModuleName.Mid(pos+1);          
-
-                /*DWORD64 dwLoadResult = */SymLoadModuleExW(
-                    m_DumpData.m_hProcess,
-                    NULL,
-                    (PWSTR)szModuleName,
-                    NULL,
-                    dwBaseAddr,
-                    (DWORD)dwImageSize,
-                    NULL,
-                    0);         
-
-                IMAGEHLP_MODULE64 modinfo;
-                memset(&modinfo, 0, sizeof(IMAGEHLP_MODULE64));
-                modinfo.SizeOfStruct = sizeof(IMAGEHLP_MODULE64);
-                BOOL bModuleInfo = SymGetModuleInfo64(m_DumpData.m_hProcess,
-                    dwBaseAddr, 
-                    &modinfo);
-                MdmpModule m;
-                if(!bModuleInfo)
-                {          
-                    m.m_bImageUnmatched = TRUE;
-                    m.m_bNoSymbolInfo = TRUE;
-                    m.m_bPdbUnmatched = TRUE;
-                    m.m_pVersionInfo = NULL;
-                    m.m_sImageName = sModuleName;
-                    m.m_sModuleName = sShortModuleName;
-                    m.m_uBaseAddr = dwBaseAddr;
-                    m.m_uImageSize = dwImageSize;          
-                }
-                else
-                {          
-                    m.m_uBaseAddr = modinfo.BaseOfImage;
-                    m.m_uImageSize = modinfo.ImageSize;        
-                    m.m_sModuleName = sShortModuleName;
-                    m.m_sImageName = modinfo.ImageName;
-                    m.m_sLoadedImageName = modinfo.LoadedImageName;
-                    m.m_sLoadedPdbName = modinfo.LoadedPdbName;
-                    m.m_pVersionInfo = &pModule->VersionInfo;
-                    m.m_bPdbUnmatched = modinfo.PdbUnmatched;          
-                    BOOL bTimeStampMatched = pModule->TimeDateStamp == modinfo.TimeDateStamp;
-                    m.m_bImageUnmatched = !bTimeStampMatched;
-                    m.m_bNoSymbolInfo = !modinfo.GlobalSymbols;
-                }        
-
-                m_DumpData.m_Modules.push_back(m);
-                m_DumpData.m_ModuleIndex[m.m_uBaseAddr] = m_DumpData.m_Modules.size()-1;          
-
-                CString sMsg;
-                if(m.m_bImageUnmatched)
-                    sMsg.Format(_T("Loaded '*%s'"), sModuleName);
-                else
-                    sMsg.Format(_T("Loaded '%s'"), m.m_sLoadedImageName);
-
-                if(m.m_bImageUnmatched)
-                    sMsg += _T(", No matching binary found.");          
-                else if(m.m_bPdbUnmatched)
-                    sMsg += _T(", No matching PDB file found.");          
-                else
-                {
-                    if(m.m_bNoSymbolInfo)            
-                        sMsg += _T(", No symbols loaded.");          
-                    else
-                        sMsg += _T(", Symbols loaded.");          
-                }
-                m_DumpData.m_LoadLog.push_back(sMsg);
-            }
-        }
+        MdmpModuleRecord& rec = aModules[i];
+
+        CString sModuleName = rec.m_sImageName.c_str();               
+        LPCWSTR szModuleName = strconv.t2w(sModuleName);
+        DWORD64 dwBaseAddr = rec.m_uBaseAddr;
+        DWORD64 dwImageSize = rec.m_uImageSize;
+
+        CString sShortModuleName = sModuleName;
+        int pos = -1;
+        pos = sModuleName.ReverseFind('\\');
+        if(pos>=0)
+            sShortModuleName = sShortModuleName.Mid(pos+1);          
+
+        CComCritSecLock<CComAutoCriticalSection> lock(g_dbghelp_cs);
+
+        /*DWORD64 dwLoadResult = */SymLoadModuleExW(
+            m_DumpData.m_hProcess,
+            NULL,
+            (PWSTR)szModuleName,
+            NULL,
+            dwBaseAddr,
+            (DWORD)dwImageSize,
+            NULL,
+            0);         
+
+        lock.Unlock();
+
+        MdmpModule m;
+        m.m_uBaseAddr = dwBaseAddr;
+        m.m_uImageSize = dwImageSize;
+        m.m_sModuleName = sShortModuleName;
+        m.m_sImageName = sModuleName;
+        m.m_bImageUnmatched = TRUE;
+        m.m_bPdbUnmatched = TRUE;
+        m.m_bNoSymbolInfo = TRUE;
+        m.m_bSymbolsDeferred = FALSE;
+        m.m_pVersionInfo = (VS_FIXEDFILEINFO*)((LPBYTE)m_pMiniDumpStartPtr+rec.m_uVersionInfoRva);
+        m.m_uTimeDateStamp = rec.m_uTimeDateStamp;
+        m.m_uSymCacheKey = CSymbolCache::MakeModuleKey(rec);
+        m.m_uLoadLogIndex = m_DumpData.m_LoadLog.size();
+
+        m_DumpData.m_LoadLog.push_back(CString());
+        m_DumpData.m_Modules.push_back(m);
+        m_DumpData.m_ModuleIndex[m.m_uBaseAddr] = m_DumpData.m_Modules.size()-1;          
+
+        UpdateModuleInfo(m_DumpData.m_Modules.size()-1);
     }
+
+    return 0;
+}
+
+void CMiniDumpReader::UpdateModuleInfo(size_t uModuleIndex)
+{
+    MdmpModule& m = m_DumpData.m_Modules[uModuleIndex];
+
+    IMAGEHLP_MODULE64 modinfo;
+    memset(&modinfo, 0, sizeof(IMAGEHLP_MODULE64));
+    modinfo.SizeOfStruct = sizeof(IMAGEHLP_MODULE64);
+    CComCritSecLock<CComAutoCriticalSection> lock(g_dbghelp_cs);
+    BOOL bModuleInfo = SymGetModuleInfo64(m_DumpData.m_hProcess,
+        m.m_uBaseAddr, 
+        &modinfo);
+    lock.Unlock();
+
+    if(!bModuleInfo)
+    {          
+        m.m_bImageUnmatched = TRUE;
+        m.m_bNoSymbolInfo = TRUE;
+        m.m_bPdbUnmatched = TRUE;
+        m.m_bSymbolsDeferred = FALSE;
+        m.m_pVersionInfo = NULL;
+    }
+    else if(modinfo.SymType==SymDeferred)
+    {
+        // Nothing is known about the image and PDB file until they are loaded
+        m.m_bImageUnmatched = FALSE;
+        m.m_bPdbUnmatched = FALSE;
+        m.m_bNoSymbolInfo = TRUE;
+        m.m_bSymbolsDeferred = TRUE;
+    }
+    else
+    {          
+        m.m_uBaseAddr = modinfo.BaseOfImage;
+        m.m_uImageSize = modinfo.ImageSize;        
+        m.m_sImageName = modinfo.ImageName;
+        m.m_sLoadedImageName = modinfo.LoadedImageName;
+        m.m_sLoadedPdbName = modinfo.LoadedPdbName;
+        m.m_bPdbUnmatched = modinfo.PdbUnmatched;          
+        BOOL bTimeStampMatched = m.m_uTimeDateStamp == modinfo.TimeDateStamp;
+        m.m_bImageUnmatched = !bTimeStampMatched;
+        m.m_bNoSymbolInfo = !modinfo.GlobalSymbols;
+        m.m_bSymbolsDeferred = FALSE;
+    }        
+
+    CString sMsg;
+    if(m.m_bImageUnmatched)
+        sMsg.Format(_T("Loaded '*%s'"), m.m_sImageName);
+    else if(m.m_bSymbolsDeferred)
+        sMsg.Format(_T("Loaded '%s'"), m.m_sImageName);
+    else
+        sMsg.Format(_T("Loaded '%s'"), m.m_sLoadedImageName);
+
+    if(m.m_bImageUnmatched)
+        sMsg += _T(", No matching binary found.");          
+    else if(m.m_bSymbolsDeferred)
+        sMsg += _T(", Symbols not loaded yet.");          
+    else if(m.m_bPdbUnmatched)
+        sMsg += _T(", No matching PDB file found.");          
     else
     {
-        return 1;
+        if(m.m_bNoSymbolInfo)            
+            sMsg += _T(", No symbols loaded.");          
+        else
+            sMsg += _T(", Symbols loaded.");          
     }
-
-    return 0;
+    m_DumpData.m_LoadLog[m.m_uLoadLogIndex] = sMsg;
 }
 
 int CMiniDumpReader::GetModuleRowIdByBaseAddr(DWORD64 dwBaseAddr)
@@ -479,13 +448,15 @@ int CMiniDumpReader::GetModuleRowIdByBaseAddr(DWORD64 dwBaseAddr)
 
 int CMiniDumpReader::GetModuleRowIdByAddress(DWORD64 dwAddress)
 {
-    UINT i;
-    for(i=0;i<m_DumpData.m_Modules.size();i++)
-    {
-        if(m_DumpData.m_Modules[i].m_uBaseAddr<=dwAddress && 
-            dwAddress<m_DumpData.m_Modules[i].m_uBaseAddr+m_DumpData.m_Modules[i].m_uImageSize)
-            return i;
-    }
+    // Find the module with the greatest base address not above the address
+    std::map<DWORD64, size_t>::iterator it = m_DumpData.m_ModuleIndex.upper_bound(dwAddress);
+    if(it==m_DumpData.m_ModuleIndex.begin())
+        return -1;
+    it--;
+
+    MdmpModule& m = m_DumpData.m_Modules[it->second];
+    if(dwAddress<m.m_uBaseAddr+m.m_uImageSize)
+        return (int)it->second;
 
     return -1;
 }
@@ -500,84 +471,47 @@ int CMiniDumpReader::GetThreadRowIdByThreadId(DWORD dwThreadId)
 
 int CMiniDumpReader::ReadMemoryListStream()
 {
-    LPVOID pStreamStart = NULL;
-    ULONG uStreamSize = 0;
-    MINIDUMP_DIRECTORY* pmd = NULL;
-    BOOL bRead = FALSE;
-
-    bRead = MiniDumpReadDumpStream(
-        m_pMiniDumpStartPtr, 
-        MemoryListStream, 
-        &pmd, 
-        &pStreamStart, 
-        &uStreamSize);
-
-    if(bRead)
-    {
-        MINIDUMP_MEMORY_LIST* pMemStream = (MINIDUMP_MEMORY_LIST*)pStreamStart;
-        if(pMemStream!=NULL)
-        {
-            ULONG32 uNumberOfMemRanges = pMemStream->NumberOfMemoryRanges;
-            ULONG i;
-            for(i=0; i<uNumberOfMemRanges; i++)
-            {
-                MINIDUMP_MEMORY_DESCRIPTOR* pMemDesc = (MINIDUMP_MEMORY_DESCRIPTOR*)(&pMemStream->MemoryRanges[i]);
-                MdmpMemRange mr;
-                mr.m_u64StartOfMemoryRange = pMemDesc->StartOfMemoryRange;
-                mr.m_uDataSize = pMemDesc->Memory.DataSize;
-                mr.m_pStartPtr = (LPBYTE)m_pMiniDumpStartPtr+pMemDesc->Memory.Rva;
+    // Minidumps normally contain MINIDUMP_MEMORY_LIST stream. Full-memory
+    // dumps store memory in MINIDUMP_MEMORY64_LIST stream instead.
+    std::vector<MdmpMemRangeRecord> aMemRanges;
+    BOOL bRead = m_Parser.ReadMemoryListStream(aMemRanges)==MDMP_OK;
+    bRead |= m_Parser.ReadMemory64ListStream(aMemRanges)==MDMP_OK;
+    if(!bRead)
+        return 1;
 
-                m_DumpData.m_MemRanges.push_back(mr);
-            }
-        }
-    }
-    else    
+    size_t i;
+    for(i=0; i<aMemRanges.size(); i++)
     {
-        return 1;
+        MdmpMemRange mr;
+        mr.m_u64StartOfMemoryRange = aMemRanges[i].m_uStartOfMemoryRange;
+        mr.m_uDataSize = aMemRanges[i].m_uDataSize;
+        mr.m_pStartPtr = (LPVOID)aMemRanges[i].m_pStartPtr;
+
+        m_DumpData.m_MemRanges.push_back(mr);
     }
 
+    // The stack walker reads memory very often, so build an index to avoid
+    // scanning the whole list on every read.
+    m_DumpData.m_MemIndex.Build(aMemRanges);
+
     return 0;
 }
 
 int CMiniDumpReader::ReadThreadListStream()
 {
-    LPVOID pStreamStart = NULL;
-    ULONG uStreamSize = 0;
-    MINIDUMP_DIRECTORY* pmd = NULL;
-    BOOL bRead = FALSE;
-
-    bRead = MiniDumpReadDumpStream(
-        m_pMiniDumpStartPtr, 
-        ThreadListStream, 
-        &pmd, 
-        &pStreamStart, 
-        &uStreamSize);
-
-    if(bRead)
-    {
-        MINIDUMP_THREAD_LIST* pThreadList = (MINIDUMP_THREAD_LIST*)pStreamStart;
-        if(pThreadList!=NULL && 
-            uStreamSize>=sizeof(MINIDUMP_THREAD_LIST))
-        {
-            ULONG32 uThreadCount = pThreadList->NumberOfThreads;
-
-            ULONG32 i;
-            for(i=0; i<uThreadCount; i++)
-            {
-                MINIDUMP_THREAD* pThread = (MINIDUMP_THREAD*)(&pThreadList->Threads[i]);
-
-                MdmpThread mt;
-                mt.m_dwThreadId = pThread->ThreadId;
-                mt.m_pThreadContext = (CONTEXT*)(((LPBYTE)m_pMiniDumpStartPtr)+pThread->ThreadContext.Rva);
+    std::vector<MdmpThreadRecord> aThreads;
+    if(m_Parser.ReadThreadListStream(aThreads)!=MDMP_OK)
+        return 1;
 
-                m_DumpData.m_Threads.push_back(mt);
-                m_DumpData.m_ThreadIndex[mt.m_dwThreadId] = m_DumpData.m_Threads.size()-1;        
-            }
-        }  
-    }
-    else
+    size_t i;
+    for(i=0; i<aThreads.size(); i++)
     {
-        return 1;
+        MdmpThread mt;
+        mt.m_dwThreadId = aThreads[i].m_uThreadId;
+        mt.m_pThreadContext = (CONTEXT*)aThreads[i].m_pThreadContext;
+
+        m_DumpData.m_Threads.push_back(mt);
+        m_DumpData.m_ThreadIndex[mt.m_dwThreadId] = m_DumpData.m_Threads.size()-1;        
     }
 
     return 0;
@@ -603,8 +537,6 @@ int CMiniDumpReader::StackWalk(DWORD dwThreadId)
     CONTEXT Context;
     memcpy(&Context, pThreadContext, sizeof(CONTEXT));
 
-    g_pMiniDumpReader = this;
-
     // Init stack frame with correct initial values
     // See this:
     // http://www.codeproject.com/KB/threads/StackWalker.aspx
@@ -663,6 +595,10 @@ int CMiniDumpReader::StackWalk(DWORD dwThreadId)
 
     for(;;)
     {    
+        // Hold the lock while walking one frame, so stack walks of different
+        // readers may interleave.
+        CComCritSecLock<CComAutoCriticalSection> lock(g_dbghelp_cs);
+
         BOOL bWalk = ::StackWalk64(
             dwMachineType,               // machine type
             m_DumpData.m_hProcess,       // our process handle
@@ -678,19 +614,41 @@ int CMiniDumpReader::StackWalk(DWORD dwThreadId)
         if(!bWalk)
             break;      
 
+        lock.Unlock();
+
         MdmpStackFrame stack_frame;
+        strconv_t strconv;
         stack_frame.m_dwAddrPCOffset = sf.AddrPC.Offset;
+        stack_frame.m_nModuleRowID = GetModuleRowIdByAddress(sf.AddrPC.Offset);
+
+        // Frames of the same module build are often resolved again and again 
+        // (the same crash reported many times), so look in the symbol cache first.
+        MdmpModule* pModule = NULL;
+        DWORD64 dwRva = 0;
+        if(stack_frame.m_nModuleRowID>=0)
+        {
+            pModule = &m_DumpData.m_Modules[stack_frame.m_nModuleRowID];
+            dwRva = sf.AddrPC.Offset-pModule->m_uBaseAddr;
+        }
 
-        // Get module info
-        IMAGEHLP_MODULE64 mi;
-        memset(&mi, 0, sizeof(IMAGEHLP_MODULE64));
-        mi.SizeOfStruct = sizeof(IMAGEHLP_MODULE64);
-        BOOL bGetModuleInfo = SymGetModuleInfo64(m_DumpData.m_hProcess, sf.AddrPC.Offset, &mi);     
-        if(bGetModuleInfo)
+        SymCacheEntry cached;
+        if(m_pSymCache!=NULL && pModule!=NULL &&
+            m_pSymCache->Lookup(pModule->m_uSymCacheKey, dwRva, cached))
         {
-            stack_frame.m_nModuleRowID = GetModuleRowIdByBaseAddr(mi.BaseOfImage);      
+            stack_frame.m_sSymbolName = strconv.utf82t(cached.m_sSymbolName.c_str());
+            stack_frame.m_dw64OffsInSymbol = cached.m_uOffsInSymbol;
+            if(cached.m_nSourceLine>=0)
+            {
+                stack_frame.m_sSrcFileName = strconv.utf82t(cached.m_sSourceFile.c_str());
+                stack_frame.m_nSrcLineNumber = cached.m_nSourceLine;
+            }
+
+            m_DumpData.m_Threads[nThreadIndex].m_StackTrace.push_back(stack_frame);
+            continue;
         }
 
+        lock.Lock();
+
         // Get symbol info
         DWORD64 dwDisp64;
         BYTE buffer[4096];
@@ -724,12 +682,43 @@ int CMiniDumpReader::StackWalk(DWORD dwThreadId)
             stack_frame.m_nSrcLineNumber = line.LineNumber;
         }
 
+        lock.Unlock();
+
+        // The lookup has loaded the symbols of a deferred module
+        if(pModule!=NULL && pModule->m_bSymbolsDeferred)
+            UpdateModuleInfo(stack_frame.m_nModuleRowID);
+
+        // Cache only symbols resolved from matching PDB files. Export symbols 
+        // found without PDB would hide the real ones once the PDB is available.
+        if(m_pSymCache!=NULL && pModule!=NULL && bGetSym &&
+            !pModule->m_bPdbUnmatched && !pModule->m_bNoSymbolInfo)
+        {
+            SymCacheEntry entry;
+            entry.m_sSymbolName = strconv.t2utf8(stack_frame.m_sSymbolName);
+            entry.m_uOffsInSymbol = stack_frame.m_dw64OffsInSymbol;
+            if(bGetLine)
+            {
+                entry.m_sSourceFile = strconv.t2utf8(stack_frame.m_sSrcFileName);
+                entry.m_nSourceLine = stack_frame.m_nSrcLineNumber;
+            }
+            m_pSymCache->Add(pModule->m_uSymCacheKey, dwRva, entry);
+        }
+
         m_DumpData.m_Threads[nThreadIndex].m_StackTrace.push_back(stack_frame);
     }
 
+    UINT i;
+
+    // Walking the stack loads deferred modules it passes, even if all their frames
+    // were found in the symbol cache
+    for(i=0; i<m_DumpData.m_Threads[nThreadIndex].m_StackTrace.size(); i++)
+    {
+        int nModuleRowID = m_DumpData.m_Threads[nThreadIndex].m_StackTrace[i].m_nModuleRowID;
+        if(nModuleRowID>=0 && m_DumpData.m_Modules[nModuleRowID].m_bSymbolsDeferred)
+            UpdateModuleInfo(nModuleRowID);
+    }
 
     CString sStackTrace;
-    UINT i;
     for(i=0; i<m_DumpData.m_Threads[nThreadIndex].m_StackTrace.size(); i++)
     {
         MdmpStackFrame& frame = m_DumpData.m_Threads[nThreadIndex].m_StackTrace[i];
@@ -804,6 +793,29 @@ int CMiniDumpReader::StackWalk(DWORD dwThreadId)
         }
     }
 
+    // The MD5 above depends on offsets and source lines, so it differs between
+    // builds. The crash bucket is made of normalized module!symbol names only.
+    {
+        CCrashSignature signature;
+        for(i=0; i<m_DumpData.m_Threads[nThreadIndex].m_StackTrace.size(); i++)
+        {
+            strconv_t strconv;
+            MdmpStackFrame& frame = m_DumpData.m_Threads[nThreadIndex].m_StackTrace[i];
+            CString sModuleName;
+            if(frame.m_nModuleRowID>=0)
+                sModuleName = m_DumpData.m_Modules[frame.m_nModuleRowID].m_sModuleName;
+            signature.AddFrame(strconv.t2utf8(sModuleName), strconv.t2utf8(frame.m_sSymbolName));
+        }
+
+        strconv_t strconv;
+        std::string sSignature;
+        std::string sBucketId;
+        MdmpThread& thread = m_DumpData.m_Threads[nThreadIndex];
+        thread.m_nBucketFrameCount = signature.Build(sSignature, sBucketId);
+        thread.m_sBucketSignature = strconv.utf82t(sSignature.c_str());
+        thread.m_sBucketId = strconv.utf82t(sBucketId.c_str());
+    }
+
     m_DumpData.m_Threads[nThreadIndex].m_bStackWalk = TRUE;
 
 
@@ -821,8 +833,11 @@ BOOL CALLBACK ReadProcessMemoryProc64(
 {
     *lpNumberOfBytesRead = 0;
 
+    // The process handle is the pointer to the reader (see CMiniDumpReader::Open())
+    CMiniDumpReader* pReader = (CMiniDumpReader*)hProcess;
+
     // Validate input parameters
-    if(hProcess!=g_pMiniDumpReader->m_DumpData.m_hProcess ||
+    if(pReader==NULL ||
         lpBaseAddress==NULL ||
         lpBuffer==NULL ||
         nSize==0)
@@ -831,30 +846,13 @@ BOOL CALLBACK ReadProcessMemoryProc64(
         return FALSE;
     }
 
-    ULONG i;
-    for(i=0; i<g_pMiniDumpReader->m_DumpData.m_MemRanges.size(); i++)
+    // Look up the range in the index. A read may span several adjacent ranges.
+    size_t uBytesRead = pReader->m_DumpData.m_MemIndex.Read(
+        lpBaseAddress, lpBuffer, nSize);
+    if(uBytesRead!=0)
     {
-        MdmpMemRange& mr = g_pMiniDumpReader->m_DumpData.m_MemRanges[i];
-        if(lpBaseAddress>=mr.m_u64StartOfMemoryRange &&
-            lpBaseAddress<mr.m_u64StartOfMemoryRange+mr.m_uDataSize)
-        {
-            DWORD64 dwOffs = lpBaseAddress-mr.m_u64StartOfMemoryRange;
-
-            LONG64 lBytesRead = 0;
-
-            if(mr.m_uDataSize-dwOffs>nSize)
-                lBytesRead = nSize;
-            else
-                lBytesRead = mr.m_uDataSize-dwOffs;
-
-            if(lBytesRead<=0 || nSize<lBytesRead)
-                return FALSE;
-
-            *lpNumberOfBytesRead = (DWORD)lBytesRead;
-            memcpy(lpBuffer, (LPBYTE)mr.m_pStartPtr+dwOffs, (size_t)lBytesRead);
-
-            return TRUE;
-        }
+        *lpNumberOfBytesRead = (DWORD)uBytesRead;
+        return TRUE;
     }
 
     return FALSE;
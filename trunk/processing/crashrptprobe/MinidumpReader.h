@@ -13,6 +13,9 @@ be found in the Authors.txt file in the root of the source tree.
 
 #include "stdafx.h"
 #include "dbghelp.h"
+#include "MinidumpParser.h"
+#include "SymbolCache.h"
+#include "CrashBucket.h"
 #include <map>
 #include <vector>
 
@@ -28,7 +31,11 @@ struct MdmpModule
     BOOL m_bImageUnmatched;     // If TRUE than there wasn't matching binary found.
     BOOL m_bPdbUnmatched;       // If TRUE than there wasn't matching PDB file found.
     BOOL m_bNoSymbolInfo;       // If TRUE than no symbols were generated for this module.
+    BOOL m_bSymbolsDeferred;    // If TRUE than symbols were not needed yet and are not loaded.
     VS_FIXEDFILEINFO* m_pVersionInfo; // Version info for module.
+    ULONG32 m_uTimeDateStamp;   // Time stamp of the image recorded in minidump.
+    ULONG64 m_uSymCacheKey;     // Identifies the module build in symbol cache.
+    size_t m_uLoadLogIndex;     // Index of the module's entry in the load log.
 };
 
 // Describes a stack frame
@@ -57,12 +64,16 @@ struct MdmpThread
         m_dwThreadId = 0;
         m_pThreadContext = NULL;
         m_bStackWalk = FALSE;
+        m_nBucketFrameCount = 0;
     }
 
     DWORD m_dwThreadId;        // Thread ID.
     CONTEXT* m_pThreadContext; // Thread context
     BOOL m_bStackWalk;         // Was stack trace retrieved for this thread?
     CString m_sStackTraceMD5;
+    CString m_sBucketId;        // Crash bucket ID (hash of normalized top frames).
+    CString m_sBucketSignature; // Normalized top frames separated by '\n'.
+    int m_nBucketFrameCount;    // Number of frames in bucket signature.
     std::vector<MdmpStackFrame> m_StackTrace; // Stack trace for this thread.
 };
 
@@ -70,11 +81,12 @@ struct MdmpThread
 struct MdmpMemRange
 {
     ULONG64 m_u64StartOfMemoryRange; // Starting address
-    ULONG32 m_uDataSize;             // Size of data
+    ULONG64 m_uDataSize;             // Size of data
     LPVOID m_pStartPtr;              // Pointer to the memrange data stored in minidump
 };
 
-// Minidump data
+// Minidump data. Filled by CMiniDumpReader (Windows only, it uses dbghelp for
+// symbols and stack walking); there is no reader on other platforms.
 struct MdmpData
 {   
     MdmpData()
@@ -91,7 +103,7 @@ struct MdmpData
         m_pExceptionThreadContext = NULL;
     }
 
-    HANDLE m_hProcess; // Process ID
+    HANDLE m_hProcess; // Fake process handle identifying dbghelp symbol session
 
     USHORT m_uProcessorArchitecture; // CPU architecture
     UCHAR  m_uchNumberOfProcessors;  // Number of processors
@@ -111,10 +123,12 @@ struct MdmpData
     std::vector<MdmpModule> m_Modules;       // The list of loaded modules.
     std::map<DWORD64, size_t> m_ModuleIndex; // <base_addr, module_entry_index> pairs
     std::vector<MdmpMemRange> m_MemRanges;   // The list of memory ranges.  
+    CMdmpMemoryIndex m_MemIndex;             // Sorted index of memory ranges (for fast memory reads).
     std::vector<CString> m_LoadLog; // Load log
 };
 
-// Class for opening minidumps
+// Class for opening minidumps. Different objects may be used concurrently from
+// different threads; a single object must not be shared between threads.
 class CMiniDumpReader
 {
 public:
@@ -128,6 +142,14 @@ public:
     // Opens a minidump (DMP) file
     int Open(CString sFileName, CString sSymSearchPath);
 
+    // Opens a minidump that is already in memory (e.g. inflated from ZIP).
+    // The buffer must remain valid until Close() is called.
+    int Open(LPCVOID pData, size_t uSize, CString sSymSearchPath);
+
+    // Sets the cache of resolved symbols shared by readers (may be NULL).
+    // Should be called before Open().
+    void SetSymbolCache(CSymbolCache* pSymCache);
+
     // Retreives stack trace for specified thread ID
     int StackWalk(DWORD dwThreadId);  
 
@@ -146,15 +168,15 @@ public:
     BOOL m_bReadSysInfoStream;    // Was system info stream read?
     BOOL m_bReadExceptionStream;  // Was exception stream read?
     BOOL m_bReadModuleListStream; // Was module list stream read?
-    BOOL m_bReadMemoryListStream; // Was memory list stream read?
+    BOOL m_bReadMemoryListStream; // Was memory list (or memory64 list) stream read?
     BOOL m_bReadThreadListStream; // Was thread list stream read?  
 
 private:
 
     /* Internally used member functions */
 
-    // Helper function which extracts a UNICODE string from the minidump
-    CString GetMinidumpString(LPVOID pStartAddr, RVA rva);
+    // Initializes dbghelp and reads minidump streams once the data is available
+    int LoadStreams();
 
     // Reads MINIDUMP_SYSTEM_INFO stream
     int ReadSysInfoStream();
@@ -165,7 +187,11 @@ private:
     // Reads MINIDUMP_MODULE_LIST stream
     int ReadModuleListStream();
 
-    // Reads MINIDUMP_MEMORY_LIST stream
+    // Updates the module and its load log entry with the info from dbghelp. Called
+    // again when symbols of a deferred module have been loaded.
+    void UpdateModuleInfo(size_t uModuleIndex);
+
+    // Reads MINIDUMP_MEMORY_LIST and MINIDUMP_MEMORY64_LIST streams
     int ReadMemoryListStream();
 
     // Reads MINIDUMP_THREAD_LIST stream
@@ -175,9 +201,9 @@ private:
 
     CString m_sFileName;    // Minidump file name.
     CString m_sSymSearchPath; // The list of symbol search dirs passed.
-    HANDLE m_hFileMiniDump; // Handle to opened .DMP file
-    HANDLE m_hFileMapping;  // Handle to memory mapping object
+    CMiniDumpParser m_Parser; // Reads minidump streams from memory-mapped .DMP file
     LPVOID m_pMiniDumpStartPtr; // Pointer to the biginning of memory-mapped minidump  
+    CSymbolCache* m_pSymCache; // Cache of resolved symbols, or NULL
 
 };
 
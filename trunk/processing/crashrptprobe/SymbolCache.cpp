@@ -0,0 +1,721 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "SymbolCache.h"
+#include <stdio.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#endif
+
+// Cache file signature ('SYMC') and format version
+#define SYMCACHE_SIGNATURE 0x434d5953
+#define SYMCACHE_VERSION   1
+
+// Size of on-disk structures. The file consists of the header, the hash table
+// (uint32 index+1 of the first entry in the chain, or 0), the entry records and
+// the pool of zero-terminated UTF-8 strings. All integers are little-endian.
+#define SYMCACHE_HEADER_SIZE 32
+#define SYMCACHE_BUCKET_SIZE 4
+#define SYMCACHE_ENTRY_SIZE  40
+
+// Offsets of entry record fields
+#define SYMCACHE_ENTRY_MODULE_KEY 0  // uint64 module key
+#define SYMCACHE_ENTRY_RVA        8  // uint64 RVA
+#define SYMCACHE_ENTRY_OFFS       16 // uint64 offset in symbol
+#define SYMCACHE_ENTRY_SYMBOL     24 // uint32 offset of symbol name in string pool
+#define SYMCACHE_ENTRY_FILE       28 // uint32 offset of source file name in string pool
+#define SYMCACHE_ENTRY_LINE       32 // int32 source line
+#define SYMCACHE_ENTRY_NEXT       36 // uint32 index+1 of the next entry in the chain, or 0
+
+// Little-endian readers and writers
+static uint32_t GetU32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24);
+}
+
+static uint64_t GetU64(const uint8_t* p)
+{
+    return (uint64_t)GetU32(p) | ((uint64_t)GetU32(p+4)<<32);
+}
+
+static void PutU32(uint8_t* p, uint32_t u)
+{
+    p[0] = (uint8_t)(u&0xFF);
+    p[1] = (uint8_t)((u>>8)&0xFF);
+    p[2] = (uint8_t)((u>>16)&0xFF);
+    p[3] = (uint8_t)(u>>24);
+}
+
+static void PutU64(uint8_t* p, uint64_t u)
+{
+    PutU32(p, (uint32_t)(u&0xFFFFFFFF));
+    PutU32(p+4, (uint32_t)(u>>32));
+}
+
+// class CSymCacheLock
+// Locks the cache for the lifetime of the object.
+class CSymCacheLock
+{
+public:
+
+    CSymCacheLock(void* pLock)
+    {
+        m_pLock = pLock;
+#ifdef _WIN32
+        EnterCriticalSection((CRITICAL_SECTION*)m_pLock);
+#else
+        pthread_mutex_lock((pthread_mutex_t*)m_pLock);
+#endif
+    }
+
+    ~CSymCacheLock()
+    {
+#ifdef _WIN32
+        LeaveCriticalSection((CRITICAL_SECTION*)m_pLock);
+#else
+        pthread_mutex_unlock((pthread_mutex_t*)m_pLock);
+#endif
+    }
+
+private:
+
+    void* m_pLock;
+};
+
+// class CSymCacheFileLock
+// Locks the lock file of the cache for the lifetime of the object, so processes
+// sharing the cache save it one at a time. The lock file is left in place.
+class CSymCacheFileLock
+{
+public:
+
+    CSymCacheFileLock(const std::string& sFileName);
+    ~CSymCacheFileLock();
+
+    bool IsLocked() const
+    {
+        return m_bLocked;
+    }
+
+private:
+
+    bool m_bLocked;
+#ifdef _WIN32
+    HANDLE m_hFile;
+#else
+    int m_fd;
+#endif
+};
+
+CSymbolCache::CSymbolCache()
+{
+    m_pData = NULL;
+    m_uSize = 0;
+    m_uBucketCount = 0;
+    m_uEntryCount = 0;
+    m_pBuckets = NULL;
+    m_pEntries = NULL;
+    m_pStrings = NULL;
+    m_uStringsSize = 0;
+    m_uHits = 0;
+    m_uMisses = 0;
+#ifdef _WIN32
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hFileMapping = NULL;
+    m_pLock = new CRITICAL_SECTION;
+    InitializeCriticalSection((CRITICAL_SECTION*)m_pLock);
+#else
+    m_fd = -1;
+    m_pLock = new pthread_mutex_t;
+    pthread_mutex_init((pthread_mutex_t*)m_pLock, NULL);
+#endif
+}
+
+CSymbolCache::~CSymbolCache()
+{
+    Close();
+
+#ifdef _WIN32
+    DeleteCriticalSection((CRITICAL_SECTION*)m_pLock);
+    delete (CRITICAL_SECTION*)m_pLock;
+#else
+    pthread_mutex_destroy((pthread_mutex_t*)m_pLock);
+    delete (pthread_mutex_t*)m_pLock;
+#endif
+}
+
+int CSymbolCache::Open(const char* szFileName)
+{
+    Close();
+
+    if(szFileName==NULL)
+        return SYMCACHE_ERR_OPEN_FILE;
+
+    m_sFileName = szFileName;
+    return MapFile();
+}
+
+void CSymbolCache::Close()
+{
+    UnmapFile();
+    m_sFileName.clear();
+    m_NewEntries.clear();
+    m_uHits = 0;
+    m_uMisses = 0;
+}
+
+#ifdef _WIN32
+
+// Converts UTF-8 string to UTF-16
+static std::wstring Utf8ToWide(const std::string& s)
+{
+    int nLen = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, NULL, 0);
+    if(nLen<=0)
+        return std::wstring();
+    std::vector<wchar_t> aBuf(nLen);
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &aBuf[0], nLen);
+    return std::wstring(&aBuf[0]);
+}
+
+CSymCacheFileLock::CSymCacheFileLock(const std::string& sFileName)
+{
+    m_bLocked = false;
+    m_hFile = CreateFileW(Utf8ToWide(sFileName).c_str(), GENERIC_READ|GENERIC_WRITE,
+        FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, 0, NULL);
+    if(m_hFile==INVALID_HANDLE_VALUE)
+        return;
+
+    // Waits until the lock is released
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    m_bLocked = LockFileEx(m_hFile, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov)!=FALSE;
+}
+
+CSymCacheFileLock::~CSymCacheFileLock()
+{
+    if(m_bLocked)
+    {
+        OVERLAPPED ov;
+        memset(&ov, 0, sizeof(ov));
+        UnlockFileEx(m_hFile, 0, 1, 0, &ov);
+    }
+    if(m_hFile!=INVALID_HANDLE_VALUE)
+        CloseHandle(m_hFile);
+}
+
+int CSymbolCache::MapFile()
+{
+    m_hFile = CreateFileW(Utf8ToWide(m_sFileName).c_str(), FILE_GENERIC_READ,
+        FILE_SHARE_READ|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+    if(m_hFile==INVALID_HANDLE_VALUE)
+    {
+        // There is no cache yet
+        return GetLastError()==ERROR_FILE_NOT_FOUND?SYMCACHE_OK:SYMCACHE_ERR_OPEN_FILE;
+    }
+
+    LARGE_INTEGER liFileSize;
+    if(!GetFileSizeEx(m_hFile, &liFileSize) || liFileSize.QuadPart<SYMCACHE_HEADER_SIZE ||
+        (unsigned __int64)liFileSize.QuadPart>0xFFFFFFFF)
+    {
+        UnmapFile();
+        return SYMCACHE_ERR_INVALID_FILE;
+    }
+
+    m_hFileMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(m_hFileMapping!=NULL)
+        m_pData = (const uint8_t*)MapViewOfFile(m_hFileMapping, FILE_MAP_READ, 0, 0, 0);
+    if(m_pData==NULL)
+    {
+        UnmapFile();
+        return SYMCACHE_ERR_OPEN_FILE;
+    }
+
+    m_uSize = (size_t)liFileSize.QuadPart;
+
+    if(!ValidateFile())
+    {
+        UnmapFile();
+        return SYMCACHE_ERR_INVALID_FILE;
+    }
+
+    return SYMCACHE_OK;
+}
+
+void CSymbolCache::UnmapFile()
+{
+    if(m_pData!=NULL)
+        UnmapViewOfFile(m_pData);
+    if(m_hFileMapping!=NULL)
+        CloseHandle(m_hFileMapping);
+    if(m_hFile!=INVALID_HANDLE_VALUE)
+        CloseHandle(m_hFile);
+
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hFileMapping = NULL;
+    m_pData = NULL;
+    m_uSize = 0;
+    m_uBucketCount = 0;
+    m_uEntryCount = 0;
+}
+
+#else
+
+CSymCacheFileLock::CSymCacheFileLock(const std::string& sFileName)
+{
+    m_bLocked = false;
+    m_fd = open(sFileName.c_str(), O_RDWR|O_CREAT|O_CLOEXEC, 0644);
+    if(m_fd<0)
+        return;
+
+    // Waits until the lock is released
+    int nResult;
+    while((nResult=flock(m_fd, LOCK_EX))!=0 && errno==EINTR)
+        ;
+    m_bLocked = nResult==0;
+}
+
+CSymCacheFileLock::~CSymCacheFileLock()
+{
+    // Closing the descriptor releases the lock
+    if(m_fd>=0)
+        close(m_fd);
+}
+
+int CSymbolCache::MapFile()
+{
+    m_fd = open(m_sFileName.c_str(), O_RDONLY);
+    if(m_fd<0)
+    {
+        // There is no cache yet
+        return errno==ENOENT?SYMCACHE_OK:SYMCACHE_ERR_OPEN_FILE;
+    }
+
+    struct stat st;
+    if(fstat(m_fd, &st)!=0 || st.st_size<SYMCACHE_HEADER_SIZE ||
+        (uint64_t)st.st_size>0xFFFFFFFF)
+    {
+        UnmapFile();
+        return SYMCACHE_ERR_INVALID_FILE;
+    }
+
+    void* pView = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if(pView==MAP_FAILED)
+    {
+        UnmapFile();
+        return SYMCACHE_ERR_OPEN_FILE;
+    }
+
+    m_pData = (const uint8_t*)pView;
+    m_uSize = (size_t)st.st_size;
+
+    if(!ValidateFile())
+    {
+        UnmapFile();
+        return SYMCACHE_ERR_INVALID_FILE;
+    }
+
+    return SYMCACHE_OK;
+}
+
+void CSymbolCache::UnmapFile()
+{
+    if(m_pData!=NULL)
+        munmap((void*)m_pData, m_uSize);
+    if(m_fd>=0)
+        close(m_fd);
+
+    m_fd = -1;
+    m_pData = NULL;
+    m_uSize = 0;
+    m_uBucketCount = 0;
+    m_uEntryCount = 0;
+}
+
+#endif
+
+bool CSymbolCache::ValidateFile()
+{
+    if(GetU32(m_pData)!=SYMCACHE_SIGNATURE || GetU32(m_pData+4)!=SYMCACHE_VERSION)
+        return false;
+
+    uint32_t uBucketCount = GetU32(m_pData+8);
+    uint32_t uEntryCount = GetU32(m_pData+12);
+    uint32_t uStringsSize = GetU32(m_pData+16);
+
+    // Hash table size must be a power of two
+    if(uBucketCount==0 || (uBucketCount&(uBucketCount-1))!=0)
+        return false;
+
+    // The sections must fit into the file exactly
+    uint64_t uExpectedSize = (uint64_t)SYMCACHE_HEADER_SIZE +
+        (uint64_t)uBucketCount*SYMCACHE_BUCKET_SIZE +
+        (uint64_t)uEntryCount*SYMCACHE_ENTRY_SIZE + uStringsSize;
+    if(uExpectedSize!=m_uSize || uStringsSize==0)
+        return false;
+
+    m_uBucketCount = uBucketCount;
+    m_uEntryCount = uEntryCount;
+    m_uStringsSize = uStringsSize;
+    m_pBuckets = m_pData+SYMCACHE_HEADER_SIZE;
+    m_pEntries = m_pBuckets+(size_t)uBucketCount*SYMCACHE_BUCKET_SIZE;
+    m_pStrings = m_pEntries+(size_t)uEntryCount*SYMCACHE_ENTRY_SIZE;
+
+    // The string pool must end with zero, so GetString() never reads past it
+    return m_pStrings[uStringsSize-1]==0;
+}
+
+uint32_t CSymbolCache::GetBucket(uint64_t uModuleKey, uint64_t uRva, uint32_t uBucketCount)
+{
+    uint64_t h = uModuleKey ^ (uRva*0x9E3779B97F4A7C15ULL);
+    h ^= h>>29;
+    return (uint32_t)h & (uBucketCount-1);
+}
+
+const char* CSymbolCache::GetString(uint32_t uOffset) const
+{
+    if(uOffset>=m_uStringsSize)
+        return NULL;
+    return (const char*)m_pStrings+uOffset;
+}
+
+void CSymbolCache::ReadFileEntries(std::map<SymCacheKey, SymCacheEntry>& Entries) const
+{
+    uint32_t i;
+    for(i=0; i<m_uEntryCount; i++)
+    {
+        const uint8_t* p = m_pEntries+(size_t)i*SYMCACHE_ENTRY_SIZE;
+        const char* pszSymbol = GetString(GetU32(p+SYMCACHE_ENTRY_SYMBOL));
+        const char* pszFile = GetString(GetU32(p+SYMCACHE_ENTRY_FILE));
+        if(pszSymbol==NULL || pszFile==NULL)
+            continue; // Skip corrupted entry
+
+        SymCacheEntry& e = Entries[SymCacheKey(GetU64(p+SYMCACHE_ENTRY_MODULE_KEY), GetU64(p+SYMCACHE_ENTRY_RVA))];
+        e.m_sSymbolName = pszSymbol;
+        e.m_uOffsInSymbol = GetU64(p+SYMCACHE_ENTRY_OFFS);
+        e.m_sSourceFile = pszFile;
+        e.m_nSourceLine = (int32_t)GetU32(p+SYMCACHE_ENTRY_LINE);
+    }
+}
+
+bool CSymbolCache::FindInFile(uint64_t uModuleKey, uint64_t uRva, SymCacheEntry& Entry) const
+{
+    if(m_pData==NULL)
+        return false;
+
+    uint32_t uBucket = GetBucket(uModuleKey, uRva, m_uBucketCount);
+    uint32_t uIndex = GetU32(m_pBuckets+(size_t)uBucket*SYMCACHE_BUCKET_SIZE);
+    uint32_t uSteps = 0;
+
+    // Limit the number of steps, so a corrupted chain can't loop forever
+    while(uIndex!=0 && uIndex<=m_uEntryCount && uSteps++<m_uEntryCount)
+    {
+        const uint8_t* p = m_pEntries+(size_t)(uIndex-1)*SYMCACHE_ENTRY_SIZE;
+        if(GetU64(p+SYMCACHE_ENTRY_MODULE_KEY)==uModuleKey && GetU64(p+SYMCACHE_ENTRY_RVA)==uRva)
+        {
+            const char* pszSymbol = GetString(GetU32(p+SYMCACHE_ENTRY_SYMBOL));
+            const char* pszFile = GetString(GetU32(p+SYMCACHE_ENTRY_FILE));
+            if(pszSymbol==NULL || pszFile==NULL)
+                return false;
+
+            Entry.m_sSymbolName = pszSymbol;
+            Entry.m_uOffsInSymbol = GetU64(p+SYMCACHE_ENTRY_OFFS);
+            Entry.m_sSourceFile = pszFile;
+            Entry.m_nSourceLine = (int32_t)GetU32(p+SYMCACHE_ENTRY_LINE);
+            return true;
+        }
+
+        uIndex = GetU32(p+SYMCACHE_ENTRY_NEXT);
+    }
+
+    return false;
+}
+
+bool CSymbolCache::Lookup(uint64_t uModuleKey, uint64_t uRva, SymCacheEntry& Entry)
+{
+    // The mapped file is read-only, so it is searched without locking
+    bool bFound = FindInFile(uModuleKey, uRva, Entry);
+
+    CSymCacheLock lock(m_pLock);
+
+    if(!bFound)
+    {
+        std::map<SymCacheKey, SymCacheEntry>::const_iterator it =
+            m_NewEntries.find(SymCacheKey(uModuleKey, uRva));
+        if(it!=m_NewEntries.end())
+        {
+            Entry = it->second;
+            bFound = true;
+        }
+    }
+
+    if(bFound)
+        m_uHits++;
+    else
+        m_uMisses++;
+
+    return bFound;
+}
+
+void CSymbolCache::Add(uint64_t uModuleKey, uint64_t uRva, const SymCacheEntry& Entry)
+{
+    CSymCacheLock lock(m_pLock);
+    m_NewEntries[SymCacheKey(uModuleKey, uRva)] = Entry;
+}
+
+size_t CSymbolCache::GetEntryCount()
+{
+    CSymCacheLock lock(m_pLock);
+
+    // New entries may replace entries of the file, but this is rare
+    return m_uEntryCount+m_NewEntries.size();
+}
+
+uint64_t CSymbolCache::GetHitCount()
+{
+    CSymCacheLock lock(m_pLock);
+    return m_uHits;
+}
+
+uint64_t CSymbolCache::GetMissCount()
+{
+    CSymCacheLock lock(m_pLock);
+    return m_uMisses;
+}
+
+// Converts a wide string to UTF-8
+static std::string WideToUtf8(const std::wstring& sText)
+{
+    std::string sUtf8;
+
+#ifdef _WIN32
+    if(sText.empty())
+        return sUtf8;
+    int nLen = WideCharToMultiByte(CP_UTF8, 0, sText.c_str(), (int)sText.length(), NULL, 0, NULL, NULL);
+    if(nLen<=0)
+        return sUtf8;
+    sUtf8.resize(nLen);
+    WideCharToMultiByte(CP_UTF8, 0, sText.c_str(), (int)sText.length(), &sUtf8[0], nLen, NULL, NULL);
+#else
+    // wchar_t holds UTF-32 here
+    size_t i;
+    for(i=0; i<sText.length(); i++)
+    {
+        uint32_t ch = (uint32_t)sText[i];
+        if(ch>0x10FFFF || (ch>=0xD800 && ch<=0xDFFF))
+            ch = 0xFFFD;
+
+        if(ch<0x80)
+            sUtf8 += (char)ch;
+        else if(ch<0x800)
+        {
+            sUtf8 += (char)(0xC0|(ch>>6));
+            sUtf8 += (char)(0x80|(ch&0x3F));
+        }
+        else if(ch<0x10000)
+        {
+            sUtf8 += (char)(0xE0|(ch>>12));
+            sUtf8 += (char)(0x80|((ch>>6)&0x3F));
+            sUtf8 += (char)(0x80|(ch&0x3F));
+        }
+        else
+        {
+            sUtf8 += (char)(0xF0|(ch>>18));
+            sUtf8 += (char)(0x80|((ch>>12)&0x3F));
+            sUtf8 += (char)(0x80|((ch>>6)&0x3F));
+            sUtf8 += (char)(0x80|(ch&0x3F));
+        }
+    }
+#endif
+
+    return sUtf8;
+}
+
+uint64_t CSymbolCache::MakeModuleKey(const MdmpModuleRecord& rec)
+{
+    std::string sIdentity;
+    char szBuff[64];
+
+    if(rec.m_bHasPdbInfo)
+    {
+        int i;
+        for(i=0; i<16; i++)
+        {
+            sprintf(szBuff, "%02x", rec.m_uchPdbGuid[i]);
+            sIdentity += szBuff;
+        }
+        sprintf(szBuff, "|%x", rec.m_uPdbAge);
+        sIdentity += szBuff;
+    }
+    else
+    {
+        // Image path may differ between machines, so use the file name only
+        std::string sImageName = WideToUtf8(rec.m_sImageName);
+        std::string::size_type pos = sImageName.find_last_of("\\/");
+        sIdentity = pos==std::string::npos?sImageName:sImageName.substr(pos+1);
+        sprintf(szBuff, "|%x|%x", rec.m_uTimeDateStamp, rec.m_uImageSize);
+        sIdentity += szBuff;
+    }
+
+    return MakeModuleKey(sIdentity.c_str());
+}
+
+uint64_t CSymbolCache::MakeModuleKey(const char* szIdentity)
+{
+    // 64-bit FNV-1a hash of the lowercased string
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const char* p;
+    for(p=szIdentity; *p!=0; p++)
+    {
+        char ch = *p;
+        if(ch>='A' && ch<='Z')
+            ch = (char)(ch-'A'+'a');
+        h ^= (uint8_t)ch;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+int CSymbolCache::Save()
+{
+    if(m_sFileName.empty())
+        return SYMCACHE_ERR_WRITE_FILE;
+
+    CSymCacheLock lock(m_pLock);
+
+    if(m_NewEntries.empty())
+        return SYMCACHE_OK; // Nothing to add
+
+    // Other processes save the file under the same lock
+    CSymCacheFileLock FileLock(m_sFileName+".lock");
+    if(!FileLock.IsLocked())
+        return SYMCACHE_ERR_WRITE_FILE;
+
+    // Merge the entries of the file mapped by Open() with the entries of the file
+    // as it is on disk now and with the new ones
+    std::map<SymCacheKey, SymCacheEntry> Entries;
+    ReadFileEntries(Entries);
+    UnmapFile();
+    MapFile();
+    ReadFileEntries(Entries);
+
+    std::map<SymCacheKey, SymCacheEntry>::const_iterator it;
+    uint32_t i;
+    for(it=m_NewEntries.begin(); it!=m_NewEntries.end(); it++)
+        Entries[it->first] = it->second;
+
+    // Hash table is at least twice as large as the number of entries
+    uint32_t uEntryCount = (uint32_t)Entries.size();
+    uint32_t uBucketCount = 16;
+    while(uBucketCount<uEntryCount*2)
+        uBucketCount *= 2;
+
+    // Build the string pool. Offset 0 is the empty string.
+    std::string sStrings(1, '\0');
+    std::map<std::string, uint32_t> StringIndex;
+    StringIndex[std::string()] = 0;
+
+    std::vector<uint8_t> aBuckets((size_t)uBucketCount*SYMCACHE_BUCKET_SIZE, 0);
+    std::vector<uint8_t> aEntries((size_t)uEntryCount*SYMCACHE_ENTRY_SIZE, 0);
+
+    for(it=Entries.begin(), i=0; it!=Entries.end(); it++, i++)
+    {
+        const SymCacheEntry& e = it->second;
+        uint32_t uOffs[2] = {0, 0};
+        const std::string* aStr[2] = {&e.m_sSymbolName, &e.m_sSourceFile};
+        int j;
+        for(j=0; j<2; j++)
+        {
+            std::map<std::string, uint32_t>::iterator sit = StringIndex.find(*aStr[j]);
+            if(sit==StringIndex.end())
+            {
+                uOffs[j] = (uint32_t)sStrings.size();
+                StringIndex[*aStr[j]] = uOffs[j];
+                sStrings.append(*aStr[j]);
+                sStrings.append(1, '\0');
+            }
+            else
+            {
+                uOffs[j] = sit->second;
+            }
+        }
+
+        // Insert the entry to the head of its chain
+        uint8_t* pBucket = &aBuckets[(size_t)GetBucket(it->first.first, it->first.second, uBucketCount)*SYMCACHE_BUCKET_SIZE];
+        uint8_t* p = &aEntries[(size_t)i*SYMCACHE_ENTRY_SIZE];
+        PutU64(p+SYMCACHE_ENTRY_MODULE_KEY, it->first.first);
+        PutU64(p+SYMCACHE_ENTRY_RVA, it->first.second);
+        PutU64(p+SYMCACHE_ENTRY_OFFS, e.m_uOffsInSymbol);
+        PutU32(p+SYMCACHE_ENTRY_SYMBOL, uOffs[0]);
+        PutU32(p+SYMCACHE_ENTRY_FILE, uOffs[1]);
+        PutU32(p+SYMCACHE_ENTRY_LINE, (uint32_t)e.m_nSourceLine);
+        PutU32(p+SYMCACHE_ENTRY_NEXT, GetU32(pBucket));
+        PutU32(pBucket, i+1);
+    }
+
+    uint8_t header[SYMCACHE_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    PutU32(header, SYMCACHE_SIGNATURE);
+    PutU32(header+4, SYMCACHE_VERSION);
+    PutU32(header+8, uBucketCount);
+    PutU32(header+12, uEntryCount);
+    PutU32(header+16, (uint32_t)sStrings.size());
+
+    // Write to a temporary file and replace the cache with it, so readers
+    // never see a partially written file
+    std::string sTmpFileName = m_sFileName+".tmp";
+    bool bWritten = false;
+#ifdef _WIN32
+    FILE* f = _wfopen(Utf8ToWide(sTmpFileName).c_str(), L"wb");
+#else
+    FILE* f = fopen(sTmpFileName.c_str(), "wb");
+#endif
+    if(f!=NULL)
+    {
+        bWritten = fwrite(header, 1, sizeof(header), f)==sizeof(header) &&
+            fwrite(&aBuckets[0], 1, aBuckets.size(), f)==aBuckets.size() &&
+            (aEntries.empty() || fwrite(&aEntries[0], 1, aEntries.size(), f)==aEntries.size()) &&
+            fwrite(sStrings.data(), 1, sStrings.size(), f)==sStrings.size();
+        bWritten = fclose(f)==0 && bWritten;
+    }
+
+    if(!bWritten)
+        return SYMCACHE_ERR_WRITE_FILE;
+
+    // The mapped file can't be replaced on Windows
+    UnmapFile();
+
+#ifdef _WIN32
+    BOOL bMoved = MoveFileExW(Utf8ToWide(sTmpFileName).c_str(), Utf8ToWide(m_sFileName).c_str(),
+        MOVEFILE_REPLACE_EXISTING);
+#else
+    bool bMoved = rename(sTmpFileName.c_str(), m_sFileName.c_str())==0;
+#endif
+
+    // Map the new file; new entries are in the file now unless it failed
+    int nResult = MapFile();
+    if(!bMoved || nResult!=SYMCACHE_OK)
+        return SYMCACHE_ERR_WRITE_FILE;
+
+    m_NewEntries.clear();
+    return SYMCACHE_OK;
+}
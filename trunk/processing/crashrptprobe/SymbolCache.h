@@ -0,0 +1,150 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: SymbolCache.h
+// Description: Persistent cache of resolved symbols. Maps (module build, RVA) to symbol
+// name, offset in symbol, source file and line, so the same address of the same module
+// build is resolved with dbghelp only once. The cache file is memory-mapped for lookups
+// and is rewritten with the new entries on Save(). Several processes may share the file:
+// Save() locks <file>.lock and merges with the file as it is on disk then, so entries
+// saved by another process in the meantime are kept.
+
+#pragma once
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "MinidumpParser.h"
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int8  uint8_t;
+typedef unsigned __int32 uint32_t;
+typedef __int32 int32_t;
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// Error codes returned by CSymbolCache methods
+enum SymCacheError
+{
+    SYMCACHE_OK = 0,              // Success
+    SYMCACHE_ERR_OPEN_FILE = 1,   // Couldn't open or map the file
+    SYMCACHE_ERR_INVALID_FILE = 2,// Not a cache file, or the file is truncated
+    SYMCACHE_ERR_WRITE_FILE = 3   // Couldn't write the file
+};
+
+// Resolved symbol stored in the cache
+struct SymCacheEntry
+{
+    SymCacheEntry()
+    {
+        m_uOffsInSymbol = 0;
+        m_nSourceLine = -1;
+    }
+
+    std::string m_sSymbolName;  // Symbol name (UTF-8)
+    uint64_t m_uOffsInSymbol;   // Offset in symbol
+    std::string m_sSourceFile;  // Source file name (UTF-8), or empty if unknown
+    int m_nSourceLine;          // Source line number, or -1 if unknown
+};
+
+// class CSymbolCache
+// Cache of resolved symbols. Lookup() and Add() may be called concurrently from
+// different threads; Open(), Save() and Close() must not.
+class CSymbolCache
+{
+public:
+
+    /* Construction/destruction */
+    CSymbolCache();
+    ~CSymbolCache();
+
+    // Opens the cache file (UTF-8 file name). A missing file is not an error, the
+    // cache is empty then. An invalid file is ignored and is overwritten on Save().
+    int Open(const char* szFileName);
+
+    // Writes the cached entries including the new ones to the file, merged with
+    // the entries other processes have saved since the file was opened. On Windows
+    // the file can't be replaced while another process has it mapped; the new
+    // entries are kept then and written by the next Save().
+    int Save();
+
+    // Closes the cache without saving
+    void Close();
+
+    // Looks up the symbol by module key and RVA. Counts hits and misses.
+    bool Lookup(uint64_t uModuleKey, uint64_t uRva, SymCacheEntry& Entry);
+
+    // Adds a resolved symbol. The entry is kept in memory until Save().
+    void Add(uint64_t uModuleKey, uint64_t uRva, const SymCacheEntry& Entry);
+
+    // Returns the number of entries (in the file and new ones)
+    size_t GetEntryCount();
+
+    // Returns the number of lookups that found or didn't find the entry
+    uint64_t GetHitCount();
+    uint64_t GetMissCount();
+
+    // Makes the module key from the string identifying a module build, for example
+    // PDB GUID and age or image name, time stamp and size. The case is ignored.
+    static uint64_t MakeModuleKey(const char* szIdentity);
+
+    // Makes the module key of a minidump module. PDB signature and age identify the
+    // symbols exactly; if there is no CodeView record, the image file name (without
+    // directory), time stamp and size are used instead.
+    static uint64_t MakeModuleKey(const MdmpModuleRecord& rec);
+
+private:
+
+    // Maps the cache file
+    int MapFile();
+
+    // Unmaps the cache file
+    void UnmapFile();
+
+    // Validates the header of the mapped file
+    bool ValidateFile();
+
+    // Looks up the entry in the mapped file
+    bool FindInFile(uint64_t uModuleKey, uint64_t uRva, SymCacheEntry& Entry) const;
+
+    // Returns the string at the given offset of the string pool, or NULL if the offset is invalid
+    const char* GetString(uint32_t uOffset) const;
+
+    // Returns the bucket index for the key
+    static uint32_t GetBucket(uint64_t uModuleKey, uint64_t uRva, uint32_t uBucketCount);
+
+    typedef std::pair<uint64_t, uint64_t> SymCacheKey; // <module_key, rva> pair
+
+    // Adds the entries of the mapped file to the map
+    void ReadFileEntries(std::map<SymCacheKey, SymCacheEntry>& Entries) const;
+
+    std::string m_sFileName;      // Cache file name (UTF-8)
+    const uint8_t* m_pData;       // Mapped file data, or NULL
+    size_t m_uSize;               // Size of mapped file data
+    uint32_t m_uBucketCount;      // Hash table size
+    uint32_t m_uEntryCount;       // Number of entries in the file
+    const uint8_t* m_pBuckets;    // Hash table
+    const uint8_t* m_pEntries;    // Entry records
+    const uint8_t* m_pStrings;    // String pool
+    uint32_t m_uStringsSize;      // Size of string pool
+    std::map<SymCacheKey, SymCacheEntry> m_NewEntries; // Entries added since the file was mapped
+    uint64_t m_uHits;             // Lookups that found the entry
+    uint64_t m_uMisses;           // Lookups that didn't find the entry
+    void* m_pLock;                // Protects new entries and counters
+
+#ifdef _WIN32
+    void* m_hFile;                // Handle to the opened file
+    void* m_hFileMapping;         // Handle to the file mapping object
+#else
+    int m_fd;                     // Descriptor of the opened file
+#endif
+};
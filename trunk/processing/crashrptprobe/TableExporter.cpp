@@ -0,0 +1,360 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "TableExporter.h"
+#include <stdio.h>
+
+// Encoded data is passed to the callback in blocks of about this size
+#define EXPORT_FLUSH_SIZE (64*1024)
+
+CTableExporter::CTableExporter(int nFormat, bool bHeader, PFNEXPORTWRITE pfnWrite, void* pParam)
+{
+    m_nFormat = nFormat;
+    m_bHeader = bHeader;
+    m_bHeaderWritten = false;
+    m_pfnWrite = pfnWrite;
+    m_pParam = pParam;
+    m_bFailed = false;
+    m_uCell = 0;
+    m_uRowRecord = 0;
+    m_sBuffer.reserve(EXPORT_FLUSH_SIZE*2);
+}
+
+CTableExporter::~CTableExporter()
+{
+    Flush();
+}
+
+bool CTableExporter::IsValidFormat(int nFormat)
+{
+    return nFormat==EXPORT_FORMAT_JSONL ||
+        nFormat==EXPORT_FORMAT_CSV ||
+        nFormat==EXPORT_FORMAT_BINARY;
+}
+
+void CTableExporter::BeginReport(const std::string& sReportId)
+{
+    if(m_nFormat==EXPORT_FORMAT_BINARY)
+    {
+        size_t uRecord = BeginRecord(EXPORT_REC_REPORT);
+        m_sBuffer.append(sReportId);
+        EndRecord(uRecord);
+        return;
+    }
+
+    // Report ID is the same for all rows, so encode it once
+    std::string sSaved;
+    sSaved.swap(m_sBuffer);
+    if(m_nFormat==EXPORT_FORMAT_JSONL)
+    {
+        m_sBuffer.append("{\"report\":");
+        AppendJsonString(sReportId.c_str(), sReportId.length());
+    }
+    else
+    {
+        AppendCsvField(sReportId.c_str(), sReportId.length());
+    }
+    m_sReportPrefix.swap(m_sBuffer);
+    m_sBuffer.swap(sSaved);
+}
+
+void CTableExporter::BeginTable(const std::string& sTableName, const std::vector<std::string>& asColumns)
+{
+    size_t i;
+
+    if(m_nFormat==EXPORT_FORMAT_BINARY)
+    {
+        size_t uRecord = BeginRecord(EXPORT_REC_TABLE);
+        AppendU16((uint16_t)sTableName.length());
+        m_sBuffer.append(sTableName);
+        AppendU16((uint16_t)asColumns.size());
+        for(i=0; i<asColumns.size(); i++)
+        {
+            AppendU16((uint16_t)asColumns[i].length());
+            m_sBuffer.append(asColumns[i]);
+        }
+        EndRecord(uRecord);
+        return;
+    }
+
+    // Encode table name and column names once per table
+    std::string sSaved;
+    sSaved.swap(m_sBuffer);
+
+    if(m_nFormat==EXPORT_FORMAT_JSONL)
+    {
+        m_sBuffer.append(",\"table\":");
+        AppendJsonString(sTableName.c_str(), sTableName.length());
+        m_sBuffer.append(",\"row\":");
+        m_sTablePrefix.swap(m_sBuffer);
+
+        m_asColumnKeys.resize(asColumns.size());
+        for(i=0; i<asColumns.size(); i++)
+        {
+            m_sBuffer.clear();
+            m_sBuffer.append(",");
+            AppendJsonString(asColumns[i].c_str(), asColumns[i].length());
+            m_sBuffer.append(":");
+            m_asColumnKeys[i] = m_sBuffer;
+        }
+        m_sBuffer.clear();
+    }
+    else
+    {
+        m_sBuffer.append(",");
+        AppendCsvField(sTableName.c_str(), sTableName.length());
+        m_sBuffer.append(",");
+        m_sTablePrefix.swap(m_sBuffer);
+    }
+
+    m_sBuffer.swap(sSaved);
+
+    // CSV header is written for the first table only, all tables exported
+    // to the same CSV stream are expected to have the same columns
+    if(m_nFormat==EXPORT_FORMAT_CSV && m_bHeader && !m_bHeaderWritten)
+    {
+        m_sBuffer.append("Report,Table,Row");
+        for(i=0; i<asColumns.size(); i++)
+        {
+            m_sBuffer.append(",");
+            AppendCsvField(asColumns[i].c_str(), asColumns[i].length());
+        }
+        m_sBuffer.append("\r\n");
+        m_bHeaderWritten = true;
+    }
+}
+
+void CTableExporter::BeginRow(uint32_t uRowIndex)
+{
+    m_uCell = 0;
+
+    if(m_nFormat==EXPORT_FORMAT_BINARY)
+    {
+        m_uRowRecord = BeginRecord(EXPORT_REC_ROW);
+        AppendU32(uRowIndex);
+        return;
+    }
+
+    char szRow[16];
+    sprintf(szRow, "%u", uRowIndex);
+    m_sBuffer.append(m_sReportPrefix);
+    m_sBuffer.append(m_sTablePrefix);
+    m_sBuffer.append(szRow);
+}
+
+void CTableExporter::BeginTextCell()
+{
+    if(m_nFormat==EXPORT_FORMAT_JSONL)
+    {
+        if(m_uCell<m_asColumnKeys.size())
+            m_sBuffer.append(m_asColumnKeys[m_uCell]);
+    }
+    else
+    {
+        m_sBuffer.append(",");
+    }
+
+    m_uCell++;
+}
+
+void CTableExporter::AddNull()
+{
+    if(m_nFormat==EXPORT_FORMAT_BINARY)
+    {
+        m_sBuffer.append(1, (char)EXPORT_CELL_NULL);
+        return;
+    }
+
+    BeginTextCell();
+    if(m_nFormat==EXPORT_FORMAT_JSONL)
+        m_sBuffer.append("null");
+}
+
+void CTableExporter::AddInt(int64_t nValue, bool bSigned)
+{
+    if(m_nFormat==EXPORT_FORMAT_BINARY)
+    {
+        m_sBuffer.append(1, (char)EXPORT_CELL_INT);
+        AppendU64((uint64_t)nValue);
+        return;
+    }
+
+    // Format the number without printf, this is the hot path for numeric tables
+    char szNum[24];
+    char* p = szNum+sizeof(szNum);
+    bool bNegative = bSigned && nValue<0;
+    uint64_t u = bNegative?(uint64_t)0-(uint64_t)nValue:(uint64_t)nValue;
+    do
+    {
+        *--p = (char)('0'+u%10);
+        u /= 10;
+    }
+    while(u!=0);
+    if(bNegative)
+        *--p = '-';
+
+    BeginTextCell();
+    m_sBuffer.append(p, szNum+sizeof(szNum)-p);
+}
+
+void CTableExporter::AddString(const char* pszValue, size_t uLength)
+{
+    if(m_nFormat==EXPORT_FORMAT_BINARY)
+    {
+        m_sBuffer.append(1, (char)EXPORT_CELL_STRING);
+        AppendU32((uint32_t)uLength);
+        m_sBuffer.append(pszValue, uLength);
+        return;
+    }
+
+    BeginTextCell();
+    if(m_nFormat==EXPORT_FORMAT_JSONL)
+        AppendJsonString(pszValue, uLength);
+    else
+        AppendCsvField(pszValue, uLength);
+}
+
+void CTableExporter::EndRow()
+{
+    if(m_nFormat==EXPORT_FORMAT_BINARY)
+        EndRecord(m_uRowRecord);
+    else if(m_nFormat==EXPORT_FORMAT_JSONL)
+        m_sBuffer.append("}\n");
+    else
+        m_sBuffer.append("\r\n");
+
+    CheckFlush();
+}
+
+bool CTableExporter::Flush()
+{
+    if(!m_bFailed && !m_sBuffer.empty())
+    {
+        if(!m_pfnWrite(m_sBuffer.data(), m_sBuffer.size(), m_pParam))
+            m_bFailed = true;
+    }
+
+    m_sBuffer.clear();
+    return !m_bFailed;
+}
+
+void CTableExporter::CheckFlush()
+{
+    if(m_sBuffer.size()>=EXPORT_FLUSH_SIZE)
+        Flush();
+}
+
+void CTableExporter::AppendJsonString(const char* psz, size_t uLength)
+{
+    static const char szHex[] = "0123456789abcdef";
+    size_t uStart = 0;
+    size_t i;
+
+    m_sBuffer.append(1, '"');
+
+    // Copy runs of characters that need no escaping at once
+    for(i=0; i<uLength; i++)
+    {
+        unsigned char ch = (unsigned char)psz[i];
+        if(ch>=0x20 && ch!='"' && ch!='\\')
+            continue;
+
+        m_sBuffer.append(psz+uStart, i-uStart);
+        uStart = i+1;
+
+        switch(ch)
+        {
+        case '"':  m_sBuffer.append("\\\""); break;
+        case '\\': m_sBuffer.append("\\\\"); break;
+        case '\n': m_sBuffer.append("\\n"); break;
+        case '\r': m_sBuffer.append("\\r"); break;
+        case '\t': m_sBuffer.append("\\t"); break;
+        default:
+            m_sBuffer.append("\\u00");
+            m_sBuffer.append(1, szHex[ch>>4]);
+            m_sBuffer.append(1, szHex[ch&0xF]);
+            break;
+        }
+    }
+
+    m_sBuffer.append(psz+uStart, uLength-uStart);
+    m_sBuffer.append(1, '"');
+}
+
+void CTableExporter::AppendCsvField(const char* psz, size_t uLength)
+{
+    size_t i;
+
+    // Quote the field only if it contains a separator, a quote or a line break
+    bool bQuote = false;
+    for(i=0; i<uLength && !bQuote; i++)
+    {
+        char ch = psz[i];
+        bQuote = ch==',' || ch=='"' || ch=='\r' || ch=='\n';
+    }
+
+    if(!bQuote)
+    {
+        m_sBuffer.append(psz, uLength);
+        return;
+    }
+
+    m_sBuffer.append(1, '"');
+    size_t uStart = 0;
+    for(i=0; i<uLength; i++)
+    {
+        if(psz[i]=='"')
+        {
+            // Double the quote
+            m_sBuffer.append(psz+uStart, i-uStart+1);
+            m_sBuffer.append(1, '"');
+            uStart = i+1;
+        }
+    }
+    m_sBuffer.append(psz+uStart, uLength-uStart);
+    m_sBuffer.append(1, '"');
+}
+
+void CTableExporter::AppendU16(uint16_t u)
+{
+    m_sBuffer.append(1, (char)(u&0xFF));
+    m_sBuffer.append(1, (char)(u>>8));
+}
+
+void CTableExporter::AppendU32(uint32_t u)
+{
+    AppendU16((uint16_t)(u&0xFFFF));
+    AppendU16((uint16_t)(u>>16));
+}
+
+void CTableExporter::AppendU64(uint64_t u)
+{
+    AppendU32((uint32_t)(u&0xFFFFFFFF));
+    AppendU32((uint32_t)(u>>32));
+}
+
+size_t CTableExporter::BeginRecord(uint8_t uchType)
+{
+    size_t uOffset = m_sBuffer.size();
+    AppendU32(0); // Length is set by EndRecord()
+    m_sBuffer.append(1, (char)uchType);
+    return uOffset;
+}
+
+void CTableExporter::EndRecord(size_t uOffset)
+{
+    uint32_t uLength = (uint32_t)(m_sBuffer.size()-uOffset-4);
+    m_sBuffer[uOffset]   = (char)(uLength&0xFF);
+    m_sBuffer[uOffset+1] = (char)((uLength>>8)&0xFF);
+    m_sBuffer[uOffset+2] = (char)((uLength>>16)&0xFF);
+    m_sBuffer[uOffset+3] = (char)(uLength>>24);
+
+    CheckFlush();
+}
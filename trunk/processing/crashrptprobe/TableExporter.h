@@ -0,0 +1,136 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: TableExporter.h
+// Description: Portable writer for bulk export of probe tables. Encodes rows as
+// JSON Lines, CSV or length-prefixed binary records and passes the encoded data
+// to a user callback in large blocks.
+
+#pragma once
+#include <string.h>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int8  uint8_t;
+typedef unsigned __int16 uint16_t;
+typedef unsigned __int32 uint32_t;
+typedef __int64 int64_t;
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// Output formats (the values match CRP_EXPORT_* constants of CrashRptProbe.h)
+enum ExportFormat
+{
+    EXPORT_FORMAT_JSONL  = 1, // One JSON object per row
+    EXPORT_FORMAT_CSV    = 2, // Comma-separated values (RFC 4180)
+    EXPORT_FORMAT_BINARY = 3  // Length-prefixed binary records
+};
+
+// Record types of the binary format. Each record is a little-endian uint32 length
+// of the rest of the record, followed by one of these type bytes and the payload.
+enum ExportRecordType
+{
+    EXPORT_REC_REPORT = 'R', // Report ID (UTF-8)
+    EXPORT_REC_TABLE  = 'T', // uint16 name length, name, uint16 column count, {uint16 length, name}...
+    EXPORT_REC_ROW    = 'W'  // uint32 row index, then one cell per column
+};
+
+// Cell types of the binary format. A cell is a type byte followed by either nothing
+// (null), little-endian int64 (integer) or uint32 length and UTF-8 bytes (string).
+enum ExportCellType
+{
+    EXPORT_CELL_NULL   = 0,
+    EXPORT_CELL_INT    = 1,
+    EXPORT_CELL_STRING = 2
+};
+
+// Receives encoded data. Returns false to abort the export.
+typedef bool (*PFNEXPORTWRITE)(const void* pData, size_t uSize, void* pParam);
+
+// class CTableExporter
+// Encodes table rows in a single pass. The caller describes each table with
+// BeginTable(), then adds rows cell by cell. All strings are UTF-8.
+class CTableExporter
+{
+public:
+
+    // Constructor. If bHeader is true, CSV output starts with a header line.
+    CTableExporter(int nFormat, bool bHeader, PFNEXPORTWRITE pfnWrite, void* pParam);
+
+    // Destructor. Flushes the remaining data.
+    ~CTableExporter();
+
+    // Returns true if the format is supported
+    static bool IsValidFormat(int nFormat);
+
+    // Sets the ID of the report the following rows belong to
+    void BeginReport(const std::string& sReportId);
+
+    // Starts a table with the given column names
+    void BeginTable(const std::string& sTableName, const std::vector<std::string>& asColumns);
+
+    // Starts a row
+    void BeginRow(uint32_t uRowIndex);
+
+    // Adds a cell to the current row. Cells must be added in column order.
+    void AddNull();
+    void AddInt(int64_t nValue, bool bSigned);
+    void AddString(const char* pszValue, size_t uLength);
+
+    // Finishes the current row
+    void EndRow();
+
+    // Passes buffered data to the callback. Returns false if the callback failed.
+    bool Flush();
+
+    // Returns true if the callback has failed
+    bool IsFailed() const { return m_bFailed; }
+
+private:
+
+    // Appends text in JSON string notation (with quotes)
+    void AppendJsonString(const char* psz, size_t uLength);
+
+    // Appends text as CSV field, quoting it if needed
+    void AppendCsvField(const char* psz, size_t uLength);
+
+    // Appends little-endian integers
+    void AppendU16(uint16_t u);
+    void AppendU32(uint32_t u);
+    void AppendU64(uint64_t u);
+
+    // Appends a binary record header and returns the offset of its length field
+    size_t BeginRecord(uint8_t uchType);
+
+    // Sets the length field of the binary record that starts at uOffset
+    void EndRecord(size_t uOffset);
+
+    // Starts a cell in text formats
+    void BeginTextCell();
+
+    // Flushes the buffer if it is full enough
+    void CheckFlush();
+
+    int m_nFormat;                   // Output format
+    bool m_bHeader;                  // Write CSV header line?
+    bool m_bHeaderWritten;           // Was CSV header line written?
+    PFNEXPORTWRITE m_pfnWrite;       // Output callback
+    void* m_pParam;                  // Parameter passed to the callback
+    bool m_bFailed;                  // Has the callback failed?
+    std::string m_sBuffer;           // Encoded data not yet passed to the callback
+    std::string m_sReportPrefix;     // Encoded report ID (text formats)
+    std::string m_sTablePrefix;      // Encoded table name (text formats)
+    std::vector<std::string> m_asColumnKeys; // Encoded column names (JSON)
+    size_t m_uCell;                  // Index of the next cell in the current row
+    size_t m_uRowRecord;             // Offset of the current row record (binary)
+};
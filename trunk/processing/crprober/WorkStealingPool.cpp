@@ -0,0 +1,222 @@
+/************************************************************************************* 
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "WorkStealingPool.h"
+
+CWorkStealingPool::CWorkStealingPool()
+{
+    m_pfnProcessItem = NULL;
+    m_pContext = NULL;
+    m_uCompleted = 0;
+    m_uSteals = 0;
+    m_nRunning = 0;
+    m_bFinished = true;
+}
+
+CWorkStealingPool::~CWorkStealingPool()
+{
+    Destroy();
+}
+
+BOOL CWorkStealingPool::Start(size_t uItemCount, int nThreadCount, 
+                              PFNPROCESSWORKITEM pfnProcessItem, LPVOID pContext)
+{
+    Destroy();
+
+    if(pfnProcessItem==NULL || nThreadCount<=0)
+        return FALSE;
+
+    m_pfnProcessItem = pfnProcessItem;
+    m_pContext = pContext;
+    m_uCompleted = 0;
+    m_uSteals = 0;
+
+    // Split items into contiguous blocks, one block per worker
+    int i;
+    for(i=0; i<nThreadCount; i++)
+    {
+        WorkerQueue* pQueue = new WorkerQueue;
+
+        size_t uFirst = uItemCount*i/nThreadCount;
+        size_t uLast = uItemCount*(i+1)/nThreadCount;
+        size_t uItem;
+        for(uItem=uFirst; uItem<uLast; uItem++)
+            pQueue->m_Items.push_back(uItem);
+
+        m_aQueues.push_back(pQueue);
+    }
+
+    // Parameters must not move once threads are started
+    m_aParams.resize(nThreadCount);
+    for(i=0; i<nThreadCount; i++)
+    {
+        m_aParams[i].m_pPool = this;
+        m_aParams[i].m_nWorker = i;
+    }
+
+    // Workers are counted before they start, so the last one to finish
+    // doesn't see the count drop to zero while others are being started
+    m_nRunning = nThreadCount;
+    m_bFinished = false;
+    for(i=0; i<nThreadCount; i++)
+    {
+        CSyncThread* pThread = new CSyncThread;
+        m_aThreads.push_back(pThread);
+        if(!pThread->Start(WorkerThread, &m_aParams[i]))
+            break;
+    }
+
+    // The items of workers that failed to start are stolen by other workers
+    int nStarted = i;
+    if(nStarted<nThreadCount)
+    {
+        CSyncLock lock(m_Mutex);
+        m_nRunning -= nThreadCount-nStarted;
+        if(m_nRunning==0 && nStarted!=0)
+            m_Finished.Post();
+    }
+
+    if(nStarted==0)
+    {
+        m_bFinished = true;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BOOL CWorkStealingPool::Wait(DWORD dwTimeoutMs)
+{
+    if(m_bFinished)
+        return TRUE;
+
+    // The last worker to finish posts the semaphore once
+    if(dwTimeoutMs==INFINITE)
+        m_Finished.Wait();
+    else if(!m_Finished.TimedWait(dwTimeoutMs))
+        return FALSE;
+
+    m_bFinished = true;
+    return TRUE;
+}
+
+size_t CWorkStealingPool::GetCompletedCount() const
+{
+    CSyncLock lock(m_Mutex);
+    return m_uCompleted;
+}
+
+size_t CWorkStealingPool::GetStealCount() const
+{
+    CSyncLock lock(m_Mutex);
+    return m_uSteals;
+}
+
+void CWorkStealingPool::WorkerThread(void* pParam)
+{
+    WorkerParams* pParams = (WorkerParams*)pParam;
+    CWorkStealingPool* pPool = pParams->m_pPool;
+
+    for(;;)
+    {
+        size_t uItem = 0;
+        if(!pPool->PopItem(pParams->m_nWorker, uItem))
+        {
+            // Own queue is empty; try to take work from others
+            if(!pPool->StealItems(pParams->m_nWorker))
+                break; // Nothing left to do
+
+            continue;
+        }
+
+        pPool->m_pfnProcessItem(uItem, pPool->m_pContext);
+
+        CSyncLock lock(pPool->m_Mutex);
+        pPool->m_uCompleted++;
+    }
+
+    CSyncLock lock(pPool->m_Mutex);
+    pPool->m_nRunning--;
+    if(pPool->m_nRunning==0)
+        pPool->m_Finished.Post();
+}
+
+BOOL CWorkStealingPool::PopItem(int nWorker, size_t& uItem)
+{
+    WorkerQueue* pQueue = m_aQueues[nWorker];
+    BOOL bResult = FALSE;
+
+    CSyncLock lock(pQueue->m_Mutex);
+    if(!pQueue->m_Items.empty())
+    {
+        // The owner takes items from the front, thieves take them from the back
+        uItem = pQueue->m_Items.front();
+        pQueue->m_Items.pop_front();
+        bResult = TRUE;
+    }
+
+    return bResult;
+}
+
+BOOL CWorkStealingPool::StealItems(int nWorker)
+{
+    int nQueueCount = (int)m_aQueues.size();
+    std::deque<size_t> aStolen;
+
+    // Look for a victim starting from the next worker, so thieves don't
+    // all attack the same queue
+    int i;
+    for(i=1; i<nQueueCount && aStolen.empty(); i++)
+    {
+        WorkerQueue* pVictim = m_aQueues[(nWorker+i)%nQueueCount];
+
+        CSyncLock lock(pVictim->m_Mutex);
+        size_t uCount = (pVictim->m_Items.size()+1)/2;
+        while(uCount>0)
+        {
+            aStolen.push_front(pVictim->m_Items.back());
+            pVictim->m_Items.pop_back();
+            uCount--;
+        }
+    }
+
+    if(aStolen.empty())
+        return FALSE;
+
+    // Items are never added after Start(), so once all queues are empty
+    // there is no more work.
+    WorkerQueue* pQueue = m_aQueues[nWorker];
+    {
+        CSyncLock lock(pQueue->m_Mutex);
+        pQueue->m_Items.insert(pQueue->m_Items.end(), aStolen.begin(), aStolen.end());
+    }
+
+    CSyncLock lock(m_Mutex);
+    m_uSteals++;
+    return TRUE;
+}
+
+void CWorkStealingPool::Destroy()
+{
+    Wait(INFINITE);
+
+    size_t i;
+    for(i=0; i<m_aThreads.size(); i++)
+    {
+        m_aThreads[i]->Join();
+        delete m_aThreads[i];
+    }
+    m_aThreads.clear();
+
+    for(i=0; i<m_aQueues.size(); i++)
+        delete m_aQueues[i];
+    m_aQueues.clear();
+    m_aParams.clear();
+}
@@ -0,0 +1,90 @@
+/************************************************************************************* 
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: WorkStealingPool.h
+// Description: Thread pool that processes a fixed set of work items. Each worker 
+// thread has its own queue of items; a worker that runs out of items steals a half
+// of the items from another worker's queue. This keeps all cores busy when items
+// take very different time to process (e.g. reports with and without symbols).
+
+#pragma once
+#include <windows.h>
+#include <vector>
+#include <deque>
+#include "ThreadSync.h"
+
+// Function that processes a single work item. Called from worker threads.
+typedef void (*PFNPROCESSWORKITEM)(size_t uItem, LPVOID pContext);
+
+// class CWorkStealingPool
+class CWorkStealingPool
+{
+public:
+
+    // Constructor
+    CWorkStealingPool();
+
+    // Destructor. Waits until all worker threads exit.
+    ~CWorkStealingPool();
+
+    // Starts processing items [0, uItemCount) on nThreadCount threads.
+    BOOL Start(size_t uItemCount, int nThreadCount, 
+        PFNPROCESSWORKITEM pfnProcessItem, LPVOID pContext);
+
+    // Waits until all items are processed or the timeout expires. 
+    // Returns TRUE if all items are processed.
+    BOOL Wait(DWORD dwTimeoutMs);
+
+    // Returns the number of processed items.
+    size_t GetCompletedCount() const;
+
+    // Returns how many times a worker stole items from another worker.
+    size_t GetStealCount() const;
+
+private:
+
+    // Queue of items assigned to a worker thread
+    struct WorkerQueue
+    {
+        CSyncMutex m_Mutex;         // Protects the queue
+        std::deque<size_t> m_Items; // Items to process
+    };
+
+    // Parameters passed to a worker thread
+    struct WorkerParams
+    {
+        CWorkStealingPool* m_pPool; // Owner
+        int m_nWorker;              // Index of the worker
+    };
+
+    // Worker thread procedure
+    static void WorkerThread(void* pParam);
+
+    // Takes the next item from the worker's own queue.
+    BOOL PopItem(int nWorker, size_t& uItem);
+
+    // Moves a half of items from another worker's queue to this worker's queue.
+    BOOL StealItems(int nWorker);
+
+    // Stops worker threads and frees resources.
+    void Destroy();
+
+    std::vector<WorkerQueue*> m_aQueues;  // Per-worker queues
+    std::vector<WorkerParams> m_aParams;  // Per-worker thread parameters
+    std::vector<CSyncThread*> m_aThreads; // Worker threads
+    PFNPROCESSWORKITEM m_pfnProcessItem;  // Item processing function
+    LPVOID m_pContext;                    // Parameter passed to m_pfnProcessItem
+    mutable CSyncMutex m_Mutex;           // Protects the counters below
+    size_t m_uCompleted;                  // Number of processed items
+    size_t m_uSteals;                     // Number of successful steals
+    int m_nRunning;                       // Number of running workers
+    bool m_bFinished;                     // Whether all workers have finished
+    CSyncSemaphore m_Finished;            // Posted by the last worker to finish
+};
@@ -20,6 +20,8 @@ be found in the Authors.txt file in the root of the source tree.
 #include <string>
 #include <assert.h>
 #include "CrashRptProbe.h"
+#include "CrashBucket.h"
+#include "WorkStealingPool.h"
 
 // Character set independent string type
 typedef std::basic_string<TCHAR> tstring;
@@ -41,12 +43,70 @@ enum ReturnCode
     EXTRACTERR  = 4  // File extraction error   
 };
 
+// Property requested with /get parameter
+struct PropRequest
+{
+    LPTSTR m_szTableId;  // Table ID
+    LPTSTR m_szColumnId; // Column ID
+    LPTSTR m_szRowId;    // Row index
+};
+
+// Bulk table export requested with /export parameter
+struct ExportRequest
+{
+    ExportRequest()
+    {
+        m_nFormat = 0;
+        m_szTableId = NULL;
+        m_pFile = NULL;
+        m_bHeaderWritten = FALSE;
+        InitializeCriticalSection(&m_cs);
+    }
+
+    ~ExportRequest()
+    {
+        DeleteCriticalSection(&m_cs);
+    }
+
+    int m_nFormat;          // One of CRP_EXPORT_* constants
+    LPTSTR m_szTableId;     // Table to export, or NULL to export all tables
+    FILE* m_pFile;          // Output file shared by all reports
+    BOOL m_bHeaderWritten;  // Was CSV header line written to the output file?
+    CRITICAL_SECTION m_cs;  // Serializes writes to the output file
+};
+
+// Crash bucket index updated with /buckets parameter
+struct BucketRequest
+{
+    BucketRequest()
+    {
+        InitializeCriticalSection(&m_cs);
+    }
+
+    ~BucketRequest()
+    {
+        DeleteCriticalSection(&m_cs);
+    }
+
+    CBucketIndex m_Index;   // Buckets loaded from the index file
+    CRITICAL_SECTION m_cs;  // Serializes access to the index
+};
+
 // Function prototypes
 int process_report(LPTSTR szInput, LPTSTR szInputMD5, LPTSTR szOutput, 
-                   LPTSTR szSymSearchPath, LPTSTR szExtractPath, LPTSTR szTableId, LPTSTR szColumnId, LPTSTR szRowId);
+                   LPTSTR szSymSearchPath, LPTSTR szExtractPath, 
+                   const std::vector<PropRequest>& aProps, ExportRequest* pExport, 
+                   BucketRequest* pBuckets, BOOL bQuiet);
+int process_batch(LPTSTR szBatch, LPTSTR szInputMD5, LPTSTR szOutput, 
+                  LPTSTR szSymSearchPath, const std::vector<PropRequest>& aProps, 
+                  ExportRequest* pExport, BucketRequest* pBuckets, int nThreads);
 int get_prop(CrpHandle hReport, LPCTSTR table_id, LPCTSTR column_id, tstring& str, int row_id=0);
 int output_document(CrpHandle hReport, FILE* f);
 int extract_files(CrpHandle hReport, LPCTSTR pszExtractPath);
+int export_tables(CrpHandle hReport, ExportRequest* pExport);
+int add_to_bucket(CrpHandle hReport, LPCTSTR szReport, BucketRequest* pBuckets);
+int write_bucket_summary(BucketRequest* pBuckets, LPCTSTR szSummaryFile);
+std::string to_utf8(LPCTSTR szString);
 
 // We want to use secure version of _stprintf function when possible
 int __STPRINTF_S(TCHAR* buffer, size_t sizeOfBuffer, const TCHAR* format, ... )
@@ -87,7 +147,27 @@ void print_usage()
     _tprintf(_T("   /ext <extract_dir>       Optional. Specifies the directory where to extract all files contained in error report. ")\
              _T("If this parameter is omitted, files are not extracted.\n"));    
     _tprintf(_T("   /get <table_id> <column_id> <row_id> Optional. Specifies the table ID, column ID and row index of the property to retrieve. ")\
-             _T("If this parameter specified, the property is written to the output file or to terminal, as defined by /o parameter.\n"));    
+             _T("If this parameter specified, the property is written to the output file or to terminal, as defined by /o parameter. ")\
+             _T("May be specified several times; each property is written on its own line in the order of /get parameters.\n"));    
+    _tprintf(_T("   /batch <dir_or_pattern>  Optional. Process all ZIP files in the directory or all files matching the pattern ")\
+             _T("(for example, C:\\Reports\\*.zip) instead of the single /f file. Requires /o to be an existing directory. ")\
+             _T("Progress is printed to stderr.\n"));    
+    _tprintf(_T("   /threads <count>         Optional. Number of worker threads used in /batch mode. ")\
+             _T("If this parameter is omitted, one thread per processor is used.\n"));    
+    _tprintf(_T("   /export <format> <out_file> Optional. Writes complete tables of the report(s) to <out_file> in a single pass. ")\
+             _T("The <format> is one of jsonl (JSON Lines), csv or binary (length-prefixed records). ")\
+             _T("In /batch mode rows of all reports are written to the same file.\n"));    
+    _tprintf(_T("   /table <table_id>        Optional. Table exported with /export parameter, for example MdmpModules, ")\
+             _T("or STACK for stack traces of all threads. If this parameter is omitted, all tables are exported. ")\
+             _T("Required for csv format.\n"));    
+    _tprintf(_T("   /symcache <cache_file>   Optional. Persistent cache of resolved symbols. Stack frames of module builds ")\
+             _T("seen before are taken from the cache instead of resolving them with dbghelp again. The file is created ")\
+             _T("if it doesn't exist. The cache hit rate is printed to stderr.\n"));    
+    _tprintf(_T("   /buckets <index_file>    Optional. Groups the report(s) into crash buckets by normalized top frames ")\
+             _T("of the exception thread stack and counts them in <index_file>. The file is created if it doesn't exist. ")\
+             _T("Without /f and /batch parameters, the existing index is only read.\n"));    
+    _tprintf(_T("   /summary <out_file>      Optional. Writes the list of crash buckets from /buckets index to <out_file>, ")\
+             _T("the largest bucket first.\n"));    
 }
 
 // COutputter
@@ -154,10 +234,17 @@ int _tmain(int argc, TCHAR** argv)
     TCHAR* szSymSearchPath = NULL; // Symbol search path   
     TCHAR* szExtractPath = NULL;   // File extraction path
 
-    TCHAR* szTableId = NULL;
-    TCHAR* szColumnId = NULL;
-    TCHAR* szRowId = NULL;
-
+    TCHAR* szBatch = NULL;         // Batch input dir or file pattern
+    int nThreads = 0;              // Number of batch worker threads
+    std::vector<PropRequest> aProps; // Properties to retrieve
+
+    TCHAR* szExportFile = NULL;    // Export output file
+    ExportRequest exportReq;       // Export parameters
+    TCHAR* szSymCache = NULL;      // Symbol cache file
+    BOOL bSymCacheOpened = FALSE;  // Was symbol cache opened?
+    TCHAR* szBucketFile = NULL;    // Crash bucket index file
+    TCHAR* szSummaryFile = NULL;   // Crash bucket summary file
+    BucketRequest bucketReq;       // Crash bucket index
     if(args_left()==0)
     {
         result = INVALIDARG;
@@ -236,20 +323,122 @@ int _tmain(int argc, TCHAR** argv)
         }
         else if(cmp_arg(_T("/get"))) // get property
         {
+            PropRequest prop;
             skip_arg();    
-            szTableId = get_arg();
+            prop.m_szTableId = get_arg();
             skip_arg();
-            szColumnId = get_arg();
+            prop.m_szColumnId = get_arg();
             skip_arg();
-            szRowId = get_arg();
+            prop.m_szRowId = get_arg();
             skip_arg();
 
-            if(szTableId==NULL || szColumnId==NULL || szRowId==NULL)
+            if(prop.m_szTableId==NULL || prop.m_szColumnId==NULL || prop.m_szRowId==NULL)
             {
                 result = INVALIDARG;
                 _tprintf(_T("Missing table ID or column ID or row ID in /get parameter.\n"));
                 goto done;
             }      
+
+            aProps.push_back(prop);
+        }
+        else if(cmp_arg(_T("/batch"))) // batch input dir or pattern
+        {
+            skip_arg();    
+            szBatch = get_arg();
+            skip_arg();
+            if(szBatch==NULL)
+            {
+                result = INVALIDARG;
+                _tprintf(_T("Missing directory name or file pattern in /batch parameter.\n"));
+                goto done;
+            }
+        }
+        else if(cmp_arg(_T("/threads"))) // number of worker threads
+        {
+            skip_arg();    
+            TCHAR* szThreads = get_arg();
+            skip_arg();
+            if(szThreads==NULL || (nThreads = _ttoi(szThreads))<=0)
+            {
+                result = INVALIDARG;
+                _tprintf(_T("Missing or invalid thread count in /threads parameter.\n"));
+                goto done;
+            }
+        }
+        else if(cmp_arg(_T("/export"))) // bulk table export
+        {
+            skip_arg();    
+            TCHAR* szFormat = get_arg();
+            skip_arg();
+            szExportFile = get_arg();
+            skip_arg();
+            if(szFormat==NULL || szExportFile==NULL)
+            {
+                result = INVALIDARG;
+                _tprintf(_T("Missing format or output file name in /export parameter.\n"));
+                goto done;
+            }
+
+            if(_tcscmp(szFormat, _T("jsonl"))==0)
+                exportReq.m_nFormat = CRP_EXPORT_JSONL;
+            else if(_tcscmp(szFormat, _T("csv"))==0)
+                exportReq.m_nFormat = CRP_EXPORT_CSV;
+            else if(_tcscmp(szFormat, _T("binary"))==0)
+                exportReq.m_nFormat = CRP_EXPORT_BINARY;
+            else
+            {
+                result = INVALIDARG;
+                _tprintf(_T("Invalid format in /export parameter: %s\n"), szFormat);
+                goto done;
+            }
+        }
+        else if(cmp_arg(_T("/table"))) // table to export
+        {
+            skip_arg();    
+            exportReq.m_szTableId = get_arg();
+            skip_arg();
+            if(exportReq.m_szTableId==NULL)
+            {
+                result = INVALIDARG;
+                _tprintf(_T("Missing table ID in /table parameter.\n"));
+                goto done;
+            }
+        }
+        else if(cmp_arg(_T("/symcache"))) // symbol cache file
+        {
+            skip_arg();    
+            szSymCache = get_arg();
+            skip_arg();
+            if(szSymCache==NULL)
+            {
+                result = INVALIDARG;
+                _tprintf(_T("Missing cache file name in /symcache parameter.\n"));
+                goto done;
+            }
+        }
+        else if(cmp_arg(_T("/buckets"))) // crash bucket index file
+        {
+            skip_arg();    
+            szBucketFile = get_arg();
+            skip_arg();
+            if(szBucketFile==NULL)
+            {
+                result = INVALIDARG;
+                _tprintf(_T("Missing index file name in /buckets parameter.\n"));
+                goto done;
+            }
+        }
+        else if(cmp_arg(_T("/summary"))) // crash bucket summary file
+        {
+            skip_arg();    
+            szSummaryFile = get_arg();
+            skip_arg();
+            if(szSummaryFile==NULL)
+            {
+                result = INVALIDARG;
+                _tprintf(_T("Missing output file name in /summary parameter.\n"));
+                goto done;
+            }
         }
         else // unknown arg
         {
@@ -258,12 +447,130 @@ int _tmain(int argc, TCHAR** argv)
         }    
     }
 
+    if(szExportFile!=NULL)
+    {
+        if(exportReq.m_nFormat==CRP_EXPORT_CSV && exportReq.m_szTableId==NULL)
+        {
+            result = INVALIDARG;
+            _tprintf(_T("The /table parameter is required for csv export.\n"));
+            goto done;
+        }
+
+        // Binary mode is used for all formats, the exported data is already encoded
+        _TFOPEN_S(exportReq.m_pFile, szExportFile, _T("wb"));
+        if(exportReq.m_pFile==NULL)
+        {
+            result = UNEXPECTED;
+            _tprintf(_T("Error: couldn't open export file '%s'.\n"), szExportFile);
+            goto done;
+        }
+    }
+    else if(exportReq.m_szTableId!=NULL)
+    {
+        result = INVALIDARG;
+        _tprintf(_T("The /table parameter requires /export parameter.\n"));
+        goto done;
+    }
+
+    if(szSymCache!=NULL)
+    {
+        if(0!=crpOpenSymbolCache(szSymCache))
+        {
+            TCHAR szErr[1024];
+            crpGetLastErrorMsg(szErr, 1024);
+            result = UNEXPECTED;
+            _tprintf(_T("Error '%s' while opening symbol cache '%s'.\n"), szErr, szSymCache);
+            goto done;
+        }
+        bSymCacheOpened = TRUE;
+    }
+
+    if(szBucketFile!=NULL)
+    {
+        // A missing index file is not an error, the index is created then
+        if(BUCKETIDX_OK!=bucketReq.m_Index.Open(to_utf8(szBucketFile).c_str()))
+        {
+            result = UNEXPECTED;
+            _tprintf(_T("Error: '%s' is not a valid bucket index file.\n"), szBucketFile);
+            goto done;
+        }
+    }
+    else if(szSummaryFile!=NULL)
+    {
+        result = INVALIDARG;
+        _tprintf(_T("The /summary parameter requires /buckets parameter.\n"));
+        goto done;
+    }
+
     // Do the processing work
-    result = process_report(szInput, szInputMD5, szOutput, szSymSearchPath, 
-        szExtractPath, szTableId, szColumnId, szRowId); 
+    if(szBatch!=NULL)
+    {
+        if(szInput!=NULL || szExtractPath!=NULL)
+        {
+            result = INVALIDARG;
+            _tprintf(_T("The /f and /ext parameters can't be used in /batch mode.\n"));
+            goto done;
+        }
+
+        result = process_batch(szBatch, szInputMD5, szOutput, szSymSearchPath, 
+            aProps, szExportFile!=NULL?&exportReq:NULL, 
+            szBucketFile!=NULL?&bucketReq:NULL, nThreads);
+    }
+    else if(szInput!=NULL || szBucketFile==NULL)
+    {
+        result = process_report(szInput, szInputMD5, szOutput, szSymSearchPath, 
+            szExtractPath, aProps, szExportFile!=NULL?&exportReq:NULL, 
+            szBucketFile!=NULL?&bucketReq:NULL, FALSE); 
+    }
+    else
+    {
+        // Only the summary of the existing index is requested
+        result = SUCCESS;
+    }
+
+    if(szBucketFile!=NULL && result!=INVALIDARG)
+    {
+        // Reports that failed in batch mode don't prevent others from being counted
+        if(BUCKETIDX_OK!=bucketReq.m_Index.Save())
+        {
+            result = UNEXPECTED;
+            _tprintf(_T("Error: couldn't write bucket index file '%s'.\n"), szBucketFile);
+            goto done;
+        }
+
+        if(szSummaryFile!=NULL)
+        {
+            int res = write_bucket_summary(&bucketReq, szSummaryFile);
+            if(res!=SUCCESS)
+                result = res;
+        }
+    }
 
 done:
 
+    if(bSymCacheOpened)
+    {
+        ULONG64 ulHits = 0;
+        ULONG64 ulMisses = 0;
+        ULONG64 ulEntries = 0;
+        crpGetSymbolCacheStats(&ulHits, &ulMisses, &ulEntries);
+        _ftprintf(stderr, _T("Symbol cache: %I64u hits, %I64u misses (%.1f%% hit rate), %I64u entries.\n"), 
+            ulHits, ulMisses, ulHits+ulMisses==0?0.0:100.0*ulHits/(ulHits+ulMisses), ulEntries);
+
+        // New symbols are written to the cache file on close
+        if(0!=crpCloseSymbolCache())
+        {
+            TCHAR szErr[1024];
+            crpGetLastErrorMsg(szErr, 1024);
+            _tprintf(_T("Error '%s' while saving symbol cache '%s'.\n"), szErr, szSymCache);
+            if(result==SUCCESS)
+                result = UNEXPECTED;
+        }
+    }
+
+    if(exportReq.m_pFile!=NULL)
+        fclose(exportReq.m_pFile);
+
     if(result==INVALIDARG)
     {
         print_usage();
@@ -273,10 +580,11 @@ done:
 }
 
 
-// Processes a crash report file.
+// Processes a crash report file. If bQuiet is TRUE, only error messages are printed.
 int process_report(LPTSTR szInput, LPTSTR szInputMD5, LPTSTR szOutput, 
-                   LPTSTR szSymSearchPath, LPTSTR szExtractPath, LPTSTR szTableId,
-                   LPTSTR szColumnId, LPTSTR szRowId)
+                   LPTSTR szSymSearchPath, LPTSTR szExtractPath, 
+                   const std::vector<PropRequest>& aProps, ExportRequest* pExport, 
+                   BucketRequest* pBuckets, BOOL bQuiet)
 {
     int result = UNEXPECTED; // Status
     CrpHandle hReport = 0; // Handle to the error report
@@ -289,9 +597,10 @@ int process_report(LPTSTR szInput, LPTSTR szInputMD5, LPTSTR szOutput,
     BOOL bInputMD5FromDir = FALSE; // Did user specified file name for .MD5 file or directory name for search?
     BOOL bOutputToDir = FALSE; // Do we save resulting files to directory or save single resulting file?  
     DWORD dwFileAttrs = 0;
-    TCHAR szMD5Buffer[64]=_T("");
+    TCHAR szMD5Buffer[80]=_T("");
     TCHAR* szMD5Hash = NULL;
     FILE* f = NULL;      
+    size_t i = 0;
 
     // Validate input parameters
     if(szInput==NULL)
@@ -301,7 +610,7 @@ int process_report(LPTSTR szInput, LPTSTR szInputMD5, LPTSTR szOutput,
         goto done;
     }
 
-    if(szTableId==NULL && szOutput==NULL && szExtractPath==NULL)
+    if(aProps.size()==0 && szOutput==NULL && szExtractPath==NULL && pExport==NULL && pBuckets==NULL)
     {
         result = INVALIDARG;
         _tprintf(_T("Output file name or directory name is missing.\n"));
@@ -395,16 +704,24 @@ int process_report(LPTSTR szInput, LPTSTR szInputMD5, LPTSTR szOutput,
         }
     }
 
+    // If the report was created with SHA-256 digest, check the stronger hash instead
+    if(szInputMD5==NULL || bInputMD5FromDir)
+    {
+        tstring sSHA256FileName = sMD5FileName.substr(0, sMD5FileName.length()-4) + _T(".sha256");
+        if(GetFileAttributes(sSHA256FileName.c_str())!=INVALID_FILE_ATTRIBUTES)
+            sMD5FileName = sSHA256FileName;
+    }
+
     // Get MD5 hash from .md5 file
     _TFOPEN_S(f, sMD5FileName.c_str(), _T("rt"));
     if(f!=NULL)
     {
-        szMD5Hash = _fgetts(szMD5Buffer, 64, f);   
+        szMD5Hash = _fgetts(szMD5Buffer, 80, f);   
         fclose(f);
-        if(szTableId==NULL)
-            _tprintf(_T("Found MD5 file %s; MD5=%s\n"), sMD5FileName.c_str(), szMD5Hash);
+        if(aProps.size()==0 && !bQuiet)
+            _tprintf(_T("Found hash file %s; hash=%s\n"), sMD5FileName.c_str(), szMD5Hash);
     }    
-    else if(szTableId==NULL)
+    else if(aProps.size()==0 && !bQuiet)
     {
         _tprintf(_T("Warning: 'MD5 file not detected; integrity check not performed.' while processing file '%s'\n"), sInFileName.c_str());
     }
@@ -461,12 +778,13 @@ int process_report(LPTSTR szInput, LPTSTR szInputMD5, LPTSTR szOutput,
             goto done;
         }
 
-        if(szTableId!=NULL)
+        for(i=0; i<aProps.size(); i++)
         {
-            // Get single property
+            // Get the requested property
+            const PropRequest& prop = aProps[i];
             tstring sProp;
-            int get = get_prop(hReport, szTableId, szColumnId, sProp, _ttoi(szRowId));
-            if(_tcscmp(szColumnId, CRP_META_ROW_COUNT)==0)
+            int get = get_prop(hReport, prop.m_szTableId, prop.m_szColumnId, sProp, _ttoi(prop.m_szRowId));
+            if(_tcscmp(prop.m_szColumnId, CRP_META_ROW_COUNT)==0)
             {
                 if(get<0)
                 {
@@ -495,7 +813,8 @@ int process_report(LPTSTR szInput, LPTSTR szInputMD5, LPTSTR szOutput,
                 _ftprintf(f, _T("%s\n"), sProp.c_str());
             }
         }
-        else if(szOutput!=NULL)
+        
+        if(aProps.size()==0 && szOutput!=NULL)
         {      
             // Write error report properties to the resulting file
             result = output_document(hReport, f);
@@ -510,6 +829,22 @@ int process_report(LPTSTR szInput, LPTSTR szInputMD5, LPTSTR szOutput,
             if(result!=0)
                 goto done;
         }
+
+        if(pExport!=NULL)
+        {
+            // Write complete tables to the export file
+            result = export_tables(hReport, pExport);
+            if(result!=0)
+                goto done;
+        }
+
+        if(pBuckets!=NULL)
+        {
+            // Count the report in its crash bucket
+            result = add_to_bucket(hReport, szInput, pBuckets);
+            if(result!=0)
+                goto done;
+        }
     }
 
     // Success.
@@ -526,6 +861,211 @@ done:
     return result;
 }
 
+// Parameters shared by batch worker threads
+struct BatchContext
+{
+    std::vector<tstring> m_aFiles;   // Report files to process
+    LPTSTR m_szInputMD5;             // Input MD5 file or dir
+    LPTSTR m_szOutput;               // Output dir
+    LPTSTR m_szSymSearchPath;        // Symbol search path
+    const std::vector<PropRequest>* m_paProps; // Properties to retrieve
+    ExportRequest* m_pExport;        // Export parameters, or NULL
+    BucketRequest* m_pBuckets;       // Crash bucket index, or NULL
+    volatile LONG m_nFailed;         // Number of reports that failed to process
+};
+
+// Processes a single report in batch mode. Called from worker threads.
+void process_batch_item(size_t uItem, LPVOID pContext)
+{
+    BatchContext* pCtx = (BatchContext*)pContext;
+    
+    // process_report() doesn't modify the input string, it only needs a non-const pointer
+    int res = process_report((LPTSTR)pCtx->m_aFiles[uItem].c_str(), pCtx->m_szInputMD5, 
+        pCtx->m_szOutput, pCtx->m_szSymSearchPath, NULL, *pCtx->m_paProps, pCtx->m_pExport, 
+        pCtx->m_pBuckets, TRUE);
+    if(res!=SUCCESS)
+        InterlockedIncrement(&pCtx->m_nFailed);
+}
+
+// Processes all reports in the directory or matching the file pattern.
+int process_batch(LPTSTR szBatch, LPTSTR szInputMD5, LPTSTR szOutput, 
+                  LPTSTR szSymSearchPath, const std::vector<PropRequest>& aProps, 
+                  ExportRequest* pExport, BucketRequest* pBuckets, int nThreads)
+{
+    int result = UNEXPECTED;
+    BatchContext ctx;
+    CWorkStealingPool pool;
+    tstring sPattern;
+    tstring sDirName;
+    WIN32_FIND_DATA fd;
+    HANDLE hFind = INVALID_HANDLE_VALUE;
+    DWORD dwFileAttrs = 0;
+    DWORD dwStartTick = 0;
+    double dElapsedSec = 0;
+    
+    // Output must go to a directory, one file per report. When only tables
+    // are exported or reports are bucketed, the output directory is not needed.
+    if(szOutput!=NULL || (pExport==NULL && pBuckets==NULL) || aProps.size()!=0)
+    {
+        dwFileAttrs = szOutput!=NULL?GetFileAttributes(szOutput):INVALID_FILE_ATTRIBUTES;
+        if(dwFileAttrs==INVALID_FILE_ATTRIBUTES ||
+            !(dwFileAttrs&FILE_ATTRIBUTE_DIRECTORY))
+        {
+            result = INVALIDARG;
+            _tprintf(_T("Output directory is missing or invalid; /batch requires /o to be an existing directory.\n"));
+            goto done;
+        }
+    }
+
+    // If a directory is specified, process all ZIP files in it;
+    // otherwise treat the parameter as a file pattern.
+    sPattern = szBatch;
+    dwFileAttrs = GetFileAttributes(szBatch);
+    if(dwFileAttrs!=INVALID_FILE_ATTRIBUTES && 
+        (dwFileAttrs&FILE_ATTRIBUTE_DIRECTORY))
+    {
+        if(sPattern.length()!=0 && sPattern[sPattern.length()-1]!='\\')
+            sPattern += _T("\\");
+        sDirName = sPattern;
+        sPattern += _T("*.zip");
+    }
+    else
+    {
+        size_t pos = sPattern.rfind('\\');
+        if(pos!=tstring::npos)
+            sDirName = sPattern.substr(0, pos+1);
+    }
+
+    // Collect the list of report files
+    hFind = FindFirstFile(sPattern.c_str(), &fd);
+    if(hFind!=INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if(!(fd.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY))
+                ctx.m_aFiles.push_back(sDirName + fd.cFileName);
+        }
+        while(FindNextFile(hFind, &fd));
+
+        FindClose(hFind);
+    }
+
+    if(ctx.m_aFiles.size()==0)
+    {
+        result = INVALIDARG;
+        _tprintf(_T("No files found matching '%s'.\n"), sPattern.c_str());
+        goto done;
+    }
+
+    if(nThreads<=0)
+    {
+        // Use one thread per processor
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        nThreads = (int)si.dwNumberOfProcessors;
+    }
+
+    if((size_t)nThreads>ctx.m_aFiles.size())
+        nThreads = (int)ctx.m_aFiles.size();
+
+    ctx.m_szInputMD5 = szInputMD5;
+    ctx.m_szOutput = szOutput;
+    ctx.m_szSymSearchPath = szSymSearchPath;
+    ctx.m_paProps = &aProps;
+    ctx.m_pExport = pExport;
+    ctx.m_pBuckets = pBuckets;
+    ctx.m_nFailed = 0;
+
+    dwStartTick = GetTickCount();
+
+    if(!pool.Start(ctx.m_aFiles.size(), nThreads, process_batch_item, &ctx))
+    {
+        result = UNEXPECTED;
+        _tprintf(_T("Error: couldn't start worker threads.\n"));
+        goto done;
+    }
+
+    // Print progress to stderr, so it doesn't mix with the output
+    for(;;)
+    {
+        BOOL bFinished = pool.Wait(1000);
+        
+        dElapsedSec = (GetTickCount()-dwStartTick)/1000.0;
+        size_t uCompleted = pool.GetCompletedCount();
+        _ftprintf(stderr, _T("\rProcessed %u of %u reports (%u failed), %.1f reports/sec   "),
+            (unsigned)uCompleted, (unsigned)ctx.m_aFiles.size(), (unsigned)ctx.m_nFailed,
+            dElapsedSec>0?uCompleted/dElapsedSec:0.0);
+
+        if(bFinished)
+            break;
+    }
+
+    _ftprintf(stderr, _T("\nDone in %.1f sec using %d threads (%u steals).\n"), 
+        dElapsedSec, nThreads, (unsigned)pool.GetStealCount());
+
+    result = ctx.m_nFailed==0?SUCCESS:UNEXPECTED;
+
+done:
+
+    return result;
+}
+
+// Receives exported data and appends it to the report's buffer
+BOOL CALLBACK export_write(LPCVOID pData, ULONG cbData, LPVOID pUserParam)
+{
+    ((std::string*)pUserParam)->append((const char*)pData, cbData);
+    return TRUE;
+}
+
+// Writes complete tables of the report to the export file
+int export_tables(CrpHandle hReport, ExportRequest* pExport)
+{
+    int result = UNEXPECTED;
+    std::string sData;
+    const char* pData = NULL;
+    size_t uSize = 0;
+
+    // Each report is encoded to memory first, so rows of different reports
+    // don't interleave when reports are processed by several threads.
+    int res = crpExportTables(hReport, pExport->m_szTableId, pExport->m_nFormat, 
+        CRP_EXPORT_HEADER, export_write, &sData);
+    if(res!=0)
+    {
+        TCHAR szErr[1024];
+        crpGetLastErrorMsg(szErr, 1024);
+        _tprintf(_T("Error '%s' while exporting tables.\n"), szErr);
+        return UNEXPECTED;
+    }
+
+    pData = sData.data();
+    uSize = sData.size();
+
+    EnterCriticalSection(&pExport->m_cs);
+
+    if(pExport->m_nFormat==CRP_EXPORT_CSV && pExport->m_bHeaderWritten)
+    {
+        // The header line is needed only once per file
+        size_t pos = sData.find('\n');
+        pos = pos!=std::string::npos?pos+1:uSize;
+        pData += pos;
+        uSize -= pos;
+    }
+
+    if(uSize==0 || fwrite(pData, 1, uSize, pExport->m_pFile)==uSize)
+    {
+        pExport->m_bHeaderWritten = pExport->m_bHeaderWritten || sData.size()!=0;
+        result = SUCCESS;
+    }
+    else
+    {
+        _tprintf(_T("Error: couldn't write to export file.\n"));
+    }
+
+    LeaveCriticalSection(&pExport->m_cs);
+
+    return result;
+}
+
 // Helper function thatr etrieves an error report property
 int get_prop(CrpHandle hReport, LPCTSTR table_id, LPCTSTR column_id, tstring& str, int row_id)
 {
@@ -542,6 +1082,124 @@ int get_table_row_count(CrpHandle hReport, LPCTSTR table_id)
     return crpGetProperty(hReport, table_id, CRP_META_ROW_COUNT, 0, NULL, 0, NULL);
 }
 
+// Converts a string to UTF-8
+std::string to_utf8(LPCTSTR szString)
+{
+#ifdef UNICODE
+    std::string sResult;
+    int nLen = WideCharToMultiByte(CP_UTF8, 0, szString, -1, NULL, 0, NULL, NULL);
+    if(nLen>1)
+    {
+        sResult.resize(nLen);
+        WideCharToMultiByte(CP_UTF8, 0, szString, -1, &sResult[0], nLen, NULL, NULL);
+        sResult.resize(nLen-1);
+    }
+    return sResult;
+#else
+    return std::string(szString);
+#endif
+}
+
+// Adds the report to its crash bucket
+int add_to_bucket(CrpHandle hReport, LPCTSTR szReport, BucketRequest* pBuckets)
+{
+    tstring sBucketId;
+    tstring sSignature;
+    tstring sCrashTime;
+
+    if(get_table_row_count(hReport, CRP_TBL_MDMP_BUCKET)<=0)
+    {
+        // There is no exception info, keep such reports together
+        sBucketId = _T("NoExceptionInfo");
+    }
+    else
+    {
+        // The signature may be longer than get_prop() buffer
+        ULONG uLen = 0;
+        std::vector<TCHAR> aBuffer;
+        int res = get_prop(hReport, CRP_TBL_MDMP_BUCKET, CRP_COL_BUCKET_ID, sBucketId);
+        if(res==0)
+            res = crpGetProperty(hReport, CRP_TBL_MDMP_BUCKET, CRP_COL_BUCKET_SIGNATURE, 0, NULL, 0, &uLen);
+        if(res==0)
+        {
+            aBuffer.resize(uLen+1);
+            res = crpGetProperty(hReport, CRP_TBL_MDMP_BUCKET, CRP_COL_BUCKET_SIGNATURE, 0, 
+                &aBuffer[0], (ULONG)aBuffer.size(), NULL);
+        }
+        if(res!=0)
+        {
+            TCHAR szErr[1024];
+            crpGetLastErrorMsg(szErr, 1024);
+            _tprintf(_T("Error '%s' while getting crash bucket.\n"), szErr);
+            return UNEXPECTED;
+        }
+        sSignature = &aBuffer[0];
+
+        // No frames are known for the exception thread stack
+        if(sBucketId.empty())
+            sBucketId = _T("NoStackTrace");
+    }
+
+    // Crash time is used for first/last seen dates; it is missing in old reports
+    get_prop(hReport, CRP_TBL_XMLDESC_MISC, CRP_COL_SYSTEM_TIME_UTC, sCrashTime);
+
+    std::string sBucketIdUtf8 = to_utf8(sBucketId.c_str());
+    std::string sSignatureUtf8 = to_utf8(sSignature.c_str());
+    std::string sReportUtf8 = to_utf8(szReport);
+    std::string sCrashTimeUtf8 = to_utf8(sCrashTime.c_str());
+
+    EnterCriticalSection(&pBuckets->m_cs);
+    pBuckets->m_Index.AddReport(sBucketIdUtf8, sSignatureUtf8, sReportUtf8, sCrashTimeUtf8);
+    LeaveCriticalSection(&pBuckets->m_cs);
+
+    return SUCCESS;
+}
+
+// Writes the list of crash buckets to the text file, the largest bucket first
+int write_bucket_summary(BucketRequest* pBuckets, LPCTSTR szSummaryFile)
+{
+    std::vector<CrashBucket> aBuckets;
+    uint64_t uTotal = pBuckets->m_Index.GetReportCount();
+    FILE* f = NULL;
+    size_t i;
+
+    _TFOPEN_S(f, szSummaryFile, _T("wt"));
+    if(f==NULL)
+    {
+        _tprintf(_T("Error: couldn't open summary file '%s'.\n"), szSummaryFile);
+        return UNEXPECTED;
+    }
+
+    pBuckets->m_Index.GetBuckets(aBuckets);
+
+    // Strings in the index are UTF-8, so they are written as is
+    fprintf(f, "Total %I64u reports (100%%) in %u buckets\n", uTotal, (unsigned)aBuckets.size());
+
+    for(i=0; i<aBuckets.size(); i++)
+    {
+        const CrashBucket& b = aBuckets[i];
+        fprintf(f, "\n%u. %u reports (%0.1f%%) in bucket %s\n", (unsigned)(i+1), b.m_uCount,
+            uTotal!=0?100.0*b.m_uCount/uTotal:0.0, b.m_sBucketId.c_str());
+        fprintf(f, "   First seen: %s\n", b.m_sFirstSeen.c_str());
+        fprintf(f, "   Last seen: %s\n", b.m_sLastSeen.c_str());
+        fprintf(f, "   Report: %s\n", b.m_sReport.c_str());
+
+        // Print signature frames one per line
+        size_t pos = 0;
+        while(pos<b.m_sSignature.size())
+        {
+            size_t end = b.m_sSignature.find('\n', pos);
+            if(end==std::string::npos)
+                end = b.m_sSignature.size();
+            fprintf(f, "     %s\n", b.m_sSignature.substr(pos, end-pos).c_str());
+            pos = end+1;
+        }
+    }
+
+    fclose(f);
+    return SUCCESS;
+}
+
 // Writes all error report properties to the file
 int output_document(CrpHandle hReport, FILE* f)
 {  
@@ -745,6 +1403,37 @@ int output_document(CrpHandle hReport, FILE* f)
         doc.EndSection();
     }
 
+    int nBreadcrumbCount = get_table_row_count(hReport, CRP_TBL_XMLDESC_BREADCRUMBS);
+    if(nBreadcrumbCount>0)
+    {
+        doc.BeginSection(_T("Breadcrumbs"));
+
+        // Print breadcrumbs, oldest first
+        doc.PutTableCell(_T("Time"), 24, false);
+        doc.PutTableCell(_T("Thread"), 8, false);
+        doc.PutTableCell(_T("Category"), 16, false);
+        doc.PutTableCell(_T("Message"), 32, true);
+
+        int i;
+        for(i=0; i<nBreadcrumbCount; i++)
+        {
+            tstring sTime;
+            get_prop(hReport, CRP_TBL_XMLDESC_BREADCRUMBS, CRP_COL_BREADCRUMB_TIME, sTime, i);
+            doc.PutTableCell(sTime.c_str(), 24, false);
+            tstring sThreadId;
+            get_prop(hReport, CRP_TBL_XMLDESC_BREADCRUMBS, CRP_COL_BREADCRUMB_THREAD_ID, sThreadId, i);
+            doc.PutTableCell(sThreadId.c_str(), 8, false);
+            tstring sCategory;
+            get_prop(hReport, CRP_TBL_XMLDESC_BREADCRUMBS, CRP_COL_BREADCRUMB_CATEGORY, sCategory, i);
+            doc.PutTableCell(sCategory.c_str(), 16, false);
+            tstring sMessage;
+            get_prop(hReport, CRP_TBL_XMLDESC_BREADCRUMBS, CRP_COL_BREADCRUMB_MESSAGE, sMessage, i);
+            doc.PutTableCell(sMessage.c_str(), 32, true);
+        }
+
+        doc.EndSection();
+    }
+
     doc.BeginSection(_T("File list"));
 
     // Print file list  
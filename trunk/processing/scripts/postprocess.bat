@@ -8,6 +8,7 @@ set ACCEPTABLE_APPVERSION="1.2.0"
 set SYM_SEARCH_DIRS="D:\Projects\CrashRpt\CrashRptSaved\1.2.0"
 set SAVE_RESULTS_TO_DIR="valid_reports\"
 set SAVE_INVALID_REPORTS_TO_DIR="invalid_reports\"
+set BUCKET_INDEX="valid_reports\buckets.idx"
 set CRPROBER_PATH="D:\Projects\CrashRpt\bin\crprober.exe"
 
 mkdir %SAVE_RESULTS_TO_DIR%
@@ -43,27 +44,28 @@ exit
 
 :appversion_ok
 
-  set stack_md5=NoExceptionInfo
-  %CRPROBER_PATH% /f %1 /o "temp.txt" /sym %SYM_SEARCH_DIRS%  /get MdmpMisc ExceptionThreadStackMD5 0
+  rem Get crash bucket ID; it doesn't depend on offsets, so reports of different builds are grouped together
+  set bucket_id=NoExceptionInfo
+  %CRPROBER_PATH% /f %1 /o "temp.txt" /sym %SYM_SEARCH_DIRS%  /get MdmpBucket BucketID 0
   if not %errorlevel%==0 goto save_results
-  set /p stack_md5=<temp.txt
+  set /p bucket_id=<temp.txt
   erase temp.txt
 
-  if %stack_md5%=="" set stack_md5=NoSymbolsLoaded
+  if "%bucket_id%"=="" set bucket_id=NoStackTrace
 
 :save_results
 
-  mkdir %SAVE_RESULTS_TO_DIR%%stack_md5%
+  mkdir %SAVE_RESULTS_TO_DIR%%bucket_id%
   
 
-  rem Process report and write results to text file
-  %CRPROBER_PATH% /f %1 /o %1.txt /sym %SYM_SEARCH_DIRS% 
+  rem Process report, write results to text file and count the report in its bucket
+  %CRPROBER_PATH% /f %1 /o %1.txt /sym %SYM_SEARCH_DIRS% /buckets %BUCKET_INDEX%
   echo Return code=%errorlevel%
   if not %errorlevel%==0 goto failed
 
 :ok
-  move %1 %SAVE_RESULTS_TO_DIR%%stack_md5%
-  move %1.txt %SAVE_RESULTS_TO_DIR%%stack_md5%
+  move %1 %SAVE_RESULTS_TO_DIR%%bucket_id%
+  move %1.txt %SAVE_RESULTS_TO_DIR%%bucket_id%
   goto done
 
 :failed
@@ -0,0 +1,360 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "BreadcrumbLog.h"
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <time.h>
+#endif
+
+// Atomic access to sequence numbers, ring heads and owners. Only the owner of a ring
+// writes to it, so writes need ordering but no read-modify-write; the ring owner is
+// taken with compare-and-swap.
+#ifdef _WIN32
+
+// Stores to volatile variables have release semantics and loads acquire semantics
+// with Visual C++ on x86 and x64; on other processors a full barrier is needed.
+static void OrderMemory()
+{
+#if defined(_M_IX86) || defined(_M_X64)
+    _ReadWriteBarrier();
+#else
+    MemoryBarrier();
+#endif
+}
+
+static uint32_t AtomicLoad(volatile uint32_t* p)
+{
+    uint32_t v = *p;
+    OrderMemory();
+    return v;
+}
+
+static void AtomicStore(volatile uint32_t* p, uint32_t v)
+{
+    OrderMemory();
+    *p = v;
+}
+
+static bool AtomicCompareExchange(volatile uint32_t* p, uint32_t uExpected, uint32_t uNew)
+{
+    return (uint32_t)InterlockedCompareExchange((volatile LONG*)p, (LONG)uNew, (LONG)uExpected)==uExpected;
+}
+
+static void WriteFence()
+{
+    OrderMemory();
+}
+
+static void ReadFence()
+{
+    OrderMemory();
+}
+
+// Returns the clock value
+static uint64_t GetTicks()
+{
+    LARGE_INTEGER li;
+    QueryPerformanceCounter(&li);
+    return (uint64_t)li.QuadPart;
+}
+
+static uint64_t GetTicksPerSec()
+{
+    LARGE_INTEGER li;
+    QueryPerformanceFrequency(&li);
+    return (uint64_t)li.QuadPart;
+}
+
+// Returns microseconds since 1970 (UTC)
+static uint64_t GetSystemTimeUs()
+{
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    uint64_t uTime = ((uint64_t)ft.dwHighDateTime<<32)|ft.dwLowDateTime;
+    return (uTime-116444736000000000ULL)/10;
+}
+
+#else
+
+static uint32_t AtomicLoad(volatile uint32_t* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void AtomicStore(volatile uint32_t* p, uint32_t v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static bool AtomicCompareExchange(volatile uint32_t* p, uint32_t uExpected, uint32_t uNew)
+{
+    return __atomic_compare_exchange_n(p, &uExpected, uNew, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+static void WriteFence()
+{
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void ReadFence()
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+static uint64_t GetTicks()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static uint64_t GetTicksPerSec()
+{
+    return 1000000000ULL;
+}
+
+static uint64_t GetSystemTimeUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec*1000000ULL+ts.tv_nsec/1000;
+}
+
+#endif
+
+// Size of a ring with its records
+#define BREADCRUMB_RING_BYTES (sizeof(BREADCRUMB_RING)+BREADCRUMB_RING_SIZE*sizeof(BREADCRUMB_RECORD))
+
+// Orders breadcrumbs by time
+static bool CompareTime(const BreadcrumbItem& a, const BreadcrumbItem& b)
+{
+    return a.m_uTime<b.m_uTime;
+}
+
+CBreadcrumbLog::CBreadcrumbLog()
+{
+    m_pHeader = NULL;
+}
+
+size_t CBreadcrumbLog::GetRequiredSize()
+{
+    return sizeof(BREADCRUMB_HEADER)+BREADCRUMB_RING_COUNT*BREADCRUMB_RING_BYTES;
+}
+
+void CBreadcrumbLog::Init(void* pMem)
+{
+    memset(pMem, 0, GetRequiredSize());
+
+    m_pHeader = (BREADCRUMB_HEADER*)pMem;
+    memcpy(m_pHeader->m_uchMagic, "BCL1", 4);
+    m_pHeader->m_uRingCount = BREADCRUMB_RING_COUNT;
+    m_pHeader->m_uRingSize = BREADCRUMB_RING_SIZE;
+    m_pHeader->m_uRecordSize = sizeof(BREADCRUMB_RECORD);
+    m_pHeader->m_uTicksPerSec = GetTicksPerSec();
+    m_pHeader->m_uBaseTicks = GetTicks();
+    m_pHeader->m_uBaseTime = GetSystemTimeUs();
+}
+
+bool CBreadcrumbLog::Attach(void* pMem, size_t uSize)
+{
+    Detach();
+
+    if(pMem==NULL || uSize<GetRequiredSize())
+        return false;
+
+    BREADCRUMB_HEADER* pHeader = (BREADCRUMB_HEADER*)pMem;
+    if(memcmp(pHeader->m_uchMagic, "BCL1", 4)!=0 ||
+        pHeader->m_uRingCount!=BREADCRUMB_RING_COUNT ||
+        pHeader->m_uRingSize!=BREADCRUMB_RING_SIZE ||
+        pHeader->m_uRecordSize!=sizeof(BREADCRUMB_RECORD) ||
+        pHeader->m_uTicksPerSec==0)
+        return false;
+
+    m_pHeader = pHeader;
+    return true;
+}
+
+void CBreadcrumbLog::Detach()
+{
+    m_pHeader = NULL;
+}
+
+bool CBreadcrumbLog::IsAttached() const
+{
+    return m_pHeader!=NULL;
+}
+
+BREADCRUMB_RING* CBreadcrumbLog::GetRing(int nRing) const
+{
+    return (BREADCRUMB_RING*)((uint8_t*)(m_pHeader+1)+nRing*BREADCRUMB_RING_BYTES);
+}
+
+BREADCRUMB_RECORD* CBreadcrumbLog::GetRecord(BREADCRUMB_RING* pRing, uint32_t uIndex)
+{
+    return (BREADCRUMB_RECORD*)(pRing+1)+(uIndex&(BREADCRUMB_RING_SIZE-1));
+}
+
+int CBreadcrumbLog::AcquireRing(uint32_t uThreadId)
+{
+    if(m_pHeader==NULL)
+        return -1;
+
+    // Thread ID 0 marks a free ring
+    if(uThreadId==0)
+        uThreadId = 0xFFFFFFFF;
+
+    int i;
+    for(i=0; i<BREADCRUMB_RING_COUNT; i++)
+    {
+        BREADCRUMB_RING* pRing = GetRing(i);
+        if(AtomicLoad(&pRing->m_uOwner)==0 &&
+            AtomicCompareExchange(&pRing->m_uOwner, 0, uThreadId))
+            return i;
+    }
+
+    return -1;
+}
+
+void CBreadcrumbLog::ReleaseRing(int nRing)
+{
+    if(m_pHeader==NULL || nRing<0 || nRing>=BREADCRUMB_RING_COUNT)
+        return;
+
+    AtomicStore(&GetRing(nRing)->m_uOwner, 0);
+}
+
+int CBreadcrumbLog::Add(int nRing, uint32_t uFlags, const void* pCategory, size_t uCategorySize,
+    const void* pMessage, size_t uMessageSize)
+{
+    if(m_pHeader==NULL || nRing<0 || nRing>=BREADCRUMB_RING_COUNT)
+        return BREADCRUMB_ERR_NOT_ATTACHED;
+
+    // Truncate the text, keeping whole UTF-16 characters
+    if(uCategorySize>BREADCRUMB_MAX_CATEGORY_SIZE)
+        uCategorySize = BREADCRUMB_MAX_CATEGORY_SIZE;
+    if(uMessageSize>BREADCRUMB_MAX_TEXT_SIZE-uCategorySize)
+        uMessageSize = BREADCRUMB_MAX_TEXT_SIZE-uCategorySize;
+    if(uFlags&BREADCRUMB_FLAG_WIDE)
+    {
+        uCategorySize &= ~(size_t)1;
+        uMessageSize &= ~(size_t)1;
+    }
+
+    BREADCRUMB_RING* pRing = GetRing(nRing);
+    uint32_t uHead = pRing->m_uHead; // Only we write it
+    BREADCRUMB_RECORD* pRecord = GetRecord(pRing, uHead);
+
+    // The odd sequence number must be visible before the record changes
+    pRecord->m_uSeq = 2*uHead+1;
+    WriteFence();
+
+    pRecord->m_uThreadId = pRing->m_uOwner;
+    pRecord->m_uTicks = GetTicks();
+    pRecord->m_uFlags = (uint16_t)uFlags;
+    pRecord->m_uCategorySize = (uint16_t)uCategorySize;
+    pRecord->m_uMessageSize = (uint16_t)uMessageSize;
+    memcpy(pRecord->m_auchText, pCategory, uCategorySize);
+    memcpy(pRecord->m_auchText+uCategorySize, pMessage, uMessageSize);
+
+    AtomicStore(&pRecord->m_uSeq, 2*uHead+2);
+    AtomicStore(&pRing->m_uHead, uHead+1);
+
+    return BREADCRUMB_OK;
+}
+
+uint64_t CBreadcrumbLog::TicksToTime(uint64_t uTicks) const
+{
+    uint64_t uTicksPerSec = m_pHeader->m_uTicksPerSec;
+    uint64_t uDelta = uTicks-m_pHeader->m_uBaseTicks;
+    return m_pHeader->m_uBaseTime+uDelta/uTicksPerSec*1000000+uDelta%uTicksPerSec*1000000/uTicksPerSec;
+}
+
+void CBreadcrumbLog::ReadRing(BREADCRUMB_RING* pRing, std::vector<BreadcrumbItem>& aItems) const
+{
+    uint32_t uHead = AtomicLoad(&pRing->m_uHead);
+    uint32_t uCount = uHead<BREADCRUMB_RING_SIZE ? uHead : BREADCRUMB_RING_SIZE;
+    uint8_t auchText[BREADCRUMB_MAX_TEXT_SIZE];
+    uint32_t i;
+
+    for(i=uHead-uCount; i!=uHead; i++)
+    {
+        BREADCRUMB_RECORD* pRecord = GetRecord(pRing, i);
+
+        // Skip the record if it doesn't hold the i-th write (it is being overwritten or
+        // has already been overwritten)
+        uint32_t uSeq = AtomicLoad(&pRecord->m_uSeq);
+        if(uSeq!=2*i+2)
+            continue;
+
+        BreadcrumbItem item;
+        uint64_t uTicks = pRecord->m_uTicks;
+        size_t uCategorySize = pRecord->m_uCategorySize;
+        size_t uMessageSize = pRecord->m_uMessageSize;
+        item.m_uThreadId = pRecord->m_uThreadId;
+        item.m_uFlags = pRecord->m_uFlags;
+        if(uCategorySize>BREADCRUMB_MAX_CATEGORY_SIZE ||
+            uMessageSize>BREADCRUMB_MAX_TEXT_SIZE-uCategorySize)
+            continue;
+        memcpy(auchText, pRecord->m_auchText, uCategorySize+uMessageSize);
+
+        ReadFence();
+        if(pRecord->m_uSeq!=uSeq)
+            continue;
+
+        item.m_uTime = TicksToTime(uTicks);
+        item.m_sCategory.assign((const char*)auchText, uCategorySize);
+        item.m_sMessage.assign((const char*)auchText+uCategorySize, uMessageSize);
+        aItems.push_back(item);
+    }
+}
+
+void CBreadcrumbLog::ReadAll(std::vector<BreadcrumbItem>& aItems) const
+{
+    aItems.clear();
+    if(m_pHeader==NULL)
+        return;
+
+    // Records of a ring are ordered by time, so the rings are merged one by one
+    int i;
+    for(i=0; i<BREADCRUMB_RING_COUNT; i++)
+    {
+        size_t uMiddle = aItems.size();
+        ReadRing(GetRing(i), aItems);
+        std::inplace_merge(aItems.begin(), aItems.begin()+uMiddle, aItems.end(), CompareTime);
+    }
+}
+
+std::string CBreadcrumbLog::FormatTime(uint64_t uTime)
+{
+    // Convert days since 1970 to a civil date (proleptic Gregorian calendar)
+    uint64_t uSeconds = uTime/1000000;
+    int nDays = (int)(uSeconds/86400);
+    int nSecOfDay = (int)(uSeconds%86400);
+    int z = nDays+719468;
+    int nEra = z/146097;
+    int nDayOfEra = z-nEra*146097;
+    int nYearOfEra = (nDayOfEra-nDayOfEra/1460+nDayOfEra/36524-nDayOfEra/146096)/365;
+    int nDayOfYear = nDayOfEra-(365*nYearOfEra+nYearOfEra/4-nYearOfEra/100);
+    int mp = (5*nDayOfYear+2)/153;
+    int nDay = nDayOfYear-(153*mp+2)/5+1;
+    int nMonth = mp<10 ? mp+3 : mp-9;
+    int nYear = nYearOfEra+nEra*400+(nMonth<=2 ? 1 : 0);
+
+    char szTime[64];
+    sprintf(szTime, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", nYear, nMonth, nDay,
+        nSecOfDay/3600, nSecOfDay/60%60, nSecOfDay%60, (int)(uTime/1000%1000));
+    return szTime;
+}
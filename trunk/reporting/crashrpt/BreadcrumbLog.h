@@ -0,0 +1,157 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: BreadcrumbLog.h
+// Description: Log of recent application events (breadcrumbs) placed in shared memory.
+// Each thread writes to its own ring of fixed-size records, so adding a breadcrumb
+// takes no lock and overwrites the oldest record of the ring when it is full. A record
+// is guarded by its sequence number: it is odd while the record is being written and
+// tells the reader which write the record holds. The reader merges the rings by time.
+
+#pragma once
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int8  uint8_t;
+typedef unsigned __int16 uint16_t;
+typedef unsigned __int32 uint32_t;
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// Number of rings, that is, how many threads may add breadcrumbs at the same time
+#define BREADCRUMB_RING_COUNT 64
+
+// Number of records in a ring (a power of two)
+#define BREADCRUMB_RING_SIZE 128
+
+// Size of category and message text stored in a record, in bytes. Longer
+// strings are truncated.
+#define BREADCRUMB_MAX_TEXT_SIZE 232
+#define BREADCRUMB_MAX_CATEGORY_SIZE 64
+
+// Record flags
+#define BREADCRUMB_FLAG_WIDE 0x1  // Text is UTF-16, otherwise it is in the ANSI code page
+
+// Error codes returned by CBreadcrumbLog methods
+enum BreadcrumbLogError
+{
+    BREADCRUMB_OK = 0,              // Success
+    BREADCRUMB_ERR_NOT_ATTACHED = 1, // The log is not initialized
+    BREADCRUMB_ERR_NO_RING = 2      // All rings are owned by other threads
+};
+
+// Log header
+struct BREADCRUMB_HEADER
+{
+    uint8_t m_uchMagic[4];     // Magic sequence "BCL1"
+    uint32_t m_uRingCount;     // Number of rings
+    uint32_t m_uRingSize;      // Number of records in a ring
+    uint32_t m_uRecordSize;    // sizeof(BREADCRUMB_RECORD)
+    uint64_t m_uTicksPerSec;   // Frequency of the clock used for record time
+    uint64_t m_uBaseTicks;     // Clock value when the log was created
+    uint64_t m_uBaseTime;      // Time when the log was created, microseconds since 1970 (UTC)
+    uint8_t m_uchReserved[24];
+};
+
+// Breadcrumb record
+struct BREADCRUMB_RECORD
+{
+    volatile uint32_t m_uSeq;  // 2*n+1 while the n-th write of the ring is in progress, 2*n+2 after it
+    uint32_t m_uThreadId;      // Thread that added the breadcrumb
+    uint64_t m_uTicks;         // Clock value
+    uint16_t m_uFlags;         // BREADCRUMB_FLAG_*
+    uint16_t m_uCategorySize;  // Category size in bytes
+    uint16_t m_uMessageSize;   // Message size in bytes
+    uint16_t m_uReserved;
+    uint8_t m_auchText[BREADCRUMB_MAX_TEXT_SIZE]; // Category followed by message
+};
+
+// Ring header, followed by BREADCRUMB_RING_SIZE records. Rings start on a cache line,
+// so threads writing to different rings don't share cache lines.
+struct BREADCRUMB_RING
+{
+    volatile uint32_t m_uOwner; // ID of the thread writing to the ring, 0 if the ring is free
+    volatile uint32_t m_uHead;  // Number of records written to the ring
+    uint8_t m_uchReserved[56];
+};
+
+// A breadcrumb read from the log
+struct BreadcrumbItem
+{
+    uint64_t m_uTime;          // Microseconds since 1970 (UTC)
+    uint32_t m_uThreadId;      // Thread ID
+    uint32_t m_uFlags;         // BREADCRUMB_FLAG_*
+    std::string m_sCategory;   // Category, bytes of UTF-16 or ANSI string
+    std::string m_sMessage;    // Message, bytes of UTF-16 or ANSI string
+};
+
+// class CBreadcrumbLog
+// Accesses a breadcrumb log in a memory region it doesn't own. A thread takes a ring
+// with AcquireRing() once and passes the ring index to Add(); only the owner writes to
+// a ring. The records of a released ring are kept until its next owner overwrites them.
+class CBreadcrumbLog
+{
+public:
+
+    CBreadcrumbLog();
+
+    // Returns the size of memory needed for the log
+    static size_t GetRequiredSize();
+
+    // Formats the memory region (at least GetRequiredSize() bytes) as an empty log
+    void Init(void* pMem);
+
+    // Attaches to a log formatted by another process. Returns false if the region
+    // doesn't contain a valid log.
+    bool Attach(void* pMem, size_t uSize);
+
+    // Detaches from the memory region
+    void Detach();
+
+    // Returns true if attached to a log
+    bool IsAttached() const;
+
+    // Takes a free ring for the thread. Returns the ring index, or -1 if all rings are owned.
+    int AcquireRing(uint32_t uThreadId);
+
+    // Frees the ring taken by AcquireRing()
+    void ReleaseRing(int nRing);
+
+    // Adds a breadcrumb to the ring owned by the calling thread. Text that doesn't fit
+    // into a record is truncated.
+    int Add(int nRing, uint32_t uFlags, const void* pCategory, size_t uCategorySize,
+        const void* pMessage, size_t uMessageSize);
+
+    // Reads breadcrumbs of all rings ordered by time. Records being overwritten
+    // while they are read are skipped.
+    void ReadAll(std::vector<BreadcrumbItem>& aItems) const;
+
+    // Formats time as YYYY-MM-DDThh:mm:ss.sssZ
+    static std::string FormatTime(uint64_t uTime);
+
+private:
+
+    // Returns the ring header
+    BREADCRUMB_RING* GetRing(int nRing) const;
+
+    // Returns the record of the ring
+    static BREADCRUMB_RECORD* GetRecord(BREADCRUMB_RING* pRing, uint32_t uIndex);
+
+    // Appends records of the ring to the list
+    void ReadRing(BREADCRUMB_RING* pRing, std::vector<BreadcrumbItem>& aItems) const;
+
+    // Converts clock value to microseconds since 1970
+    uint64_t TicksToTime(uint64_t uTicks) const;
+
+    BREADCRUMB_HEADER* m_pHeader; // Log header, or NULL
+};
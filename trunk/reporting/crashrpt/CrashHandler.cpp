@@ -60,6 +60,7 @@ CCrashHandler::CCrashHandler()
   m_hEvent = NULL;
   m_hEvent2 = NULL;
   m_pCrashDesc = NULL;
+  m_dwBreadcrumbTlsIndex = TLS_OUT_OF_INDEXES;
   m_hSenderProcess = NULL;
   m_pfnCallback2W = NULL;
   m_pfnCallback2A = NULL;
@@ -403,6 +404,15 @@ int CCrashHandler::Init(
     return 1; 
   }
 
+  // Allocate TLS slot for breadcrumb ring indices of threads.
+  m_dwBreadcrumbTlsIndex = TlsAlloc();
+  if(m_dwBreadcrumbTlsIndex==TLS_OUT_OF_INDEXES)
+  {
+    ATLASSERT(0);
+    crSetErrorMsg(_T("Couldn't allocate TLS slot."));
+    return 1; 
+  }
+
   // Init some fields that should be reinitialized before each new crash.
   if(0!=PerCrashInit())
     return 1;
@@ -571,6 +581,32 @@ CRASH_DESCRIPTION* CCrashHandler::PackCrashInfoIntoSharedMem(CSharedMem* pShared
   m_pTmpCrashDesc->m_dwSmtpLoginOffs = PackString(m_sSmtpLogin);
   m_pTmpCrashDesc->m_dwSmtpPasswordOffs = PackString(m_sSmtpPassword);
 
+  // Init custom property table
+  CPropertyTable TmpPropTable;
+  CPropertyTable* pPropTable = bTempMem ? &TmpPropTable : &m_PropTable;
+  std::map<CString, DWORD> TmpPropBlocks;
+  std::map<CString, DWORD>* pPropBlocks = bTempMem ? &TmpPropBlocks : &m_PropBlocks;
+  pPropBlocks->clear();
+  pPropTable->Init(pSharedMem->CreateView(SHARED_MEM_PROP_TABLE_OFFS, (DWORD)CPropertyTable::GetRequiredSize()));
+  m_pTmpCrashDesc->m_dwPropTableOffs = SHARED_MEM_PROP_TABLE_OFFS;
+
+  // Init breadcrumb log (queued reports sent with temporary memory have no breadcrumbs).
+  // The log has its own file mapping that is created once and is never recreated
+  // on the next crash, because threads write breadcrumbs to it without a lock.
+  if(!bTempMem)
+  {
+    if(!m_BreadcrumbMem.IsInitialized())
+    {
+      CString sBreadcrumbMemName;
+      sBreadcrumbMemName.Format(_T("%s-breadcrumbs"), m_sCrashGUID);
+      if(m_BreadcrumbMem.Init(sBreadcrumbMemName, FALSE, CBreadcrumbLog::GetRequiredSize()))
+        m_Breadcrumbs.Init(m_BreadcrumbMem.CreateView(0, (DWORD)CBreadcrumbLog::GetRequiredSize()));
+    }
+
+    if(m_Breadcrumbs.IsAttached())
+      m_pTmpCrashDesc->m_dwBreadcrumbsNameOffs = PackString(m_BreadcrumbMem.GetName());
+  }
+
   // Pack file items
   std::map<CString, FileItem>::iterator fit;
   for(fit=m_files.begin(); fit!=m_files.end(); fit++)
@@ -583,7 +619,7 @@ CRASH_DESCRIPTION* CCrashHandler::PackCrashInfoIntoSharedMem(CSharedMem* pShared
   std::map<CString, CString>::iterator pit;
   for(pit=m_props.begin(); pit!=m_props.end(); pit++)
   {
-    PackProperty(pit->first, pit->second);
+    StoreProperty(pPropTable, pPropBlocks, pit->first, pit->second);
   }
 
   // Pack reg keys
@@ -597,18 +633,30 @@ CRASH_DESCRIPTION* CCrashHandler::PackCrashInfoIntoSharedMem(CSharedMem* pShared
   return m_pTmpCrashDesc;
 }
 
-// Packs a string to shared memory
-DWORD CCrashHandler::PackString(CString str)
+// Packs a string to shared memory. Returns the offset of the string block,
+// or 0 if there is not enough space for it.
+DWORD CCrashHandler::PackString(CString str, DWORD dwCapacity)
 {
   DWORD dwTotalSize = m_pTmpCrashDesc->m_dwTotalSize;
-  int nStrLen = str.GetLength()*sizeof(TCHAR);
-  WORD wLength = (WORD)(sizeof(STRING_DESC)+nStrLen);
+  DWORD dwStrLen = str.GetLength()*sizeof(TCHAR);
+  if(dwCapacity<dwStrLen)
+    dwCapacity = dwStrLen;
+  if(dwCapacity>SHARED_MEM_MAX_STRING_SIZE)
+    dwCapacity = SHARED_MEM_MAX_STRING_SIZE; // Longer string is truncated
+  if(dwStrLen>dwCapacity)
+    dwStrLen = dwCapacity;
+  WORD wLength = (WORD)(sizeof(STRING_DESC)+dwCapacity);
+
+  // Blocks must not run into the property table
+  if(dwTotalSize+wLength>SHARED_MEM_PROP_TABLE_OFFS)
+    return 0;
 
   LPBYTE pView = m_pTmpSharedMem->CreateView(dwTotalSize, wLength);
   STRING_DESC* pStrDesc = (STRING_DESC*)pView;
   memcpy(pStrDesc->m_uchMagic, "STR", 3);
   pStrDesc->m_wSize = wLength;
-  memcpy(pView+sizeof(STRING_DESC), str.GetBuffer(0), nStrLen);
+  memcpy(pView+sizeof(STRING_DESC), str.GetBuffer(0), dwStrLen);
+  memset(pView+sizeof(STRING_DESC)+dwStrLen, 0, dwCapacity-dwStrLen);
 
   m_pTmpCrashDesc->m_dwTotalSize += wLength;
 
@@ -616,13 +664,35 @@ DWORD CCrashHandler::PackString(CString str)
   return dwTotalSize;
 }
 
-// Packs file item to shared memory
+// Replaces the string packed at the given offset. Returns FALSE if the string
+// doesn't fit into the block; dwCapacity receives the size of the block data.
+BOOL CCrashHandler::ReplaceString(DWORD dwOffset, CString str, DWORD& dwCapacity)
+{
+  LPBYTE pView = m_pTmpSharedMem->CreateView(dwOffset, sizeof(STRING_DESC));
+  STRING_DESC* pStrDesc = (STRING_DESC*)pView;
+  dwCapacity = pStrDesc->m_wSize-sizeof(STRING_DESC);
+  m_pTmpSharedMem->DestroyView(pView);
+
+  DWORD dwStrLen = str.GetLength()*sizeof(TCHAR);
+  if(dwStrLen>dwCapacity)
+    return FALSE;
+
+  pView = m_pTmpSharedMem->CreateView(dwOffset+sizeof(STRING_DESC), dwCapacity);
+  memcpy(pView, str.GetBuffer(0), dwStrLen);
+  memset(pView+dwStrLen, 0, dwCapacity-dwStrLen);
+  m_pTmpSharedMem->DestroyView(pView);
+  return TRUE;
+}
+
+// Packs file item to shared memory. Returns the offset of the block,
+// or 0 if there is not enough space for it.
 DWORD CCrashHandler::PackFileItem(FileItem& fi)
 {
   DWORD dwTotalSize = m_pTmpCrashDesc->m_dwTotalSize;
   WORD wLength = sizeof(FILE_ITEM);
+  if(dwTotalSize+wLength>SHARED_MEM_PROP_TABLE_OFFS)
+    return 0;
   m_pTmpCrashDesc->m_dwTotalSize += wLength;
-  m_pTmpCrashDesc->m_uFileItems++;
 
   LPBYTE pView = m_pTmpSharedMem->CreateView(dwTotalSize, wLength);
   FILE_ITEM* pFileItem = (FILE_ITEM*)pView;
@@ -633,39 +703,114 @@ DWORD CCrashHandler::PackFileItem(FileItem& fi)
   pFileItem->m_dwDescriptionOffs = PackString(fi.m_sDescription);
   pFileItem->m_bMakeCopy = fi.m_bMakeCopy;
   pFileItem->m_bAllowDelete = fi.m_bAllowDelete;
+  pFileItem->m_bSnapshot = fi.m_bSnapshot;
   pFileItem->m_wSize = (WORD)(m_pTmpCrashDesc->m_dwTotalSize-dwTotalSize);
 
+  BOOL bPacked = pFileItem->m_dwSrcFilePathOffs!=0 && 
+    pFileItem->m_dwDstFileNameOffs!=0 && pFileItem->m_dwDescriptionOffs!=0;
+
   m_pTmpSharedMem->DestroyView(pView);
+
+  if(!bPacked)
+  {
+    // Drop the incomplete block
+    m_pTmpCrashDesc->m_dwTotalSize = dwTotalSize;
+    return 0;
+  }
+
+  m_pTmpCrashDesc->m_uFileItems++;
   return dwTotalSize;
 }
 
-// Packs custom property to shared memory
-DWORD CCrashHandler::PackProperty(CString sName, CString sValue)
+// Packs custom property to shared memory. Returns the offset of the block,
+// or 0 if there is not enough space for it.
+DWORD CCrashHandler::PackProperty(CString sName, CString sValue, DWORD dwValueCapacity)
 {
   DWORD dwTotalSize = m_pTmpCrashDesc->m_dwTotalSize;
   WORD wLength = sizeof(CUSTOM_PROP);
+  if(dwTotalSize+wLength>SHARED_MEM_PROP_TABLE_OFFS)
+    return 0;
   m_pTmpCrashDesc->m_dwTotalSize += wLength;
-  m_pTmpCrashDesc->m_uCustomProps++;
 
   LPBYTE pView = m_pTmpSharedMem->CreateView(dwTotalSize, wLength);
   CUSTOM_PROP* pProp = (CUSTOM_PROP*)pView;
 
   memcpy(pProp->m_uchMagic, "CPR", 3);
   pProp->m_dwNameOffs = PackString(sName);
-  pProp->m_dwValueOffs = PackString(sValue);
+  pProp->m_dwValueOffs = PackString(sValue, dwValueCapacity);
   pProp->m_wSize = (WORD)(m_pTmpCrashDesc->m_dwTotalSize-dwTotalSize);
 
+  BOOL bPacked = pProp->m_dwNameOffs!=0 && pProp->m_dwValueOffs!=0;
+
   m_pTmpSharedMem->DestroyView(pView);
+
+  if(!bPacked)
+  {
+    // Drop the incomplete block
+    m_pTmpCrashDesc->m_dwTotalSize = dwTotalSize;
+    return 0;
+  }
+
+  m_pTmpCrashDesc->m_uCustomProps++;
   return dwTotalSize;
 }
 
-// Packs registry key to shared memory
+// Stores custom property in the property table. Returns FALSE if there is not
+// enough space for the property, or the value is truncated.
+BOOL CCrashHandler::StoreProperty(CPropertyTable* pPropTable, std::map<CString, DWORD>* pPropBlocks, 
+                                  CString sName, CString sValue)
+{
+  // The table slot is overwritten on each update. Properties that don't fit into
+  // the table are packed as blocks; the reader takes table values over blocks.
+  int nResult = pPropTable->Set((LPCTSTR)sName, sName.GetLength()*sizeof(TCHAR), 
+    (LPCTSTR)sValue, sValue.GetLength()*sizeof(TCHAR));
+  if(nResult==PROPTABLE_OK)
+    return TRUE;
+
+  BOOL bTruncated = FALSE;
+  if(sValue.GetLength()*sizeof(TCHAR)>SHARED_MEM_MAX_STRING_SIZE)
+  {
+    sValue = sValue.Left((int)(SHARED_MEM_MAX_STRING_SIZE/sizeof(TCHAR)));
+    bTruncated = TRUE;
+  }
+
+  // The value of a packed property is replaced in place while it fits into the block,
+  // so updating the property doesn't use up shared memory. A value that doesn't fit
+  // is packed in a new block of twice the size; the reader takes the latest block.
+  DWORD dwCapacity = 0;
+  std::map<CString, DWORD>::iterator it = pPropBlocks->find(sName);
+  if(it!=pPropBlocks->end())
+  {
+    if(ReplaceString(it->second, sValue, dwCapacity))
+      return !bTruncated;
+    dwCapacity *= 2;
+  }
+
+  DWORD dwPropOffs = PackProperty(sName, sValue, dwCapacity);
+  if(dwPropOffs!=0)
+  {
+    CUSTOM_PROP* pProp = (CUSTOM_PROP*)m_pTmpSharedMem->CreateView(dwPropOffs, sizeof(CUSTOM_PROP));
+    (*pPropBlocks)[sName] = pProp->m_dwValueOffs;
+    m_pTmpSharedMem->DestroyView((LPBYTE)pProp);
+    return !bTruncated;
+  }
+
+  // Not enough space for the block, store the beginning of the value in the table
+  CString sValueBegin = sValue.Left(PROPTABLE_MAX_VALUE_SIZE/sizeof(TCHAR));
+  pPropTable->Set((LPCTSTR)sName, sName.GetLength()*sizeof(TCHAR), 
+    (LPCTSTR)sValueBegin, sValueBegin.GetLength()*sizeof(TCHAR));
+  return FALSE;
+}
+
+// Packs registry key to shared memory. Returns the offset of the block,
+// or 0 if there is not enough space for it.
 DWORD CCrashHandler::PackRegKey(CString sKeyName, RegKeyInfo& rki)
 {
   DWORD dwTotalSize = m_pTmpCrashDesc->m_dwTotalSize;
   WORD wLength = sizeof(REG_KEY);
+  if(dwTotalSize+wLength>SHARED_MEM_PROP_TABLE_OFFS)
+    return 0;
   m_pTmpCrashDesc->m_dwTotalSize += wLength;
-  m_pTmpCrashDesc->m_uRegKeyEntries++;
 
   LPBYTE pView = m_pTmpSharedMem->CreateView(dwTotalSize, wLength);
   REG_KEY* pKey = (REG_KEY*)pView;
@@ -676,7 +821,18 @@ DWORD CCrashHandler::PackRegKey(CString sKeyName, RegKeyInfo& rki)
   pKey->m_dwDstFileNameOffs = PackString(rki.m_sDstFileName);
   pKey->m_wSize = (WORD)(m_pTmpCrashDesc->m_dwTotalSize-dwTotalSize);
 
+  BOOL bPacked = pKey->m_dwRegKeyNameOffs!=0 && pKey->m_dwDstFileNameOffs!=0;
+
   m_pTmpSharedMem->DestroyView(pView);
+
+  if(!bPacked)
+  {
+    // Drop the incomplete block
+    m_pTmpCrashDesc->m_dwTotalSize = dwTotalSize;
+    return 0;
+  }
+
+  m_pTmpCrashDesc->m_uRegKeyEntries++;
   return dwTotalSize;
 }
 
@@ -731,6 +887,13 @@ int CCrashHandler::Destroy()
 
   m_oldSehHandler = NULL;
 
+  // Free TLS slot of breadcrumb rings
+  if(m_dwBreadcrumbTlsIndex!=TLS_OUT_OF_INDEXES)
+  {
+    TlsFree(m_dwBreadcrumbTlsIndex);
+    m_dwBreadcrumbTlsIndex = TLS_OUT_OF_INDEXES;
+  }
+
   // All installed per-thread C++ exception handlers should be uninstalled
   // using crUninstallFromCurrentThread() before calling Destroy()
 
@@ -1076,6 +1239,7 @@ int CCrashHandler::AddFile(LPCTSTR pszFile, LPCTSTR pszDestFile, LPCTSTR pszDesc
     fi.m_sSrcFilePath = pszFile;
     fi.m_bMakeCopy = (dwFlags&CR_AF_MAKE_FILE_COPY)!=0;
     fi.m_bAllowDelete = (dwFlags&CR_AF_ALLOW_DELETE)!=0;
+    fi.m_bSnapshot = (dwFlags&CR_AF_SNAPSHOT)!=0;
     if(pszDestFile!=NULL)
     {
       fi.m_sDstFileName = pszDestFile;        
@@ -1100,10 +1264,14 @@ int CCrashHandler::AddFile(LPCTSTR pszFile, LPCTSTR pszDestFile, LPCTSTR pszDesc
       return 1;
     }
 
-    m_files[fi.m_sDstFileName] = fi;
-
     // Pack this file item into shared mem.
-    PackFileItem(fi);
+    if(0==PackFileItem(fi))
+    {
+      crSetErrorMsg(_T("Not enough shared memory to add the file."));
+      return 1;
+    }
+
+    m_files[fi.m_sDstFileName] = fi;
   }
   else // Search pattern
   {			
@@ -1114,10 +1282,16 @@ int CCrashHandler::AddFile(LPCTSTR pszFile, LPCTSTR pszDestFile, LPCTSTR pszDesc
     fi.m_sDstFileName = Utility::GetFileName(pszFile);
     fi.m_bMakeCopy = (dwFlags&CR_AF_MAKE_FILE_COPY)!=0;
     fi.m_bAllowDelete = (dwFlags&CR_AF_ALLOW_DELETE)!=0;		
-    m_files[fi.m_sDstFileName] = fi;
+    fi.m_bSnapshot = (dwFlags&CR_AF_SNAPSHOT)!=0;
 
     // Pack this file item into shared mem.
-    PackFileItem(fi);
+    if(0==PackFileItem(fi))
+    {
+      crSetErrorMsg(_T("Not enough shared memory to add the file."));
+      return 1;
+    }
+
+    m_files[fi.m_sDstFileName] = fi;
   }	 
 
   // OK.
@@ -1138,13 +1312,59 @@ int CCrashHandler::AddProperty(CString sPropName, CString sPropValue)
 
   m_props[sPropName] = sPropValue;
 
-  PackProperty(sPropName, sPropValue);
+  if(!StoreProperty(&m_PropTable, &m_PropBlocks, sPropName, sPropValue))
+  {
+    crSetErrorMsg(_T("Not enough shared memory to store the whole property value."));
+    return 2;
+  }
 
   // OK.
   crSetErrorMsg(_T("Success."));
   return 0;
 }
 
+// Adds a breadcrumb to the error report
+int CCrashHandler::AddBreadcrumb(LPCVOID pCategory, size_t uCategorySize, 
+                                 LPCVOID pMessage, size_t uMessageSize, BOOL bWide)
+{
+  // This method is called from hot paths of the application, so it takes no lock
+  // and doesn't set the error message on success.
+
+  // Take a ring when the thread adds its first breadcrumb
+  int nRing = (int)(INT_PTR)TlsGetValue(m_dwBreadcrumbTlsIndex)-1;
+  if(nRing<0)
+  {
+    nRing = m_Breadcrumbs.AcquireRing(GetCurrentThreadId());
+    if(nRing<0)
+    {
+      crSetErrorMsg(_T("Too many threads add breadcrumbs."));
+      return 1;
+    }
+    TlsSetValue(m_dwBreadcrumbTlsIndex, (LPVOID)(INT_PTR)(nRing+1));
+  }
+
+  if(BREADCRUMB_OK!=m_Breadcrumbs.Add(nRing, bWide?BREADCRUMB_FLAG_WIDE:0, 
+    pCategory, uCategorySize, pMessage, uMessageSize))
+  {
+    crSetErrorMsg(_T("Breadcrumb log is not initialized."));
+    return 2;
+  }
+
+  // OK.
+  return 0;
+}
+
+// Frees the breadcrumb ring of the caller thread
+void CCrashHandler::ReleaseThreadBreadcrumbRing()
+{
+  int nRing = (int)(INT_PTR)TlsGetValue(m_dwBreadcrumbTlsIndex)-1;
+  if(nRing<0)
+    return;
+
+  m_Breadcrumbs.ReleaseRing(nRing);
+  TlsSetValue(m_dwBreadcrumbTlsIndex, NULL);
+}
+
 // Adds a screen shot to the error report
 int CCrashHandler::AddScreenshot(DWORD dwFlags, int nJpegQuality)
 { 
@@ -1497,9 +1717,13 @@ int CCrashHandler::AddRegKey(LPCTSTR szRegKey, LPCTSTR szDstFileName, DWORD dwFl
   rki.m_sDstFileName = sDstFileName;
   rki.m_bAllowDelete = (dwFlags&CR_AR_ALLOW_DELETE)!=0;
 
-  m_RegKeys[CString(szRegKey)] = rki;
+  if(0==PackRegKey(szRegKey, rki))
+  {
+    crSetErrorMsg(_T("Not enough shared memory to add the registry key."));
+    return 4;
+  }
 
-  PackRegKey(szRegKey, rki);
+  m_RegKeys[CString(szRegKey)] = rki;
 
   // OK
   crSetErrorMsg(_T("Success."));
@@ -1672,11 +1896,14 @@ int CCrashHandler::PerCrashInit()
   m_sErrorReportDirW = strconv.t2w(sErrorReportDirName);
   m_sErrorReportDirA = strconv.t2a(sErrorReportDirName);
 
-  // Reset shared memory
+  // Reset shared memory. The breadcrumb log is not reset, it has its own
+  // shared memory, so threads keep their rings and the next report
+  // includes the breadcrumbs added before this crash.
   if(m_SharedMem.IsInitialized())
   {
     m_SharedMem.Destroy();
     m_pCrashDesc = NULL;
+    m_PropTable.Detach();
   }
 
   // Pack configuration info into shared memory.
@@ -18,6 +18,8 @@ be found in the Authors.txt file in the root of the source tree.
 #include "CrashRpt.h"
 #include "Utility.h"
 #include "SharedMem.h"
+#include "PropertyTable.h"
+#include "BreadcrumbLog.h"
 #include "Prefastdef.h"
 
 /* This structure contains pointer to the exception handlers for a thread.*/
@@ -49,6 +51,7 @@ struct FileItem
   {
     m_bMakeCopy = FALSE;
     m_bAllowDelete = FALSE;
+    m_bSnapshot = FALSE;
   }
 
     CString m_sSrcFilePath; // Path to the original file. 
@@ -59,6 +62,7 @@ struct FileItem
               // otherwise the file will be included from its original location (not guaranteing that file is the same it was
               // at the moment of crash).
   BOOL m_bAllowDelete;    // Whether to allow user deleting the file from context menu of Error Report Details dialog.
+  BOOL m_bSnapshot;       // Should we only record the size of this append-only file on crash instead of copying it?
 };
 
 // Contains information about a registry key included into a crash report.
@@ -127,6 +131,14 @@ public:
     // Adds a named text property to the report.
     int AddProperty(CString sPropName, CString sPropValue);
 
+    // Adds a breadcrumb to the ring of the caller thread. Text sizes are in bytes;
+    // bWide tells if the text is wide-char or multi-byte.
+    int AddBreadcrumb(LPCVOID pCategory, size_t uCategorySize, 
+        LPCVOID pMessage, size_t uMessageSize, BOOL bWide);
+
+    // Frees the breadcrumb ring of the caller thread (its breadcrumbs are kept).
+    void ReleaseThreadBreadcrumbRing();
+
     // Adds desktop screenshot of crash into error report.
     int AddScreenshot(DWORD dwFlags, int nJpegQuality);
 
@@ -205,12 +217,17 @@ public:
 
     // Packs crash description into shared memory.
     CRASH_DESCRIPTION* PackCrashInfoIntoSharedMem(__in CSharedMem* pSharedMem, BOOL bTempMem);
-    // Packs a string.
-    DWORD PackString(CString str);
+    // Packs a string, reserving at least dwCapacity bytes for string data.
+    DWORD PackString(CString str, DWORD dwCapacity=0);
+    // Replaces a packed string if the new one fits into its block.
+    BOOL ReplaceString(DWORD dwOffset, CString str, DWORD& dwCapacity);
     // Packs a file item.
     DWORD PackFileItem(FileItem& fi);
     // Packs a custom user property.
-    DWORD PackProperty(CString sName, CString sValue);
+    DWORD PackProperty(CString sName, CString sValue, DWORD dwValueCapacity=0);
+    // Stores a custom user property in the property table, or packs it if it doesn't fit.
+    BOOL StoreProperty(CPropertyTable* pPropTable, std::map<CString, DWORD>* pPropBlocks, 
+        CString sName, CString sValue);
     // Packs a registry key.
     DWORD PackRegKey(CString sKeyName, RegKeyInfo& rki);
     
@@ -307,6 +324,11 @@ public:
     HANDLE m_hEvent2;              // Another event used to synchronize CrashRpt.dll with CrashSender.exe.
     CSharedMem m_SharedMem;        // Shared memory.
     CRASH_DESCRIPTION* m_pCrashDesc; // Pointer to crash description shared mem view.
+    CPropertyTable m_PropTable;    // Custom properties in shared memory, updated in place.
+    std::map<CString, DWORD> m_PropBlocks; // Offsets of value strings of properties packed as blocks.
+    CSharedMem m_BreadcrumbMem;    // Shared memory of breadcrumb log, kept until the handler is destroyed.
+    CBreadcrumbLog m_Breadcrumbs;  // Breadcrumb rings in shared memory.
+    DWORD m_dwBreadcrumbTlsIndex;  // TLS slot holding the breadcrumb ring index+1 of a thread.
     CSharedMem* m_pTmpSharedMem;   // Used temporarily
     CRASH_DESCRIPTION* m_pTmpCrashDesc; // Used temporarily
     HANDLE m_hSenderProcess;       // Handle to CrashSender.exe process.
@@ -308,6 +308,9 @@ CRASHRPTAPI(int)
     return 1; // Invalid parameter?
   }
 
+  // Free the breadcrumb ring of this thread for other threads
+  pCrashHandler->ReleaseThreadBreadcrumbRing();
+
   int nResult = pCrashHandler->UnSetThreadExceptionHandlers();
   if(nResult!=0)
     return 2; // Error?
@@ -510,6 +513,73 @@ CRASHRPTAPI(int)
   return crAddPropertyW(strconv.a2w(pszPropName), strconv.a2w(pszPropValue));
 }
 
+CRASHRPTAPI(int)
+  crAddBreadcrumbW(
+  LPCWSTR pszCategory,
+  LPCWSTR pszMessage
+  )
+{
+  // Breadcrumbs are added from hot paths, so the string is not converted and the
+  // error message is set on failure only.
+
+  CCrashHandler *pCrashHandler = CCrashHandler::GetCurrentProcessCrashHandler();
+
+  if(pCrashHandler==NULL)
+  {
+    crSetErrorMsg(_T("Crash handler wasn't previously installed for current process."));
+    return 1; // No handler installed for current process?
+  }
+
+  if(pszMessage==NULL)
+  {
+    crSetErrorMsg(_T("Invalid message specified."));
+    return 2;
+  }
+
+  if(pszCategory==NULL)
+    pszCategory = L"";
+
+  int nResult = pCrashHandler->AddBreadcrumb(pszCategory, wcslen(pszCategory)*sizeof(WCHAR), 
+    pszMessage, wcslen(pszMessage)*sizeof(WCHAR), TRUE);
+  if(nResult!=0)
+    return 3; // Failed to add the breadcrumb
+
+  return 0;
+}
+
+CRASHRPTAPI(int)
+  crAddBreadcrumbA(
+  LPCSTR pszCategory,
+  LPCSTR pszMessage
+  )
+{
+  // The multi-byte string is stored as is and converted by CrashSender.exe.
+
+  CCrashHandler *pCrashHandler = CCrashHandler::GetCurrentProcessCrashHandler();
+
+  if(pCrashHandler==NULL)
+  {
+    crSetErrorMsg(_T("Crash handler wasn't previously installed for current process."));
+    return 1; // No handler installed for current process?
+  }
+
+  if(pszMessage==NULL)
+  {
+    crSetErrorMsg(_T("Invalid message specified."));
+    return 2;
+  }
+
+  if(pszCategory==NULL)
+    pszCategory = "";
+
+  int nResult = pCrashHandler->AddBreadcrumb(pszCategory, strlen(pszCategory), 
+    pszMessage, strlen(pszMessage), FALSE);
+  if(nResult!=0)
+    return 3; // Failed to add the breadcrumb
+
+  return 0;
+}
+
 CRASHRPTAPI(int) crAddRegKeyW(LPCWSTR pszRegKey, LPCWSTR pszDstFileName, DWORD dwFlags)
 {
   crSetErrorMsg(_T("Unspecified error."));
@@ -944,10 +1014,13 @@ BOOL APIENTRY DllMain(HANDLE hModule, DWORD dwReason, LPVOID /*lpReserved*/)
     // A thread is exiting cleanly.
     CCrashHandler *pCrashHandler = CCrashHandler::GetCurrentProcessCrashHandler();
     if(pCrashHandler!=NULL &&
-      pCrashHandler->IsInitialized() &&
-      (pCrashHandler->GetFlags()&CR_INST_AUTO_THREAD_HANDLERS)!=0 )
+      pCrashHandler->IsInitialized())
     {
-      pCrashHandler->UnSetThreadExceptionHandlers();
+      // Free the breadcrumb ring of the thread for other threads
+      pCrashHandler->ReleaseThreadBreadcrumbRing();
+
+      if((pCrashHandler->GetFlags()&CR_INST_AUTO_THREAD_HANDLERS)!=0)
+        pCrashHandler->UnSetThreadExceptionHandlers();
     }
   }
 
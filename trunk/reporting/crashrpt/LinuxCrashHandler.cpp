@@ -0,0 +1,772 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "LinuxCrashHandler.h"
+#include "FileCollector.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#if defined(__x86_64__)
+#include <asm/prctl.h>
+#endif
+
+// Signature of the crash message ('LCRH')
+#define LCRASH_MESSAGE_MAGIC 0x4852434c
+
+// Signature of the parameters sent to the helper ('LCFG')
+#define LCRASH_INFO_MAGIC 0x4746434c
+
+// Maximum size of the parameters sent to the helper
+#define LCRASH_MAX_INFO_SIZE (1024*1024)
+
+// Version of crashrpt.xml format (CRASHRPT_VER of CrashRpt.h)
+#define LCRASH_CRASHRPT_VER 1403
+
+// Exception types written to crashrpt.xml (CR_CPP_xxx values of CrashRpt.h)
+#define LCRASH_TYPE_SIGABRT 7
+#define LCRASH_TYPE_SIGFPE  8
+#define LCRASH_TYPE_SIGILL  9
+#define LCRASH_TYPE_SIGSEGV 11
+
+// Handled signals
+static const int g_anSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+#define LCRASH_SIGNAL_COUNT (sizeof(g_anSignals)/sizeof(g_anSignals[0]))
+
+// Alternate signal stack of the thread, set by InstallToCurrentThread()
+static __thread void* t_pAltStack = NULL;
+static __thread size_t t_uAltStackSize = 0;
+
+CLinuxCrashHandler* CLinuxCrashHandler::s_pInstance = NULL;
+CLinuxCrashHandler::CrashMessage CLinuxCrashHandler::s_Message;
+volatile pid_t CLinuxCrashHandler::s_nCrashedTid = 0;
+
+// Creates the folder and its parents
+static bool CreateFolders(const std::string& sPath)
+{
+    size_t uPos = 0;
+    while(uPos!=std::string::npos)
+    {
+        uPos = sPath.find('/', uPos+1);
+        std::string sDir = sPath.substr(0, uPos);
+        if(!sDir.empty() && mkdir(sDir.c_str(), 0700)!=0 && errno!=EEXIST)
+            return false;
+    }
+
+    struct stat st;
+    return stat(sPath.c_str(), &st)==0 && S_ISDIR(st.st_mode);
+}
+
+// Makes a random (version 4) GUID string
+static std::string MakeGUID()
+{
+    uint8_t auch[16];
+    memset(auch, 0, sizeof(auch));
+
+    int fd = open("/dev/urandom", O_RDONLY|O_CLOEXEC);
+    if(fd<0 || read(fd, auch, sizeof(auch))!=(ssize_t)sizeof(auch))
+    {
+        // Not random, but unique on this machine
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        uint64_t uPid = (uint64_t)getpid();
+        uint64_t uTime = (uint64_t)ts.tv_sec*1000000000+ts.tv_nsec;
+        memcpy(auch, &uPid, 8);
+        memcpy(auch+8, &uTime, 8);
+    }
+    if(fd>=0)
+        close(fd);
+
+    auch[6] = (uint8_t)((auch[6]&0x0F)|0x40);
+    auch[8] = (uint8_t)((auch[8]&0x3F)|0x80);
+
+    char szGUID[40];
+    snprintf(szGUID, sizeof(szGUID),
+        "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+        auch[0], auch[1], auch[2], auch[3], auch[4], auch[5], auch[6], auch[7],
+        auch[8], auch[9], auch[10], auch[11], auch[12], auch[13], auch[14], auch[15]);
+    return szGUID;
+}
+
+// Replaces characters having special meaning in XML
+static std::string XmlEscape(const std::string& s)
+{
+    std::string sOut;
+    size_t i;
+    for(i=0; i<s.length(); i++)
+    {
+        switch(s[i])
+        {
+        case '&': sOut += "&amp;"; break;
+        case '<': sOut += "&lt;"; break;
+        case '>': sOut += "&gt;"; break;
+        case '"': sOut += "&quot;"; break;
+        case '\'': sOut += "&apos;"; break;
+        default: sOut += s[i];
+        }
+    }
+
+    return sOut;
+}
+
+// Returns the file name part of the path
+static std::string GetFileName(const std::string& sPath)
+{
+    size_t uPos = sPath.rfind('/');
+    return uPos==std::string::npos?sPath:sPath.substr(uPos+1);
+}
+
+// Returns the default helper path: CrashRptHelper in the directory of the application
+static std::string GetDefaultHelperPath()
+{
+    char szExe[4096];
+    ssize_t nLen = readlink("/proc/self/exe", szExe, sizeof(szExe)-1);
+    if(nLen<=0)
+        return LCRASH_HELPER_FILE_NAME;
+    szExe[nLen] = 0;
+
+    std::string sPath = szExe;
+    size_t uPos = sPath.rfind('/');
+    return sPath.substr(0, uPos+1)+LCRASH_HELPER_FILE_NAME;
+}
+
+static void AppendUInt32(std::string& sBuf, uint32_t u)
+{
+    sBuf.append((const char*)&u, sizeof(u));
+}
+
+static void AppendString(std::string& sBuf, const std::string& s)
+{
+    AppendUInt32(sBuf, (uint32_t)s.length());
+    sBuf += s;
+}
+
+static bool ReadUInt32(const std::string& sBuf, size_t& uPos, uint32_t& u)
+{
+    if(sBuf.length()-uPos<sizeof(u))
+        return false;
+    memcpy(&u, sBuf.data()+uPos, sizeof(u));
+    uPos += sizeof(u);
+    return true;
+}
+
+static bool ReadString(const std::string& sBuf, size_t& uPos, std::string& s)
+{
+    uint32_t uLen = 0;
+    if(!ReadUInt32(sBuf, uPos, uLen) || sBuf.length()-uPos<uLen)
+        return false;
+    s.assign(sBuf.data()+uPos, uLen);
+    uPos += uLen;
+    return true;
+}
+
+// Sends the whole buffer to the socket
+static bool SendAll(int fd, const void* pData, size_t uSize)
+{
+    const char* p = (const char*)pData;
+    while(uSize>0)
+    {
+        ssize_t n = send(fd, p, uSize, MSG_NOSIGNAL);
+        if(n<0 && errno==EINTR)
+            continue;
+        if(n<=0)
+            return false;
+        p += n;
+        uSize -= (size_t)n;
+    }
+    return true;
+}
+
+// Receives the whole buffer from the socket
+static bool RecvAll(int fd, void* pData, size_t uSize)
+{
+    char* p = (char*)pData;
+    while(uSize>0)
+    {
+        ssize_t n = recv(fd, p, uSize, 0);
+        if(n<0 && errno==EINTR)
+            continue;
+        if(n<=0)
+            return false;
+        p += n;
+        uSize -= (size_t)n;
+    }
+    return true;
+}
+
+CLinuxCrashHandler::CLinuxCrashHandler()
+{
+    m_bInstalled = false;
+    m_nHelperPid = -1;
+    m_fdSocket = -1;
+    memset(m_aOldActions, 0, sizeof(m_aOldActions));
+}
+
+CLinuxCrashHandler::~CLinuxCrashHandler()
+{
+    Uninstall();
+}
+
+int CLinuxCrashHandler::Install(const LinuxCrashHandlerInfo& Info)
+{
+    int afd[2] = {-1, -1};
+    size_t i;
+
+    if(s_pInstance!=NULL)
+        return LCRASH_ERR_INSTALLED;
+
+    if(!CreateFolders(Info.m_sReportsFolder))
+        return LCRASH_ERR_FOLDER;
+
+    m_Info = Info;
+
+    std::string sHelperPath = m_Info.m_sHelperPath.empty()?GetDefaultHelperPath():m_Info.m_sHelperPath;
+    if(access(sHelperPath.c_str(), X_OK)!=0)
+        return LCRASH_ERR_HELPER;
+
+    // Everything the child needs is prepared before fork(): other threads may hold the
+    // malloc lock, so the child may only call async-signal-safe functions until exec
+    std::string sInfo;
+    AppendUInt32(sInfo, LCRASH_INFO_MAGIC);
+    AppendString(sInfo, m_Info.m_sAppName);
+    AppendString(sInfo, m_Info.m_sAppVersion);
+    AppendString(sInfo, m_Info.m_sReportsFolder);
+    AppendString(sInfo, m_Info.m_sSenderPath);
+    AppendUInt32(sInfo, (uint32_t)m_Info.m_aFiles.size());
+    for(i=0; i<m_Info.m_aFiles.size(); i++)
+    {
+        AppendString(sInfo, m_Info.m_aFiles[i].m_sSrcFile);
+        AppendString(sInfo, m_Info.m_aFiles[i].m_sDestFile);
+        AppendString(sInfo, m_Info.m_aFiles[i].m_sDesc);
+    }
+    uint32_t uInfoSize = (uint32_t)sInfo.length();
+    if(uInfoSize>LCRASH_MAX_INFO_SIZE)
+        return LCRASH_ERR_HELPER;
+
+    // A stream socket (not a pipe) can be written with MSG_NOSIGNAL, so the crashed
+    // process doesn't get SIGPIPE if the helper has gone
+    if(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, afd)!=0)
+        return LCRASH_ERR_HELPER;
+
+    char szSocket[16];
+    snprintf(szSocket, sizeof(szSocket), "%d", afd[1]);
+    char* apszArgs[3] = {(char*)sHelperPath.c_str(), szSocket, NULL};
+    sigset_t EmptySet;
+    sigemptyset(&EmptySet);
+
+    m_nHelperPid = fork();
+    if(m_nHelperPid<0)
+    {
+        close(afd[0]);
+        close(afd[1]);
+        return LCRASH_ERR_HELPER;
+    }
+
+    if(m_nHelperPid==0)
+    {
+        // The helper's end of the socket is kept open across exec
+        sigprocmask(SIG_SETMASK, &EmptySet, NULL);
+        fcntl(afd[1], F_SETFD, 0);
+        execv(apszArgs[0], apszArgs);
+        _exit(127);
+    }
+
+    close(afd[1]);
+    m_fdSocket = afd[0];
+
+    // With Yama ptrace restrictions only the parent may attach, allow the helper.
+    // Fails harmlessly if Yama is not enabled.
+    prctl(PR_SET_PTRACER, m_nHelperPid, 0, 0, 0);
+
+    // Send the parameters and wait until the helper is ready
+    bool bReady = false;
+    if(SendAll(m_fdSocket, &uInfoSize, sizeof(uInfoSize)) && SendAll(m_fdSocket, sInfo.data(), sInfo.length()))
+    {
+        struct pollfd pfd;
+        pfd.fd = m_fdSocket;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        char chReady = 0;
+        bReady = poll(&pfd, 1, m_Info.m_nDumpTimeout)>0 && recv(m_fdSocket, &chReady, 1, 0)==1 && chReady==1;
+    }
+    if(!bReady)
+    {
+        Uninstall();
+        return LCRASH_ERR_HELPER;
+    }
+
+    if(InstallToCurrentThread()!=LCRASH_OK)
+    {
+        Uninstall();
+        return LCRASH_ERR_SIGNALS;
+    }
+
+    s_nCrashedTid = 0;
+    s_pInstance = this;
+    m_bInstalled = true;
+
+    for(i=0; i<LCRASH_SIGNAL_COUNT; i++)
+    {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sigemptyset(&sa.sa_mask);
+        sa.sa_sigaction = SignalHandler;
+        sa.sa_flags = SA_SIGINFO|SA_ONSTACK;
+        if(sigaction(g_anSignals[i], &sa, &m_aOldActions[i])!=0)
+        {
+            // Restore the handlers set so far
+            while(i-->0)
+                sigaction(g_anSignals[i], &m_aOldActions[i], NULL);
+            m_bInstalled = false;
+            UninstallFromCurrentThread();
+            Uninstall();
+            return LCRASH_ERR_SIGNALS;
+        }
+    }
+
+    return LCRASH_OK;
+}
+
+void CLinuxCrashHandler::Uninstall()
+{
+    size_t i;
+
+    if(m_bInstalled)
+    {
+        for(i=0; i<LCRASH_SIGNAL_COUNT; i++)
+            sigaction(g_anSignals[i], &m_aOldActions[i], NULL);
+        m_bInstalled = false;
+        UninstallFromCurrentThread();
+    }
+
+    if(s_pInstance==this)
+        s_pInstance = NULL;
+
+    // The helper exits when the socket is closed
+    if(m_fdSocket>=0)
+    {
+        close(m_fdSocket);
+        m_fdSocket = -1;
+    }
+
+    if(m_nHelperPid>0)
+    {
+        while(waitpid(m_nHelperPid, NULL, 0)<0 && errno==EINTR)
+            ;
+        m_nHelperPid = -1;
+    }
+}
+
+bool CLinuxCrashHandler::IsInstalled() const
+{
+    return m_bInstalled;
+}
+
+pid_t CLinuxCrashHandler::GetHelperPid() const
+{
+    return m_nHelperPid;
+}
+
+int CLinuxCrashHandler::InstallToCurrentThread()
+{
+    if(t_pAltStack!=NULL)
+        return LCRASH_OK;
+
+    size_t uSize = SIGSTKSZ>LCRASH_MIN_ALT_STACK_SIZE?SIGSTKSZ:LCRASH_MIN_ALT_STACK_SIZE;
+    void* pStack = mmap(NULL, uSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(pStack==MAP_FAILED)
+        return LCRASH_ERR_SIGNALS;
+
+    stack_t ss;
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_sp = pStack;
+    ss.ss_size = uSize;
+    if(sigaltstack(&ss, NULL)!=0)
+    {
+        munmap(pStack, uSize);
+        return LCRASH_ERR_SIGNALS;
+    }
+
+    t_pAltStack = pStack;
+    t_uAltStackSize = uSize;
+    return LCRASH_OK;
+}
+
+void CLinuxCrashHandler::UninstallFromCurrentThread()
+{
+    if(t_pAltStack==NULL)
+        return;
+
+    stack_t ss;
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_flags = SS_DISABLE;
+    sigaltstack(&ss, NULL);
+
+    munmap(t_pAltStack, t_uAltStackSize);
+    t_pAltStack = NULL;
+    t_uAltStackSize = 0;
+}
+
+void CLinuxCrashHandler::SignalHandler(int nSignal, siginfo_t* pSigInfo, void* pContext)
+{
+    // Only async-signal-safe functions may be called here: the crash may have happened
+    // inside malloc() or with any lock held.
+
+    pid_t nTid = (pid_t)syscall(SYS_gettid);
+    if(!__sync_bool_compare_and_swap(&s_nCrashedTid, 0, nTid))
+    {
+        if(s_nCrashedTid!=nTid)
+        {
+            // Another thread is reporting a crash, the process is terminated when it is done
+            for(;;)
+                pause();
+        }
+
+        // The handler itself has crashed
+        ResendSignal(nSignal, pSigInfo);
+        return;
+    }
+
+    CLinuxCrashHandler* pThis = s_pInstance;
+    if(pThis!=NULL && pThis->m_fdSocket>=0)
+    {
+        memset(&s_Message, 0, sizeof(s_Message));
+        s_Message.m_uMagic = LCRASH_MESSAGE_MAGIC;
+
+        LinuxCrashInfo& ci = s_Message.m_Info;
+        ci.m_nPid = getpid();
+        ci.m_nTid = nTid;
+        ci.m_nSignal = nSignal;
+        ci.m_nCode = pSigInfo->si_code;
+        // si_addr is only defined for faults
+        if(pSigInfo->si_code>0 && nSignal!=SIGABRT)
+            ci.m_uFaultAddr = (uint64_t)(uintptr_t)pSigInfo->si_addr;
+
+#if defined(__x86_64__)
+        const ucontext_t* pUc = (const ucontext_t*)pContext;
+        const greg_t* g = pUc->uc_mcontext.gregs;
+        struct user_regs_struct& r = ci.m_Regs;
+        r.r8 = g[REG_R8];
+        r.r9 = g[REG_R9];
+        r.r10 = g[REG_R10];
+        r.r11 = g[REG_R11];
+        r.r12 = g[REG_R12];
+        r.r13 = g[REG_R13];
+        r.r14 = g[REG_R14];
+        r.r15 = g[REG_R15];
+        r.rdi = g[REG_RDI];
+        r.rsi = g[REG_RSI];
+        r.rbp = g[REG_RBP];
+        r.rbx = g[REG_RBX];
+        r.rdx = g[REG_RDX];
+        r.rax = g[REG_RAX];
+        r.rcx = g[REG_RCX];
+        r.rsp = g[REG_RSP];
+        r.rip = g[REG_RIP];
+        r.eflags = g[REG_EFL];
+        r.orig_rax = (unsigned long long)-1;
+        // Segment registers are packed as cs, gs, fs and (on newer kernels) ss
+        r.cs = (uint64_t)g[REG_CSGSFS]&0xFFFF;
+        r.gs = ((uint64_t)g[REG_CSGSFS]>>16)&0xFFFF;
+        r.fs = ((uint64_t)g[REG_CSGSFS]>>32)&0xFFFF;
+        r.ss = ((uint64_t)g[REG_CSGSFS]>>48)&0xFFFF;
+        syscall(SYS_arch_prctl, ARCH_GET_FS, &r.fs_base);
+        if(pUc->uc_mcontext.fpregs!=NULL)
+            memcpy(&ci.m_FpRegs, pUc->uc_mcontext.fpregs, sizeof(ci.m_FpRegs));
+        ci.m_bHasContext = 1;
+#else
+        (void)pContext;
+#endif
+
+        // Send the message and wait until the helper has captured the process
+        if(SendAll(pThis->m_fdSocket, &s_Message, sizeof(s_Message)))
+        {
+            struct pollfd pfd;
+            pfd.fd = pThis->m_fdSocket;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if(poll(&pfd, 1, pThis->m_Info.m_nDumpTimeout)>0)
+            {
+                char chAck = 0;
+                recv(pThis->m_fdSocket, &chAck, 1, 0);
+            }
+        }
+    }
+
+    ResendSignal(nSignal, pSigInfo);
+}
+
+void CLinuxCrashHandler::ResendSignal(int nSignal, const siginfo_t* pSigInfo)
+{
+    signal(nSignal, SIG_DFL);
+
+    // A fault happens again when the instruction is restarted. A signal sent by
+    // kill() or abort() has to be raised again; it stays blocked until the handler returns.
+    if(pSigInfo->si_code<=0 || nSignal==SIGABRT)
+        raise(nSignal);
+}
+
+int CLinuxCrashHandler::RunHelperProcess(int argc, char* argv[])
+{
+    CLinuxCrashHandler Helper;
+
+    if(argc<2)
+        return 1;
+
+    // The socket is not inherited by the sender
+    char* pszEnd = NULL;
+    long nSocket = strtol(argv[1], &pszEnd, 10);
+    if(pszEnd==argv[1] || *pszEnd!=0 || nSocket<0 || fcntl((int)nSocket, F_SETFD, FD_CLOEXEC)!=0)
+        return 1;
+
+    Helper.m_fdSocket = (int)nSocket;
+    if(!Helper.ReceiveInfo())
+        return 1;
+
+    char chReady = 1;
+    if(!SendAll(Helper.m_fdSocket, &chReady, 1))
+        return 1;
+
+    Helper.RunHelper();
+    return 0;
+}
+
+bool CLinuxCrashHandler::ReceiveInfo()
+{
+    uint32_t uSize = 0;
+    uint32_t uMagic = 0;
+    uint32_t uFileCount = 0;
+    std::string sInfo;
+    size_t uPos = 0;
+    uint32_t i;
+
+    if(!RecvAll(m_fdSocket, &uSize, sizeof(uSize)) || uSize>LCRASH_MAX_INFO_SIZE)
+        return false;
+
+    sInfo.resize(uSize);
+    if(uSize>0 && !RecvAll(m_fdSocket, &sInfo[0], uSize))
+        return false;
+
+    if(!ReadUInt32(sInfo, uPos, uMagic) || uMagic!=LCRASH_INFO_MAGIC ||
+        !ReadString(sInfo, uPos, m_Info.m_sAppName) ||
+        !ReadString(sInfo, uPos, m_Info.m_sAppVersion) ||
+        !ReadString(sInfo, uPos, m_Info.m_sReportsFolder) ||
+        !ReadString(sInfo, uPos, m_Info.m_sSenderPath) ||
+        !ReadUInt32(sInfo, uPos, uFileCount))
+        return false;
+
+    for(i=0; i<uFileCount; i++)
+    {
+        LinuxCrashFile f;
+        if(!ReadString(sInfo, uPos, f.m_sSrcFile) ||
+            !ReadString(sInfo, uPos, f.m_sDestFile) ||
+            !ReadString(sInfo, uPos, f.m_sDesc))
+            return false;
+        m_Info.m_aFiles.push_back(f);
+    }
+
+    return uPos==sInfo.length();
+}
+
+void CLinuxCrashHandler::RunHelper()
+{
+    CrashMessage Message;
+
+    // Ctrl+C in the terminal is sent to the whole process group, the helper should
+    // outlive the application until the application exits
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+
+    // Fails when the handler was uninstalled or the process exited
+    if(!RecvAll(m_fdSocket, &Message, sizeof(Message)))
+        _exit(0);
+
+    if(Message.m_uMagic==LCRASH_MESSAGE_MAGIC)
+        ProcessCrash(Message.m_Info);
+
+    _exit(0);
+}
+
+void CLinuxCrashHandler::ProcessCrash(const LinuxCrashInfo& Info)
+{
+    std::string sCrashGUID = MakeGUID();
+    std::string sReportDir = m_Info.m_sReportsFolder+"/"+m_Info.m_sAppName+"_"+
+        m_Info.m_sAppVersion+"/"+sCrashGUID;
+    std::vector<FileCollectItem> aItems;
+    std::vector<LinuxCrashFile> aFiles;
+    CLinuxDumpWriter Writer;
+    CFileCollector Collector;
+    size_t i;
+    size_t j;
+
+    // The image name must be read while the process exists
+    char szImageName[4096];
+    char szPath[64];
+    snprintf(szPath, sizeof(szPath), "/proc/%d/exe", (int)Info.m_nPid);
+    ssize_t nLen = readlink(szPath, szImageName, sizeof(szImageName)-1);
+    szImageName[nLen>0?nLen:0] = 0;
+
+    int nResult = LDUMP_ERR_WRITE_FILE;
+    if(CreateFolders(sReportDir))
+        nResult = Writer.WriteDump(Info, (sReportDir+"/crashdump.dmp").c_str());
+
+    // Let the crashed process terminate
+    char chAck = nResult==LDUMP_OK?1:0;
+    send(m_fdSocket, &chAck, 1, MSG_NOSIGNAL);
+    close(m_fdSocket);
+    m_fdSocket = -1;
+
+    if(nResult!=LDUMP_OK)
+        return;
+
+    LinuxCrashFile DumpFile;
+    DumpFile.m_sDestFile = "crashdump.dmp";
+    DumpFile.m_sDesc = "Crash Minidump";
+    aFiles.push_back(DumpFile);
+
+    // Collect the files, a template may give several files
+    for(i=0; i<m_Info.m_aFiles.size(); i++)
+    {
+        const LinuxCrashFile& f = m_Info.m_aFiles[i];
+        std::vector<std::string> aSrcFiles;
+        if(!CFileCollector::ExpandTemplate(f.m_sSrcFile, aSrcFiles))
+            continue;
+
+        for(j=0; j<aSrcFiles.size(); j++)
+        {
+            LinuxCrashFile ReportFile;
+            ReportFile.m_sSrcFile = aSrcFiles[j];
+            ReportFile.m_sDestFile = aSrcFiles.size()==1 && !f.m_sDestFile.empty()?
+                f.m_sDestFile:GetFileName(aSrcFiles[j]);
+            ReportFile.m_sDesc = f.m_sDesc;
+
+            FileCollectItem Item;
+            Item.m_sSrcFile = ReportFile.m_sSrcFile;
+            Item.m_sDestFile = sReportDir+"/"+ReportFile.m_sDestFile;
+            aItems.push_back(Item);
+            aFiles.push_back(ReportFile);
+        }
+    }
+
+    Collector.Run(aItems);
+
+    // Only the files that were copied are listed
+    std::vector<LinuxCrashFile> aReportFiles(1, aFiles[0]);
+    for(i=0; i<aItems.size(); i++)
+    {
+        if(aItems[i].m_nResult==FCOLLECT_OK)
+            aReportFiles.push_back(aFiles[i+1]);
+    }
+
+    if(!WriteCrashDescription(sReportDir+"/crashrpt.xml", sCrashGUID, szImageName, Info,
+        Writer, aReportFiles))
+        return;
+
+    if(!m_Info.m_sSenderPath.empty())
+    {
+        execl(m_Info.m_sSenderPath.c_str(), m_Info.m_sSenderPath.c_str(), sReportDir.c_str(), (char*)NULL);
+        _exit(127);
+    }
+}
+
+bool CLinuxCrashHandler::WriteCrashDescription(const std::string& sFileName, const std::string& sCrashGUID,
+    const std::string& sImageName, const LinuxCrashInfo& Info, const CLinuxDumpWriter& Writer,
+    const std::vector<LinuxCrashFile>& aFiles)
+{
+    char szBuf[256];
+    std::string sXml;
+    size_t i;
+
+    sXml = "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n";
+    snprintf(szBuf, sizeof(szBuf), "<CrashRpt version=\"%d\">\n", LCRASH_CRASHRPT_VER);
+    sXml += szBuf;
+    sXml += "    <CrashGUID>"+XmlEscape(sCrashGUID)+"</CrashGUID>\n";
+    sXml += "    <AppName>"+XmlEscape(m_Info.m_sAppName)+"</AppName>\n";
+    sXml += "    <AppVersion>"+XmlEscape(m_Info.m_sAppVersion)+"</AppVersion>\n";
+    sXml += "    <ImageName>"+XmlEscape(sImageName)+"</ImageName>\n";
+
+    struct utsname un;
+    if(uname(&un)==0)
+    {
+        sXml += "    <OperatingSystem>"+XmlEscape(std::string(un.sysname)+" "+un.release+" "+
+            un.machine)+"</OperatingSystem>\n";
+        sXml += std::string("    <OSIs64Bit>")+(strstr(un.machine, "64")!=NULL?"1":"0")+"</OSIs64Bit>\n";
+    }
+
+    time_t t = time(NULL);
+    struct tm tmUTC;
+    gmtime_r(&t, &tmUTC);
+    strftime(szBuf, sizeof(szBuf), "%Y-%m-%dT%H:%M:%SZ", &tmUTC);
+    sXml += std::string("    <SystemTimeUTC>")+szBuf+"</SystemTimeUTC>\n";
+
+    uint64_t uExceptionAddress = Writer.GetExceptionAddress();
+    if(uExceptionAddress!=0)
+    {
+        snprintf(szBuf, sizeof(szBuf), "0x%llx", (unsigned long long)uExceptionAddress);
+        sXml += std::string("    <ExceptionAddress>")+szBuf+"</ExceptionAddress>\n";
+
+        const LinuxDumpModule* pModule = Writer.FindModule(uExceptionAddress);
+        if(pModule!=NULL)
+        {
+            sXml += "    <ExceptionModule>"+XmlEscape(pModule->m_sPath)+"</ExceptionModule>\n";
+            snprintf(szBuf, sizeof(szBuf), "0x%llx", (unsigned long long)pModule->m_uBaseAddr);
+            sXml += std::string("    <ExceptionModuleBase>")+szBuf+"</ExceptionModuleBase>\n";
+        }
+    }
+
+    int nExceptionType = LCRASH_TYPE_SIGSEGV;
+    if(Info.m_nSignal==SIGABRT)
+        nExceptionType = LCRASH_TYPE_SIGABRT;
+    else if(Info.m_nSignal==SIGFPE)
+        nExceptionType = LCRASH_TYPE_SIGFPE;
+    else if(Info.m_nSignal==SIGILL)
+        nExceptionType = LCRASH_TYPE_SIGILL;
+    snprintf(szBuf, sizeof(szBuf), "    <ExceptionType>%d</ExceptionType>\n", nExceptionType);
+    sXml += szBuf;
+    // The signal number, the type doesn't tell SIGBUS from SIGSEGV
+    snprintf(szBuf, sizeof(szBuf), "    <ExceptionCode>%d</ExceptionCode>\n", Info.m_nSignal);
+    sXml += szBuf;
+
+    sXml += "    <FileList>\n";
+    for(i=0; i<aFiles.size(); i++)
+    {
+        sXml += "        <FileItem name=\""+XmlEscape(aFiles[i].m_sDestFile)+"\" description=\""+
+            XmlEscape(aFiles[i].m_sDesc)+"\" />\n";
+    }
+    sXml += "    </FileList>\n";
+    sXml += "</CrashRpt>\n";
+
+    // The file is renamed when complete, so the sender never sees a partial description
+    std::string sTmpFileName = sFileName+".tmp";
+    FILE* f = fopen(sTmpFileName.c_str(), "wb");
+    if(f==NULL)
+        return false;
+
+    bool bWritten = fwrite(sXml.data(), 1, sXml.length(), f)==sXml.length();
+    if(fclose(f)!=0 || !bWritten || rename(sTmpFileName.c_str(), sFileName.c_str())!=0)
+    {
+        unlink(sTmpFileName.c_str());
+        return false;
+    }
+
+    return true;
+}
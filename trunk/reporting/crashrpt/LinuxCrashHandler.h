@@ -0,0 +1,147 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: LinuxCrashHandler.h
+// Description: Crash handler for Linux. A helper process (the CrashRptHelper executable)
+// is started when the handler is installed and waits for a crash message on a socket.
+// The signal handler of the crashed process only fills a static message with the
+// registers and sends it (both are async-signal-safe), the helper then captures the
+// process into a minidump, collects the report files, writes crashrpt.xml and starts
+// the sender.
+
+#pragma once
+#include <signal.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include "LinuxDumpWriter.h"
+
+// Default time the crashed process waits for the helper to write the minidump
+#define LCRASH_DEFAULT_DUMP_TIMEOUT 30000
+
+// Minimum size of the alternate signal stack
+#define LCRASH_MIN_ALT_STACK_SIZE (64*1024)
+
+// File name of the helper executable
+#define LCRASH_HELPER_FILE_NAME "CrashRptHelper"
+
+// Error codes returned by CLinuxCrashHandler methods
+enum LinuxCrashHandlerError
+{
+    LCRASH_OK = 0,                // Success
+    LCRASH_ERR_INSTALLED = 1,     // A crash handler is already installed
+    LCRASH_ERR_FOLDER = 2,        // Couldn't create the reports folder
+    LCRASH_ERR_HELPER = 3,        // Couldn't start the helper process
+    LCRASH_ERR_SIGNALS = 4        // Couldn't set the signal stack or handlers
+};
+
+// A file to include into the error report
+struct LinuxCrashFile
+{
+    std::string m_sSrcFile;   // File path, may contain * and ? in the file name
+    std::string m_sDestFile;  // Name in the report, empty means the source file name
+    std::string m_sDesc;      // File description
+};
+
+// Crash handler parameters
+struct LinuxCrashHandlerInfo
+{
+    LinuxCrashHandlerInfo()
+    {
+        m_nDumpTimeout = LCRASH_DEFAULT_DUMP_TIMEOUT;
+    }
+
+    std::string m_sAppName;        // Application name
+    std::string m_sAppVersion;     // Application version
+    std::string m_sReportsFolder;  // Reports are written to <folder>/<AppName>_<AppVersion>/<GUID>
+    std::string m_sSenderPath;     // Executable started with the report folder as argument, may be empty
+    std::string m_sHelperPath;     // Helper executable, empty means CrashRptHelper in the directory of the application
+    std::vector<LinuxCrashFile> m_aFiles; // Files to include into reports
+    int m_nDumpTimeout;            // Milliseconds the crashed process waits for the minidump
+};
+
+// class CLinuxCrashHandler
+// Handles SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT of the process. Only one handler
+// may be installed in a process. Signal handlers are per process, but the alternate
+// signal stack is per thread: Install() sets it for the calling thread only, so other
+// threads must call InstallToCurrentThread(), or a stack overflow in them kills the
+// process without a report. The helper exits when the socket is closed, that is, when
+// the handler is uninstalled or the process exits.
+class CLinuxCrashHandler
+{
+public:
+
+    CLinuxCrashHandler();
+    ~CLinuxCrashHandler();
+
+    // Starts the helper and installs the signal handlers
+    int Install(const LinuxCrashHandlerInfo& Info);
+
+    // Restores the previous signal handlers and stops the helper
+    void Uninstall();
+
+    // Returns true if the handler is installed
+    bool IsInstalled() const;
+
+    // Returns the process ID of the helper
+    pid_t GetHelperPid() const;
+
+    // Sets an alternate signal stack for the calling thread, so a stack overflow in
+    // the thread is reported. Call it in each thread except the one calling Install().
+    static int InstallToCurrentThread();
+
+    // Removes the alternate signal stack set by InstallToCurrentThread(). Call it
+    // before the thread exits.
+    static void UninstallFromCurrentThread();
+
+    // Entry point of the helper executable. The socket descriptor is passed as the
+    // only argument. Returns the exit code.
+    static int RunHelperProcess(int argc, char* argv[]);
+
+private:
+
+    // Crash message sent to the helper
+    struct CrashMessage
+    {
+        uint32_t m_uMagic;     // LCRASH_MESSAGE_MAGIC
+        LinuxCrashInfo m_Info; // Crash information
+    };
+
+    // Signal handler
+    static void SignalHandler(int nSignal, siginfo_t* pSigInfo, void* pContext);
+
+    // Restores the default action of the signal and makes sure it is delivered again
+    // after the handler returns
+    static void ResendSignal(int nSignal, const siginfo_t* pSigInfo);
+
+    // Receives the parameters sent by Install() to the helper
+    bool ReceiveInfo();
+
+    // Main loop of the helper process. Never returns.
+    void RunHelper();
+
+    // Writes the minidump and the report of a crash, then starts the sender
+    void ProcessCrash(const LinuxCrashInfo& Info);
+
+    // Writes crashrpt.xml
+    bool WriteCrashDescription(const std::string& sFileName, const std::string& sCrashGUID,
+        const std::string& sImageName, const LinuxCrashInfo& Info, const CLinuxDumpWriter& Writer,
+        const std::vector<LinuxCrashFile>& aFiles);
+
+    LinuxCrashHandlerInfo m_Info;  // Parameters
+    bool m_bInstalled;             // Is the handler installed?
+    pid_t m_nHelperPid;            // Helper process
+    int m_fdSocket;                // Our end of the socket connected to the helper
+    struct sigaction m_aOldActions[5]; // Signal actions replaced by ours
+
+    static CLinuxCrashHandler* s_pInstance; // Installed handler
+    static CrashMessage s_Message; // Message filled by the signal handler
+    static volatile pid_t s_nCrashedTid; // Thread handling a crash, or 0
+};
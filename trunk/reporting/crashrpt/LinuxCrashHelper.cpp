@@ -0,0 +1,20 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: LinuxCrashHelper.cpp
+// Description: Helper process of the Linux crash handler. Started by
+// CLinuxCrashHandler::Install() with its end of the socket, writes the reports.
+
+#include "LinuxCrashHandler.h"
+
+int main(int argc, char* argv[])
+{
+    return CLinuxCrashHandler::RunHelperProcess(argc, argv);
+}
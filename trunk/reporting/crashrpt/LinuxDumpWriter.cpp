@@ -0,0 +1,792 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "LinuxDumpWriter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <link.h>
+#include <elf.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/utsname.h>
+
+// Minidump signature ('MDMP') and format version
+#define LDUMP_SIGNATURE 0x504d444d
+#define LDUMP_VERSION   0xa793
+
+// Minidump stream types
+#define LDUMP_THREAD_LIST_STREAM   3
+#define LDUMP_MODULE_LIST_STREAM   4
+#define LDUMP_MEMORY_LIST_STREAM   5
+#define LDUMP_EXCEPTION_STREAM     6
+#define LDUMP_SYSTEM_INFO_STREAM   7
+
+// Processor architectures (PROCESSOR_ARCHITECTURE_xxx)
+#define LDUMP_ARCH_INTEL   0
+#define LDUMP_ARCH_AMD64   9
+#define LDUMP_ARCH_ARM64   12
+#define LDUMP_ARCH_UNKNOWN 0xFFFF
+
+// Size of the AMD64 CONTEXT structure and its flags (CONTEXT_AMD64 with control,
+// integer, segment and floating point registers)
+#define LDUMP_AMD64_CONTEXT_SIZE 0x4D0
+#define LDUMP_AMD64_CONTEXT_FULL 0x10000F
+
+// Bytes below the stack pointer that may be used by leaf functions (x86-64 red zone)
+#define LDUMP_RED_ZONE 128
+
+// Maximum size of ELF notes read when looking for the build ID
+#define LDUMP_MAX_NOTES_SIZE 4096
+
+// Minidump image composed in memory
+class CDumpImage
+{
+public:
+
+    CDumpImage()
+    {
+        m_aData.resize(32, 0); // Header
+    }
+
+    // Appends a data block aligned to 4 bytes and returns its RVA
+    uint32_t AddBlob(const void* pData, size_t uSize)
+    {
+        m_aData.resize((m_aData.size()+3)&~(size_t)3, 0);
+        uint32_t uRva = (uint32_t)m_aData.size();
+        if(uSize!=0)
+            m_aData.insert(m_aData.end(), (const uint8_t*)pData, (const uint8_t*)pData+uSize);
+        return uRva;
+    }
+
+    // Appends a MINIDUMP_STRING converted from UTF-8 and returns its RVA
+    uint32_t AddString(const std::string& sUtf8)
+    {
+        std::vector<uint8_t> a(4, 0);
+        size_t i = 0;
+        while(i<sUtf8.length())
+        {
+            uint32_t ch = DecodeUtf8(sUtf8, i);
+            if(ch>=0x10000)
+            {
+                ch -= 0x10000;
+                PutU16(a, (uint16_t)(0xD800+(ch>>10)));
+                PutU16(a, (uint16_t)(0xDC00+(ch&0x3FF)));
+            }
+            else
+                PutU16(a, (uint16_t)ch);
+        }
+        SetU32(a, 0, (uint32_t)(a.size()-4));
+        PutU16(a, 0);
+        return AddBlob(&a[0], a.size());
+    }
+
+    // Appends a stream and adds its directory entry
+    void AddStream(uint32_t uStreamType, const std::vector<uint8_t>& aBody)
+    {
+        uint32_t uRva = AddBlob(aBody.empty()?NULL:&aBody[0], aBody.size());
+        PutU32(m_aDirectory, uStreamType);
+        PutU32(m_aDirectory, (uint32_t)aBody.size());
+        PutU32(m_aDirectory, uRva);
+    }
+
+    // Appends the stream directory, fills in the header and returns the image
+    std::vector<uint8_t>& Finish()
+    {
+        uint32_t uDirRva = AddBlob(m_aDirectory.empty()?NULL:&m_aDirectory[0], m_aDirectory.size());
+        SetU32(m_aData, 0, LDUMP_SIGNATURE);
+        SetU32(m_aData, 4, LDUMP_VERSION);
+        SetU32(m_aData, 8, (uint32_t)(m_aDirectory.size()/12));
+        SetU32(m_aData, 12, uDirRva);
+        return m_aData;
+    }
+
+    static void PutU16(std::vector<uint8_t>& a, uint16_t v)
+    {
+        a.push_back((uint8_t)v);
+        a.push_back((uint8_t)(v>>8));
+    }
+
+    static void PutU32(std::vector<uint8_t>& a, uint32_t v)
+    {
+        PutU16(a, (uint16_t)v);
+        PutU16(a, (uint16_t)(v>>16));
+    }
+
+    static void PutU64(std::vector<uint8_t>& a, uint64_t v)
+    {
+        PutU32(a, (uint32_t)v);
+        PutU32(a, (uint32_t)(v>>32));
+    }
+
+    static void SetU16(std::vector<uint8_t>& a, size_t uOffs, uint16_t v)
+    {
+        a[uOffs] = (uint8_t)v;
+        a[uOffs+1] = (uint8_t)(v>>8);
+    }
+
+    static void SetU32(std::vector<uint8_t>& a, size_t uOffs, uint32_t v)
+    {
+        SetU16(a, uOffs, (uint16_t)v);
+        SetU16(a, uOffs+2, (uint16_t)(v>>16));
+    }
+
+    static void SetU64(std::vector<uint8_t>& a, size_t uOffs, uint64_t v)
+    {
+        SetU32(a, uOffs, (uint32_t)v);
+        SetU32(a, uOffs+4, (uint32_t)(v>>32));
+    }
+
+private:
+
+    // Decodes a character at the position and moves the position past it. Invalid
+    // sequences give U+FFFD.
+    static uint32_t DecodeUtf8(const std::string& s, size_t& i)
+    {
+        uint8_t c = (uint8_t)s[i++];
+        int nExtra = 0;
+        uint32_t ch = 0;
+
+        if(c<0x80)
+            return c;
+        else if((c&0xE0)==0xC0)
+        {
+            nExtra = 1;
+            ch = c&0x1F;
+        }
+        else if((c&0xF0)==0xE0)
+        {
+            nExtra = 2;
+            ch = c&0x0F;
+        }
+        else if((c&0xF8)==0xF0)
+        {
+            nExtra = 3;
+            ch = c&0x07;
+        }
+        else
+            return 0xFFFD;
+
+        while(nExtra-->0)
+        {
+            if(i>=s.length() || ((uint8_t)s[i]&0xC0)!=0x80)
+                return 0xFFFD;
+            ch = (ch<<6)|((uint8_t)s[i++]&0x3F);
+        }
+
+        return ch<=0x10FFFF?ch:0xFFFD;
+    }
+
+    std::vector<uint8_t> m_aData;      // Header and data blocks
+    std::vector<uint8_t> m_aDirectory; // Stream directory
+};
+
+#if defined(__x86_64__)
+// Converts registers to the AMD64 CONTEXT layout
+static void MakeContext(const struct user_regs_struct& regs, const struct user_fpregs_struct* pFpRegs,
+    std::vector<uint8_t>& aContext)
+{
+    aContext.assign(LDUMP_AMD64_CONTEXT_SIZE, 0);
+    CDumpImage::SetU32(aContext, 0x30, LDUMP_AMD64_CONTEXT_FULL);
+    CDumpImage::SetU32(aContext, 0x34, pFpRegs!=NULL?pFpRegs->mxcsr:0);
+    CDumpImage::SetU16(aContext, 0x38, (uint16_t)regs.cs);
+    CDumpImage::SetU16(aContext, 0x3A, (uint16_t)regs.ds);
+    CDumpImage::SetU16(aContext, 0x3C, (uint16_t)regs.es);
+    CDumpImage::SetU16(aContext, 0x3E, (uint16_t)regs.fs);
+    CDumpImage::SetU16(aContext, 0x40, (uint16_t)regs.gs);
+    CDumpImage::SetU16(aContext, 0x42, (uint16_t)regs.ss);
+    CDumpImage::SetU32(aContext, 0x44, (uint32_t)regs.eflags);
+    CDumpImage::SetU64(aContext, 0x78, regs.rax);
+    CDumpImage::SetU64(aContext, 0x80, regs.rcx);
+    CDumpImage::SetU64(aContext, 0x88, regs.rdx);
+    CDumpImage::SetU64(aContext, 0x90, regs.rbx);
+    CDumpImage::SetU64(aContext, 0x98, regs.rsp);
+    CDumpImage::SetU64(aContext, 0xA0, regs.rbp);
+    CDumpImage::SetU64(aContext, 0xA8, regs.rsi);
+    CDumpImage::SetU64(aContext, 0xB0, regs.rdi);
+    CDumpImage::SetU64(aContext, 0xB8, regs.r8);
+    CDumpImage::SetU64(aContext, 0xC0, regs.r9);
+    CDumpImage::SetU64(aContext, 0xC8, regs.r10);
+    CDumpImage::SetU64(aContext, 0xD0, regs.r11);
+    CDumpImage::SetU64(aContext, 0xD8, regs.r12);
+    CDumpImage::SetU64(aContext, 0xE0, regs.r13);
+    CDumpImage::SetU64(aContext, 0xE8, regs.r14);
+    CDumpImage::SetU64(aContext, 0xF0, regs.r15);
+    CDumpImage::SetU64(aContext, 0xF8, regs.rip);
+
+    // The FXSAVE area has the layout of XMM_SAVE_AREA32
+    if(pFpRegs!=NULL)
+        memcpy(&aContext[0x100], pFpRegs, sizeof(*pFpRegs));
+}
+#endif
+
+CLinuxDumpWriter::CLinuxDumpWriter()
+{
+    memset(&m_Info, 0, sizeof(m_Info));
+    m_uMaxStackSize = LDUMP_MAX_STACK_SIZE;
+    m_fdMem = -1;
+    m_uExceptionAddress = 0;
+}
+
+CLinuxDumpWriter::~CLinuxDumpWriter()
+{
+    if(m_fdMem>=0)
+        close(m_fdMem);
+}
+
+void CLinuxDumpWriter::SetMaxStackSize(size_t uMaxStackSize)
+{
+    m_uMaxStackSize = uMaxStackSize;
+}
+
+int CLinuxDumpWriter::WriteDump(const LinuxCrashInfo& Info, const char* szFileName)
+{
+    char szPath[64];
+    size_t i;
+    int nResult = LDUMP_OK;
+
+    m_Info = Info;
+    m_aThreads.clear();
+    m_aMappings.clear();
+    m_aModules.clear();
+    m_uExceptionAddress = 0;
+
+    // Stop the process, so its memory doesn't change while it is read
+    nResult = StopThreads();
+    if(nResult!=LDUMP_OK)
+        goto cleanup;
+
+    snprintf(szPath, sizeof(szPath), "/proc/%d/mem", (int)m_Info.m_nPid);
+    m_fdMem = open(szPath, O_RDONLY|O_CLOEXEC);
+    if(m_fdMem<0)
+    {
+        nResult = LDUMP_ERR_READ_PROC;
+        goto cleanup;
+    }
+
+    nResult = ReadMappings();
+    if(nResult!=LDUMP_OK)
+        goto cleanup;
+
+    for(i=0; i<m_aThreads.size(); i++)
+    {
+        ReadRegisters(m_aThreads[i]);
+        ReadStack(m_aThreads[i]);
+    }
+
+    ReadModules();
+
+cleanup:
+
+    // Let the process go on (it waits in the signal handler until told the dump is written)
+    ResumeThreads();
+
+    if(m_fdMem>=0)
+    {
+        close(m_fdMem);
+        m_fdMem = -1;
+    }
+
+    if(nResult==LDUMP_OK)
+        nResult = SaveFile(szFileName);
+
+    return nResult;
+}
+
+const std::vector<LinuxDumpModule>& CLinuxDumpWriter::GetModules() const
+{
+    return m_aModules;
+}
+
+size_t CLinuxDumpWriter::GetThreadCount() const
+{
+    return m_aThreads.size();
+}
+
+uint64_t CLinuxDumpWriter::GetExceptionAddress() const
+{
+    return m_uExceptionAddress;
+}
+
+const LinuxDumpModule* CLinuxDumpWriter::FindModule(uint64_t uAddress) const
+{
+    size_t i;
+    for(i=0; i<m_aModules.size(); i++)
+    {
+        if(uAddress>=m_aModules[i].m_uBaseAddr &&
+            uAddress<m_aModules[i].m_uBaseAddr+m_aModules[i].m_uSize)
+            return &m_aModules[i];
+    }
+
+    return NULL;
+}
+
+int CLinuxDumpWriter::StopThreads()
+{
+    char szPath[64];
+    bool bFound = true;
+    size_t i;
+
+    snprintf(szPath, sizeof(szPath), "/proc/%d/task", (int)m_Info.m_nPid);
+
+    while(bFound)
+    {
+        bFound = false;
+
+        DIR* pDir = opendir(szPath);
+        if(pDir==NULL)
+            return LDUMP_ERR_READ_PROC;
+
+        struct dirent* pEntry;
+        while((pEntry = readdir(pDir))!=NULL)
+        {
+            pid_t nTid = (pid_t)atoi(pEntry->d_name);
+            if(nTid<=0)
+                continue;
+
+            for(i=0; i<m_aThreads.size(); i++)
+            {
+                if(m_aThreads[i].m_nTid==nTid)
+                    break;
+            }
+            if(i!=m_aThreads.size())
+                continue; // Already stopped
+
+            // Seizing doesn't send SIGSTOP, which would remain pending after detaching.
+            // The thread may have exited in the meantime.
+            if(ptrace(PTRACE_SEIZE, nTid, NULL, NULL)!=0)
+                continue;
+            if(ptrace(PTRACE_INTERRUPT, nTid, NULL, NULL)!=0)
+            {
+                ptrace(PTRACE_DETACH, nTid, NULL, NULL);
+                continue;
+            }
+
+            int nStatus = 0;
+            pid_t nWaitResult;
+            do
+            {
+                nWaitResult = waitpid(nTid, &nStatus, __WALL);
+            }
+            while(nWaitResult<0 && errno==EINTR);
+            if(nWaitResult!=nTid || !WIFSTOPPED(nStatus))
+            {
+                // Don't leave the thread attached; this fails harmlessly if it has exited
+                ptrace(PTRACE_DETACH, nTid, NULL, NULL);
+                continue;
+            }
+
+            DumpThread t;
+            t.m_nTid = nTid;
+            // A signal-delivery stop takes the signal from the thread, it is passed back
+            // on detach; other stops are ptrace events
+            t.m_nStopSignal = (nStatus>>16)==0?WSTOPSIG(nStatus):0;
+            t.m_bHasContext = false;
+            t.m_uStackPtr = 0;
+            t.m_uTlsBase = 0;
+            t.m_uStackStart = 0;
+            m_aThreads.push_back(t);
+            bFound = true;
+        }
+
+        closedir(pDir);
+    }
+
+    return m_aThreads.empty()?LDUMP_ERR_ATTACH:LDUMP_OK;
+}
+
+void CLinuxDumpWriter::ResumeThreads()
+{
+    size_t i;
+    for(i=0; i<m_aThreads.size(); i++)
+    {
+        ptrace(PTRACE_DETACH, m_aThreads[i].m_nTid, NULL,
+            (void*)(intptr_t)m_aThreads[i].m_nStopSignal);
+    }
+}
+
+void CLinuxDumpWriter::ReadRegisters(DumpThread& t)
+{
+#if defined(__x86_64__)
+    struct user_regs_struct regs;
+    struct user_fpregs_struct fpregs;
+    const struct user_fpregs_struct* pFpRegs = NULL;
+
+    if(t.m_nTid==m_Info.m_nTid && m_Info.m_bHasContext)
+    {
+        // The crashed thread now runs the signal handler, its registers at the
+        // moment of the crash were saved by the handler
+        regs = m_Info.m_Regs;
+        pFpRegs = &m_Info.m_FpRegs;
+        m_uExceptionAddress = regs.rip;
+    }
+    else
+    {
+        if(ptrace(PTRACE_GETREGS, t.m_nTid, NULL, &regs)!=0)
+            return;
+        if(ptrace(PTRACE_GETFPREGS, t.m_nTid, NULL, &fpregs)==0)
+            pFpRegs = &fpregs;
+    }
+
+    MakeContext(regs, pFpRegs, t.m_aContext);
+    t.m_bHasContext = true;
+    t.m_uStackPtr = regs.rsp;
+    t.m_uTlsBase = regs.fs_base;
+#else
+    // Thread contexts are only written for x86-64, other threads are saved without
+    // registers and stacks
+    (void)t;
+#endif
+}
+
+int CLinuxDumpWriter::ReadMappings()
+{
+    char szPath[64];
+    char szLine[4096+256];
+
+    snprintf(szPath, sizeof(szPath), "/proc/%d/maps", (int)m_Info.m_nPid);
+    FILE* f = fopen(szPath, "r");
+    if(f==NULL)
+        return LDUMP_ERR_READ_PROC;
+
+    while(fgets(szLine, sizeof(szLine), f)!=NULL)
+    {
+        unsigned long long uStart = 0;
+        unsigned long long uEnd = 0;
+        unsigned long long uOffset = 0;
+        char szPerms[8];
+        int nPathPos = 0;
+
+        // start-end perms offset dev inode path
+        if(sscanf(szLine, "%llx-%llx %7s %llx %*s %*s %n", &uStart, &uEnd, szPerms, &uOffset, &nPathPos)<4)
+            continue;
+
+        DumpMapping m;
+        m.m_uStart = uStart;
+        m.m_uEnd = uEnd;
+        m.m_uOffset = uOffset;
+        m.m_bReadable = szPerms[0]=='r';
+        if(nPathPos>0)
+        {
+            m.m_sPath = szLine+nPathPos;
+            while(!m.m_sPath.empty() && (m.m_sPath[m.m_sPath.length()-1]=='\n' ||
+                m.m_sPath[m.m_sPath.length()-1]==' '))
+                m.m_sPath.erase(m.m_sPath.length()-1);
+        }
+        m_aMappings.push_back(m);
+    }
+
+    fclose(f);
+    return m_aMappings.empty()?LDUMP_ERR_READ_PROC:LDUMP_OK;
+}
+
+void CLinuxDumpWriter::ReadModules()
+{
+    size_t i;
+
+    // A module starts with the mapping of its ELF header (file offset 0) and spans
+    // the following mappings of the same file
+    for(i=0; i<m_aMappings.size(); i++)
+    {
+        const DumpMapping& m = m_aMappings[i];
+        if(m.m_sPath.empty() || m.m_sPath[0]!='/')
+            continue;
+
+        if(m.m_uOffset==0 && m.m_bReadable)
+        {
+            LinuxDumpModule module;
+            module.m_uBaseAddr = m.m_uStart;
+            module.m_uSize = m.m_uEnd-m.m_uStart;
+            module.m_sPath = m.m_sPath;
+            m_aModules.push_back(module);
+        }
+        else if(!m_aModules.empty() && m_aModules.back().m_sPath==m.m_sPath &&
+            m.m_uEnd>m_aModules.back().m_uBaseAddr)
+        {
+            m_aModules.back().m_uSize = m.m_uEnd-m_aModules.back().m_uBaseAddr;
+        }
+    }
+
+    // Mapped files that are not ELF images are not modules
+    std::vector<LinuxDumpModule> aModules;
+    for(i=0; i<m_aModules.size(); i++)
+    {
+        ElfW(Ehdr) ehdr;
+        if(ReadMemory(m_aModules[i].m_uBaseAddr, &ehdr, sizeof(ehdr))!=sizeof(ehdr) ||
+            memcmp(ehdr.e_ident, ELFMAG, SELFMAG)!=0)
+            continue;
+
+        ReadBuildId(m_aModules[i]);
+        aModules.push_back(m_aModules[i]);
+    }
+    m_aModules.swap(aModules);
+}
+
+void CLinuxDumpWriter::ReadBuildId(LinuxDumpModule& m)
+{
+    ElfW(Ehdr) ehdr;
+    std::vector<ElfW(Phdr)> aPhdrs;
+    uint64_t uBias = m.m_uBaseAddr;
+    size_t i;
+
+    if(ReadMemory(m.m_uBaseAddr, &ehdr, sizeof(ehdr))!=sizeof(ehdr) ||
+        ehdr.e_ident[EI_CLASS]!=(sizeof(void*)==8?ELFCLASS64:ELFCLASS32) ||
+        ehdr.e_phentsize!=sizeof(ElfW(Phdr)) || ehdr.e_phnum==0 || ehdr.e_phnum>256)
+        return;
+
+    aPhdrs.resize(ehdr.e_phnum);
+    size_t uPhdrSize = aPhdrs.size()*sizeof(ElfW(Phdr));
+    if(ReadMemory(m.m_uBaseAddr+ehdr.e_phoff, &aPhdrs[0], uPhdrSize)!=uPhdrSize)
+        return;
+
+    // Segment addresses are relative to the address of the segment with the headers
+    for(i=0; i<aPhdrs.size(); i++)
+    {
+        if(aPhdrs[i].p_type==PT_LOAD && aPhdrs[i].p_offset==0)
+        {
+            uBias = m.m_uBaseAddr-aPhdrs[i].p_vaddr;
+            break;
+        }
+    }
+
+    for(i=0; i<aPhdrs.size(); i++)
+    {
+        if(aPhdrs[i].p_type!=PT_NOTE)
+            continue;
+
+        std::vector<uint8_t> aNotes((size_t)(aPhdrs[i].p_filesz<LDUMP_MAX_NOTES_SIZE?
+            aPhdrs[i].p_filesz:LDUMP_MAX_NOTES_SIZE));
+        if(aNotes.empty())
+            continue;
+        aNotes.resize(ReadMemory(uBias+aPhdrs[i].p_vaddr, &aNotes[0], aNotes.size()));
+
+        size_t uPos = 0;
+        while(uPos+sizeof(ElfW(Nhdr))<=aNotes.size())
+        {
+            ElfW(Nhdr) nhdr;
+            memcpy(&nhdr, &aNotes[uPos], sizeof(nhdr));
+            size_t uNamePos = uPos+sizeof(nhdr);
+            size_t uDescPos = uNamePos+((nhdr.n_namesz+3)&~3u);
+            size_t uNext = uDescPos+((nhdr.n_descsz+3)&~3u);
+            if(uNext>aNotes.size() || uNext<=uPos)
+                break;
+
+            if(nhdr.n_type==NT_GNU_BUILD_ID && nhdr.n_namesz==4 &&
+                memcmp(&aNotes[uNamePos], "GNU", 4)==0)
+            {
+                m.m_aBuildId.assign(aNotes.begin()+uDescPos, aNotes.begin()+uDescPos+nhdr.n_descsz);
+                return;
+            }
+            uPos = uNext;
+        }
+    }
+}
+
+void CLinuxDumpWriter::ReadStack(DumpThread& t)
+{
+    size_t i;
+
+    if(t.m_uStackPtr==0)
+        return;
+
+    for(i=0; i<m_aMappings.size(); i++)
+    {
+        const DumpMapping& m = m_aMappings[i];
+        if(t.m_uStackPtr<m.m_uStart || t.m_uStackPtr>=m.m_uEnd || !m.m_bReadable)
+            continue;
+
+        // The used part of the stack is above the stack pointer
+        uint64_t uStart = t.m_uStackPtr-m.m_uStart>LDUMP_RED_ZONE?t.m_uStackPtr-LDUMP_RED_ZONE:m.m_uStart;
+        uint64_t uSize = m.m_uEnd-uStart;
+        if(uSize>m_uMaxStackSize)
+            uSize = m_uMaxStackSize;
+
+        t.m_aStack.resize((size_t)uSize);
+        t.m_aStack.resize(ReadMemory(uStart, &t.m_aStack[0], t.m_aStack.size()));
+        t.m_uStackStart = uStart;
+        return;
+    }
+}
+
+size_t CLinuxDumpWriter::ReadMemory(uint64_t uAddress, void* pBuf, size_t uSize)
+{
+    size_t uRead = 0;
+    while(uRead<uSize)
+    {
+        ssize_t n = pread(m_fdMem, (uint8_t*)pBuf+uRead, uSize-uRead, (off_t)(uAddress+uRead));
+        if(n<0 && errno==EINTR)
+            continue;
+        if(n<=0)
+            break;
+        uRead += (size_t)n;
+    }
+
+    return uRead;
+}
+
+int CLinuxDumpWriter::SaveFile(const char* szFileName)
+{
+    CDumpImage image;
+    std::vector<uint8_t> aThreadList;
+    std::vector<uint8_t> aMemoryList;
+    std::vector<uint8_t> aModuleList;
+    uint32_t uCrashContextSize = 0;
+    uint32_t uCrashContextRva = 0;
+    size_t i;
+
+    // System info
+    {
+        struct utsname un;
+        unsigned uMajor = 0;
+        unsigned uMinor = 0;
+        unsigned uBuild = 0;
+        std::string sOS;
+        if(uname(&un)==0)
+        {
+            sscanf(un.release, "%u.%u.%u", &uMajor, &uMinor, &uBuild);
+            sOS = std::string(un.sysname)+" "+un.release+" "+un.version+" "+un.machine;
+        }
+
+        uint16_t uArch = LDUMP_ARCH_UNKNOWN;
+#if defined(__x86_64__)
+        uArch = LDUMP_ARCH_AMD64;
+#elif defined(__aarch64__)
+        uArch = LDUMP_ARCH_ARM64;
+#elif defined(__i386__)
+        uArch = LDUMP_ARCH_INTEL;
+#endif
+        long nCpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+
+        std::vector<uint8_t> a(56, 0);
+        CDumpImage::SetU16(a, 0, uArch);
+        a[6] = (uint8_t)(nCpuCount>0 && nCpuCount<255?nCpuCount:255);
+        CDumpImage::SetU32(a, 8, uMajor);
+        CDumpImage::SetU32(a, 12, uMinor);
+        CDumpImage::SetU32(a, 16, uBuild);
+        CDumpImage::SetU32(a, 20, LDUMP_PLATFORM_LINUX);
+        CDumpImage::SetU32(a, 24, image.AddString(sOS));
+        image.AddStream(LDUMP_SYSTEM_INFO_STREAM, a);
+    }
+
+    // Threads, their stacks are also listed in the memory list
+    CDumpImage::PutU32(aThreadList, (uint32_t)m_aThreads.size());
+    CDumpImage::PutU32(aMemoryList, 0);
+    uint32_t uRangeCount = 0;
+    for(i=0; i<m_aThreads.size(); i++)
+    {
+        const DumpThread& t = m_aThreads[i];
+        uint32_t uStackRva = t.m_aStack.empty()?0:image.AddBlob(&t.m_aStack[0], t.m_aStack.size());
+        uint32_t uContextRva = t.m_aContext.empty()?0:image.AddBlob(&t.m_aContext[0], t.m_aContext.size());
+
+        size_t uOffs = aThreadList.size();
+        aThreadList.resize(uOffs+48, 0);
+        CDumpImage::SetU32(aThreadList, uOffs, (uint32_t)t.m_nTid);
+        CDumpImage::SetU64(aThreadList, uOffs+16, t.m_uTlsBase);
+        CDumpImage::SetU64(aThreadList, uOffs+24, t.m_uStackStart);
+        CDumpImage::SetU32(aThreadList, uOffs+32, (uint32_t)t.m_aStack.size());
+        CDumpImage::SetU32(aThreadList, uOffs+36, uStackRva);
+        CDumpImage::SetU32(aThreadList, uOffs+40, (uint32_t)t.m_aContext.size());
+        CDumpImage::SetU32(aThreadList, uOffs+44, uContextRva);
+
+        if(!t.m_aStack.empty())
+        {
+            CDumpImage::PutU64(aMemoryList, t.m_uStackStart);
+            CDumpImage::PutU32(aMemoryList, (uint32_t)t.m_aStack.size());
+            CDumpImage::PutU32(aMemoryList, uStackRva);
+            uRangeCount++;
+        }
+
+        if(t.m_nTid==m_Info.m_nTid)
+        {
+            uCrashContextSize = (uint32_t)t.m_aContext.size();
+            uCrashContextRva = uContextRva;
+        }
+    }
+    CDumpImage::SetU32(aMemoryList, 0, uRangeCount);
+    image.AddStream(LDUMP_THREAD_LIST_STREAM, aThreadList);
+    image.AddStream(LDUMP_MEMORY_LIST_STREAM, aMemoryList);
+
+    // Modules. The build ID is stored as the GUID of a CodeView record, so modules can
+    // be matched with their symbols.
+    CDumpImage::PutU32(aModuleList, (uint32_t)m_aModules.size());
+    for(i=0; i<m_aModules.size(); i++)
+    {
+        const LinuxDumpModule& m = m_aModules[i];
+        uint32_t uNameRva = image.AddString(m.m_sPath);
+
+        uint32_t uCvSize = 0;
+        uint32_t uCvRva = 0;
+        if(!m.m_aBuildId.empty())
+        {
+            std::vector<uint8_t> r;
+            uint8_t auchGuid[16];
+            memset(auchGuid, 0, sizeof(auchGuid));
+            memcpy(auchGuid, &m.m_aBuildId[0], m.m_aBuildId.size()<16?m.m_aBuildId.size():16);
+            CDumpImage::PutU32(r, 0x53445352); // 'RSDS'
+            r.insert(r.end(), auchGuid, auchGuid+16);
+            CDumpImage::PutU32(r, 0); // Age
+            r.insert(r.end(), m.m_sPath.begin(), m.m_sPath.end());
+            r.push_back(0);
+            uCvSize = (uint32_t)r.size();
+            uCvRva = image.AddBlob(&r[0], r.size());
+        }
+
+        size_t uOffs = aModuleList.size();
+        aModuleList.resize(uOffs+108, 0);
+        CDumpImage::SetU64(aModuleList, uOffs, m.m_uBaseAddr);
+        CDumpImage::SetU32(aModuleList, uOffs+8, (uint32_t)m.m_uSize);
+        CDumpImage::SetU32(aModuleList, uOffs+20, uNameRva);
+        CDumpImage::SetU32(aModuleList, uOffs+76, uCvSize);
+        CDumpImage::SetU32(aModuleList, uOffs+80, uCvRva);
+    }
+    image.AddStream(LDUMP_MODULE_LIST_STREAM, aModuleList);
+
+    // Exception: the signal number is the exception code and si_code the flags, the
+    // faulting address is the first exception parameter
+    if(m_Info.m_nSignal!=0)
+    {
+        std::vector<uint8_t> a(168, 0);
+        CDumpImage::SetU32(a, 0, (uint32_t)m_Info.m_nTid);
+        CDumpImage::SetU32(a, 8, (uint32_t)m_Info.m_nSignal);
+        CDumpImage::SetU32(a, 12, (uint32_t)m_Info.m_nCode);
+        CDumpImage::SetU64(a, 24, m_uExceptionAddress!=0?m_uExceptionAddress:m_Info.m_uFaultAddr);
+        CDumpImage::SetU32(a, 32, 1);
+        CDumpImage::SetU64(a, 40, m_Info.m_uFaultAddr);
+        CDumpImage::SetU32(a, 160, uCrashContextSize);
+        CDumpImage::SetU32(a, 164, uCrashContextRva);
+        image.AddStream(LDUMP_EXCEPTION_STREAM, a);
+    }
+
+    // Write the file
+    std::vector<uint8_t>& aImage = image.Finish();
+    int fd = open(szFileName, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+    if(fd<0)
+        return LDUMP_ERR_WRITE_FILE;
+
+    size_t uWritten = 0;
+    while(uWritten<aImage.size())
+    {
+        ssize_t n = write(fd, &aImage[uWritten], aImage.size()-uWritten);
+        if(n<0 && errno==EINTR)
+            continue;
+        if(n<=0)
+            break;
+        uWritten += (size_t)n;
+    }
+
+    if(close(fd)!=0 || uWritten!=aImage.size())
+        return LDUMP_ERR_WRITE_FILE;
+
+    return LDUMP_OK;
+}
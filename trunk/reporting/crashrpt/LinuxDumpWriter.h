@@ -0,0 +1,161 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: LinuxDumpWriter.h
+// Description: Writes a minidump of another process on Linux. The threads of the process
+// are stopped with ptrace, their registers and stacks, the loaded modules (from
+// /proc/<pid>/maps) and the crash information received from the crashed process are
+// saved in the minidump format read by CrashRptProbe.
+
+#pragma once
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/user.h>
+#include <string>
+#include <vector>
+
+// Platform ID of Linux minidumps (the value used by Breakpad)
+#define LDUMP_PLATFORM_LINUX 0x8201
+
+// Maximum size of stack memory saved for a thread
+#define LDUMP_MAX_STACK_SIZE (256*1024)
+
+// Error codes returned by CLinuxDumpWriter methods
+enum LinuxDumpError
+{
+    LDUMP_OK = 0,              // Success
+    LDUMP_ERR_ATTACH = 1,      // Couldn't stop the process with ptrace
+    LDUMP_ERR_READ_PROC = 2,   // Couldn't read /proc/<pid> files
+    LDUMP_ERR_WRITE_FILE = 3   // Couldn't write the minidump file
+};
+
+// Crash information passed by the crashed process. It is filled by the signal
+// handler, so it is a plain structure without pointers.
+struct LinuxCrashInfo
+{
+    pid_t m_nPid;              // Crashed process
+    pid_t m_nTid;              // Thread that received the signal
+    int m_nSignal;             // Signal number, or 0 if there was no crash
+    int m_nCode;               // si_code of the signal
+    uint64_t m_uFaultAddr;     // si_addr of the signal
+    int m_bHasContext;         // Are the registers below valid?
+#if defined(__x86_64__)
+    struct user_regs_struct m_Regs;     // Registers at the moment of the crash
+    struct user_fpregs_struct m_FpRegs; // FPU and SSE registers
+#endif
+};
+
+// A module loaded by the process
+struct LinuxDumpModule
+{
+    LinuxDumpModule()
+    {
+        m_uBaseAddr = 0;
+        m_uSize = 0;
+    }
+
+    uint64_t m_uBaseAddr;          // Address of the first mapping of the file
+    uint64_t m_uSize;              // Size of address range covered by the mappings
+    std::string m_sPath;           // File path
+    std::vector<uint8_t> m_aBuildId; // GNU build ID, may be empty
+};
+
+// class CLinuxDumpWriter
+// Captures a process into a minidump. The process is stopped only while its threads are
+// read and is resumed before the file is written. The caller must be allowed to ptrace
+// the process (the crashed process calls prctl(PR_SET_PTRACER) for its helper).
+class CLinuxDumpWriter
+{
+public:
+
+    CLinuxDumpWriter();
+    ~CLinuxDumpWriter();
+
+    // Sets the maximum size of stack memory saved for a thread
+    void SetMaxStackSize(size_t uMaxStackSize);
+
+    // Captures the process and writes the minidump file. For the crashed thread the
+    // registers from the crash information are used, since the thread is now running
+    // the signal handler.
+    int WriteDump(const LinuxCrashInfo& Info, const char* szFileName);
+
+    // Returns the modules found by the last WriteDump() call
+    const std::vector<LinuxDumpModule>& GetModules() const;
+
+    // Returns the number of threads captured by the last WriteDump() call
+    size_t GetThreadCount() const;
+
+    // Returns the instruction address of the crash (or 0 if unknown)
+    uint64_t GetExceptionAddress() const;
+
+    // Returns the module containing the address, or NULL
+    const LinuxDumpModule* FindModule(uint64_t uAddress) const;
+
+private:
+
+    // A thread stopped by ptrace
+    struct DumpThread
+    {
+        pid_t m_nTid;                  // Thread ID
+        int m_nStopSignal;             // Signal to pass back when resuming the thread
+        bool m_bHasContext;            // Were the registers read?
+        uint64_t m_uStackPtr;          // Stack pointer
+        uint64_t m_uTlsBase;           // Thread pointer (stored as TEB address)
+        std::vector<uint8_t> m_aContext; // Registers in the minidump CONTEXT layout
+        uint64_t m_uStackStart;        // Address of captured stack memory
+        std::vector<uint8_t> m_aStack; // Captured stack memory
+    };
+
+    // A line of /proc/<pid>/maps
+    struct DumpMapping
+    {
+        uint64_t m_uStart;
+        uint64_t m_uEnd;
+        uint64_t m_uOffset;
+        bool m_bReadable;
+        std::string m_sPath;
+    };
+
+    // Stops all threads of the process. New threads may appear while the existing ones
+    // are being stopped, so the thread list is read until no new thread is found.
+    int StopThreads();
+
+    // Resumes the stopped threads
+    void ResumeThreads();
+
+    // Reads the registers of a stopped thread
+    void ReadRegisters(DumpThread& t);
+
+    // Reads /proc/<pid>/maps
+    int ReadMappings();
+
+    // Builds the module list from the mappings
+    void ReadModules();
+
+    // Reads the GNU build ID of a module from its ELF headers in memory
+    void ReadBuildId(LinuxDumpModule& m);
+
+    // Captures stack memory of a thread
+    void ReadStack(DumpThread& t);
+
+    // Reads process memory. Returns the number of bytes read.
+    size_t ReadMemory(uint64_t uAddress, void* pBuf, size_t uSize);
+
+    // Composes the minidump and writes it to the file
+    int SaveFile(const char* szFileName);
+
+    LinuxCrashInfo m_Info;              // Crash information
+    size_t m_uMaxStackSize;             // Stack size limit
+    int m_fdMem;                        // /proc/<pid>/mem
+    std::vector<DumpThread> m_aThreads; // Captured threads
+    std::vector<DumpMapping> m_aMappings; // Memory mappings
+    std::vector<LinuxDumpModule> m_aModules; // Loaded modules
+    uint64_t m_uExceptionAddress;       // Instruction address of the crash
+};
@@ -0,0 +1,269 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PropertyTable.h"
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Atomic access to the sequence number and the hash. Reads acquire and writes release,
+// so the slot data written before the sequence number is published are seen by the
+// reader that sees the number.
+#ifdef _WIN32
+
+static uint32_t AtomicLoad(volatile uint32_t* p)
+{
+    uint32_t v = *p;
+    MemoryBarrier();
+    return v;
+}
+
+static void AtomicStore(volatile uint32_t* p, uint32_t v)
+{
+    MemoryBarrier();
+    *p = v;
+}
+
+static bool AtomicCompareExchange(volatile uint32_t* p, uint32_t uExpected, uint32_t uNew)
+{
+    return (uint32_t)InterlockedCompareExchange((volatile LONG*)p, (LONG)uNew, (LONG)uExpected)==uExpected;
+}
+
+static void AtomicFence()
+{
+    MemoryBarrier();
+}
+
+static void SpinPause()
+{
+    YieldProcessor();
+}
+
+#else
+
+static uint32_t AtomicLoad(volatile uint32_t* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void AtomicStore(volatile uint32_t* p, uint32_t v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static bool AtomicCompareExchange(volatile uint32_t* p, uint32_t uExpected, uint32_t uNew)
+{
+    return __atomic_compare_exchange_n(p, &uExpected, uNew, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static void AtomicFence()
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+static void SpinPause()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+#endif
+
+CPropertyTable::CPropertyTable()
+{
+    m_pHeader = NULL;
+    m_pSlots = NULL;
+}
+
+size_t CPropertyTable::GetRequiredSize()
+{
+    return sizeof(PROPTABLE_HEADER)+PROPTABLE_SLOT_COUNT*sizeof(PROPTABLE_SLOT);
+}
+
+void CPropertyTable::Init(void* pMem)
+{
+    memset(pMem, 0, GetRequiredSize());
+
+    m_pHeader = (PROPTABLE_HEADER*)pMem;
+    memcpy(m_pHeader->m_uchMagic, "PTB1", 4);
+    m_pHeader->m_uSlotCount = PROPTABLE_SLOT_COUNT;
+    m_pHeader->m_uSlotSize = sizeof(PROPTABLE_SLOT);
+    m_pSlots = (PROPTABLE_SLOT*)(m_pHeader+1);
+}
+
+bool CPropertyTable::Attach(void* pMem, size_t uSize)
+{
+    Detach();
+
+    if(pMem==NULL || uSize<GetRequiredSize())
+        return false;
+
+    PROPTABLE_HEADER* pHeader = (PROPTABLE_HEADER*)pMem;
+    if(memcmp(pHeader->m_uchMagic, "PTB1", 4)!=0 ||
+        pHeader->m_uSlotCount!=PROPTABLE_SLOT_COUNT ||
+        pHeader->m_uSlotSize!=sizeof(PROPTABLE_SLOT))
+        return false;
+
+    m_pHeader = pHeader;
+    m_pSlots = (PROPTABLE_SLOT*)(m_pHeader+1);
+    return true;
+}
+
+void CPropertyTable::Detach()
+{
+    m_pHeader = NULL;
+    m_pSlots = NULL;
+}
+
+bool CPropertyTable::IsAttached() const
+{
+    return m_pHeader!=NULL;
+}
+
+int CPropertyTable::GetSlotCount() const
+{
+    return m_pHeader!=NULL?PROPTABLE_SLOT_COUNT:0;
+}
+
+uint32_t CPropertyTable::Hash(const void* pName, size_t uNameSize)
+{
+    // FNV-1a
+    const uint8_t* p = (const uint8_t*)pName;
+    uint32_t uHash = 2166136261u;
+    size_t i;
+    for(i=0; i<uNameSize; i++)
+    {
+        uHash ^= p[i];
+        uHash *= 16777619u;
+    }
+
+    return uHash!=0?uHash:1;
+}
+
+void CPropertyTable::LockSlot(PROPTABLE_SLOT* pSlot)
+{
+    for(;;)
+    {
+        uint32_t uSeq = AtomicLoad(&pSlot->m_uSeq);
+        if((uSeq&1)==0 && AtomicCompareExchange(&pSlot->m_uSeq, uSeq, uSeq+1))
+            return;
+        SpinPause();
+    }
+}
+
+void CPropertyTable::UnlockSlot(PROPTABLE_SLOT* pSlot)
+{
+    AtomicStore(&pSlot->m_uSeq, pSlot->m_uSeq+1);
+}
+
+int CPropertyTable::Set(const void* pName, size_t uNameSize, const void* pValue, size_t uValueSize)
+{
+    if(m_pHeader==NULL)
+        return PROPTABLE_ERR_FULL;
+
+    if(uNameSize>PROPTABLE_MAX_NAME_SIZE)
+        return PROPTABLE_ERR_TOO_LONG;
+
+    uint32_t uHash = Hash(pName, uNameSize);
+    uint32_t uIndex = uHash&(PROPTABLE_SLOT_COUNT-1);
+    int nProbe;
+
+    // Linear probing. A slot's hash is set once, so slots of other names are skipped
+    // without locking them.
+    for(nProbe=0; nProbe<PROPTABLE_SLOT_COUNT; nProbe++)
+    {
+        PROPTABLE_SLOT* pSlot = &m_pSlots[(uIndex+nProbe)&(PROPTABLE_SLOT_COUNT-1)];
+        uint32_t uSlotHash = AtomicLoad(&pSlot->m_uHash);
+        if(uSlotHash!=0 && uSlotHash!=uHash)
+            continue;
+
+        LockSlot(pSlot);
+
+        // Another writer may have taken the free slot meanwhile
+        if(pSlot->m_uHash==0)
+        {
+            pSlot->m_uHash = uHash;
+            pSlot->m_uNameSize = (uint16_t)uNameSize;
+            memcpy(pSlot->m_auchName, pName, uNameSize);
+        }
+        else if(pSlot->m_uHash!=uHash || pSlot->m_uNameSize!=uNameSize ||
+            memcmp(pSlot->m_auchName, pName, uNameSize)!=0)
+        {
+            UnlockSlot(pSlot);
+            continue;
+        }
+
+        int nResult = PROPTABLE_OK;
+        if(uValueSize<=PROPTABLE_MAX_VALUE_SIZE)
+        {
+            pSlot->m_uValueSize = (uint16_t)uValueSize;
+            memcpy(pSlot->m_auchValue, pValue, uValueSize);
+        }
+        else
+        {
+            pSlot->m_uValueSize = PROPTABLE_VALUE_MOVED;
+            nResult = PROPTABLE_ERR_TOO_LONG;
+        }
+
+        UnlockSlot(pSlot);
+        return nResult;
+    }
+
+    return PROPTABLE_ERR_FULL;
+}
+
+int CPropertyTable::Read(int nSlot, std::string& sName, std::string& sValue) const
+{
+    if(m_pHeader==NULL || nSlot<0 || nSlot>=PROPTABLE_SLOT_COUNT)
+        return PROPTABLE_ERR_EMPTY;
+
+    PROPTABLE_SLOT* pSlot = &m_pSlots[nSlot];
+    char szName[PROPTABLE_MAX_NAME_SIZE];
+    char szValue[PROPTABLE_MAX_VALUE_SIZE];
+    int nRetry;
+
+    for(nRetry=0; nRetry<PROPTABLE_READ_RETRIES; nRetry++)
+    {
+        uint32_t uSeq = AtomicLoad(&pSlot->m_uSeq);
+        if((uSeq&1)!=0)
+        {
+            SpinPause();
+            continue;
+        }
+
+        uint32_t uHash = pSlot->m_uHash;
+        size_t uNameSize = pSlot->m_uNameSize;
+        size_t uValueSize = pSlot->m_uValueSize;
+
+        // The sizes may be torn by a concurrent write, check them before copying
+        bool bValid = uNameSize<=PROPTABLE_MAX_NAME_SIZE &&
+            (uValueSize<=PROPTABLE_MAX_VALUE_SIZE || uValueSize==PROPTABLE_VALUE_MOVED);
+        if(bValid && uHash!=0 && uValueSize!=PROPTABLE_VALUE_MOVED)
+        {
+            memcpy(szName, pSlot->m_auchName, uNameSize);
+            memcpy(szValue, pSlot->m_auchValue, uValueSize);
+        }
+
+        AtomicFence();
+        if(AtomicLoad(&pSlot->m_uSeq)!=uSeq)
+            continue;
+
+        if(!bValid || uHash==0 || uValueSize==PROPTABLE_VALUE_MOVED)
+            return PROPTABLE_ERR_EMPTY;
+
+        sName.assign(szName, uNameSize);
+        sValue.assign(szValue, uValueSize);
+        return PROPTABLE_OK;
+    }
+
+    return PROPTABLE_ERR_BUSY;
+}
@@ -0,0 +1,122 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: PropertyTable.h
+// Description: Fixed-capacity hash table of custom properties placed in shared memory.
+// A property keeps its slot, so updating a value overwrites it in place instead of
+// appending a new record. Each slot is guarded by a sequence lock: the writer makes the
+// sequence number odd while it changes the slot, the reader copies the slot and retries
+// if the number was odd or has changed.
+
+#pragma once
+#include <string>
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int8  uint8_t;
+typedef unsigned __int16 uint16_t;
+typedef unsigned __int32 uint32_t;
+#else
+#include <stdint.h>
+#endif
+
+// Number of slots (a power of two)
+#define PROPTABLE_SLOT_COUNT 256
+
+// Maximum size of a property name and value in bytes
+#define PROPTABLE_MAX_NAME_SIZE 256
+#define PROPTABLE_MAX_VALUE_SIZE 1024
+
+// Value size of a property whose value didn't fit into the slot and is stored elsewhere
+#define PROPTABLE_VALUE_MOVED 0xFFFF
+
+// How many times the reader retries a slot being written
+#define PROPTABLE_READ_RETRIES 100000
+
+// Error codes returned by CPropertyTable methods
+enum PropertyTableError
+{
+    PROPTABLE_OK = 0,            // Success
+    PROPTABLE_ERR_TOO_LONG = 1,  // Name or value is too long for a slot
+    PROPTABLE_ERR_FULL = 2,      // No free slot
+    PROPTABLE_ERR_EMPTY = 3,     // The slot has no value
+    PROPTABLE_ERR_BUSY = 4       // The slot is being written (the writer may have crashed)
+};
+
+// Table header
+struct PROPTABLE_HEADER
+{
+    uint8_t m_uchMagic[4];     // Magic sequence "PTB1"
+    uint32_t m_uSlotCount;     // Number of slots
+    uint32_t m_uSlotSize;      // sizeof(PROPTABLE_SLOT)
+    uint32_t m_uReserved;
+};
+
+// Table slot
+struct PROPTABLE_SLOT
+{
+    volatile uint32_t m_uSeq;  // Sequence number, odd while the slot is being written
+    uint32_t m_uHash;          // Hash of the name, 0 if the slot is free. Never changes once set.
+    uint16_t m_uNameSize;      // Name size in bytes
+    uint16_t m_uValueSize;     // Value size in bytes, or PROPTABLE_VALUE_MOVED
+    uint8_t m_auchName[PROPTABLE_MAX_NAME_SIZE];   // Name
+    uint8_t m_auchValue[PROPTABLE_MAX_VALUE_SIZE]; // Value
+};
+
+// class CPropertyTable
+// Accesses a property table in a memory region it doesn't own. Names and values are
+// byte strings (CrashRpt stores TCHAR strings). Set() may be called from several threads
+// and processes; a writer only waits for another writer of the same slot.
+class CPropertyTable
+{
+public:
+
+    CPropertyTable();
+
+    // Returns the size of memory needed for the table
+    static size_t GetRequiredSize();
+
+    // Formats the memory region (at least GetRequiredSize() bytes) as an empty table
+    void Init(void* pMem);
+
+    // Attaches to a table formatted by another process. Returns false if the region
+    // doesn't contain a valid table.
+    bool Attach(void* pMem, size_t uSize);
+
+    // Detaches from the memory region
+    void Detach();
+
+    // Returns true if attached to a table
+    bool IsAttached() const;
+
+    // Adds or updates the property. If the value is too long for a slot, the slot is
+    // marked as moved and PROPTABLE_ERR_TOO_LONG is returned; the caller stores the
+    // value elsewhere.
+    int Set(const void* pName, size_t uNameSize, const void* pValue, size_t uValueSize);
+
+    // Reads the property from the slot
+    int Read(int nSlot, std::string& sName, std::string& sValue) const;
+
+    // Returns the number of slots
+    int GetSlotCount() const;
+
+private:
+
+    // Returns the hash of the name, never 0
+    static uint32_t Hash(const void* pName, size_t uNameSize);
+
+    // Takes the write lock of the slot
+    static void LockSlot(PROPTABLE_SLOT* pSlot);
+
+    // Releases the write lock, making the new contents visible
+    static void UnlockSlot(PROPTABLE_SLOT* pSlot);
+
+    PROPTABLE_HEADER* m_pHeader; // Table header, or NULL
+    PROPTABLE_SLOT* m_pSlots;    // Slots
+};
@@ -30,6 +30,7 @@ struct STRING_DESC
   BYTE m_uchMagic[3]; // Magic sequence "STR".
   WORD m_wSize;       // Total bytes occupied by this block.
   // This structure is followed by (m_wSize-sizeof(STRING_DESC) bytes of string data.
+  // The data may be padded with zeros to leave room for a longer string.
 };
 
 // File item entry.
@@ -42,6 +43,7 @@ struct FILE_ITEM
   DWORD m_dwDescriptionOffs; // File description.
   BOOL  m_bMakeCopy;         // Should we make a copy of this file on crash?
   BOOL  m_bAllowDelete;      // Should allow user to delete the file from crash report?
+  BOOL  m_bSnapshot;         // Should we take a snapshot of this file instead of a copy?
 };
 
 // Registry key entry.
@@ -119,10 +121,18 @@ struct CRASH_DESCRIPTION
   SIZE  m_DesiredFrameSize;      // Video frame size.
   HWND m_hWndVideoParent;        // Parent window for video recording dialog.
   BOOL m_bClientAppCrashed;      // If TRUE, the client app has crashed; otherwise the client has exited without crash.
+  DWORD m_dwPropTableOffs;       // Offset of custom property table (see PropertyTable.h), or 0.
+  DWORD m_dwBreadcrumbsNameOffs; // Offset of the name of breadcrumb log file mapping (see BreadcrumbLog.h), or 0.
 };
 
 #define SHARED_MEM_MAX_SIZE 10*1024*1024   /* 10 MB */
 
+// Custom property table is placed at the end of shared memory, after the space used by blocks
+#define SHARED_MEM_PROP_TABLE_OFFS (SHARED_MEM_MAX_SIZE-512*1024)
+
+// Maximum size of string data in a string block (block size is a WORD)
+#define SHARED_MEM_MAX_STRING_SIZE ((0xFFFF-sizeof(STRING_DESC))&~3)
+
 // Used to share memory between CrashRpt.dll and CrashSender.exe
 class CSharedMem
 {
@@ -20,12 +20,16 @@ AsyncNotification::AsyncNotification()
     m_hFeedbackEvent = CreateEvent(0, FALSE, FALSE, 0);
     // Init handle to log file
     m_fileLog = NULL;
+    m_pParent = NULL;
     Reset();
 }
 
 AsyncNotification::~AsyncNotification()
 {
   CloseLogFile();
+  CloseHandle(m_hCompletionEvent);
+  CloseHandle(m_hCancelEvent);
+  CloseHandle(m_hFeedbackEvent);
 }
 
 void AsyncNotification::CloseLogFile()
@@ -73,6 +77,10 @@ void AsyncNotification::Reset()
 
 void AsyncNotification::SetProgress(const WTL::CString& sStatusMsg, int percentCompleted, bool bRelative)
 {
+    // Forward the message (but not the progress) to the parent
+    if(m_pParent!=NULL)
+        m_pParent->SetProgress(m_sParentPrefix + sStatusMsg, 0);
+
     m_cs.Lock(); // Acquire lock
 
     m_statusLog.push_back(sStatusMsg);
@@ -170,6 +178,10 @@ bool AsyncNotification::IsCancelled()
         return true;
     }
 
+    // The parent operation was cancelled
+    if(m_pParent!=NULL && m_pParent->IsCancelled())
+        return true;
+
     return false;
 }
 
@@ -190,4 +202,12 @@ void AsyncNotification::FeedbackReady(int code)
     m_nCompletionStatus = code;
     m_cs.Unlock();
     SetEvent(m_hFeedbackEvent);
-}
+}
+
+void AsyncNotification::SetParent(AsyncNotification* pParent, LPCTSTR szPrefix)
+{
+    m_cs.Lock();
+    m_pParent = pParent;
+    m_sParentPrefix = szPrefix;
+    m_cs.Unlock();
+}
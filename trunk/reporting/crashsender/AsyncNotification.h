@@ -56,6 +56,11 @@ struct AsyncNotification
     // Notifies about feedback is ready to be received
     void FeedbackReady(int code);
 
+    // Makes this object forward its status messages to another one (prefixed with
+    // szPrefix) and treat cancellation of the other one as its own. Used when
+    // several operations run at once on behalf of a single operation.
+    void SetParent(AsyncNotification* pParent, LPCTSTR szPrefix);
+
 private:
     ATL::CComAutoCriticalSection m_cs; // Protects internal state
     int m_nCompletionStatus;      // Completion status of the assync operation
@@ -66,4 +71,6 @@ private:
     std::vector<WTL::CString> m_statusLog; // Status log
     WTL::CString m_sLogFile;
     FILE* m_fileLog;	
+    AsyncNotification* m_pParent; // Object to forward messages to
+    WTL::CString m_sParentPrefix; // Prefix of forwarded messages
 };
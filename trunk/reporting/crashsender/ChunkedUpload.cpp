@@ -0,0 +1,251 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "ChunkedUpload.h"
+#include "ThreadSync.h"
+#include <string.h>
+#include <vector>
+
+CChunkedUpload::CChunkedUpload()
+{
+    m_uChunkSize = CHUNKED_UPLOAD_DEFAULT_CHUNK_SIZE;
+    m_nMaxRetries = CHUNKED_UPLOAD_DEFAULT_RETRIES;
+    m_uRetryDelay = CHUNKED_UPLOAD_DEFAULT_RETRY_DELAY;
+    m_uTotalSize = 0;
+    m_pfnTransport = NULL;
+    m_pParam = NULL;
+    m_uResumeOffset = 0;
+    m_uBytesSent = 0;
+    m_nRequests = 0;
+}
+
+void CChunkedUpload::SetChunkSize(size_t uChunkSize)
+{
+    if(uChunkSize!=0)
+        m_uChunkSize = uChunkSize;
+}
+
+void CChunkedUpload::SetMaxRetries(int nMaxRetries)
+{
+    if(nMaxRetries>0)
+        m_nMaxRetries = nMaxRetries;
+}
+
+void CChunkedUpload::SetRetryDelay(unsigned uDelayMs)
+{
+    m_uRetryDelay = uDelayMs;
+}
+
+int CChunkedUpload::Upload(
+    const std::string& sUploadId,
+    uint64_t uTotalSize,
+    PFNCHUNKREAD pfnRead,
+    PFNCHUNKTRANSPORT pfnTransport,
+    void* pParam)
+{
+    std::vector<unsigned char> aChunk;
+    ChunkResponse Response;
+    uint64_t uOffset = 0;
+    uint64_t uStored = 0;
+    bool bHasOffset = false;
+    bool bKnowOffset = false;
+    int nFailures = 0;
+    int nStatus = 0;
+    int nResult = 0;
+
+    m_sUploadId = sUploadId;
+    m_uTotalSize = uTotalSize;
+    m_pfnTransport = pfnTransport;
+    m_pParam = pParam;
+    m_uResumeOffset = 0;
+    m_uBytesSent = 0;
+    m_nRequests = 0;
+
+    // Find out if the server supports chunked upload and what it has already stored
+    for(;;)
+    {
+        nResult = SendRequest("query", 0, NULL, 0, Response);
+        if(nResult==CHUNK_CANCELLED)
+            return CHUNKED_ERR_CANCELLED;
+        if(nResult==CHUNK_SENT)
+            break;
+        if(!OnFailure(nFailures))
+            return CHUNKED_ERR_TRANSPORT;
+    }
+
+    GetResponseStatus(Response, nStatus, bHasOffset, uOffset);
+    if(nStatus!=200 || !bHasOffset || uOffset>uTotalSize)
+        return CHUNKED_ERR_UNSUPPORTED;
+
+    m_uResumeOffset = uOffset;
+    uStored = uOffset;
+    bKnowOffset = true;
+    nFailures = 0;
+
+    aChunk.resize(m_uChunkSize);
+
+    while(uOffset<uTotalSize || !bKnowOffset)
+    {
+        if(!bKnowOffset)
+        {
+            // The last request failed; what was stored is unknown
+            nResult = SendRequest("query", 0, NULL, 0, Response);
+        }
+        else
+        {
+            size_t uSize = m_uChunkSize;
+            if(uTotalSize-uOffset<uSize)
+                uSize = (size_t)(uTotalSize-uOffset);
+
+            if(!pfnRead(uOffset, &aChunk[0], uSize, pParam))
+                return CHUNKED_ERR_READ;
+
+            nResult = SendRequest("chunk", uOffset, &aChunk[0], uSize, Response);
+            if(nResult==CHUNK_SENT)
+                m_uBytesSent += uSize;
+        }
+
+        if(nResult==CHUNK_CANCELLED)
+            return CHUNKED_ERR_CANCELLED;
+
+        if(nResult==CHUNK_SENT)
+        {
+            bool bQuery = !bKnowOffset;
+            GetResponseStatus(Response, nStatus, bHasOffset, uOffset);
+            if(nStatus==200 && bHasOffset && uOffset<=uTotalSize)
+            {
+                // Continue from the offset the server has (it may differ from the
+                // one requested if an earlier response was lost)
+                bKnowOffset = true;
+                if(uOffset>uStored)
+                {
+                    uStored = uOffset;
+                    nFailures = 0;
+                }
+                else if(!bQuery && !OnFailure(nFailures))
+                {
+                    // The server keeps answering chunks without storing them
+                    return CHUNKED_ERR_TRANSPORT;
+                }
+                continue;
+            }
+            if(nStatus>=400 && nStatus<500)
+                return CHUNKED_ERR_REJECTED; // The server won't accept this upload
+        }
+
+        // Retry from the offset stored by the server
+        bKnowOffset = false;
+        if(!OnFailure(nFailures))
+            return CHUNKED_ERR_TRANSPORT;
+    }
+
+    // All data are stored, assemble the file
+    nFailures = 0;
+    for(;;)
+    {
+        nResult = SendRequest("commit", uTotalSize, NULL, 0, Response);
+        if(nResult==CHUNK_CANCELLED)
+            return CHUNKED_ERR_CANCELLED;
+        if(nResult==CHUNK_SENT)
+            break;
+        if(!OnFailure(nFailures))
+            return CHUNKED_ERR_TRANSPORT;
+    }
+
+    GetResponseStatus(Response, nStatus, bHasOffset, uOffset);
+    if(nStatus!=200)
+        return CHUNKED_ERR_REJECTED;
+
+    return CHUNKED_OK;
+}
+
+uint64_t CChunkedUpload::GetResumeOffset() const
+{
+    return m_uResumeOffset;
+}
+
+uint64_t CChunkedUpload::GetBytesSent() const
+{
+    return m_uBytesSent;
+}
+
+int CChunkedUpload::GetRequestCount() const
+{
+    return m_nRequests;
+}
+
+bool CChunkedUpload::ParseResponse(const std::string& sBody, int& nStatus, bool& bHasOffset, uint64_t& uOffset)
+{
+    nStatus = 0;
+    bHasOffset = false;
+    uOffset = 0;
+
+    size_t i = 0;
+    if(sBody.empty() || sBody[0]<'0' || sBody[0]>'9')
+        return false;
+
+    for(i=0; i<sBody.length() && sBody[i]>='0' && sBody[i]<='9' && i<4; i++)
+        nStatus = nStatus*10 + (sBody[i]-'0');
+
+    size_t uPos = sBody.find("offset=");
+    if(uPos!=std::string::npos)
+    {
+        uPos += 7;
+        for(i=uPos; i<sBody.length() && sBody[i]>='0' && sBody[i]<='9'; i++)
+            uOffset = uOffset*10 + (sBody[i]-'0');
+        bHasOffset = i>uPos;
+    }
+
+    return true;
+}
+
+int CChunkedUpload::SendRequest(const char* szAction, uint64_t uOffset,
+    const unsigned char* pData, size_t uDataSize, ChunkResponse& Response)
+{
+    ChunkRequest Request;
+    Request.m_szAction = szAction;
+    Request.m_sUploadId = m_sUploadId;
+    Request.m_uTotalSize = m_uTotalSize;
+    Request.m_uOffset = uOffset;
+    Request.m_pData = pData;
+    Request.m_uDataSize = uDataSize;
+
+    Response.m_nHttpStatus = 0;
+    Response.m_sBody.clear();
+
+    m_nRequests++;
+    return m_pfnTransport(Request, Response, m_pParam);
+}
+
+bool CChunkedUpload::OnFailure(int& nFailures)
+{
+    if(++nFailures>=m_nMaxRetries)
+        return false;
+
+    // Exponential backoff
+    unsigned uDelay = m_uRetryDelay;
+    int i;
+    for(i=1; i<nFailures && uDelay<CHUNKED_UPLOAD_MAX_RETRY_DELAY; i++)
+        uDelay *= 2;
+    if(uDelay>CHUNKED_UPLOAD_MAX_RETRY_DELAY)
+        uDelay = CHUNKED_UPLOAD_MAX_RETRY_DELAY;
+    if(uDelay!=0)
+        CSyncThread::Sleep(uDelay);
+
+    return true;
+}
+
+void CChunkedUpload::GetResponseStatus(const ChunkResponse& Response, int& nStatus, bool& bHasOffset, uint64_t& uOffset)
+{
+    // As with the single-request upload, the status is taken from the response body
+    // if it starts with a digit, else from the HTTP response code
+    if(!ParseResponse(Response.m_sBody, nStatus, bHasOffset, uOffset))
+        nStatus = Response.m_nHttpStatus;
+}
@@ -0,0 +1,150 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: ChunkedUpload.h
+// Description: Resumable upload of a large file in fixed-size chunks. The protocol
+// logic is independent of the HTTP implementation, which is provided as a callback.
+//
+// Every request is a form POST to the usual crash report URL with a 'chunkaction'
+// field, the upload ID and the total file size:
+//   query  - asks for the number of bytes already stored by the server;
+//   chunk  - sends the bytes at the given 'offset' as the 'chunk' file attachment;
+//   commit - asks to assemble the file, it also carries the usual report fields.
+// The server responds with a body starting with a status code, query and chunk
+// responses contain 'offset=<bytes stored>', e.g. "200 offset=1048576". A server that
+// doesn't answer a query this way doesn't support chunked upload.
+
+#pragma once
+#include <stddef.h>
+#include <string>
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// Default size of a chunk
+#define CHUNKED_UPLOAD_DEFAULT_CHUNK_SIZE (1024*1024)
+
+// Default number of failed requests in a row before the upload is abandoned
+#define CHUNKED_UPLOAD_DEFAULT_RETRIES 5
+
+// Default delay before the first retry, in milliseconds. The delay is doubled
+// with each failure in a row, up to CHUNKED_UPLOAD_MAX_RETRY_DELAY.
+#define CHUNKED_UPLOAD_DEFAULT_RETRY_DELAY 500
+#define CHUNKED_UPLOAD_MAX_RETRY_DELAY 8000
+
+// Error codes returned by CChunkedUpload::Upload()
+enum ChunkedUploadError
+{
+    CHUNKED_OK = 0,               // The file was uploaded and committed
+    CHUNKED_ERR_UNSUPPORTED = 1,  // The server doesn't support chunked upload
+    CHUNKED_ERR_READ = 2,         // The read callback failed
+    CHUNKED_ERR_TRANSPORT = 3,    // Requests failed too many times in a row
+    CHUNKED_ERR_REJECTED = 4,     // The server refused the upload (e.g. hash mismatch)
+    CHUNKED_ERR_CANCELLED = 5     // The transport callback cancelled the upload
+};
+
+// Result of the transport callback
+enum ChunkTransportResult
+{
+    CHUNK_SENT = 0,               // The response was received
+    CHUNK_NOT_SENT = 1,           // Connection error, the request may be retried
+    CHUNK_CANCELLED = 2           // The upload should be stopped
+};
+
+// Request to the server
+struct ChunkRequest
+{
+    const char* m_szAction;       // "query", "chunk" or "commit"
+    std::string m_sUploadId;      // Upload ID
+    uint64_t m_uTotalSize;        // Size of the file
+    uint64_t m_uOffset;           // Offset of the chunk (chunk requests only)
+    const unsigned char* m_pData; // Chunk data (chunk requests only)
+    size_t m_uDataSize;           // Chunk size
+};
+
+// Response of the server
+struct ChunkResponse
+{
+    int m_nHttpStatus;            // HTTP response code
+    std::string m_sBody;          // Response body
+};
+
+// Reads uSize bytes at uOffset of the file being uploaded. Returns false on error.
+typedef bool (*PFNCHUNKREAD)(uint64_t uOffset, void* pBuf, size_t uSize, void* pParam);
+
+// Sends the request and receives the response. Returns ChunkTransportResult.
+typedef int (*PFNCHUNKTRANSPORT)(const ChunkRequest& Request, ChunkResponse& Response, void* pParam);
+
+// class CChunkedUpload
+// Uploads a file in chunks. After a failed request the stored offset is queried again
+// and the upload resumes from there, so a dropped connection costs at most one chunk.
+// A chunk the server answers without storing more data counts as a failed request.
+// The upload may also be resumed by another process, given the same upload ID.
+class CChunkedUpload
+{
+public:
+
+    CChunkedUpload();
+
+    // Sets the chunk size and the number of failed requests in a row to tolerate.
+    void SetChunkSize(size_t uChunkSize);
+    void SetMaxRetries(int nMaxRetries);
+
+    // Sets the delay before the first retry, in milliseconds (0 means no delay).
+    void SetRetryDelay(unsigned uDelayMs);
+
+    // Uploads the file. The upload ID must identify the file contents.
+    int Upload(
+        const std::string& sUploadId,
+        uint64_t uTotalSize,
+        PFNCHUNKREAD pfnRead,
+        PFNCHUNKTRANSPORT pfnTransport,
+        void* pParam);
+
+    // Returns the offset the server had already stored when the upload started
+    uint64_t GetResumeOffset() const;
+
+    // Returns the number of file bytes sent in chunk requests
+    uint64_t GetBytesSent() const;
+
+    // Returns the number of requests made
+    int GetRequestCount() const;
+
+    // Parses the response body. Returns false if it doesn't start with a status code;
+    // bHasOffset is set if the body contains 'offset=<number>'.
+    static bool ParseResponse(const std::string& sBody, int& nStatus, bool& bHasOffset, uint64_t& uOffset);
+
+private:
+
+    // Makes a request, returns ChunkTransportResult
+    int SendRequest(const char* szAction, uint64_t uOffset, const unsigned char* pData,
+        size_t uDataSize, ChunkResponse& Response);
+
+    // Gets the status code and the offset from the response
+    static void GetResponseStatus(const ChunkResponse& Response, int& nStatus, bool& bHasOffset, uint64_t& uOffset);
+
+    // Counts a failed request and waits before the retry. Returns false if the
+    // number of failures in a row has reached the limit.
+    bool OnFailure(int& nFailures);
+
+    size_t m_uChunkSize;           // Chunk size
+    int m_nMaxRetries;             // Failed requests in a row to tolerate
+    unsigned m_uRetryDelay;        // Delay before the first retry, in milliseconds
+    std::string m_sUploadId;       // Current upload ID
+    uint64_t m_uTotalSize;         // Current file size
+    PFNCHUNKTRANSPORT m_pfnTransport; // Transport callback
+    void* m_pParam;                // Callback parameter
+    uint64_t m_uResumeOffset;      // Offset stored when the upload started
+    uint64_t m_uBytesSent;         // Number of bytes sent
+    int m_nRequests;               // Number of requests made
+};
@@ -0,0 +1,205 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "CompressionPolicy.h"
+#include <string.h>
+#include <math.h>
+
+// Files up to this size are compressed with the best level
+#define CPOLICY_SMALL_FILE ((uint64_t)1024*1024)
+
+// Files up to this size are compressed with the default level
+#define CPOLICY_MEDIUM_FILE ((uint64_t)64*1024*1024)
+
+// Files up to this size are compressed with a fast level, larger ones with the fastest
+#define CPOLICY_LARGE_FILE ((uint64_t)512*1024*1024)
+
+// Extensions of already compressed formats
+static const char* s_aszCompressedExt[] =
+{
+    "png", "jpg", "jpeg", "gif", "webp", "ogg", "ogv", "oga", "webm", "mkv", "mp3", "mp4",
+    "zip", "gz", "tgz", "bz2", "xz", "7z", "rar", "cab", "lzma", "zst", "jar", "docx",
+    "xlsx", "pptx", NULL
+};
+
+// Extensions of formats known to compress well
+static const char* s_aszCompressibleExt[] =
+{
+    "dmp", "mdmp", "xml", "txt", "log", "ini", "csv", "json", "htm", "html", "reg", "rtf",
+    "bmp", NULL
+};
+
+// Signature of a compressed format
+struct FileSignature
+{
+    const char* m_pData;
+    size_t m_uSize;
+};
+
+static const FileSignature s_aSignatures[] =
+{
+    {"\x89PNG", 4},                  // PNG
+    {"\xFF\xD8\xFF", 3},             // JPEG
+    {"GIF8", 4},                     // GIF
+    {"OggS", 4},                     // Ogg
+    {"\x1A\x45\xDF\xA3", 4},         // Matroska, WebM
+    {"PK\x03\x04", 4},               // ZIP
+    {"\x1F\x8B", 2},                 // gzip
+    {"BZh", 3},                      // bzip2
+    {"\xFD" "7zXZ", 5},              // xz
+    {"7z\xBC\xAF\x27\x1C", 6},       // 7-Zip
+    {"Rar!", 4},                     // RAR
+    {"MSCF", 4},                     // CAB
+    {"\x28\xB5\x2F\xFD", 4},         // Zstandard
+    {NULL, 0}
+};
+
+// Checks if the name has one of the extensions
+static bool HasExtension(const char* szFileName, const char** aszExt)
+{
+    const char* szExt = strrchr(szFileName, '.');
+    if(szExt==NULL || strchr(szExt, '/')!=NULL || strchr(szExt, '\\')!=NULL)
+        return false;
+    szExt++;
+
+    int i;
+    for(i=0; aszExt[i]!=NULL; i++)
+    {
+        const char* p = szExt;
+        const char* q = aszExt[i];
+        while(*p!=0 && *q!=0)
+        {
+            char c = *p;
+            if(c>='A' && c<='Z')
+                c = (char)(c-'A'+'a');
+            if(c!=*q)
+                break;
+            p++;
+            q++;
+        }
+
+        if(*p==0 && *q==0)
+            return true;
+    }
+
+    return false;
+}
+
+int CCompressionPolicy::ClassifyByName(const char* szFileName)
+{
+    if(szFileName==NULL)
+        return CPOLICY_CLASS_UNKNOWN;
+
+    if(HasExtension(szFileName, s_aszCompressedExt))
+        return CPOLICY_CLASS_COMPRESSED;
+
+    if(HasExtension(szFileName, s_aszCompressibleExt))
+        return CPOLICY_CLASS_COMPRESSIBLE;
+
+    return CPOLICY_CLASS_UNKNOWN;
+}
+
+int CCompressionPolicy::ClassifyBySignature(const unsigned char* pData, size_t uSize)
+{
+    int i;
+    for(i=0; s_aSignatures[i].m_pData!=NULL; i++)
+    {
+        if(uSize>=s_aSignatures[i].m_uSize &&
+            memcmp(pData, s_aSignatures[i].m_pData, s_aSignatures[i].m_uSize)==0)
+            return CPOLICY_CLASS_COMPRESSED;
+    }
+
+    return CPOLICY_CLASS_UNKNOWN;
+}
+
+double CCompressionPolicy::CalcEntropy(const unsigned char* pData, size_t uSize)
+{
+    size_t auCount[256];
+    double dEntropy = 0;
+    size_t i;
+
+    if(uSize==0)
+        return 0;
+
+    memset(auCount, 0, sizeof(auCount));
+    for(i=0; i<uSize; i++)
+        auCount[pData[i]]++;
+
+    for(i=0; i<256; i++)
+    {
+        if(auCount[i]!=0)
+        {
+            double p = (double)auCount[i]/uSize;
+            dEntropy -= p*log(p);
+        }
+    }
+
+    // Natural logarithm to bits
+    return dEntropy/log(2.0);
+}
+
+void CCompressionPolicy::GetSampleOffsets(uint64_t uFileSize, std::vector<uint64_t>& aOffsets)
+{
+    aOffsets.clear();
+
+    // A small file is read whole
+    if(uFileSize<=(uint64_t)CPOLICY_SAMPLE_SIZE*CPOLICY_MAX_SAMPLES)
+    {
+        uint64_t uOffset;
+        for(uOffset=0; uOffset<uFileSize; uOffset+=CPOLICY_SAMPLE_SIZE)
+            aOffsets.push_back(uOffset);
+        return;
+    }
+
+    // The first sample is at the beginning, the last one at the end of the file
+    uint64_t uLastOffset = uFileSize-CPOLICY_SAMPLE_SIZE;
+    int i;
+    for(i=0; i<CPOLICY_MAX_SAMPLES; i++)
+        aOffsets.push_back(uLastOffset/(CPOLICY_MAX_SAMPLES-1)*i);
+    aOffsets[CPOLICY_MAX_SAMPLES-1] = uLastOffset;
+}
+
+int CCompressionPolicy::GetDeflateLevel(uint64_t uFileSize)
+{
+    if(uFileSize<=CPOLICY_SMALL_FILE)
+        return 9;
+    if(uFileSize<=CPOLICY_MEDIUM_FILE)
+        return 6;
+    if(uFileSize<=CPOLICY_LARGE_FILE)
+        return 3;
+    return 1;
+}
+
+void CCompressionPolicy::Choose(const char* szFileName, uint64_t uFileSize,
+    const unsigned char* pSamples, size_t uSamplesSize, int& nMethod, int& nLevel)
+{
+    int nClass = ClassifyByName(szFileName);
+
+    if(nClass==CPOLICY_CLASS_UNKNOWN && pSamples!=NULL)
+    {
+        nClass = ClassifyBySignature(pSamples, uSamplesSize);
+
+        // Unknown data that look random won't shrink
+        if(nClass==CPOLICY_CLASS_UNKNOWN && uSamplesSize!=0 &&
+            CalcEntropy(pSamples, uSamplesSize)>CPOLICY_MAX_ENTROPY)
+            nClass = CPOLICY_CLASS_COMPRESSED;
+    }
+
+    // There is nothing to compress in an empty file
+    if(nClass==CPOLICY_CLASS_COMPRESSED || uFileSize==0)
+    {
+        nMethod = CPOLICY_METHOD_STORE;
+        nLevel = 0;
+        return;
+    }
+
+    nMethod = CPOLICY_METHOD_DEFLATE;
+    nLevel = GetDeflateLevel(uFileSize);
+}
@@ -0,0 +1,78 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: CompressionPolicy.h
+// Description: Chooses how each file is put into the report archive. Files that are
+// already compressed (screenshots, video, archives) are stored as is, files of unknown
+// type are classified by their signature and by the entropy of a few samples, and the
+// deflate level of the rest depends on the file size, so that multi-gigabyte memory
+// dumps are compressed with a faster level.
+
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// ZIP compression methods
+#define CPOLICY_METHOD_STORE   0  // Stored without compression
+#define CPOLICY_METHOD_DEFLATE 8  // Deflated (the same as Z_DEFLATED)
+
+// Size of a data sample used to estimate entropy
+#define CPOLICY_SAMPLE_SIZE (16*1024)
+
+// Maximum number of samples taken from a file
+#define CPOLICY_MAX_SAMPLES 4
+
+// Order-0 entropy (bits per byte) above which data are considered incompressible
+#define CPOLICY_MAX_ENTROPY 7.9
+
+// File classes
+enum CompressionClass
+{
+    CPOLICY_CLASS_UNKNOWN = 0,      // Data must be sampled
+    CPOLICY_CLASS_COMPRESSED = 1,   // Already compressed, store as is
+    CPOLICY_CLASS_COMPRESSIBLE = 2  // Compresses well, deflate
+};
+
+// class CCompressionPolicy
+// Set of functions deciding on the compression method and level of an archive entry.
+class CCompressionPolicy
+{
+public:
+
+    // Classifies the file by its extension (case insensitive)
+    static int ClassifyByName(const char* szFileName);
+
+    // Classifies the data by the signature at their beginning. Returns
+    // CPOLICY_CLASS_COMPRESSED for known compressed formats, otherwise CPOLICY_CLASS_UNKNOWN.
+    static int ClassifyBySignature(const unsigned char* pData, size_t uSize);
+
+    // Returns order-0 entropy of the data in bits per byte (0 to 8)
+    static double CalcEntropy(const unsigned char* pData, size_t uSize);
+
+    // Returns offsets of the samples to read from a file of the given size. The samples are
+    // CPOLICY_SAMPLE_SIZE bytes long (the last one may be shorter) and spread evenly over
+    // the file, the first one is at the beginning of the file.
+    static void GetSampleOffsets(uint64_t uFileSize, std::vector<uint64_t>& aOffsets);
+
+    // Returns the deflate level for a file of the given size
+    static int GetDeflateLevel(uint64_t uFileSize);
+
+    // Chooses the compression method and level of the file. The samples are the data read
+    // at GetSampleOffsets() joined together; they are not needed (and may be NULL) if the
+    // file is classified by its name.
+    static void Choose(const char* szFileName, uint64_t uFileSize,
+        const unsigned char* pSamples, size_t uSamplesSize, int& nMethod, int& nLevel);
+};
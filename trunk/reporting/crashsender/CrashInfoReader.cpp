@@ -20,6 +20,22 @@ be found in the Authors.txt file in the root of the source tree.
 #include "tinyxml.h"
 #include "Utility.h"
 #include "SharedMem.h"
+#include "PropertyTable.h"
+#include "BreadcrumbLog.h"
+#include "XmlStream.h"
+
+// Returns the last write time of a folder. The time changes when files are
+// added to or removed from the folder.
+static BOOL GetFolderWriteTime(LPCTSTR szFolder, ULONG64& uTime)
+{
+  WIN32_FILE_ATTRIBUTE_DATA fad;
+  if(!GetFileAttributesEx(szFolder, GetFileExInfoStandard, &fad) ||
+    (fad.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY)==0)
+    return FALSE;
+
+  uTime = ((ULONG64)fad.ftLastWriteTime.dwHighDateTime<<32)|fad.ftLastWriteTime.dwLowDateTime;
+  return TRUE;
+}
 
 BOOL ERIFileItem::GetFileInfo(HICON& hIcon, WTL::CString& sTypeName, LONGLONG& lSize)
 {
@@ -29,9 +45,10 @@ BOOL ERIFileItem::GetFileInfo(HICON& hIcon, WTL::CString& sTypeName, LONGLONG& l
   SHFILEINFO sfi;
   HANDLE hFile = INVALID_HANDLE_VALUE;
 
-  // Open file for reading
+  // Open file for reading. The application may still be writing to a snapshot.
   hFile = CreateFile(m_sSrcFile, 
-    GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, NULL, NULL); 
+    GENERIC_READ, m_lSnapshotSize>=0 ? FILE_SHARE_READ|FILE_SHARE_WRITE : FILE_SHARE_READ, 
+    NULL, OPEN_EXISTING, NULL, NULL); 
   if(hFile==INVALID_HANDLE_VALUE)
     return FALSE; // Error - file may not exist
 
@@ -41,6 +58,10 @@ BOOL ERIFileItem::GetFileInfo(HICON& hIcon, WTL::CString& sTypeName, LONGLONG& l
   if(bGetSize)
   {            
     lSize = lFileSize.QuadPart; 
+
+    // Only the snapshot is included
+    if(m_lSnapshotSize>=0 && m_lSnapshotSize<lSize)
+      lSize = m_lSnapshotSize;
   }
 
   // Get file icon and type name
@@ -69,6 +90,7 @@ CErrorReportInfo::CErrorReportInfo()
   m_dwGuiResources = 0;
   m_dwProcessHandleCount = 0;
   m_uTotalSize = 0;
+  m_bTotalSizeValid = FALSE;
   m_dwExceptionAddress = 0;
   m_dwExceptionModuleBase = 0;
 }
@@ -121,7 +143,9 @@ WTL::CString CErrorReportInfo::GetSystemTimeUTC()
 
 ULONG64 CErrorReportInfo::GetTotalSize()
 {
-  m_uTotalSize = CalcUncompressedReportSize();
+  // Files of a queued report are not changed, so their size is calculated once
+  if(!m_bTotalSizeValid)
+    m_uTotalSize = CalcUncompressedReportSize();
   return m_uTotalSize;
 }
 
@@ -244,6 +268,7 @@ ERIFileItem* CErrorReportInfo::GetFileItemByName(LPCTSTR szDestFileName)
 void CErrorReportInfo::AddFileItem(ERIFileItem* pfi)
 {
   m_FileItems[pfi->m_sDestFile] = *pfi;
+  m_bTotalSizeValid = FALSE;
 }
 
 BOOL CErrorReportInfo::DeleteFileItemByIndex(int nItem)
@@ -255,6 +280,7 @@ BOOL CErrorReportInfo::DeleteFileItemByIndex(int nItem)
     return FALSE;
 
   m_FileItems.erase(p);
+  m_bTotalSizeValid = FALSE;
   return TRUE;
 }
 
@@ -313,6 +339,21 @@ void CErrorReportInfo::AddRegKey(LPCTSTR szKeyName, ERIRegKey& rki)
   m_RegKeys[szKeyName] = rki;
 }
 
+// Returns count of breadcrumbs in error report.
+int CErrorReportInfo::GetBreadcrumbCount()
+{
+  return (int)m_Breadcrumbs.size();
+}
+
+// Method that retrieves a breadcrumb by zero-based index.
+ERIBreadcrumb* CErrorReportInfo::GetBreadcrumbByIndex(int nItem)
+{
+  if(nItem<0 || nItem>=(int)m_Breadcrumbs.size())
+    return NULL; // No such item
+
+  return &m_Breadcrumbs[nItem];
+}
+
 // This method calculates the total size of files included into error report
 LONG64 CErrorReportInfo::CalcUncompressedReportSize()
 {
@@ -332,7 +373,8 @@ LONG64 CErrorReportInfo::CalcUncompressedReportSize()
     WTL::CString sFileName = pfi->m_sSrcFile.GetBuffer(0);
     // Open file for reading
     hFile = CreateFile(sFileName, 
-      GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, NULL, NULL); 
+      GENERIC_READ, pfi->m_lSnapshotSize>=0 ? FILE_SHARE_READ|FILE_SHARE_WRITE : FILE_SHARE_READ, 
+      NULL, OPEN_EXISTING, NULL, NULL); 
     if(hFile==INVALID_HANDLE_VALUE)
     {            
       continue;
@@ -346,6 +388,10 @@ LONG64 CErrorReportInfo::CalcUncompressedReportSize()
       continue;
     }
 
+    // Only the snapshot of the file is included
+    if(pfi->m_lSnapshotSize>=0 && pfi->m_lSnapshotSize<lFileSize.QuadPart)
+      lFileSize.QuadPart = pfi->m_lSnapshotSize;
+
     // Update totals
     lTotalSize += lFileSize.QuadPart;
 
@@ -375,6 +421,7 @@ CCrashInfoReader::CCrashInfoReader()
   m_bShowAdditionalInfoFields = FALSE;
   m_bAllowAttachMoreFiles = FALSE;
   m_bStoreZIPArchives = FALSE;
+  m_bSHA256Digest = FALSE;
   m_bSendRecentReports = FALSE;
   m_bAppRestart = FALSE;
   m_uPriorities[CR_HTTP] = 3;
@@ -445,6 +492,10 @@ int CCrashInfoReader::Init(LPCTSTR szFileMappingName)
   // Save path to INI file storing settings
   m_sINIFile = m_sUnsentCrashReportsFolder + _T("\\~CrashRpt.ini");
 
+  // Open the index of queued reports. If the index is missing or damaged, 
+  // reports are parsed from their folders and indexed again.
+  m_ReportIndex.Open(strconv.t2utf8(m_sUnsentCrashReportsFolder + _T("\\~CrashRpt.idx")));
+
   if(!m_bSendRecentReports) // We should send report immediately
   { 
     CollectMiscCrashInfo(eri);
@@ -464,6 +515,7 @@ int CCrashInfoReader::Init(LPCTSTR szFileMappingName)
       SetEvent(hEvent);
 
     // Look for pending error reports and add them to the list
+    std::vector<std::string> asFolderNames;
     WTL::CString sSearchPattern = m_sUnsentCrashReportsFolder + _T("\\*");
     WTL::CFindFile find;
     BOOL bFound = find.FindFile(sSearchPattern);
@@ -474,20 +526,39 @@ int CCrashInfoReader::Init(LPCTSTR szFileMappingName)
         WTL::CString sErrorReportDirName = m_sUnsentCrashReportsFolder + _T("\\") + 
           find.GetFileName();
         WTL::CString sFileName = sErrorReportDirName + _T("\\crashrpt.xml");
+        std::string sFolderName = strconv.t2utf8(find.GetFileName());
+        asFolderNames.push_back(sFolderName);
         CErrorReportInfo eri2;
         eri2.m_sErrorReportDirName = sErrorReportDirName;
+        ULONG64 uDirTime = 0;
+        GetFolderWriteTime(sErrorReportDirName, uDirTime);
+        ReportIndexEntry entry;
+        BOOL bIndexed = m_ReportIndex.Find(sFolderName, entry);
+        if(bIndexed && uDirTime!=0 && entry.m_uDirTime==uDirTime)
+        {
+          // The folder wasn't changed since it was indexed
+          ReadReportIndexEntry(entry, eri2);
+          m_Reports.push_back(eri2);
+        }
         // Read crash description XML from the directory
-        if(0==ParseCrashDescription(sFileName, TRUE, eri2))
+        else if(0==ParseCrashDescription(sFileName, TRUE, eri2))
         {          
           // Calculate crash report size
           eri2.m_uTotalSize = GetUncompressedReportSize(eri2);
+          eri2.m_bTotalSizeValid = TRUE;
           // Add report to the list
           m_Reports.push_back(eri2);
+          // Index the report, so it is not parsed next time
+          if(uDirTime!=0)
+            PutReportIndexEntry(eri2, uDirTime, bIndexed?entry.m_nStatus:PENDING);
         }
       }
 
       bFound = find.FindNextFile();
     }
+
+    // Drop entries of folders removed while the index wasn't updated
+    m_ReportIndex.Retain(asFolderNames);
   }
 
   // Done
@@ -540,6 +611,7 @@ int CCrashInfoReader::UnpackCrashDescription(CErrorReportInfo& eri)
   m_bShowAdditionalInfoFields = (dwInstallFlags&CR_INST_SHOW_ADDITIONAL_INFO_FIELDS)!=0;
   m_bAllowAttachMoreFiles = (dwInstallFlags&CR_INST_ALLOW_ATTACH_MORE_FILES)!=0;
   m_bStoreZIPArchives = (dwInstallFlags&CR_INST_STORE_ZIP_ARCHIVES)!=0;
+  m_bSHA256Digest = (dwInstallFlags&CR_INST_SHA256_DIGEST)!=0;
   m_bAppRestart = (dwInstallFlags&CR_INST_APP_RESTART)!=0;
   m_bGenerateMinidump = (dwInstallFlags&CR_INST_NO_MINIDUMP)==0;
   m_bQueueEnabled = (dwInstallFlags&CR_INST_SEND_QUEUED_REPORTS)!=0;
@@ -589,6 +661,7 @@ int CCrashInfoReader::UnpackCrashDescription(CErrorReportInfo& eri)
       UnpackString(pFileItem->m_dwDescriptionOffs, fi.m_sDesc);
       fi.m_bMakeCopy = pFileItem->m_bMakeCopy;
       fi.m_bAllowDelete = pFileItem->m_bAllowDelete;
+      fi.m_bSnapshot = pFileItem->m_bSnapshot;
 
       eri.m_FileItems[fi.m_sDestFile] = fi;
 
@@ -638,6 +711,70 @@ int CCrashInfoReader::UnpackCrashDescription(CErrorReportInfo& eri)
     m_SharedMem.DestroyView(pView);
   }
 
+  // Unpack properties from the property table. They are newer than the
+  // property blocks (only values that didn't fit into the table are packed as blocks).
+  if(m_pCrashDesc->m_dwPropTableOffs!=0)
+  {
+    CPropertyTable PropTable;
+    LPBYTE pTable = m_SharedMem.CreateView(m_pCrashDesc->m_dwPropTableOffs, (DWORD)CPropertyTable::GetRequiredSize());
+    if(PropTable.Attach(pTable, (size_t)(SHARED_MEM_MAX_SIZE-m_pCrashDesc->m_dwPropTableOffs)))
+    {
+      int i;
+      for(i=0; i<PropTable.GetSlotCount(); i++)
+      {
+        std::string sName;
+        std::string sValue;
+        if(PropTable.Read(i, sName, sValue)!=PROPTABLE_OK)
+          continue;
+
+        WTL::CString sPropName((LPCTSTR)sName.data(), (int)(sName.size()/sizeof(TCHAR)));
+        WTL::CString sPropValue((LPCTSTR)sValue.data(), (int)(sValue.size()/sizeof(TCHAR)));
+        eri.m_Props[sPropName] = sPropValue;
+      }
+    }
+    m_SharedMem.DestroyView(pTable);
+  }
+
+  // Unpack breadcrumbs of all threads, merged by time. The breadcrumb log
+  // has its own file mapping, kept by the client for its lifetime.
+  WTL::CString sBreadcrumbMemName;
+  if(m_pCrashDesc->m_dwBreadcrumbsNameOffs!=0 &&
+    0==UnpackString(m_pCrashDesc->m_dwBreadcrumbsNameOffs, sBreadcrumbMemName))
+  {
+    CSharedMem BreadcrumbMem;
+    CBreadcrumbLog Breadcrumbs;
+    LPBYTE pLog = NULL;
+    if(BreadcrumbMem.Init(sBreadcrumbMemName, TRUE, CBreadcrumbLog::GetRequiredSize()))
+      pLog = BreadcrumbMem.CreateView(0, (DWORD)CBreadcrumbLog::GetRequiredSize());
+    if(Breadcrumbs.Attach(pLog, (size_t)CBreadcrumbLog::GetRequiredSize()))
+    {
+      strconv_t strconv;
+      std::vector<BreadcrumbItem> aItems;
+      Breadcrumbs.ReadAll(aItems);
+
+      size_t i;
+      for(i=0; i<aItems.size(); i++)
+      {
+        ERIBreadcrumb bc;
+        bc.m_sTime = strconv.a2t(CBreadcrumbLog::FormatTime(aItems[i].m_uTime).c_str());
+        bc.m_dwThreadId = aItems[i].m_uThreadId;
+        if(aItems[i].m_uFlags&BREADCRUMB_FLAG_WIDE)
+        {
+          // UTF-16 text, as TCHAR is WCHAR here
+          bc.m_sCategory = WTL::CString((LPCTSTR)aItems[i].m_sCategory.data(), (int)(aItems[i].m_sCategory.size()/sizeof(TCHAR)));
+          bc.m_sMessage = WTL::CString((LPCTSTR)aItems[i].m_sMessage.data(), (int)(aItems[i].m_sMessage.size()/sizeof(TCHAR)));
+        }
+        else
+        {
+          // Text in ANSI code page of the client application
+          bc.m_sCategory = strconv.a2t(aItems[i].m_sCategory.c_str());
+          bc.m_sMessage = strconv.a2t(aItems[i].m_sMessage.c_str());
+        }
+        eri.m_Breadcrumbs.push_back(bc);
+      }
+    }
+  }
+
   // Success
   return 0;
 }
@@ -656,7 +793,12 @@ int CCrashInfoReader::UnpackString(DWORD dwOffset, WTL::CString& str)
 
   m_SharedMem.DestroyView((LPBYTE)pStrDesc);
   LPBYTE pStrData = m_SharedMem.CreateView(dwOffset+sizeof(STRING_DESC), wStrLen);
-  str = WTL::CString((LPCTSTR)pStrData, wStrLen/sizeof(TCHAR));
+  // The string may be padded with zeros
+  LPCTSTR pszStr = (LPCTSTR)pStrData;
+  int nStrLen = 0;
+  while(nStrLen<(int)(wStrLen/sizeof(TCHAR)) && pszStr[nStrLen]!=0)
+    nStrLen++;
+  str = WTL::CString(pszStr, nStrLen);
   m_SharedMem.DestroyView(pStrData);
 
   return 0;
@@ -684,6 +826,7 @@ void CCrashInfoReader::DeleteReport(int nIndex)
 
   // Delete from list
   m_Reports[nIndex].m_DeliveryStatus = DELETED;
+  UpdateReportIndexStatus(nIndex);
 }
 
 void CCrashInfoReader::DeleteAllReports()
@@ -695,6 +838,7 @@ void CCrashInfoReader::DeleteAllReports()
     Utility::RecycleFile(m_Reports[i].m_sErrorReportDirName, TRUE);
 
     m_Reports[i].m_DeliveryStatus = DELETED;
+    UpdateReportIndexStatus(i);
   }	
 }
 
@@ -893,6 +1037,8 @@ int CCrashInfoReader::ParseCrashDescription(WTL::CString sFileName, BOOL bParseF
 {
   strconv_t strconv;
   FILE* f = NULL; 
+  CXmlPullParser parser;
+  BOOL bFileList = FALSE;
 
 #if _MSC_VER<1400
   f = _tfopen(sFileName, _T("rb"));
@@ -903,134 +1049,103 @@ int CCrashInfoReader::ParseCrashDescription(WTL::CString sFileName, BOOL bParseF
   if(f==NULL)
     return 1;
 
-  TiXmlDocument doc;
-  bool bOpen = doc.LoadFile(f);
+  bool bOpen = parser.Open(f);
+  fclose(f);
   if(!bOpen)
     return 1;
 
-  TiXmlHandle hRoot = doc.FirstChild("CrashRpt");
-  if(hRoot.ToElement()==NULL)
+  // Find the root element
+  for(;;)
   {
-    fclose(f);
-    return 1;
+    if(!parser.ReadChildElement(-1))
+      return 1;
+    if(strcmp(parser.GetName(), "CrashRpt")==0)
+      break;
   }
 
+  // Get directory name
+  WTL::CString sReportDir = sFileName;
+  int pos = sFileName.ReverseFind('\\');
+  if(pos>=0)
+    sReportDir = sFileName.Left(pos);
+  if(sReportDir.Right(1)!=_T("\\"))
+    sReportDir += _T("\\");
+
+  // Walk the children of the root element in a single pass
+  int nRootDepth = parser.GetDepth();
+  while(parser.ReadChildElement(nRootDepth))
   {
-    TiXmlHandle hCrashGUID = hRoot.FirstChild("CrashGUID");
-    if(hCrashGUID.ToElement()!=NULL)
-    {
-      if(hCrashGUID.FirstChild().ToText()!=NULL)
-      {
-        const char* szCrashGUID = hCrashGUID.FirstChild().ToText()->Value();
-        if(szCrashGUID!=NULL)
-          eri.m_sCrashGUID = strconv.utf82t(szCrashGUID);
-      }
-    }
-  }
+    const char* szName = parser.GetName();
 
-  {
-    TiXmlHandle hAppName = hRoot.FirstChild("AppName");
-    if(hAppName.ToElement()!=NULL)
+    if(strcmp(szName, "CrashGUID")==0)
     {
-      const char* szAppName = hAppName.FirstChild().ToText()->Value();
-      if(szAppName!=NULL)
-        eri.m_sAppName = strconv.utf82t(szAppName);
+      eri.m_sCrashGUID = strconv.utf82t(parser.ReadElementText());
     }
-  }
-
-  {
-    TiXmlHandle hAppVersion = hRoot.FirstChild("AppVersion");
-    if(hAppVersion.ToElement()!=NULL)
+    else if(strcmp(szName, "AppName")==0)
     {
-      TiXmlText* pText = hAppVersion.FirstChild().ToText();
-      if(pText!=NULL)
-      {
-        const char* szAppVersion = pText->Value();
-        if(szAppVersion!=NULL)
-          eri.m_sAppVersion = strconv.utf82t(szAppVersion);
-      }
+      eri.m_sAppName = strconv.utf82t(parser.ReadElementText());
     }
-  }
-
-  {
-    TiXmlHandle hImageName = hRoot.FirstChild("ImageName");
-    if(hImageName.ToElement()!=NULL)
+    else if(strcmp(szName, "AppVersion")==0)
     {
-      TiXmlText* pText = hImageName.FirstChild().ToText();
-      if(pText!=NULL)
-      {
-        const char* szImageName = pText->Value();
-        if(szImageName!=NULL)
-          eri.m_sImageName = strconv.utf82t(szImageName);
-      }
+      eri.m_sAppVersion = strconv.utf82t(parser.ReadElementText());
     }
-  }
-
-  {
-    TiXmlHandle hSystemTimeUTC = hRoot.FirstChild("SystemTimeUTC");
-    if(hSystemTimeUTC.ToElement()!=NULL)
+    else if(strcmp(szName, "ImageName")==0)
     {
-      TiXmlText* pText = hSystemTimeUTC.FirstChild().ToText();
-      if(pText!=NULL)
-      {
-        const char* szSystemTimeUTC = pText->Value();
-        if(szSystemTimeUTC!=NULL)
-          eri.m_sSystemTimeUTC = strconv.utf82t(szSystemTimeUTC);
-      }
+      eri.m_sImageName = strconv.utf82t(parser.ReadElementText());
     }
-  }
-
-  if(bParseFileItems)
-  {
-    // Get directory name
-    WTL::CString sReportDir = sFileName;
-    int pos = sFileName.ReverseFind('\\');
-    if(pos>=0)
-      sReportDir = sFileName.Left(pos);
-    if(sReportDir.Right(1)!=_T("\\"))
-      sReportDir += _T("\\");
-
-    TiXmlHandle fl = hRoot.FirstChild("FileList");
-    if(fl.ToElement()==0)
-    {    
-      fclose(f);
-      return 1;
+    else if(strcmp(szName, "SystemTimeUTC")==0)
+    {
+      eri.m_sSystemTimeUTC = strconv.utf82t(parser.ReadElementText());
     }
-
-    TiXmlHandle fi = fl.FirstChild("FileItem");
-    while(fi.ToElement()!=0)
+    else if(bParseFileItems && !bFileList && strcmp(szName, "FileList")==0)
     {
-      const char* pszDestFile = fi.ToElement()->Attribute("name");      
-      const char* pszDesc = fi.ToElement()->Attribute("description");      
-      const char* pszOptional = fi.ToElement()->Attribute("optional");      
+      bFileList = TRUE;
 
-      if(pszDestFile!=NULL)
+      while(parser.ReadChildElement(nRootDepth+1))
       {
-        WTL::CString sDestFile = strconv.utf82t(pszDestFile);      
-        ERIFileItem item;
-        item.m_sDestFile = sDestFile;
-        item.m_sSrcFile = sReportDir + sDestFile;
-        if(pszDesc)
-          item.m_sDesc = strconv.utf82t(pszDesc);
-        item.m_bMakeCopy = FALSE;
+        if(strcmp(parser.GetName(), "FileItem")!=0)
+          continue;
 
-        if(pszOptional && strcmp(pszOptional, "1")==0)
-          item.m_bAllowDelete = true;
+        const char* pszDestFile = parser.GetAttribute("name");      
+        const char* pszDesc = parser.GetAttribute("description");      
+        const char* pszOptional = parser.GetAttribute("optional");      
+        const char* pszSnapshotSize = parser.GetAttribute("snapshotsize");
 
-        // Check that file really exists
-        DWORD dwAttrs = GetFileAttributes(item.m_sSrcFile);
-        if(dwAttrs!=INVALID_FILE_ATTRIBUTES &&
-          (dwAttrs&FILE_ATTRIBUTE_DIRECTORY)==0)
+        if(pszDestFile!=NULL)
         {
-          eri.m_FileItems[sDestFile] = item;
+          WTL::CString sDestFile = strconv.utf82t(pszDestFile);      
+          ERIFileItem item;
+          item.m_sDestFile = sDestFile;
+          item.m_sSrcFile = sReportDir + sDestFile;
+          if(pszDesc)
+            item.m_sDesc = strconv.utf82t(pszDesc);
+          item.m_bMakeCopy = FALSE;
+
+          if(pszOptional && strcmp(pszOptional, "1")==0)
+            item.m_bAllowDelete = true;
+
+          // A snapshot linked to the report folder may have grown since the crash
+          if(pszSnapshotSize)
+            item.m_lSnapshotSize = _atoi64(pszSnapshotSize);
+
+          // Check that file really exists
+          DWORD dwAttrs = GetFileAttributes(item.m_sSrcFile);
+          if(dwAttrs!=INVALID_FILE_ATTRIBUTES &&
+            (dwAttrs&FILE_ATTRIBUTE_DIRECTORY)==0)
+          {
+            eri.m_FileItems[sDestFile] = item;
+          }
         }
       }
-
-      fi = fi.ToElement()->NextSibling("FileItem");
-    }    
+    }
   }
 
-  fclose(f);
+  if(parser.GetNodeType()==XML_NODE_ERROR)
+    return 1;
+
+  if(bParseFileItems && !bFileList)
+    return 1;
+
   return 0;
 }
 
@@ -1062,9 +1177,10 @@ BOOL CCrashInfoReader::UpdateUserInfo(WTL::CString sEmail, WTL::CString sDesc)
   GetReport(0)->m_sDescription = sDesc;	
 
   // Write user email and problem description to XML
-  AddUserInfoToCrashDescriptionXML(
+  if(AddUserInfoToCrashDescriptionXML(
     GetReport(0)->m_sEmailFrom, 
-    GetReport(0)->m_sDescription);
+    GetReport(0)->m_sDescription))
+    UpdateReportIndex(0);
 
   // Save E-mail entered by user to INI file for later reuse.
   SetPersistentUserEmail(sEmail);
@@ -1228,6 +1344,8 @@ BOOL CCrashInfoReader::AddFilesToCrashReport(int nReport, std::vector<ERIFileIte
     }
   }
 
+  m_Reports[nReport].m_bTotalSizeValid = FALSE;
+
 #if _MSC_VER<1400
   f = _tfopen(sFileName, _T("w"));
 #else
@@ -1241,6 +1359,8 @@ BOOL CCrashInfoReader::AddFilesToCrashReport(int nReport, std::vector<ERIFileIte
   if(!bSave)
     return FALSE;
   fclose(f);
+
+  UpdateReportIndex(nReport);
   return TRUE;
 }
 
@@ -1311,6 +1431,8 @@ BOOL CCrashInfoReader::RemoveFilesFromCrashReport(int nReport, std::vector<WTL::
     m_Reports[nReport].m_FileItems.erase(it);
   }
 
+  m_Reports[nReport].m_bTotalSizeValid = FALSE;
+
 #if _MSC_VER<1400
   f = _tfopen(sFileName, _T("w"));
 #else
@@ -1324,6 +1446,8 @@ BOOL CCrashInfoReader::RemoveFilesFromCrashReport(int nReport, std::vector<WTL::
   if(!bSave)
     return FALSE;
   fclose(f);
+
+  UpdateReportIndex(nReport);
   return TRUE;
 }
 
@@ -1425,7 +1549,8 @@ LONG64 CCrashInfoReader::GetUncompressedReportSize(CErrorReportInfo& eri)
     WTL::CString sFileName = it->second.m_sSrcFile.GetBuffer(0);
     // Check file exists
     hFile = CreateFile(sFileName, 
-      GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, NULL, NULL); 
+      GENERIC_READ, it->second.m_lSnapshotSize>=0 ? FILE_SHARE_READ|FILE_SHARE_WRITE : FILE_SHARE_READ, 
+      NULL, OPEN_EXISTING, NULL, NULL); 
     if(hFile==INVALID_HANDLE_VALUE)
       continue; // File does not exist
 
@@ -1437,6 +1562,10 @@ LONG64 CCrashInfoReader::GetUncompressedReportSize(CErrorReportInfo& eri)
       continue;
     }
 
+    // Only the snapshot of the file is included
+    if(it->second.m_lSnapshotSize>=0 && it->second.m_lSnapshotSize<lFileSize.QuadPart)
+      lFileSize.QuadPart = it->second.m_lSnapshotSize;
+
     // Add to the sum
     lTotalSize += lFileSize.QuadPart;
 
@@ -1449,6 +1578,104 @@ LONG64 CCrashInfoReader::GetUncompressedReportSize(CErrorReportInfo& eri)
   return lTotalSize;
 }
 
+void CCrashInfoReader::UpdateReportIndex(int nReport)
+{
+  CErrorReportInfo* eri = GetReport(nReport);
+  if(eri==NULL)
+    return;
+
+  ULONG64 uDirTime = 0;
+  if(!GetFolderWriteTime(eri->m_sErrorReportDirName, uDirTime))
+    return; // The report folder was removed
+
+  // Index the report the way it will be read from its folder
+  CErrorReportInfo eri2;
+  eri2.m_sErrorReportDirName = eri->m_sErrorReportDirName;
+  if(0!=ParseCrashDescription(eri->m_sErrorReportDirName + _T("\\crashrpt.xml"), TRUE, eri2))
+    return;
+
+  eri2.m_uTotalSize = GetUncompressedReportSize(eri2);
+  PutReportIndexEntry(eri2, uDirTime, eri->m_DeliveryStatus==FAILED?FAILED:PENDING);
+}
+
+void CCrashInfoReader::UpdateReportIndexStatus(int nReport)
+{
+  strconv_t strconv;
+
+  CErrorReportInfo* eri = GetReport(nReport);
+  if(eri==NULL)
+    return;
+
+  std::string sFolderName = strconv.t2utf8(Utility::GetFileName(eri->m_sErrorReportDirName));
+
+  DWORD dwAttrs = GetFileAttributes(eri->m_sErrorReportDirName);
+  if(eri->m_DeliveryStatus==DELIVERED || eri->m_DeliveryStatus==DELETED ||
+    dwAttrs==INVALID_FILE_ATTRIBUTES)
+  {
+    // The report is not in the queue anymore
+    m_ReportIndex.Remove(sFolderName);
+  }
+  else if(eri->m_DeliveryStatus!=INPROGRESS)
+  {
+    m_ReportIndex.SetStatus(sFolderName, eri->m_DeliveryStatus);
+  }
+}
+
+void CCrashInfoReader::PutReportIndexEntry(CErrorReportInfo& eri, ULONG64 uDirTime, int nStatus)
+{
+  strconv_t strconv;
+  ReportIndexEntry entry;
+
+  entry.m_uDirTime = uDirTime;
+  entry.m_sCrashGUID = strconv.t2utf8(eri.m_sCrashGUID);
+  entry.m_sAppName = strconv.t2utf8(eri.m_sAppName);
+  entry.m_sAppVersion = strconv.t2utf8(eri.m_sAppVersion);
+  entry.m_sImageName = strconv.t2utf8(eri.m_sImageName);
+  entry.m_sSystemTimeUTC = strconv.t2utf8(eri.m_sSystemTimeUTC);
+  entry.m_uTotalSize = eri.m_uTotalSize;
+  entry.m_nStatus = nStatus;
+
+  std::map<WTL::CString, ERIFileItem>::iterator it;
+  for(it=eri.m_FileItems.begin(); it!=eri.m_FileItems.end(); it++)
+  {
+    ReportIndexFile file;
+    file.m_sName = strconv.t2utf8(it->second.m_sDestFile);
+    file.m_sDesc = strconv.t2utf8(it->second.m_sDesc);
+    file.m_bOptional = it->second.m_bAllowDelete?true:false;
+    file.m_nSnapshotSize = it->second.m_lSnapshotSize;
+    entry.m_aFiles.push_back(file);
+  }
+
+  m_ReportIndex.Put(strconv.t2utf8(Utility::GetFileName(eri.m_sErrorReportDirName)), entry);
+}
+
+void CCrashInfoReader::ReadReportIndexEntry(const ReportIndexEntry& entry, CErrorReportInfo& eri)
+{
+  strconv_t strconv;
+
+  eri.m_sCrashGUID = strconv.utf82t(entry.m_sCrashGUID.c_str());
+  eri.m_sAppName = strconv.utf82t(entry.m_sAppName.c_str());
+  eri.m_sAppVersion = strconv.utf82t(entry.m_sAppVersion.c_str());
+  eri.m_sImageName = strconv.utf82t(entry.m_sImageName.c_str());
+  eri.m_sSystemTimeUTC = strconv.utf82t(entry.m_sSystemTimeUTC.c_str());
+  eri.m_uTotalSize = entry.m_uTotalSize;
+  eri.m_bTotalSizeValid = TRUE;
+
+  size_t i;
+  for(i=0; i<entry.m_aFiles.size(); i++)
+  {
+    WTL::CString sDestFile = strconv.utf82t(entry.m_aFiles[i].m_sName.c_str());
+    ERIFileItem item;
+    item.m_sDestFile = sDestFile;
+    item.m_sSrcFile = eri.m_sErrorReportDirName + _T("\\") + sDestFile;
+    item.m_sDesc = strconv.utf82t(entry.m_aFiles[i].m_sDesc.c_str());
+    item.m_bMakeCopy = FALSE;
+    item.m_bAllowDelete = entry.m_aFiles[i].m_bOptional;
+    item.m_lSnapshotSize = entry.m_aFiles[i].m_nSnapshotSize;
+    eri.m_FileItems[sDestFile] = item;
+  }
+}
+
 HICON CCrashInfoReader::GetCustomIcon()
 {
   // This method extracts custom icon from the specified resource file.
@@ -18,6 +18,7 @@ be found in the Authors.txt file in the root of the source tree.
 #include "tinyxml.h"
 #include "SharedMem.h"
 #include "ScreenCap.h"
+#include "ReportIndex.h"
 
 // The structure describing a file item contained in crash report.
 struct ERIFileItem
@@ -27,6 +28,8 @@ struct ERIFileItem
     {
         m_bMakeCopy = FALSE;
     m_bAllowDelete = FALSE;
+    m_bSnapshot = FALSE;
+    m_lSnapshotSize = -1;
     }
 
     WTL::CString m_sDestFile;    // Destination file name as it appears in ZIP archive (not including directory name).
@@ -34,6 +37,8 @@ struct ERIFileItem
     WTL::CString m_sDesc;        // File description.
     BOOL m_bMakeCopy;       // Should we copy source file to error report folder?
     BOOL m_bAllowDelete;    // Should allow user to delete the file from crash report?
+    BOOL m_bSnapshot;       // Should we take a snapshot (record the size) instead of a copy?
+    LONGLONG m_lSnapshotSize; // Size of the file data included into the report, -1 for the whole file.
     WTL::CString m_sErrorStatus; // Empty if OK, non-empty if error occurred.
 
   // Retrieves file information, such as type and size.
@@ -51,6 +56,20 @@ struct ERIRegKey
   bool m_bAllowDelete;    // Whether to allow user deleting the file from context menu of Error Report Details dialog.
 };
 
+// A breadcrumb (recent application event) recorded with crAddBreadcrumb().
+struct ERIBreadcrumb
+{
+  ERIBreadcrumb()
+  {
+    m_dwThreadId = 0;
+  }
+
+  WTL::CString m_sTime;     // Time in format YYYY-MM-DDThh:mm:ss.sssZ (UTC).
+  DWORD m_dwThreadId;       // ID of the thread that recorded the breadcrumb.
+  WTL::CString m_sCategory; // Category.
+  WTL::CString m_sMessage;  // Message.
+};
+
 // Error report delivery statuses.
 enum DELIVERY_STATUS
 {  
@@ -107,6 +126,12 @@ public:
     // Adds/replaces a reg key in crash report.
     void AddRegKey(LPCTSTR szKeyName, ERIRegKey& rki);
 
+    // Returns count of breadcrumbs in error report.
+    int GetBreadcrumbCount();
+
+    // Method that retrieves a breadcrumb by zero-based index (breadcrumbs are ordered by time).
+    ERIBreadcrumb* GetBreadcrumbByIndex(int nItem);
+
     // Returns the name of the directory where error report files are located.
     WTL::CString GetErrorReportDirName();
 
@@ -218,12 +243,14 @@ private:
     WTL::CString         m_sGeoLocation;        // Geographic location.
     ScreenshotInfo  m_ScreenshotInfo;      // Screenshot info.
     ULONG64         m_uTotalSize;          // Summary size of this (uncompressed) report.
+    BOOL            m_bTotalSizeValid;     // Is m_uTotalSize known (files of a queued report don't change)?
     BOOL            m_bSelected;           // Is this report selected for delivery or not?
     DELIVERY_STATUS m_DeliveryStatus;      // Error report delivery status.
 
     std::map<WTL::CString, ERIFileItem>  m_FileItems; // The list of files that are included into this error report.
     std::map<WTL::CString, ERIRegKey> m_RegKeys; // The list of registry keys included into this error report.
     std::map<WTL::CString, WTL::CString> m_Props;   // The list of custom properties included into this error report.
+    std::vector<ERIBreadcrumb> m_Breadcrumbs; // Recent application events, oldest first.
 };
 
 // Remind policy. Defines the way user is notified about recently queued crash reports.
@@ -261,6 +288,7 @@ public:
     BOOL  m_bShowAdditionalInfoFields; // Make "Your E-mail" and "Describe what you were doing when the problem occurred" fields of Error Report dialog always visible.
     BOOL  m_bAllowAttachMoreFiles; // Whether to allow user to attach more files to crash report by clicking "Attach More File(s)" item from context menu of Error Report Details dialog.
     BOOL        m_bStoreZIPArchives;    // Should we store zipped error report files?
+    BOOL        m_bSHA256Digest;        // Should we calculate SHA-256 hash of ZIP archive?
     BOOL        m_bSendRecentReports;   // Should we send recently queued reports now?
     BOOL        m_bAppRestart;          // Should we restart the crashed application?
     WTL::CString     m_sRestartCmdLine;      // Command line for crashed app restart.
@@ -344,6 +372,14 @@ public:
 
     // Removes several files by names.
     BOOL RemoveFilesFromCrashReport(int nReport, std::vector<WTL::CString> FilesToRemove);
+
+    // Updates the entry of the report in the index of queued reports.
+    // Called when the report files are written or changed.
+    void UpdateReportIndex(int nReport);
+
+    // Records the delivery result of the report in the index of queued reports.
+    // Reports that were delivered or whose files were removed are removed from the index.
+    void UpdateReportIndexStatus(int nReport);
   
 private:
 
@@ -377,8 +413,15 @@ private:
     // Calculates size of an uncompressed error report.
     LONG64 GetUncompressedReportSize(CErrorReportInfo& eri);
 
+    // Adds the report read from its folder to the index of queued reports.
+    void PutReportIndexEntry(CErrorReportInfo& eri, ULONG64 uDirTime, int nStatus);
+
+    // Fills in the report from its entry in the index of queued reports.
+    void ReadReportIndexEntry(const ReportIndexEntry& entry, CErrorReportInfo& eri);
+
     std::vector<CErrorReportInfo> m_Reports; // Array of error reports.
     WTL::CString m_sINIFile;                     // Path to ~CrashRpt.ini file.
+    CReportIndex m_ReportIndex;             // Index of queued reports (~CrashRpt.idx file).
     CSharedMem m_SharedMem;                 // Shared memory
     CRASH_DESCRIPTION* m_pCrashDesc;        // Pointer to crash descritpion
     WTL::CString m_sErrorMsg;                    // Last error message.
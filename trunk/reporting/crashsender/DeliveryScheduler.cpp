@@ -0,0 +1,209 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "DeliveryScheduler.h"
+#include <stddef.h>
+
+CDeliveryScheduler::CDeliveryScheduler()
+{
+    m_pfnNext = NULL;
+    m_pfnPrepare = NULL;
+    m_pfnDeliver = NULL;
+    m_pfnDone = NULL;
+    m_pParam = NULL;
+    m_bCancelled = false;
+    m_nInFlight = 0;
+    m_nPeakInFlight = 0;
+    m_nDelivered = 0;
+    m_nFailed = 0;
+    m_pReadySem = NULL;
+    m_pSlotSem = NULL;
+}
+
+int CDeliveryScheduler::Run(
+    int nConcurrency,
+    PFNDELIVERYNEXT pfnNext,
+    PFNDELIVERYSTAGE pfnPrepare,
+    PFNDELIVERYSTAGE pfnDeliver,
+    PFNDELIVERYDONE pfnDone,
+    void* pParam)
+{
+    int nStatus = DELIVERY_ERR_PARAM;
+    int nStarted = 0;
+    int i;
+
+    if(pfnNext==NULL || pfnPrepare==NULL || pfnDeliver==NULL || pfnDone==NULL)
+        return DELIVERY_ERR_PARAM;
+
+    if(nConcurrency<=0)
+        nConcurrency = DELIVERY_DEFAULT_CONCURRENCY;
+    if(nConcurrency>DELIVERY_MAX_CONCURRENCY)
+        nConcurrency = DELIVERY_MAX_CONCURRENCY;
+
+    m_pfnNext = pfnNext;
+    m_pfnPrepare = pfnPrepare;
+    m_pfnDeliver = pfnDeliver;
+    m_pfnDone = pfnDone;
+    m_pParam = pParam;
+    m_Ready.clear();
+    m_bCancelled = false;
+    m_nInFlight = 0;
+    m_nPeakInFlight = 0;
+    m_nDelivered = 0;
+    m_nFailed = 0;
+
+    // One slot per worker plus one for the item prepared ahead
+    CSyncSemaphore ReadySem(0);
+    CSyncSemaphore SlotSem(nConcurrency+1);
+    m_pReadySem = &ReadySem;
+    m_pSlotSem = &SlotSem;
+
+    CSyncThread aThreads[DELIVERY_MAX_CONCURRENCY];
+    for(i=0; i<nConcurrency; i++)
+    {
+        if(!aThreads[i].Start(WorkerThread, this))
+        {
+            nStatus = DELIVERY_ERR_THREAD;
+            goto cleanup;
+        }
+        nStarted++;
+    }
+
+    for(;;)
+    {
+        // Wait until a worker is about to become free
+        SlotSem.Wait();
+
+        if(IsCancelled())
+        {
+            SlotSem.Post();
+            break;
+        }
+
+        int nItem = m_pfnNext(m_pParam);
+        if(nItem<0)
+        {
+            SlotSem.Post();
+            break;
+        }
+
+        if(!m_pfnPrepare(nItem, m_pParam))
+        {
+            FinishItem(nItem, false);
+            SlotSem.Post();
+            continue;
+        }
+
+        m_Lock.Lock();
+        m_Ready.push_back(nItem);
+        m_Lock.Unlock();
+        ReadySem.Post();
+    }
+
+    nStatus = DELIVERY_OK;
+
+cleanup:
+
+    // Stop workers after they take all prepared items
+    m_Lock.Lock();
+    for(i=0; i<nStarted; i++)
+        m_Ready.push_back(-1);
+    m_Lock.Unlock();
+
+    for(i=0; i<nStarted; i++)
+        ReadySem.Post();
+
+    for(i=0; i<nStarted; i++)
+        aThreads[i].Join();
+
+    m_pReadySem = NULL;
+    m_pSlotSem = NULL;
+
+    return nStatus;
+}
+
+void CDeliveryScheduler::Cancel()
+{
+    CSyncLock lock(m_Lock);
+    m_bCancelled = true;
+}
+
+bool CDeliveryScheduler::IsCancelled()
+{
+    CSyncLock lock(m_Lock);
+    return m_bCancelled;
+}
+
+int CDeliveryScheduler::GetDeliveredCount() const
+{
+    return m_nDelivered;
+}
+
+int CDeliveryScheduler::GetFailedCount() const
+{
+    return m_nFailed;
+}
+
+int CDeliveryScheduler::GetPeakConcurrency() const
+{
+    return m_nPeakInFlight;
+}
+
+void CDeliveryScheduler::WorkerThread(void* pParam)
+{
+    CDeliveryScheduler* pThis = (CDeliveryScheduler*)pParam;
+
+    for(;;)
+    {
+        pThis->m_pReadySem->Wait();
+
+        pThis->m_Lock.Lock();
+        int nItem = pThis->m_Ready.front();
+        pThis->m_Ready.pop_front();
+        bool bCancelled = pThis->m_bCancelled;
+        if(nItem>=0 && !bCancelled)
+        {
+            pThis->m_nInFlight++;
+            if(pThis->m_nInFlight>pThis->m_nPeakInFlight)
+                pThis->m_nPeakInFlight = pThis->m_nInFlight;
+        }
+        pThis->m_Lock.Unlock();
+
+        if(nItem<0)
+            break; // Stop
+
+        bool bDelivered = false;
+        if(!bCancelled)
+        {
+            bDelivered = pThis->m_pfnDeliver(nItem, pThis->m_pParam);
+
+            pThis->m_Lock.Lock();
+            pThis->m_nInFlight--;
+            pThis->m_Lock.Unlock();
+        }
+
+        pThis->FinishItem(nItem, bDelivered);
+
+        // The slot is free for the next prepared item
+        pThis->m_pSlotSem->Post();
+    }
+}
+
+void CDeliveryScheduler::FinishItem(int nItem, bool bDelivered)
+{
+    CSyncLock lock(m_DoneLock);
+
+    if(bDelivered)
+        m_nDelivered++;
+    else
+        m_nFailed++;
+
+    m_pfnDone(nItem, bDelivered, m_pParam);
+}
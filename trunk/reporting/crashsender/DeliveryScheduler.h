@@ -0,0 +1,102 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: DeliveryScheduler.h
+// Description: Bounded-concurrency pipeline used to deliver queued error reports.
+// Reports are prepared (compressed) one by one in the calling thread while up to K
+// prepared reports are being delivered by worker threads, so compression of the next
+// report overlaps with the upload of the previous ones.
+
+#pragma once
+#include <deque>
+#include "ThreadSync.h"
+
+// Default number of deliveries in flight
+#define DELIVERY_DEFAULT_CONCURRENCY 4
+
+// Maximum number of deliveries in flight
+#define DELIVERY_MAX_CONCURRENCY 16
+
+// Error codes returned by CDeliveryScheduler::Run()
+enum DeliverySchedulerError
+{
+    DELIVERY_OK = 0,             // Success (or cancelled)
+    DELIVERY_ERR_PARAM = 1,      // Invalid parameter
+    DELIVERY_ERR_THREAD = 2      // Couldn't create worker threads
+};
+
+// Returns the next item to process, or a negative value when there are no more items.
+// Called in the thread calling Run(). An item returned must not be returned again.
+typedef int (*PFNDELIVERYNEXT)(void* pParam);
+
+// Prepares or delivers the item. Returns false on failure.
+typedef bool (*PFNDELIVERYSTAGE)(int nItem, void* pParam);
+
+// Called once per item returned by PFNDELIVERYNEXT when its processing is finished.
+// Calls are serialized, but may come from any thread.
+typedef void (*PFNDELIVERYDONE)(int nItem, bool bDelivered, void* pParam);
+
+// class CDeliveryScheduler
+// Runs the prepare stage in the calling thread and the deliver stage in a pool of
+// worker threads. At most nConcurrency items are delivered at once, and at most one
+// prepared item waits for a free worker, which bounds the disk space taken by
+// prepared items.
+class CDeliveryScheduler
+{
+public:
+
+    CDeliveryScheduler();
+
+    // Processes items until PFNDELIVERYNEXT returns a negative value or Cancel() is
+    // called. Returns when all items started are finished.
+    int Run(
+        int nConcurrency,
+        PFNDELIVERYNEXT pfnNext,
+        PFNDELIVERYSTAGE pfnPrepare,
+        PFNDELIVERYSTAGE pfnDeliver,
+        PFNDELIVERYDONE pfnDone,
+        void* pParam);
+
+    // Stops taking new items. Prepared items that were not delivered yet are
+    // finished as failed. May be called from any thread.
+    void Cancel();
+
+    // Returns true if Cancel() was called during the current run
+    bool IsCancelled();
+
+    // Returns statistics of the last run
+    int GetDeliveredCount() const;
+    int GetFailedCount() const;
+    int GetPeakConcurrency() const;
+
+private:
+
+    // Worker thread procedure
+    static void WorkerThread(void* pParam);
+
+    // Finishes the item
+    void FinishItem(int nItem, bool bDelivered);
+
+    PFNDELIVERYNEXT m_pfnNext;       // Callbacks
+    PFNDELIVERYSTAGE m_pfnPrepare;
+    PFNDELIVERYSTAGE m_pfnDeliver;
+    PFNDELIVERYDONE m_pfnDone;
+    void* m_pParam;                  // Callback parameter
+    CSyncMutex m_Lock;               // Protects the members below
+    std::deque<int> m_Ready;         // Prepared items (negative item stops a worker)
+    bool m_bCancelled;               // Cancel flag
+    int m_nInFlight;                 // Number of items being delivered
+    int m_nPeakInFlight;             // Maximum value of m_nInFlight
+    int m_nDelivered;                // Number of items delivered
+    int m_nFailed;                   // Number of items failed
+    CSyncMutex m_DoneLock;           // Serializes PFNDELIVERYDONE calls
+    CSyncSemaphore* m_pReadySem;     // Count of m_Ready entries
+    CSyncSemaphore* m_pSlotSem;      // Count of free pipeline slots
+};
@@ -14,17 +14,18 @@ be found in the Authors.txt file in the root of the source tree.
 #include "smtpclient.h"
 #include "HttpRequestSender.h"
 #include "CrashRpt.h"
-#include "md5.h"
 #include "Utility.h"
 #include "zip.h"
+#include "HashingFileFunc.h"
+#include "CompressionPolicy.h"
 #include "CrashInfoReader.h"
 #include "strconv.h"
 #include "ScreenCap.h"
-#include "base64.h"
 #include <sys/stat.h>
 #include "dbghelp.h"
 #include "VideoRec.h"
 #include "VideoRecDlg.h"
+#include "XmlStream.h"
 
 CErrorReportSender* CErrorReportSender::m_pInstance = NULL;
 
@@ -367,7 +368,7 @@ BOOL CErrorReportSender::DoWork(int Action)
       return FALSE;
     }
 
-    // Encode recorded video to an .OGG file
+    // Encode recorded video to an .OGG or .WEBM file
     EncodeVideo();
 
     if(m_Assync.IsCancelled()) // Check if user-cancelled
@@ -380,6 +381,9 @@ BOOL CErrorReportSender::DoWork(int Action)
     // Create crash description XML
     CreateCrashDescriptionXML(*m_CrashInfo.GetReport(0));
 
+    // Index the report, so it is listed quickly if it stays in the queue
+    m_CrashInfo.UpdateReportIndex(0);
+
     // Add a message to log
     m_Assync.SetProgress(_T("[confirm_send_report]"), 100, false);
   }
@@ -458,6 +462,7 @@ BOOL CErrorReportSender::Finalize()
   {
     // Remove report files if queue disabled (or if client app not crashed).
     Utility::RecycleFile(m_CrashInfo.GetReport(0)->GetErrorReportDirName(), true);    
+    m_CrashInfo.UpdateReportIndexStatus(0);
   }
 
   if(!m_CrashInfo.m_bSendErrorReport && 
@@ -861,16 +866,6 @@ Cleanup:
   return fSuccess;
 }
 
-// This method adds an element to XML file
-void CErrorReportSender::AddElemToXML(WTL::CString sName, WTL::CString sValue, TiXmlNode* root)
-{
-  strconv_t strconv;
-  TiXmlHandle hElem = new TiXmlElement(strconv.t2utf8(sName));
-  root->LinkEndChild(hElem.ToNode());
-  TiXmlText* text = new TiXmlText(strconv.t2utf8(sValue));
-  hElem.ToElement()->LinkEndChild(text);
-}
-
 // This method generates an XML file describing the crash
 BOOL CErrorReportSender::CreateCrashDescriptionXML(CErrorReportInfo& eri)
 {
@@ -878,13 +873,11 @@ BOOL CErrorReportSender::CreateCrashDescriptionXML(CErrorReportInfo& eri)
   ERIFileItem fi;
   WTL::CString sFileName = eri.GetErrorReportDirName() + _T("\\crashrpt.xml");
   WTL::CString sErrorMsg;
-  strconv_t strconv;
-  TiXmlDocument doc;
+  CXmlWriter writer;
   FILE* f = NULL; 
   WTL::CString sNum;
-  WTL::CString sCrashRptVer;
-  WTL::CString sOSIs64Bit;
-  WTL::CString sExceptionType;
+  size_t i;
+  int n;
 
   fi.m_bMakeCopy = false;
   fi.m_sDesc = Utility::GetINIString(m_CrashInfo.m_sLangFileName, _T("DetailDlg"), _T("DescXML"));
@@ -894,201 +887,222 @@ BOOL CErrorReportSender::CreateCrashDescriptionXML(CErrorReportInfo& eri)
   // Add this file to the list
   eri.AddFileItem(&fi);
 
-  TiXmlNode* root = root = new TiXmlElement("CrashRpt");
-  doc.LinkEndChild(root);  
-  sCrashRptVer.Format(_T("%d"), CRASHRPT_VER);
-  TiXmlHandle(root).ToElement()->SetAttribute("version", strconv.t2utf8(sCrashRptVer));
+#if _MSC_VER<1400
+  f = _tfopen(sFileName, _T("w"));
+#else
+  _tfopen_s(&f, sFileName, _T("w"));
+#endif
 
-  TiXmlDeclaration * decl = new TiXmlDeclaration( "1.0", "UTF-8", "" );
-  doc.InsertBeforeChild(root, *decl);
+  if(f==NULL)
+  {
+    sErrorMsg = _T("Error opening file for writing");
+    goto cleanup;
+  }
 
-  AddElemToXML(_T("CrashGUID"), eri.GetCrashGUID(), root);
-  AddElemToXML(_T("AppName"), eri.GetAppName(), root);
-  AddElemToXML(_T("AppVersion"), eri.GetAppVersion(), root);  
-  AddElemToXML(_T("ImageName"), eri.GetImageName(), root);
-  AddElemToXML(_T("OperatingSystem"), eri.GetOSName(), root);
+  // The description is written element by element as the data are walked,
+  // no document tree is built in memory
+  writer.Open(f, true);
 
+  writer.BeginElement("CrashRpt");
+  sNum.Format(_T("%d"), CRASHRPT_VER);
+  writer.AddAttribute("version", sNum);
 
-  sOSIs64Bit.Format(_T("%d"), eri.IsOS64Bit());
-  AddElemToXML(_T("OSIs64Bit"), sOSIs64Bit, root);
+  writer.AddElement("CrashGUID", eri.GetCrashGUID());
+  writer.AddElement("AppName", eri.GetAppName());
+  writer.AddElement("AppVersion", eri.GetAppVersion());  
+  writer.AddElement("ImageName", eri.GetImageName());
+  writer.AddElement("OperatingSystem", eri.GetOSName());
 
-  AddElemToXML(_T("GeoLocation"), eri.GetGeoLocation(), root);
-  AddElemToXML(_T("SystemTimeUTC"), eri.GetSystemTimeUTC(), root);
+  sNum.Format(_T("%d"), eri.IsOS64Bit());
+  writer.AddElement("OSIs64Bit", sNum);
+
+  writer.AddElement("GeoLocation", eri.GetGeoLocation());
+  writer.AddElement("SystemTimeUTC", eri.GetSystemTimeUTC());
 
   if(eri.GetExceptionAddress()!=0)
   {
     sNum.Format(_T("0x%I64x"), eri.GetExceptionAddress());
-    AddElemToXML(_T("ExceptionAddress"), sNum, root);
+    writer.AddElement("ExceptionAddress", sNum);
 
-    AddElemToXML(_T("ExceptionModule"), eri.GetExceptionModule(), root);
+    writer.AddElement("ExceptionModule", eri.GetExceptionModule());
 
     sNum.Format(_T("0x%I64x"), eri.GetExceptionModuleBase());
-    AddElemToXML(_T("ExceptionModuleBase"), sNum, root);
+    writer.AddElement("ExceptionModuleBase", sNum);
 
-    AddElemToXML(_T("ExceptionModuleVersion"), eri.GetExceptionModuleVersion(), root);
+    writer.AddElement("ExceptionModuleVersion", eri.GetExceptionModuleVersion());
   }
 
-  sExceptionType.Format(_T("%d"), m_CrashInfo.m_nExceptionType);
-  AddElemToXML(_T("ExceptionType"), sExceptionType, root);
+  sNum.Format(_T("%d"), m_CrashInfo.m_nExceptionType);
+  writer.AddElement("ExceptionType", sNum);
   if(m_CrashInfo.m_nExceptionType==CR_SEH_EXCEPTION)
   {
-    WTL::CString sExceptionCode;
-    sExceptionCode.Format(_T("%d"), m_CrashInfo.m_dwExceptionCode);
-    AddElemToXML(_T("ExceptionCode"), sExceptionCode, root);
+    sNum.Format(_T("%d"), m_CrashInfo.m_dwExceptionCode);
+    writer.AddElement("ExceptionCode", sNum);
   }
   else if(m_CrashInfo.m_nExceptionType==CR_CPP_SIGFPE)
   {
-    WTL::CString sFPESubcode;
-    sFPESubcode.Format(_T("%d"), m_CrashInfo.m_uFPESubcode);
-    AddElemToXML(_T("FPESubcode"), sFPESubcode, root);
+    sNum.Format(_T("%d"), m_CrashInfo.m_uFPESubcode);
+    writer.AddElement("FPESubcode", sNum);
   }
   else if(m_CrashInfo.m_nExceptionType==CR_CPP_INVALID_PARAMETER)
   {
-    AddElemToXML(_T("InvParamExpression"), m_CrashInfo.m_sInvParamExpr, root);
-    AddElemToXML(_T("InvParamFunction"), m_CrashInfo.m_sInvParamFunction, root);
-    AddElemToXML(_T("InvParamFile"), m_CrashInfo.m_sInvParamFile, root);
+    writer.AddElement("InvParamExpression", m_CrashInfo.m_sInvParamExpr);
+    writer.AddElement("InvParamFunction", m_CrashInfo.m_sInvParamFunction);
+    writer.AddElement("InvParamFile", m_CrashInfo.m_sInvParamFile);
 
-    WTL::CString sInvParamLine;
-    sInvParamLine.Format(_T("%d"), m_CrashInfo.m_uInvParamLine);
-    AddElemToXML(_T("InvParamLine"), sInvParamLine, root);
+    sNum.Format(_T("%d"), m_CrashInfo.m_uInvParamLine);
+    writer.AddElement("InvParamLine", sNum);
   }
 
-  WTL::CString sGuiResources;
-  sGuiResources.Format(_T("%d"), eri.GetGuiResourceCount());
-  AddElemToXML(_T("GUIResourceCount"), sGuiResources, root);
+  sNum.Format(_T("%d"), eri.GetGuiResourceCount());
+  writer.AddElement("GUIResourceCount", sNum);
 
-  WTL::CString sProcessHandleCount;
-  sProcessHandleCount.Format(_T("%d"), eri.GetProcessHandleCount());
-  AddElemToXML(_T("OpenHandleCount"), sProcessHandleCount, root);
+  sNum.Format(_T("%d"), eri.GetProcessHandleCount());
+  writer.AddElement("OpenHandleCount", sNum);
 
-  AddElemToXML(_T("MemoryUsageKbytes"), eri.GetMemUsage(), root);
+  writer.AddElement("MemoryUsageKbytes", eri.GetMemUsage());
 
   if(eri.GetScreenshotInfo().m_bValid)
   {
-    TiXmlHandle hScreenshotInfo = new TiXmlElement("ScreenshotInfo");
-    root->LinkEndChild(hScreenshotInfo.ToNode());
+    writer.BeginElement("ScreenshotInfo");
 
-    TiXmlHandle hVirtualScreen = new TiXmlElement("VirtualScreen");    
+    writer.BeginElement("VirtualScreen");    
 
     sNum.Format(_T("%d"), eri.GetScreenshotInfo().m_rcVirtualScreen.left);
-    hVirtualScreen.ToElement()->SetAttribute("left", strconv.t2utf8(sNum));
+    writer.AddAttribute("left", sNum);
 
     sNum.Format(_T("%d"), eri.GetScreenshotInfo().m_rcVirtualScreen.top);
-    hVirtualScreen.ToElement()->SetAttribute("top", strconv.t2utf8(sNum));
+    writer.AddAttribute("top", sNum);
 
     sNum.Format(_T("%d"), eri.GetScreenshotInfo().m_rcVirtualScreen.Width());
-    hVirtualScreen.ToElement()->SetAttribute("width", strconv.t2utf8(sNum));
+    writer.AddAttribute("width", sNum);
 
     sNum.Format(_T("%d"), eri.GetScreenshotInfo().m_rcVirtualScreen.Height());
-    hVirtualScreen.ToElement()->SetAttribute("height", strconv.t2utf8(sNum));
+    writer.AddAttribute("height", sNum);
 
-    hScreenshotInfo.ToNode()->LinkEndChild(hVirtualScreen.ToNode());
+    writer.EndElement();
 
-    TiXmlHandle hMonitors = new TiXmlElement("Monitors");
-    hScreenshotInfo.ToElement()->LinkEndChild(hMonitors.ToNode());                  
+    writer.BeginElement("Monitors");
 
-    size_t i;
     for(i=0; i<eri.GetScreenshotInfo().m_aMonitors.size(); i++)
     { 
       MonitorInfo& mi = eri.GetScreenshotInfo().m_aMonitors[i];      
-      TiXmlHandle hMonitor = new TiXmlElement("Monitor");
+      writer.BeginElement("Monitor");
 
       sNum.Format(_T("%d"), mi.m_rcMonitor.left);
-      hMonitor.ToElement()->SetAttribute("left", strconv.t2utf8(sNum));
+      writer.AddAttribute("left", sNum);
 
       sNum.Format(_T("%d"), mi.m_rcMonitor.top);
-      hMonitor.ToElement()->SetAttribute("top", strconv.t2utf8(sNum));
+      writer.AddAttribute("top", sNum);
 
       sNum.Format(_T("%d"), mi.m_rcMonitor.Width());
-      hMonitor.ToElement()->SetAttribute("width", strconv.t2utf8(sNum));
+      writer.AddAttribute("width", sNum);
 
       sNum.Format(_T("%d"), mi.m_rcMonitor.Height());
-      hMonitor.ToElement()->SetAttribute("height", strconv.t2utf8(sNum));
+      writer.AddAttribute("height", sNum);
 
-      hMonitor.ToElement()->SetAttribute("file", strconv.t2utf8(Utility::GetFileName(mi.m_sFileName)));
+      writer.AddAttribute("file", Utility::GetFileName(mi.m_sFileName));
 
-      hMonitors.ToElement()->LinkEndChild(hMonitor.ToNode());                  
+      writer.EndElement();
     }
 
-    TiXmlHandle hWindows = new TiXmlElement("Windows");
-    hScreenshotInfo.ToElement()->LinkEndChild(hWindows.ToNode());                  
+    writer.EndElement();
+
+    writer.BeginElement("Windows");
 
     for(i=0; i<eri.GetScreenshotInfo().m_aWindows.size(); i++)
     { 
       WindowInfo& wi = eri.GetScreenshotInfo().m_aWindows[i];      
-      TiXmlHandle hWindow = new TiXmlElement("Window");
+      writer.BeginElement("Window");
 
       sNum.Format(_T("%d"), wi.m_rcWnd.left);
-      hWindow.ToElement()->SetAttribute("left", strconv.t2utf8(sNum));
+      writer.AddAttribute("left", sNum);
 
       sNum.Format(_T("%d"), wi.m_rcWnd.top);
-      hWindow.ToElement()->SetAttribute("top", strconv.t2utf8(sNum));
+      writer.AddAttribute("top", sNum);
 
       sNum.Format(_T("%d"), wi.m_rcWnd.Width());
-      hWindow.ToElement()->SetAttribute("width", strconv.t2utf8(sNum));
+      writer.AddAttribute("width", sNum);
 
       sNum.Format(_T("%d"), wi.m_rcWnd.Height());
-      hWindow.ToElement()->SetAttribute("height", strconv.t2utf8(sNum));
+      writer.AddAttribute("height", sNum);
 
-      hWindow.ToElement()->SetAttribute("title", strconv.t2utf8(wi.m_sTitle));
+      writer.AddAttribute("title", wi.m_sTitle);
 
-      hWindows.ToElement()->LinkEndChild(hWindow.ToNode());
+      writer.EndElement();
     }
+
+    writer.EndElement();
+
+    writer.EndElement();
   }
 
-  TiXmlHandle hCustomProps = new TiXmlElement("CustomProps");
-  root->LinkEndChild(hCustomProps.ToNode());
+  writer.BeginElement("CustomProps");
 
-  int i;
-  for(i=0; i<eri.GetPropCount(); i++)
+  for(n=0; n<eri.GetPropCount(); n++)
   { 
     WTL::CString sName;
     WTL::CString sVal;
-    eri.GetPropByIndex(i, sName, sVal);
+    eri.GetPropByIndex(n, sName, sVal);
+
+    writer.BeginElement("Prop");
+    writer.AddAttribute("name", sName);
+    writer.AddAttribute("value", sVal);
+    writer.EndElement();
+  }
 
-    TiXmlHandle hProp = new TiXmlElement("Prop");
+  writer.EndElement();
 
-    hProp.ToElement()->SetAttribute("name", strconv.t2utf8(sName));
-    hProp.ToElement()->SetAttribute("value", strconv.t2utf8(sVal));
+  if(eri.GetBreadcrumbCount()!=0)
+  {
+    writer.BeginElement("Breadcrumbs");
 
-    hCustomProps.ToElement()->LinkEndChild(hProp.ToNode());                  
+    for(n=0; n<eri.GetBreadcrumbCount(); n++)
+    {
+      ERIBreadcrumb* pbc = eri.GetBreadcrumbByIndex(n);
+      writer.BeginElement("Breadcrumb");
+
+      writer.AddAttribute("time", pbc->m_sTime);
+      sNum.Format(_T("%u"), pbc->m_dwThreadId);
+      writer.AddAttribute("thread", sNum);
+      writer.AddAttribute("category", pbc->m_sCategory);
+      writer.AddAttribute("message", pbc->m_sMessage);
+
+      writer.EndElement();
+    }
+
+    writer.EndElement();
   }
 
-  TiXmlHandle hFileItems = new TiXmlElement("FileList");
-  root->LinkEndChild(hFileItems.ToNode());
+  writer.BeginElement("FileList");
 
-  for(i=0; i<eri.GetFileItemCount(); i++)
+  for(n=0; n<eri.GetFileItemCount(); n++)
   {    
-    ERIFileItem* rfi = eri.GetFileItemByIndex(i);
-    TiXmlHandle hFileItem = new TiXmlElement("FileItem");
+    ERIFileItem* rfi = eri.GetFileItemByIndex(n);
+    writer.BeginElement("FileItem");
 
-    hFileItem.ToElement()->SetAttribute("name", strconv.t2utf8(rfi->m_sDestFile));
-    hFileItem.ToElement()->SetAttribute("description", strconv.t2utf8(rfi->m_sDesc));
+    writer.AddAttribute("name", rfi->m_sDestFile);
+    writer.AddAttribute("description", rfi->m_sDesc);
     if(rfi->m_bAllowDelete)
-      hFileItem.ToElement()->SetAttribute("optional", "1");
+      writer.AddAttribute("optional", "1");
+    if(rfi->m_lSnapshotSize>=0)
+    {
+      sNum.Format(_T("%I64d"), rfi->m_lSnapshotSize);
+      writer.AddAttribute("snapshotsize", sNum);
+    }
     if(!rfi->m_sErrorStatus.IsEmpty())
-      hFileItem.ToElement()->SetAttribute("error", strconv.t2utf8(rfi->m_sErrorStatus));
+      writer.AddAttribute("error", rfi->m_sErrorStatus);
 
-    hFileItems.ToElement()->LinkEndChild(hFileItem.ToNode());                  
+    writer.EndElement();
   }
 
-#if _MSC_VER<1400
-  f = _tfopen(sFileName, _T("w"));
-#else
-  _tfopen_s(&f, sFileName, _T("w"));
-#endif
+  writer.EndElement();
 
-  if(f==NULL)
-  {
-    sErrorMsg = _T("Error opening file for writing");
-    goto cleanup;
-  }
+  writer.EndElement();
 
-  doc.useMicrosoftBOM = true;
-  bool bSave = doc.SaveFile(f); 
-  if(!bSave)
+  if(!writer.Close())
   {
-    sErrorMsg = doc.ErrorDesc();
+    sErrorMsg = _T("Error writing file");
     goto cleanup;
   }
 
@@ -1110,68 +1124,123 @@ cleanup:
   return bStatus;
 }
 
-// This method collects user-specified files
+// This method collects user-specified files. Search templates are expanded first,
+// then all files are copied (or snapshotted) at once by a pool of threads.
 BOOL CErrorReportSender::CollectCrashFiles()
 { 
   BOOL bStatus = FALSE;
   WTL::CString str;
-  WTL::CString sErrorReportDir = m_CrashInfo.GetReport(m_nCurReport)->GetErrorReportDirName();
-  WTL::CString sSrcFile;
-  WTL::CString sDestFile;
+  CErrorReportInfo* eri = m_CrashInfo.GetReport(m_nCurReport);
+  WTL::CString sErrorReportDir = eri->GetErrorReportDirName();
   std::vector<ERIFileItem> file_list;
+  std::vector<FileCollectItem> collect_list;
+  CFileCollector collector;
+  int nFailed = 0;
 
   // Copy application-defined files that should be copied on crash
   m_Assync.SetProgress(_T("[copying_files]"), 0, false);
 
-  // Walk through error report files
+  // Walk through error report files, replacing search templates with the files found
   int i;
-  for(i=0; i<m_CrashInfo.GetReport(m_nCurReport)->GetFileItemCount(); i++)
+  for(i=0; i<eri->GetFileItemCount(); i++)
   {
-    ERIFileItem* pfi = m_CrashInfo.GetReport(m_nCurReport)->GetFileItemByIndex(i);
+    ERIFileItem* pfi = eri->GetFileItemByIndex(i);
 
     // Check if operation has been cancelled by user
     if(m_Assync.IsCancelled())
       goto cleanup;
 
     // Check if the file name is a search template.		
-    BOOL bSearchPattern = Utility::IsFileSearchPattern(pfi->m_sSrcFile);
-    if(bSearchPattern)
-      CollectFilesBySearchTemplate(pfi, file_list);
-    else
-      CollectSingleFile(pfi);
+    if(!Utility::IsFileSearchPattern(pfi->m_sSrcFile))
+    {
+      file_list.push_back(*pfi);
+      continue;
+    }
+
+    str.Format(_T("Looking for files using search template: %s"), pfi->m_sSrcFile);
+    m_Assync.SetProgress(str, 0);
+
+    std::vector<FileCollectPath> found_files;
+    if(!CFileCollector::ExpandTemplate(FileCollectPath((LPCTSTR)pfi->m_sSrcFile), found_files))
+    {
+      // Nothing found
+      m_Assync.SetProgress(_T("Could not find any files matching the search template."), 0);
+      continue;
+    }
+
+    size_t j;
+    for(j=0; j<found_files.size(); j++)
+    {
+      ERIFileItem fi;
+      fi.m_sSrcFile = found_files[j].c_str();
+      fi.m_sDestFile = Utility::GetFileName(fi.m_sSrcFile);
+      fi.m_sDesc = pfi->m_sDesc;
+      fi.m_bMakeCopy = pfi->m_bMakeCopy;
+      fi.m_bAllowDelete = pfi->m_bAllowDelete;
+      fi.m_bSnapshot = pfi->m_bSnapshot;
+      file_list.push_back(fi);
+    }
   }
 
-  // Add newly collected files to the list of file items
+  // Files that are neither copied nor snapshotted are only checked for access
   for(i=0; i<(int)file_list.size(); i++)
   {
-    m_CrashInfo.GetReport(0)->AddFileItem(&file_list[i]);
-  }				
+    WTL::CString sDestFile = sErrorReportDir + _T("\\") + file_list[i].m_sDestFile;
+    FileCollectItem item;
+    item.m_sSrcFile = (LPCTSTR)file_list[i].m_sSrcFile;
+    item.m_sDestFile = (LPCTSTR)sDestFile;
+    if(file_list[i].m_bSnapshot)
+      item.m_nMode = FCOLLECT_MODE_SNAPSHOT;
+    else if(file_list[i].m_bMakeCopy)
+      item.m_nMode = FCOLLECT_MODE_COPY;
+    else
+      item.m_nMode = FCOLLECT_MODE_CHECK;
+    collect_list.push_back(item);
+  }
+
+  collector.SetProgressCallback(CollectProgressCallback, this);
+  nFailed = collector.Run(collect_list);
 
-  // Remove file items that are search patterns
-  BOOL bFound = FALSE;
-  do
+  str.Format(_T("Collected %d file(s) with %d thread(s), %d failed."), 
+    (int)collect_list.size(), collector.GetThreadCount(), nFailed);
+  m_Assync.SetProgress(str, 0, false);
+
+  // Check if operation has been cancelled by user
+  if(m_Assync.IsCancelled())
+    goto cleanup;
+
+  for(i=0; i<(int)file_list.size(); i++)
   {
-    bFound = FALSE;
-    for(i=0; i<m_CrashInfo.GetReport(m_nCurReport)->GetFileItemCount(); i++)
-    {
-      ERIFileItem* pfi = m_CrashInfo.GetReport(m_nCurReport)->GetFileItemByIndex(i);
+    ERIFileItem& fi = file_list[i];
+    const FileCollectItem& item = collect_list[i];
 
-      // Check if the file name is a search template.		
-      BOOL bSearchPattern = Utility::IsFileSearchPattern(pfi->m_sSrcFile);
-      if(bSearchPattern)
-      {
-        // Delete this item
-        m_CrashInfo.GetReport(m_nCurReport)->DeleteFileItemByIndex(i);
-        bFound = TRUE;
-        break;
-      }
+    if(item.m_nResult!=FCOLLECT_OK)
+    {
+      fi.m_sErrorStatus = Utility::FormatErrorMsg(item.m_nSysError);
+      str.Format(_T("Error collecting file %s."), fi.m_sSrcFile);
+      m_Assync.SetProgress(str, 0, false);
+      continue;
     }
+
+    // Use the copy (or the link) for display and zipping.
+    if(item.m_nMethod==FCOLLECT_METHOD_READ || 
+      item.m_nMethod==FCOLLECT_METHOD_SYSTEM || 
+      item.m_nMethod==FCOLLECT_METHOD_LINK)
+      fi.m_sSrcFile = item.m_sDestFile.c_str();
+
+    // Data appended to the snapshot after the crash are not included.
+    if(item.m_nMode==FCOLLECT_MODE_SNAPSHOT)
+      fi.m_lSnapshotSize = (LONGLONG)item.m_uSize;
   }
-  while(bFound);
+
+  // Replace the file items in one pass; search templates are not included
+  while(eri->GetFileItemCount()!=0)
+    eri->DeleteFileItemByIndex(0);
+  for(i=0; i<(int)file_list.size(); i++)
+    eri->AddFileItem(&file_list[i]);
 
   // Create dump of registry keys
 
-  CErrorReportInfo* eri = m_CrashInfo.GetReport(m_nCurReport);  
   if(eri->GetRegKeyCount()!=0)
   {
     m_Assync.SetProgress(_T("Dumping registry keys..."), 0, false);    
@@ -1202,10 +1271,8 @@ BOOL CErrorReportSender::CollectCrashFiles()
     fi.m_bMakeCopy = FALSE;
     fi.m_bAllowDelete = rki.m_bAllowDelete;
     fi.m_sErrorStatus = sErrorMsg;
-    std::vector<ERIFileItem> file_list;
-    file_list.push_back(fi);
     // Add file to the list of file items
-    m_CrashInfo.GetReport(0)->AddFileItem(&fi);
+    eri->AddFileItem(&fi);
   }
 
   // Success
@@ -1219,169 +1286,15 @@ cleanup:
   return 0;
 }
 
-BOOL CErrorReportSender::CollectSingleFile(ERIFileItem* pfi)
+// Reports progress of copying files and checks if the operation was cancelled.
+bool CErrorReportSender::CollectProgressCallback(uint64_t uDone, uint64_t uTotal, void* pParam)
 {
-  BOOL bStatus = false;
-  WTL::CString str;
-  HANDLE hSrcFile = INVALID_HANDLE_VALUE;
-  HANDLE hDestFile = INVALID_HANDLE_VALUE;
-  BOOL bGetSize = FALSE;
-  LARGE_INTEGER lFileSize;
-  LARGE_INTEGER lTotalWritten;
-  WTL::CString sDestFile;
-  BOOL bRead = FALSE;
-  BOOL bWrite = FALSE;
-  LPBYTE buffer[1024];
-  DWORD dwBytesRead = 0;
-  DWORD dwBytesWritten = 0;
-
-  WTL::CString sErrorReportDir = m_CrashInfo.GetReport(m_nCurReport)->GetErrorReportDirName();
-
-  // Open source file with read/write sharing permissions.
-  hSrcFile = CreateFile(pfi->m_sSrcFile, GENERIC_READ, 
-    FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
-  if(hSrcFile==INVALID_HANDLE_VALUE)
-  {
-    pfi->m_sErrorStatus = Utility::FormatErrorMsg(GetLastError());
-    str.Format(_T("Error opening file %s."), pfi->m_sSrcFile);
-    m_Assync.SetProgress(str, 0, false);
-    goto cleanup;
-  }
-
-  // If we should make a copy of the file
-  if(pfi->m_bMakeCopy)
-  {
-    str.Format(_T("Copying file %s."), pfi->m_sSrcFile);
-    m_Assync.SetProgress(str, 0, false);
-
-    bGetSize = GetFileSizeEx(hSrcFile, &lFileSize);
-    if(!bGetSize)
-    {
-      pfi->m_sErrorStatus = Utility::FormatErrorMsg(GetLastError());
-      str.Format(_T("Couldn't get file size of %s"), pfi->m_sSrcFile);
-      m_Assync.SetProgress(str, 0, false);
-      CloseHandle(hSrcFile);
-      hSrcFile = INVALID_HANDLE_VALUE;
-      goto cleanup;
-    }
-
-    sDestFile = sErrorReportDir + _T("\\") + pfi->m_sDestFile;
-
-    hDestFile = CreateFile(sDestFile, GENERIC_WRITE, 
-      FILE_SHARE_READ, NULL, CREATE_ALWAYS, 0, NULL);
-    if(hDestFile==INVALID_HANDLE_VALUE)
-    {
-      pfi->m_sErrorStatus = Utility::FormatErrorMsg(GetLastError());
-      str.Format(_T("Error creating file %s."), sDestFile);
-      m_Assync.SetProgress(str, 0, false);
-      CloseHandle(hSrcFile);
-      hSrcFile = INVALID_HANDLE_VALUE;
-      goto cleanup;
-    }
-
-    lTotalWritten.QuadPart = 0;
-
-    for(;;)
-    {        
-      if(m_Assync.IsCancelled())
-        goto cleanup;
-
-      bRead = ReadFile(hSrcFile, buffer, 1024, &dwBytesRead, NULL);
-      if(!bRead || dwBytesRead==0)
-        break;
-
-      bWrite = WriteFile(hDestFile, buffer, dwBytesRead, &dwBytesWritten, NULL);
-      if(!bWrite || dwBytesRead!=dwBytesWritten)
-        break;
+  CErrorReportSender* pSender = (CErrorReportSender*)pParam;
 
-      lTotalWritten.QuadPart += dwBytesWritten;
+  if(uTotal!=0)
+    pSender->m_Assync.SetProgress((int)(100.0*uDone/uTotal), false);
 
-      int nProgress = (int)(100.0f*lTotalWritten.QuadPart/lFileSize.QuadPart);
-
-      m_Assync.SetProgress(nProgress, false);
-    }
-
-    CloseHandle(hSrcFile);
-    hSrcFile = INVALID_HANDLE_VALUE;
-    CloseHandle(hDestFile);
-    hDestFile = INVALID_HANDLE_VALUE;
-
-    // Use the copy for display and zipping.
-    pfi->m_sSrcFile = sDestFile;
-  }
-
-  bStatus = true;
-
-cleanup:
-
-  if(hSrcFile!=INVALID_HANDLE_VALUE)
-    CloseHandle(hSrcFile);
-
-  if(hDestFile!=INVALID_HANDLE_VALUE)
-    CloseHandle(hDestFile);
-
-
-  return bStatus;
-}
-
-BOOL CErrorReportSender::CollectFilesBySearchTemplate(ERIFileItem* pfi, std::vector<ERIFileItem>& file_list)
-{
-  WTL::CString sMsg;
-  sMsg.Format(_T("Looking for files using search template: %s"), pfi->m_sSrcFile);
-  m_Assync.SetProgress(sMsg, 0);
-
-  // Look for files matching search pattern
-  WIN32_FIND_DATA ffd;		
-  HANDLE hFind = FindFirstFile(pfi->m_sSrcFile, &ffd);
-  if (hFind == INVALID_HANDLE_VALUE) 
-  {
-    // Nothing found
-    m_Assync.SetProgress(_T("Could not find any files matching the search template."), 0);
-    return FALSE;
-  } 
-  else
-  {		
-    // Get owning directory name
-    int nPos = pfi->m_sSrcFile.ReverseFind(_T('\\'));
-    WTL::CString sDir = pfi->m_sSrcFile.Mid(0, nPos);
-
-    // Enumerate matching files 
-    BOOL bFound = TRUE;
-    int nFileCount = 0;
-    while(bFound)
-    {
-      if(m_Assync.IsCancelled())
-        break;
-
-      if((ffd.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY)==0)
-      {
-        WTL::CString sFile = sDir + _T("\\");
-        sFile += ffd.cFileName;
-
-        // Add file to file list.
-        ERIFileItem fi;
-        fi.m_sSrcFile = sFile;
-        fi.m_sDestFile = ffd.cFileName;
-        fi.m_sDesc = pfi->m_sDesc;
-        fi.m_bMakeCopy = pfi->m_bMakeCopy;
-        fi.m_bAllowDelete = pfi->m_bAllowDelete;
-        file_list.push_back(fi);
-
-        CollectSingleFile(&fi);
-
-        nFileCount++;
-      }
-
-      // Go to next file
-      bFound = FindNextFile(hFind, &ffd);
-    }
-
-    // Clean up
-    FindClose(hFind);
-  }
-
-  // Done
-  return TRUE;
+  return !pSender->m_Assync.IsCancelled();
 }
 
 // This method dumps a registry key contents to an XML file
@@ -1663,58 +1576,91 @@ int CErrorReportSender::DumpRegKey(HKEY hParentKey, WTL::CString sSubKey, TiXmlE
   return 0;
 }
 
-// This method calculates an MD5 hash for the file
-int CErrorReportSender::CalcFileMD5Hash(WTL::CString sFileName, WTL::CString& sMD5Hash)
+// This method calculates the digest of the file
+int CErrorReportSender::CalcFileDigest(WTL::CString sFileName, CReportDigest& Digest)
 {
   FILE* f = NULL;  // Handle to file
-  BYTE buff[512];  // Read buffer
-  MD5 md5;         // MD5 hash
-  MD5_CTX md5_ctx; // MD5 context
-  unsigned char md5_hash[16]; // MD5 hash as sequence of bytes
-  int i;
-
-  // Clear output
-  sMD5Hash.Empty();
 
   // Open file
-#if _MSC_VER<1400
-  f = _tfopen(sFileName.GetBuffer(0), _T("rb"));
-#else
-  _tfopen_s(&f, sFileName.GetBuffer(0), _T("rb"));
-#endif
+  _TFOPEN_S(f, sFileName, _T("rb"));
 
   // Check if file has been opened
   if(f==NULL) 
     return -1;
 
-  // Init MD5 context
-  md5.MD5Init(&md5_ctx);
+  // Read file contents in large blocks and hash them
+  bool bHashed = Digest.HashFile(f, m_CrashInfo.m_bSHA256Digest!=FALSE);
+
+  // Close file
+  fclose(f);
 
-  // Read file contents and update MD5 hash as each portion is being read
-  while(!feof(f))
+  return bHashed?0:-1;
+}
+
+// This method saves the digest of ZIP archive next to the archive
+int CErrorReportSender::SaveReportDigest(WTL::CString sZipName, const CReportDigest& Digest)
+{
+  FILE* f = NULL;
+
+  _TFOPEN_S(f, sZipName + _T(".md5"), _T("wt"));
+  if(f==NULL)
+    return -1;
+  fputs(Digest.GetMD5Hash().c_str(), f);
+  fclose(f);
+
+  if(!Digest.GetSHA256Hash().empty())
   {
-    size_t count = fread(buff, 1, 512, f);
-    if(count>0)
-    {
-      md5.MD5Update(&md5_ctx, buff, (unsigned int)count);
-    }
+    _TFOPEN_S(f, sZipName + _T(".sha256"), _T("wt"));
+    if(f==NULL)
+      return -1;
+    fputs(Digest.GetSHA256Hash().c_str(), f);
+    fclose(f);
   }
 
-  // Close file
-  fclose(f);
+  return 0;
+}
+
+// This method returns the digest of ZIP archive. The digest saved when the archive was
+// compressed is used, so the archive is not read again.
+int CErrorReportSender::GetReportDigest(WTL::CString sZipName, WTL::CString& sMD5Hash, WTL::CString& sSHA256Hash)
+{
+  strconv_t strconv;
+  std::string sHash;
+  FILE* f = NULL;
 
-  // Finalize MD5 hash calculation
-  md5.MD5Final(md5_hash, &md5_ctx);
+  sMD5Hash.Empty();
+  sSHA256Hash.Empty();
 
-  // Format hash as a string
-  for(i=0; i<16; i++)
+  _TFOPEN_S(f, sZipName + _T(".md5"), _T("rt"));
+  if(f!=NULL)
   {
-    WTL::CString number;
-    number.Format(_T("%02x"), md5_hash[i]);
-    sMD5Hash += number;
+    if(CReportDigest::ReadHashFile(f, REPORT_DIGEST_MD5_LEN, sHash))
+      sMD5Hash = strconv.a2t(sHash.c_str());
+    fclose(f);
   }
 
-  // Done
+  if(m_CrashInfo.m_bSHA256Digest)
+  {
+    _TFOPEN_S(f, sZipName + _T(".sha256"), _T("rt"));
+    if(f!=NULL)
+    {
+      if(CReportDigest::ReadHashFile(f, REPORT_DIGEST_SHA256_LEN, sHash))
+        sSHA256Hash = strconv.a2t(sHash.c_str());
+      fclose(f);
+    }
+  }
+
+  if(!sMD5Hash.IsEmpty() && (!m_CrashInfo.m_bSHA256Digest || !sSHA256Hash.IsEmpty()))
+    return 0; // Digest was saved
+
+  // Calculate the digest and save it for other transports
+  CReportDigest Digest;
+  if(0!=CalcFileDigest(sZipName, Digest))
+    return -1;
+  SaveReportDigest(sZipName, Digest);
+
+  sMD5Hash = strconv.a2t(Digest.GetMD5Hash().c_str());
+  sSHA256Hash = strconv.a2t(Digest.GetSHA256Hash().c_str());
   return 0;
 }
 
@@ -1787,7 +1733,96 @@ BOOL CErrorReportSender::RestartApp()
   return TRUE;
 }
 
+// State of the file being compressed, passed to compression callbacks.
+struct CompressFileState
+{
+  CErrorReportSender* m_pSender; // Owner
+  HANDLE m_hFile;                // Source file
+  LONG64 m_lFileLeft;            // Bytes left to read from a snapshot, -1 to read up to the end of file
+  zipFile m_hZip;                // ZIP archive
+  LONG64 m_lTotalSize;           // Total size of files
+  LONG64 m_lTotalCompressed;     // Size of data read so far
+};
+
+// Reads data samples used to choose the compression method of the file, then
+// moves the file pointer back to the beginning of the file.
+static BOOL ReadFileSamples(HANDLE hFile, ULONG64 uFileSize, std::vector<unsigned char>& aSamples)
+{
+  std::vector<uint64_t> aOffsets;
+  LARGE_INTEGER lPos;
+  size_t i;
+
+  aSamples.clear();
+  CCompressionPolicy::GetSampleOffsets(uFileSize, aOffsets);
+  aSamples.resize(aOffsets.size()*CPOLICY_SAMPLE_SIZE);
+
+  size_t uSamplesSize = 0;
+  for(i=0; i<aOffsets.size(); i++)
+  {
+    DWORD dwBytesRead = 0;
+    lPos.QuadPart = (LONGLONG)aOffsets[i];
+    if(!SetFilePointerEx(hFile, lPos, NULL, FILE_BEGIN) ||
+      !ReadFile(hFile, &aSamples[uSamplesSize], CPOLICY_SAMPLE_SIZE, &dwBytesRead, NULL))
+      break;
+    uSamplesSize += dwBytesRead;
+  }
+  aSamples.resize(uSamplesSize);
+
+  lPos.QuadPart = 0;
+  return SetFilePointerEx(hFile, lPos, NULL, FILE_BEGIN);
+}
+
+bool CErrorReportSender::CompressReadCallback(void* pBuf, size_t uSize, size_t* puRead, void* pParam)
+{
+  CompressFileState* pState = (CompressFileState*)pParam;
+  DWORD dwBytesRead = 0;
+
+  *puRead = 0;
+
+  // Check if operation was cancelled by user
+  if(pState->m_pSender->m_Assync.IsCancelled())
+    return false;
+
+  // Data appended to a snapshot after the crash are not read
+  if(pState->m_lFileLeft>=0 && (LONG64)uSize>pState->m_lFileLeft)
+    uSize = (size_t)pState->m_lFileLeft;
+
+  // Read a portion of source file
+  if(uSize!=0 && !ReadFile(pState->m_hFile, pBuf, (DWORD)uSize, &dwBytesRead, NULL))
+    return false;
+
+  *puRead = dwBytesRead;
+  if(pState->m_lFileLeft>=0)
+    pState->m_lFileLeft -= dwBytesRead;
+
+  // Update totals
+  pState->m_lTotalCompressed += dwBytesRead;
+
+  // Update progress
+  if(pState->m_lTotalSize!=0)
+  {
+    float fProgress = 100.0f*pState->m_lTotalCompressed/pState->m_lTotalSize;
+    pState->m_pSender->m_Assync.SetProgress((int)fProgress, false);
+  }
+
+  return true;
+}
+
+bool CErrorReportSender::CompressWriteCallback(const void* pData, size_t uSize, void* pParam)
+{
+  CompressFileState* pState = (CompressFileState*)pParam;
+
+  return zipWriteInFileInZip(pState->m_hZip, pData, (unsigned)uSize)==ZIP_OK;
+}
+
 // This method compresses the files contained in the report and produces a ZIP archive.
+// Files are read with large buffers and compressed by a thread per processor; the
+// compressed data are stored to the archive in raw mode. Files that are already
+// compressed are stored as is, and large files use a faster deflate level (see
+// CCompressionPolicy). Entries of large files have ZIP64 extensions, so reports
+// with full-memory dumps over 4 GB can be archived. The archive is written
+// sequentially (CRC and sizes follow the data), so its MD5 hash is calculated on
+// the fly instead of reading the archive again.
 BOOL CErrorReportSender::CompressReportFiles(CErrorReportInfo* eri)
 { 
   BOOL bStatus = FALSE;
@@ -1795,13 +1830,21 @@ BOOL CErrorReportSender::CompressReportFiles(CErrorReportInfo* eri)
   zipFile hZip = NULL;
   WTL::CString sMsg;
   LONG64 lTotalSize = 0;
-  LONG64 lTotalCompressed = 0;
-  BYTE buff[1024];
-  DWORD dwBytesRead=0;
   HANDLE hFile = INVALID_HANDLE_VALUE;  
   std::map<WTL::CString, ERIFileItem>::iterator it;
-  FILE* f = NULL;
-  WTL::CString sMD5Hash;
+  CReportDigest Digest;
+  CParallelDeflate deflate;
+  CHashingFileFunc hashing;
+  zlib_filefunc64_def filefunc;
+  CompressFileState state;
+  std::vector<unsigned char> aSamples;
+
+  state.m_pSender = this;
+  state.m_hFile = INVALID_HANDLE_VALUE;
+  state.m_lFileLeft = -1;
+  state.m_hZip = NULL;
+  state.m_lTotalSize = 0;
+  state.m_lTotalCompressed = 0;
 
   // Add a different log message depending on the current mode.
   if(m_bExport)
@@ -1822,18 +1865,42 @@ BOOL CErrorReportSender::CompressReportFiles(CErrorReportInfo* eri)
   else
     m_sZipName = eri->GetErrorReportDirName() + _T(".zip");  
 
+  // Remove the digest of previous archive, it is saved again when the new archive is ready
+  if(!m_bExport)
+  {
+    Utility::RecycleFile(m_sZipName+_T(".md5"), true);
+    Utility::RecycleFile(m_sZipName+_T(".sha256"), true);
+  }
+
+  // Start compression threads
+  if(deflate.Init(Z_DEFAULT_COMPRESSION)!=PDEFLATE_OK)
+  {
+    m_Assync.SetProgress(_T("Failed to start compression threads."), 100, true);
+    goto cleanup;
+  }
+
+  sMsg.Format(_T("Compressing with %d thread(s)"), deflate.GetThreadCount());
+  m_Assync.SetProgress(sMsg, 0, false);
+
   // Update progress
   sMsg.Format(_T("Creating ZIP archive file %s"), m_sZipName);
   m_Assync.SetProgress(sMsg, 1, false);
 
-  // Create ZIP archive
-  hZip = zipOpen((const char*)m_sZipName.GetBuffer(0), APPEND_STATUS_CREATE);
+  // Create ZIP archive, hashing its contents as they are written
+  zlib_filefunc64_def basefunc;
+  fill_fopen64_filefunc(&basefunc);
+  hashing.SetSHA256(!m_bExport && m_CrashInfo.m_bSHA256Digest);
+  hashing.Wrap(&basefunc, &filefunc);
+  hZip = zipOpen2_64(m_sZipName.GetBuffer(0), APPEND_STATUS_CREATE, NULL, &filefunc);
   if(hZip==NULL)
   {
     m_Assync.SetProgress(_T("Failed to create ZIP file."), 100, true);
     goto cleanup;
   }
 
+  state.m_hZip = hZip;
+  state.m_lTotalSize = lTotalSize;
+
   // Enumerate files contained in the report
   int i;
   for(i=0; i<eri->GetFileItemCount(); i++)
@@ -1855,9 +1922,12 @@ BOOL CErrorReportSender::CompressReportFiles(CErrorReportInfo* eri)
     sMsg.Format(_T("Compressing file %s"), sDstFileName);
     m_Assync.SetProgress(sMsg, 0, false);
 
-    // Open file for reading
+    // Open file for reading. The application may still be writing to a snapshot.
+    DWORD dwShareMode = FILE_SHARE_READ;
+    if(pfi->m_lSnapshotSize>=0)
+      dwShareMode |= FILE_SHARE_WRITE;
     hFile = CreateFile(sFileName, 
-      GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, NULL, NULL); 
+      GENERIC_READ, dwShareMode, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL); 
     if(hFile==INVALID_HANDLE_VALUE)
     {
       sMsg.Format(_T("Couldn't open file %s"), sFileName);
@@ -1873,6 +1943,38 @@ BOOL CErrorReportSender::CompressReportFiles(CErrorReportInfo* eri)
     SYSTEMTIME st;
     FileTimeToSystemTime(&fi.ftLastWriteTime, &st);
 
+    // Size of data to be put into the archive
+    ULONG64 uFileSize = ((ULONG64)fi.nFileSizeHigh<<32)|fi.nFileSizeLow;
+    if(pfi->m_lSnapshotSize>=0 && (ULONG64)pfi->m_lSnapshotSize<uFileSize)
+      uFileSize = (ULONG64)pfi->m_lSnapshotSize;
+
+    // Choose compression method and level. Files of unknown type are sampled.
+    const char* szZipFileName = strconv.t2a(sDstFileName.GetBuffer(0));
+    int nMethod = CPOLICY_METHOD_DEFLATE;
+    int nLevel = Z_DEFAULT_COMPRESSION;
+    aSamples.clear();
+    if(CCompressionPolicy::ClassifyByName(szZipFileName)==CPOLICY_CLASS_UNKNOWN &&
+      !ReadFileSamples(hFile, uFileSize, aSamples))
+    {
+      sMsg.Format(_T("Couldn't read file %s"), sFileName);
+      m_Assync.SetProgress(sMsg, 0, false);
+      CloseHandle(hFile);
+      hFile = INVALID_HANDLE_VALUE;
+      continue;
+    }
+    CCompressionPolicy::Choose(szZipFileName, uFileSize,
+      aSamples.empty()?NULL:&aSamples[0], aSamples.size(), nMethod, nLevel);
+
+    if(nMethod==CPOLICY_METHOD_STORE)
+      sMsg.Format(_T("Storing file %s without compression"), sDstFileName);
+    else
+      sMsg.Format(_T("Compressing file %s with level %d"), sDstFileName, nLevel);
+    m_Assync.SetProgress(sMsg, 0, false);
+
+    // ZIP64 extensions are needed when sizes don't fit 32 bits. Deflated data may be
+    // slightly larger than the input, so the limit has a margin.
+    int nZip64 = uFileSize>=0xF0000000?1:0;
+
     // Fill in the ZIP file info
     zip_fileinfo info;
     info.dosDate = 0;
@@ -1885,48 +1987,46 @@ BOOL CErrorReportSender::CompressReportFiles(CErrorReportInfo* eri)
     info.external_fa = FILE_ATTRIBUTE_NORMAL;
     info.internal_fa = FILE_ATTRIBUTE_NORMAL;
 
-    // Create new file inside of our ZIP archive
-    int n = zipOpenNewFileInZip( hZip, (const char*)strconv.t2a(sDstFileName.GetBuffer(0)), &info,
-      NULL, 0, NULL, 0, strconv.t2a(sDesc), Z_DEFLATED, Z_DEFAULT_COMPRESSION);
+    // Create new file inside of our ZIP archive. The data are compressed by us (raw mode),
+    // CRC and sizes are written after the data (general purpose flag bit 3).
+    int n = zipOpenNewFileInZip4_64( hZip, szZipFileName, &info,
+      NULL, 0, NULL, 0, strconv.t2a(sDesc), nMethod, nLevel, 1,
+      -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY, NULL, 0, 0, 8, nZip64);
     if(n!=0)
     {
       sMsg.Format(_T("Couldn't compress file %s"), sDstFileName);
       m_Assync.SetProgress(sMsg, 0, false);
+      CloseHandle(hFile);
+      hFile = INVALID_HANDLE_VALUE;
       continue;
     }
 
-    // Read source file contents and write it to ZIP archive
-    for(;;)
+    // Read source file contents, compress it and write to ZIP archive
+    state.m_hFile = hFile;
+    state.m_lFileLeft = pfi->m_lSnapshotSize;
+    int nResult = PDEFLATE_OK;
+    if(nMethod==CPOLICY_METHOD_STORE)
     {
-      // Check if operation was cancelled by user
-      if(m_Assync.IsCancelled())    
-        goto cleanup;
-
-      // Read a portion of source file
-      BOOL bRead = ReadFile(hFile, buff, 1024, &dwBytesRead, NULL);
-      if(!bRead || dwBytesRead==0)
-        break;
-
-      // Write a portion into destination file
-      int res = zipWriteInFileInZip(hZip, buff, dwBytesRead);
-      if(res!=0)
-      {
-        zipCloseFileInZip(hZip);
-        sMsg.Format(_T("Couldn't write to compressed file %s"), sDstFileName);
-        m_Assync.SetProgress(sMsg, 0, false);        
-        break;
-      }
+      nResult = deflate.Store(CompressReadCallback, CompressWriteCallback, &state);
+    }
+    else
+    {
+      deflate.SetLevel(nLevel);
+      nResult = deflate.Compress(CompressReadCallback, CompressWriteCallback, &state);
+    }
 
-      // Update totals
-      lTotalCompressed += dwBytesRead;
+    // Check if operation was cancelled by user
+    if(m_Assync.IsCancelled())    
+      goto cleanup;
 
-      // Update progress
-      float fProgress = 100.0f*lTotalCompressed/lTotalSize;
-      m_Assync.SetProgress((int)fProgress, false);
+    if(nResult!=PDEFLATE_OK)
+    {
+      sMsg.Format(_T("Couldn't write to compressed file %s"), sDstFileName);
+      m_Assync.SetProgress(sMsg, 0, false);        
     }
 
     // Close file
-    zipCloseFileInZip(hZip);
+    zipCloseFileInZipRaw64(hZip, deflate.GetInputSize(), deflate.GetCrc32());
     CloseHandle(hFile);
     hFile = INVALID_HANDLE_VALUE;
   }
@@ -1938,39 +2038,37 @@ BOOL CErrorReportSender::CompressReportFiles(CErrorReportInfo* eri)
     hZip = NULL;
   }
 
-  // Save MD5 hash file
+  // Save digest files
   if(!m_bExport)
   {
-    sMsg.Format(_T("Calculating MD5 hash for file %s"), m_sZipName);
-    m_Assync.SetProgress(sMsg, 0, false);
+    // The digest is calculated while the archive is written, read the archive
+    // only if minizip had to seek back and rewrite it
+    int nCalcDigest = 0;
+    if(!hashing.GetDigest(Digest))
+    {
+      sMsg.Format(_T("Calculating MD5 hash for file %s"), m_sZipName);
+      m_Assync.SetProgress(sMsg, 0, false);
 
-    int nCalcMD5 = CalcFileMD5Hash(m_sZipName, sMD5Hash);
-    if(nCalcMD5!=0)
+      nCalcDigest = CalcFileDigest(m_sZipName, Digest);
+    }
+
+    if(nCalcDigest!=0)
     {
       sMsg.Format(_T("Couldn't calculate MD5 hash for file %s"), m_sZipName);
       m_Assync.SetProgress(sMsg, 0, false);
       goto cleanup;
     }
 
-#if _MSC_VER <1400
-    f = _tfopen(m_sZipName + _T(".md5"), _T("wt"));
-#else
-    _tfopen_s(&f, m_sZipName + _T(".md5"), _T("wt"));
-#endif
-    if(f==NULL)
+    if(0!=SaveReportDigest(m_sZipName, Digest))
     {
       sMsg.Format(_T("Couldn't save MD5 hash for file %s"), m_sZipName);
       m_Assync.SetProgress(sMsg, 0, false);
       goto cleanup;
     }
-
-    _ftprintf(f, sMD5Hash);
-    fclose(f);
-    f = NULL;
   }
 
   // Check if totals match
-  if(lTotalSize==lTotalCompressed)
+  if(lTotalSize==state.m_lTotalCompressed)
     bStatus = TRUE;
 
 cleanup:
@@ -1983,9 +2081,6 @@ cleanup:
   if(hFile!=INVALID_HANDLE_VALUE)
     CloseHandle(hFile);
 
-  if(f!=NULL)
-    fclose(f);
-
   if(bStatus)
     m_Assync.SetProgress(_T("Finished compressing files...OK"), 100, true);
   else
@@ -2040,6 +2135,10 @@ BOOL CErrorReportSender::SendReport()
 
     int id = rit->second;
 
+    // Don't upload the report over HTTP again if it has just failed
+    if(id==CR_HTTP && m_HttpFailedReports.find(m_nCurReport)!=m_HttpFailedReports.end())
+      continue;
+
     BOOL bResult = FALSE;
 
     // Send the report
@@ -2072,6 +2171,7 @@ BOOL CErrorReportSender::SendReport()
   // Remove compressed ZIP file and MD5 file
   Utility::RecycleFile(m_sZipName, true);
   Utility::RecycleFile(m_sZipName+_T(".md5"), true);
+  Utility::RecycleFile(m_sZipName+_T(".sha256"), true);
 
   // Check status
   if(status==0)
@@ -2096,6 +2196,9 @@ BOOL CErrorReportSender::SendReport()
     }
   }
 
+  // Update the index of queued reports
+  m_CrashInfo.UpdateReportIndexStatus(m_nCurReport);
+
   // Done
   m_nStatus = status;
   m_Assync.SetCompleted(status);  
@@ -2105,8 +2208,6 @@ BOOL CErrorReportSender::SendReport()
 // This method sends the report over HTTP request
 BOOL CErrorReportSender::SendOverHTTP()
 {  
-  strconv_t strconv;
-
   // Check our config - should we send the report over HTTP or not?
   if(m_CrashInfo.m_uPriorities[CR_HTTP]==CR_NEGATIVE_PRIORITY)
   {
@@ -2127,9 +2228,19 @@ BOOL CErrorReportSender::SendOverHTTP()
 
   // Create HTTP request
   CHttpRequest request;
-  request.m_sUrl = m_CrashInfo.m_sUrl;  
+  FormatHttpRequest(m_CrashInfo.GetReport(m_nCurReport), m_sZipName, request);
 
-  CErrorReportInfo* eri = m_CrashInfo.GetReport(m_nCurReport);
+  // Send HTTP request assynchronously
+  BOOL bSend = m_HttpSender.SendAssync(request, &m_Assync);  
+  return bSend;
+}
+
+// This method fills in the HTTP request fields
+void CErrorReportSender::FormatHttpRequest(CErrorReportInfo* eri, WTL::CString sZipName, CHttpRequest& request)
+{
+  strconv_t strconv;
+
+  request.m_sUrl = m_CrashInfo.m_sUrl;  
 
   // Fill in the request fields
   WTL::CString sNum;
@@ -2148,63 +2259,19 @@ BOOL CErrorReportSender::SendOverHTTP()
   sNum.Format(_T("%I64u"), eri->GetExceptionAddress());
   request.m_aTextFields[_T("exceptionaddress")] = strconv.t2utf8(sNum);
 
-  // Add an MD5 hash of file attachment
+  // Add an MD5 hash (and SHA-256 hash, if enabled) of file attachment
   WTL::CString sMD5Hash;
-  CalcFileMD5Hash(m_sZipName, sMD5Hash);
+  WTL::CString sSHA256Hash;
+  GetReportDigest(sZipName, sMD5Hash, sSHA256Hash);
   request.m_aTextFields[_T("md5")] = strconv.t2utf8(sMD5Hash);
+  if(!sSHA256Hash.IsEmpty())
+    request.m_aTextFields[_T("sha256")] = strconv.t2utf8(sSHA256Hash);
 
   // Set content type 
   CHttpRequestFile f;
-  f.m_sSrcFileName = m_sZipName;
+  f.m_sSrcFileName = sZipName;
   f.m_sContentType = _T("application/zip");  
   request.m_aIncludedFiles[_T("crashrpt")] = f;  
-
-  // Send HTTP request assynchronously
-  BOOL bSend = m_HttpSender.SendAssync(request, &m_Assync);  
-  return bSend;
-}
-
-int CErrorReportSender::Base64EncodeAttachment(WTL::CString sFileName, WTL::CString& sEncodedFileData)
-{
-  int uFileSize = 0;
-  BYTE* uchFileData = NULL;
-  struct _stat st;
-
-  // Get file information
-  int nResult = _tstat(sFileName, &st);
-  if(nResult != 0)
-    return 1;  // File not found.
-
-  // Allocate buffer of file size
-  uFileSize = (int)st.st_size;
-  uchFileData = new BYTE[uFileSize];
-
-  // Read file data to buffer.
-  FILE* f = NULL;
-#if _MSC_VER<1400
-  f = _tfopen(sFileName, _T("rb"));
-#else
-  /*errno_t err = */_tfopen_s(&f, sFileName, _T("rb"));
-#endif 
-
-  if(!f || fread(uchFileData, uFileSize, 1, f)!=1)
-  {
-    delete [] uchFileData;
-    uchFileData = NULL;
-    return 2; // Coudln't read file data.
-  }
-
-  // Close file
-  fclose(f);
-
-  // BASE-64 ecode data
-  sEncodedFileData = base64_encode(uchFileData, uFileSize).c_str();
-
-  // Clean up
-  delete [] uchFileData;
-
-  // OK.
-  return 0;
 }
 
 // This method formats the E-mail message text
@@ -2247,8 +2314,6 @@ WTL::CString CErrorReportSender::FormatEmailText()
 // This method sends the report over SMTP 
 BOOL CErrorReportSender::SendOverSMTP()
 {  
-  strconv_t strconv;
-
   // Check our config - should we send the report over SMTP or not?
   if(m_CrashInfo.m_uPriorities[CR_SMTP]==CR_NEGATIVE_PRIORITY)
   {
@@ -2287,26 +2352,14 @@ BOOL CErrorReportSender::SendOverSMTP()
 
   m_EmailMsg.AddAttachment(m_sZipName);  
 
-  // Create and attach MD5 hash file
+  // Attach the digest files saved next to the archive
   WTL::CString sErrorRptHash;
-  CalcFileMD5Hash(m_sZipName, sErrorRptHash);
-  WTL::CString sFileTitle = m_sZipName;
-  sFileTitle.Replace('/', '\\');
-  int pos = sFileTitle.ReverseFind('\\');
-  if(pos>=0)
-    sFileTitle = sFileTitle.Mid(pos+1);
-  sFileTitle += _T(".md5");
-  WTL::CString sTempDir;
-  Utility::getTempDirectory(sTempDir);
-  WTL::CString sTmpFileName = sTempDir +_T("\\")+ sFileTitle;
-  FILE* f = NULL;
-  _TFOPEN_S(f, sTmpFileName, _T("wt"));
-  if(f!=NULL)
-  {   
-    LPCSTR szErrorRptHash = strconv.t2a(sErrorRptHash.GetBuffer(0));
-    fwrite(szErrorRptHash, strlen(szErrorRptHash), 1, f);
-    fclose(f);
-    m_EmailMsg.AddAttachment(sTmpFileName);  
+  WTL::CString sSHA256Hash;
+  if(0==GetReportDigest(m_sZipName, sErrorRptHash, sSHA256Hash))
+  {
+    m_EmailMsg.AddAttachment(m_sZipName + _T(".md5"));  
+    if(!sSHA256Hash.IsEmpty())
+      m_EmailMsg.AddAttachment(m_sZipName + _T(".sha256"));  
   }
 
   // Set SMTP proxy server (if specified)
@@ -2324,8 +2377,6 @@ BOOL CErrorReportSender::SendOverSMTP()
 // This method sends the report over Simple MAPI
 BOOL CErrorReportSender::SendOverSMAPI()
 {  
-  strconv_t strconv;
-
   // Check our config - should we send the report over Simple MAPI or not?
   if(m_CrashInfo.m_uPriorities[CR_SMAPI]==CR_NEGATIVE_PRIORITY)
   {
@@ -2418,21 +2469,14 @@ BOOL CErrorReportSender::SendOverSMAPI()
     m_MapiSender.SetMessage(m_CrashInfo.m_sEmailText);
   m_MapiSender.AddAttachment(m_sZipName, sFileTitle);
 
-  // Create and attach MD5 hash file
+  // Attach the digest files saved next to the archive
   WTL::CString sErrorRptHash;
-  CalcFileMD5Hash(m_sZipName, sErrorRptHash);
-  sFileTitle += _T(".md5");
-  WTL::CString sTempDir;
-  Utility::getTempDirectory(sTempDir);
-  WTL::CString sTmpFileName = sTempDir +_T("\\")+ sFileTitle;
-  FILE* f = NULL;
-  _TFOPEN_S(f, sTmpFileName, _T("wt"));
-  if(f!=NULL)
-  { 
-    LPCSTR szErrorRptHash = strconv.t2a(sErrorRptHash.GetBuffer(0));
-    fwrite(szErrorRptHash, strlen(szErrorRptHash), 1, f);
-    fclose(f);
-    m_MapiSender.AddAttachment(sTmpFileName, sFileTitle);  
+  WTL::CString sSHA256Hash;
+  if(0==GetReportDigest(m_sZipName, sErrorRptHash, sSHA256Hash))
+  {
+    m_MapiSender.AddAttachment(m_sZipName + _T(".md5"), sFileTitle + _T(".md5"));  
+    if(!sSHA256Hash.IsEmpty())
+      m_MapiSender.AddAttachment(m_sZipName + _T(".sha256"), sFileTitle + _T(".sha256"));  
   }
 
   // Send email
@@ -2462,6 +2506,11 @@ BOOL CErrorReportSender::SendRecentReports()
   m_bSendingNow = TRUE;
   m_bErrors = FALSE;
 
+  // Upload reports over HTTP several at once, if possible. The reports that
+  // fail to upload remain pending and are sent in turn below over other transports.
+  if(CanSendConcurrently())
+    SendRecentReportsConcurrently();
+
   // Send error reports in turn
   BOOL bSend = TRUE;
   int nReport = -1;
@@ -2550,6 +2599,7 @@ BOOL CErrorReportSender::SendNextReport(int nReport)
   {
     eri->SetDeliveryStatus(DELIVERED);
   }
+  m_CrashInfo.UpdateReportIndexStatus(m_nCurReport);
 
   // Notify GUI about current item change
   if(IsWindow(m_hWndNotify))
@@ -2559,6 +2609,218 @@ BOOL CErrorReportSender::SendNextReport(int nReport)
   return TRUE;
 }
 
+BOOL CErrorReportSender::CanSendConcurrently()
+{
+  // Reports are uploaded concurrently only over HTTP, and only if HTTP
+  // is the transport tried first.
+  if(m_CrashInfo.m_uPriorities[CR_HTTP]==CR_NEGATIVE_PRIORITY)
+    return FALSE;
+
+  if(m_CrashInfo.m_sUrl.IsEmpty())
+    return FALSE;
+
+  if(m_CrashInfo.m_uPriorities[CR_HTTP]<m_CrashInfo.m_uPriorities[CR_SMTP] ||
+     m_CrashInfo.m_uPriorities[CR_HTTP]<m_CrashInfo.m_uPriorities[CR_SMAPI])
+    return FALSE;
+
+  return TRUE;
+}
+
+// State of concurrent delivery of queued reports
+struct ConcurrentDeliveryState
+{
+  CErrorReportSender* m_pSender;      // Sender
+  ATL::CComAutoCriticalSection m_cs;  // Protects delivery statuses of reports
+  std::vector<WTL::CString> m_asZipNames; // ZIP archives of reports (empty if not compressed yet)
+  std::vector<BOOL> m_abCompressed;   // Reports compressed successfully
+  BOOL m_bFallback;                   // TRUE if reports failed over HTTP may be sent over other transports
+};
+
+void CErrorReportSender::SendRecentReportsConcurrently()
+{
+  ConcurrentDeliveryState state;
+  CDeliveryScheduler scheduler;
+  WTL::CString sMsg;
+
+  state.m_pSender = this;
+  state.m_asZipNames.resize(m_CrashInfo.GetReportCount());
+  state.m_abCompressed.resize(m_CrashInfo.GetReportCount(), FALSE);
+  state.m_bFallback = 
+    m_CrashInfo.m_uPriorities[CR_SMTP]!=CR_NEGATIVE_PRIORITY ||
+    m_CrashInfo.m_uPriorities[CR_SMAPI]!=CR_NEGATIVE_PRIORITY;
+
+  m_HttpFailedReports.clear();
+
+  sMsg.Format(_T("Uploading error reports over HTTP, up to %d at once"), DELIVERY_DEFAULT_CONCURRENCY);
+  m_Assync.SetProgress(sMsg, 0, false);
+
+  // Compress reports in this thread while previous ones are being uploaded
+  scheduler.Run(DELIVERY_DEFAULT_CONCURRENCY, 
+    DeliveryNextCallback, DeliveryPrepareCallback, 
+    DeliveryDeliverCallback, DeliveryDoneCallback, &state);
+
+  sMsg.Format(_T("Uploaded %d error report(s) over HTTP, %d failed"), 
+    scheduler.GetDeliveredCount(), scheduler.GetFailedCount());
+  m_Assync.SetProgress(sMsg, 0, false);
+}
+
+int CErrorReportSender::DeliveryNextCallback(void* pParam)
+{
+  ConcurrentDeliveryState* pState = (ConcurrentDeliveryState*)pParam;
+  CErrorReportSender* pSender = pState->m_pSender;
+  CCrashInfoReader& CrashInfo = pSender->m_CrashInfo;
+
+  if(pSender->m_Assync.IsCancelled())
+    return -1; // Stop taking reports
+
+  // Ask GUI for hint what report to send next (to keep the list order)
+  int nReport = -1;
+  if(IsWindow(pSender->m_hWndNotify))
+    nReport = (int)::SendMessage(pSender->m_hWndNotify, WM_NEXT_ITEM_HINT, 0, 0);
+
+  ATL::CComCritSecLock<ATL::CComAutoCriticalSection> lock(pState->m_cs);
+
+  // Reports failed over HTTP remain pending, but they are not taken again
+  CErrorReportInfo* eri = NULL;
+  if(nReport>=0 && nReport<CrashInfo.GetReportCount())
+  {
+    eri = CrashInfo.GetReport(nReport);
+    if(!eri->IsSelected() || eri->GetDeliveryStatus()!=PENDING ||
+       pSender->m_HttpFailedReports.find(nReport)!=pSender->m_HttpFailedReports.end())
+      eri = NULL;
+  }
+
+  if(eri==NULL)
+  {
+    int i;
+    for(i=0; i<CrashInfo.GetReportCount(); i++)
+    {
+      CErrorReportInfo* pERI = CrashInfo.GetReport(i);
+      if(pERI->IsSelected() && pERI->GetDeliveryStatus()==PENDING &&
+         pSender->m_HttpFailedReports.find(i)==pSender->m_HttpFailedReports.end())
+      {
+        nReport = i;
+        eri = pERI;
+        break;
+      }
+    }
+  }
+
+  if(eri==NULL)
+    return -1; // No more reports
+
+  // The report being compressed is the current one
+  pSender->m_nCurReport = nReport;
+  eri->SetDeliveryStatus(INPROGRESS);
+
+  // Notify GUI about item status change
+  if(IsWindow(pSender->m_hWndNotify))
+    ::PostMessage(pSender->m_hWndNotify, WM_ITEM_STATUS_CHANGED, (WPARAM)nReport, (LPARAM)INPROGRESS);
+
+  return nReport;
+}
+
+bool CErrorReportSender::DeliveryPrepareCallback(int nReport, void* pParam)
+{
+  ConcurrentDeliveryState* pState = (ConcurrentDeliveryState*)pParam;
+  CErrorReportSender* pSender = pState->m_pSender;
+  CErrorReportInfo* eri = pSender->m_CrashInfo.GetReport(nReport);
+
+  // Add a message to log
+  WTL::CString sMsg;
+  sMsg.Format(_T(">>> Performing actions with error report: '%s'"), eri->GetErrorReportDirName());
+  pSender->m_Assync.SetProgress(sMsg, 0, false);
+
+  // Reports are compressed one at a time in this thread, so the shared ZIP name may be used
+  BOOL bCompress = pSender->CompressReportFiles(eri);
+  pState->m_asZipNames[nReport] = pSender->m_sZipName;
+  pState->m_abCompressed[nReport] = bCompress;
+
+  return bCompress?true:false;
+}
+
+bool CErrorReportSender::DeliveryDeliverCallback(int nReport, void* pParam)
+{
+  ConcurrentDeliveryState* pState = (ConcurrentDeliveryState*)pParam;
+  CErrorReportSender* pSender = pState->m_pSender;
+  CErrorReportInfo* eri = pSender->m_CrashInfo.GetReport(nReport);
+
+  // Each upload has its own sender and notification object; messages 
+  // are forwarded to the main one and it cancels all uploads
+  AsyncNotification an;
+  CHttpRequestSender HttpSender;
+  CHttpRequest request;
+  WTL::CString sPrefix;
+  sPrefix.Format(_T("[%d] "), nReport);
+  an.SetParent(&pSender->m_Assync, sPrefix);
+
+  an.SetProgress(_T("Sending error report over HTTP..."), 0);
+  pSender->FormatHttpRequest(eri, pState->m_asZipNames[nReport], request);
+
+  if(!HttpSender.SendAssync(request, &an))
+    return false;
+
+  return an.WaitForCompletion()==0;
+}
+
+void CErrorReportSender::DeliveryDoneCallback(int nReport, bool bDelivered, void* pParam)
+{
+  ConcurrentDeliveryState* pState = (ConcurrentDeliveryState*)pParam;
+  CErrorReportSender* pSender = pState->m_pSender;
+  CErrorReportInfo* eri = pSender->m_CrashInfo.GetReport(nReport);
+  WTL::CString sMsg;
+
+  // Remove compressed ZIP file and MD5 file
+  WTL::CString sZipName = pState->m_asZipNames[nReport];
+  if(!sZipName.IsEmpty())
+  {
+    Utility::RecycleFile(sZipName, true);
+    Utility::RecycleFile(sZipName+_T(".md5"), true);
+    Utility::RecycleFile(sZipName+_T(".sha256"), true);
+  }
+
+  ATL::CComCritSecLock<ATL::CComAutoCriticalSection> lock(pState->m_cs);
+
+  if(bDelivered)
+  {
+    sMsg.Format(_T("Error report '%s' has been uploaded"), eri->GetErrorReportDirName());
+    pSender->m_Assync.SetProgress(sMsg, 0, false);
+
+    eri->SetDeliveryStatus(DELIVERED);
+    // Delete report files
+    Utility::RecycleFile(eri->GetErrorReportDirName(), true);
+  }
+  else if(pState->m_abCompressed[nReport] && pState->m_bFallback && !pSender->m_Assync.IsCancelled())
+  {
+    sMsg.Format(_T("Error report '%s' failed to upload over HTTP; it will be sent later over other transports"), 
+      eri->GetErrorReportDirName());
+    pSender->m_Assync.SetProgress(sMsg, 0, false);
+
+    // Leave the report for sending in turn
+    pSender->m_HttpFailedReports.insert(nReport);
+    eri->SetDeliveryStatus(PENDING);
+  }
+  else
+  {
+    sMsg.Format(_T("Error report '%s' failed to upload"), eri->GetErrorReportDirName());
+    pSender->m_Assync.SetProgress(sMsg, 0, false);
+
+    pSender->m_bErrors = TRUE;
+    eri->SetDeliveryStatus(FAILED);
+
+    // Check if we should store files for later delivery or we should remove them
+    if(!pSender->m_CrashInfo.m_bQueueEnabled)
+      Utility::RecycleFile(eri->GetErrorReportDirName(), true);
+  }
+
+  // Update the index of queued reports
+  pSender->m_CrashInfo.UpdateReportIndexStatus(nReport);
+
+  // Notify GUI about item status change
+  if(IsWindow(pSender->m_hWndNotify))
+    ::PostMessage(pSender->m_hWndNotify, WM_ITEM_STATUS_CHANGED, (WPARAM)nReport, (LPARAM)eri->GetDeliveryStatus());
+}
+
 BOOL CErrorReportSender::IsSendingNow()
 {
   // Return TRUE if currently sending error report(s)
@@ -2657,6 +2919,12 @@ BOOL CErrorReportSender::RecordVideo()
   else if((dwFlags&CR_AV_QUALITY_BEST)!=0)
     quality = 63;
 
+  // Determine whether to compress frames kept in memory
+  BOOL bCompressFrames = (dwFlags&CR_AV_NO_COMPRESSION)==0;
+
+  // Determine what codec to use
+  BOOL bEncodeVP8 = (dwFlags&CR_AV_CODEC_VP8)!=0;
+
   // Add a message to log
   WTL::CString sMsg;
   sMsg.Format(_T("Start video recording."));
@@ -2678,7 +2946,7 @@ BOOL CErrorReportSender::RecordVideo()
   if(!m_VideoRec.Init(m_CrashInfo.GetReport(0)->GetErrorReportDirName(),
     type, m_CrashInfo.m_dwProcessId, m_CrashInfo.m_nVideoDuration,
     m_CrashInfo.m_nVideoFrameInterval,
-    quality, &m_CrashInfo.m_DesiredFrameSize))
+    quality, &m_CrashInfo.m_DesiredFrameSize, bCompressFrames, bEncodeVP8))
   {
     // Add a message to log
     sMsg.Format(_T("Error initializing video recorder."));
@@ -2692,7 +2960,7 @@ BOOL CErrorReportSender::RecordVideo()
     // Wait for a while
     BOOL bExitLoop = WAIT_OBJECT_0==WaitForSingleObject(hEvent, m_CrashInfo.m_nVideoFrameInterval);
 
-    // This will record a single BMP file
+    // This will record a single frame to memory
     m_VideoRec.RecordVideoFrame();
 
     if(bExitLoop)
@@ -2739,7 +3007,7 @@ BOOL CErrorReportSender::EncodeVideo()
   // Add a message to log
   m_Assync.SetProgress(_T("Encoding recorded video, please wait..."), 1);    
 
-  // Encode recorded video to a webm file
+  // Encode recorded video to an ogg or webm file
   if(!m_VideoRec.EncodeVideo())
   {
     // Add a message to log
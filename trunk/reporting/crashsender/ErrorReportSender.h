@@ -16,6 +16,10 @@ be found in the Authors.txt file in the root of the source tree.
 #include "tinyxml.h"
 #include "CrashInfoReader.h"
 #include "VideoRec.h"
+#include "ParallelDeflate.h"
+#include "DeliveryScheduler.h"
+#include "FileCollector.h"
+#include "ReportDigest.h"
 
 // Action type
 enum ActionType  
@@ -129,14 +133,18 @@ private:
     // Collects crash report files.
     BOOL CollectCrashFiles();  
 
-    // Includes a single file to crash report
-    BOOL CollectSingleFile(ERIFileItem* pfi);
+    // Reports progress of copying crash report files.
+    static bool CollectProgressCallback(uint64_t uDone, uint64_t uTotal, void* pParam);
 
-    // Includes all files matching search pattern to crash report
-    BOOL CollectFilesBySearchTemplate(ERIFileItem* pfi, std::vector<ERIFileItem>& file_list);
+    // Calculates MD5 hash (and SHA-256 hash, if enabled) for a file.
+    int CalcFileDigest(WTL::CString sFileName, CReportDigest& Digest);
 
-    // Calculates MD5 hash for a file.
-    int CalcFileMD5Hash(WTL::CString sFileName, WTL::CString& sMD5Hash);
+    // Saves the digest of a ZIP archive to .md5 and .sha256 files next to it.
+    int SaveReportDigest(WTL::CString sZipName, const CReportDigest& Digest);
+
+    // Returns the digest of a ZIP archive saved when it was compressed. The digest is 
+    // calculated only if it wasn't saved.
+    int GetReportDigest(WTL::CString sZipName, WTL::CString& sMD5Hash, WTL::CString& sSHA256Hash);
       
     // Takes desktop screenshot.
     BOOL TakeDesktopScreenshot();
@@ -155,9 +163,6 @@ private:
 
     // Creates crash description XML file.
     BOOL CreateCrashDescriptionXML(CErrorReportInfo& eri);
-  
-    // Adds an element to XML file.
-    void AddElemToXML(WTL::CString sName, WTL::CString sValue, TiXmlNode* root);
 
     // Minidump callback.
     static BOOL CALLBACK MiniDumpCallback(PVOID CallbackParam, PMINIDUMP_CALLBACK_INPUT CallbackInput,
@@ -179,6 +184,12 @@ private:
     // Packs error report files to ZIP archive.
     BOOL CompressReportFiles(CErrorReportInfo* eri);
 
+    // Reads the next portion of the file being compressed.
+    static bool CompressReadCallback(void* pBuf, size_t uSize, size_t* puRead, void* pParam);
+
+    // Writes compressed data to the ZIP archive.
+    static bool CompressWriteCallback(const void* pData, size_t uSize, void* pParam);
+
     // Unblocks parent process.
     void UnblockParentProcess();
 
@@ -188,8 +199,8 @@ private:
     // Sends error report over HTTP.
     BOOL SendOverHTTP();
 
-    // Encodes attachment file with Base-64 encoding.
-    int Base64EncodeAttachment(WTL::CString sFileName, WTL::CString& sEncodedFileData);
+    // Fills in the HTTP request for the error report and its ZIP archive.
+    void FormatHttpRequest(CErrorReportInfo* eri, WTL::CString sZipName, CHttpRequest& request);
 
     // Formats Email text.
     WTL::CString FormatEmailText();
@@ -205,6 +216,18 @@ private:
 
     // Send the next queued report.
     BOOL SendNextReport(int nReport);
+
+    // Returns TRUE if queued reports may be uploaded over HTTP several at once.
+    BOOL CanSendConcurrently();
+
+    // Compresses queued reports and uploads them over HTTP several at once.
+    void SendRecentReportsConcurrently();
+
+    // Delivery scheduler callbacks used by SendRecentReportsConcurrently().
+    static int DeliveryNextCallback(void* pParam);
+    static bool DeliveryPrepareCallback(int nReport, void* pParam);
+    static bool DeliveryDeliverCallback(int nReport, void* pParam);
+    static void DeliveryDoneCallback(int nReport, bool bDelivered, void* pParam);
     
     // Internal variables
     static CErrorReportSender* m_pInstance; // Singleton
@@ -229,4 +252,5 @@ private:
     BOOL m_bSendingNow;                 // TRUE if in progress of sending reports.
     BOOL m_bErrors;                     // TRUE if there were errors.
     WTL::CString m_sCrashLogFile;            // Log file.
+    std::set<int> m_HttpFailedReports;  // Reports that failed to upload over HTTP concurrently.
 };
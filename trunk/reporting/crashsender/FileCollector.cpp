@@ -0,0 +1,647 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "FileCollector.h"
+#include "ParallelDeflate.h"
+#include <algorithm>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+#ifdef _WIN32
+#define FCOLLECT_NO_FILE INVALID_HANDLE_VALUE
+#else
+#define FCOLLECT_NO_FILE (-1)
+#endif
+
+// Maximum number of bytes copied by a single sendfile() call, so progress is
+// reported and cancellation is checked while large files are copied
+#define FCOLLECT_SYSTEM_COPY_CHUNK (8*1024*1024)
+
+// Returns the error code of the last failed system call
+static int GetSysError()
+{
+#ifdef _WIN32
+    return (int)GetLastError();
+#else
+    return errno;
+#endif
+}
+
+// Opens the source file for sequential reading. The application may still have
+// the file open for writing.
+static FileCollectHandle OpenSource(const FileCollectPath& sPath)
+{
+#ifdef _WIN32
+    return CreateFileW(sPath.c_str(), GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+#else
+    int hFile = open(sPath.c_str(), O_RDONLY);
+#ifdef POSIX_FADV_SEQUENTIAL
+    if(hFile>=0)
+        posix_fadvise(hFile, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return hFile;
+#endif
+}
+
+// Creates or truncates the destination file
+static FileCollectHandle CreateDest(const FileCollectPath& sPath)
+{
+#ifdef _WIN32
+    return CreateFileW(sPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ,
+        NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+#else
+    return open(sPath.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+#endif
+}
+
+static void CloseFile(FileCollectHandle hFile)
+{
+#ifdef _WIN32
+    CloseHandle(hFile);
+#else
+    close(hFile);
+#endif
+}
+
+static bool RemoveFile(const FileCollectPath& sPath)
+{
+#ifdef _WIN32
+    return DeleteFileW(sPath.c_str())!=FALSE;
+#else
+    return unlink(sPath.c_str())==0;
+#endif
+}
+
+// Returns the size of an open file
+static bool GetOpenFileSize(FileCollectHandle hFile, uint64_t& uSize)
+{
+#ifdef _WIN32
+    LARGE_INTEGER lSize;
+    if(!GetFileSizeEx(hFile, &lSize))
+        return false;
+    uSize = (uint64_t)lSize.QuadPart;
+#else
+    struct stat st;
+    if(fstat(hFile, &st)!=0)
+        return false;
+    uSize = (uint64_t)st.st_size;
+#endif
+    return true;
+}
+
+// Returns the size of a file, or zero if it is not accessible
+static uint64_t GetPathSize(const FileCollectPath& sPath)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    if(!GetFileAttributesExW(sPath.c_str(), GetFileExInfoStandard, &fad))
+        return 0;
+    return ((uint64_t)fad.nFileSizeHigh<<32)|fad.nFileSizeLow;
+#else
+    struct stat st;
+    if(stat(sPath.c_str(), &st)!=0)
+        return 0;
+    return (uint64_t)st.st_size;
+#endif
+}
+
+// Reads up to uSize bytes. Zero bytes read means the end of file.
+static bool ReadData(FileCollectHandle hFile, void* pBuf, size_t uSize, size_t* puRead)
+{
+#ifdef _WIN32
+    DWORD dwRead = 0;
+    if(!ReadFile(hFile, pBuf, (DWORD)uSize, &dwRead, NULL))
+        return false;
+    *puRead = dwRead;
+#else
+    ssize_t nRead;
+    do
+    {
+        nRead = read(hFile, pBuf, uSize);
+    }
+    while(nRead<0 && errno==EINTR);
+    if(nRead<0)
+        return false;
+    *puRead = (size_t)nRead;
+#endif
+    return true;
+}
+
+// Writes all bytes
+static bool WriteData(FileCollectHandle hFile, const void* pData, size_t uSize)
+{
+#ifdef _WIN32
+    DWORD dwWritten = 0;
+    return WriteFile(hFile, pData, (DWORD)uSize, &dwWritten, NULL) && dwWritten==uSize;
+#else
+    const char* p = (const char*)pData;
+    while(uSize!=0)
+    {
+        ssize_t nWritten = write(hFile, p, uSize);
+        if(nWritten<0 && errno==EINTR)
+            continue;
+        if(nWritten<=0)
+            return false;
+        p += nWritten;
+        uSize -= (size_t)nWritten;
+    }
+    return true;
+#endif
+}
+
+CFileCollector::CFileCollector()
+{
+    m_nThreads = 0;
+    m_nThreadsUsed = 0;
+    m_uBufferSize = FCOLLECT_DEFAULT_BUFFER_SIZE;
+    m_bSystemCopy = true;
+    m_pfnProgress = NULL;
+    m_pProgressParam = NULL;
+    m_pItems = NULL;
+    m_bCancelled = false;
+    m_uTotal = 0;
+    m_uDone = 0;
+    m_uReported = 0;
+}
+
+void CFileCollector::SetThreadCount(int nThreads)
+{
+    m_nThreads = nThreads;
+}
+
+void CFileCollector::SetBufferSize(size_t uBufferSize)
+{
+    m_uBufferSize = uBufferSize>0 ? uBufferSize : FCOLLECT_DEFAULT_BUFFER_SIZE;
+}
+
+void CFileCollector::SetSystemCopy(bool bSystemCopy)
+{
+    m_bSystemCopy = bSystemCopy;
+}
+
+void CFileCollector::SetProgressCallback(PFNFILECOLLECTPROGRESS pfnProgress, void* pParam)
+{
+    m_pfnProgress = pfnProgress;
+    m_pProgressParam = pParam;
+}
+
+int CFileCollector::Run(std::vector<FileCollectItem>& aItems)
+{
+    int nFailed = 0;
+    int nStarted = 0;
+    size_t i;
+
+    m_pItems = &aItems;
+    m_aQueue.clear();
+    m_bCancelled = false;
+    m_uTotal = 0;
+    m_uDone = 0;
+    m_uReported = 0;
+
+    // Items are cancelled unless a worker finishes them. Only copied data count
+    // for progress.
+    for(i=0; i<aItems.size(); i++)
+    {
+        FileCollectItem& item = aItems[i];
+        item.m_nResult = FCOLLECT_ERR_CANCELLED;
+        item.m_nMethod = FCOLLECT_METHOD_NONE;
+        item.m_nSysError = 0;
+        item.m_uSize = 0;
+
+        uint64_t uSize = item.m_nMode==FCOLLECT_MODE_COPY ? GetPathSize(item.m_sSrcFile) : 0;
+        m_uTotal += uSize;
+        m_aQueue.push_back(std::make_pair(uSize, (int)i));
+    }
+
+    // Workers take items from the end of the queue, the largest first
+    std::sort(m_aQueue.begin(), m_aQueue.end());
+
+    int nThreads = m_nThreads;
+    if(nThreads<=0)
+    {
+        nThreads = CParallelDeflate::GetProcessorCount();
+        if(nThreads<FCOLLECT_MIN_THREADS)
+            nThreads = FCOLLECT_MIN_THREADS;
+    }
+    if(nThreads>FCOLLECT_MAX_THREADS)
+        nThreads = FCOLLECT_MAX_THREADS;
+    if(nThreads>(int)aItems.size())
+        nThreads = (int)aItems.size();
+
+    // The calling thread is a worker too, so all items are collected even if
+    // threads can't be started
+    CSyncThread aThreads[FCOLLECT_MAX_THREADS];
+    while(nStarted+1<nThreads)
+    {
+        if(!aThreads[nStarted].Start(WorkerThread, this))
+            break;
+        nStarted++;
+    }
+    m_nThreadsUsed = nStarted+1;
+
+    CollectItems();
+
+    for(i=0; i<(size_t)nStarted; i++)
+        aThreads[i].Join();
+
+    // Report the final totals
+    if(m_pfnProgress!=NULL && m_uDone!=m_uReported && !IsCancelled())
+        m_pfnProgress(m_uDone, m_uDone>m_uTotal ? m_uDone : m_uTotal, m_pProgressParam);
+
+    for(i=0; i<aItems.size(); i++)
+    {
+        if(aItems[i].m_nResult!=FCOLLECT_OK)
+            nFailed++;
+    }
+
+    m_pItems = NULL;
+    return nFailed;
+}
+
+void CFileCollector::Cancel()
+{
+    CSyncLock lock(m_Lock);
+    m_bCancelled = true;
+}
+
+bool CFileCollector::IsCancelled()
+{
+    CSyncLock lock(m_Lock);
+    return m_bCancelled;
+}
+
+int CFileCollector::GetThreadCount() const
+{
+    return m_nThreadsUsed;
+}
+
+void CFileCollector::WorkerThread(void* pParam)
+{
+    CFileCollector* pCollector = (CFileCollector*)pParam;
+    pCollector->CollectItems();
+}
+
+void CFileCollector::CollectItems()
+{
+    // The buffer is allocated on first use, the system copy routine doesn't need it
+    std::vector<char> aBuffer;
+
+    for(;;)
+    {
+        int nItem;
+
+        m_Lock.Lock();
+        if(m_bCancelled || m_aQueue.empty())
+        {
+            m_Lock.Unlock();
+            break;
+        }
+        nItem = m_aQueue.back().second;
+        m_aQueue.pop_back();
+        m_Lock.Unlock();
+
+        FileCollectItem& item = (*m_pItems)[nItem];
+        if(item.m_nMode==FCOLLECT_MODE_SNAPSHOT)
+            Snapshot(item);
+        else
+            CopyItem(item, aBuffer);
+    }
+}
+
+void CFileCollector::CopyItem(FileCollectItem& item, std::vector<char>& aBuffer)
+{
+    FileCollectHandle hSrc = FCOLLECT_NO_FILE;
+    FileCollectHandle hDest = FCOLLECT_NO_FILE;
+
+    hSrc = OpenSource(item.m_sSrcFile);
+    if(hSrc==FCOLLECT_NO_FILE)
+    {
+        item.m_nResult = FCOLLECT_ERR_OPEN;
+        item.m_nSysError = GetSysError();
+        goto cleanup;
+    }
+
+    if(item.m_nMode==FCOLLECT_MODE_CHECK)
+    {
+        item.m_nResult = FCOLLECT_OK;
+        goto cleanup;
+    }
+
+    if(m_bSystemCopy && SystemCopy(item, hSrc, hDest))
+        goto cleanup;
+
+    if(hDest==FCOLLECT_NO_FILE)
+    {
+        hDest = CreateDest(item.m_sDestFile);
+        if(hDest==FCOLLECT_NO_FILE)
+        {
+            item.m_nResult = FCOLLECT_ERR_CREATE;
+            item.m_nSysError = GetSysError();
+            goto cleanup;
+        }
+    }
+
+    BufferedCopy(item, hSrc, hDest, aBuffer);
+
+cleanup:
+
+    if(hSrc!=FCOLLECT_NO_FILE)
+        CloseFile(hSrc);
+
+    if(hDest!=FCOLLECT_NO_FILE)
+    {
+        CloseFile(hDest);
+
+        // Don't leave a partial copy
+        if(item.m_nResult!=FCOLLECT_OK)
+            RemoveFile(item.m_sDestFile);
+    }
+}
+
+#ifdef _WIN32
+
+// State of a CopyFileEx() call
+struct SystemCopyState
+{
+    CFileCollector* m_pCollector;  // Owner
+    FileCollectItem* m_pItem;      // Item being copied
+};
+
+DWORD CALLBACK CFileCollector::CopyProgressRoutine(LARGE_INTEGER TotalFileSize,
+    LARGE_INTEGER TotalBytesTransferred, LARGE_INTEGER StreamSize,
+    LARGE_INTEGER StreamBytesTransferred, DWORD dwStreamNumber, DWORD dwCallbackReason,
+    HANDLE hSourceFile, HANDLE hDestinationFile, LPVOID lpData)
+{
+    SystemCopyState* pState = (SystemCopyState*)lpData;
+    uint64_t uTransferred = (uint64_t)TotalBytesTransferred.QuadPart;
+
+    if(uTransferred>pState->m_pItem->m_uSize)
+    {
+        uint64_t uBytes = uTransferred-pState->m_pItem->m_uSize;
+        pState->m_pItem->m_uSize = uTransferred;
+        if(!pState->m_pCollector->AddProgress(uBytes))
+            return PROGRESS_CANCEL;
+    }
+    else if(pState->m_pCollector->IsCancelled())
+        return PROGRESS_CANCEL;
+
+    return PROGRESS_CONTINUE;
+}
+
+#endif
+
+bool CFileCollector::SystemCopy(FileCollectItem& item, FileCollectHandle hSrc, FileCollectHandle& hDest)
+{
+#if defined(_WIN32)
+
+    // CopyFileEx() may offload the copy to the file system or the storage. The source
+    // is opened by the caller, so it can't be replaced until the copy is finished.
+    SystemCopyState state;
+    state.m_pCollector = this;
+    state.m_pItem = &item;
+
+    if(CopyFileExW(item.m_sSrcFile.c_str(), item.m_sDestFile.c_str(),
+        CopyProgressRoutine, &state, NULL, 0))
+    {
+        uint64_t uSize = GetPathSize(item.m_sDestFile);
+        if(uSize>item.m_uSize)
+        {
+            AddProgress(uSize-item.m_uSize);
+            item.m_uSize = uSize;
+        }
+        item.m_nResult = FCOLLECT_OK;
+        item.m_nMethod = FCOLLECT_METHOD_SYSTEM;
+        return true;
+    }
+
+    DWORD dwError = GetLastError();
+    if(dwError==ERROR_REQUEST_ABORTED)
+    {
+        item.m_nResult = FCOLLECT_ERR_CANCELLED;
+        return true;
+    }
+
+    // CopyFileEx() fails on files the application keeps open without read sharing of
+    // the writer; the buffered copy opens them with write sharing. It copies the file
+    // from the start, so bytes copied already may be counted twice in progress.
+    item.m_uSize = 0;
+    return false;
+
+#elif defined(__linux__)
+
+    // sendfile() copies in the kernel, without passing data through user buffers.
+    // If it fails, the rest of the file is copied with buffers from the current offsets.
+    hDest = CreateDest(item.m_sDestFile);
+    if(hDest==FCOLLECT_NO_FILE)
+    {
+        item.m_nResult = FCOLLECT_ERR_CREATE;
+        item.m_nSysError = GetSysError();
+        return true;
+    }
+
+    for(;;)
+    {
+        ssize_t nCopied = sendfile(hDest, hSrc, NULL, FCOLLECT_SYSTEM_COPY_CHUNK);
+        if(nCopied<0 && errno==EINTR)
+            continue;
+        if(nCopied<0)
+            return false;
+
+        if(nCopied==0)
+        {
+            item.m_nResult = FCOLLECT_OK;
+            item.m_nMethod = FCOLLECT_METHOD_SYSTEM;
+            return true;
+        }
+
+        item.m_uSize += (uint64_t)nCopied;
+        if(!AddProgress((uint64_t)nCopied))
+        {
+            item.m_nResult = FCOLLECT_ERR_CANCELLED;
+            return true;
+        }
+    }
+
+#else
+
+    (void)item;
+    (void)hSrc;
+    (void)hDest;
+    return false;
+
+#endif
+}
+
+void CFileCollector::BufferedCopy(FileCollectItem& item, FileCollectHandle hSrc, FileCollectHandle hDest,
+    std::vector<char>& aBuffer)
+{
+    if(aBuffer.size()<m_uBufferSize)
+        aBuffer.resize(m_uBufferSize);
+
+    item.m_nMethod = FCOLLECT_METHOD_READ;
+
+    for(;;)
+    {
+        size_t uRead = 0;
+        if(!ReadData(hSrc, &aBuffer[0], m_uBufferSize, &uRead))
+        {
+            item.m_nResult = FCOLLECT_ERR_READ;
+            item.m_nSysError = GetSysError();
+            return;
+        }
+
+        if(uRead==0)
+            break;
+
+        if(!WriteData(hDest, &aBuffer[0], uRead))
+        {
+            item.m_nResult = FCOLLECT_ERR_WRITE;
+            item.m_nSysError = GetSysError();
+            return;
+        }
+
+        item.m_uSize += uRead;
+        if(!AddProgress(uRead))
+        {
+            item.m_nResult = FCOLLECT_ERR_CANCELLED;
+            return;
+        }
+    }
+
+    item.m_nResult = FCOLLECT_OK;
+}
+
+void CFileCollector::Snapshot(FileCollectItem& item)
+{
+    // The size is taken from an open file, so the file is known to be readable
+    FileCollectHandle hSrc = OpenSource(item.m_sSrcFile);
+    if(hSrc==FCOLLECT_NO_FILE)
+    {
+        item.m_nResult = FCOLLECT_ERR_OPEN;
+        item.m_nSysError = GetSysError();
+        return;
+    }
+
+    bool bSize = GetOpenFileSize(hSrc, item.m_uSize);
+    if(!bSize)
+        item.m_nSysError = GetSysError();
+    CloseFile(hSrc);
+
+    if(!bSize)
+    {
+        item.m_nResult = FCOLLECT_ERR_READ;
+        return;
+    }
+
+    // Data appended later are beyond the recorded size. If the link can't be created
+    // (e.g. the report folder is on another volume), the data are read from the source.
+    RemoveFile(item.m_sDestFile);
+#ifdef _WIN32
+    bool bLinked = CreateHardLinkW(item.m_sDestFile.c_str(), item.m_sSrcFile.c_str(), NULL)!=FALSE;
+#else
+    bool bLinked = link(item.m_sSrcFile.c_str(), item.m_sDestFile.c_str())==0;
+#endif
+
+    item.m_nMethod = bLinked ? FCOLLECT_METHOD_LINK : FCOLLECT_METHOD_SIZE;
+    item.m_nResult = FCOLLECT_OK;
+}
+
+bool CFileCollector::AddProgress(uint64_t uBytes)
+{
+    uint64_t uDone;
+    uint64_t uTotal;
+
+    // Reported values don't go back, as the callback is called in the same order
+    // the bytes are added. It is called without holding m_Lock, so it may call Cancel().
+    CSyncLock lock(m_ProgressLock);
+
+    m_Lock.Lock();
+    m_uDone += uBytes;
+    bool bReport = m_pfnProgress!=NULL && !m_bCancelled &&
+        m_uDone-m_uReported>=FCOLLECT_PROGRESS_STEP;
+    if(bReport)
+        m_uReported = m_uDone;
+    uDone = m_uDone;
+    uTotal = m_uDone>m_uTotal ? m_uDone : m_uTotal;
+    m_Lock.Unlock();
+
+    if(bReport && !m_pfnProgress(uDone, uTotal, m_pProgressParam))
+        Cancel();
+
+    return !IsCancelled();
+}
+
+bool CFileCollector::ExpandTemplate(const FileCollectPath& sTemplate, std::vector<FileCollectPath>& aFiles)
+{
+    std::vector<FileCollectPath> aFound;
+
+#ifdef _WIN32
+
+    size_t uPos = sTemplate.find_last_of(L"\\/");
+    FileCollectPath sDir = uPos==FileCollectPath::npos ? FileCollectPath() : sTemplate.substr(0, uPos+1);
+
+    WIN32_FIND_DATAW ffd;
+    HANDLE hFind = FindFirstFileW(sTemplate.c_str(), &ffd);
+    if(hFind==INVALID_HANDLE_VALUE)
+        return false;
+
+    do
+    {
+        if((ffd.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY)==0)
+            aFound.push_back(sDir+ffd.cFileName);
+    }
+    while(FindNextFileW(hFind, &ffd));
+
+    FindClose(hFind);
+
+#else
+
+    size_t uPos = sTemplate.rfind('/');
+    FileCollectPath sDir = uPos==FileCollectPath::npos ? FileCollectPath() : sTemplate.substr(0, uPos+1);
+    FileCollectPath sPattern = uPos==FileCollectPath::npos ? sTemplate : sTemplate.substr(uPos+1);
+
+    DIR* pDir = opendir(sDir.empty() ? "." : sDir.c_str());
+    if(pDir==NULL)
+        return false;
+
+    struct dirent* pEntry;
+    while((pEntry=readdir(pDir))!=NULL)
+    {
+        if(fnmatch(sPattern.c_str(), pEntry->d_name, FNM_PERIOD)!=0)
+            continue;
+
+        FileCollectPath sPath = sDir+pEntry->d_name;
+        struct stat st;
+        if(stat(sPath.c_str(), &st)==0 && S_ISREG(st.st_mode))
+            aFound.push_back(sPath);
+    }
+
+    closedir(pDir);
+
+    // Same order as FindFirstFile() gives on NTFS
+    std::sort(aFound.begin(), aFound.end());
+
+#endif
+
+    aFiles.insert(aFiles.end(), aFound.begin(), aFound.end());
+    return !aFound.empty();
+}
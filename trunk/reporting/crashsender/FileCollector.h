@@ -0,0 +1,193 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: FileCollector.h
+// Description: Collects application files into the error report folder. Files are
+// copied by a pool of worker threads with large buffers, or by the system copy routine
+// where available. Append-only logs may be taken as a snapshot without copying their
+// data: the file is hard-linked into the report folder and its current size is recorded.
+
+#pragma once
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include "ThreadSync.h"
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// File paths (wide strings on Windows) and open file handles
+#ifdef _WIN32
+typedef std::wstring FileCollectPath;
+typedef HANDLE FileCollectHandle;
+#else
+typedef std::string FileCollectPath;
+typedef int FileCollectHandle;
+#endif
+
+// Default size of the copy buffer of a worker
+#define FCOLLECT_DEFAULT_BUFFER_SIZE (1024*1024)
+
+// Minimum and maximum number of worker threads
+#define FCOLLECT_MIN_THREADS 2
+#define FCOLLECT_MAX_THREADS 8
+
+// The progress callback is called each time that many bytes are collected
+#define FCOLLECT_PROGRESS_STEP (1024*1024)
+
+// How a file is collected
+enum FileCollectMode
+{
+    FCOLLECT_MODE_CHECK = 0,    // Only check that the file can be opened for reading
+    FCOLLECT_MODE_COPY = 1,     // Copy the file to the destination path
+    FCOLLECT_MODE_SNAPSHOT = 2  // Link the file to the destination path, record its size
+};
+
+// How a file was actually collected
+enum FileCollectMethod
+{
+    FCOLLECT_METHOD_NONE = 0,   // Not collected, or only checked
+    FCOLLECT_METHOD_READ = 1,   // Copied by reading and writing buffers
+    FCOLLECT_METHOD_SYSTEM = 2, // Copied by the system (CopyFileEx or sendfile)
+    FCOLLECT_METHOD_LINK = 3,   // Hard link at the destination path, data up to m_uSize
+    FCOLLECT_METHOD_SIZE = 4    // Data up to m_uSize at the source path (link failed)
+};
+
+// Item results
+enum FileCollectError
+{
+    FCOLLECT_OK = 0,             // Success
+    FCOLLECT_ERR_OPEN = 1,       // Couldn't open the source file
+    FCOLLECT_ERR_CREATE = 2,     // Couldn't create the destination file
+    FCOLLECT_ERR_READ = 3,       // Couldn't read the source file
+    FCOLLECT_ERR_WRITE = 4,      // Couldn't write the destination file
+    FCOLLECT_ERR_CANCELLED = 5   // Cancelled before the item was finished
+};
+
+// A file to collect
+struct FileCollectItem
+{
+    FileCollectItem()
+    {
+        m_nMode = FCOLLECT_MODE_COPY;
+        m_nResult = FCOLLECT_OK;
+        m_nMethod = FCOLLECT_METHOD_NONE;
+        m_nSysError = 0;
+        m_uSize = 0;
+    }
+
+    FileCollectPath m_sSrcFile;  // Source file path
+    FileCollectPath m_sDestFile; // Destination file path (not used in check mode)
+    int m_nMode;                 // FileCollectMode
+    int m_nResult;               // FileCollectError, set by CFileCollector::Run()
+    int m_nMethod;               // FileCollectMethod, set by CFileCollector::Run()
+    int m_nSysError;             // errno or GetLastError() code of the failed operation
+    uint64_t m_uSize;            // Bytes copied, or the size of the snapshot
+};
+
+// Reports the number of bytes collected. Returns false to cancel the collection.
+// Calls are serialized, but may come from any thread.
+typedef bool (*PFNFILECOLLECTPROGRESS)(uint64_t uDone, uint64_t uTotal, void* pParam);
+
+// class CFileCollector
+// Collects a list of files by a pool of worker threads (the calling thread is one of
+// them). Larger files are started first, so a single large log doesn't keep one
+// worker busy after the others are finished.
+class CFileCollector
+{
+public:
+
+    CFileCollector();
+
+    // Sets the number of worker threads. Zero means a thread per processor, but at least
+    // two, so reading of one file overlaps writing of another.
+    void SetThreadCount(int nThreads);
+
+    // Sets the size of the copy buffer of a worker
+    void SetBufferSize(size_t uBufferSize);
+
+    // Enables the system copy routine. If disabled, files are copied by reading
+    // and writing buffers.
+    void SetSystemCopy(bool bSystemCopy);
+
+    // Sets the progress callback
+    void SetProgressCallback(PFNFILECOLLECTPROGRESS pfnProgress, void* pParam);
+
+    // Collects the items, setting their result fields. Returns the number of items
+    // that failed or were cancelled.
+    int Run(std::vector<FileCollectItem>& aItems);
+
+    // Stops taking new items and interrupts copies in progress. May be called from
+    // any thread, including the progress callback.
+    void Cancel();
+
+    // Returns true if the current run was cancelled
+    bool IsCancelled();
+
+    // Returns the number of worker threads used by the last run
+    int GetThreadCount() const;
+
+    // Finds files matching a search template such as "C:\\Logs\\*.log". Only the file
+    // name part may contain wildcards; directories are skipped. Adds the full paths
+    // to aFiles. Returns false if no files were found.
+    static bool ExpandTemplate(const FileCollectPath& sTemplate, std::vector<FileCollectPath>& aFiles);
+
+private:
+
+    // Worker thread procedure
+    static void WorkerThread(void* pParam);
+
+    // Collects items until there are no more
+    void CollectItems();
+
+    // Checks or copies the file using the given buffer
+    void CopyItem(FileCollectItem& item, std::vector<char>& aBuffer);
+
+    // Copies the source file by the system copy routine. The destination file is created
+    // if needed. Returns false if the rest of the file should be copied with buffers.
+    bool SystemCopy(FileCollectItem& item, FileCollectHandle hSrc, FileCollectHandle& hDest);
+
+    // Copies the rest of the source file by reading and writing buffers
+    void BufferedCopy(FileCollectItem& item, FileCollectHandle hSrc, FileCollectHandle hDest,
+        std::vector<char>& aBuffer);
+
+    // Takes a snapshot of the file
+    void Snapshot(FileCollectItem& item);
+
+    // Adds collected bytes and reports progress. Returns false if cancelled.
+    bool AddProgress(uint64_t uBytes);
+
+#ifdef _WIN32
+    // CopyFileEx() progress routine
+    static DWORD CALLBACK CopyProgressRoutine(LARGE_INTEGER TotalFileSize,
+        LARGE_INTEGER TotalBytesTransferred, LARGE_INTEGER StreamSize,
+        LARGE_INTEGER StreamBytesTransferred, DWORD dwStreamNumber, DWORD dwCallbackReason,
+        HANDLE hSourceFile, HANDLE hDestinationFile, LPVOID lpData);
+#endif
+
+    int m_nThreads;                  // Requested number of threads
+    int m_nThreadsUsed;              // Threads used by the last run
+    size_t m_uBufferSize;            // Copy buffer size
+    bool m_bSystemCopy;              // Use the system copy routine?
+    PFNFILECOLLECTPROGRESS m_pfnProgress; // Progress callback
+    void* m_pProgressParam;          // Progress callback parameter
+    std::vector<FileCollectItem>* m_pItems; // Items of the current run
+    CSyncMutex m_Lock;               // Protects the members below
+    std::vector< std::pair<uint64_t, int> > m_aQueue; // Items left (size, index), largest last
+    bool m_bCancelled;               // Cancel flag
+    uint64_t m_uTotal;               // Total bytes to copy
+    uint64_t m_uDone;                // Bytes collected
+    uint64_t m_uReported;            // Bytes reported to the progress callback
+    CSyncMutex m_ProgressLock;       // Serializes progress updates and callback calls
+};
@@ -13,6 +13,7 @@ be found in the Authors.txt file in the root of the source tree.
 #include "png.h"
 #include "jpeglib.h"
 #include "strconv.h"
+#include "YuvConvert.h"
 
 #pragma warning(disable:4611)
 // DIBSIZE calculates the number of bytes required by an image
@@ -22,12 +23,6 @@ be found in the Authors.txt file in the root of the source tree.
 #define _DIBSIZE(bi) (DIBWIDTHBYTES(bi) * (DWORD)(bi).biHeight)
 #define DIBSIZE(bi) ((bi).biHeight < 0 ? (-1)*(_DIBSIZE(bi)) : _DIBSIZE(bi))
 
-static inline 
-  unsigned char CLAMP(int x)
-{
-  return  (unsigned char)((x > 255) ? 255 : (x < 0) ? 0 : x);
-}
-
 //-----------------------------------------------------------------------------
 // CFileMemoryMapping implementation
 //-----------------------------------------------------------------------------
@@ -1019,23 +1014,8 @@ BOOL CVideo::IsValid()
 void CVideo::YV12_To_RGB(unsigned char *pRGBData, int nFrameWidth, 
                          int nFrameHeight, int nRGBStride, th_ycbcr_buffer raw)
 {
-
-  int x, y;
-  for(y=0; y<nFrameHeight;y++)
-  {
-    for (x=0; x < nFrameWidth; x ++)
-    {
-      int nRGBOffs = y*nRGBStride+x*3;
-
-      float Y = raw[0].data[y*raw[0].stride+x];
-      float U = raw[1].data[y/2*raw[1].stride+x/2];
-      float V = raw[2].data[y/2*raw[2].stride+x/2];
-
-      pRGBData[nRGBOffs+0] = CLAMP((int)(1.164*(Y - 16) + 2.018*(U - 128)));
-      pRGBData[nRGBOffs+1] = CLAMP((int)(1.164*(Y - 16) - 0.813*(V - 128) - 0.391*(U - 128)));
-      pRGBData[nRGBOffs+2] = CLAMP((int)(1.164*(Y - 16) + 1.596*(V - 128)));
-    }
-  }	
+  YV12_To_RGB24(raw[0].data, raw[0].stride, raw[1].data, raw[1].stride, 
+    raw[2].data, raw[2].stride, nFrameWidth, nFrameHeight, pRGBData, nRGBStride);
 }
 
 BOOL CVideo::CreateFrameDIB(DWORD dwWidth, DWORD dwHeight, int nBits)
@@ -0,0 +1,195 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "FramePipeline.h"
+#include "ParallelDeflate.h"
+
+CFramePipeline::CFramePipeline()
+{
+    m_nTaken = 0;
+    m_bStop = false;
+    m_pfnProcess = NULL;
+    m_pParam = NULL;
+}
+
+CFramePipeline::~CFramePipeline()
+{
+    Destroy();
+}
+
+int CFramePipeline::Init(int nThreads, int nSlots)
+{
+    int i;
+
+    Destroy();
+
+    if(nThreads<=0)
+        nThreads = CParallelDeflate::GetProcessorCount();
+    if(nThreads>FPIPE_MAX_THREADS)
+        nThreads = FPIPE_MAX_THREADS;
+
+    // While workers process some frames, the caller reads and writes others
+    if(nSlots<=0)
+        nSlots = 2*nThreads;
+
+    m_bStop = false;
+
+    for(i=0; i<nSlots; i++)
+        m_aSlots.push_back(new FrameSlot);
+
+    for(i=0; i<nThreads; i++)
+    {
+        CSyncThread* pThread = new CSyncThread;
+        m_aThreads.push_back(pThread);
+        if(!pThread->Start(WorkerThread, this))
+        {
+            Destroy();
+            return FPIPE_ERR_INIT;
+        }
+    }
+
+    return FPIPE_OK;
+}
+
+void CFramePipeline::FitMemoryBudget(size_t uSlotSize, size_t uMemoryBudget, int nProcessors,
+    int& nThreads, int& nSlots)
+{
+    if(nProcessors<=0)
+        nProcessors = CParallelDeflate::GetProcessorCount();
+    if(nProcessors>FPIPE_MAX_THREADS)
+        nProcessors = FPIPE_MAX_THREADS;
+
+    nSlots = 2*nProcessors;
+    if(uSlotSize!=0 && uMemoryBudget/uSlotSize<(size_t)nSlots)
+        nSlots = (int)(uMemoryBudget/uSlotSize);
+    if(nSlots<1)
+        nSlots = 1;
+
+    nThreads = nProcessors<nSlots ? nProcessors : nSlots;
+}
+
+void CFramePipeline::Destroy()
+{
+    size_t i;
+
+    // Wake up the threads and wait for them to exit
+    m_bStop = true;
+    for(i=0; i<m_aThreads.size(); i++)
+        m_JobPosted.Post();
+
+    for(i=0; i<m_aThreads.size(); i++)
+    {
+        m_aThreads[i]->Join();
+        delete m_aThreads[i];
+    }
+    m_aThreads.clear();
+
+    for(i=0; i<m_aSlots.size(); i++)
+        delete m_aSlots[i];
+    m_aSlots.clear();
+}
+
+void CFramePipeline::WorkerThread(void* pParam)
+{
+    CFramePipeline* pThis = (CFramePipeline*)pParam;
+    pThis->RunWorker();
+}
+
+void CFramePipeline::RunWorker()
+{
+    for(;;)
+    {
+        m_JobPosted.Wait();
+        if(m_bStop)
+            break;
+
+        // Frames are posted in order and at most a slot count of them are
+        // being processed, so the next frame taken tells its slot
+        int nFrame;
+        {
+            CSyncLock lock(m_JobLock);
+            nFrame = m_nTaken++;
+        }
+
+        int nSlot = nFrame%(int)m_aSlots.size();
+        FrameSlot* pSlot = m_aSlots[nSlot];
+        pSlot->m_bResult = m_pfnProcess(pSlot->m_nFrame, nSlot, m_pParam);
+        pSlot->m_Done.Post();
+    }
+}
+
+int CFramePipeline::Run(int nFrameCount, PFNFRAMESTAGE pfnRead, PFNFRAMESTAGE pfnProcess,
+    PFNFRAMESTAGE pfnWrite, void* pParam)
+{
+    int nSlotCount = (int)m_aSlots.size();
+    int nRead = 0;    // Number of frames read and passed to workers
+    int nWritten = 0; // Number of frames written (or dropped on error)
+    int nResult = FPIPE_OK;
+    bool bReadFailed = false;
+
+    if(m_aThreads.empty())
+        return FPIPE_ERR_INIT;
+
+    // Workers are idle between runs
+    m_nTaken = 0;
+    m_pfnProcess = pfnProcess;
+    m_pParam = pParam;
+
+    for(;;)
+    {
+        // Fill free slots
+        while(nResult==FPIPE_OK && !bReadFailed && nRead<nFrameCount && nRead-nWritten<nSlotCount)
+        {
+            int nSlot = nRead%nSlotCount;
+            if(!pfnRead(nRead, nSlot, pParam))
+            {
+                // Frames read before are still written
+                bReadFailed = true;
+                break;
+            }
+
+            m_aSlots[nSlot]->m_nFrame = nRead;
+            nRead++;
+            m_JobPosted.Post();
+        }
+
+        if(nWritten==nRead)
+            break; // All frames passed to workers are written
+
+        // Write the oldest frame when it is processed
+        FrameSlot* pSlot = m_aSlots[nWritten%nSlotCount];
+        pSlot->m_Done.Wait();
+
+        if(nResult==FPIPE_OK)
+        {
+            if(!pSlot->m_bResult)
+                nResult = FPIPE_ERR_PROCESS;
+            else if(!pfnWrite(nWritten, nWritten%nSlotCount, pParam))
+                nResult = FPIPE_ERR_WRITE;
+        }
+
+        nWritten++;
+    }
+
+    if(nResult==FPIPE_OK && bReadFailed)
+        nResult = FPIPE_ERR_READ;
+
+    return nResult;
+}
+
+int CFramePipeline::GetThreadCount() const
+{
+    return (int)m_aThreads.size();
+}
+
+int CFramePipeline::GetSlotCount() const
+{
+    return (int)m_aSlots.size();
+}
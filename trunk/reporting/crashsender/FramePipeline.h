@@ -0,0 +1,98 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: FramePipeline.h
+// Description: Three-stage producer/consumer pipeline for video encoding. Frames are read
+// in order by the caller, processed (composed and converted) by a pool of worker threads,
+// and written in order by the caller, so encoding starts with the first frame ready.
+
+#pragma once
+#include <vector>
+#include "ThreadSync.h"
+
+// Maximum number of worker threads
+#define FPIPE_MAX_THREADS 32
+
+// Error codes returned by CFramePipeline methods
+enum FramePipelineError
+{
+    FPIPE_OK = 0,              // Success
+    FPIPE_ERR_INIT = 1,        // Not initialized, or couldn't create threads
+    FPIPE_ERR_READ = 2,        // The read callback failed
+    FPIPE_ERR_PROCESS = 3,     // The process callback failed
+    FPIPE_ERR_WRITE = 4        // The write callback failed
+};
+
+// A pipeline stage. Handles frame nFrame whose data is kept in buffers of slot nSlot
+// (the caller owns a set of buffers per slot). Returns false on error.
+typedef bool (*PFNFRAMESTAGE)(int nFrame, int nSlot, void* pParam);
+
+// class CFramePipeline
+// Runs frames through read, process and write stages. The read and write callbacks
+// are called in the caller's thread in frame order; the process callback is called by
+// worker threads, for up to GetSlotCount() frames at once. The threads are created by
+// Init() and are reused by all Run() calls until Destroy().
+class CFramePipeline
+{
+public:
+
+    CFramePipeline();
+    ~CFramePipeline();
+
+    // Creates worker threads. If nThreads is zero or negative, a thread per processor is
+    // created. If nSlots is zero or negative, two slots per thread are used.
+    int Init(int nThreads=0, int nSlots=0);
+
+    // Stops worker threads
+    void Destroy();
+
+    // Runs nFrameCount frames through the pipeline. On error, the frames before the failed
+    // one are written; frames after it already passed to workers are waited for but not written.
+    int Run(int nFrameCount, PFNFRAMESTAGE pfnRead, PFNFRAMESTAGE pfnProcess,
+        PFNFRAMESTAGE pfnWrite, void* pParam);
+
+    // Returns the number of worker threads
+    int GetThreadCount() const;
+
+    // Returns the number of slots, that is frames being processed at once
+    int GetSlotCount() const;
+
+    // Chooses the numbers of threads and slots for Init() so that slots of uSlotSize 
+    // bytes each fit into uMemoryBudget bytes. At least one slot is used; there are at 
+    // most a thread per processor (nProcessors, or the processor count if it is zero 
+    // or negative) and two slots per thread, and no more threads than slots.
+    static void FitMemoryBudget(size_t uSlotSize, size_t uMemoryBudget, int nProcessors,
+        int& nThreads, int& nSlots);
+
+private:
+
+    // A frame passed to workers
+    struct FrameSlot
+    {
+        int m_nFrame;             // Frame index
+        bool m_bResult;           // Result of the process callback
+        CSyncSemaphore m_Done;    // Signalled when the frame is processed
+    };
+
+    // Worker thread procedure
+    static void WorkerThread(void* pParam);
+
+    // Processes frames until the pipeline is destroyed
+    void RunWorker();
+
+    std::vector<CSyncThread*> m_aThreads; // Worker threads
+    std::vector<FrameSlot*> m_aSlots;     // Frames being processed
+    int m_nTaken;                         // Frames taken by workers in the current run
+    CSyncMutex m_JobLock;                 // Guards m_nTaken
+    CSyncSemaphore m_JobPosted;           // Signalled when a job is queued (or on stop)
+    bool m_bStop;                         // Set to stop worker threads
+    PFNFRAMESTAGE m_pfnProcess;           // Process callback of the current run
+    void* m_pParam;                       // Callback parameter of the current run
+};
@@ -0,0 +1,568 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "FrameRingBuffer.h"
+#include <string.h>
+
+// Width and height of tiles compared by delta capture, in pixels
+static const int TILE_SIZE = 32;
+
+CFrameRingBuffer::CFrameRingBuffer()
+{
+    m_nMaxFrames = 0;
+    m_uMaxSize = 0;
+    m_bCompress = false;
+    m_nKeyFrameInterval = 1;
+    m_nFirst = 0;
+    m_nCount = 0;
+    m_uDataSize = 0;
+    m_nFramesSinceKey = 0;
+    m_bForceKeyFrame = false;
+    m_bInImage = false;
+    m_bDeltaImage = false;
+    m_nRowsLeft = 0;
+    m_bDeflateInit = false;
+    m_bInflateInit = false;
+    memset(&m_Deflate, 0, sizeof(m_Deflate));
+    memset(&m_Inflate, 0, sizeof(m_Inflate));
+}
+
+CFrameRingBuffer::~CFrameRingBuffer()
+{
+    Destroy();
+}
+
+bool CFrameRingBuffer::Init(int nMaxFrames, size_t uMaxSize, bool bCompress, int nKeyFrameInterval)
+{
+    Destroy();
+
+    if(nMaxFrames<=0 || nKeyFrameInterval<=0)
+        return false;
+
+    if(bCompress)
+    {
+        if(deflateInit(&m_Deflate, Z_BEST_SPEED)!=Z_OK)
+            return false;
+        m_bDeflateInit = true;
+
+        if(inflateInit(&m_Inflate)!=Z_OK)
+        {
+            Destroy();
+            return false;
+        }
+        m_bInflateInit = true;
+    }
+
+    m_nMaxFrames = nMaxFrames;
+    m_uMaxSize = uMaxSize;
+    m_bCompress = bCompress;
+    m_nKeyFrameInterval = nKeyFrameInterval;
+    m_aSlots.resize(nMaxFrames);
+    m_aKeyFrames.resize(nMaxFrames, 0);
+    return true;
+}
+
+void CFrameRingBuffer::Destroy()
+{
+    if(m_bDeflateInit)
+        deflateEnd(&m_Deflate);
+    if(m_bInflateInit)
+        inflateEnd(&m_Inflate);
+    m_bDeflateInit = false;
+    m_bInflateInit = false;
+
+    std::vector< std::vector<FrameImage> >().swap(m_aSlots);
+    std::vector<unsigned char>().swap(m_aKeyFrames);
+    std::vector<unsigned char>().swap(m_aImageData);
+    std::vector<ReferenceImage>().swap(m_aReferences);
+    std::vector<unsigned char>().swap(m_aDirtyTiles);
+    std::vector<unsigned char>().swap(m_aDeltaData);
+    m_nMaxFrames = 0;
+    m_nKeyFrameInterval = 1;
+    m_nFirst = 0;
+    m_nCount = 0;
+    m_uDataSize = 0;
+    m_nFramesSinceKey = 0;
+    m_bForceKeyFrame = false;
+    m_bInImage = false;
+}
+
+int CFrameRingBuffer::AddFrame()
+{
+    if(m_nMaxFrames==0)
+        return -1;
+
+    AbortImage();
+
+    if(m_nCount==m_nMaxFrames)
+        DropOldestFrame();
+
+    int nSlot = (m_nFirst+m_nCount)%m_nMaxFrames;
+    ClearSlot(nSlot);
+
+    // Deltas can only refer to frames still stored
+    bool bKeyFrame = m_nCount==0 || m_bForceKeyFrame ||
+        m_nFramesSinceKey+1>=m_nKeyFrameInterval;
+
+    if(bKeyFrame)
+    {
+        // Images of the key frame must not refer to older ones
+        size_t i;
+        for(i=0; i<m_aReferences.size(); i++)
+            m_aReferences[i].m_nWidth = 0;
+
+        m_nFramesSinceKey = 0;
+        m_bForceKeyFrame = false;
+    }
+    else
+    {
+        m_nFramesSinceKey++;
+    }
+
+    m_aKeyFrames[nSlot] = bKeyFrame ? 1 : 0;
+    m_nCount++;
+    return nSlot;
+}
+
+void CFrameRingBuffer::CancelFrame()
+{
+    if(m_nCount==0)
+        return;
+
+    AbortImage();
+    ClearSlot((m_nFirst+m_nCount-1)%m_nMaxFrames);
+    m_nCount--;
+
+    // Reference images were updated by the removed frame
+    m_bForceKeyFrame = true;
+}
+
+bool CFrameRingBuffer::BeginImage(int nWidth, int nHeight)
+{
+    if(m_nCount==0 || nWidth<=0 || nHeight<=0)
+        return false;
+
+    int nSlot = (m_nFirst+m_nCount-1)%m_nMaxFrames;
+    size_t uRawSize = (size_t)nWidth*nHeight*3;
+    bool bDelta = false;
+
+    if(m_nKeyFrameInterval>1)
+    {
+        size_t uImage = m_aSlots[nSlot].size();
+        if(m_aReferences.size()<=uImage)
+            m_aReferences.resize(uImage+1);
+
+        // A delta needs the previous image of the same size
+        ReferenceImage& ref = m_aReferences[uImage];
+        bDelta = !m_aKeyFrames[nSlot] && ref.m_nWidth==nWidth && ref.m_nHeight==nHeight;
+
+        if(bDelta)
+        {
+            int nTiles = ((nWidth+TILE_SIZE-1)/TILE_SIZE)*((nHeight+TILE_SIZE-1)/TILE_SIZE);
+            m_aDirtyTiles.assign(nTiles, 0);
+        }
+        else
+        {
+            ref.m_nWidth = nWidth;
+            ref.m_nHeight = nHeight;
+            ref.m_aPixels.resize(uRawSize);
+        }
+    }
+
+    if(bDelta)
+    {
+        // Data is made when all rows are compared
+    }
+    else if(m_bCompress)
+    {
+        if(deflateReset(&m_Deflate)!=Z_OK)
+            return false;
+
+        // The bound guarantees deflate never runs out of output space
+        size_t uBound = deflateBound(&m_Deflate, (uLong)uRawSize);
+        if(m_aImageData.size()<uBound)
+            m_aImageData.resize(uBound);
+        m_Deflate.next_out = &m_aImageData[0];
+        m_Deflate.avail_out = (uInt)uBound;
+    }
+    else
+    {
+        m_aImageData.reserve(uRawSize);
+        m_aImageData.clear();
+    }
+
+    FrameImage image;
+    image.m_nWidth = nWidth;
+    image.m_nHeight = nHeight;
+    image.m_bDelta = bDelta;
+    image.m_uDeltaSize = 0;
+    m_aSlots[nSlot].push_back(image);
+
+    m_bInImage = true;
+    m_bDeltaImage = bDelta;
+    m_nRowsLeft = nHeight;
+    return true;
+}
+
+bool CFrameRingBuffer::AddImageRow(const unsigned char* pRow)
+{
+    if(!m_bInImage || m_nRowsLeft==0)
+        return false;
+
+    std::vector<FrameImage>& aImages = m_aSlots[(m_nFirst+m_nCount-1)%m_nMaxFrames];
+    const FrameImage& image = aImages.back();
+    uInt uRowSize = (uInt)image.m_nWidth*3;
+
+    if(m_nKeyFrameInterval>1)
+    {
+        ReferenceImage& ref = m_aReferences[aImages.size()-1];
+        int y = image.m_nHeight-m_nRowsLeft;
+        unsigned char* pRefRow = &ref.m_aPixels[(size_t)y*uRowSize];
+
+        // Most rows of a static desktop are equal, so compare tiles only if the row differs
+        if(m_bDeltaImage && memcmp(pRefRow, pRow, uRowSize)!=0)
+        {
+            unsigned char* pDirty = &m_aDirtyTiles[(y/TILE_SIZE)*((image.m_nWidth+TILE_SIZE-1)/TILE_SIZE)];
+            uInt uOffs;
+            for(uOffs=0; uOffs<uRowSize; uOffs+=TILE_SIZE*3, pDirty++)
+            {
+                uInt uSize = uRowSize-uOffs<TILE_SIZE*3 ? uRowSize-uOffs : TILE_SIZE*3;
+                if(!*pDirty && memcmp(pRefRow+uOffs, pRow+uOffs, uSize)!=0)
+                    *pDirty = 1;
+            }
+        }
+
+        memcpy(pRefRow, pRow, uRowSize);
+    }
+
+    if(m_bDeltaImage)
+    {
+        // The row is kept in the reference image
+    }
+    else if(m_bCompress)
+    {
+        m_Deflate.next_in = (Bytef*)pRow;
+        m_Deflate.avail_in = uRowSize;
+        if(deflate(&m_Deflate, Z_NO_FLUSH)!=Z_OK || m_Deflate.avail_in!=0)
+        {
+            AbortImage();
+            return false;
+        }
+    }
+    else
+    {
+        m_aImageData.insert(m_aImageData.end(), pRow, pRow+uRowSize);
+    }
+
+    m_nRowsLeft--;
+    return true;
+}
+
+bool CFrameRingBuffer::EndImage()
+{
+    if(!m_bInImage)
+        return false;
+
+    std::vector<FrameImage>& aImages = m_aSlots[(m_nFirst+m_nCount-1)%m_nMaxFrames];
+    FrameImage& image = aImages.back();
+    const unsigned char* pData = NULL;
+    size_t uSize = 0;
+
+    if(m_nRowsLeft!=0)
+    {
+        AbortImage();
+        return false;
+    }
+
+    if(m_bDeltaImage)
+    {
+        MakeDelta(m_aReferences[aImages.size()-1]);
+        image.m_uDeltaSize = m_aDeltaData.size();
+
+        if(m_bCompress)
+        {
+            if(deflateReset(&m_Deflate)!=Z_OK)
+            {
+                AbortImage();
+                return false;
+            }
+
+            size_t uBound = deflateBound(&m_Deflate, (uLong)m_aDeltaData.size());
+            if(m_aImageData.size()<uBound)
+                m_aImageData.resize(uBound);
+            m_Deflate.next_out = &m_aImageData[0];
+            m_Deflate.avail_out = (uInt)uBound;
+            m_Deflate.next_in = &m_aDeltaData[0];
+            m_Deflate.avail_in = (uInt)m_aDeltaData.size();
+        }
+        else
+        {
+            pData = &m_aDeltaData[0];
+            uSize = m_aDeltaData.size();
+        }
+    }
+    else if(!m_bCompress)
+    {
+        pData = &m_aImageData[0];
+        uSize = m_aImageData.size();
+    }
+
+    if(m_bCompress)
+    {
+        if(deflate(&m_Deflate, Z_FINISH)!=Z_STREAM_END)
+        {
+            AbortImage();
+            return false;
+        }
+
+        pData = &m_aImageData[0];
+        uSize = m_Deflate.total_out;
+    }
+
+    m_bInImage = false;
+
+    // Copy the data to a block of its exact size, the work buffers are reused
+    std::vector<unsigned char>(pData, pData+uSize).swap(image.m_aData);
+    m_uDataSize += uSize;
+
+    while(m_uDataSize>m_uMaxSize && HasNextKeyFrame())
+        DropOldestFrame();
+
+    return true;
+}
+
+bool CFrameRingBuffer::AddImage(const unsigned char* pPixels, int nWidth, int nHeight, int nStride)
+{
+    if(!BeginImage(nWidth, nHeight))
+        return false;
+
+    int y;
+    for(y=0; y<nHeight; y++)
+    {
+        if(!AddImageRow(pPixels+(size_t)y*nStride))
+            return false;
+    }
+
+    return EndImage();
+}
+
+int CFrameRingBuffer::GetFrameCount() const
+{
+    return m_nCount;
+}
+
+int CFrameRingBuffer::GetFrameSlot(int nFrame) const
+{
+    if(nFrame<0 || nFrame>=m_nCount)
+        return -1;
+
+    return (m_nFirst+nFrame)%m_nMaxFrames;
+}
+
+bool CFrameRingBuffer::IsKeyFrame(int nSlot) const
+{
+    if(nSlot<0 || nSlot>=m_nMaxFrames)
+        return false;
+
+    return m_aKeyFrames[nSlot]!=0;
+}
+
+int CFrameRingBuffer::GetImageCount(int nSlot) const
+{
+    if(nSlot<0 || nSlot>=m_nMaxFrames)
+        return 0;
+
+    int nCount = (int)m_aSlots[nSlot].size();
+
+    // Don't expose the image being added
+    if(m_bInImage && nSlot==(m_nFirst+m_nCount-1)%m_nMaxFrames)
+        nCount--;
+
+    return nCount;
+}
+
+bool CFrameRingBuffer::GetImageSize(int nSlot, int nImage, int& nWidth, int& nHeight) const
+{
+    if(nImage<0 || nImage>=GetImageCount(nSlot))
+        return false;
+
+    const FrameImage& image = m_aSlots[nSlot][nImage];
+    nWidth = image.m_nWidth;
+    nHeight = image.m_nHeight;
+    return true;
+}
+
+bool CFrameRingBuffer::ReadImage(int nSlot, int nImage, unsigned char* pOut, int nStride)
+{
+    if(nImage<0 || nImage>=GetImageCount(nSlot))
+        return false;
+
+    const FrameImage& image = m_aSlots[nSlot][nImage];
+    size_t uRowSize = (size_t)image.m_nWidth*3;
+    int y;
+
+    if(image.m_bDelta)
+    {
+        const unsigned char* pDelta = NULL;
+
+        if(m_bCompress)
+        {
+            m_aDeltaData.resize(image.m_uDeltaSize);
+            if(inflateReset(&m_Inflate)!=Z_OK)
+                return false;
+
+            m_Inflate.next_in = (Bytef*)&image.m_aData[0];
+            m_Inflate.avail_in = (uInt)image.m_aData.size();
+            m_Inflate.next_out = &m_aDeltaData[0];
+            m_Inflate.avail_out = (uInt)m_aDeltaData.size();
+            if(inflate(&m_Inflate, Z_FINISH)!=Z_STREAM_END || m_Inflate.avail_out!=0)
+                return false;
+
+            pDelta = &m_aDeltaData[0];
+        }
+        else
+        {
+            pDelta = &image.m_aData[0];
+        }
+
+        // Tile flags are followed by rows of changed tiles
+        int nTilesX = (image.m_nWidth+TILE_SIZE-1)/TILE_SIZE;
+        int nTilesY = (image.m_nHeight+TILE_SIZE-1)/TILE_SIZE;
+        const unsigned char* pTileData = pDelta+nTilesX*nTilesY;
+        const unsigned char* pEnd = pDelta+image.m_uDeltaSize;
+        int nTileX, nTileY;
+        for(nTileY=0; nTileY<nTilesY; nTileY++)
+        {
+            int nBottom = (nTileY+1)*TILE_SIZE<image.m_nHeight ? (nTileY+1)*TILE_SIZE : image.m_nHeight;
+            for(nTileX=0; nTileX<nTilesX; nTileX++)
+            {
+                if(!pDelta[nTileY*nTilesX+nTileX])
+                    continue;
+
+                size_t uOffs = (size_t)nTileX*TILE_SIZE*3;
+                size_t uSize = uRowSize-uOffs<TILE_SIZE*3 ? uRowSize-uOffs : TILE_SIZE*3;
+                if(pTileData+uSize*(nBottom-nTileY*TILE_SIZE)>pEnd)
+                    return false;
+
+                for(y=nTileY*TILE_SIZE; y<nBottom; y++, pTileData+=uSize)
+                    memcpy(pOut+(size_t)y*nStride+uOffs, pTileData, uSize);
+            }
+        }
+
+        return true;
+    }
+
+    if(!m_bCompress)
+    {
+        for(y=0; y<image.m_nHeight; y++)
+            memcpy(pOut+(size_t)y*nStride, &image.m_aData[y*uRowSize], uRowSize);
+        return true;
+    }
+
+    if(inflateReset(&m_Inflate)!=Z_OK)
+        return false;
+
+    m_Inflate.next_in = (Bytef*)&image.m_aData[0];
+    m_Inflate.avail_in = (uInt)image.m_aData.size();
+
+    for(y=0; y<image.m_nHeight; y++)
+    {
+        m_Inflate.next_out = pOut+(size_t)y*nStride;
+        m_Inflate.avail_out = (uInt)uRowSize;
+
+        int nResult = inflate(&m_Inflate, Z_SYNC_FLUSH);
+        if((nResult!=Z_OK && nResult!=Z_STREAM_END) || m_Inflate.avail_out!=0)
+            return false;
+    }
+
+    return true;
+}
+
+size_t CFrameRingBuffer::GetDataSize() const
+{
+    return m_uDataSize;
+}
+
+void CFrameRingBuffer::ClearSlot(int nSlot)
+{
+    std::vector<FrameImage>& aImages = m_aSlots[nSlot];
+    size_t i;
+
+    for(i=0; i<aImages.size(); i++)
+        m_uDataSize -= aImages[i].m_aData.size();
+
+    aImages.clear();
+}
+
+void CFrameRingBuffer::AbortImage()
+{
+    if(!m_bInImage)
+        return;
+
+    std::vector<FrameImage>& aImages = m_aSlots[(m_nFirst+m_nCount-1)%m_nMaxFrames];
+
+    // The reference image holds some rows of the aborted image
+    if(m_nKeyFrameInterval>1)
+        m_aReferences[aImages.size()-1].m_nWidth = 0;
+
+    aImages.pop_back();
+    m_bInImage = false;
+}
+
+void CFrameRingBuffer::DropOldestFrame()
+{
+    do
+    {
+        ClearSlot(m_nFirst);
+        m_nFirst = (m_nFirst+1)%m_nMaxFrames;
+        m_nCount--;
+    }
+    while(m_nCount>0 && !m_aKeyFrames[m_nFirst]);
+}
+
+bool CFrameRingBuffer::HasNextKeyFrame() const
+{
+    int i;
+    for(i=1; i<m_nCount; i++)
+    {
+        if(m_aKeyFrames[(m_nFirst+i)%m_nMaxFrames])
+            return true;
+    }
+
+    return false;
+}
+
+void CFrameRingBuffer::MakeDelta(const ReferenceImage& ref)
+{
+    size_t uRowSize = (size_t)ref.m_nWidth*3;
+    int nTilesX = (ref.m_nWidth+TILE_SIZE-1)/TILE_SIZE;
+    int nTilesY = (ref.m_nHeight+TILE_SIZE-1)/TILE_SIZE;
+    int nTileX, nTileY, y;
+
+    m_aDeltaData.assign(m_aDirtyTiles.begin(), m_aDirtyTiles.end());
+
+    for(nTileY=0; nTileY<nTilesY; nTileY++)
+    {
+        int nBottom = (nTileY+1)*TILE_SIZE<ref.m_nHeight ? (nTileY+1)*TILE_SIZE : ref.m_nHeight;
+        for(nTileX=0; nTileX<nTilesX; nTileX++)
+        {
+            if(!m_aDirtyTiles[nTileY*nTilesX+nTileX])
+                continue;
+
+            size_t uOffs = (size_t)nTileX*TILE_SIZE*3;
+            size_t uSize = uRowSize-uOffs<TILE_SIZE*3 ? uRowSize-uOffs : TILE_SIZE*3;
+            for(y=nTileY*TILE_SIZE; y<nBottom; y++)
+            {
+                const unsigned char* pTileRow = &ref.m_aPixels[y*uRowSize+uOffs];
+                m_aDeltaData.insert(m_aDeltaData.end(), pTileRow, pTileRow+uSize);
+            }
+        }
+    }
+}
@@ -0,0 +1,142 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: FrameRingBuffer.h
+// Description: Bounded in-memory storage of captured video frames. The video recorder
+// keeps the last frames here instead of writing BMP files to a temp folder, and the
+// encoder reads them back from memory.
+
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include "zlib.h"
+
+// class CFrameRingBuffer
+// Stores up to a given number of frames, each made of one or more 24-bit images (one
+// per monitor). When all slots are used or the stored data exceeds the size limit, the
+// oldest frames are dropped. Images may be deflated as they are added.
+//
+// With delta capture on, only key frames store whole images. Other frames store the
+// tiles of each image that changed since the previous frame. Frames are dropped
+// together with the deltas that depend on them, so the oldest frame stored is always
+// a key frame.
+class CFrameRingBuffer
+{
+public:
+
+    CFrameRingBuffer();
+    ~CFrameRingBuffer();
+
+    // Allocates nMaxFrames slots. uMaxSize limits the size of stored image data (the
+    // newest frame is kept even if it alone exceeds the limit). If bCompress is true,
+    // images are compressed with zlib at the fastest level. If nKeyFrameInterval is
+    // greater than 1, every nKeyFrameInterval-th frame is a key frame and the others
+    // are stored as deltas.
+    bool Init(int nMaxFrames, size_t uMaxSize, bool bCompress, int nKeyFrameInterval = 1);
+
+    // Frees all frames and slots.
+    void Destroy();
+
+    // Starts a new frame and returns its slot index. If all slots are used,
+    // the oldest frame is dropped and its slot is reused.
+    int AddFrame();
+
+    // Removes the newest frame (for example, if its capture failed).
+    void CancelFrame();
+
+    // Adds an image to the newest frame row by row, top row first. A row is nWidth*3 bytes.
+    bool BeginImage(int nWidth, int nHeight);
+    bool AddImageRow(const unsigned char* pRow);
+    bool EndImage();
+
+    // Adds a whole image, rows are nStride bytes apart.
+    bool AddImage(const unsigned char* pPixels, int nWidth, int nHeight, int nStride);
+
+    // Returns the number of frames stored.
+    int GetFrameCount() const;
+
+    // Returns the slot index of a frame; frame 0 is the oldest one.
+    int GetFrameSlot(int nFrame) const;
+
+    // Returns true if the frame stored in the slot is a key frame.
+    bool IsKeyFrame(int nSlot) const;
+
+    // Returns the number of images in the frame stored in the slot.
+    int GetImageCount(int nSlot) const;
+
+    // Returns the size of an image.
+    bool GetImageSize(int nSlot, int nImage, int& nWidth, int& nHeight) const;
+
+    // Restores an image to pOut, top row first, rows nStride bytes apart. A delta image
+    // only overwrites the tiles that changed, so pOut must hold the image with the same
+    // index restored last; read frames in order starting from frame 0.
+    bool ReadImage(int nSlot, int nImage, unsigned char* pOut, int nStride);
+
+    // Returns the size of image data stored, in bytes.
+    size_t GetDataSize() const;
+
+private:
+
+    // An image of a frame
+    struct FrameImage
+    {
+        int m_nWidth;                       // Width in pixels
+        int m_nHeight;                      // Height in pixels
+        bool m_bDelta;                      // Are only changed tiles stored?
+        size_t m_uDeltaSize;                // Size of delta data before compression
+        std::vector<unsigned char> m_aData; // Pixels or delta data, deflated if compression is on
+    };
+
+    // The last image added with a given index, changed tiles are found against it
+    struct ReferenceImage
+    {
+        int m_nWidth;                         // Width in pixels, 0 if not valid
+        int m_nHeight;                        // Height in pixels
+        std::vector<unsigned char> m_aPixels; // Rows of nWidth*3 bytes
+    };
+
+    // Frees images of a slot
+    void ClearSlot(int nSlot);
+
+    // Removes the image being added from the newest frame
+    void AbortImage();
+
+    // Drops the oldest frame and the delta frames following it
+    void DropOldestFrame();
+
+    // Returns true if a frame other than the oldest one is a key frame
+    bool HasNextKeyFrame() const;
+
+    // Serializes changed tiles of the image being added to m_aDeltaData
+    void MakeDelta(const ReferenceImage& ref);
+
+    int m_nMaxFrames;       // Number of slots
+    size_t m_uMaxSize;      // Limit of image data size
+    bool m_bCompress;       // Deflate images?
+    int m_nKeyFrameInterval; // Frames between key frames, 1 if delta capture is off
+    std::vector< std::vector<FrameImage> > m_aSlots; // Images of each slot
+    std::vector<unsigned char> m_aKeyFrames; // Is the frame in a slot a key frame?
+    int m_nFirst;           // Slot of the oldest frame
+    int m_nCount;           // Number of frames stored
+    size_t m_uDataSize;     // Size of image data stored
+    int m_nFramesSinceKey;  // Frames added after the last key frame
+    bool m_bForceKeyFrame;  // Must the next frame be a key frame?
+    bool m_bInImage;        // Is an image being added?
+    bool m_bDeltaImage;     // Is the image being added stored as a delta?
+    int m_nRowsLeft;        // Rows of the image being added that are not received yet
+    bool m_bDeflateInit;    // Is m_Deflate initialized?
+    bool m_bInflateInit;    // Is m_Inflate initialized?
+    z_stream m_Deflate;     // Compressor state, reused for every image
+    z_stream m_Inflate;     // Decompressor state, reused for every image
+    std::vector<unsigned char> m_aImageData; // Data of the image being added
+    std::vector<ReferenceImage> m_aReferences; // Reference image for each image index
+    std::vector<unsigned char> m_aDirtyTiles; // Changed tiles of the image being added
+    std::vector<unsigned char> m_aDeltaData; // Uncompressed delta data
+};
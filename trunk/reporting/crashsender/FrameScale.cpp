@@ -0,0 +1,150 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "FrameScale.h"
+#include <string.h>
+
+void CFrameScaler::MakeTaps(AxisTaps& taps, int nSrcSize, int nDstSize, int nBegin, int nEnd)
+{
+    int i;
+
+    taps.m_aFirst.resize(nEnd-nBegin);
+    taps.m_aCount.resize(nEnd-nBegin);
+    taps.m_aOffset.resize(nEnd-nBegin);
+    taps.m_aWeights.clear();
+
+    // Coordinates are in units of 1/nDstSize of a source pixel, so destination
+    // pixel i covers [i*nSrcSize, (i+1)*nSrcSize)
+    for(i=nBegin; i<nEnd; i++)
+    {
+        long long nStart = (long long)i*nSrcSize;
+        long long nStop = nStart+nSrcSize;
+        int nFirst = (int)(nStart/nDstSize);
+        int nLast = (int)((nStop-1)/nDstSize);
+        unsigned uTotal = 0;
+        int j;
+
+        taps.m_aFirst[i-nBegin] = nFirst;
+        taps.m_aCount[i-nBegin] = nLast-nFirst+1;
+        taps.m_aOffset[i-nBegin] = (int)taps.m_aWeights.size();
+
+        for(j=nFirst; j<=nLast; j++)
+        {
+            long long nPixelStart = (long long)j*nDstSize;
+            long long nPixelStop = nPixelStart+nDstSize;
+            long long nOverlap = (nStop<nPixelStop ? nStop : nPixelStop)-
+                (nStart>nPixelStart ? nStart : nPixelStart);
+            unsigned uWeight = (unsigned)(nOverlap*65536/nSrcSize);
+
+            // The last weight takes the rounding error
+            if(j==nLast)
+                uWeight = 65536-uTotal;
+
+            taps.m_aWeights.push_back(uWeight);
+            uTotal += uWeight;
+        }
+    }
+}
+
+void CFrameScaler::Draw(const unsigned char* pSrc, int nSrcWidth, int nSrcHeight, int nSrcStride,
+    unsigned char* pDst, int nDstWidth, int nDstHeight, int nDstStride,
+    int xDest, int yDest, int nDestWidth, int nDestHeight)
+{
+    if(nSrcWidth<=0 || nSrcHeight<=0 || nDestWidth<=0 || nDestHeight<=0)
+        return;
+
+    // Clip the destination rectangle
+    int nLeft = xDest>0 ? xDest : 0;
+    int nTop = yDest>0 ? yDest : 0;
+    int nRight = xDest+nDestWidth<nDstWidth ? xDest+nDestWidth : nDstWidth;
+    int nBottom = yDest+nDestHeight<nDstHeight ? yDest+nDestHeight : nDstHeight;
+    if(nLeft>=nRight || nTop>=nBottom)
+        return;
+
+    int nCols = nRight-nLeft;
+    int x, y, i;
+
+    if(nDestWidth==nSrcWidth && nDestHeight==nSrcHeight)
+    {
+        // Not scaled
+        for(y=nTop; y<nBottom; y++)
+        {
+            memcpy(pDst+(size_t)y*nDstStride+nLeft*3,
+                pSrc+(size_t)(y-yDest)*nSrcStride+(nLeft-xDest)*3, nCols*3);
+        }
+        return;
+    }
+
+    MakeTaps(m_Horz, nSrcWidth, nDestWidth, nLeft-xDest, nRight-xDest);
+    MakeTaps(m_Vert, nSrcHeight, nDestHeight, nTop-yDest, nBottom-yDest);
+
+    // Source rows used by the clipped rectangle
+    int nRowFirst = m_Vert.m_aFirst[0];
+    int nRowEnd = m_Vert.m_aFirst[nBottom-nTop-1]+m_Vert.m_aCount[nBottom-nTop-1];
+    size_t uRowSize = (size_t)nCols*3;
+
+    m_aRows.resize((nRowEnd-nRowFirst)*uRowSize);
+    m_aSum.resize(uRowSize);
+
+    // Scale source rows horizontally
+    for(y=nRowFirst; y<nRowEnd; y++)
+    {
+        const unsigned char* pSrcRow = pSrc+(size_t)y*nSrcStride;
+        unsigned short* pRow = &m_aRows[(y-nRowFirst)*uRowSize];
+
+        if(nDestWidth==nSrcWidth)
+        {
+            const unsigned char* p = pSrcRow+(nLeft-xDest)*3;
+            for(x=0; x<(int)uRowSize; x++)
+                pRow[x] = (unsigned short)(p[x]<<8);
+            continue;
+        }
+
+        for(x=0; x<nCols; x++)
+        {
+            const unsigned char* p = pSrcRow+m_Horz.m_aFirst[x]*3;
+            const unsigned* pWeight = &m_Horz.m_aWeights[m_Horz.m_aOffset[x]];
+            unsigned uB = 0;
+            unsigned uG = 0;
+            unsigned uR = 0;
+            for(i=0; i<m_Horz.m_aCount[x]; i++, p+=3)
+            {
+                uB += pWeight[i]*p[0];
+                uG += pWeight[i]*p[1];
+                uR += pWeight[i]*p[2];
+            }
+            pRow[x*3] = (unsigned short)((uB+128)>>8);
+            pRow[x*3+1] = (unsigned short)((uG+128)>>8);
+            pRow[x*3+2] = (unsigned short)((uR+128)>>8);
+        }
+    }
+
+    // Blend scaled rows vertically. The sum of 8.8 values and 16-bit weights fits 32 bits.
+    unsigned* pSum = &m_aSum[0];
+    for(y=nTop; y<nBottom; y++)
+    {
+        int nRow = y-nTop;
+        const unsigned* pWeight = &m_Vert.m_aWeights[m_Vert.m_aOffset[nRow]];
+        size_t j;
+
+        memset(pSum, 0, uRowSize*sizeof(unsigned));
+        for(i=0; i<m_Vert.m_aCount[nRow]; i++)
+        {
+            const unsigned short* pRow = &m_aRows[(m_Vert.m_aFirst[nRow]+i-nRowFirst)*uRowSize];
+            unsigned uWeight = pWeight[i];
+            for(j=0; j<uRowSize; j++)
+                pSum[j] += uWeight*pRow[j];
+        }
+
+        unsigned char* pDstRow = pDst+(size_t)y*nDstStride+nLeft*3;
+        for(j=0; j<uRowSize; j++)
+            pDstRow[j] = (unsigned char)((pSum[j]+(1<<23))>>24);
+    }
+}
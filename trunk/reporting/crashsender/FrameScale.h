@@ -0,0 +1,52 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: FrameScale.h
+// Description: Scaling of 24-bit images when monitor images are composed into a video
+// frame. Doesn't use GDI, so frames may be composed by several threads at once.
+
+#pragma once
+#include <vector>
+
+// class CFrameScaler
+// Draws 24-bit images scaled to a rectangle of another 24-bit image. Every destination
+// pixel is the average of the source area it covers (as with GDI's HALFTONE stretch mode),
+// computed with 16-bit fixed-point weights. An object keeps its work buffers between
+// calls and must not be used by several threads at once.
+class CFrameScaler
+{
+public:
+
+    // Draws the source image to the destination rectangle (xDest, yDest, nDestWidth,
+    // nDestHeight). The parts of the rectangle outside the destination image are clipped.
+    void Draw(const unsigned char* pSrc, int nSrcWidth, int nSrcHeight, int nSrcStride,
+        unsigned char* pDst, int nDstWidth, int nDstHeight, int nDstStride,
+        int xDest, int yDest, int nDestWidth, int nDestHeight);
+
+private:
+
+    // Weights of the source pixels covered by each destination pixel along an axis
+    struct AxisTaps
+    {
+        std::vector<int> m_aFirst;        // First source pixel of each destination pixel
+        std::vector<int> m_aCount;        // Number of source pixels
+        std::vector<int> m_aOffset;       // Offset of the first weight in m_aWeights
+        std::vector<unsigned> m_aWeights; // Weights, 65536 in total for a destination pixel
+    };
+
+    // Computes taps of destination pixels nBegin to nEnd-1 of nDstSize pixels
+    // covering nSrcSize source pixels
+    static void MakeTaps(AxisTaps& taps, int nSrcSize, int nDstSize, int nBegin, int nEnd);
+
+    AxisTaps m_Horz;                        // Taps of destination columns
+    AxisTaps m_Vert;                        // Taps of destination rows
+    std::vector<unsigned short> m_aRows;    // Source rows scaled horizontally, 8.8 fixed point
+    std::vector<unsigned> m_aSum;           // Destination row being accumulated
+};
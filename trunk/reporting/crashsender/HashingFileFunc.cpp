@@ -0,0 +1,168 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "HashingFileFunc.h"
+#include <stdio.h>
+#include <string.h>
+
+CHashingFileFunc::CHashingFileFunc()
+{
+    memset(&m_Base, 0, sizeof(m_Base));
+    m_bSHA256 = false;
+    m_uPos = 0;
+    m_uEnd = 0;
+    m_uHashed = 0;
+    m_bSequential = false;
+}
+
+void CHashingFileFunc::Wrap(const zlib_filefunc64_def* pBase, zlib_filefunc64_def* pFileFunc)
+{
+    m_Base = *pBase;
+
+    pFileFunc->zopen64_file = Open;
+    pFileFunc->zread_file = Read;
+    pFileFunc->zwrite_file = Write;
+    pFileFunc->ztell64_file = Tell;
+    pFileFunc->zseek64_file = Seek;
+    pFileFunc->zclose_file = Close;
+    pFileFunc->zerror_file = Error;
+    pFileFunc->opaque = this;
+}
+
+void CHashingFileFunc::SetSHA256(bool bSHA256)
+{
+    m_bSHA256 = bSHA256;
+}
+
+bool CHashingFileFunc::GetMD5Hash(std::string& sMD5Hash)
+{
+    CReportDigest Digest;
+
+    sMD5Hash.clear();
+
+    if(!GetDigest(Digest))
+        return false;
+
+    sMD5Hash = Digest.GetMD5Hash();
+    return true;
+}
+
+bool CHashingFileFunc::GetDigest(CReportDigest& Digest)
+{
+    if(!m_bSequential || m_uHashed!=m_uEnd)
+        return false;
+
+    // Finalize a copy, so more data may be hashed later
+    Digest = m_Digest;
+    Digest.Final();
+    return true;
+}
+
+ZPOS64_T CHashingFileFunc::GetHashedSize() const
+{
+    return m_uHashed;
+}
+
+voidpf ZCALLBACK CHashingFileFunc::Open(voidpf opaque, const void* filename, int mode)
+{
+    CHashingFileFunc* pThis = (CHashingFileFunc*)opaque;
+
+    pThis->m_Digest.Init(pThis->m_bSHA256);
+    pThis->m_uPos = 0;
+    pThis->m_uEnd = 0;
+    pThis->m_uHashed = 0;
+    // Contents of an existing file are not hashed
+    pThis->m_bSequential = (mode & ZLIB_FILEFUNC_MODE_CREATE)!=0;
+
+    return pThis->m_Base.zopen64_file(pThis->m_Base.opaque, filename, mode);
+}
+
+uLong ZCALLBACK CHashingFileFunc::Read(voidpf opaque, voidpf stream, void* buf, uLong size)
+{
+    CHashingFileFunc* pThis = (CHashingFileFunc*)opaque;
+
+    uLong uRead = pThis->m_Base.zread_file(pThis->m_Base.opaque, stream, buf, size);
+    pThis->m_uPos += uRead;
+    return uRead;
+}
+
+uLong ZCALLBACK CHashingFileFunc::Write(voidpf opaque, voidpf stream, const void* buf, uLong size)
+{
+    CHashingFileFunc* pThis = (CHashingFileFunc*)opaque;
+
+    uLong uWritten = pThis->m_Base.zwrite_file(pThis->m_Base.opaque, stream, buf, size);
+
+    if(pThis->m_uPos==pThis->m_uHashed)
+    {
+        // Appending to the hashed data
+        pThis->m_Digest.Update(buf, uWritten);
+        pThis->m_uHashed += uWritten;
+    }
+    else
+    {
+        // Hashed data are overwritten, or there is a gap
+        pThis->m_bSequential = false;
+    }
+
+    pThis->m_uPos += uWritten;
+    if(pThis->m_uPos>pThis->m_uEnd)
+        pThis->m_uEnd = pThis->m_uPos;
+
+    return uWritten;
+}
+
+ZPOS64_T ZCALLBACK CHashingFileFunc::Tell(voidpf opaque, voidpf stream)
+{
+    CHashingFileFunc* pThis = (CHashingFileFunc*)opaque;
+
+    return pThis->m_Base.ztell64_file(pThis->m_Base.opaque, stream);
+}
+
+long ZCALLBACK CHashingFileFunc::Seek(voidpf opaque, voidpf stream, ZPOS64_T offset, int origin)
+{
+    CHashingFileFunc* pThis = (CHashingFileFunc*)opaque;
+
+    long lResult = pThis->m_Base.zseek64_file(pThis->m_Base.opaque, stream, offset, origin);
+    if(lResult!=0)
+    {
+        // The position is unknown now
+        pThis->m_bSequential = false;
+        return lResult;
+    }
+
+    switch(origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_SET:
+        pThis->m_uPos = offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_CUR:
+        pThis->m_uPos += offset;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END:
+        pThis->m_uPos = pThis->m_uEnd+offset;
+        break;
+    }
+
+    return lResult;
+}
+
+int ZCALLBACK CHashingFileFunc::Close(voidpf opaque, voidpf stream)
+{
+    CHashingFileFunc* pThis = (CHashingFileFunc*)opaque;
+
+    return pThis->m_Base.zclose_file(pThis->m_Base.opaque, stream);
+}
+
+int ZCALLBACK CHashingFileFunc::Error(voidpf opaque, voidpf stream)
+{
+    CHashingFileFunc* pThis = (CHashingFileFunc*)opaque;
+
+    return pThis->m_Base.zerror_file(pThis->m_Base.opaque, stream);
+}
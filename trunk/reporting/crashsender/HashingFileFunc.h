@@ -0,0 +1,66 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: HashingFileFunc.h
+// Description: minizip file functions that compute the digest of the archive while it
+// is being written, so the ZIP file doesn't have to be read again to hash it.
+
+#pragma once
+#include <string>
+#include "ioapi.h"
+#include "ReportDigest.h"
+
+// class CHashingFileFunc
+// Wraps zlib_filefunc64_def and hashes the bytes written to the file. The hash is
+// valid only if the file is written sequentially; if minizip seeks back and rewrites
+// the data already hashed, the hash is discarded and should be calculated from the file.
+// A single object serves one open file at a time.
+class CHashingFileFunc
+{
+public:
+
+    CHashingFileFunc();
+
+    // Calculate the SHA-256 hash in addition to MD5. Should be called before the file is opened.
+    void SetSHA256(bool bSHA256);
+
+    // Fills pFileFunc with functions calling pBase ones and hashing written data.
+    // The object must live until the file is closed.
+    void Wrap(const zlib_filefunc64_def* pBase, zlib_filefunc64_def* pFileFunc);
+
+    // Returns MD5 hash of the file as a string of 32 lowercase hex digits.
+    // Returns false if the file was not written sequentially.
+    bool GetMD5Hash(std::string& sMD5Hash);
+
+    // Returns the finalized digest of the file.
+    // Returns false if the file was not written sequentially.
+    bool GetDigest(CReportDigest& Digest);
+
+    // Returns the number of bytes hashed
+    ZPOS64_T GetHashedSize() const;
+
+private:
+
+    static voidpf ZCALLBACK Open(voidpf opaque, const void* filename, int mode);
+    static uLong ZCALLBACK Read(voidpf opaque, voidpf stream, void* buf, uLong size);
+    static uLong ZCALLBACK Write(voidpf opaque, voidpf stream, const void* buf, uLong size);
+    static ZPOS64_T ZCALLBACK Tell(voidpf opaque, voidpf stream);
+    static long ZCALLBACK Seek(voidpf opaque, voidpf stream, ZPOS64_T offset, int origin);
+    static int ZCALLBACK Close(voidpf opaque, voidpf stream);
+    static int ZCALLBACK Error(voidpf opaque, voidpf stream);
+
+    zlib_filefunc64_def m_Base; // Wrapped functions
+    CReportDigest m_Digest;     // Digest of the data written
+    bool m_bSHA256;             // Calculate SHA-256 hash?
+    ZPOS64_T m_uPos;            // Current file position
+    ZPOS64_T m_uEnd;            // File size
+    ZPOS64_T m_uHashed;         // Number of bytes hashed from the file start
+    bool m_bSequential;         // False if hashed data were overwritten or skipped
+};
@@ -29,6 +29,9 @@ CHttpRequestSender::CHttpRequestSender()
     m_sTextPartFooterFmt = _T("\r\n");   
     m_sFilePartHeaderFmt = _T("--%s\r\nContent-disposition: form-data; name=\"%s\"; filename=\"%s\"\r\nContent-Type: %s\r\nContent-Transfer-Encoding: binary\r\n\r\n");
     m_sFilePartFooterFmt = _T("\r\n");  
+    m_hChunkFile = INVALID_HANDLE_VALUE;
+    m_hChunkConnect = NULL;
+    m_dwChunkFlags = 0;
 }
 
 // Sends HTTP request assyncronously (in a working thread)
@@ -135,6 +138,26 @@ BOOL CHttpRequestSender::InternalSend()
     DWORD dwFlags = INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_NO_AUTO_REDIRECT;
     if(dwPort==INTERNET_DEFAULT_HTTPS_PORT)
       dwFlags |= INTERNET_FLAG_SECURE; // Use SSL
+
+  // Try to upload a large attachment in chunks, so a dropped connection
+  // doesn't make us upload it from the beginning
+  int nChunked = InternalSendChunked(hConnect, szURI, dwFlags);
+  if(nChunked==CHUNKED_OK)
+  {
+    m_async->SetProgress(_T("Error report has been sent OK!"), 100, false);
+    bStatus = TRUE;
+    goto cleanup;
+  }
+  else if(nChunked==CHUNKED_ERR_CANCELLED)
+  {
+    goto cleanup;
+  }
+  else if(nChunked!=CHUNKED_ERR_UNSUPPORTED)
+  {
+    // The data uploaded so far are kept by the server for the next attempt,
+    // but try to deliver the report with a single request now
+    m_async->SetProgress(_T("Chunked upload has failed; sending the whole file."), 0);
+  }
   
   BOOL bRedirect = FALSE;
   int nCount = 0;
@@ -159,19 +182,7 @@ BOOL CHttpRequestSender::InternalSend()
       goto cleanup;
     }
 
-    // This code was copied from http://support.microsoft.com/kb/182888 to address the problem
-    // that MVS doesn't have a valid SSL certificate.
-    DWORD extraSSLDwFlags = 0;
-    DWORD dwBuffLen = sizeof(extraSSLDwFlags);
-    InternetQueryOption (hRequest, INTERNET_OPTION_SECURITY_FLAGS,
-    (LPVOID)&extraSSLDwFlags, &dwBuffLen);
-    // We have to specifically ignore these 2 errors for MVS	
-    extraSSLDwFlags |= SECURITY_FLAG_IGNORE_REVOCATION |  // Ignores certificate revocation problems.
-               SECURITY_FLAG_IGNORE_WRONG_USAGE | // Ignores incorrect usage problems.
-               SECURITY_FLAG_IGNORE_CERT_CN_INVALID | // Ignores the ERROR_INTERNET_SEC_CERT_CN_INVALID error message.
-               SECURITY_FLAG_IGNORE_CERT_DATE_INVALID; // Ignores the ERROR_INTERNET_SEC_CERT_DATE_INVALID error message.
-    InternetSetOption (hRequest, INTERNET_OPTION_SECURITY_FLAGS,
-              &extraSSLDwFlags, sizeof (extraSSLDwFlags) );
+    SetSecurityFlags(hRequest);
 
     // Fill in buffer
     BufferIn.dwStructSize = sizeof( INTERNET_BUFFERS ); // Must be set or error will occur
@@ -713,6 +724,202 @@ BOOL CHttpRequestSender::CalcAttachmentPartSize(WTL::CString sName, LONGLONG& lS
     return TRUE;
 }
 
+// This method uploads the attachment in chunks. Returns CHUNKED_ERR_UNSUPPORTED if
+// the request doesn't fit or the server doesn't support chunked upload.
+int CHttpRequestSender::InternalSendChunked(HINTERNET hConnect, LPCTSTR szURI, DWORD dwFlags)
+{
+    WTL::CString sMsg;
+    LARGE_INTEGER lFileSize;
+    std::map<WTL::CString, std::string>::iterator itGuid = m_Request.m_aTextFields.find(_T("crashguid"));
+    std::map<WTL::CString, std::string>::iterator itMD5 = m_Request.m_aTextFields.find(_T("md5"));
+
+    // A single attachment identified by crash GUID and its hash is required
+    if(m_Request.m_aIncludedFiles.size()!=1 || 
+       itGuid==m_Request.m_aTextFields.end() || itMD5==m_Request.m_aTextFields.end())
+        return CHUNKED_ERR_UNSUPPORTED;
+
+    m_hChunkFile = CreateFile(m_Request.m_aIncludedFiles.begin()->second.m_sSrcFileName, 
+        GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL); 
+    if(m_hChunkFile==INVALID_HANDLE_VALUE)
+        return CHUNKED_ERR_UNSUPPORTED;
+
+    if(!GetFileSizeEx(m_hChunkFile, &lFileSize) || 
+       lFileSize.QuadPart<=CHUNKED_UPLOAD_DEFAULT_CHUNK_SIZE)
+    {
+        // Small files are sent with a single request
+        CloseHandle(m_hChunkFile);
+        m_hChunkFile = INVALID_HANDLE_VALUE;
+        return CHUNKED_ERR_UNSUPPORTED;
+    }
+
+    m_async->SetProgress(_T("Querying server for chunked upload..."), 0);
+
+    m_hChunkConnect = hConnect;
+    m_sChunkURI = szURI;
+    m_dwChunkFlags = dwFlags;
+    m_dwPostSize = (DWORD)(lFileSize.QuadPart>0xffffffff?0xffffffff:lFileSize.QuadPart);
+    m_dwUploaded = 0;
+
+    CChunkedUpload upload;
+    int nResult = upload.Upload(itGuid->second + "-" + itMD5->second, 
+        lFileSize.QuadPart, ChunkReadCallback, ChunkTransportCallback, this);
+
+    CloseHandle(m_hChunkFile);
+    m_hChunkFile = INVALID_HANDLE_VALUE;
+
+    if(nResult==CHUNKED_ERR_UNSUPPORTED)
+    {
+        m_async->SetProgress(_T("Server doesn't support chunked upload; sending the whole file."), 0);
+    }
+    else
+    {
+        sMsg.Format(_T("Chunked upload: resumed at %I64u bytes, sent %I64u bytes in %d requests, result %d."), 
+            upload.GetResumeOffset(), upload.GetBytesSent(), upload.GetRequestCount(), nResult);
+        m_async->SetProgress(sMsg, 0);
+    }
+
+    return nResult;
+}
+
+bool CHttpRequestSender::ChunkReadCallback(uint64_t uOffset, void* pBuf, size_t uSize, void* pParam)
+{
+    CHttpRequestSender* pSender = (CHttpRequestSender*)pParam;
+    LARGE_INTEGER lPos;
+    DWORD dwBytesRead = 0;
+
+    lPos.QuadPart = (LONGLONG)uOffset;
+    if(!SetFilePointerEx(pSender->m_hChunkFile, lPos, NULL, FILE_BEGIN))
+        return false;
+
+    if(!ReadFile(pSender->m_hChunkFile, pBuf, (DWORD)uSize, &dwBytesRead, NULL) || dwBytesRead!=uSize)
+    {
+        pSender->m_async->SetProgress(_T("Error reading data from attachment file."), 0);
+        return false;
+    }
+
+    return true;
+}
+
+int CHttpRequestSender::ChunkTransportCallback(const ChunkRequest& Request, ChunkResponse& Response, void* pParam)
+{
+    CHttpRequestSender* pSender = (CHttpRequestSender*)pParam;
+    strconv_t strconv;
+    WTL::CString sHeaders = _T("Content-type: multipart/form-data; boundary=") + pSender->m_sBoundary;
+    LPCTSTR szAccept[2]={_T("*/*"), NULL};
+    std::map<std::string, std::string> aFields;
+    std::map<std::string, std::string>::iterator it;
+    std::string sBody;
+    char szNumber[32];
+    BYTE pBuffer[4096];
+    DWORD dwBuffSize = 0;
+    DWORD dwHttpStatus = 0;
+    DWORD dwHttpStatusSize = sizeof(dwHttpStatus);
+    int nResult = CHUNK_NOT_SENT;
+
+    if(pSender->m_async->IsCancelled())
+        return CHUNK_CANCELLED;
+
+    // Crash GUID and hash are sent with each request, the rest of the
+    // report fields is sent on commit
+    if(strcmp(Request.m_szAction, "commit")==0)
+    {
+        std::map<WTL::CString, std::string>::iterator it2;
+        for(it2=pSender->m_Request.m_aTextFields.begin(); it2!=pSender->m_Request.m_aTextFields.end(); it2++)
+            aFields[strconv.t2a(it2->first)] = it2->second;
+    }
+    else
+    {
+        aFields["crashguid"] = pSender->m_Request.m_aTextFields[_T("crashguid")];
+        aFields["md5"] = pSender->m_Request.m_aTextFields[_T("md5")];
+    }
+
+    aFields["chunkaction"] = Request.m_szAction;
+    aFields["uploadid"] = Request.m_sUploadId;
+    sprintf_s(szNumber, sizeof(szNumber), "%I64u", Request.m_uTotalSize);
+    aFields["totalsize"] = szNumber;
+    sprintf_s(szNumber, sizeof(szNumber), "%I64u", Request.m_uOffset);
+    aFields["offset"] = szNumber;
+
+    // Format multipart form data
+    std::string sBoundary = strconv.t2a(pSender->m_sBoundary);
+    for(it=aFields.begin(); it!=aFields.end(); it++)
+    {
+        sBody += "--" + sBoundary + "\r\nContent-disposition: form-data; name=\"" + it->first + "\"\r\n\r\n";
+        sBody += it->second + "\r\n";
+    }
+    if(Request.m_uDataSize!=0)
+    {
+        sBody += "--" + sBoundary + "\r\nContent-disposition: form-data; name=\"chunk\"; filename=\"chunk.bin\"\r\n"
+            "Content-Type: application/octet-stream\r\nContent-Transfer-Encoding: binary\r\n\r\n";
+        sBody.append((const char*)Request.m_pData, Request.m_uDataSize);
+        sBody += "\r\n";
+    }
+    sBody += "--" + sBoundary + "--\r\n";
+
+    HINTERNET hRequest = HttpOpenRequest(pSender->m_hChunkConnect, _T("POST"), pSender->m_sChunkURI, 
+        NULL, NULL, szAccept, pSender->m_dwChunkFlags, 0);
+    if(hRequest==NULL)
+        return CHUNK_NOT_SENT;
+
+    pSender->SetSecurityFlags(hRequest);
+
+    if(!HttpSendRequest(hRequest, sHeaders, sHeaders.GetLength(), (LPVOID)sBody.data(), (DWORD)sBody.size()))
+        goto cleanup;
+
+    if(HttpQueryInfo(hRequest, HTTP_QUERY_STATUS_CODE|HTTP_QUERY_FLAG_NUMBER, 
+        &dwHttpStatus, &dwHttpStatusSize, 0))
+        Response.m_nHttpStatus = (int)dwHttpStatus;
+
+    // Read response body
+    for(;;)
+    {
+        if(!InternetReadFile(hRequest, pBuffer, sizeof(pBuffer), &dwBuffSize))
+            goto cleanup;
+        if(dwBuffSize==0)
+            break;
+        Response.m_sBody.append((const char*)pBuffer, dwBuffSize);
+    }
+
+    // Update progress with the number of bytes the server has
+    if(Request.m_uDataSize!=0)
+    {
+        int nStatus = 0;
+        bool bHasOffset = false;
+        uint64_t uOffset = 0;
+        if(CChunkedUpload::ParseResponse(Response.m_sBody, nStatus, bHasOffset, uOffset) && bHasOffset)
+        {
+            pSender->m_dwUploaded = 0;
+            pSender->UploadProgress((DWORD)(uOffset>pSender->m_dwPostSize?pSender->m_dwPostSize:uOffset));
+        }
+    }
+
+    nResult = CHUNK_SENT;
+
+cleanup:
+
+    InternetCloseHandle(hRequest);
+
+    return nResult;
+}
+
+// This method disables SSL certificate checks for the request
+void CHttpRequestSender::SetSecurityFlags(HINTERNET hRequest)
+{
+    // This code was copied from http://support.microsoft.com/kb/182888 to address the problem
+    // that MVS doesn't have a valid SSL certificate.
+    DWORD extraSSLDwFlags = 0;
+    DWORD dwBuffLen = sizeof(extraSSLDwFlags);
+    InternetQueryOption (hRequest, INTERNET_OPTION_SECURITY_FLAGS,
+    (LPVOID)&extraSSLDwFlags, &dwBuffLen);
+    // We have to specifically ignore these 2 errors for MVS	
+    extraSSLDwFlags |= SECURITY_FLAG_IGNORE_REVOCATION |  // Ignores certificate revocation problems.
+               SECURITY_FLAG_IGNORE_WRONG_USAGE | // Ignores incorrect usage problems.
+               SECURITY_FLAG_IGNORE_CERT_CN_INVALID | // Ignores the ERROR_INTERNET_SEC_CERT_CN_INVALID error message.
+               SECURITY_FLAG_IGNORE_CERT_DATE_INVALID; // Ignores the ERROR_INTERNET_SEC_CERT_DATE_INVALID error message.
+    InternetSetOption (hRequest, INTERNET_OPTION_SECURITY_FLAGS,
+              &extraSSLDwFlags, sizeof (extraSSLDwFlags) );
+}
+
 // This method updates upload progress status
 void CHttpRequestSender::UploadProgress(DWORD dwBytesWritten)
 {
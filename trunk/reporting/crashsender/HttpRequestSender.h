@@ -16,6 +16,7 @@ be found in the Authors.txt file in the root of the source tree.
 #pragma once
 #include "stdafx.h"
 #include "AsyncNotification.h"
+#include "ChunkedUpload.h"
 
 
 struct CHttpRequestFile
@@ -51,6 +52,18 @@ private:
 
     BOOL InternalSend();
 
+    // Uploads the attachment in chunks, returns ChunkedUploadError
+    int InternalSendChunked(HINTERNET hConnect, LPCTSTR szURI, DWORD dwFlags);
+
+    // Reads a chunk of the attachment file
+    static bool ChunkReadCallback(uint64_t uOffset, void* pBuf, size_t uSize, void* pParam);
+
+    // Sends a chunked upload request, returns ChunkTransportResult
+    static int ChunkTransportCallback(const ChunkRequest& Request, ChunkResponse& Response, void* pParam);
+
+    // Ignores SSL certificate problems for the request
+    void SetSecurityFlags(HINTERNET hRequest);
+
     // Used to calculate summary size of the request
     BOOL CalcRequestSize(LONGLONG& lSize);
     BOOL FormatTextPartHeader(WTL::CString sName, WTL::CString& sText);
@@ -79,6 +92,10 @@ private:
     WTL::CString m_sBoundary;
     DWORD m_dwPostSize;
     DWORD m_dwUploaded;
+    HANDLE m_hChunkFile;          // Attachment being uploaded in chunks
+    HINTERNET m_hChunkConnect;    // Connection used for chunk requests
+    WTL::CString m_sChunkURI;     // URI of chunk requests
+    DWORD m_dwChunkFlags;         // HttpOpenRequest flags of chunk requests
 };
 
 
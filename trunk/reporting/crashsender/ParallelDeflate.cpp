@@ -0,0 +1,459 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "ParallelDeflate.h"
+#include <string.h>
+#include <stdlib.h>
+#include "zlib.h"
+#include "ThreadSync.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Size of deflate window, the dictionary of a block is that much of the previous block
+#define PDEFLATE_DICT_SIZE 32768
+
+// Alignment of input buffers (page size, suitable for unbuffered I/O)
+#define PDEFLATE_BUF_ALIGN 4096
+
+// Maximum block size (zlib takes uInt sizes)
+#define PDEFLATE_MAX_BLOCK_SIZE (64*1024*1024)
+
+// Allocates aligned memory block
+static void* AlignedAlloc(size_t uSize)
+{
+#ifdef _WIN32
+    return _aligned_malloc(uSize, PDEFLATE_BUF_ALIGN);
+#else
+    void* p = NULL;
+    if(posix_memalign(&p, PDEFLATE_BUF_ALIGN, uSize)!=0)
+        return NULL;
+    return p;
+#endif
+}
+
+// Frees memory allocated with AlignedAlloc()
+static void AlignedFree(void* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+// Buffers of a block. The input buffer holds the dictionary (the tail of the
+// previous block) right before the block data.
+struct CParallelDeflate::DeflateSlot
+{
+    DeflateSlot()
+    {
+        m_pInput = NULL;
+        m_uDictSize = 0;
+        m_uInputSize = 0;
+        m_pOutput = NULL;
+        m_uOutputCapacity = 0;
+        m_uOutputSize = 0;
+        m_uCrc32 = 0;
+        m_nResult = PDEFLATE_OK;
+        m_pWorker = NULL;
+    }
+
+    unsigned char* m_pInput;    // Dictionary area followed by block data
+    size_t m_uDictSize;         // Dictionary size (at the end of dictionary area)
+    size_t m_uInputSize;        // Block data size
+    unsigned char* m_pOutput;   // Compressed data
+    size_t m_uOutputCapacity;   // Size of output buffer
+    size_t m_uOutputSize;       // Compressed data size
+    uint32_t m_uCrc32;          // CRC-32 of block data
+    int m_nResult;              // Compression result
+    DeflateWorker* m_pWorker;   // Worker compressing this slot
+    CSyncSemaphore m_Done;      // Signalled when the block is compressed
+};
+
+// Worker thread and its deflate stream
+struct CParallelDeflate::DeflateWorker
+{
+    DeflateWorker()
+    {
+        m_pOwner = NULL;
+        m_bStreamInit = false;
+        m_nStreamLevel = 0;
+        memset(&m_Stream, 0, sizeof(m_Stream));
+        m_apJobs[0] = m_apJobs[1] = NULL;
+        m_nPosted = 0;
+        m_nTaken = 0;
+    }
+
+    CParallelDeflate* m_pOwner; // Owner object
+    CSyncThread m_Thread;       // Worker thread
+    z_stream m_Stream;          // Raw deflate stream
+    bool m_bStreamInit;         // Whether the stream is initialized
+    int m_nStreamLevel;         // Compression level of the stream
+    DeflateSlot* m_apJobs[2];   // Ring of slots to compress, a worker has two slots
+    unsigned m_nPosted;         // Number of slots posted by the caller
+    unsigned m_nTaken;          // Number of slots taken by the worker
+    CSyncSemaphore m_Job;       // Signalled when a slot is posted (or on stop)
+};
+
+CParallelDeflate::CParallelDeflate()
+{
+    m_nLevel = Z_DEFAULT_COMPRESSION;
+    m_uBlockSize = PDEFLATE_DEFAULT_BLOCK_SIZE;
+    m_bStop = false;
+    m_uCrc32 = 0;
+    m_uInputSize = 0;
+    m_uOutputSize = 0;
+}
+
+CParallelDeflate::~CParallelDeflate()
+{
+    Destroy();
+}
+
+int CParallelDeflate::GetProcessorCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+#else
+    long nCount = sysconf(_SC_NPROCESSORS_ONLN);
+    return nCount>0?(int)nCount:1;
+#endif
+}
+
+int CParallelDeflate::Init(int nLevel, int nThreads, size_t uBlockSize)
+{
+    int i;
+
+    Destroy();
+
+    if(nThreads<=0)
+        nThreads = GetProcessorCount();
+    if(nThreads>PDEFLATE_MAX_THREADS)
+        nThreads = PDEFLATE_MAX_THREADS;
+
+    // Blocks must be larger than the dictionary
+    m_uBlockSize = (uBlockSize+0xFFFF)&~(size_t)0xFFFF;
+    if(m_uBlockSize==0)
+        m_uBlockSize = 0x10000;
+    if(m_uBlockSize>PDEFLATE_MAX_BLOCK_SIZE)
+        m_uBlockSize = PDEFLATE_MAX_BLOCK_SIZE;
+    m_nLevel = nLevel;
+    m_bStop = false;
+
+    for(i=0; i<nThreads; i++)
+    {
+        DeflateWorker* pWorker = new DeflateWorker;
+        pWorker->m_pOwner = this;
+        m_aWorkers.push_back(pWorker);
+
+        // Raw deflate (negative window bits), the ZIP entry has no zlib header
+        if(deflateInit2(&pWorker->m_Stream, nLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)!=Z_OK)
+            goto cleanup;
+        pWorker->m_bStreamInit = true;
+        pWorker->m_nStreamLevel = nLevel;
+    }
+
+    // Two slots per worker: while a worker compresses one block, the next
+    // one is being read
+    for(i=0; i<2*nThreads; i++)
+    {
+        DeflateSlot* pSlot = new DeflateSlot;
+        m_aSlots.push_back(pSlot);
+
+        pSlot->m_pWorker = m_aWorkers[i%nThreads];
+        pSlot->m_pInput = (unsigned char*)AlignedAlloc(PDEFLATE_DICT_SIZE+m_uBlockSize);
+        // Sync flush adds an empty stored block to the output
+        pSlot->m_uOutputCapacity = compressBound((uLong)m_uBlockSize)+64;
+        pSlot->m_pOutput = (unsigned char*)malloc(pSlot->m_uOutputCapacity);
+        if(pSlot->m_pInput==NULL || pSlot->m_pOutput==NULL)
+            goto cleanup;
+    }
+
+    for(i=0; i<nThreads; i++)
+    {
+        if(!m_aWorkers[i]->m_Thread.Start(WorkerThread, m_aWorkers[i]))
+            goto cleanup;
+    }
+
+    return PDEFLATE_OK;
+
+cleanup:
+
+    Destroy();
+    return PDEFLATE_ERR_INIT;
+}
+
+void CParallelDeflate::Destroy()
+{
+    size_t i;
+
+    // Wake up the threads and wait for them to exit (joining a thread
+    // that wasn't started does nothing)
+    m_bStop = true;
+    for(i=0; i<m_aWorkers.size(); i++)
+        m_aWorkers[i]->m_Job.Post();
+
+    for(i=0; i<m_aWorkers.size(); i++)
+    {
+        DeflateWorker* pWorker = m_aWorkers[i];
+        pWorker->m_Thread.Join();
+
+        if(pWorker->m_bStreamInit)
+            deflateEnd(&pWorker->m_Stream);
+
+        delete pWorker;
+    }
+    m_aWorkers.clear();
+
+    for(i=0; i<m_aSlots.size(); i++)
+    {
+        if(m_aSlots[i]->m_pInput!=NULL)
+            AlignedFree(m_aSlots[i]->m_pInput);
+        free(m_aSlots[i]->m_pOutput);
+        delete m_aSlots[i];
+    }
+    m_aSlots.clear();
+}
+
+void CParallelDeflate::SetLevel(int nLevel)
+{
+    // Workers pick up the level when they take the next block
+    m_nLevel = nLevel;
+}
+
+void CParallelDeflate::WorkerThread(void* pParam)
+{
+    DeflateWorker* pWorker = (DeflateWorker*)pParam;
+    pWorker->m_pOwner->RunWorker(pWorker);
+}
+
+void CParallelDeflate::RunWorker(DeflateWorker* pWorker)
+{
+    for(;;)
+    {
+        pWorker->m_Job.Wait();
+        if(m_bStop)
+            break;
+
+        DeflateSlot* pSlot = pWorker->m_apJobs[pWorker->m_nTaken%2];
+        pWorker->m_nTaken++;
+
+        pSlot->m_nResult = CompressBlock(pWorker, pSlot);
+        pSlot->m_Done.Post();
+    }
+}
+
+int CParallelDeflate::CompressBlock(DeflateWorker* pWorker, DeflateSlot* pSlot)
+{
+    z_stream* pStream = &pWorker->m_Stream;
+    unsigned char* pData = pSlot->m_pInput+PDEFLATE_DICT_SIZE;
+
+    if(deflateReset(pStream)!=Z_OK)
+        return PDEFLATE_ERR_ZLIB;
+
+    // The stream was just reset and has no pending output, so the level
+    // can be changed without flushing anything
+    if(pWorker->m_nStreamLevel!=m_nLevel)
+    {
+        if(deflateParams(pStream, m_nLevel, Z_DEFAULT_STRATEGY)!=Z_OK)
+            return PDEFLATE_ERR_ZLIB;
+        pWorker->m_nStreamLevel = m_nLevel;
+    }
+
+    // Prime the window with the end of the previous block, so matches may
+    // refer to it as if the stream was compressed by a single thread
+    if(pSlot->m_uDictSize!=0 &&
+        deflateSetDictionary(pStream, pData-pSlot->m_uDictSize, (uInt)pSlot->m_uDictSize)!=Z_OK)
+        return PDEFLATE_ERR_ZLIB;
+
+    pStream->next_in = pData;
+    pStream->avail_in = (uInt)pSlot->m_uInputSize;
+    pStream->next_out = pSlot->m_pOutput;
+    pStream->avail_out = (uInt)pSlot->m_uOutputCapacity;
+
+    // Sync flush ends the block at a byte boundary without marking the last block
+    if(deflate(pStream, Z_SYNC_FLUSH)!=Z_OK || pStream->avail_in!=0 || pStream->avail_out==0)
+        return PDEFLATE_ERR_ZLIB;
+
+    pSlot->m_uOutputSize = pSlot->m_uOutputCapacity-pStream->avail_out;
+    pSlot->m_uCrc32 = (uint32_t)crc32(0, pData, (uInt)pSlot->m_uInputSize);
+
+    return PDEFLATE_OK;
+}
+
+int CParallelDeflate::ReadBlock(DeflateSlot* pSlot, PFNDEFLATEREAD pfnRead, void* pParam)
+{
+    unsigned char* pData = pSlot->m_pInput+PDEFLATE_DICT_SIZE;
+
+    pSlot->m_uInputSize = 0;
+    while(pSlot->m_uInputSize<m_uBlockSize)
+    {
+        size_t uRead = 0;
+        if(!pfnRead(pData+pSlot->m_uInputSize, m_uBlockSize-pSlot->m_uInputSize, &uRead, pParam))
+            return PDEFLATE_ERR_READ;
+        if(uRead==0)
+            break; // End of input
+        pSlot->m_uInputSize += uRead;
+    }
+
+    return PDEFLATE_OK;
+}
+
+int CParallelDeflate::WriteBlock(DeflateSlot* pSlot, PFNDEFLATEWRITE pfnWrite, void* pParam)
+{
+    pSlot->m_Done.Wait();
+
+    if(pfnWrite==NULL)
+        return PDEFLATE_OK;
+
+    if(pSlot->m_nResult!=PDEFLATE_OK)
+        return pSlot->m_nResult;
+
+    if(!pfnWrite(pSlot->m_pOutput, pSlot->m_uOutputSize, pParam))
+        return PDEFLATE_ERR_WRITE;
+
+    m_uCrc32 = (uint32_t)crc32_combine(m_uCrc32, pSlot->m_uCrc32, (z_off_t)pSlot->m_uInputSize);
+    m_uInputSize += pSlot->m_uInputSize;
+    m_uOutputSize += pSlot->m_uOutputSize;
+
+    return PDEFLATE_OK;
+}
+
+int CParallelDeflate::Compress(PFNDEFLATEREAD pfnRead, PFNDEFLATEWRITE pfnWrite, void* pParam)
+{
+    // Empty final block with fixed Huffman codes, ends the stream
+    static const unsigned char s_abLastBlock[2] = {0x03, 0x00};
+    size_t uSlotCount = m_aSlots.size();
+    uint64_t uRead = 0;    // Number of blocks read and passed to workers
+    uint64_t uWritten = 0; // Number of blocks written
+    int nResult = PDEFLATE_OK;
+
+    m_uCrc32 = 0;
+    m_uInputSize = 0;
+    m_uOutputSize = 0;
+
+    if(m_aWorkers.empty())
+        return PDEFLATE_ERR_INIT;
+
+    for(;;)
+    {
+        DeflateSlot* pSlot = m_aSlots[(size_t)(uRead%uSlotCount)];
+
+        // Wait for the slot to be free, blocks are written in order
+        if(uRead-uWritten==uSlotCount)
+        {
+            nResult = WriteBlock(pSlot, pfnWrite, pParam);
+            uWritten++;
+            if(nResult!=PDEFLATE_OK)
+                break;
+        }
+
+        // The dictionary is the tail of the previous block, which is always full
+        pSlot->m_uDictSize = 0;
+        if(uRead!=0)
+        {
+            DeflateSlot* pPrevSlot = m_aSlots[(size_t)((uRead-1)%uSlotCount)];
+            memcpy(pSlot->m_pInput, pPrevSlot->m_pInput+m_uBlockSize, PDEFLATE_DICT_SIZE);
+            pSlot->m_uDictSize = PDEFLATE_DICT_SIZE;
+        }
+
+        nResult = ReadBlock(pSlot, pfnRead, pParam);
+        if(nResult!=PDEFLATE_OK || pSlot->m_uInputSize==0)
+            break;
+
+        // Pass the slot to its worker
+        DeflateWorker* pWorker = pSlot->m_pWorker;
+        pWorker->m_apJobs[pWorker->m_nPosted%2] = pSlot;
+        pWorker->m_nPosted++;
+        pWorker->m_Job.Post();
+        uRead++;
+
+        if(pSlot->m_uInputSize<m_uBlockSize)
+            break; // End of input
+    }
+
+    // Write the rest of blocks, or just wait for them on error
+    while(uWritten<uRead)
+    {
+        DeflateSlot* pSlot = m_aSlots[(size_t)(uWritten%uSlotCount)];
+        int nWriteResult = WriteBlock(pSlot, nResult==PDEFLATE_OK?pfnWrite:NULL, pParam);
+        if(nResult==PDEFLATE_OK)
+            nResult = nWriteResult;
+        uWritten++;
+    }
+
+    if(nResult!=PDEFLATE_OK)
+        return nResult;
+
+    if(!pfnWrite(s_abLastBlock, sizeof(s_abLastBlock), pParam))
+        return PDEFLATE_ERR_WRITE;
+    m_uOutputSize += sizeof(s_abLastBlock);
+
+    return PDEFLATE_OK;
+}
+
+int CParallelDeflate::Store(PFNDEFLATEREAD pfnRead, PFNDEFLATEWRITE pfnWrite, void* pParam)
+{
+    m_uCrc32 = 0;
+    m_uInputSize = 0;
+    m_uOutputSize = 0;
+
+    if(m_aSlots.empty())
+        return PDEFLATE_ERR_INIT;
+
+    // Reading and writing is all there is to do, so a single buffer is enough
+    DeflateSlot* pSlot = m_aSlots[0];
+    unsigned char* pData = pSlot->m_pInput+PDEFLATE_DICT_SIZE;
+
+    for(;;)
+    {
+        int nResult = ReadBlock(pSlot, pfnRead, pParam);
+        if(nResult!=PDEFLATE_OK)
+            return nResult;
+        if(pSlot->m_uInputSize==0)
+            break;
+
+        if(!pfnWrite(pData, pSlot->m_uInputSize, pParam))
+            return PDEFLATE_ERR_WRITE;
+
+        m_uCrc32 = (uint32_t)crc32(m_uCrc32, pData, (uInt)pSlot->m_uInputSize);
+        m_uInputSize += pSlot->m_uInputSize;
+        m_uOutputSize += pSlot->m_uInputSize;
+
+        if(pSlot->m_uInputSize<m_uBlockSize)
+            break; // End of input
+    }
+
+    return PDEFLATE_OK;
+}
+
+uint32_t CParallelDeflate::GetCrc32() const
+{
+    return m_uCrc32;
+}
+
+uint64_t CParallelDeflate::GetInputSize() const
+{
+    return m_uInputSize;
+}
+
+uint64_t CParallelDeflate::GetOutputSize() const
+{
+    return m_uOutputSize;
+}
+
+int CParallelDeflate::GetThreadCount() const
+{
+    return (int)m_aWorkers.size();
+}
@@ -0,0 +1,128 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: ParallelDeflate.h
+// Description: Multi-threaded raw deflate compression. The input is split into blocks
+// that are compressed in parallel, each block is primed with the last 32 KB of the
+// previous one and ends with a sync flush, so the blocks joined in order form a single
+// deflate stream (the same approach as pigz). The output can be stored to a ZIP
+// archive in raw mode.
+
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int32 uint32_t;
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// Default size of a block compressed by a worker thread
+#define PDEFLATE_DEFAULT_BLOCK_SIZE (1024*1024)
+
+// Maximum number of worker threads
+#define PDEFLATE_MAX_THREADS 32
+
+// Error codes returned by CParallelDeflate methods
+enum ParallelDeflateError
+{
+    PDEFLATE_OK = 0,              // Success
+    PDEFLATE_ERR_INIT = 1,        // Not initialized, or couldn't create threads
+    PDEFLATE_ERR_READ = 2,        // The read callback failed (or the operation was cancelled)
+    PDEFLATE_ERR_WRITE = 3,       // The write callback failed
+    PDEFLATE_ERR_ZLIB = 4         // zlib error
+};
+
+// Reads up to uSize bytes of input to pBuf and sets *puRead to the number of bytes read.
+// Zero bytes read means end of input. Returns false on error or to cancel compression.
+typedef bool (*PFNDEFLATEREAD)(void* pBuf, size_t uSize, size_t* puRead, void* pParam);
+
+// Writes the next portion of compressed data. Returns false on error.
+typedef bool (*PFNDEFLATEWRITE)(const void* pData, size_t uSize, void* pParam);
+
+// class CParallelDeflate
+// Compresses data streams with a pool of worker threads. The threads are created
+// by Init() and are reused by all Compress() calls until Destroy(). A single
+// object must not be used by several threads at once.
+class CParallelDeflate
+{
+public:
+
+    CParallelDeflate();
+    ~CParallelDeflate();
+
+    // Creates worker threads and buffers. The compression level is zlib's one (0-9 or
+    // Z_DEFAULT_COMPRESSION). If nThreads is zero or negative, a thread per processor is
+    // created. The block size is rounded up to a multiple of 64 KB.
+    int Init(int nLevel, int nThreads=0, size_t uBlockSize=PDEFLATE_DEFAULT_BLOCK_SIZE);
+
+    // Stops worker threads and frees buffers
+    void Destroy();
+
+    // Changes the compression level used by the next Compress() calls
+    void SetLevel(int nLevel);
+
+    // Compresses the whole input returned by the read callback to a raw deflate stream
+    // written by the write callback. Blocks are read to aligned buffers of the block size.
+    // The write callback is called in the caller's thread, in stream order.
+    int Compress(PFNDEFLATEREAD pfnRead, PFNDEFLATEWRITE pfnWrite, void* pParam);
+
+    // Copies the input to the write callback as is, computing its CRC-32 and size. Used
+    // for data stored without compression; the block buffers are reused for reading.
+    int Store(PFNDEFLATEREAD pfnRead, PFNDEFLATEWRITE pfnWrite, void* pParam);
+
+    // Returns CRC-32 of the input of the last Compress() or Store() call
+    uint32_t GetCrc32() const;
+
+    // Returns the input size of the last Compress() or Store() call
+    uint64_t GetInputSize() const;
+
+    // Returns the output size of the last Compress() or Store() call
+    uint64_t GetOutputSize() const;
+
+    // Returns the number of worker threads
+    int GetThreadCount() const;
+
+    // Returns the number of processors in the system
+    static int GetProcessorCount();
+
+private:
+
+    struct DeflateSlot;
+    struct DeflateWorker;
+
+    // Worker thread procedure
+    static void WorkerThread(void* pParam);
+
+    // Compresses the blocks given to the worker until the pool is destroyed
+    void RunWorker(DeflateWorker* pWorker);
+
+    // Compresses a single block
+    int CompressBlock(DeflateWorker* pWorker, DeflateSlot* pSlot);
+
+    // Reads the next block to the slot. The block is shorter than the block size
+    // only at the end of input.
+    int ReadBlock(DeflateSlot* pSlot, PFNDEFLATEREAD pfnRead, void* pParam);
+
+    // Waits for the slot to be compressed and writes its output. If the write callback
+    // is NULL, only waits (used to drain the pipeline on error).
+    int WriteBlock(DeflateSlot* pSlot, PFNDEFLATEWRITE pfnWrite, void* pParam);
+
+    int m_nLevel;                          // Compression level
+    size_t m_uBlockSize;                   // Size of input block
+    std::vector<DeflateWorker*> m_aWorkers; // Worker threads
+    std::vector<DeflateSlot*> m_aSlots;    // Block buffers, two per worker
+    volatile bool m_bStop;                 // Set to stop worker threads
+    uint32_t m_uCrc32;                     // CRC-32 of the input
+    uint64_t m_uInputSize;                 // Input size in bytes
+    uint64_t m_uOutputSize;                // Output size in bytes
+};
@@ -0,0 +1,155 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "ReportDigest.h"
+#include <vector>
+
+CReportDigest::CReportDigest()
+{
+    Init(false);
+}
+
+void CReportDigest::Init(bool bSHA256)
+{
+    m_bSHA256 = bSHA256;
+    m_md5.MD5Init(&m_md5Ctx);
+    m_sha256.SHA256Init(&m_sha256Ctx);
+    m_uSize = 0;
+    m_sMD5Hash.clear();
+    m_sSHA256Hash.clear();
+}
+
+void CReportDigest::Update(const void* pData, size_t uSize)
+{
+    const unsigned char* pBytes = (const unsigned char*)pData;
+
+    m_uSize += uSize;
+
+    // Hash functions take 32-bit sizes
+    while(uSize!=0)
+    {
+        unsigned int uPortion = uSize>0x40000000 ? 0x40000000 : (unsigned int)uSize;
+
+        m_md5.MD5Update(&m_md5Ctx, (unsigned char*)pBytes, uPortion);
+        if(m_bSHA256)
+            m_sha256.SHA256Update(&m_sha256Ctx, pBytes, uPortion);
+
+        pBytes += uPortion;
+        uSize -= uPortion;
+    }
+}
+
+void CReportDigest::Final()
+{
+    unsigned char md5_hash[16];
+    m_md5.MD5Final(md5_hash, &m_md5Ctx);
+    m_sMD5Hash = FormatHex(md5_hash, 16);
+
+    if(m_bSHA256)
+    {
+        unsigned char sha256_hash[32];
+        m_sha256.SHA256Final(sha256_hash, &m_sha256Ctx);
+        m_sSHA256Hash = FormatHex(sha256_hash, 32);
+    }
+}
+
+bool CReportDigest::HashFile(FILE* f, bool bSHA256)
+{
+    std::vector<unsigned char> aBuffer(REPORT_DIGEST_READ_BUFFER_SIZE);
+
+    Init(bSHA256);
+
+    for(;;)
+    {
+        size_t uRead = fread(&aBuffer[0], 1, aBuffer.size(), f);
+        if(uRead!=0)
+            Update(&aBuffer[0], uRead);
+        if(uRead<aBuffer.size())
+            break;
+    }
+
+    if(ferror(f))
+        return false;
+
+    Final();
+    return true;
+}
+
+const std::string& CReportDigest::GetMD5Hash() const
+{
+    return m_sMD5Hash;
+}
+
+const std::string& CReportDigest::GetSHA256Hash() const
+{
+    return m_sSHA256Hash;
+}
+
+uint64_t CReportDigest::GetSize() const
+{
+    return m_uSize;
+}
+
+bool CReportDigest::IsValidHash(const std::string& sHash, size_t uDigits)
+{
+    if(sHash.length()!=uDigits)
+        return false;
+
+    size_t i;
+    for(i=0; i<sHash.length(); i++)
+    {
+        char c = sHash[i];
+        if(!((c>='0' && c<='9') || (c>='a' && c<='f') || (c>='A' && c<='F')))
+            return false;
+    }
+
+    return true;
+}
+
+bool CReportDigest::ReadHashFile(FILE* f, size_t uDigits, std::string& sHash)
+{
+    char szBuffer[REPORT_DIGEST_SHA256_LEN+2];
+
+    sHash.clear();
+
+    if(uDigits>REPORT_DIGEST_SHA256_LEN)
+        return false;
+
+    size_t uRead = fread(szBuffer, 1, uDigits+1, f);
+    if(uRead<uDigits)
+        return false;
+
+    // The hash may be followed by a line break
+    if(uRead>uDigits && szBuffer[uDigits]!='\r' && szBuffer[uDigits]!='\n')
+        return false;
+
+    std::string sRead(szBuffer, uDigits);
+    if(!IsValidHash(sRead, uDigits))
+        return false;
+
+    sHash = sRead;
+    return true;
+}
+
+std::string CReportDigest::FormatHex(const unsigned char* pBytes, size_t uCount)
+{
+    static const char szDigits[] = "0123456789abcdef";
+    std::string sHex;
+    size_t i;
+
+    sHex.reserve(uCount*2);
+    for(i=0; i<uCount; i++)
+    {
+        sHex += szDigits[pBytes[i]>>4];
+        sHex += szDigits[pBytes[i]&0xf];
+    }
+
+    return sHex;
+}
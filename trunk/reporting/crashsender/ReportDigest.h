@@ -0,0 +1,89 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: ReportDigest.h
+// Description: Digests of an error report archive. The MD5 hash (and optionally the
+// SHA-256 hash) is calculated once, while the archive is written, and stored next to
+// it in the .md5 and .sha256 files; transports read them from there. CrashRptProbe
+// still hashes the whole archive to check it against the hash given by the caller.
+
+#pragma once
+#include <stdio.h>
+#include <stddef.h>
+#include <string>
+#include "md5.h"
+#include "sha256.h"
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// Number of hex digits in digests
+#define REPORT_DIGEST_MD5_LEN 32
+#define REPORT_DIGEST_SHA256_LEN 64
+
+// Read buffer size used when a file is hashed
+#define REPORT_DIGEST_READ_BUFFER_SIZE (1024*1024)
+
+// class CReportDigest
+// Incrementally calculates the MD5 hash and, if requested, the SHA-256 hash of data.
+// The object may be copied to finalize a digest of the data seen so far.
+class CReportDigest
+{
+public:
+
+    CReportDigest();
+
+    // Starts a new digest.
+    void Init(bool bSHA256);
+
+    // Hashes a portion of data.
+    void Update(const void* pData, size_t uSize);
+
+    // Finalizes the digest; GetMD5Hash() and GetSHA256Hash() are valid after this call.
+    void Final();
+
+    // Hashes the rest of the opened file in large blocks and finalizes the digest.
+    // Returns false on read error.
+    bool HashFile(FILE* f, bool bSHA256);
+
+    // Returns the MD5 hash as 32 lowercase hex digits.
+    const std::string& GetMD5Hash() const;
+
+    // Returns the SHA-256 hash as 64 lowercase hex digits, or an empty string
+    // if SHA-256 was not requested.
+    const std::string& GetSHA256Hash() const;
+
+    // Returns the number of bytes hashed.
+    uint64_t GetSize() const;
+
+    // Returns true if the string is a hash of the given number of hex digits.
+    static bool IsValidHash(const std::string& sHash, size_t uDigits);
+
+    // Reads a hash saved to a .md5 or .sha256 file. Returns false if the file
+    // doesn't start with a hash of the given number of hex digits.
+    static bool ReadHashFile(FILE* f, size_t uDigits, std::string& sHash);
+
+private:
+
+    // Formats bytes as lowercase hex digits
+    static std::string FormatHex(const unsigned char* pBytes, size_t uCount);
+
+    bool m_bSHA256;             // Calculate SHA-256 too?
+    MD5 m_md5;                  // MD5 hash
+    MD5_CTX m_md5Ctx;           // MD5 context
+    SHA256 m_sha256;            // SHA-256 hash
+    SHA256_CTX m_sha256Ctx;     // SHA-256 context
+    uint64_t m_uSize;           // Number of bytes hashed
+    std::string m_sMD5Hash;     // Finalized MD5 hash
+    std::string m_sSHA256Hash;  // Finalized SHA-256 hash
+};
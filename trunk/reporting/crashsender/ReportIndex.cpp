@@ -0,0 +1,514 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "ReportIndex.h"
+#include <stdio.h>
+#include <errno.h>
+#include "zlib.h"
+
+// Index file signature ('CRIX') and format version
+#define RINDEX_SIGNATURE 0x58495243
+#define RINDEX_VERSION   1
+
+// The file consists of the header (uint32 signature, uint32 version) and records.
+// A record is uint32 payload size, uint32 CRC-32 of the payload and the payload,
+// which starts with the record type and the report folder name. Strings are
+// uint32 length and UTF-8 bytes. All integers are little-endian.
+#define RINDEX_HEADER_SIZE 8
+#define RINDEX_RECORD_HEADER_SIZE 8
+
+// Largest record accepted on replay
+#define RINDEX_MAX_RECORD_SIZE (16*1024*1024)
+
+// The journal is compacted when it has more than twice as many records as entries
+// plus this many
+#define RINDEX_COMPACT_SLACK 64
+
+// Record types
+enum ReportIndexRecord
+{
+    RINDEX_RECORD_PUT = 1,     // Entry follows
+    RINDEX_RECORD_STATUS = 2,  // uint32 delivery status follows
+    RINDEX_RECORD_REMOVE = 3   // Nothing follows
+};
+
+// Little-endian readers and writers
+static uint32_t GetU32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24);
+}
+
+static void PutU32(uint8_t* p, uint32_t u)
+{
+    p[0] = (uint8_t)(u&0xFF);
+    p[1] = (uint8_t)((u>>8)&0xFF);
+    p[2] = (uint8_t)((u>>16)&0xFF);
+    p[3] = (uint8_t)(u>>24);
+}
+
+static void AppendU32(std::string& s, uint32_t u)
+{
+    uint8_t b[4];
+    PutU32(b, u);
+    s.append((const char*)b, 4);
+}
+
+static void AppendU64(std::string& s, uint64_t u)
+{
+    AppendU32(s, (uint32_t)(u&0xFFFFFFFF));
+    AppendU32(s, (uint32_t)(u>>32));
+}
+
+static void AppendString(std::string& s, const std::string& sValue)
+{
+    AppendU32(s, (uint32_t)sValue.size());
+    s += sValue;
+}
+
+// Reads fields of a record payload. Reading past the end sets the error flag.
+class CRecordReader
+{
+public:
+
+    CRecordReader(const uint8_t* pData, size_t uSize)
+    {
+        m_pData = pData;
+        m_uSize = uSize;
+        m_uPos = 0;
+        m_bError = false;
+    }
+
+    uint32_t ReadU32()
+    {
+        if(m_uSize-m_uPos<4)
+        {
+            m_bError = true;
+            return 0;
+        }
+        uint32_t u = GetU32(m_pData+m_uPos);
+        m_uPos += 4;
+        return u;
+    }
+
+    uint64_t ReadU64()
+    {
+        uint64_t uLow = ReadU32();
+        return uLow|((uint64_t)ReadU32()<<32);
+    }
+
+    std::string ReadString()
+    {
+        uint32_t uLen = ReadU32();
+        if(m_bError || m_uSize-m_uPos<uLen)
+        {
+            m_bError = true;
+            return std::string();
+        }
+        std::string s((const char*)m_pData+m_uPos, uLen);
+        m_uPos += uLen;
+        return s;
+    }
+
+    // Returns true if a field was read past the end of the record
+    bool IsError() const
+    {
+        return m_bError;
+    }
+
+    // Returns true if all fields were read and there is no data left
+    bool IsComplete() const
+    {
+        return !m_bError && m_uPos==m_uSize;
+    }
+
+private:
+
+    const uint8_t* m_pData;
+    size_t m_uSize;
+    size_t m_uPos;
+    bool m_bError;
+};
+
+#ifdef _WIN32
+static std::wstring Utf8ToWide(const std::string& s)
+{
+    int nLen = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, NULL, 0);
+    if(nLen<=0)
+        return std::wstring();
+    std::vector<wchar_t> aBuf(nLen);
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &aBuf[0], nLen);
+    return std::wstring(&aBuf[0]);
+}
+#endif
+
+static FILE* OpenIndexFile(const std::string& sFileName, bool bWrite)
+{
+#ifdef _WIN32
+    return _wfopen(Utf8ToWide(sFileName).c_str(), bWrite?L"ab":L"rb");
+#else
+    return fopen(sFileName.c_str(), bWrite?"ab":"rb");
+#endif
+}
+
+// Frames the payload as a record
+static std::string MakeRecord(const std::string& sPayload)
+{
+    std::string sRecord;
+    AppendU32(sRecord, (uint32_t)sPayload.size());
+    AppendU32(sRecord, (uint32_t)crc32(0, (const Bytef*)sPayload.data(), (uInt)sPayload.size()));
+    sRecord += sPayload;
+    return sRecord;
+}
+
+CReportIndex::CReportIndex()
+{
+    m_uRecordCount = 0;
+    m_bRewrite = false;
+}
+
+int CReportIndex::Open(const char* szFileName)
+{
+    Close();
+
+    CSyncLock lock(m_Lock);
+
+    m_sFileName = szFileName;
+
+    FILE* f = OpenIndexFile(m_sFileName, false);
+    if(f==NULL)
+        return errno==ENOENT?RINDEX_OK:RINDEX_ERR_OPEN_FILE;
+
+    // Reports are few, so the whole journal is read at once
+    std::vector<uint8_t> aData;
+    uint8_t buf[64*1024];
+    size_t uRead;
+    while((uRead = fread(buf, 1, sizeof(buf), f))>0)
+        aData.insert(aData.end(), buf, buf+uRead);
+    fclose(f);
+
+    if(aData.empty())
+        return RINDEX_OK;
+
+    if(aData.size()<RINDEX_HEADER_SIZE ||
+        GetU32(&aData[0])!=RINDEX_SIGNATURE || GetU32(&aData[4])!=RINDEX_VERSION)
+    {
+        // Not our file or a different version; start from scratch
+        m_bRewrite = true;
+        WriteFile();
+        return RINDEX_ERR_INVALID_FILE;
+    }
+
+    size_t uPos = RINDEX_HEADER_SIZE;
+    while(uPos<aData.size())
+    {
+        if(aData.size()-uPos<RINDEX_RECORD_HEADER_SIZE)
+            break;
+
+        uint32_t uSize = GetU32(&aData[uPos]);
+        uint32_t uCrc = GetU32(&aData[uPos+4]);
+        if(uSize==0 || uSize>RINDEX_MAX_RECORD_SIZE ||
+            aData.size()-uPos-RINDEX_RECORD_HEADER_SIZE<uSize)
+            break;
+
+        const uint8_t* pPayload = &aData[uPos+RINDEX_RECORD_HEADER_SIZE];
+        if((uint32_t)crc32(0, pPayload, uSize)!=uCrc || !ApplyRecord(pPayload, uSize))
+            break;
+
+        m_uRecordCount++;
+        uPos += RINDEX_RECORD_HEADER_SIZE+uSize;
+    }
+
+    if(uPos!=aData.size())
+    {
+        // Records after a damaged one can't be reached, so drop the tail now
+        m_bRewrite = true;
+        WriteFile();
+    }
+
+    return RINDEX_OK;
+}
+
+void CReportIndex::Close()
+{
+    CSyncLock lock(m_Lock);
+
+    m_sFileName.clear();
+    m_Entries.clear();
+    m_uRecordCount = 0;
+    m_bRewrite = false;
+}
+
+bool CReportIndex::Find(const std::string& sName, ReportIndexEntry& Entry)
+{
+    CSyncLock lock(m_Lock);
+
+    std::map<std::string, ReportIndexEntry>::iterator it = m_Entries.find(sName);
+    if(it==m_Entries.end())
+        return false;
+
+    Entry = it->second;
+    return true;
+}
+
+int CReportIndex::Put(const std::string& sName, const ReportIndexEntry& Entry)
+{
+    CSyncLock lock(m_Lock);
+
+    m_Entries[sName] = Entry;
+    return Append(MakePutRecord(sName, Entry));
+}
+
+int CReportIndex::SetStatus(const std::string& sName, int nStatus)
+{
+    CSyncLock lock(m_Lock);
+
+    std::map<std::string, ReportIndexEntry>::iterator it = m_Entries.find(sName);
+    if(it==m_Entries.end() || it->second.m_nStatus==nStatus)
+        return RINDEX_OK;
+
+    it->second.m_nStatus = nStatus;
+
+    std::string sPayload;
+    sPayload += (char)RINDEX_RECORD_STATUS;
+    AppendString(sPayload, sName);
+    AppendU32(sPayload, (uint32_t)nStatus);
+    return Append(MakeRecord(sPayload));
+}
+
+int CReportIndex::Remove(const std::string& sName)
+{
+    CSyncLock lock(m_Lock);
+
+    if(m_Entries.erase(sName)==0)
+        return RINDEX_OK;
+
+    std::string sPayload;
+    sPayload += (char)RINDEX_RECORD_REMOVE;
+    AppendString(sPayload, sName);
+    return Append(MakeRecord(sPayload));
+}
+
+int CReportIndex::Retain(const std::vector<std::string>& aNames)
+{
+    CSyncLock lock(m_Lock);
+
+    std::map<std::string, ReportIndexEntry> Entries;
+    size_t i;
+    for(i=0; i<aNames.size(); i++)
+    {
+        std::map<std::string, ReportIndexEntry>::iterator it = m_Entries.find(aNames[i]);
+        if(it!=m_Entries.end())
+            Entries.insert(*it);
+    }
+
+    if(Entries.size()!=m_Entries.size())
+    {
+        m_Entries.swap(Entries);
+        m_bRewrite = true;
+    }
+
+    if(m_uRecordCount>2*m_Entries.size()+RINDEX_COMPACT_SLACK)
+        m_bRewrite = true;
+
+    return m_bRewrite?WriteFile():RINDEX_OK;
+}
+
+int CReportIndex::Compact()
+{
+    CSyncLock lock(m_Lock);
+
+    return WriteFile();
+}
+
+size_t CReportIndex::GetEntryCount()
+{
+    CSyncLock lock(m_Lock);
+
+    return m_Entries.size();
+}
+
+size_t CReportIndex::GetRecordCount()
+{
+    CSyncLock lock(m_Lock);
+
+    return m_uRecordCount;
+}
+
+int CReportIndex::Append(const std::string& sRecord)
+{
+    if(m_sFileName.empty())
+        return RINDEX_OK; // Not opened; the index is kept in memory only
+
+    if(m_bRewrite)
+        return WriteFile();
+
+    FILE* f = OpenIndexFile(m_sFileName, true);
+    if(f==NULL)
+        return RINDEX_ERR_WRITE_FILE;
+
+    // A new file starts with the header
+    std::string sData;
+    fseek(f, 0, SEEK_END);
+    if(ftell(f)==0)
+    {
+        AppendU32(sData, RINDEX_SIGNATURE);
+        AppendU32(sData, RINDEX_VERSION);
+    }
+    sData += sRecord;
+
+    // The record is written by a single call, so a concurrent writer doesn't split it
+    bool bWritten = fwrite(sData.data(), 1, sData.size(), f)==sData.size();
+    bWritten = fclose(f)==0 && bWritten;
+    if(!bWritten)
+    {
+        // A partially written record must not be followed by others
+        m_bRewrite = true;
+        return RINDEX_ERR_WRITE_FILE;
+    }
+
+    m_uRecordCount++;
+    return RINDEX_OK;
+}
+
+int CReportIndex::WriteFile()
+{
+    if(m_sFileName.empty())
+        return RINDEX_OK;
+
+    std::string sData;
+    AppendU32(sData, RINDEX_SIGNATURE);
+    AppendU32(sData, RINDEX_VERSION);
+
+    std::map<std::string, ReportIndexEntry>::iterator it;
+    for(it=m_Entries.begin(); it!=m_Entries.end(); it++)
+        sData += MakePutRecord(it->first, it->second);
+
+    // Write to a temporary file and replace the index with it, so readers
+    // never see a partially written file
+    std::string sTmpFileName = m_sFileName+".tmp";
+    bool bWritten = false;
+#ifdef _WIN32
+    FILE* f = _wfopen(Utf8ToWide(sTmpFileName).c_str(), L"wb");
+#else
+    FILE* f = fopen(sTmpFileName.c_str(), "wb");
+#endif
+    if(f!=NULL)
+    {
+        bWritten = fwrite(sData.data(), 1, sData.size(), f)==sData.size();
+        bWritten = fclose(f)==0 && bWritten;
+    }
+
+    if(!bWritten)
+        return RINDEX_ERR_WRITE_FILE;
+
+#ifdef _WIN32
+    BOOL bMoved = MoveFileExW(Utf8ToWide(sTmpFileName).c_str(), Utf8ToWide(m_sFileName).c_str(),
+        MOVEFILE_REPLACE_EXISTING);
+#else
+    bool bMoved = rename(sTmpFileName.c_str(), m_sFileName.c_str())==0;
+#endif
+    if(!bMoved)
+        return RINDEX_ERR_WRITE_FILE;
+
+    m_uRecordCount = m_Entries.size();
+    m_bRewrite = false;
+    return RINDEX_OK;
+}
+
+bool CReportIndex::ApplyRecord(const uint8_t* pData, size_t uSize)
+{
+    CRecordReader reader(pData+1, uSize-1);
+    std::string sName = reader.ReadString();
+
+    switch(pData[0])
+    {
+    case RINDEX_RECORD_PUT:
+        {
+            ReportIndexEntry Entry;
+            Entry.m_uDirTime = reader.ReadU64();
+            Entry.m_sCrashGUID = reader.ReadString();
+            Entry.m_sAppName = reader.ReadString();
+            Entry.m_sAppVersion = reader.ReadString();
+            Entry.m_sImageName = reader.ReadString();
+            Entry.m_sSystemTimeUTC = reader.ReadString();
+            Entry.m_uTotalSize = reader.ReadU64();
+            Entry.m_nStatus = (int)reader.ReadU32();
+
+            uint32_t uFileCount = reader.ReadU32();
+            uint32_t i;
+            for(i=0; i<uFileCount && !reader.IsError(); i++)
+            {
+                ReportIndexFile File;
+                File.m_sName = reader.ReadString();
+                File.m_sDesc = reader.ReadString();
+                File.m_bOptional = reader.ReadU32()!=0;
+                File.m_nSnapshotSize = (int64_t)reader.ReadU64();
+                Entry.m_aFiles.push_back(File);
+            }
+
+            if(!reader.IsComplete())
+                return false;
+
+            m_Entries[sName] = Entry;
+        }
+        break;
+
+    case RINDEX_RECORD_STATUS:
+        {
+            int nStatus = (int)reader.ReadU32();
+            if(!reader.IsComplete())
+                return false;
+
+            std::map<std::string, ReportIndexEntry>::iterator it = m_Entries.find(sName);
+            if(it!=m_Entries.end())
+                it->second.m_nStatus = nStatus;
+        }
+        break;
+
+    case RINDEX_RECORD_REMOVE:
+        if(!reader.IsComplete())
+            return false;
+        m_Entries.erase(sName);
+        break;
+
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+std::string CReportIndex::MakePutRecord(const std::string& sName, const ReportIndexEntry& Entry)
+{
+    std::string sPayload;
+    sPayload += (char)RINDEX_RECORD_PUT;
+    AppendString(sPayload, sName);
+    AppendU64(sPayload, Entry.m_uDirTime);
+    AppendString(sPayload, Entry.m_sCrashGUID);
+    AppendString(sPayload, Entry.m_sAppName);
+    AppendString(sPayload, Entry.m_sAppVersion);
+    AppendString(sPayload, Entry.m_sImageName);
+    AppendString(sPayload, Entry.m_sSystemTimeUTC);
+    AppendU64(sPayload, Entry.m_uTotalSize);
+    AppendU32(sPayload, (uint32_t)Entry.m_nStatus);
+
+    AppendU32(sPayload, (uint32_t)Entry.m_aFiles.size());
+    size_t i;
+    for(i=0; i<Entry.m_aFiles.size(); i++)
+    {
+        const ReportIndexFile& File = Entry.m_aFiles[i];
+        AppendString(sPayload, File.m_sName);
+        AppendString(sPayload, File.m_sDesc);
+        AppendU32(sPayload, File.m_bOptional?1:0);
+        AppendU64(sPayload, (uint64_t)File.m_nSnapshotSize);
+    }
+
+    return MakeRecord(sPayload);
+}
@@ -0,0 +1,143 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: ReportIndex.h
+// Description: Index of error reports queued in the UnsentCrashReports folder. Keeps the
+// crash description fields, file list, total size and delivery state of each report, so
+// the queue can be listed without parsing crashrpt.xml and opening every file of every
+// report. Changes are appended to a journal file, which is rewritten when it grows much
+// larger than the index itself.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include "ThreadSync.h"
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int8  uint8_t;
+typedef unsigned __int32 uint32_t;
+typedef __int64 int64_t;
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// Error codes returned by CReportIndex methods
+enum ReportIndexError
+{
+    RINDEX_OK = 0,               // Success
+    RINDEX_ERR_OPEN_FILE = 1,    // Couldn't open the file
+    RINDEX_ERR_INVALID_FILE = 2, // Not an index file
+    RINDEX_ERR_WRITE_FILE = 3    // Couldn't write the file
+};
+
+// A file included into the report
+struct ReportIndexFile
+{
+    ReportIndexFile()
+    {
+        m_bOptional = false;
+        m_nSnapshotSize = -1;
+    }
+
+    std::string m_sName;       // File name in the report folder (UTF-8)
+    std::string m_sDesc;       // File description (UTF-8)
+    bool m_bOptional;          // Can the user remove the file from the report?
+    int64_t m_nSnapshotSize;   // Size of the data included into the report, -1 for the whole file
+};
+
+// Indexed report
+struct ReportIndexEntry
+{
+    ReportIndexEntry()
+    {
+        m_uDirTime = 0;
+        m_uTotalSize = 0;
+        m_nStatus = 0;
+    }
+
+    uint64_t m_uDirTime;          // Last write time of the report folder when the entry was made
+    std::string m_sCrashGUID;     // Crash description fields (UTF-8)
+    std::string m_sAppName;
+    std::string m_sAppVersion;
+    std::string m_sImageName;
+    std::string m_sSystemTimeUTC;
+    uint64_t m_uTotalSize;        // Uncompressed size of the report files
+    int m_nStatus;                // Result of the last delivery attempt (DELIVERY_STATUS)
+    std::vector<ReportIndexFile> m_aFiles; // Files of the report
+};
+
+// class CReportIndex
+// Journaled index of queued reports keyed by report folder name. Entries are validated
+// by the caller against the folder's last write time; the index is only a cache, and
+// an entry that was lost or is out of date means the report is parsed again. Methods
+// may be called from different threads. Several processes may append to the same file;
+// a compaction by one process may drop records appended by another at the same moment.
+class CReportIndex
+{
+public:
+
+    CReportIndex();
+
+    // Opens the index file (UTF-8 file name) and replays the journal. A missing file is
+    // not an error, the index is empty then. An invalid file gives an empty index and is
+    // rewritten on the next change. Replay stops at a torn or damaged record (for example,
+    // the process was terminated while appending); the file is rewritten then.
+    int Open(const char* szFileName);
+
+    // Closes the index
+    void Close();
+
+    // Looks up the entry of the report folder. Returns false if there is none.
+    bool Find(const std::string& sName, ReportIndexEntry& Entry);
+
+    // Adds or replaces the entry of the report folder
+    int Put(const std::string& sName, const ReportIndexEntry& Entry);
+
+    // Records the result of a delivery attempt. Does nothing if there is no such entry.
+    int SetStatus(const std::string& sName, int nStatus);
+
+    // Removes the entry of a report folder that was delivered or deleted
+    int Remove(const std::string& sName);
+
+    // Removes the entries of folders not in the list (folders that were removed while
+    // the index wasn't updated), then rewrites the journal if it needs compaction.
+    int Retain(const std::vector<std::string>& aNames);
+
+    // Rewrites the journal with a single record per entry
+    int Compact();
+
+    // Returns the number of entries
+    size_t GetEntryCount();
+
+    // Returns the number of records in the journal
+    size_t GetRecordCount();
+
+private:
+
+    // Appends the record to the journal, or rewrites the journal if it can't be appended to
+    int Append(const std::string& sRecord);
+
+    // Rewrites the journal. The lock must be held.
+    int WriteFile();
+
+    // Applies a record. Returns false if the record is malformed.
+    bool ApplyRecord(const uint8_t* pData, size_t uSize);
+
+    // Makes a PUT record
+    static std::string MakePutRecord(const std::string& sName, const ReportIndexEntry& Entry);
+
+    std::string m_sFileName;      // Index file name (UTF-8)
+    std::map<std::string, ReportIndexEntry> m_Entries; // Entries by report folder name
+    size_t m_uRecordCount;        // Records in the journal
+    bool m_bRewrite;              // Should the journal be rewritten instead of appended to?
+    CSyncMutex m_Lock;            // Protects the members above
+};
@@ -22,6 +22,7 @@ CScreenCapture::CScreenCapture()
     m_png_ptr = NULL;
     m_info_ptr = NULL;
     m_nIdStartFrom = 0;
+    m_pFrameBuffer = NULL;
 }
 
 CScreenCapture::~CScreenCapture()
@@ -37,7 +38,8 @@ BOOL CScreenCapture::TakeDesktopScreenshot(
       SCREENSHOT_IMAGE_FORMAT fmt, 
       int nJpegQuality,
       BOOL bGrayscale,
-      int nIdStartFrom)
+      int nIdStartFrom,
+      CFrameRingBuffer* pFrameBuffer)
 {   
   // This method takes the desktop screenshot (screenshot of entire virtual screen
   // or screenshot of the main window, or screenshot of all process windows). 
@@ -91,6 +93,7 @@ BOOL CScreenCapture::TakeDesktopScreenshot(
     fmt, 
     nJpegQuality, 
     bGrayscale, 
+        pFrameBuffer,
         ssi.m_aMonitors);
     if(bTakeScreenshot==FALSE)
     {
@@ -108,10 +111,14 @@ BOOL CScreenCapture::CaptureScreenRect(
                                        SCREENSHOT_IMAGE_FORMAT fmt,
                                        int nJpegQuality,
                                        BOOL bGrayscale,
+                                       CFrameRingBuffer* pFrameBuffer,
                                        std::vector<MonitorInfo>& monitor_list)
 {	
     // Init output variables
     monitor_list.clear();
+
+    if(fmt==SCREENSHOT_FORMAT_RAW && pFrameBuffer==NULL)
+        return FALSE;
     
     // Set internal variables
     m_nIdStartFrom = nIdStartFrom;
@@ -119,6 +126,7 @@ BOOL CScreenCapture::CaptureScreenRect(
     m_fmt = fmt;
     m_nJpegQuality = nJpegQuality;
     m_bGrayscale = bGrayscale;
+    m_pFrameBuffer = pFrameBuffer;
     m_arcCapture = arcCapture;
     m_monitor_list.clear();
 
@@ -230,11 +238,19 @@ BOOL CALLBACK CScreenCapture::EnumMonitorsProc(HMONITOR hMonitor, HDC /*hdcMonit
         if(!bInit)
             goto cleanup;		
     }
+    else if(psc->m_fmt==SCREENSHOT_FORMAT_RAW)
+    {
+        // Add an image to the current frame
+        BOOL bInit = psc->m_pFrameBuffer->BeginImage(nWidth, nHeight);
+        if(!bInit)
+            goto cleanup;
+    }
 
     // We will get bitmap bits row by row
     nRowWidth = nWidth*3;
   nRowWidth+=nRowWidth%4;
-    pRowBits = new BYTE[nRowWidth];
+    // GetDIBits pads rows to a DWORD boundary
+    pRowBits = new BYTE[(nWidth*3+3)&~3];
     if(pRowBits==NULL)
         goto cleanup;
 
@@ -275,6 +291,12 @@ BOOL CALLBACK CScreenCapture::EnumMonitorsProc(HMONITOR hMonitor, HDC /*hdcMonit
             if(!bWrite)
                 goto cleanup;  
         }      
+        else if(psc->m_fmt==SCREENSHOT_FORMAT_RAW)
+        {
+            BOOL bWrite = psc->m_pFrameBuffer->AddImageRow(pRowBits);
+            if(!bWrite)
+                goto cleanup;
+        }
 
     if(psc->m_fmt==SCREENSHOT_FORMAT_BMP)
     {
@@ -302,6 +324,12 @@ BOOL CALLBACK CScreenCapture::EnumMonitorsProc(HMONITOR hMonitor, HDC /*hdcMonit
     {
     psc->BmpFinalize();
     }
+    else if(psc->m_fmt==SCREENSHOT_FORMAT_RAW)
+    {
+        BOOL bFinalize = psc->m_pFrameBuffer->EndImage();
+        if(!bFinalize)
+            goto cleanup;
+    }
     else
     {
         ATLASSERT(0); // Invalid format
@@ -15,6 +15,7 @@ extern "C" {
 #include "png.h"
 }
 #include "jpeglib.h"
+#include "FrameRingBuffer.h"
 
 // Window information
 struct WindowInfo
@@ -30,7 +31,7 @@ struct MonitorInfo
 {
     WTL::CString m_sDeviceID; // Device ID
     WTL::CRect m_rcMonitor;   // Monitor rectangle in screen coordinates
-    WTL::CString m_sFileName; // Image file name corresponding to this monitor
+    WTL::CString m_sFileName; // Image file name corresponding to this monitor (empty for SCREENSHOT_FORMAT_RAW)
 };
 
 // Desktop screen shot info
@@ -62,7 +63,8 @@ enum SCREENSHOT_IMAGE_FORMAT
 {
     SCREENSHOT_FORMAT_PNG = 0, // Use PNG format
     SCREENSHOT_FORMAT_JPG = 1, // Use JPG format
-    SCREENSHOT_FORMAT_BMP = 2  // Use BMP format
+    SCREENSHOT_FORMAT_BMP = 2, // Use BMP format
+    SCREENSHOT_FORMAT_RAW = 3  // Add 24-bit pixels to a frame ring buffer, no files are written
 };
 
 // Desktop screenshot capture
@@ -74,6 +76,7 @@ public:
     ~CScreenCapture();
   
     // Takes desktop screenshot and returns information about it.
+    // For SCREENSHOT_FORMAT_RAW, an image per monitor is added to the newest frame of pFrameBuffer.
     BOOL TakeDesktopScreenshot(
       LPCTSTR szSaveToDir,
       ScreenshotInfo& ssi, 
@@ -82,7 +85,8 @@ public:
       SCREENSHOT_IMAGE_FORMAT fmt=SCREENSHOT_FORMAT_PNG,
       int nJpegQuality = 95,
       BOOL bGrayscale=FALSE,
-      int nIdStartFrom=0);
+      int nIdStartFrom=0,
+      CFrameRingBuffer* pFrameBuffer=NULL);
 
 private:
 
@@ -102,6 +106,7 @@ private:
         SCREENSHOT_IMAGE_FORMAT fmt, 
         int nJpegQuality,
         BOOL bGrayscale,
+        CFrameRingBuffer* pFrameBuffer,
         std::vector<MonitorInfo>& monitor_list);
 
     // Monitor enumeration callback.
@@ -162,6 +167,7 @@ private:
     SCREENSHOT_IMAGE_FORMAT m_fmt;        // Image format
     int m_nJpegQuality;                   // Jpeg quality
     BOOL m_bGrayscale;                    // Create grayscale image or not
+    CFrameRingBuffer* m_pFrameBuffer;     // Frame buffer for SCREENSHOT_FORMAT_RAW
     FILE* m_fp;                           // Handle to the file
     png_structp m_png_ptr;                // libpng stuff
     png_infop m_info_ptr;                 // libpng stuff
@@ -0,0 +1,278 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: ThreadSync.h
+// Description: Minimal portable threads, semaphores and mutexes (Win32 API or pthreads)
+// used by the platform-independent parts of CrashSender and by crprober.
+
+#pragma once
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#endif
+
+// Thread procedure
+typedef void (*PFNSYNCTHREADPROC)(void* pParam);
+
+// class CSyncSemaphore
+// Counting semaphore.
+class CSyncSemaphore
+{
+public:
+
+    CSyncSemaphore(int nInitialCount=0)
+    {
+#ifdef _WIN32
+        m_hSem = CreateSemaphore(NULL, nInitialCount, 0x7fffffff, NULL);
+#else
+        sem_init(&m_Sem, 0, (unsigned)nInitialCount);
+#endif
+    }
+
+    ~CSyncSemaphore()
+    {
+#ifdef _WIN32
+        if(m_hSem!=NULL)
+            CloseHandle(m_hSem);
+#else
+        sem_destroy(&m_Sem);
+#endif
+    }
+
+    // Increments the count, waking up a waiting thread
+    void Post()
+    {
+#ifdef _WIN32
+        ReleaseSemaphore(m_hSem, 1, NULL);
+#else
+        sem_post(&m_Sem);
+#endif
+    }
+
+    // Waits until the count is positive and decrements it
+    void Wait()
+    {
+#ifdef _WIN32
+        WaitForSingleObject(m_hSem, INFINITE);
+#else
+        while(sem_wait(&m_Sem)!=0 && errno==EINTR);
+#endif
+    }
+
+    // Waits up to the given time for the count to be positive and decrements it.
+    // Returns false on timeout.
+    bool TimedWait(unsigned uMilliseconds)
+    {
+#ifdef _WIN32
+        return WaitForSingleObject(m_hSem, uMilliseconds)==WAIT_OBJECT_0;
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += uMilliseconds/1000;
+        ts.tv_nsec += (long)(uMilliseconds%1000)*1000000;
+        if(ts.tv_nsec>=1000000000)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        int nResult;
+        while((nResult = sem_timedwait(&m_Sem, &ts))!=0 && errno==EINTR);
+        return nResult==0;
+#endif
+    }
+
+private:
+
+    CSyncSemaphore(const CSyncSemaphore&);
+    CSyncSemaphore& operator=(const CSyncSemaphore&);
+
+#ifdef _WIN32
+    HANDLE m_hSem;
+#else
+    sem_t m_Sem;
+#endif
+};
+
+// class CSyncMutex
+// Non-recursive mutex.
+class CSyncMutex
+{
+public:
+
+    CSyncMutex()
+    {
+#ifdef _WIN32
+        InitializeCriticalSection(&m_cs);
+#else
+        pthread_mutex_init(&m_Mutex, NULL);
+#endif
+    }
+
+    ~CSyncMutex()
+    {
+#ifdef _WIN32
+        DeleteCriticalSection(&m_cs);
+#else
+        pthread_mutex_destroy(&m_Mutex);
+#endif
+    }
+
+    void Lock()
+    {
+#ifdef _WIN32
+        EnterCriticalSection(&m_cs);
+#else
+        pthread_mutex_lock(&m_Mutex);
+#endif
+    }
+
+    void Unlock()
+    {
+#ifdef _WIN32
+        LeaveCriticalSection(&m_cs);
+#else
+        pthread_mutex_unlock(&m_Mutex);
+#endif
+    }
+
+private:
+
+    CSyncMutex(const CSyncMutex&);
+    CSyncMutex& operator=(const CSyncMutex&);
+
+#ifdef _WIN32
+    CRITICAL_SECTION m_cs;
+#else
+    pthread_mutex_t m_Mutex;
+#endif
+};
+
+// class CSyncLock
+// Locks the mutex for the lifetime of the object.
+class CSyncLock
+{
+public:
+
+    CSyncLock(CSyncMutex& Mutex)
+        : m_Mutex(Mutex)
+    {
+        m_Mutex.Lock();
+    }
+
+    ~CSyncLock()
+    {
+        m_Mutex.Unlock();
+    }
+
+private:
+
+    CSyncLock(const CSyncLock&);
+    CSyncLock& operator=(const CSyncLock&);
+
+    CSyncMutex& m_Mutex;
+};
+
+// class CSyncThread
+// Joinable thread. The thread must be joined before the object is destroyed.
+class CSyncThread
+{
+public:
+
+    CSyncThread()
+    {
+        m_pfnProc = NULL;
+        m_pParam = NULL;
+        m_bStarted = false;
+#ifdef _WIN32
+        m_hThread = NULL;
+#endif
+    }
+
+    ~CSyncThread()
+    {
+        Join();
+    }
+
+    // Starts the thread
+    bool Start(PFNSYNCTHREADPROC pfnProc, void* pParam)
+    {
+        if(m_bStarted)
+            return false;
+
+        m_pfnProc = pfnProc;
+        m_pParam = pParam;
+#ifdef _WIN32
+        m_hThread = CreateThread(NULL, 0, ThreadProc, this, 0, NULL);
+        m_bStarted = m_hThread!=NULL;
+#else
+        m_bStarted = pthread_create(&m_Thread, NULL, ThreadProc, this)==0;
+#endif
+        return m_bStarted;
+    }
+
+    // Waits for the thread to exit
+    void Join()
+    {
+        if(!m_bStarted)
+            return;
+#ifdef _WIN32
+        WaitForSingleObject(m_hThread, INFINITE);
+        CloseHandle(m_hThread);
+        m_hThread = NULL;
+#else
+        pthread_join(m_Thread, NULL);
+#endif
+        m_bStarted = false;
+    }
+
+    // Suspends the calling thread
+    static void Sleep(unsigned uMilliseconds)
+    {
+#ifdef _WIN32
+        ::Sleep(uMilliseconds);
+#else
+        usleep(uMilliseconds*1000);
+#endif
+    }
+
+private:
+
+    CSyncThread(const CSyncThread&);
+    CSyncThread& operator=(const CSyncThread&);
+
+#ifdef _WIN32
+    static DWORD WINAPI ThreadProc(LPVOID pParam)
+#else
+    static void* ThreadProc(void* pParam)
+#endif
+    {
+        CSyncThread* pThis = (CSyncThread*)pParam;
+        pThis->m_pfnProc(pThis->m_pParam);
+        return 0;
+    }
+
+    PFNSYNCTHREADPROC m_pfnProc; // Thread procedure
+    void* m_pParam;              // Thread procedure parameter
+    bool m_bStarted;             // Whether the thread is running (not joined yet)
+#ifdef _WIN32
+    HANDLE m_hThread;
+#else
+    pthread_t m_Thread;
+#endif
+};
@@ -16,8 +16,17 @@ be found in the Authors.txt file in the root of the source tree.
 #include "stdafx.h"
 #include "VideoRec.h"
 #include "Utility.h"
+#include "YuvConvert.h"
+#include "ParallelDeflate.h"
+#include "vpx/vp8cx.h"
 #include "math.h"
 
+// Max size of recorded frame data kept in memory
+static const size_t VIDEO_MAX_FRAME_BUFFER_SIZE = 256*1024*1024;
+
+// Frames between two frames stored whole, the others store changed tiles only
+static const int VIDEO_KEY_FRAME_INTERVAL = 20;
+
 static int ilog(unsigned _v){
   int ret;
   for(ret=0;_v;ret++)_v>>=1;
@@ -35,14 +44,17 @@ CVideoRecorder::CVideoRecorder()
   m_nVideoFrameInterval = 300;
   m_dwProcessId = 0;
   m_nFrameCount = 0;
-  m_nFileId = 0;
-  m_nFrameId = 0;
   m_nVideoQuality = 5;
   m_DesiredFrameSize.cx = 0;
   m_DesiredFrameSize.cy = 0;
-  m_hbmpFrame = NULL;
-  m_pFrameBits = NULL;
-  m_pDIB = NULL;
+  m_bEncodeVP8 = FALSE;
+  m_nFrameWidth = 0;
+  m_nFrameHeight = 0;
+  m_nEncodedFrameCount = 0;
+  m_pOutFile = NULL;
+  m_pTheoraEnc = NULL;
+  m_bOggStreamInit = FALSE;
+  m_bVP8CodecInit = FALSE;
   m_bInitialized = FALSE;
 }
 
@@ -57,7 +69,9 @@ BOOL CVideoRecorder::Init(LPCTSTR szSaveToDir,
   int nVideoDuration,
   int nVideoFrameInterval,
   int nVideoQuality,
-  SIZE* pDesiredFrameSize)
+  SIZE* pDesiredFrameSize,
+  BOOL bCompressFrames,
+  BOOL bEncodeVP8)
 {
   // Validate input params
   if(nVideoDuration<=0 || nVideoFrameInterval<=0)
@@ -73,6 +87,7 @@ BOOL CVideoRecorder::Init(LPCTSTR szSaveToDir,
   m_nVideoFrameInterval = nVideoFrameInterval;
   m_nVideoQuality = nVideoQuality;
   m_dwProcessId = dwProcessId;
+  m_bEncodeVP8 = bEncodeVP8;
 
   // Save desired frame size
   if(pDesiredFrameSize)
@@ -85,17 +100,28 @@ BOOL CVideoRecorder::Init(LPCTSTR szSaveToDir,
 
   // Calculate max frame count
   m_nFrameCount = m_nVideoDuration/m_nVideoFrameInterval;
-  m_nFileId = 0;
-  m_nFrameId = 0;
-
-  // Create folder where to save video frames
-  WTL::CString sDirName = m_sSaveToDir + _T("\\~temp_video");
-  if(!Utility::CreateFolder(sDirName))
+  if(m_nFrameCount<1)
+    m_nFrameCount = 1;
+
+  // When the buffer is full, the oldest key frame is dropped with its deltas,
+  // so keep key frames close enough to lose only a small part of the video
+  int nKeyFrameInterval = VIDEO_KEY_FRAME_INTERVAL;
+  if(nKeyFrameInterval>m_nFrameCount/4)
+    nKeyFrameInterval = m_nFrameCount/4;
+  if(nKeyFrameInterval<1)
+    nKeyFrameInterval = 1;
+
+  // Allocate the ring buffer for video frames
+  if(!m_FrameBuffer.Init(m_nFrameCount, VIDEO_MAX_FRAME_BUFFER_SIZE, 
+    bCompressFrames!=FALSE, nKeyFrameInterval))
   {
-    // Error creating temp folder
+    // Error allocating frame buffer
     return FALSE;
   }
 
+  m_aVideoFrames.clear();
+  m_aVideoFrames.resize(m_nFrameCount);
+
   // Done
   m_bInitialized = TRUE;
   return TRUE;
@@ -108,12 +134,11 @@ BOOL CVideoRecorder::IsInitialized()
 
 void CVideoRecorder::Destroy()
 {
-  // Remove temp files
-  if(!m_sSaveToDir.IsEmpty())
-  {
-    WTL::CString sDirName = m_sSaveToDir + _T("\\~temp_video");
-    Utility::RecycleFile(sDirName, TRUE);
-  }
+  // Free recorded frames
+  m_FrameBuffer.Destroy();
+  m_aVideoFrames.clear();
+  std::vector< std::vector<unsigned char> >().swap(m_aMonitorPixels);
+  std::vector<EncodeSlot>().swap(m_aEncodeSlots);
 
   m_bInitialized=FALSE;
 }
@@ -124,94 +149,57 @@ BOOL CVideoRecorder::RecordVideoFrame()
 
   ScreenshotInfo ssi; // Screenshot params    
 
-  WTL::CString sDirName = m_sSaveToDir + _T("\\~temp_video");
+  // Start a new frame, the oldest one is overwritten when the buffer is full
+  int nSlot = m_FrameBuffer.AddFrame();
+  if(nSlot<0)
+    return FALSE;
 
-  // Take the screen shot and save it as raw BMP file.
+  // Take the screen shot and add its pixels to the frame buffer.
   BOOL bTakeScreenshot = m_sc.TakeDesktopScreenshot(
-    sDirName, 
+    m_sSaveToDir, 
     ssi, m_ScreenshotType, m_dwProcessId, 
-    SCREENSHOT_FORMAT_BMP, 0, FALSE, m_nFileId);
+    SCREENSHOT_FORMAT_RAW, 0, FALSE, 0, &m_FrameBuffer);
   if(bTakeScreenshot==FALSE)
   {
     // Failed to take screenshot
+    m_FrameBuffer.CancelFrame();
     return FALSE;
   }
 
   // Save video frame info
-  SetVideoFrameInfo(m_nFrameId, ssi);
-
-  // Increment file ID
-  m_nFileId += (int)ssi.m_aMonitors.size();
-
-  // Increment frame number
-  m_nFrameId++;
-
-  // Reuse files cyclically
-  if(m_nFrameId>=m_nFrameCount)
-  {
-    m_nFileId = 0;
-    m_nFrameId = 0;					
-  }
+  m_aVideoFrames[nSlot] = ssi;
 
   return TRUE;
 }
 
-void CVideoRecorder::SetVideoFrameInfo(int nFrameId, ScreenshotInfo& ssi)
-{
-  if((int)m_aVideoFrames.size()<=nFrameId)
-  {
-    // Add frame to the end of sequence
-    m_aVideoFrames.push_back(ssi);
-  }
-  else
-  {
-    // Replace existing frame
-
-    /*size_t j;
-    for(j=0; j<m_aVideoFrames[nFrameId].m_aMonitors.size(); j++)
-    {
-    Utility::RecycleFile(m_aVideoFrames[nFrameId].m_aMonitors[j].m_sFileName, TRUE);
-    }*/
-
-    m_aVideoFrames[nFrameId]=ssi;
-  }
-}
-
 BOOL CVideoRecorder::EncodeVideo()
 {	
-  // This method encodes all raw BMP files
-  // into a single OGG file.
-
-  FILE* fout = NULL;
-  ogg_stream_state to; /* take physical pages, weld into a logical
-             stream of packets */
-  ogg_page         og; /* one Ogg bitstream page.  Vorbis packets are inside */
-  ogg_packet       op; /* one raw packet of data for decode */
-
-  th_enc_ctx      *td = NULL;
-  th_info          ti;
-  th_comment       tc;
-  int frame_avail = 0;
-  th_ycbcr_buffer raw;	
-  int frame_cnt = 0;
+  // This method encodes all frames stored in the frame buffer
+  // into a single OGG or WebM file. Frames are restored from the buffer 
+  // in order, composed and converted to YV12 by worker threads, and 
+  // passed to the encoder in order, so encoding starts with the first 
+  // frame composed.
+
+  CFramePipeline pipeline;
+  BOOL bStatus = FALSE;
+  WTL::CString sFileName;
+  SIZE ScreenSize={0,0};
   int nFrameWidth = 0;
   int nFrameHeight = 0;
-  int ret = 1;
-  
-  memset(&to, 0, sizeof(to));
-  memset(&og, 0, sizeof(og));
-  memset(&op, 0, sizeof(op));
-  memset(&tc, 0, sizeof(tc));
+  int i;
 
-  // Clear frame buffer
-  memset(&raw, 0, sizeof(raw));
+  m_pOutFile = NULL;
+  m_pTheoraEnc = NULL;
+  m_bOggStreamInit = FALSE;
+  m_bVP8CodecInit = FALSE;
+  m_nEncodedFrameCount = m_FrameBuffer.GetFrameCount();
+  if(m_nEncodedFrameCount==0)
+    goto cleanup; // Nothing to encode
 
   /* Determine max screen size, it will define frame width and height */
-  SIZE ScreenSize={0,0};
-  size_t i;
-  for(i=0; i<m_aVideoFrames.size(); i++)
+  for(i=0; i<m_nEncodedFrameCount; i++)
   {
-    ScreenshotInfo& ssi = m_aVideoFrames[i];
+    ScreenshotInfo& ssi = m_aVideoFrames[m_FrameBuffer.GetFrameSlot(i)];
     if(ScreenSize.cx<ssi.m_rcVirtualScreen.Width() ||
        ScreenSize.cy<ssi.m_rcVirtualScreen.Height())
     {
@@ -249,360 +237,468 @@ BOOL CVideoRecorder::EncodeVideo()
   }
   
   /* Theora encoder has a divisible-by-sixteen restriction for the encoded frame size */
-    /* scale the picture size up to the nearest /16 and calculate offsets */
-    nFrameWidth=nFrameWidth+15&~0xF;
-    nFrameHeight=nFrameHeight+15&~0xF;
-    
-  /* Set up Ogg output stream */
-    srand((unsigned int)time(NULL));
-    ogg_stream_init(&to,rand());                                                              
-    
-  // Fill in a th_info structure with details on the format of the video you wish to encode.
-  th_info_init(&ti);
-    ti.frame_width=nFrameWidth;
-    ti.frame_height=nFrameHeight;
-    ti.pic_width=nFrameWidth;
-    ti.pic_height=nFrameHeight;
-    ti.pic_x=0;
-    ti.pic_y=0;
-    ti.fps_numerator=1000;
-    ti.fps_denominator=m_nVideoFrameInterval;
-    ti.aspect_numerator=0;
-    ti.aspect_denominator=0;
-    ti.colorspace=TH_CS_UNSPECIFIED;
-    ti.target_bitrate=0; // VBR mode at specified video quality
-    ti.quality=m_nVideoQuality; 
-    ti.keyframe_granule_shift=6;
-    ti.pixel_fmt=TH_PF_420;
-   
-  // Allocate a th_enc_ctx handle with th_encode_alloc().
-    td=th_encode_alloc(&ti);
-    th_info_clear(&ti);
-  
-  /*Allocate YV12 image */
-  int nDataSize = (nFrameWidth*nFrameHeight*3)/2;
-  unsigned char* pImageData = new unsigned char[nDataSize]; 
-  raw[0].data = pImageData;
-  raw[0].width = nFrameWidth;
-  raw[0].height = nFrameHeight;
-  raw[0].stride = nFrameWidth;
-  raw[1].data = pImageData+nFrameWidth*nFrameHeight;
-  raw[1].width = nFrameWidth/2;
-  raw[1].height = nFrameHeight/2;
-  raw[1].stride = nFrameWidth/2;
-  raw[2].data = pImageData+nFrameWidth*nFrameHeight*5/4;
-  raw[2].width = nFrameWidth/2;
-  raw[2].height = nFrameHeight/2;
-  raw[2].stride = nFrameWidth/2;
-  
+  /* scale the picture size up to the nearest /16 and calculate offsets */
+  m_nFrameWidth = nFrameWidth+15&~0xF;
+  m_nFrameHeight = nFrameHeight+15&~0xF;
+  if(m_nFrameWidth==0 || m_nFrameHeight==0)
+    goto cleanup;
+
   /*Open output file */
-  WTL::CString sFileName = m_sSaveToDir + _T("\\video.ogg");
+  sFileName = m_sSaveToDir + (m_bEncodeVP8 ? _T("\\video.webm") : _T("\\video.ogg"));
   m_sOutFile = sFileName;
-  _tfopen_s(&fout, sFileName, _T("wb"));
-  if(fout==NULL)
+  _tfopen_s(&m_pOutFile, sFileName, _T("wb"));
+  if(m_pOutFile==NULL)
     goto cleanup;
 
-  /* write the bitstream header packets with proper page interleave */
-    th_comment_init(&tc);
-  // Repeatedly call th_encode_flushheader() to retrieve all the header packets.
-    // first packet will get its own page automatically 
-    if(th_encode_flushheader(td,&tc,&op)<=0)
+  // Init the encoder and write file headers
+  if(m_bEncodeVP8 ? !StartVP8Encoding() : !StartTheoraEncoding())
+    goto cleanup;
+
+  // Create a worker thread per processor and the buffers of frames 
+  // being composed, as many as fit into the memory budget. A slot holds 
+  // the RGB and YUV frame images and a copy of monitor images, which 
+  // cover the virtual screen at most.
   {
-      // Internal Theora library error.
+    size_t uSlotSize = (size_t)m_nFrameWidth*m_nFrameHeight*3 + 
+      (size_t)m_nFrameWidth*m_nFrameHeight*3/2 + 
+      (size_t)((ScreenSize.cx*3+3)&~3)*ScreenSize.cy;
+    int nThreads = 0;
+    int nSlots = 0;
+    CFramePipeline::FitMemoryBudget(uSlotSize, VIDEO_ENCODE_MEMORY_BUDGET, 0, nThreads, nSlots);
+    if(pipeline.Init(nThreads, nSlots)!=FPIPE_OK)
       goto cleanup;
-    }
+  }
 
-  /* Write OGG page */
-  ogg_stream_packetin(&to,&op);
-    if(ogg_stream_pageout(&to,&og)!=1)
+  m_aEncodeSlots.resize(pipeline.GetSlotCount());
+  for(i=0; i<(int)m_aEncodeSlots.size(); i++)
   {
-    goto cleanup;
+    m_aEncodeSlots[i].m_aFrame.resize((size_t)m_nFrameWidth*m_nFrameHeight*3);
+    m_aEncodeSlots[i].m_aYUV.resize((size_t)m_nFrameWidth*m_nFrameHeight*3/2);
   }
-  fwrite(og.header,1,og.header_len,fout);
-    fwrite(og.body,1,og.body_len,fout);
 
-  /* create the remaining theora headers */
-    for(;;)
-  {
-      ret=th_encode_flushheader(td,&tc,&op);
-      if(ret<0)
-    {
-        // Internal Theora library error
-        goto cleanup;
-      }
-      else if(!ret)
-      break;
-    ogg_stream_packetin(&to,&op);
-    }
-    
-  /* Write OGG page */
-  for(;;)
+  /* Encode frames, starting with the oldest one */
+  if(pipeline.Run(m_nEncodedFrameCount, ReadFrameStage, 
+    ComposeFrameStage, WriteFrameStage, this)!=FPIPE_OK)
+    goto cleanup;
+
+  bStatus = TRUE;
+      
+cleanup:
+
+  // Stop worker threads
+  pipeline.Destroy();
+
+  /* Write the rest of the video and free codec resources */
+  if(m_bEncodeVP8 ? !FinishVP8Encoding(bStatus) : !FinishTheoraEncoding(bStatus))
+    bStatus = FALSE;
+
+  // Close file
+  if(m_pOutFile)
   {
-    int ret = ogg_stream_flush(&to,&og);
-    if(ret==0)
-      break;
-    if(ret<0)
-      goto cleanup;
-    fwrite(og.header,1,og.header_len,fout);
-    fwrite(og.body,1,og.body_len,fout);
+    if(fclose(m_pOutFile)!=0)
+      bStatus = FALSE;
+    m_pOutFile = NULL;
   }
-  
-  /* Encode frames. */
-  int nFrame = m_nFrameId; // Start with the oldest frame
-  if(nFrame==(int)m_aVideoFrames.size())
-    nFrame=0; // Start from the zeroth frame
-  for( ; ; )
-  {
-    /* Compose frame */
-    frame_avail = ComposeFrame(nFrame, &raw);
 
-    // Encode frame
-    if(th_encode_ycbcr_in(td, raw)) 
-    {
-      goto cleanup;
-    }
+  // Free recorded frames.
+  m_FrameBuffer.Destroy();
+  std::vector< std::vector<unsigned char> >().swap(m_aMonitorPixels);
+  std::vector<EncodeSlot>().swap(m_aEncodeSlots);
 
-    // Read packets
-    while((ret = th_encode_packetout(td, !frame_avail, &op))!=0)
-    {
-      /* Write OGG page */
-      ogg_stream_packetin(&to,&op);
-      int ret = ogg_stream_pageout(&to,&og);
-      if(ret<0)
-        goto cleanup;
-      if(ret!=0)
-      {
-        fwrite(og.header,1,og.header_len,fout);
-        fwrite(og.body,1,og.body_len,fout);
-      }
-    }
-  
-    // Increment total encoded frame count
-    if(frame_avail)
-      frame_cnt++;
-    else 
-      break;
+  // Done
+  return bStatus;
+}
 
-    // Increment frame index
-    nFrame++;
-    if(nFrame==(int)m_aVideoFrames.size())
-      nFrame=0; // Start from the zeroth frame
+bool CVideoRecorder::ReadFrameStage(int nFrame, int nSlot, void* pParam)
+{
+  CVideoRecorder* pThis = (CVideoRecorder*)pParam;
+  return pThis->ReadFrame(nFrame, nSlot)!=FALSE;
+}
 
-    if(nFrame==m_nFrameId || frame_cnt>=(int)m_aVideoFrames.size())
-      break; // All frames have been encoded
-  }
+bool CVideoRecorder::ComposeFrameStage(int /*nFrame*/, int nSlot, void* pParam)
+{
+  CVideoRecorder* pThis = (CVideoRecorder*)pParam;
+  return pThis->ComposeFrame(nSlot)!=FALSE;
+}
 
-  /* Write OGG page */
-  for(;;)
+bool CVideoRecorder::WriteFrameStage(int nFrame, int nSlot, void* pParam)
+{
+  CVideoRecorder* pThis = (CVideoRecorder*)pParam;
+  return pThis->WriteFrame(nFrame, nSlot)!=FALSE;
+}
+
+BOOL CVideoRecorder::ReadFrame(int nFrame, int nSlot)
+{
+  // This method restores monitor images of a frame. A delta image updates
+  // the image restored for the previous frame, so images are restored in 
+  // frame order, then copied to the slot to be composed.
+
+  EncodeSlot& slot = m_aEncodeSlots[nSlot];
+  int nBufferSlot = m_FrameBuffer.GetFrameSlot(nFrame);
+  int nImageCount = m_FrameBuffer.GetImageCount(nBufferSlot);
+  int i;
+
+  slot.m_nBufferSlot = nBufferSlot;
+  slot.m_aImages.resize(nImageCount);
+
+  for(i=0; i<nImageCount; i++)
   {
-    int ret = ogg_stream_flush(&to,&og);
-    if(ret==0)
-      break;
-    if(ret<0)
-      goto cleanup;
-    fwrite(og.header,1,og.header_len,fout);
-    fwrite(og.body,1,og.body_len,fout);
+    MonitorImage& image = slot.m_aImages[i];
+    image.m_nWidth = 0;
+    image.m_nHeight = 0;
+
+    // Restore image pixels, rows are DWORD-aligned as in DIBs.
+    int nWidth = 0;
+    int nHeight = 0;
+    if(!m_FrameBuffer.GetImageSize(nBufferSlot, i, nWidth, nHeight))
+      continue;
+    int nStride = (nWidth*3+3)&~3;
+    if((int)m_aMonitorPixels.size()<=i)
+      m_aMonitorPixels.resize(i+1);
+    std::vector<unsigned char>& aPixels = m_aMonitorPixels[i];
+    aPixels.resize((size_t)nStride*nHeight);
+    if(!m_FrameBuffer.ReadImage(nBufferSlot, i, &aPixels[0], nStride))
+      continue; // The image is not drawn
+
+    image.m_nWidth = nWidth;
+    image.m_nHeight = nHeight;
+    image.m_aPixels.assign(aPixels.begin(), aPixels.end());
   }
-      
-cleanup:
 
-  /* Free codec resources */
-  ogg_stream_clear(&to);
-    th_comment_clear(&tc);
-  th_encode_free(td);
+  return TRUE;
+}
 
-  // Close file
-  if(fout)
-    fclose(fout);
+BOOL CVideoRecorder::ComposeFrame(int nSlot)
+{
+  // This method composes several monitor images into single frame image.
+  // It is called by worker threads and uses the buffers of its slot only.
 
-  if(raw[0].data)
-    delete [] raw[0].data;
+  EncodeSlot& slot = m_aEncodeSlots[nSlot];
+  const ScreenshotInfo& ssi = m_aVideoFrames[slot.m_nBufferSlot];
+  int nYSize = m_nFrameWidth*m_nFrameHeight;
+  int i;
 
-  // Delete temp files.
-  WTL::CString sDirName = m_sSaveToDir + _T("\\~temp_video");
-  Utility::RecycleFile(sDirName, true);
+  // The area not covered by monitors is black
+  memset(&slot.m_aFrame[0], 0, slot.m_aFrame.size());
+
+  // Walk through monitor images
+  for(i=0; i<(int)ssi.m_aMonitors.size() && i<(int)slot.m_aImages.size(); i++)
+  {
+    MonitorImage& image = slot.m_aImages[i];
+    if(image.m_nWidth==0 || image.m_nHeight==0)
+      continue;
+
+    float x_ratio = (float)m_nFrameWidth/(float)ssi.m_rcVirtualScreen.Width();
+    float y_ratio = (float)m_nFrameHeight/(float)ssi.m_rcVirtualScreen.Height();
+    int xDest = (int)ceil((ssi.m_aMonitors[i].m_rcMonitor.left +  abs(ssi.m_rcVirtualScreen.left))*x_ratio-0.5);
+    int yDest = (int)ceil((ssi.m_aMonitors[i].m_rcMonitor.top + abs(ssi.m_rcVirtualScreen.top))*y_ratio-0.5);
+    int wDest = (int)ceil(ssi.m_aMonitors[i].m_rcMonitor.Width()*x_ratio-0.5);
+    int hDest = (int)ceil(ssi.m_aMonitors[i].m_rcMonitor.Height()*y_ratio-0.5);
+
+    // Copy image to its destination rect
+    slot.m_Scaler.Draw(&image.m_aPixels[0], image.m_nWidth, image.m_nHeight, 
+      (image.m_nWidth*3+3)&~3, &slot.m_aFrame[0], m_nFrameWidth, m_nFrameHeight, 
+      m_nFrameWidth*3, xDest, yDest, wDest, hDest);
+  }
+
+  // Convert RGB to YV12, the U plane follows the Y plane and the V plane 
+  // follows the U plane
+  RGB24_To_YV12(&slot.m_aFrame[0], m_nFrameWidth, m_nFrameHeight, m_nFrameWidth*3, 
+    &slot.m_aYUV[0], m_nFrameWidth, 
+    &slot.m_aYUV[nYSize], m_nFrameWidth/2, 
+    &slot.m_aYUV[nYSize+nYSize/4], m_nFrameWidth/2);
 
-  // Done
   return TRUE;
 }
 
-BOOL CVideoRecorder::ComposeFrame(int nFrameId, th_ycbcr_buffer *pImage)
+BOOL CVideoRecorder::WriteFrame(int nFrame, int nSlot)
 {
-  // This method composes several bitmaps into single frame image
+  unsigned char* pYUV = &m_aEncodeSlots[nSlot].m_aYUV[0];
 
-  // Validate input
-  if(nFrameId<0 || nFrameId>=(int)m_aVideoFrames.size())
-    return FALSE;
+  if(m_bEncodeVP8)
+    return WriteVP8Frame(nFrame, pYUV);
+
+  return WriteTheoraFrame(nFrame, pYUV);
+}
 
-  if(pImage==NULL)
+BOOL CVideoRecorder::StartTheoraEncoding()
+{
+  th_info          ti;
+  th_comment       tc;
+  ogg_packet       op; /* one raw packet of data for decode */
+  ogg_page         og; /* one Ogg bitstream page.  Vorbis packets are inside */
+  BOOL bStatus = FALSE;
+  int ret = 1;
+
+  memset(&op, 0, sizeof(op));
+  memset(&og, 0, sizeof(og));
+
+  /* Set up Ogg output stream */
+  srand((unsigned int)time(NULL));
+  ogg_stream_init(&m_OggStream,rand());
+  m_bOggStreamInit = TRUE;
+    
+  // Fill in a th_info structure with details on the format of the video you wish to encode.
+  th_info_init(&ti);
+  ti.frame_width=m_nFrameWidth;
+  ti.frame_height=m_nFrameHeight;
+  ti.pic_width=m_nFrameWidth;
+  ti.pic_height=m_nFrameHeight;
+  ti.pic_x=0;
+  ti.pic_y=0;
+  ti.fps_numerator=1000;
+  ti.fps_denominator=m_nVideoFrameInterval;
+  ti.aspect_numerator=0;
+  ti.aspect_denominator=0;
+  ti.colorspace=TH_CS_UNSPECIFIED;
+  ti.target_bitrate=0; // VBR mode at specified video quality
+  ti.quality=m_nVideoQuality; 
+  ti.keyframe_granule_shift=6;
+  ti.pixel_fmt=TH_PF_420;
+   
+  // Allocate a th_enc_ctx handle with th_encode_alloc().
+  m_pTheoraEnc=th_encode_alloc(&ti);
+  th_info_clear(&ti);
+  if(m_pTheoraEnc==NULL)
     return FALSE;
 
-  if(m_hbmpFrame==NULL)
+  /* write the bitstream header packets with proper page interleave */
+  th_comment_init(&tc);
+  // Repeatedly call th_encode_flushheader() to retrieve all the header packets.
+  // first packet will get its own page automatically 
+  if(th_encode_flushheader(m_pTheoraEnc,&tc,&op)<=0)
   {
-    // Calculate frame size
+    // Internal Theora library error.
+    goto cleanup;
+  }
 
-    CreateFrameDIB(pImage[0]->width, pImage[0]->height, 24);
+  /* Write OGG page */
+  ogg_stream_packetin(&m_OggStream,&op);
+  if(ogg_stream_pageout(&m_OggStream,&og)!=1)
+  {
+    goto cleanup;
   }
+  if(fwrite(og.header,1,og.header_len,m_pOutFile)!=(size_t)og.header_len ||
+     fwrite(og.body,1,og.body_len,m_pOutFile)!=(size_t)og.body_len)
+    goto cleanup;
 
-  // Walk through monitor bitmaps
-  ScreenshotInfo& ssi = m_aVideoFrames[nFrameId];
-  size_t i;
-  for(i=0; i<ssi.m_aMonitors.size(); i++)
+  /* create the remaining theora headers */
+  for(;;)
   {
-    // Load image from BMP
-    WTL::CString sFileName = ssi.m_aMonitors[i].m_sFileName;
-    HBITMAP hBitmap = LoadBitmapFromBMPFile(sFileName);
-    if(hBitmap)
+    ret=th_encode_flushheader(m_pTheoraEnc,&tc,&op);
+    if(ret<0)
     {
-      // Create temp DC
-      HDC hMemDC = CreateCompatibleDC(m_hDC);
-      // Select loaded bitmap into DC
-      HBITMAP hOldBitmap = (HBITMAP)SelectObject(hMemDC, hBitmap);
-
-      float x_ratio = (float)pImage[0]->width/(float)ssi.m_rcVirtualScreen.Width();
-      float y_ratio = (float)pImage[0]->height/(float)ssi.m_rcVirtualScreen.Height();
-      int xDest = (int)ceil((ssi.m_aMonitors[i].m_rcMonitor.left +  abs(ssi.m_rcVirtualScreen.left))*x_ratio-0.5);
-      int yDest = (int)ceil((ssi.m_aMonitors[i].m_rcMonitor.top + abs(ssi.m_rcVirtualScreen.top))*y_ratio-0.5);
-      int wDest = (int)ceil(ssi.m_aMonitors[i].m_rcMonitor.Width()*x_ratio-0.5);
-      int hDest = (int)ceil(ssi.m_aMonitors[i].m_rcMonitor.Height()*y_ratio-0.5);
-
-      // Copy bitmap to its destination rect
-      int nOldMode = SetStretchBltMode(m_hDC, HALFTONE);
-      StretchBlt(m_hDC, xDest, yDest, wDest, hDest, hMemDC, 0, 0, 
-        ssi.m_aMonitors[i].m_rcMonitor.Width(), ssi.m_aMonitors[i].m_rcMonitor.Height(), SRCCOPY);
-      SetStretchBltMode(m_hDC, nOldMode);
-
-      // Select old bitmap into DC
-      SelectObject(hMemDC, hOldBitmap);
-      // Free DC
-      DeleteDC(hMemDC);
-      // Free loaded bitmap
-      DeleteObject(hBitmap);
-    }		
+      // Internal Theora library error
+      goto cleanup;
+    }
+    else if(!ret)
+      break;
+    ogg_stream_packetin(&m_OggStream,&op);
   }
 
-  // Convert RGB to YV12
-  RGB_To_YV12((unsigned char*)m_pFrameBits, 
-    pImage[0]->width, pImage[0]->height, 
-    pImage[0]->width*3+(pImage[0]->width*3)%4, 
-    (*pImage)[0].data, (*pImage)[1].data, (*pImage)[2].data);
+  /* Write OGG pages */
+  bStatus = WriteOggPages(TRUE);
 
-  return TRUE;
-}
+cleanup:
 
-BOOL CVideoRecorder::CreateFrameDIB(DWORD dwWidth, DWORD dwHeight, int nBits)
-{
-  if (m_pDIB) 
-    return FALSE;
+  th_comment_clear(&tc);
 
-  const DWORD dwcBihSize = sizeof(BITMAPINFOHEADER);
+  return bStatus;
+}
 
-  // Calculate the memory required for the DIB
-  DWORD dwSize = dwcBihSize +
-    (2>>nBits) * sizeof(RGBQUAD) +
-    ((nBits * dwWidth) * dwHeight);
+BOOL CVideoRecorder::WriteTheoraFrame(int nFrame, unsigned char* pYUV)
+{
+  th_ycbcr_buffer raw;	
+  ogg_packet op;
+  int nYSize = m_nFrameWidth*m_nFrameHeight;
+  int ret;
 
-  m_pDIB = (LPBITMAPINFO)new BYTE[dwSize];
-  if (!m_pDIB) 
+  raw[0].data = pYUV;
+  raw[0].width = m_nFrameWidth;
+  raw[0].height = m_nFrameHeight;
+  raw[0].stride = m_nFrameWidth;
+  raw[1].data = pYUV+nYSize;
+  raw[1].width = m_nFrameWidth/2;
+  raw[1].height = m_nFrameHeight/2;
+  raw[1].stride = m_nFrameWidth/2;
+  raw[2].data = pYUV+nYSize*5/4;
+  raw[2].width = m_nFrameWidth/2;
+  raw[2].height = m_nFrameHeight/2;
+  raw[2].stride = m_nFrameWidth/2;
+
+  // Encode frame
+  if(th_encode_ycbcr_in(m_pTheoraEnc, raw)) 
     return FALSE;
 
+  // Read packets, the packet of the last frame ends the stream
+  while((ret = th_encode_packetout(m_pTheoraEnc, 
+    nFrame==m_nEncodedFrameCount-1, &op))>0)
+  {
+    /* Write OGG pages */
+    ogg_stream_packetin(&m_OggStream,&op);
+    if(!WriteOggPages(FALSE))
+      return FALSE;
+  }
+
+  return ret==0;
+}
 
-  m_pDIB->bmiHeader.biSize = dwcBihSize;
-  m_pDIB->bmiHeader.biWidth = dwWidth;
-  m_pDIB->bmiHeader.biHeight = -(LONG)dwHeight;
-  m_pDIB->bmiHeader.biBitCount = (WORD)nBits;
-  m_pDIB->bmiHeader.biPlanes = 1;
-  m_pDIB->bmiHeader.biCompression = BI_RGB;
-  m_pDIB->bmiHeader.biXPelsPerMeter = 1000;
-  m_pDIB->bmiHeader.biYPelsPerMeter = 1000;
-  m_pDIB->bmiHeader.biClrUsed = 0;
-  m_pDIB->bmiHeader.biClrImportant = 0;
-
-  LPRGBQUAD lpColors =
-    (LPRGBQUAD)(m_pDIB+m_pDIB->bmiHeader.biSize);
-  int nColors=2>>m_pDIB->bmiHeader.biBitCount;
-  for(int i=0;i<nColors;i++)
+BOOL CVideoRecorder::WriteOggPages(BOOL bFlush)
+{
+  // Writes complete pages, or all packets when flushing
+  ogg_page og;
+  for(;;)
   {
-    lpColors[i].rgbRed=0;
-    lpColors[i].rgbBlue=0;
-    lpColors[i].rgbGreen=0;
-    lpColors[i].rgbReserved=0;
+    int ret = bFlush ? ogg_stream_flush(&m_OggStream,&og) : 
+      ogg_stream_pageout(&m_OggStream,&og);
+    if(ret==0)
+      break;
+    if(ret<0)
+      return FALSE;
+    if(fwrite(og.header,1,og.header_len,m_pOutFile)!=(size_t)og.header_len ||
+       fwrite(og.body,1,og.body_len,m_pOutFile)!=(size_t)og.body_len)
+      return FALSE;
   }
 
-  m_hDC = CreateCompatibleDC(GetDC(NULL));
+  return TRUE;
+}
 
-  m_hbmpFrame = CreateDIBSection(m_hDC, m_pDIB, DIB_RGB_COLORS, &m_pFrameBits,
-    NULL, 0);
+BOOL CVideoRecorder::FinishTheoraEncoding(BOOL bFlush)
+{
+  BOOL bStatus = TRUE;
 
-  m_hOldBitmap = (HBITMAP)SelectObject(m_hDC, m_hbmpFrame);
+  /* Write OGG pages */
+  if(bFlush && !WriteOggPages(TRUE))
+    bStatus = FALSE;
 
-  return TRUE;
+  /* Free codec resources */
+  if(m_bOggStreamInit)
+  {
+    ogg_stream_clear(&m_OggStream);
+    m_bOggStreamInit = FALSE;
+  }
+
+  if(m_pTheoraEnc)
+  {
+    th_encode_free(m_pTheoraEnc);
+    m_pTheoraEnc = NULL;
+  }
+
+  return bStatus;
 }
 
-HBITMAP CVideoRecorder::LoadBitmapFromBMPFile(LPCTSTR szFileName)
+BOOL CVideoRecorder::StartVP8Encoding()
 {
-  // This method loads a BMP file.
+  vpx_codec_enc_cfg_t cfg;
 
-  // Use LoadImage() to get the image loaded into a DIBSection
-  HBITMAP hBitmap = (HBITMAP)LoadImage( NULL, szFileName, IMAGE_BITMAP, 0, 0,
-    LR_CREATEDIBSECTION | LR_DEFAULTSIZE | LR_LOADFROMFILE );
+  if(vpx_codec_enc_config_default(vpx_codec_vp8_cx(), &cfg, 0)!=VPX_CODEC_OK)
+    return FALSE;
 
-  return hBitmap;
+  // Time is counted in frame intervals. Frames are encoded as soon as 
+  // they are composed, using a thread per processor.
+  cfg.g_w = m_nFrameWidth;
+  cfg.g_h = m_nFrameHeight;
+  cfg.g_timebase.num = m_nVideoFrameInterval;
+  cfg.g_timebase.den = 1000;
+  cfg.g_threads = CParallelDeflate::GetProcessorCount();
+  cfg.g_lag_in_frames = 0;
+  
+  // Constant quality mode. Keyframes at least as often as in Theora video.
+  cfg.rc_end_usage = VPX_CQ;
+  cfg.rc_min_quantizer = 4;
+  cfg.rc_max_quantizer = 63;
+  cfg.kf_mode = VPX_KF_AUTO;
+  cfg.kf_max_dist = 64;
+
+  if(vpx_codec_enc_init(&m_VP8Codec, vpx_codec_vp8_cx(), &cfg, 0)!=VPX_CODEC_OK)
+    return FALSE;
+  m_bVP8CodecInit = TRUE;
+
+  // Quality 0..63 maps to quantizer 63..4
+  unsigned int uCQLevel = m_nVideoQuality<59 ? 63-m_nVideoQuality : 4;
+  if(vpx_codec_control(&m_VP8Codec, VP8E_SET_CQ_LEVEL, uCQLevel)!=VPX_CODEC_OK ||
+     vpx_codec_control(&m_VP8Codec, VP8E_SET_CPUUSED, 4)!=VPX_CODEC_OK)
+    return FALSE;
+
+  // Write file headers
+  return m_WebmWriter.Open(m_pOutFile, m_nFrameWidth, m_nFrameHeight, m_nVideoFrameInterval);
 }
 
-WTL::CString CVideoRecorder::GetOutFile()
+BOOL CVideoRecorder::WriteVP8Frame(int nFrame, unsigned char* pYUV)
 {
-  return m_sOutFile;
+  vpx_image_t img;
+  int nPacketCount = 0;
+
+  // The U plane follows the Y plane, the V plane follows the U plane
+  if(!vpx_img_wrap(&img, VPX_IMG_FMT_I420, m_nFrameWidth, m_nFrameHeight, 1, pYUV))
+    return FALSE;
+
+  // Encode frame
+  if(vpx_codec_encode(&m_VP8Codec, &img, nFrame, 1, 0, VPX_DL_REALTIME)!=VPX_CODEC_OK)
+    return FALSE;
+
+  return WriteVP8Packets(nPacketCount);
 }
 
-void CVideoRecorder::RGB_To_YV12( unsigned char *pRGBData, int nFrameWidth, 
-  int nFrameHeight, int nRGBStride, unsigned char *pFullYPlane, 
-  unsigned char *pDownsampledUPlane, 
-  unsigned char *pDownsampledVPlane )
+BOOL CVideoRecorder::WriteVP8Packets(int& nPacketCount)
 {
-  // Convert RGB -> YV12. We do this in-place to avoid allocating any more memory.
-  unsigned char *pYPlaneOut = (unsigned char*)pFullYPlane;
-  int nYPlaneOut = 0;
+  vpx_codec_iter_t iter = NULL;
+  const vpx_codec_cx_pkt_t* pkt = NULL;
 
-  int x, y;
-  for(y=0; y<nFrameHeight;y++)
+  nPacketCount = 0;
+  while((pkt = vpx_codec_get_cx_data(&m_VP8Codec, &iter))!=NULL)
   {
-    for (x=0; x < nFrameWidth; x ++)
-    {
-      int nRGBOffs = y*nRGBStride+x*3;
+    if(pkt->kind!=VPX_CODEC_CX_FRAME_PKT)
+      continue;
+
+    // Frame time is in frame intervals
+    if(!m_WebmWriter.WriteFrame(pkt->data.frame.buf, pkt->data.frame.sz, 
+      (uint64_t)pkt->data.frame.pts*m_nVideoFrameInterval,
+      (pkt->data.frame.flags&VPX_FRAME_IS_KEY)!=0))
+      return FALSE;
 
-      unsigned char B = pRGBData[nRGBOffs+0];
-      unsigned char G = pRGBData[nRGBOffs+1];
-      unsigned char R = pRGBData[nRGBOffs+2];
+    nPacketCount++;
+  }
 
-      float y = (float)( R*66 + G*129 + B*25 + 128 ) / 256 + 16;
-      float u = (float)( R*-38 + G*-74 + B*112 + 128 ) / 256 + 128;
-      float v = (float)( R*112 + G*-94 + B*-18 + 128 ) / 256 + 128;
+  return TRUE;
+}
 
-      // NOTE: We're converting pRGBData to YUV in-place here as well as writing out YUV to pFullYPlane/pDownsampledUPlane/pDownsampledVPlane.
-      pRGBData[nRGBOffs+0] = (unsigned char)y;
-      pRGBData[nRGBOffs+1] = (unsigned char)u;
-      pRGBData[nRGBOffs+2] = (unsigned char)v;
+BOOL CVideoRecorder::FinishVP8Encoding(BOOL bFlush)
+{
+  BOOL bStatus = TRUE;
 
-      // Write out the Y plane directly here rather than in another loop.
-      pYPlaneOut[nYPlaneOut++] = pRGBData[nRGBOffs+0];
+  if(bFlush)
+  {
+    // Get the frames kept by the encoder
+    for(;;)
+    {
+      int nPacketCount = 0;
+      if(vpx_codec_encode(&m_VP8Codec, NULL, -1, 1, 0, VPX_DL_REALTIME)!=VPX_CODEC_OK ||
+         !WriteVP8Packets(nPacketCount))
+      {
+        bStatus = FALSE;
+        break;
+      }
+      if(nPacketCount==0)
+        break;
     }
+
+    // Update element sizes and video duration
+    if(!m_WebmWriter.Close())
+      bStatus = FALSE;
   }
 
-  // Downsample to U and V.
-  int halfHeight = nFrameHeight/2;
-  int halfWidth = nFrameWidth/2;
-    
-  for ( int yPixel=0; yPixel < halfHeight; yPixel++ )
+  /* Free codec resources */
+  if(m_bVP8CodecInit)
   {
-    int iBaseSrc = ( (yPixel*2) * nRGBStride );
+    vpx_codec_destroy(&m_VP8Codec);
+    m_bVP8CodecInit = FALSE;
+  }
 
-    for ( int xPixel=0; xPixel < halfWidth; xPixel++ )
-    {
-      pDownsampledVPlane[yPixel * halfWidth + xPixel] = pRGBData[iBaseSrc + 2];
-      pDownsampledUPlane[yPixel * halfWidth + xPixel] = pRGBData[iBaseSrc + 1];
+  return bStatus;
+}
 
-      iBaseSrc += 6;
-    }
-  }
+WTL::CString CVideoRecorder::GetOutFile()
+{
+  return m_sOutFile;
 }
\ No newline at end of file
@@ -16,11 +16,23 @@ be found in the Authors.txt file in the root of the source tree.
 #pragma once
 #include "stdafx.h"
 #include "ScreenCap.h"
+#include "FrameRingBuffer.h"
+#include "FramePipeline.h"
+#include "FrameScale.h"
+#include "WebmWriter.h"
 #include "theora/theoraenc.h"
+#include "vpx/vpx_encoder.h"
+
+// Memory for the frames being encoded at once: the composed frame images and the 
+// copies of monitor images they are composed of. With large virtual screens fewer 
+// frames are encoded in parallel.
+#define VIDEO_ENCODE_MEMORY_BUDGET (256*1024*1024)
 
 // class CVideoRecorder
-// Captures desktop and writes the video frames as raw uncompressed BMP files
-// Later the recorded frames are encoded to a libtheora-encoded video file.
+// Captures desktop and keeps the last video frames in a memory ring buffer.
+// Later the recorded frames are encoded to a libtheora-encoded (OGG) or 
+// VP8-encoded (WebM) video file. Frames are composed by several threads 
+// while the encoder compresses the frames already composed.
 //
 class CVideoRecorder
 {
@@ -39,18 +51,21 @@ public:
       int nVideoDuration,
       int nVideoFrameInterval,
       int nVideoQuality,
-      SIZE* pDesiredFrameSize
+      SIZE* pDesiredFrameSize,
+      BOOL bCompressFrames = TRUE,
+      BOOL bEncodeVP8 = FALSE
       );
 
   BOOL IsInitialized();
 
-  // Deletes all temp files and frees used resources.
+  // Frees recorded frames and other used resources.
   void Destroy();
 
   // Records a single video frame
   BOOL RecordVideoFrame();
 
-  // Encodes the video with VP8 codec and writes .webm file.
+  // Encodes the video with Theora codec and writes .ogg file, or with
+  // VP8 codec and writes .webm file.
   BOOL EncodeVideo();
 
   // Returns the output file name
@@ -58,22 +73,50 @@ public:
 
 private:
 
-  // Sets video frame parameters.
-  void SetVideoFrameInfo(int nFrameId, ScreenshotInfo& ssi);
-
-  // Composes video frame from one or several bitmaps.
-  BOOL ComposeFrame(int nFrameId, th_ycbcr_buffer* raw);
-
-  // Creates a device-independent bitmap (DIB) used as video frame
-  BOOL CreateFrameDIB(DWORD dwWidth, DWORD dwHeight,int nBits);
-
-  // Loads a BMP file and returns its data.
-  HBITMAP LoadBitmapFromBMPFile(LPCTSTR szFileName);
-
-  // Converts an RGB24 image to YV12 image.
-  void RGB_To_YV12( unsigned char *pRGBData, int nFrameWidth, 
-        int nFrameHeight, int nRGBStride, unsigned char *pFullYPlane, 
-        unsigned char *pDownsampledUPlane, unsigned char *pDownsampledVPlane );
+  // A monitor image restored from the frame buffer
+  struct MonitorImage
+  {
+    int m_nWidth;   // Image width.
+    int m_nHeight;  // Image height.
+    std::vector<unsigned char> m_aPixels; // Rows are DWORD-aligned, as in DIBs.
+  };
+
+  // Buffers of a frame passing through the encoding pipeline
+  struct EncodeSlot
+  {
+    int m_nBufferSlot; // Frame buffer slot the frame was read from.
+    std::vector<MonitorImage> m_aImages; // Monitor images of the frame.
+    std::vector<unsigned char> m_aFrame; // Composed 24-bit frame image.
+    std::vector<unsigned char> m_aYUV;   // YV12 planes of the frame.
+    CFrameScaler m_Scaler; // Scales monitor images into the frame.
+  };
+
+  // Pipeline stages, pParam is a pointer to CVideoRecorder.
+  static bool ReadFrameStage(int nFrame, int nSlot, void* pParam);
+  static bool ComposeFrameStage(int nFrame, int nSlot, void* pParam);
+  static bool WriteFrameStage(int nFrame, int nSlot, void* pParam);
+
+  // Restores monitor images of a frame from the frame buffer. Called in frame order.
+  BOOL ReadFrame(int nFrame, int nSlot);
+
+  // Composes video frame from one or several monitor images and converts it to YV12.
+  // Called by worker threads.
+  BOOL ComposeFrame(int nSlot);
+
+  // Passes a composed frame to the encoder. Called in frame order.
+  BOOL WriteFrame(int nFrame, int nSlot);
+
+  // Theora encoding.
+  BOOL StartTheoraEncoding();
+  BOOL WriteTheoraFrame(int nFrame, unsigned char* pYUV);
+  BOOL WriteOggPages(BOOL bFlush);
+  BOOL FinishTheoraEncoding(BOOL bFlush);
+
+  // VP8 encoding.
+  BOOL StartVP8Encoding();
+  BOOL WriteVP8Frame(int nFrame, unsigned char* pYUV);
+  BOOL WriteVP8Packets(int& nPacketCount);
+  BOOL FinishVP8Encoding(BOOL bFlush);
   
   /* Internal variables */
   BOOL m_bInitialized;  // Init flag.
@@ -81,7 +124,9 @@ private:
   WTL::CString m_sOutFile;   // Output webm file.
   SCREENSHOT_TYPE m_ScreenshotType; // What part of desktop is captured.
   CScreenCapture m_sc;  // Screen capture object
-  std::vector<ScreenshotInfo> m_aVideoFrames; // Array of recorded video frames.
+  std::vector<ScreenshotInfo> m_aVideoFrames; // Info of recorded video frames, indexed by frame buffer slot.
+  CFrameRingBuffer m_FrameBuffer; // Pixels of recorded video frames.
+  std::vector< std::vector<unsigned char> > m_aMonitorPixels; // The last restored image of each monitor.
   SIZE m_DesiredFrameSize; // Desired frame size.
   SIZE m_ActualFrameSize;  // Actual frame size.
   int m_nVideoQuality;  // Video quality.
@@ -89,11 +134,16 @@ private:
   int m_nVideoFrameInterval; // Interval between two subsequent frames (in msec).
   DWORD m_dwProcessId;  // ID of the process being captured.
   int m_nFrameCount;    // Total max count of frames.
-  int m_nFileId;        // Index of current BMP file.
-  int m_nFrameId;       // Index of current video frame.
-  HBITMAP m_hbmpFrame;  // Video frame bitmap.
-  LPVOID m_pFrameBits;  // Frame buffer.
-  LPBITMAPINFO m_pDIB;  // Bitmap info.
-  HDC m_hDC;            // Device context.
-  HBITMAP m_hOldBitmap; //	
+  BOOL m_bEncodeVP8;    // Use VP8 codec instead of Theora.
+  int m_nFrameWidth;    // Width of encoded frames.
+  int m_nFrameHeight;   // Height of encoded frames.
+  int m_nEncodedFrameCount; // Count of frames being encoded.
+  std::vector<EncodeSlot> m_aEncodeSlots; // Buffers of frames in the encoding pipeline.
+  FILE* m_pOutFile;     // Output video file.
+  th_enc_ctx* m_pTheoraEnc; // Theora encoder.
+  ogg_stream_state m_OggStream; // OGG stream.
+  BOOL m_bOggStreamInit; // Whether m_OggStream is initialized.
+  vpx_codec_ctx_t m_VP8Codec; // VP8 encoder.
+  BOOL m_bVP8CodecInit; // Whether m_VP8Codec is initialized.
+  CWebmWriter m_WebmWriter; // Writes VP8 frames to the output file.
 };
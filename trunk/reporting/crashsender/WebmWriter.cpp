@@ -0,0 +1,300 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "WebmWriter.h"
+#include <string.h>
+
+// Element IDs
+#define WEBM_EBML               0x1A45DFA3
+#define WEBM_EBML_VERSION       0x4286
+#define WEBM_EBML_READ_VERSION  0x42F7
+#define WEBM_EBML_MAX_ID_LENGTH 0x42F2
+#define WEBM_EBML_MAX_SIZE_LENGTH 0x42F3
+#define WEBM_DOC_TYPE           0x4282
+#define WEBM_DOC_TYPE_VERSION   0x4287
+#define WEBM_DOC_TYPE_READ_VERSION 0x4285
+#define WEBM_SEGMENT            0x18538067
+#define WEBM_INFO               0x1549A966
+#define WEBM_TIMECODE_SCALE     0x2AD7B1
+#define WEBM_DURATION           0x4489
+#define WEBM_MUXING_APP         0x4D80
+#define WEBM_WRITING_APP        0x5741
+#define WEBM_TRACKS             0x1654AE6B
+#define WEBM_TRACK_ENTRY        0xAE
+#define WEBM_TRACK_NUMBER       0xD7
+#define WEBM_TRACK_UID          0x73C5
+#define WEBM_TRACK_TYPE         0x83
+#define WEBM_DEFAULT_DURATION   0x23E383
+#define WEBM_CODEC_ID           0x86
+#define WEBM_VIDEO              0xE0
+#define WEBM_PIXEL_WIDTH        0xB0
+#define WEBM_PIXEL_HEIGHT       0xBA
+#define WEBM_CLUSTER            0x1F43B675
+#define WEBM_TIMECODE           0xE7
+#define WEBM_SIMPLE_BLOCK       0xA3
+
+// Size fields of master elements are 8 bytes long, so they can be updated in place
+#define WEBM_SIZE_FIELD_LENGTH 8
+
+CWebmWriter::CWebmWriter()
+{
+    m_pFile = NULL;
+    m_nFrameInterval = 0;
+    m_nSegmentSizePos = -1;
+    m_nDurationPos = -1;
+    m_nClusterSizePos = -1;
+    m_uClusterTime = 0;
+    m_uLastTime = 0;
+    m_bError = false;
+}
+
+bool CWebmWriter::Open(FILE* pFile, int nWidth, int nHeight, int nFrameInterval)
+{
+    m_pFile = pFile;
+    m_nFrameInterval = nFrameInterval;
+    m_nClusterSizePos = -1;
+    m_uClusterTime = 0;
+    m_uLastTime = 0;
+    m_bError = pFile==NULL;
+
+    long nPos = StartElement(WEBM_EBML);
+    WriteUInt(WEBM_EBML_VERSION, 1);
+    WriteUInt(WEBM_EBML_READ_VERSION, 1);
+    WriteUInt(WEBM_EBML_MAX_ID_LENGTH, 4);
+    WriteUInt(WEBM_EBML_MAX_SIZE_LENGTH, 8);
+    WriteString(WEBM_DOC_TYPE, "webm");
+    WriteUInt(WEBM_DOC_TYPE_VERSION, 2);
+    WriteUInt(WEBM_DOC_TYPE_READ_VERSION, 2);
+    EndElement(nPos);
+
+    m_nSegmentSizePos = StartElement(WEBM_SEGMENT);
+
+    // Times are in milliseconds. The duration is updated on close.
+    nPos = StartElement(WEBM_INFO);
+    WriteUInt(WEBM_TIMECODE_SCALE, 1000000);
+    m_nDurationPos = m_bError ? -1 : ftell(m_pFile)+3;
+    WriteFloat(WEBM_DURATION, 0);
+    WriteString(WEBM_MUXING_APP, "CrashRpt");
+    WriteString(WEBM_WRITING_APP, "CrashRpt");
+    EndElement(nPos);
+
+    nPos = StartElement(WEBM_TRACKS);
+    long nTrackPos = StartElement(WEBM_TRACK_ENTRY);
+    WriteUInt(WEBM_TRACK_NUMBER, 1);
+    WriteUInt(WEBM_TRACK_UID, 1);
+    WriteUInt(WEBM_TRACK_TYPE, 1); // Video
+    WriteUInt(WEBM_DEFAULT_DURATION, (uint64_t)nFrameInterval*1000000);
+    WriteString(WEBM_CODEC_ID, "V_VP8");
+    long nVideoPos = StartElement(WEBM_VIDEO);
+    WriteUInt(WEBM_PIXEL_WIDTH, nWidth);
+    WriteUInt(WEBM_PIXEL_HEIGHT, nHeight);
+    EndElement(nVideoPos);
+    EndElement(nTrackPos);
+    EndElement(nPos);
+
+    return !m_bError;
+}
+
+bool CWebmWriter::WriteFrame(const void* pData, size_t uSize, uint64_t uTime, bool bKeyFrame)
+{
+    if(m_pFile==NULL || m_bError || uTime<m_uLastTime)
+        return false;
+
+    // Block times are 16-bit offsets from the cluster time. A cluster starts with
+    // a key frame, so players can seek to it.
+    if(m_nClusterSizePos<0 || bKeyFrame || uTime-m_uClusterTime>32767)
+    {
+        if(m_nClusterSizePos>=0)
+            EndElement(m_nClusterSizePos);
+
+        m_nClusterSizePos = StartElement(WEBM_CLUSTER);
+        m_uClusterTime = uTime;
+        WriteUInt(WEBM_TIMECODE, uTime);
+    }
+
+    unsigned char abHeader[4];
+    unsigned uOffset = (unsigned)(uTime-m_uClusterTime);
+    abHeader[0] = 0x81; // Track number 1
+    abHeader[1] = (unsigned char)(uOffset>>8);
+    abHeader[2] = (unsigned char)uOffset;
+    abHeader[3] = bKeyFrame ? 0x80 : 0x00;
+
+    WriteID(WEBM_SIMPLE_BLOCK);
+    WriteSize(sizeof(abHeader)+uSize);
+    WriteBytes(abHeader, sizeof(abHeader));
+    WriteBytes(pData, uSize);
+
+    m_uLastTime = uTime;
+    return !m_bError;
+}
+
+bool CWebmWriter::Close()
+{
+    if(m_pFile==NULL)
+        return false;
+
+    if(m_nClusterSizePos>=0)
+        EndElement(m_nClusterSizePos);
+    m_nClusterSizePos = -1;
+
+    EndElement(m_nSegmentSizePos);
+
+    // Update the duration, the last frame lasts a frame interval
+    if(!m_bError && m_nDurationPos>=0)
+    {
+        double dDuration = (double)(m_uLastTime+m_nFrameInterval);
+        unsigned char abValue[8];
+        uint64_t uBits;
+        int i;
+
+        memcpy(&uBits, &dDuration, sizeof(uBits));
+        for(i=0; i<8; i++)
+            abValue[i] = (unsigned char)(uBits>>(56-8*i));
+
+        if(fseek(m_pFile, m_nDurationPos, SEEK_SET)!=0)
+            m_bError = true;
+        WriteBytes(abValue, sizeof(abValue));
+        if(fseek(m_pFile, 0, SEEK_END)!=0)
+            m_bError = true;
+    }
+
+    if(fflush(m_pFile)!=0)
+        m_bError = true;
+
+    m_pFile = NULL;
+    return !m_bError;
+}
+
+bool CWebmWriter::WriteBytes(const void* pData, size_t uSize)
+{
+    if(m_bError)
+        return false;
+
+    if(uSize!=0 && fwrite(pData, 1, uSize, m_pFile)!=uSize)
+        m_bError = true;
+
+    return !m_bError;
+}
+
+bool CWebmWriter::WriteID(unsigned uID)
+{
+    unsigned char abID[4];
+    int nLength = uID>0xFFFFFF ? 4 : uID>0xFFFF ? 3 : uID>0xFF ? 2 : 1;
+    int i;
+
+    for(i=0; i<nLength; i++)
+        abID[i] = (unsigned char)(uID>>(8*(nLength-1-i)));
+
+    return WriteBytes(abID, nLength);
+}
+
+bool CWebmWriter::WriteSize(uint64_t uSize)
+{
+    unsigned char abSize[8];
+    int nLength = 1;
+    int i;
+
+    // A length of n bytes holds 7*n bits; all ones is reserved for unknown size
+    while(nLength<8 && uSize>=((uint64_t)1<<(7*nLength))-1)
+        nLength++;
+
+    for(i=0; i<nLength; i++)
+        abSize[i] = (unsigned char)(uSize>>(8*(nLength-1-i)));
+    abSize[0] |= (unsigned char)(0x80>>(nLength-1));
+
+    return WriteBytes(abSize, nLength);
+}
+
+bool CWebmWriter::WriteUInt(unsigned uID, uint64_t uValue)
+{
+    unsigned char abValue[8];
+    int nLength = 1;
+    int i;
+
+    while(nLength<8 && (uValue>>(8*nLength))!=0)
+        nLength++;
+
+    for(i=0; i<nLength; i++)
+        abValue[i] = (unsigned char)(uValue>>(8*(nLength-1-i)));
+
+    WriteID(uID);
+    WriteSize(nLength);
+    return WriteBytes(abValue, nLength);
+}
+
+bool CWebmWriter::WriteFloat(unsigned uID, double dValue)
+{
+    unsigned char abValue[8];
+    uint64_t uBits;
+    int i;
+
+    memcpy(&uBits, &dValue, sizeof(uBits));
+    for(i=0; i<8; i++)
+        abValue[i] = (unsigned char)(uBits>>(56-8*i));
+
+    WriteID(uID);
+    WriteSize(sizeof(abValue));
+    return WriteBytes(abValue, sizeof(abValue));
+}
+
+bool CWebmWriter::WriteString(unsigned uID, const char* szValue)
+{
+    size_t uLength = strlen(szValue);
+
+    WriteID(uID);
+    WriteSize(uLength);
+    return WriteBytes(szValue, uLength);
+}
+
+long CWebmWriter::StartElement(unsigned uID)
+{
+    // Unknown size until the element is ended
+    static const unsigned char s_abUnknownSize[WEBM_SIZE_FIELD_LENGTH] =
+        {0x01, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+    if(!WriteID(uID))
+        return -1;
+
+    long nPos = ftell(m_pFile);
+    if(nPos<0)
+        m_bError = true;
+
+    WriteBytes(s_abUnknownSize, sizeof(s_abUnknownSize));
+    return nPos;
+}
+
+bool CWebmWriter::EndElement(long nSizePos)
+{
+    if(m_bError || nSizePos<0)
+        return false;
+
+    long nEnd = ftell(m_pFile);
+    if(nEnd<0)
+    {
+        m_bError = true;
+        return false;
+    }
+
+    uint64_t uSize = (uint64_t)(nEnd-nSizePos-WEBM_SIZE_FIELD_LENGTH);
+    unsigned char abSize[WEBM_SIZE_FIELD_LENGTH];
+    int i;
+
+    abSize[0] = 0x01;
+    for(i=1; i<WEBM_SIZE_FIELD_LENGTH; i++)
+        abSize[i] = (unsigned char)(uSize>>(8*(WEBM_SIZE_FIELD_LENGTH-1-i)));
+
+    if(fseek(m_pFile, nSizePos, SEEK_SET)!=0)
+        m_bError = true;
+    WriteBytes(abSize, sizeof(abSize));
+    if(fseek(m_pFile, nEnd, SEEK_SET)!=0)
+        m_bError = true;
+
+    return !m_bError;
+}
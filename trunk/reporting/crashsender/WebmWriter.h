@@ -0,0 +1,77 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: WebmWriter.h
+// Description: Minimal WebM (Matroska) muxer for a single VP8 video track. Writes the
+// EBML header, segment info, track description and clusters of simple blocks; element
+// sizes are updated when the file is closed. Cues are not written.
+
+#pragma once
+#include <stdio.h>
+#include <stddef.h>
+
+#if defined(_MSC_VER) && _MSC_VER<1600
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+// class CWebmWriter
+// Writes VP8 frames produced by the encoder to a WebM file.
+class CWebmWriter
+{
+public:
+
+    CWebmWriter();
+
+    // Writes the file header. The file must be opened for writing in binary mode.
+    // nFrameInterval is the interval between frames in milliseconds.
+    bool Open(FILE* pFile, int nWidth, int nHeight, int nFrameInterval);
+
+    // Writes a compressed frame. uTime is the presentation time in milliseconds,
+    // it must not decrease.
+    bool WriteFrame(const void* pData, size_t uSize, uint64_t uTime, bool bKeyFrame);
+
+    // Finishes the file by updating element sizes and video duration.
+    // The file is not closed.
+    bool Close();
+
+private:
+
+    // Writes bytes, remembers an error
+    bool WriteBytes(const void* pData, size_t uSize);
+
+    // Writes an element ID (IDs include their length marker bits)
+    bool WriteID(unsigned uID);
+
+    // Writes an element data size as a variable length integer
+    bool WriteSize(uint64_t uSize);
+
+    // Write elements of basic types
+    bool WriteUInt(unsigned uID, uint64_t uValue);
+    bool WriteFloat(unsigned uID, double dValue);
+    bool WriteString(unsigned uID, const char* szValue);
+
+    // Starts a master element of unknown size. Returns the position of the size field.
+    long StartElement(unsigned uID);
+
+    // Sets the size of a master element started at the given position to span
+    // up to the end of file
+    bool EndElement(long nSizePos);
+
+    FILE* m_pFile;              // Output file
+    int m_nFrameInterval;       // Interval between frames, in milliseconds
+    long m_nSegmentSizePos;     // Position of the segment size field
+    long m_nDurationPos;        // Position of the duration value
+    long m_nClusterSizePos;     // Position of the current cluster size field, -1 if none
+    uint64_t m_uClusterTime;    // Time of the current cluster
+    uint64_t m_uLastTime;       // Time of the last frame written
+    bool m_bError;              // Whether a write failed
+};
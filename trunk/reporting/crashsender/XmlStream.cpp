@@ -0,0 +1,860 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "XmlStream.h"
+#include <string.h>
+
+// Returns true for the characters TinyXML treats as white space
+static bool IsSpace(char c)
+{
+    return c==' ' || c=='\t' || c=='\n' || c=='\r' || c=='\v' || c=='\f';
+}
+
+// Encodes a code point as UTF-8. Returns the number of bytes written (at most 4).
+static int EncodeUtf8(unsigned int uChar, char* pOut)
+{
+    if(uChar<0x80)
+    {
+        pOut[0] = (char)uChar;
+        return 1;
+    }
+    if(uChar<0x800)
+    {
+        pOut[0] = (char)(0xC0|(uChar>>6));
+        pOut[1] = (char)(0x80|(uChar&0x3F));
+        return 2;
+    }
+    if(uChar<0x10000)
+    {
+        pOut[0] = (char)(0xE0|(uChar>>12));
+        pOut[1] = (char)(0x80|((uChar>>6)&0x3F));
+        pOut[2] = (char)(0x80|(uChar&0x3F));
+        return 3;
+    }
+    pOut[0] = (char)(0xF0|(uChar>>18));
+    pOut[1] = (char)(0x80|((uChar>>12)&0x3F));
+    pOut[2] = (char)(0x80|((uChar>>6)&0x3F));
+    pOut[3] = (char)(0x80|(uChar&0x3F));
+    return 4;
+}
+
+//-----------------------------------------------------------------------------
+// CXmlWriter
+//-----------------------------------------------------------------------------
+
+CXmlWriter::CXmlWriter()
+{
+    m_f = NULL;
+    m_nDepth = 0;
+    m_nSkipDepth = 0;
+    m_bStartTagOpen = false;
+    m_bError = false;
+}
+
+CXmlWriter::~CXmlWriter()
+{
+}
+
+void CXmlWriter::Open(FILE* f, bool bBOM)
+{
+    m_f = f;
+    m_sBuffer.clear();
+    if(f!=NULL)
+        m_sBuffer.reserve(XML_WRITER_BUFFER_SIZE+1024);
+    m_nDepth = 0;
+    m_nSkipDepth = 0;
+    m_bStartTagOpen = false;
+    m_bError = false;
+
+    if(bBOM)
+        m_sBuffer += "\xEF\xBB\xBF";
+    m_sBuffer += "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n";
+}
+
+void CXmlWriter::BeginElement(const char* szName)
+{
+    if(m_nSkipDepth>0 || m_nDepth==XML_WRITER_MAX_DEPTH)
+    {
+        // Nested too deep
+        m_nSkipDepth++;
+        m_bError = true;
+        return;
+    }
+
+    if(m_nDepth>0)
+    {
+        CloseStartTag();
+        m_aStack[m_nDepth-1].m_bHasElements = true;
+        WriteIndent(m_nDepth);
+    }
+
+    m_sBuffer += '<';
+    m_sBuffer += szName;
+
+    OpenElement& elem = m_aStack[m_nDepth++];
+    elem.m_szName = szName;
+    elem.m_bHasElements = false;
+    elem.m_bHasText = false;
+    m_bStartTagOpen = true;
+}
+
+void CXmlWriter::AddAttribute(const char* szName, const char* szValue)
+{
+    if(!m_bStartTagOpen || m_nSkipDepth>0)
+        return;
+
+    m_sBuffer += ' ';
+    m_sBuffer += szName;
+    m_sBuffer += "=\"";
+    WriteEscaped(szValue);
+    m_sBuffer += '"';
+}
+
+void CXmlWriter::AddAttribute(const char* szName, const wchar_t* szValue)
+{
+    if(!m_bStartTagOpen || m_nSkipDepth>0)
+        return;
+
+    m_sBuffer += ' ';
+    m_sBuffer += szName;
+    m_sBuffer += "=\"";
+    WriteEscaped(szValue);
+    m_sBuffer += '"';
+}
+
+void CXmlWriter::AddText(const char* szText)
+{
+    if(m_nDepth==0 || m_nSkipDepth>0)
+        return;
+
+    CloseStartTag();
+    m_aStack[m_nDepth-1].m_bHasText = true;
+    WriteEscaped(szText);
+    FlushIfFull();
+}
+
+void CXmlWriter::AddText(const wchar_t* szText)
+{
+    if(m_nDepth==0 || m_nSkipDepth>0)
+        return;
+
+    CloseStartTag();
+    m_aStack[m_nDepth-1].m_bHasText = true;
+    WriteEscaped(szText);
+    FlushIfFull();
+}
+
+void CXmlWriter::EndElement()
+{
+    if(m_nSkipDepth>0)
+    {
+        m_nSkipDepth--;
+        return;
+    }
+
+    if(m_nDepth==0)
+        return;
+
+    OpenElement& elem = m_aStack[--m_nDepth];
+    if(m_bStartTagOpen)
+    {
+        // No content
+        m_sBuffer += " />";
+        m_bStartTagOpen = false;
+    }
+    else
+    {
+        // End tag of an element with children goes to a separate line
+        if(elem.m_bHasElements)
+            WriteIndent(m_nDepth);
+        m_sBuffer += "</";
+        m_sBuffer += elem.m_szName;
+        m_sBuffer += '>';
+    }
+
+    if(m_nDepth==0)
+        m_sBuffer += '\n';
+
+    FlushIfFull();
+}
+
+void CXmlWriter::AddElement(const char* szName, const char* szText)
+{
+    BeginElement(szName);
+    AddText(szText);
+    EndElement();
+}
+
+void CXmlWriter::AddElement(const char* szName, const wchar_t* szText)
+{
+    BeginElement(szName);
+    AddText(szText);
+    EndElement();
+}
+
+bool CXmlWriter::Close()
+{
+    while(m_nSkipDepth>0 || m_nDepth>0)
+        EndElement();
+
+    Flush();
+    if(m_f!=NULL && ferror(m_f))
+        m_bError = true;
+
+    return !m_bError;
+}
+
+const char* CXmlWriter::GetData() const
+{
+    return m_sBuffer.c_str();
+}
+
+size_t CXmlWriter::GetSize() const
+{
+    return m_sBuffer.size();
+}
+
+void CXmlWriter::CloseStartTag()
+{
+    if(m_bStartTagOpen)
+    {
+        m_sBuffer += '>';
+        m_bStartTagOpen = false;
+    }
+}
+
+void CXmlWriter::WriteIndent(int nDepth)
+{
+    m_sBuffer += '\n';
+    m_sBuffer.append((size_t)nDepth*4, ' ');
+}
+
+void CXmlWriter::WriteEscaped(const char* szText)
+{
+    if(szText==NULL)
+        return;
+
+    // Copy runs of characters that don't need encoding at once
+    const char* p = szText;
+    const char* pRun = szText;
+    for(; *p!=0; p++)
+    {
+        unsigned char c = (unsigned char)*p;
+        if(c>=32 && c!='&' && c!='<' && c!='>' && c!='"' && c!='\'')
+            continue;
+
+        m_sBuffer.append(pRun, p-pRun);
+        WriteEscapedChar(c);
+        pRun = p+1;
+    }
+    m_sBuffer.append(pRun, p-pRun);
+}
+
+void CXmlWriter::WriteEscaped(const wchar_t* szText)
+{
+    if(szText==NULL)
+        return;
+
+    const wchar_t* p;
+    for(p=szText; *p!=0; p++)
+    {
+        unsigned int uChar = (unsigned int)*p;
+        if(uChar>=0xD800 && uChar<0xDC00 &&
+            (unsigned int)p[1]>=0xDC00 && (unsigned int)p[1]<0xE000)
+        {
+            // UTF-16 surrogate pair
+            uChar = 0x10000+((uChar-0xD800)<<10)+((unsigned int)p[1]-0xDC00);
+            p++;
+        }
+        else if((uChar>=0xD800 && uChar<0xE000) || uChar>0x10FFFF)
+        {
+            // Unpaired surrogate or not a character
+            uChar = 0xFFFD;
+        }
+
+        WriteEscapedChar(uChar);
+    }
+}
+
+void CXmlWriter::WriteEscapedChar(unsigned int uChar)
+{
+    switch(uChar)
+    {
+    case '&': m_sBuffer += "&amp;"; return;
+    case '<': m_sBuffer += "&lt;"; return;
+    case '>': m_sBuffer += "&gt;"; return;
+    case '"': m_sBuffer += "&quot;"; return;
+    case '\'': m_sBuffer += "&apos;"; return;
+    }
+
+    if(uChar<32)
+    {
+        // Control characters (including line breaks) are written as character
+        // references, as TinyXML does
+        const char* szHex = "0123456789ABCDEF";
+        char szRef[7] = {'&', '#', 'x', szHex[uChar>>4], szHex[uChar&0xF], ';', 0};
+        m_sBuffer += szRef;
+        return;
+    }
+
+    if(uChar<0x80)
+    {
+        m_sBuffer += (char)uChar;
+        return;
+    }
+
+    char szUtf8[4];
+    int nLen = EncodeUtf8(uChar, szUtf8);
+    m_sBuffer.append(szUtf8, nLen);
+}
+
+void CXmlWriter::FlushIfFull()
+{
+    if(m_f!=NULL && m_sBuffer.size()>=XML_WRITER_BUFFER_SIZE)
+        Flush();
+}
+
+void CXmlWriter::Flush()
+{
+    if(m_f==NULL || m_sBuffer.empty())
+        return;
+
+    if(fwrite(m_sBuffer.data(), 1, m_sBuffer.size(), m_f)!=m_sBuffer.size())
+        m_bError = true;
+    m_sBuffer.clear();
+}
+
+//-----------------------------------------------------------------------------
+// CXmlPullParser
+//-----------------------------------------------------------------------------
+
+CXmlPullParser::CXmlPullParser()
+{
+    m_aData.push_back(0);
+    Start();
+}
+
+void CXmlPullParser::Open(const char* pData, size_t uSize)
+{
+    const char* pEnd = pData!=NULL ? (const char*)memchr(pData, 0, uSize) : NULL;
+    if(pEnd!=NULL)
+        uSize = pEnd-pData;
+
+    m_aData.clear();
+    if(pData!=NULL)
+        m_aData.insert(m_aData.end(), pData, pData+uSize);
+    m_aData.push_back(0);
+    Start();
+}
+
+bool CXmlPullParser::Open(FILE* f)
+{
+    long lPos = ftell(f);
+    long lEnd = -1;
+    if(lPos>=0 && fseek(f, 0, SEEK_END)==0)
+    {
+        lEnd = ftell(f);
+        if(fseek(f, lPos, SEEK_SET)!=0)
+            lEnd = -1;
+    }
+
+    m_aData.clear();
+    if(lEnd<lPos)
+    {
+        m_aData.push_back(0);
+        Start();
+        return false;
+    }
+
+    m_aData.resize((size_t)(lEnd-lPos)+1);
+    size_t uRead = fread(&m_aData[0], 1, (size_t)(lEnd-lPos), f);
+    m_aData.resize(uRead);
+    m_aData.push_back(0);
+    Start();
+
+    return uRead==(size_t)(lEnd-lPos);
+}
+
+void CXmlPullParser::Start()
+{
+    m_p = &m_aData[0];
+    if((unsigned char)m_p[0]==0xEF && (unsigned char)m_p[1]==0xBB && (unsigned char)m_p[2]==0xBF)
+        m_p += 3; // UTF-8 byte order mark
+
+    m_bMarkupNext = false;
+    m_nNodeType = XML_NODE_NONE;
+    m_nDepth = 0;
+    m_szName = "";
+    m_szText = "";
+    m_bEmptyElement = false;
+    m_aOpenElements.clear();
+    m_aAttributes.clear();
+}
+
+int CXmlPullParser::Read()
+{
+    if(m_nNodeType==XML_NODE_EOF || m_nNodeType==XML_NODE_ERROR)
+        return m_nNodeType;
+
+    m_aAttributes.clear();
+
+    if(m_bEmptyElement)
+    {
+        // Report the end of the empty element
+        m_bEmptyElement = false;
+        m_aOpenElements.pop_back();
+        m_nDepth = (int)m_aOpenElements.size();
+        m_nNodeType = XML_NODE_END_ELEMENT;
+        return m_nNodeType;
+    }
+
+    for(;;)
+    {
+        if(m_bMarkupNext || *m_p=='<')
+        {
+            m_bMarkupNext = false;
+            m_p++;
+            int nType = ReadMarkup();
+            if(nType!=XML_NODE_NONE)
+                return nType;
+            continue; // Comment, processing instruction or DOCTYPE
+        }
+
+        if(*m_p==0)
+        {
+            if(!m_aOpenElements.empty())
+                return SetError(); // Elements are not closed
+
+            m_nDepth = 0;
+            m_nNodeType = XML_NODE_EOF;
+            return m_nNodeType;
+        }
+
+        // Text outside of the root element is ignored
+        if(ReadCharData() && !m_aOpenElements.empty())
+        {
+            m_nDepth = (int)m_aOpenElements.size();
+            m_nNodeType = XML_NODE_TEXT;
+            return m_nNodeType;
+        }
+    }
+}
+
+int CXmlPullParser::GetNodeType() const
+{
+    return m_nNodeType;
+}
+
+int CXmlPullParser::GetDepth() const
+{
+    return m_nDepth;
+}
+
+const char* CXmlPullParser::GetName() const
+{
+    return m_szName;
+}
+
+bool CXmlPullParser::IsEmptyElement() const
+{
+    return m_nNodeType==XML_NODE_ELEMENT && m_bEmptyElement;
+}
+
+const char* CXmlPullParser::GetAttribute(const char* szName) const
+{
+    size_t i;
+    for(i=0; i<m_aAttributes.size(); i++)
+    {
+        if(strcmp(m_aAttributes[i].m_szName, szName)==0)
+            return m_aAttributes[i].m_szValue;
+    }
+
+    return NULL;
+}
+
+const char* CXmlPullParser::GetText() const
+{
+    return m_szText;
+}
+
+bool CXmlPullParser::ReadChildElement(int nParentDepth)
+{
+    for(;;)
+    {
+        int nType = Read();
+        if(nType==XML_NODE_ELEMENT && m_nDepth==nParentDepth+1)
+            return true;
+        if(nType==XML_NODE_END_ELEMENT && m_nDepth<=nParentDepth)
+            return false;
+        if(nType==XML_NODE_EOF || nType==XML_NODE_ERROR)
+            return false;
+    }
+}
+
+const char* CXmlPullParser::ReadElementText()
+{
+    const char* szText = "";
+
+    if(m_nNodeType!=XML_NODE_ELEMENT)
+        return szText;
+
+    int nDepth = m_nDepth;
+    bool bFirstChild = true;
+    for(;;)
+    {
+        int nType = Read();
+        if(nType==XML_NODE_EOF || nType==XML_NODE_ERROR)
+            break;
+        if(nType==XML_NODE_END_ELEMENT && m_nDepth==nDepth)
+            break;
+
+        if(bFirstChild && m_nDepth==nDepth+1)
+        {
+            if(nType==XML_NODE_TEXT)
+                szText = m_szText;
+            bFirstChild = false;
+        }
+    }
+
+    return szText;
+}
+
+int CXmlPullParser::ReadMarkup()
+{
+    char* p = m_p;
+
+    if(*p=='/')
+    {
+        m_p = p+1;
+        return ReadEndTag();
+    }
+
+    if(*p=='?')
+    {
+        // Processing instruction or XML declaration
+        char* pEnd = strstr(p+1, "?>");
+        if(pEnd==NULL)
+            return SetError();
+        m_p = pEnd+2;
+        return XML_NODE_NONE;
+    }
+
+    if(*p=='!')
+    {
+        if(strncmp(p, "!--", 3)==0)
+        {
+            // Comment
+            char* pEnd = strstr(p+3, "-->");
+            if(pEnd==NULL)
+                return SetError();
+            m_p = pEnd+3;
+            return XML_NODE_NONE;
+        }
+
+        if(strncmp(p, "![CDATA[", 8)==0)
+        {
+            // CDATA section is text taken as is, except for line breaks
+            char* pText = p+8;
+            char* pEnd = strstr(pText, "]]>");
+            if(pEnd==NULL)
+                return SetError();
+            m_p = pEnd+3;
+
+            char* pIn = pText;
+            char* pOut = pText;
+            while(pIn<pEnd)
+            {
+                if(*pIn=='\r')
+                {
+                    *pOut++ = '\n';
+                    pIn++;
+                    if(pIn<pEnd && *pIn=='\n')
+                        pIn++;
+                }
+                else
+                    *pOut++ = *pIn++;
+            }
+            *pOut = 0;
+
+            if(m_aOpenElements.empty())
+                return XML_NODE_NONE;
+
+            m_szText = pText;
+            m_nDepth = (int)m_aOpenElements.size();
+            m_nNodeType = XML_NODE_TEXT;
+            return m_nNodeType;
+        }
+
+        // DOCTYPE or another declaration
+        char* pEnd = strchr(p, '>');
+        if(pEnd==NULL)
+            return SetError();
+        m_p = pEnd+1;
+        return XML_NODE_NONE;
+    }
+
+    return ReadStartTag();
+}
+
+int CXmlPullParser::ReadStartTag()
+{
+    // Names are terminated with zero after the characters following them are parsed
+    char* p = m_p;
+    char* pName = p;
+    while(*p!=0 && !IsSpace(*p) && *p!='/' && *p!='>')
+        p++;
+    if(p==pName)
+        return SetError();
+    char* pNameEnd = p;
+
+    bool bEmpty = false;
+    for(;;)
+    {
+        while(IsSpace(*p))
+            p++;
+
+        if(*p=='/')
+        {
+            if(p[1]!='>')
+                return SetError();
+            bEmpty = true;
+            p += 2;
+            break;
+        }
+
+        if(*p=='>')
+        {
+            p++;
+            break;
+        }
+
+        if(*p==0)
+            return SetError();
+
+        // Attribute name
+        char* pAttrName = p;
+        while(*p!=0 && !IsSpace(*p) && *p!='=' && *p!='/' && *p!='>')
+            p++;
+        char* pAttrNameEnd = p;
+
+        while(IsSpace(*p))
+            p++;
+        if(*p!='=')
+            return SetError();
+        p++;
+        while(IsSpace(*p))
+            p++;
+        if(*p!='"' && *p!='\'')
+            return SetError();
+
+        char* pValue = p+1;
+        p = DecodeAttribute(pValue, *p);
+        if(p==NULL)
+            return SetError();
+        *pAttrNameEnd = 0;
+
+        Attribute attr;
+        attr.m_szName = pAttrName;
+        attr.m_szValue = pValue;
+        m_aAttributes.push_back(attr);
+    }
+    *pNameEnd = 0;
+
+    m_p = p;
+    m_szName = pName;
+    m_nDepth = (int)m_aOpenElements.size();
+    m_aOpenElements.push_back(pName);
+    m_bEmptyElement = bEmpty;
+    m_nNodeType = XML_NODE_ELEMENT;
+    return m_nNodeType;
+}
+
+int CXmlPullParser::ReadEndTag()
+{
+    char* p = m_p;
+    char* pName = p;
+    while(*p!=0 && !IsSpace(*p) && *p!='>')
+        p++;
+    char* pNameEnd = p;
+
+    while(IsSpace(*p))
+        p++;
+    if(*p!='>')
+        return SetError();
+    p++;
+    *pNameEnd = 0;
+
+    if(m_aOpenElements.empty() || strcmp(m_aOpenElements.back(), pName)!=0)
+        return SetError(); // Doesn't match the start tag
+
+    m_aOpenElements.pop_back();
+    m_p = p;
+    m_szName = pName;
+    m_nDepth = (int)m_aOpenElements.size();
+    m_nNodeType = XML_NODE_END_ELEMENT;
+    return m_nNodeType;
+}
+
+bool CXmlPullParser::ReadCharData()
+{
+    // Leading and trailing white space is removed and other runs of white space are
+    // replaced with a single space. The text is never longer than its source, so it is
+    // decoded in place.
+    char* pText = m_p;
+    char* pIn = m_p;
+    char* pOut = m_p;
+    bool bSpace = false;
+
+    while(IsSpace(*pIn))
+        pIn++;
+
+    while(*pIn!=0 && *pIn!='<')
+    {
+        if(IsSpace(*pIn))
+        {
+            bSpace = true;
+            pIn++;
+            continue;
+        }
+
+        if(bSpace)
+        {
+            *pOut++ = ' ';
+            bSpace = false;
+        }
+
+        if(*pIn=='&')
+        {
+            int nLen = 0;
+            pIn = DecodeEntity(pIn, pOut, nLen);
+            pOut += nLen;
+        }
+        else
+            *pOut++ = *pIn++;
+    }
+
+    // The zero may overwrite '<' of the next markup
+    m_bMarkupNext = *pIn=='<';
+    m_p = pIn;
+    *pOut = 0;
+    m_szText = pText;
+
+    return pOut!=pText;
+}
+
+char* CXmlPullParser::DecodeAttribute(char* p, char chQuote)
+{
+    // White space of attribute values is kept, line breaks are normalized to '\n'
+    char* pOut = p;
+    while(*p!=chQuote)
+    {
+        if(*p==0)
+            return NULL;
+
+        if(*p=='&')
+        {
+            int nLen = 0;
+            p = DecodeEntity(p, pOut, nLen);
+            pOut += nLen;
+        }
+        else if(*p=='\r')
+        {
+            *pOut++ = '\n';
+            p++;
+            if(*p=='\n')
+                p++;
+        }
+        else
+            *pOut++ = *p++;
+    }
+
+    char* pNext = p+1;
+    *pOut = 0;
+    return pNext;
+}
+
+char* CXmlPullParser::DecodeEntity(char* p, char* pOut, int& nLen)
+{
+    // Predefined entities
+    static const struct
+    {
+        const char* m_szEntity;
+        size_t m_uLength;
+        char m_chValue;
+    }
+    aEntities[] =
+    {
+        {"&amp;", 5, '&'},
+        {"&lt;", 4, '<'},
+        {"&gt;", 4, '>'},
+        {"&quot;", 6, '"'},
+        {"&apos;", 6, '\''}
+    };
+
+    if(p[1]=='#')
+    {
+        // Character reference, decimal (&#nnn;) or hexadecimal (&#xhhh;)
+        bool bHex = p[2]=='x';
+        char* q = p+(bHex?3:2);
+        unsigned int uChar = 0;
+        bool bValid = *q!=';';
+        for(; *q!=';'; q++)
+        {
+            int nDigit = -1;
+            if(*q>='0' && *q<='9')
+                nDigit = *q-'0';
+            else if(bHex && *q>='a' && *q<='f')
+                nDigit = *q-'a'+10;
+            else if(bHex && *q>='A' && *q<='F')
+                nDigit = *q-'A'+10;
+
+            if(nDigit<0 || uChar>0x10FFFF)
+            {
+                bValid = false;
+                break;
+            }
+            uChar = uChar*(bHex?16:10)+nDigit;
+        }
+
+        if(bValid && uChar!=0 && uChar<=0x10FFFF)
+        {
+            // The reference is longer than its UTF-8 encoding
+            char szUtf8[4];
+            nLen = EncodeUtf8(uChar, szUtf8);
+            memcpy(pOut, szUtf8, nLen);
+            return q+1;
+        }
+    }
+    else
+    {
+        size_t i;
+        for(i=0; i<sizeof(aEntities)/sizeof(aEntities[0]); i++)
+        {
+            if(strncmp(p, aEntities[i].m_szEntity, aEntities[i].m_uLength)==0)
+            {
+                *pOut = aEntities[i].m_chValue;
+                nLen = 1;
+                return p+aEntities[i].m_uLength;
+            }
+        }
+    }
+
+    // Not an entity, '&' is taken as is
+    *pOut = '&';
+    nLen = 1;
+    return p+1;
+}
+
+int CXmlPullParser::SetError()
+{
+    m_bEmptyElement = false;
+    m_nNodeType = XML_NODE_ERROR;
+    return m_nNodeType;
+}
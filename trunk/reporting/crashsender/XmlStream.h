@@ -0,0 +1,216 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: XmlStream.h
+// Description: Streaming XML writer and pull parser for crash description files
+// (crashrpt.xml). The writer produces the same layout as TinyXML does and the parser
+// returns the same text and attribute values as TinyXML with its default settings,
+// without building a document tree: the parser decodes names, text and attribute
+// values in place in its copy of the document, so nodes don't allocate memory.
+
+#pragma once
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Maximum nesting of elements written by CXmlWriter
+#define XML_WRITER_MAX_DEPTH 32
+
+// Size of the buffer that CXmlWriter fills before writing it to file
+#define XML_WRITER_BUFFER_SIZE (64*1024)
+
+// Node types returned by CXmlPullParser::Read()
+enum XmlNodeType
+{
+    XML_NODE_NONE = 0,        // Nothing has been read yet
+    XML_NODE_ELEMENT = 1,     // Start tag (or empty element tag)
+    XML_NODE_END_ELEMENT = 2, // End tag, also reported after an empty element tag
+    XML_NODE_TEXT = 3,        // Text or CDATA section
+    XML_NODE_EOF = 4,         // End of document
+    XML_NODE_ERROR = 5        // The document is malformed
+};
+
+// class CXmlWriter
+// Writes an XML document element by element. Output is buffered and written to the
+// file in XML_WRITER_BUFFER_SIZE blocks, or kept in memory. Strings are UTF-8 unless
+// passed as wide strings (UTF-16 on Windows, UTF-32 elsewhere).
+class CXmlWriter
+{
+public:
+
+    CXmlWriter();
+    ~CXmlWriter();
+
+    // Starts a document and writes XML declaration. If the file is NULL, the document
+    // is kept in memory (see GetData()). The file is not closed by the writer.
+    void Open(FILE* f, bool bBOM);
+
+    // Writes the start tag of an element. The name must stay valid until the element is
+    // ended (names are usually string literals).
+    void BeginElement(const char* szName);
+
+    // Adds an attribute to the element just begun
+    void AddAttribute(const char* szName, const char* szValue);
+    void AddAttribute(const char* szName, const wchar_t* szValue);
+
+    // Adds text to the current element
+    void AddText(const char* szText);
+    void AddText(const wchar_t* szText);
+
+    // Writes the end tag of the current element
+    void EndElement();
+
+    // Writes an element containing text only
+    void AddElement(const char* szName, const char* szText);
+    void AddElement(const char* szName, const wchar_t* szText);
+
+    // Ends elements left open and writes the rest of the buffer to file. Returns false
+    // if writing failed or elements were nested too deep.
+    bool Close();
+
+    // Returns the document written to memory
+    const char* GetData() const;
+    size_t GetSize() const;
+
+private:
+
+    // Completes the start tag of the current element, if it is still open
+    void CloseStartTag();
+
+    // Starts a new line indented to the depth
+    void WriteIndent(int nDepth);
+
+    // Appends a string encoding the markup characters
+    void WriteEscaped(const char* szText);
+    void WriteEscaped(const wchar_t* szText);
+
+    // Appends a character encoding it if necessary
+    void WriteEscapedChar(unsigned int uChar);
+
+    // Writes the buffer to file when it is full
+    void FlushIfFull();
+
+    // Writes the buffer to file
+    void Flush();
+
+    // An element being written
+    struct OpenElement
+    {
+        const char* m_szName; // Element name
+        bool m_bHasElements;  // Child elements have been written
+        bool m_bHasText;      // Text has been written
+    };
+
+    FILE* m_f;               // Output file, or NULL
+    std::string m_sBuffer;   // Output not yet written to file
+    OpenElement m_aStack[XML_WRITER_MAX_DEPTH]; // Elements being written
+    int m_nDepth;            // Number of elements being written
+    int m_nSkipDepth;        // Number of elements nested too deep, they are not written
+    bool m_bStartTagOpen;    // The start tag of the current element is not completed yet
+    bool m_bError;           // Writing failed
+};
+
+// class CXmlPullParser
+// Reads an XML document node by node. Entities, numeric character references and line
+// breaks are decoded and white space of text is condensed the same way as TinyXML does.
+// Comments, processing instructions and DOCTYPE are skipped. Strings returned by the
+// parser stay valid until another document is opened.
+class CXmlPullParser
+{
+public:
+
+    CXmlPullParser();
+
+    // Opens a document in memory. The data are copied, parsing stops at the first zero byte.
+    void Open(const char* pData, size_t uSize);
+
+    // Opens a document by reading the file from the current position to its end.
+    // Returns false if the file can't be read.
+    bool Open(FILE* f);
+
+    // Reads the next node and returns its type (XML_NODE_*). After the end of document
+    // or an error, the same type is returned again.
+    int Read();
+
+    // Returns the type of the current node
+    int GetNodeType() const;
+
+    // Returns the number of elements enclosing the current node. The root element has depth 0.
+    int GetDepth() const;
+
+    // Returns the name of the current element (start or end tag)
+    const char* GetName() const;
+
+    // Returns true if the current element has no content (<name/>)
+    bool IsEmptyElement() const;
+
+    // Returns the value of an attribute of the current start tag, or NULL if there is
+    // no such attribute
+    const char* GetAttribute(const char* szName) const;
+
+    // Returns the text of the current text node
+    const char* GetText() const;
+
+    // Moves to the next child element of the element at depth nParentDepth, skipping
+    // text and the content of other children. Returns false when the end tag of the
+    // parent is reached. With nParentDepth equal to -1, moves to the next root element.
+    bool ReadChildElement(int nParentDepth);
+
+    // Reads the content of the current start element up to its end tag and returns its
+    // text, if the first child node is text, or an empty string.
+    const char* ReadElementText();
+
+private:
+
+    // Starts parsing of the document in m_aData
+    void Start();
+
+    // Parses markup starting at m_p (after '<')
+    int ReadMarkup();
+
+    // Parses a start tag
+    int ReadStartTag();
+
+    // Parses an end tag
+    int ReadEndTag();
+
+    // Parses text up to the next '<'. Returns false if the text consists of white space only.
+    bool ReadCharData();
+
+    // Decodes an attribute value up to the quote, terminates it with zero and returns
+    // the position after the quote, or NULL if there is no closing quote
+    static char* DecodeAttribute(char* p, char chQuote);
+
+    // Decodes an entity or a character reference at p (pointing to '&') to pOut.
+    // Returns the position after the entity and sets the number of bytes written.
+    static char* DecodeEntity(char* p, char* pOut, int& nLen);
+
+    // Sets the error state
+    int SetError();
+
+    // An attribute of the current start tag
+    struct Attribute
+    {
+        const char* m_szName;
+        const char* m_szValue;
+    };
+
+    std::vector<char> m_aData;     // Document being parsed, zero terminated
+    char* m_p;                     // Parse position
+    bool m_bMarkupNext;            // '<' at m_p was overwritten by the zero terminating text
+    int m_nNodeType;               // Type of the current node
+    int m_nDepth;                  // Depth of the current node
+    const char* m_szName;          // Name of the current element
+    const char* m_szText;          // Text of the current text node
+    bool m_bEmptyElement;          // The current start tag is an empty element tag
+    std::vector<const char*> m_aOpenElements; // Names of the elements being parsed
+    std::vector<Attribute> m_aAttributes;     // Attributes of the current start tag
+};
@@ -0,0 +1,391 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "YuvConvert.h"
+#include <stddef.h>
+
+#ifdef YUV_CONVERT_SSE2
+#include <emmintrin.h>
+#endif
+
+// BT.601 coefficients in 8-bit fixed point. RGB -> YUV matches the floating point formulas
+// CVideoRecorder used before (Y = (66R+129G+25B+128)/256+16 etc.); YUV -> RGB uses
+// 1.164, 2.018, 0.391, 0.813 and 1.596 scaled by 256.
+#define YUV_Y_R 66
+#define YUV_Y_G 129
+#define YUV_Y_B 25
+#define YUV_U_R (-38)
+#define YUV_U_G (-74)
+#define YUV_U_B 112
+#define YUV_V_R 112
+#define YUV_V_G (-94)
+#define YUV_V_B (-18)
+#define RGB_Y 298
+#define RGB_B_U 517
+#define RGB_G_U (-100)
+#define RGB_G_V (-208)
+#define RGB_R_V 409
+
+// Chroma of a 2x2 block is computed from sums of four pixels: the average of the
+// four per-pixel values (c+128)/256+128 is (sum+4*128)/1024+128.
+#define YUV_CHROMA_BIAS ((128<<10)+512)
+
+static inline unsigned char Clamp(int x)
+{
+    return (unsigned char)((x > 255) ? 255 : (x < 0) ? 0 : x);
+}
+
+// Y of a pixel
+static inline unsigned char CalcY(const unsigned char* p)
+{
+    return (unsigned char)(((YUV_Y_R*p[2] + YUV_Y_G*p[1] + YUV_Y_B*p[0] + 128)>>8) + 16);
+}
+
+// Converts pixels [x, nWidth) of two rows, x must be even. pY1 is NULL if the
+// second row is the first one repeated (the last row of an image of odd height).
+static void RGB24_To_YV12_Rows_Scalar(const unsigned char* pRow0, const unsigned char* pRow1,
+    int x, int nWidth, unsigned char* pY0, unsigned char* pY1,
+    unsigned char* pU, unsigned char* pV)
+{
+    int i;
+    for(i=x; i<nWidth; i++)
+    {
+        pY0[i] = CalcY(pRow0+i*3);
+        if(pY1!=NULL)
+            pY1[i] = CalcY(pRow1+i*3);
+    }
+
+    for(; x<nWidth; x+=2)
+    {
+        // The last column of an image of odd width is counted twice
+        int x1 = x+1<nWidth ? x+1 : x;
+        int nSumB = pRow0[x*3+0] + pRow0[x1*3+0] + pRow1[x*3+0] + pRow1[x1*3+0];
+        int nSumG = pRow0[x*3+1] + pRow0[x1*3+1] + pRow1[x*3+1] + pRow1[x1*3+1];
+        int nSumR = pRow0[x*3+2] + pRow0[x1*3+2] + pRow1[x*3+2] + pRow1[x1*3+2];
+
+        pU[x/2] = (unsigned char)((YUV_U_R*nSumR + YUV_U_G*nSumG + YUV_U_B*nSumB + YUV_CHROMA_BIAS)>>10);
+        pV[x/2] = (unsigned char)((YUV_V_R*nSumR + YUV_V_G*nSumG + YUV_V_B*nSumB + YUV_CHROMA_BIAS)>>10);
+    }
+}
+
+// Converts pixels [x, nWidth) of a row.
+static void YV12_To_RGB24_Row_Scalar(const unsigned char* pY, const unsigned char* pU,
+    const unsigned char* pV, int x, int nWidth, unsigned char* pRGB)
+{
+    for(; x<nWidth; x++)
+    {
+        int c = RGB_Y*(pY[x]-16) + 128;
+        int d = pU[x/2]-128;
+        int e = pV[x/2]-128;
+
+        pRGB[x*3+0] = Clamp((c + RGB_B_U*d)>>8);
+        pRGB[x*3+1] = Clamp((c + RGB_G_U*d + RGB_G_V*e)>>8);
+        pRGB[x*3+2] = Clamp((c + RGB_R_V*e)>>8);
+    }
+}
+
+#ifdef YUV_CONVERT_SSE2
+
+// Number of pixels the SSE2 code converts at once
+#define YUV_SSE2_BLOCK 32
+
+// Moves byte s of the six vectors (96 bytes) to position 2*s mod 95.
+static inline void Shuffle96(__m128i v[6])
+{
+    __m128i a0 = _mm_unpacklo_epi8(v[0], v[3]);
+    __m128i a1 = _mm_unpackhi_epi8(v[0], v[3]);
+    __m128i a2 = _mm_unpacklo_epi8(v[1], v[4]);
+    __m128i a3 = _mm_unpackhi_epi8(v[1], v[4]);
+    __m128i a4 = _mm_unpacklo_epi8(v[2], v[5]);
+    __m128i a5 = _mm_unpackhi_epi8(v[2], v[5]);
+    v[0] = a0; v[1] = a1; v[2] = a2; v[3] = a3; v[4] = a4; v[5] = a5;
+}
+
+// Inverse of Shuffle96().
+static inline void Unshuffle96(__m128i v[6])
+{
+    const __m128i kLowBytes = _mm_set1_epi16(0x00ff);
+    __m128i a0 = _mm_packus_epi16(_mm_and_si128(v[0], kLowBytes), _mm_and_si128(v[1], kLowBytes));
+    __m128i a3 = _mm_packus_epi16(_mm_srli_epi16(v[0], 8), _mm_srli_epi16(v[1], 8));
+    __m128i a1 = _mm_packus_epi16(_mm_and_si128(v[2], kLowBytes), _mm_and_si128(v[3], kLowBytes));
+    __m128i a4 = _mm_packus_epi16(_mm_srli_epi16(v[2], 8), _mm_srli_epi16(v[3], 8));
+    __m128i a2 = _mm_packus_epi16(_mm_and_si128(v[4], kLowBytes), _mm_and_si128(v[5], kLowBytes));
+    __m128i a5 = _mm_packus_epi16(_mm_srli_epi16(v[4], 8), _mm_srli_epi16(v[5], 8));
+    v[0] = a0; v[1] = a1; v[2] = a2; v[3] = a3; v[4] = a4; v[5] = a5;
+}
+
+// Splits 32 three-byte pixels into planes: v[0..1] get the first bytes, v[2..3] the
+// second and v[4..5] the third ones. Byte 3*p+c goes to 32*c+p, that is 32*s mod 95,
+// which is Shuffle96() applied five times.
+static inline void LoadDeinterleave(const unsigned char* p, __m128i v[6])
+{
+    int i;
+    for(i=0; i<6; i++)
+        v[i] = _mm_loadu_si128((const __m128i*)(p+16*i));
+    for(i=0; i<5; i++)
+        Shuffle96(v);
+}
+
+// Merges planes into 32 three-byte pixels, the inverse of LoadDeinterleave().
+static inline void InterleaveStore(__m128i v[6], unsigned char* p)
+{
+    int i;
+    for(i=0; i<5; i++)
+        Unshuffle96(v);
+    for(i=0; i<6; i++)
+        _mm_storeu_si128((__m128i*)(p+16*i), v[i]);
+}
+
+// Y of 16 pixels
+static inline __m128i CalcY16(__m128i b, __m128i g, __m128i r)
+{
+    const __m128i kZero = _mm_setzero_si128();
+    const __m128i kYR = _mm_set1_epi16(YUV_Y_R);
+    const __m128i kYG = _mm_set1_epi16(YUV_Y_G);
+    const __m128i kYB = _mm_set1_epi16(YUV_Y_B);
+    const __m128i kRound = _mm_set1_epi16(128);
+    const __m128i kOffset = _mm_set1_epi16(16);
+    __m128i y[2];
+    int i;
+
+    for(i=0; i<2; i++)
+    {
+        __m128i b16 = i==0 ? _mm_unpacklo_epi8(b, kZero) : _mm_unpackhi_epi8(b, kZero);
+        __m128i g16 = i==0 ? _mm_unpacklo_epi8(g, kZero) : _mm_unpackhi_epi8(g, kZero);
+        __m128i r16 = i==0 ? _mm_unpacklo_epi8(r, kZero) : _mm_unpackhi_epi8(r, kZero);
+
+        // The sum is below 65536, so unsigned 16-bit arithmetic is enough
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r16, kYR), _mm_mullo_epi16(g16, kYG));
+        sum = _mm_add_epi16(sum, _mm_mullo_epi16(b16, kYB));
+        sum = _mm_add_epi16(sum, kRound);
+        y[i] = _mm_add_epi16(_mm_srli_epi16(sum, 8), kOffset);
+    }
+
+    return _mm_packus_epi16(y[0], y[1]);
+}
+
+// Sums of horizontal pairs of bytes of two rows (8 sums of 16 bytes)
+static inline __m128i SumPairs(__m128i row0, __m128i row1)
+{
+    const __m128i kLowBytes = _mm_set1_epi16(0x00ff);
+    __m128i s0 = _mm_add_epi16(_mm_and_si128(row0, kLowBytes), _mm_srli_epi16(row0, 8));
+    __m128i s1 = _mm_add_epi16(_mm_and_si128(row1, kLowBytes), _mm_srli_epi16(row1, 8));
+    return _mm_add_epi16(s0, s1);
+}
+
+// Chroma of 8 blocks from the sums of 2x2 blocks: (kRG*(R,G) + kB*B + bias)>>10
+static inline __m128i CalcChroma8(__m128i sumB, __m128i sumG, __m128i sumR,
+    __m128i kRG, __m128i kB)
+{
+    const __m128i kZero = _mm_setzero_si128();
+    const __m128i kBias = _mm_set1_epi32(YUV_CHROMA_BIAS);
+    __m128i c[2];
+    int i;
+
+    for(i=0; i<2; i++)
+    {
+        __m128i rg = i==0 ? _mm_unpacklo_epi16(sumR, sumG) : _mm_unpackhi_epi16(sumR, sumG);
+        __m128i b0 = i==0 ? _mm_unpacklo_epi16(sumB, kZero) : _mm_unpackhi_epi16(sumB, kZero);
+        __m128i sum = _mm_add_epi32(_mm_madd_epi16(rg, kRG), _mm_madd_epi16(b0, kB));
+        c[i] = _mm_srai_epi32(_mm_add_epi32(sum, kBias), 10);
+    }
+
+    return _mm_packs_epi32(c[0], c[1]);
+}
+
+// Converts 32 pixels of two rows; pY1 is NULL if the second row is not stored.
+static inline void RGB24_To_YV12_Block_SSE2(const unsigned char* pRow0, const unsigned char* pRow1,
+    unsigned char* pY0, unsigned char* pY1, unsigned char* pU, unsigned char* pV)
+{
+    const __m128i kURG = _mm_setr_epi16(YUV_U_R, YUV_U_G, YUV_U_R, YUV_U_G, YUV_U_R, YUV_U_G, YUV_U_R, YUV_U_G);
+    const __m128i kUB = _mm_setr_epi16(YUV_U_B, 0, YUV_U_B, 0, YUV_U_B, 0, YUV_U_B, 0);
+    const __m128i kVRG = _mm_setr_epi16(YUV_V_R, YUV_V_G, YUV_V_R, YUV_V_G, YUV_V_R, YUV_V_G, YUV_V_R, YUV_V_G);
+    const __m128i kVB = _mm_setr_epi16(YUV_V_B, 0, YUV_V_B, 0, YUV_V_B, 0, YUV_V_B, 0);
+    __m128i row0[6];
+    __m128i row1[6];
+
+    // B in [0..1], G in [2..3], R in [4..5]
+    LoadDeinterleave(pRow0, row0);
+    LoadDeinterleave(pRow1, row1);
+
+    _mm_storeu_si128((__m128i*)pY0, CalcY16(row0[0], row0[2], row0[4]));
+    _mm_storeu_si128((__m128i*)(pY0+16), CalcY16(row0[1], row0[3], row0[5]));
+    if(pY1!=NULL)
+    {
+        _mm_storeu_si128((__m128i*)pY1, CalcY16(row1[0], row1[2], row1[4]));
+        _mm_storeu_si128((__m128i*)(pY1+16), CalcY16(row1[1], row1[3], row1[5]));
+    }
+
+    __m128i u[2];
+    __m128i v[2];
+    int i;
+    for(i=0; i<2; i++)
+    {
+        __m128i sumB = SumPairs(row0[i], row1[i]);
+        __m128i sumG = SumPairs(row0[2+i], row1[2+i]);
+        __m128i sumR = SumPairs(row0[4+i], row1[4+i]);
+        u[i] = CalcChroma8(sumB, sumG, sumR, kURG, kUB);
+        v[i] = CalcChroma8(sumB, sumG, sumR, kVRG, kVB);
+    }
+
+    _mm_storeu_si128((__m128i*)pU, _mm_packus_epi16(u[0], u[1]));
+    _mm_storeu_si128((__m128i*)pV, _mm_packus_epi16(v[0], v[1]));
+}
+
+// B, G, R of 8 pixels from C = Y-16, D = U-128 and E = V-128, as 16-bit values.
+static inline void CalcRGB8(__m128i c, __m128i d, __m128i e,
+    __m128i& b, __m128i& g, __m128i& r)
+{
+    const __m128i kB = _mm_setr_epi16(RGB_Y, RGB_B_U, RGB_Y, RGB_B_U, RGB_Y, RGB_B_U, RGB_Y, RGB_B_U);
+    const __m128i kGU = _mm_setr_epi16(RGB_Y, RGB_G_U, RGB_Y, RGB_G_U, RGB_Y, RGB_G_U, RGB_Y, RGB_G_U);
+    const __m128i kGV = _mm_setr_epi16(0, RGB_G_V, 0, RGB_G_V, 0, RGB_G_V, 0, RGB_G_V);
+    const __m128i kR = _mm_setr_epi16(RGB_Y, RGB_R_V, RGB_Y, RGB_R_V, RGB_Y, RGB_R_V, RGB_Y, RGB_R_V);
+    const __m128i kRound = _mm_set1_epi32(128);
+    __m128i b32[2];
+    __m128i g32[2];
+    __m128i r32[2];
+    int i;
+
+    for(i=0; i<2; i++)
+    {
+        __m128i cd = i==0 ? _mm_unpacklo_epi16(c, d) : _mm_unpackhi_epi16(c, d);
+        __m128i ce = i==0 ? _mm_unpacklo_epi16(c, e) : _mm_unpackhi_epi16(c, e);
+
+        b32[i] = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cd, kB), kRound), 8);
+        g32[i] = _mm_add_epi32(_mm_madd_epi16(cd, kGU), _mm_madd_epi16(ce, kGV));
+        g32[i] = _mm_srai_epi32(_mm_add_epi32(g32[i], kRound), 8);
+        r32[i] = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(ce, kR), kRound), 8);
+    }
+
+    b = _mm_packs_epi32(b32[0], b32[1]);
+    g = _mm_packs_epi32(g32[0], g32[1]);
+    r = _mm_packs_epi32(r32[0], r32[1]);
+}
+
+// Converts 16 pixels; the low 8 bytes of u and v hold their chroma.
+static inline void CalcRGB16(__m128i y, __m128i u, __m128i v,
+    __m128i& b, __m128i& g, __m128i& r)
+{
+    const __m128i kZero = _mm_setzero_si128();
+    const __m128i kYOffset = _mm_set1_epi16(16);
+    const __m128i kUVOffset = _mm_set1_epi16(128);
+    __m128i d = _mm_sub_epi16(_mm_unpacklo_epi8(u, kZero), kUVOffset);
+    __m128i e = _mm_sub_epi16(_mm_unpacklo_epi8(v, kZero), kUVOffset);
+    __m128i b16[2];
+    __m128i g16[2];
+    __m128i r16[2];
+    int i;
+
+    for(i=0; i<2; i++)
+    {
+        __m128i c = _mm_sub_epi16(i==0 ? _mm_unpacklo_epi8(y, kZero) : _mm_unpackhi_epi8(y, kZero), kYOffset);
+        // Every chroma sample covers two pixels
+        __m128i d2 = i==0 ? _mm_unpacklo_epi16(d, d) : _mm_unpackhi_epi16(d, d);
+        __m128i e2 = i==0 ? _mm_unpacklo_epi16(e, e) : _mm_unpackhi_epi16(e, e);
+        CalcRGB8(c, d2, e2, b16[i], g16[i], r16[i]);
+    }
+
+    b = _mm_packus_epi16(b16[0], b16[1]);
+    g = _mm_packus_epi16(g16[0], g16[1]);
+    r = _mm_packus_epi16(r16[0], r16[1]);
+}
+
+// Converts 32 pixels of a row
+static inline void YV12_To_RGB24_Block_SSE2(const unsigned char* pY, const unsigned char* pU,
+    const unsigned char* pV, unsigned char* pRGB)
+{
+    __m128i u = _mm_loadu_si128((const __m128i*)pU);
+    __m128i v = _mm_loadu_si128((const __m128i*)pV);
+    __m128i planes[6];
+
+    CalcRGB16(_mm_loadu_si128((const __m128i*)pY), u, v, planes[0], planes[2], planes[4]);
+    CalcRGB16(_mm_loadu_si128((const __m128i*)(pY+16)), _mm_srli_si128(u, 8), _mm_srli_si128(v, 8),
+        planes[1], planes[3], planes[5]);
+
+    InterleaveStore(planes, pRGB);
+}
+
+#endif // YUV_CONVERT_SSE2
+
+bool YuvConvertHasSIMD()
+{
+#ifdef YUV_CONVERT_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+void RGB24_To_YV12(const unsigned char* pRGBData, int nWidth, int nHeight, int nRGBStride,
+    unsigned char* pYPlane, int nYStride,
+    unsigned char* pUPlane, int nUStride,
+    unsigned char* pVPlane, int nVStride,
+    YuvConvertMethod Method)
+{
+    int y;
+    for(y=0; y<nHeight; y+=2)
+    {
+        const unsigned char* pRow0 = pRGBData + y*nRGBStride;
+        unsigned char* pY0 = pYPlane + y*nYStride;
+        unsigned char* pU = pUPlane + y/2*nUStride;
+        unsigned char* pV = pVPlane + y/2*nVStride;
+
+        // The last row of an image of odd height is counted twice
+        const unsigned char* pRow1 = pRow0;
+        unsigned char* pY1 = NULL;
+        if(y+1<nHeight)
+        {
+            pRow1 = pRow0 + nRGBStride;
+            pY1 = pY0 + nYStride;
+        }
+
+        int x = 0;
+
+#ifdef YUV_CONVERT_SSE2
+        if(Method==YUV_CONVERT_AUTO)
+        {
+            for(; x+YUV_SSE2_BLOCK<=nWidth; x+=YUV_SSE2_BLOCK)
+            {
+                RGB24_To_YV12_Block_SSE2(pRow0+x*3, pRow1+x*3, pY0+x,
+                    pY1!=NULL ? pY1+x : NULL, pU+x/2, pV+x/2);
+            }
+        }
+#endif
+
+        RGB24_To_YV12_Rows_Scalar(pRow0, pRow1, x, nWidth, pY0, pY1, pU, pV);
+    }
+}
+
+void YV12_To_RGB24(const unsigned char* pYPlane, int nYStride,
+    const unsigned char* pUPlane, int nUStride,
+    const unsigned char* pVPlane, int nVStride,
+    int nWidth, int nHeight, unsigned char* pRGBData, int nRGBStride,
+    YuvConvertMethod Method)
+{
+    int y;
+    for(y=0; y<nHeight; y++)
+    {
+        const unsigned char* pY = pYPlane + y*nYStride;
+        const unsigned char* pU = pUPlane + y/2*nUStride;
+        const unsigned char* pV = pVPlane + y/2*nVStride;
+        unsigned char* pRGB = pRGBData + y*nRGBStride;
+        int x = 0;
+
+#ifdef YUV_CONVERT_SSE2
+        if(Method==YUV_CONVERT_AUTO)
+        {
+            for(; x+YUV_SSE2_BLOCK<=nWidth; x+=YUV_SSE2_BLOCK)
+                YV12_To_RGB24_Block_SSE2(pY+x, pU+x/2, pV+x/2, pRGB+x*3);
+        }
+#endif
+
+        YV12_To_RGB24_Row_Scalar(pY, pU, pV, x, nWidth, pRGB);
+    }
+}
@@ -0,0 +1,49 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: YuvConvert.h
+// Description: Conversion of video frames between 24-bit DIB pixels and YV12 (planar
+// YUV 4:2:0) images. Integer fixed-point BT.601 arithmetic, with an SSE2 path processing
+// 32 pixels at a time and a scalar path used for the rest of a row and on other targets.
+
+#pragma once
+
+// SSE2 is available on all x64 targets and on x86 targets built with /arch:SSE2
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define YUV_CONVERT_SSE2
+#endif
+
+// Conversion method
+enum YuvConvertMethod
+{
+    YUV_CONVERT_AUTO,    // Use SIMD instructions if available
+    YUV_CONVERT_SCALAR   // Use the scalar code only
+};
+
+// Returns true if SIMD instructions are used by YUV_CONVERT_AUTO conversions.
+bool YuvConvertHasSIMD();
+
+// Converts a 24-bit image (B, G, R byte order, as in DIBs) to YV12 planes.
+// Chroma is the average of every 2x2 block of pixels. Width and height may be odd;
+// U and V planes are then (nWidth+1)/2 by (nHeight+1)/2, and edge pixels are counted
+// twice in the blocks of the last column and row. The source image is not modified.
+void RGB24_To_YV12(const unsigned char* pRGBData, int nWidth, int nHeight, int nRGBStride,
+    unsigned char* pYPlane, int nYStride,
+    unsigned char* pUPlane, int nUStride,
+    unsigned char* pVPlane, int nVStride,
+    YuvConvertMethod Method = YUV_CONVERT_AUTO);
+
+// Converts YV12 planes to a 24-bit image (B, G, R byte order). Every chroma sample
+// covers a 2x2 block of pixels.
+void YV12_To_RGB24(const unsigned char* pYPlane, int nYStride,
+    const unsigned char* pUPlane, int nUStride,
+    const unsigned char* pVPlane, int nVStride,
+    int nWidth, int nHeight, unsigned char* pRGBData, int nRGBStride,
+    YuvConvertMethod Method = YUV_CONVERT_AUTO);
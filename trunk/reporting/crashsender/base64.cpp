@@ -37,6 +37,9 @@ be found in the Authors.txt file in the root of the source tree.
 
 #include "base64.h"
 #include <iostream>
+#include <ctype.h>
+#include <string.h>
+#include <vector>
 
 static const std::string base64_chars = 
              "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
@@ -143,4 +146,159 @@ std::string base64_decode(std::string const& encoded_string) {
   return ret;
 }
 
+// Streaming encoder (CrashRpt addition)
 
+CBase64Encoder::CBase64Encoder(int nLineLength, const char* szLineBreak)
+{
+    m_nQuadsPerLine = nLineLength>0 ? nLineLength/4 : 0;
+    m_sLineBreak = szLineBreak!=NULL ? szLineBreak : "";
+
+    int i;
+    for(i=0; i<4096; i++)
+    {
+        m_aPairs[i*2] = base64_chars[i>>6];
+        m_aPairs[i*2+1] = base64_chars[i&0x3f];
+    }
+
+    Reset();
+}
+
+void CBase64Encoder::Reset()
+{
+    m_nQuadsInLine = 0;
+    m_nPending = 0;
+}
+
+size_t CBase64Encoder::Encode(const unsigned char* pData, size_t uSize, char* pOut)
+{
+    char* p = pOut;
+
+    // Complete the group started by the previous call
+    if(m_nPending!=0)
+    {
+        while(m_nPending<3 && uSize!=0)
+        {
+            m_aPending[m_nPending++] = *pData++;
+            uSize--;
+        }
+
+        if(m_nPending<3)
+            return 0;
+
+        p = EncodeTriples(m_aPending, 1, p);
+        m_nPending = 0;
+    }
+
+    size_t uTriples = uSize/3;
+    p = EncodeTriples(pData, uTriples, p);
+    pData += uTriples*3;
+    uSize -= uTriples*3;
+
+    // Keep the rest
+    while(uSize!=0)
+    {
+        m_aPending[m_nPending++] = *pData++;
+        uSize--;
+    }
+
+    return p-pOut;
+}
+
+size_t CBase64Encoder::Finish(char* pOut)
+{
+    if(m_nPending==0)
+        return 0;
+
+    unsigned int v = m_aPending[0]<<16;
+    if(m_nPending>1)
+        v |= m_aPending[1]<<8;
+
+    pOut[0] = base64_chars[(v>>18)&0x3f];
+    pOut[1] = base64_chars[(v>>12)&0x3f];
+    pOut[2] = m_nPending>1 ? base64_chars[(v>>6)&0x3f] : '=';
+    pOut[3] = '=';
+
+    m_nPending = 0;
+    return 4;
+}
+
+size_t CBase64Encoder::GetMaxOutputSize(size_t uSize) const
+{
+    // Groups for the data and the bytes kept from the previous call
+    size_t uQuads = (uSize+2)/3+1;
+    size_t uSizeOut = uQuads*4;
+    if(m_nQuadsPerLine!=0)
+        uSizeOut += (uQuads/m_nQuadsPerLine+1)*m_sLineBreak.length();
+    return uSizeOut;
+}
+
+bool CBase64Encoder::EncodeFile(FILE* f, PFNBASE64WRITE pfnWrite, void* pParam)
+{
+    std::vector<unsigned char> aIn(BASE64_ENCODE_BLOCK_SIZE);
+    std::vector<char> aOut(GetMaxOutputSize(aIn.size()));
+
+    Reset();
+
+    for(;;)
+    {
+        size_t uRead = fread(&aIn[0], 1, aIn.size(), f);
+        size_t uOut = Encode(&aIn[0], uRead, &aOut[0]);
+
+        if(uRead<aIn.size())
+        {
+            if(ferror(f))
+                return false;
+
+            uOut += Finish(&aOut[uOut]);
+            return uOut==0 || pfnWrite(&aOut[0], uOut, pParam);
+        }
+
+        if(uOut!=0 && !pfnWrite(&aOut[0], uOut, pParam))
+            return false;
+    }
+}
+
+char* CBase64Encoder::EncodeTriples(const unsigned char* pIn, size_t uCount, char* pOut)
+{
+    const char* pPairs = m_aPairs;
+
+    while(uCount!=0)
+    {
+        // Groups that fit in the current line
+        size_t uGroups = uCount;
+        if(m_nQuadsPerLine!=0 && uGroups>(size_t)(m_nQuadsPerLine-m_nQuadsInLine))
+            uGroups = m_nQuadsPerLine-m_nQuadsInLine;
+
+        size_t i;
+        for(i=0; i<uGroups; i++)
+        {
+            unsigned int v = (pIn[0]<<16)|(pIn[1]<<8)|pIn[2];
+            const char* pHi = &pPairs[(v>>12)*2];
+            const char* pLo = &pPairs[(v&0xfff)*2];
+            pOut[0] = pHi[0];
+            pOut[1] = pHi[1];
+            pOut[2] = pLo[0];
+            pOut[3] = pLo[1];
+            pIn += 3;
+            pOut += 4;
+        }
+
+        uCount -= uGroups;
+
+        if(m_nQuadsPerLine!=0)
+        {
+            m_nQuadsInLine += (int)uGroups;
+            if(m_nQuadsInLine==m_nQuadsPerLine)
+                pOut = PutLineBreak(pOut);
+        }
+    }
+
+    return pOut;
+}
+
+char* CBase64Encoder::PutLineBreak(char* pOut)
+{
+    memcpy(pOut, m_sLineBreak.data(), m_sLineBreak.length());
+    m_nQuadsInLine = 0;
+    return pOut+m_sLineBreak.length();
+}
@@ -9,8 +9,63 @@ be found in the Authors.txt file in the root of the source tree.
 ***************************************************************************************/
 #pragma once
 
+#include <stdio.h>
+#include <stddef.h>
 #include <string>
 
 std::string base64_encode(unsigned char const* , unsigned int len, int split_count = 76, const char *split = "\r\n");
 std::string base64_decode(std::string const& s);
 
+// Size of input block CBase64Encoder::EncodeFile() reads at once. It is a multiple
+// of 57 bytes (one 76-character line), so blocks are encoded as whole lines.
+#define BASE64_ENCODE_BLOCK_SIZE (57*1024)
+
+// Receives a portion of encoded data. Returns false to stop encoding.
+typedef bool (*PFNBASE64WRITE)(const char* pData, size_t uSize, void* pParam);
+
+// class CBase64Encoder
+// Streaming BASE-64 encoder. Data may be passed in portions of any size; the output
+// is the same as base64_encode() returns for the whole data. Input is encoded three
+// bytes at a time through a 12-bit lookup table, a line at a time where possible.
+class CBase64Encoder
+{
+public:
+
+    // Line length should be a multiple of 4 (it is rounded down), 0 means no line breaks.
+    CBase64Encoder(int nLineLength = 76, const char* szLineBreak = "\r\n");
+
+    // Starts encoding new data.
+    void Reset();
+
+    // Encodes a portion of data to pOut and returns the number of characters written.
+    // pOut should have room for GetMaxOutputSize(uSize) characters. Up to two bytes
+    // are kept until the next call.
+    size_t Encode(const unsigned char* pData, size_t uSize, char* pOut);
+
+    // Encodes the bytes kept, adds padding and returns the number of characters written.
+    size_t Finish(char* pOut);
+
+    // Returns the maximum number of characters Encode() and Finish() write for uSize bytes.
+    size_t GetMaxOutputSize(size_t uSize) const;
+
+    // Encodes the rest of the opened file, passing the output to pfnWrite in blocks.
+    // Memory used doesn't depend on the file size. Returns false on read error
+    // or if pfnWrite returns false.
+    bool EncodeFile(FILE* f, PFNBASE64WRITE pfnWrite, void* pParam);
+
+private:
+
+    // Encodes whole three-byte groups
+    char* EncodeTriples(const unsigned char* pIn, size_t uCount, char* pOut);
+
+    // Ends the current line
+    char* PutLineBreak(char* pOut);
+
+    int m_nQuadsPerLine;          // Four-character groups in a line (0 = no line breaks)
+    std::string m_sLineBreak;     // Line break
+    int m_nQuadsInLine;           // Groups written to the current line
+    unsigned char m_aPending[3];  // Bytes kept until the next call
+    int m_nPending;               // Number of bytes kept
+    char m_aPairs[4096*2];        // Two characters for every 12-bit value
+};
+
@@ -74,8 +74,9 @@ static unsigned char PADDING[64] = {
 #define H(x, y, z) ((x) ^ (y) ^ (z))
 #define I(x, y, z) ((y) ^ ((x) | (~z)))
 
-/* ROTATE_LEFT rotates x left n bits. */
-#define ROTATE_LEFT(x, n) (((x) << (n)) | ((x) >> (32-(n))))
+/* ROTATE_LEFT rotates x left n bits. Only the low 32 bits are used, because
+   unsigned long int is 64-bit wide on LP64 platforms. */
+#define ROTATE_LEFT(x, n) ((((x) << (n)) | (((x) & 0xffffffffUL) >> (32-(n)))) & 0xffffffffUL)
 //#define ROTATE_LEFT(x, n) (((x) << (n)) | (( (UINT32) x) >> (32-(n))))
 
 /*
@@ -127,8 +128,8 @@ void MD5::MD5Update (MD5_CTX *context, unsigned char *input, unsigned int inputL
     index = (unsigned int)((context->count[0] >> 3) & 0x3F);
 
     /* Update number of bits */
-    if ( (context->count[0] += ((unsigned long int)inputLen << 3))
-        < ((unsigned long int)inputLen << 3))
+    context->count[0] = (context->count[0] + ((unsigned long int)inputLen << 3)) & 0xffffffffUL;
+    if (context->count[0] < (((unsigned long int)inputLen << 3) & 0xffffffffUL))
         context->count[1]++;
 
     context->count[1] += ((unsigned long int)inputLen >> 29);
@@ -0,0 +1,171 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "sha256.h"
+#include <string.h>
+
+// Round constants: first 32 bits of the fractional parts of the cube roots of the first 64 primes
+static const unsigned int K[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define EP0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define EP1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SIG0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define SIG1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+/*
+ * SHA-256 initialization. Begins an SHA-256 operation, writing a new context.
+ */
+void SHA256::SHA256Init (SHA256_CTX *context)
+{
+	context->count[0] = context->count[1] = 0;
+
+	context->state[0] = 0x6a09e667;
+	context->state[1] = 0xbb67ae85;
+	context->state[2] = 0x3c6ef372;
+	context->state[3] = 0xa54ff53a;
+	context->state[4] = 0x510e527f;
+	context->state[5] = 0x9b05688c;
+	context->state[6] = 0x1f83d9ab;
+	context->state[7] = 0x5be0cd19;
+}
+
+/*
+ * SHA-256 block update operation. Continues an SHA-256 message-digest
+ * operation, processing another message block, and updating the context.
+ */
+void SHA256::SHA256Update (SHA256_CTX *context, const unsigned char *input, unsigned int inputLen)
+{
+	unsigned int index = context->count[0] & 0x3F;
+	unsigned int partLen = 64 - index;
+	unsigned int i = 0;
+
+	/* Update number of bytes */
+	context->count[0] += inputLen;
+	if (context->count[0] < inputLen)
+		context->count[1]++;
+
+	/* Transform as many times as possible */
+	if (inputLen >= partLen)
+	{
+		memcpy (&context->buffer[index], input, partLen);
+		SHA256Transform (context->state, context->buffer);
+
+		for (i = partLen; i + 63 < inputLen; i += 64)
+			SHA256Transform (context->state, &input[i]);
+
+		index = 0;
+	}
+
+	/* Buffer remaining input */
+	memcpy (&context->buffer[index], &input[i], inputLen - i);
+}
+
+/*
+ * SHA-256 finalization. Ends an SHA-256 message-digest operation, writing the
+ * message digest and zeroizing the context.
+ */
+void SHA256::SHA256Final (unsigned char digest[32], SHA256_CTX *context)
+{
+	unsigned char bits[8];
+	unsigned char padding[64];
+	unsigned int hi = (context->count[1] << 3) | (context->count[0] >> 29);
+	unsigned int lo = context->count[0] << 3;
+	unsigned int index, padLen;
+	int i;
+
+	/* Save number of bits (big endian) */
+	for (i = 0; i < 4; i++)
+	{
+		bits[i] = (unsigned char)(hi >> (24 - i * 8));
+		bits[i + 4] = (unsigned char)(lo >> (24 - i * 8));
+	}
+
+	/* Pad out to 56 mod 64 */
+	memset (padding, 0, sizeof(padding));
+	padding[0] = 0x80;
+	index = context->count[0] & 0x3f;
+	padLen = (index < 56) ? (56 - index) : (120 - index);
+	SHA256Update (context, padding, padLen);
+
+	/* Append length (before padding) */
+	SHA256Update (context, bits, 8);
+
+	/* Store state in digest (big endian) */
+	for (i = 0; i < 8; i++)
+	{
+		digest[i * 4] = (unsigned char)(context->state[i] >> 24);
+		digest[i * 4 + 1] = (unsigned char)(context->state[i] >> 16);
+		digest[i * 4 + 2] = (unsigned char)(context->state[i] >> 8);
+		digest[i * 4 + 3] = (unsigned char)(context->state[i]);
+	}
+
+	/* Zeroize sensitive information */
+	memset (context, 0, sizeof (*context));
+}
+
+/*
+ * SHA-256 basic transformation. Transforms state based on block.
+ */
+void SHA256::SHA256Transform (unsigned int state[8], const unsigned char block[64])
+{
+	unsigned int a, b, c, d, e, f, g, h, t1, t2, w[64];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = ((unsigned int)block[i * 4] << 24) | ((unsigned int)block[i * 4 + 1] << 16) |
+		       ((unsigned int)block[i * 4 + 2] << 8) | ((unsigned int)block[i * 4 + 3]);
+	for (; i < 64; i++)
+		w[i] = SIG1(w[i - 2]) + w[i - 7] + SIG0(w[i - 15]) + w[i - 16];
+
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
+
+	for (i = 0; i < 64; i++)
+	{
+		t1 = h + EP1(e) + CH(e, f, g) + K[i] + w[i];
+		t2 = EP0(a) + MAJ(a, b, c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
@@ -0,0 +1,46 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: sha256.h
+// Description: SHA-256 message digest (FIPS 180-4). The interface follows the MD5 class.
+
+#ifndef SHA256_H
+#define SHA256_H
+
+/*
+ * SHA-256 context.
+ */
+typedef struct
+{
+	unsigned int state[8];            /* state (A..H) */
+	unsigned int count[2];            /* number of bytes, modulo 2^64 (lsw first) */
+	unsigned char buffer[64];         /* input buffer */
+} SHA256_CTX;
+
+/*
+ * SHA256 class
+ */
+class SHA256
+{
+
+	private:
+
+		void SHA256Transform (unsigned int state[8], const unsigned char block[64]);
+
+	public:
+
+		void SHA256Init (SHA256_CTX*);
+		void SHA256Update (SHA256_CTX*, const unsigned char*, unsigned int);
+		void SHA256Final (unsigned char [32], SHA256_CTX*);
+
+	SHA256(){};
+};
+
+#endif
@@ -317,7 +317,6 @@ int CSmtpClient::SendEmailToRecipient(WTL::CString sSmtpServer, CEmailMessage* m
     const int RESPONSE_BUFF_SIZE = 4096;
     char response[RESPONSE_BUFF_SIZE];
     int res = SOCKET_ERROR;
-    std::string sEncodedFileData;
     bool bESMTP = false;
 
     // Convert port number to string
@@ -633,24 +632,14 @@ int CSmtpClient::SendEmailToRecipient(WTL::CString sSmtpServer, CEmailMessage* m
         if(res!=sMsg.GetLength())
             goto exit;
 
-        // Encode data
-        LPBYTE buf = NULL;
-        //int buf_len = 0;
-        int nEncode=Base64EncodeAttachment(sFileName, sEncodedFileData);
+        // Encode and send data
+        int nEncode=SendAttachmentData(sock, sFileName);
         if(nEncode!=0)
         {
             sStatusMsg.Format(_T("Error BASE64-encoding attachment %s"), sFileName);
             m_scn->SetProgress(sStatusMsg, 1);
             goto exit;
         }
-
-        // Send encoded data
-        sMsg = sEncodedFileData.c_str();        
-        res = SendMsg(sock, sMsg);
-        if(res!=sMsg.GetLength())
-            goto exit;
-
-        delete [] buf;
     }
 
     sMsg =  "\r\n--KkK170891tpbkKk__FV_KKKkkkjjwq--";
@@ -838,51 +827,78 @@ int CSmtpClient::CheckAttachmentOK(WTL::CString sFileName)
     return 0;
 }
 
-int CSmtpClient::Base64EncodeAttachment(WTL::CString sFileName, 
-                                        std::string& sEncodedFileData)
+// Context of SendEncodedBlock() callback
+struct AttachmentSendContext
 {
-  // This method encodes the file into BASE-64 encoding.
-  // It is suitable for small files only, because it reads
-  // entire file contents into memory.
-
-    strconv_t strconv;  
-    int uFileSize = 0;
-    BYTE* uchFileData = NULL;  
-    
-  // Check if file exists.	
-  long lFileSize = Utility::GetFileSize(sFileName);
-    if(lFileSize<0)
-        return 1;  // File not found.
+    CSmtpClient* m_pClient; // SMTP client
+    SOCKET m_sock;          // Socket
+};
 
-    // Allocate buffer of file size
-    uFileSize = (int)lFileSize;
-    uchFileData = new BYTE[uFileSize];
+int CSmtpClient::SendAttachmentData(SOCKET sock, WTL::CString sFileName)
+{
+  // This method encodes the file into BASE-64 encoding and sends it.
+  // The file is read, encoded and sent in blocks, so the memory used
+  // doesn't depend on the file size.
 
-    // Read file data to buffer.
     FILE* f = NULL;
+    CBase64Encoder encoder;
+    AttachmentSendContext ctx;
+
 #if _MSC_VER<1400
     f = _tfopen(sFileName, _T("rb"));
 #else
     _tfopen_s(&f, sFileName, _T("rb"));  
 #endif 
 
-  // Read file data to buffer
-    if(!f || fread(uchFileData, uFileSize, 1, f)!=1)
-    {
-        delete [] uchFileData;
-        uchFileData = NULL;
-        return 2; // Coudln't read file data.
-    }
+    if(f==NULL)
+        return 1;  // File not found.
+
+    ctx.m_pClient = this;
+    ctx.m_sock = sock;
+
+  // Encode file data and send it as it is encoded
+    bool bSent = encoder.EncodeFile(f, SendEncodedBlock, &ctx);
 
   // Close file
     fclose(f);
 
-  // Encode file data.
-    sEncodedFileData = base64_encode(uchFileData, uFileSize);
-
-  // Release buffer
-    delete [] uchFileData;
+    if(!bSent)
+        return 2; // Couldn't read file data or send it.
 
     // OK.
     return 0;
 }
+
+bool CSmtpClient::SendEncodedBlock(const char* pData, size_t uSize, void* pParam)
+{
+    AttachmentSendContext* pCtx = (AttachmentSendContext*)pParam;
+
+    return pCtx->m_pClient->SendData(pCtx->m_sock, pData, (int)uSize)==(int)uSize;
+}
+
+int CSmtpClient::SendData(SOCKET sock, const char* pData, int nSize)
+{
+  // This method sends the data using the specified socket. The data
+  // are sent as is, without conversion.
+
+    int nSent = 0;
+    while(nSent<nSize)
+    {
+      // Check if cancelled
+      if(m_scn->IsCancelled()) 
+        return -1;
+
+      int res = send(sock, pData+nSent, nSize-nSent, 0);
+      if(res==SOCKET_ERROR) 
+      {
+        WTL::CString sMsg;
+        sMsg.Format(_T("Send error: %d"), WSAGetLastError());
+        m_scn->SetProgress(sMsg, 0);    
+        return -1;
+      }
+
+      nSent += res;
+    }
+
+    return nSent;
+}
@@ -134,10 +134,16 @@ protected:
     // Returns zero on success, otherwise non-zero.
     int CheckAttachmentOK(WTL::CString sFileName);
 
-    // Encodes the given file into BASE-64 encoding and returns the file contents as a string.
+    // Encodes the given file into BASE-64 encoding and sends it block by block.
     // Returns zero on success, otherwise non-zero.
-    int Base64EncodeAttachment(WTL::CString sFileName, 
-        std::string& sEncodedFileData);
+    int SendAttachmentData(SOCKET sock, WTL::CString sFileName);
+
+    // Sends a block of encoded attachment data (CBase64Encoder callback).
+    static bool SendEncodedBlock(const char* pData, size_t uSize, void* pParam);
+
+    // Sends raw data to SMTP server.
+    // Returns the number of bytes sent, or -1 on error.
+    int SendData(SOCKET sock, const char* pData, int nSize);
 
     // Converts a string from UTF-16 (UNICODE) to UTF-8 encoding.
     std::string UTF16toUTF8(LPCWSTR utf16);
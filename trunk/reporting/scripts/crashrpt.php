@@ -3,6 +3,9 @@
 // Specify the directory where to save error reports
 $file_root = "/home/username/crash_reports/";
 
+// Specify the directory where to keep partially uploaded error reports
+$chunk_root = $file_root."partial/";
+
 // This is to avoid PHP warning
 date_default_timezone_set('UTC');
 
@@ -26,6 +29,7 @@ function checkOK($field)
 }
 
 $md5_hash = "";    // MD5 hash for error report ZIP
+$sha256_hash = ""; // Optional SHA-256 hash for error report ZIP
 $file_name = "";   // Destination file name                                  
 $crash_guid = "";  // Crash GUID
 
@@ -43,6 +47,17 @@ if(strlen($md5_hash)!=32)
   done(450, "MD5 hash value has wrong length.");
 }
 
+// Get SHA-256 hash (sent if the client was installed with CR_INST_SHA256_DIGEST flag)
+if(isset($_POST['sha256']))
+{
+  $sha256_hash = $_POST['sha256'];
+  checkOK($sha256_hash);
+  if(strlen($sha256_hash)!=64)
+  {
+    done(450, "SHA-256 hash value has wrong length.");
+  }
+}
+
 // Get CrashGUID
 if(!array_key_exists("crashguid", $_POST))
 {
@@ -56,6 +71,98 @@ if(strlen($crash_guid)!=36)
   done(450, "Crash GUID has wrong length.");
 }  
 
+// Chunked upload: large error reports are sent in parts, the client asks 
+// how many bytes are stored and continues from there after a failure
+if(array_key_exists("chunkaction", $_POST))
+{
+  // Get upload ID (crash GUID and MD5 hash)
+  $upload_id = $_POST["uploadid"];
+  if(!preg_match('/^[0-9A-Za-z\-]{1,80}$/', $upload_id))
+  {
+    done(450, "Invalid upload ID.");
+  }
+
+  $total_size = floatval($_POST["totalsize"]);
+  $part_file_name = $chunk_root.$upload_id.".part";
+
+  // Get the number of bytes stored so far
+  clearstatcache();
+  $stored_size = file_exists($part_file_name) ? filesize($part_file_name) : 0;
+
+  $action = $_POST["chunkaction"];
+  if($action=="query")
+  {
+    done(200, "offset=".$stored_size);
+  }
+  else if($action=="chunk")
+  {
+    if(!array_key_exists("chunk", $_FILES) || $_FILES["chunk"]["error"]!=0)
+    {
+      done(450, "Chunk data missing.");
+    }
+
+    $offset = floatval($_POST["offset"]);
+    $chunk_file_name = $_FILES["chunk"]["tmp_name"];
+    $chunk_size = filesize($chunk_file_name);
+    if($offset+$chunk_size>$total_size)
+    {
+      done(450, "Invalid chunk offset.");
+    }
+
+    // A chunk at another offset is ignored, the client continues 
+    // from the offset returned
+    if($offset==$stored_size)
+    {
+      if(!is_dir($chunk_root))
+      {
+        mkdir($chunk_root, 0700, true);
+      }
+
+      if(file_put_contents($part_file_name, file_get_contents($chunk_file_name), FILE_APPEND|LOCK_EX)===false)
+      {
+        done(452, "Couldn't save data to local storage");
+      }
+
+      $stored_size += $chunk_size;
+    }
+
+    done(200, "offset=".$stored_size);
+  }
+  else if($action=="commit")
+  {
+    if($stored_size!=$total_size)
+    {
+      done(450, "Upload is incomplete.");
+    }
+
+    // Check that the assembled file has correct MD5 hash
+    $my_md5_hash = strtolower(md5_file($part_file_name));
+    $their_md5_hash = strtolower($md5_hash);
+    if($my_md5_hash!=$their_md5_hash)
+    {
+      unlink($part_file_name);
+      done(451, "MD5 hash is invalid (yours is ".$their_md5_hash.", but mine is ".$my_md5_hash.")");
+    }
+
+    if($sha256_hash!="" && strtolower(hash_file("sha256", $part_file_name))!=strtolower($sha256_hash))
+    {
+      unlink($part_file_name);
+      done(451, "SHA-256 hash is invalid.");
+    }
+
+    // Use crash GUID as file name
+    $file_name = $file_root.$crash_guid.".zip";
+    if(!rename($part_file_name, $file_name))
+    {
+      done(452, "Couldn't save data to local storage"); 
+    }
+
+    done(200, "Success.");
+  }
+
+  done(450, "Invalid chunk action.");
+}
+
 // Get file attachment
 if(array_key_exists("crashrpt", $_FILES))
 {
@@ -78,6 +185,11 @@ if(array_key_exists("crashrpt", $_FILES))
     done(451, "MD5 hash is invalid (yours is ".$their_md5_hash.", but mine is ".$my_md5_hash.")");
   }
 
+  if($sha256_hash!="" && strtolower(hash_file("sha256", $tmp_file_name))!=strtolower($sha256_hash))
+  {
+    done(451, "SHA-256 hash is invalid.");
+  }
+
   // Use crash GUID as file name
   $file_name = $file_root.$crash_guid.".zip";
 
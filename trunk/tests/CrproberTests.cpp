@@ -23,6 +23,8 @@ class CrproberTests : public CTestSuite
 		REGISTER_TEST(Test_output)
         REGISTER_TEST(Test_extract_file)
 		REGISTER_TEST(Test_get)
+        REGISTER_TEST(Test_batch)
+        REGISTER_TEST(Test_export)
     END_TEST_MAP()
 
 public:
@@ -34,6 +36,8 @@ public:
     void Test_output();
     void Test_extract_file();
 	void Test_get();
+    void Test_batch();
+    void Test_export();
 
     CString m_sTmpFolder;
     CString m_sErrorReportName;
@@ -228,4 +232,117 @@ void CrproberTests::Test_get()
 	TEST_ASSERT(sOut==L"My& app Name &");
 
 	__TEST_CLEANUP__;
+}
+
+void CrproberTests::Test_batch()
+{
+    // This test calls crprober.exe with /batch flag to process all ZIP files
+    // in the temp folder and checks that properties are written to the output dir
+
+    CString sExeName;
+    CString sParams;
+    CString sOutFolder;
+    CString sOutFile;
+    int nRetCode = -1;
+    FILE* f = NULL;
+    TCHAR szLine[256] = _T("");
+    CString sLine;
+
+#ifdef _DEBUG
+    sExeName = Utility::GetModulePath(NULL)+_T("\\crproberd.exe");
+#else
+    sExeName = Utility::GetModulePath(NULL)+_T("\\crprober.exe");
+#endif
+
+    sOutFolder = m_sTmpFolder+_T("\\batch_out");
+    BOOL bCreate = Utility::CreateFolder(sOutFolder);
+    TEST_ASSERT(bCreate);
+
+    sParams.Format(_T("/batch \"%s\" /o \"%s\" /threads 2 /get XmlDescMisc AppName 0 /get MdmpModules RowCount 0"), 
+        m_sTmpFolder, sOutFolder);
+
+    // Run - assume zero ret code
+    nRetCode = TestUtils::RunProgram(sExeName, sParams);
+    TEST_ASSERT(nRetCode==0);
+
+    // The output file is named after the report file
+    sOutFile = sOutFolder+_T("\\")+Utility::GetFileName(m_sErrorReportName)+_T(".txt");
+#if _MSC_VER<1400
+    f = _tfopen(sOutFile, _T("rt"));
+#else
+    _tfopen_s(&f, sOutFile, _T("rt"));
+#endif
+    TEST_ASSERT(f!=NULL);
+
+    // The first line must contain the application name
+    TEST_ASSERT(_fgetts(szLine, 256, f)!=NULL);
+    sLine = szLine;
+    sLine.TrimRight(_T("\n"));
+    TEST_ASSERT(sLine==_T("My& app Name &"));
+
+    // The second line must contain the module count
+    TEST_ASSERT(_fgetts(szLine, 256, f)!=NULL);
+    TEST_ASSERT(_ttoi(szLine)>0);
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
+
+void CrproberTests::Test_export()
+{
+    // This test calls crprober.exe with /export flag to write the module table
+    // of the report to a CSV file and checks the file content
+
+    CString sExeName;
+    CString sParams;
+    CString sOutFile;
+    int nRetCode = -1;
+    FILE* f = NULL;
+    char szLine[1024] = "";
+    int nRows = 0;
+
+#ifdef _DEBUG
+    sExeName = Utility::GetModulePath(NULL)+_T("\\crproberd.exe");
+#else
+    sExeName = Utility::GetModulePath(NULL)+_T("\\crprober.exe");
+#endif
+
+    sOutFile = m_sTmpFolder+_T("\\modules.csv");
+    sParams.Format(_T("/f \"%s\" /export csv \"%s\" /table MdmpModules"), 
+        m_sErrorReportName, sOutFile);
+
+    // Run - assume zero ret code
+    nRetCode = TestUtils::RunProgram(sExeName, sParams);
+    TEST_ASSERT(nRetCode==0);
+
+    // CSV is required to have a table specified - assume invalid argument
+    sParams.Format(_T("/f \"%s\" /export csv \"%s\""), m_sErrorReportName, sOutFile);
+    nRetCode = TestUtils::RunProgram(sExeName, sParams);
+    TEST_ASSERT(nRetCode==2);
+
+#if _MSC_VER<1400
+    f = _tfopen(sOutFile, _T("rb"));
+#else
+    _tfopen_s(&f, sOutFile, _T("rb"));
+#endif
+    TEST_ASSERT(f!=NULL);
+
+    // The first line contains column names
+    TEST_ASSERT(fgets(szLine, 1024, f)!=NULL);
+    TEST_ASSERT(strncmp(szLine, "Report,Table,Row,ModuleName,", 28)==0);
+
+    // One line per module
+    while(fgets(szLine, 1024, f)!=NULL)
+    {
+        TEST_ASSERT(strstr(szLine, ",MdmpModules,")!=NULL);
+        nRows++;
+    }
+    TEST_ASSERT(nRows>0);
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
 }
\ No newline at end of file
@@ -0,0 +1,223 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "base64.h"
+#include <string.h>
+#include <vector>
+
+class Base64Tests : public CTestSuite
+{
+    BEGIN_TEST_MAP(Base64Tests, "CBase64Encoder class tests")
+        REGISTER_TEST(Test_Encode)
+        REGISTER_TEST(Test_Portions)
+        REGISTER_TEST(Test_EncodeFile)
+        REGISTER_TEST(Test_Benchmark_Encode)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_Encode();
+    void Test_Portions();
+    void Test_EncodeFile();
+    void Test_Benchmark_Encode();
+
+private:
+
+    // Makes pseudo-random data
+    static void MakeData(std::vector<unsigned char>& aData, size_t uSize);
+
+    // Encodes the data in one call
+    static std::string Encode(CBase64Encoder& encoder, const unsigned char* pData, size_t uSize);
+
+    // Output callback appending to a string
+    static bool AppendOutput(const char* pData, size_t uSize, void* pParam);
+};
+
+REGISTER_TEST_SUITE( Base64Tests );
+
+void Base64Tests::SetUp()
+{
+}
+
+void Base64Tests::TearDown()
+{
+}
+
+void Base64Tests::MakeData(std::vector<unsigned char>& aData, size_t uSize)
+{
+    uint32_t uSeed = 4321;
+    size_t i;
+
+    aData.resize(uSize);
+    for(i=0; i<uSize; i++)
+    {
+        uSeed = uSeed*1103515245+12345;
+        aData[i] = (unsigned char)(uSeed>>16);
+    }
+}
+
+std::string Base64Tests::Encode(CBase64Encoder& encoder, const unsigned char* pData, size_t uSize)
+{
+    std::vector<char> aOut(encoder.GetMaxOutputSize(uSize));
+
+    encoder.Reset();
+    size_t uOut = encoder.Encode(pData, uSize, &aOut[0]);
+    uOut += encoder.Finish(&aOut[uOut]);
+    return std::string(&aOut[0], uOut);
+}
+
+bool Base64Tests::AppendOutput(const char* pData, size_t uSize, void* pParam)
+{
+    std::string* psOut = (std::string*)pParam;
+    psOut->append(pData, uSize);
+    return true;
+}
+
+void Base64Tests::Test_Encode()
+{
+    CBase64Encoder encoder;
+    CBase64Encoder nobreaks(0);
+    std::vector<unsigned char> aData;
+    size_t uSize;
+
+    // Test vectors of RFC 4648
+    TEST_ASSERT(Encode(encoder, (const unsigned char*)"", 0)=="");
+    TEST_ASSERT(Encode(encoder, (const unsigned char*)"f", 1)=="Zg==");
+    TEST_ASSERT(Encode(encoder, (const unsigned char*)"fo", 2)=="Zm8=");
+    TEST_ASSERT(Encode(encoder, (const unsigned char*)"foo", 3)=="Zm9v");
+    TEST_ASSERT(Encode(encoder, (const unsigned char*)"foob", 4)=="Zm9vYg==");
+    TEST_ASSERT(Encode(encoder, (const unsigned char*)"fooba", 5)=="Zm9vYmE=");
+    TEST_ASSERT(Encode(encoder, (const unsigned char*)"foobar", 6)=="Zm9vYmFy");
+
+    // The output is the same as of the scalar encoder, including line breaks
+    // around line boundaries
+    MakeData(aData, 1000);
+    for(uSize=1; uSize<=aData.size(); uSize+=(uSize<200 ? 1 : 37))
+    {
+        TEST_ASSERT(Encode(encoder, &aData[0], uSize)==base64_encode(&aData[0], (unsigned int)uSize));
+        TEST_ASSERT(Encode(nobreaks, &aData[0], uSize)==base64_encode(&aData[0], (unsigned int)uSize, 0));
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void Base64Tests::Test_Portions()
+{
+    CBase64Encoder encoder;
+    std::vector<unsigned char> aData;
+    std::string sOut;
+
+    MakeData(aData, 10000);
+    std::string sExpected = base64_encode(&aData[0], (unsigned int)aData.size());
+
+    // Portions of sizes not multiple of 3 leave bytes for the next call
+    std::vector<char> aOut(encoder.GetMaxOutputSize(1000));
+    size_t uOffset = 0;
+    size_t uPortion = 1;
+    while(uOffset<aData.size())
+    {
+        size_t uSize = uPortion<aData.size()-uOffset ? uPortion : aData.size()-uOffset;
+        size_t uOut = encoder.Encode(&aData[uOffset], uSize, &aOut[0]);
+        TEST_ASSERT(uOut<=aOut.size());
+        sOut.append(&aOut[0], uOut);
+        uOffset += uSize;
+        uPortion = uPortion*7%997+1;
+    }
+    sOut.append(&aOut[0], encoder.Finish(&aOut[0]));
+
+    TEST_ASSERT(sOut==sExpected);
+
+    __TEST_CLEANUP__;
+}
+
+void Base64Tests::Test_EncodeFile()
+{
+    CBase64Encoder encoder;
+    std::vector<unsigned char> aData;
+    std::string sOut;
+    FILE* f = NULL;
+
+    // Several blocks and a partial one
+    MakeData(aData, 3*BASE64_ENCODE_BLOCK_SIZE+1001);
+
+    f = tmpfile();
+    TEST_ASSERT(f!=NULL);
+    TEST_ASSERT(fwrite(&aData[0], 1, aData.size(), f)==aData.size());
+    rewind(f);
+
+    TEST_ASSERT(encoder.EncodeFile(f, AppendOutput, &sOut));
+    TEST_ASSERT(sOut==base64_encode(&aData[0], (unsigned int)aData.size()));
+
+    // An empty file
+    sOut.clear();
+    TEST_ASSERT(encoder.EncodeFile(f, AppendOutput, &sOut));
+    TEST_ASSERT(sOut.empty());
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
+
+void Base64Tests::Test_Benchmark_Encode()
+{
+    // Encodes a 64 MB attachment as CSmtpClient used to (the whole file in memory and
+    // base64_encode() building a string), then streaming it in blocks.
+
+    const size_t FILE_SIZE = 64*1024*1024;
+    CBase64Encoder encoder;
+    std::vector<unsigned char> aData;
+    std::vector<unsigned char> aIn(BASE64_ENCODE_BLOCK_SIZE);
+    std::vector<char> aOut(encoder.GetMaxOutputSize(aIn.size()));
+    CPerfTimer timer;
+    double dScalarMs = 0;
+    double dStreamMs = 0;
+    size_t uScalarSize = 0;
+    size_t uStreamSize = 0;
+    size_t uOffset = 0;
+
+    MakeData(aData, FILE_SIZE);
+
+    timer.Start();
+    {
+        std::string sEncoded = base64_encode(&aData[0], (unsigned int)aData.size());
+        uScalarSize = sEncoded.size();
+    }
+    dScalarMs = timer.GetElapsedMs();
+
+    timer.Start();
+    encoder.Reset();
+    while(uOffset<aData.size())
+    {
+        // Stands for fread() into the block buffer
+        size_t uSize = aIn.size()<aData.size()-uOffset ? aIn.size() : aData.size()-uOffset;
+        memcpy(&aIn[0], &aData[uOffset], uSize);
+        uStreamSize += encoder.Encode(&aIn[0], uSize, &aOut[0]);
+        uOffset += uSize;
+    }
+    uStreamSize += encoder.Finish(&aOut[0]);
+    dStreamMs = timer.GetElapsedMs();
+
+    TEST_ASSERT(uStreamSize==uScalarSize);
+
+    printf("\n   %u MB: scalar %.0f ms (%.0f MB/s, %u MB buffered), streaming %.0f ms (%.0f MB/s, %u KB buffered)\n   ",
+        (unsigned)(FILE_SIZE/(1024*1024)),
+        dScalarMs, FILE_SIZE/1048576.0/(dScalarMs/1000),
+        (unsigned)((FILE_SIZE+uScalarSize)/(1024*1024)),
+        dStreamMs, FILE_SIZE/1048576.0/(dStreamMs/1000),
+        (unsigned)((aIn.size()+aOut.size())/1024));
+
+    __TEST_CLEANUP__;
+}
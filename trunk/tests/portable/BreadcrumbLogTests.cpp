@@ -0,0 +1,358 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "BreadcrumbLog.h"
+#include "ThreadSync.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+class BreadcrumbLogTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(BreadcrumbLogTests, "CBreadcrumbLog class tests")
+        REGISTER_TEST(Test_AddAndRead)
+        REGISTER_TEST(Test_Overwrite)
+        REGISTER_TEST(Test_Truncate)
+        REGISTER_TEST(Test_Rings)
+        REGISTER_TEST(Test_FormatTime)
+        REGISTER_TEST(Test_ConcurrentRead)
+        REGISTER_TEST(Test_Benchmark_Add)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_AddAndRead();
+    void Test_Overwrite();
+    void Test_Truncate();
+    void Test_Rings();
+    void Test_FormatTime();
+    void Test_ConcurrentRead();
+    void Test_Benchmark_Add();
+
+private:
+
+    // Adds a breadcrumb given as C strings
+    static int AddCrumb(CBreadcrumbLog& log, int nRing, const char* szCategory, const char* szMessage);
+
+    // Adds breadcrumbs to its own ring
+    static void WriterThread(void* pParam);
+
+    // State shared with a writer thread
+    struct WriterState
+    {
+        CBreadcrumbLog* m_pLog;  // Log
+        uint32_t m_uThreadId;    // Thread ID to take a ring for
+        int m_nCount;            // Number of breadcrumbs to add
+        const char* m_szMessage; // Message to add, or NULL to add numbered messages
+        int m_nRing;             // Ring taken, or -1
+        double m_dMs;            // Time spent adding
+        volatile bool m_bDone;   // Set when the writer has finished
+    };
+
+    std::vector<char> m_aMem; // Memory of the log
+};
+
+REGISTER_TEST_SUITE( BreadcrumbLogTests );
+
+void BreadcrumbLogTests::SetUp()
+{
+    m_aMem.assign(CBreadcrumbLog::GetRequiredSize(), (char)0xCC);
+}
+
+void BreadcrumbLogTests::TearDown()
+{
+    m_aMem.clear();
+}
+
+int BreadcrumbLogTests::AddCrumb(CBreadcrumbLog& log, int nRing, const char* szCategory, const char* szMessage)
+{
+    return log.Add(nRing, 0, szCategory, strlen(szCategory), szMessage, strlen(szMessage));
+}
+
+void BreadcrumbLogTests::WriterThread(void* pParam)
+{
+    WriterState* pState = (WriterState*)pParam;
+    CPerfTimer timer;
+    char szMessage[32];
+    int i;
+
+    pState->m_nRing = pState->m_pLog->AcquireRing(pState->m_uThreadId);
+    if(pState->m_nRing>=0)
+    {
+        timer.Start();
+        for(i=0; i<pState->m_nCount; i++)
+        {
+            if(pState->m_szMessage!=NULL)
+            {
+                pState->m_pLog->Add(pState->m_nRing, 0, "net", 3, pState->m_szMessage, strlen(pState->m_szMessage));
+                continue;
+            }
+
+            // The message repeats the number, so a torn record can be detected
+            int nLen = sprintf(szMessage, "%d:%d", i, i);
+            pState->m_pLog->Add(pState->m_nRing, 0, "net", 3, szMessage, nLen);
+        }
+        pState->m_dMs = timer.GetElapsedMs();
+    }
+
+    pState->m_bDone = true;
+}
+
+void BreadcrumbLogTests::Test_AddAndRead()
+{
+    // Breadcrumbs of different threads are merged by time
+
+    CBreadcrumbLog log;
+    CBreadcrumbLog reader;
+    std::vector<BreadcrumbItem> aItems;
+    const wchar_t szWide[] = L"Opened";
+    uint16_t auchCategory[2] = {'u', 'i'};
+    uint16_t auchMessage[6];
+    int nRing1 = -1;
+    int nRing2 = -1;
+    int i;
+
+    TEST_ASSERT(!log.IsAttached());
+    TEST_ASSERT(log.AcquireRing(1)==-1);
+    TEST_ASSERT(AddCrumb(log, 0, "a", "b")==BREADCRUMB_ERR_NOT_ATTACHED);
+
+    log.Init(&m_aMem[0]);
+    log.ReadAll(aItems);
+    TEST_ASSERT(aItems.empty());
+
+    nRing1 = log.AcquireRing(100);
+    nRing2 = log.AcquireRing(200);
+    TEST_ASSERT(nRing1>=0 && nRing2>=0 && nRing1!=nRing2);
+
+    TEST_ASSERT(AddCrumb(log, nRing2, "app", "Started")==BREADCRUMB_OK);
+    CSyncThread::Sleep(2);
+    TEST_ASSERT(AddCrumb(log, nRing1, "net", "Connecting")==BREADCRUMB_OK);
+    CSyncThread::Sleep(2);
+    TEST_ASSERT(AddCrumb(log, nRing2, "", "")==BREADCRUMB_OK);
+    CSyncThread::Sleep(2);
+    for(i=0; i<6; i++)
+        auchMessage[i] = (uint16_t)szWide[i];
+    TEST_ASSERT(log.Add(nRing1, BREADCRUMB_FLAG_WIDE, auchCategory, 4, auchMessage, 12)==BREADCRUMB_OK);
+
+    // The reader attaches to the memory, as CrashSender does
+    TEST_ASSERT(reader.Attach(&m_aMem[0], m_aMem.size()));
+    reader.ReadAll(aItems);
+    TEST_ASSERT(aItems.size()==4);
+    TEST_ASSERT(aItems[0].m_uThreadId==200 && aItems[0].m_sCategory=="app" && aItems[0].m_sMessage=="Started");
+    TEST_ASSERT(aItems[1].m_uThreadId==100 && aItems[1].m_sCategory=="net" && aItems[1].m_sMessage=="Connecting");
+    TEST_ASSERT(aItems[2].m_uThreadId==200 && aItems[2].m_sCategory.empty() && aItems[2].m_sMessage.empty());
+    TEST_ASSERT(aItems[3].m_uFlags==BREADCRUMB_FLAG_WIDE && aItems[3].m_sCategory.size()==4 &&
+        memcmp(aItems[3].m_sMessage.data(), auchMessage, 12)==0);
+    for(i=1; i<4; i++)
+        TEST_ASSERT(aItems[i-1].m_uTime<aItems[i].m_uTime);
+
+    // Not a log
+    TEST_ASSERT(!reader.Attach(&m_aMem[0], m_aMem.size()-1));
+    memcpy(&m_aMem[0], "XXXX", 4);
+    TEST_ASSERT(!reader.Attach(&m_aMem[0], m_aMem.size()));
+
+    __TEST_CLEANUP__;
+}
+
+void BreadcrumbLogTests::Test_Overwrite()
+{
+    // A full ring keeps the newest breadcrumbs
+
+    CBreadcrumbLog log;
+    std::vector<BreadcrumbItem> aItems;
+    char szMessage[32];
+    int nRing = -1;
+    int i;
+
+    log.Init(&m_aMem[0]);
+    nRing = log.AcquireRing(1);
+    TEST_ASSERT(nRing>=0);
+
+    for(i=0; i<BREADCRUMB_RING_SIZE*2+10; i++)
+    {
+        sprintf(szMessage, "%d", i);
+        TEST_ASSERT(AddCrumb(log, nRing, "c", szMessage)==BREADCRUMB_OK);
+    }
+
+    log.ReadAll(aItems);
+    TEST_ASSERT(aItems.size()==BREADCRUMB_RING_SIZE);
+    for(i=0; i<BREADCRUMB_RING_SIZE; i++)
+    {
+        sprintf(szMessage, "%d", BREADCRUMB_RING_SIZE+10+i);
+        TEST_ASSERT(aItems[i].m_sMessage==szMessage);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void BreadcrumbLogTests::Test_Truncate()
+{
+    // Text that doesn't fit into a record is truncated
+
+    CBreadcrumbLog log;
+    std::vector<BreadcrumbItem> aItems;
+    std::string sLong(1000, 'x');
+    int nRing = -1;
+
+    log.Init(&m_aMem[0]);
+    nRing = log.AcquireRing(1);
+
+    TEST_ASSERT(AddCrumb(log, nRing, sLong.c_str(), sLong.c_str())==BREADCRUMB_OK);
+    TEST_ASSERT(AddCrumb(log, nRing, "short", sLong.c_str())==BREADCRUMB_OK);
+    // Odd sizes of UTF-16 text are rounded down to whole characters
+    TEST_ASSERT(log.Add(nRing, BREADCRUMB_FLAG_WIDE, sLong.data(), 5, sLong.data(), 999)==BREADCRUMB_OK);
+
+    log.ReadAll(aItems);
+    TEST_ASSERT(aItems.size()==3);
+    TEST_ASSERT(aItems[0].m_sCategory.size()==BREADCRUMB_MAX_CATEGORY_SIZE);
+    TEST_ASSERT(aItems[0].m_sMessage.size()==BREADCRUMB_MAX_TEXT_SIZE-BREADCRUMB_MAX_CATEGORY_SIZE);
+    TEST_ASSERT(aItems[1].m_sCategory=="short");
+    TEST_ASSERT(aItems[1].m_sMessage.size()==BREADCRUMB_MAX_TEXT_SIZE-5);
+    TEST_ASSERT(aItems[2].m_sCategory.size()==4);
+    TEST_ASSERT(aItems[2].m_sMessage.size()==BREADCRUMB_MAX_TEXT_SIZE-6);
+
+    __TEST_CLEANUP__;
+}
+
+void BreadcrumbLogTests::Test_Rings()
+{
+    // Rings are owned by one thread; released rings keep their records
+
+    CBreadcrumbLog log;
+    std::vector<BreadcrumbItem> aItems;
+    int nRing = -1;
+    int i;
+
+    log.Init(&m_aMem[0]);
+    for(i=0; i<BREADCRUMB_RING_COUNT; i++)
+        TEST_ASSERT(log.AcquireRing(1000+i)==i);
+    TEST_ASSERT(log.AcquireRing(5000)==-1);
+
+    TEST_ASSERT(AddCrumb(log, 7, "c", "before release")==BREADCRUMB_OK);
+    log.ReleaseRing(7);
+    nRing = log.AcquireRing(5000);
+    TEST_ASSERT(nRing==7);
+    TEST_ASSERT(AddCrumb(log, nRing, "c", "after release")==BREADCRUMB_OK);
+
+    log.ReadAll(aItems);
+    TEST_ASSERT(aItems.size()==2);
+    TEST_ASSERT(aItems[0].m_uThreadId==1007 && aItems[0].m_sMessage=="before release");
+    TEST_ASSERT(aItems[1].m_uThreadId==5000 && aItems[1].m_sMessage=="after release");
+
+    __TEST_CLEANUP__;
+}
+
+void BreadcrumbLogTests::Test_FormatTime()
+{
+    TEST_ASSERT(CBreadcrumbLog::FormatTime(0)=="1970-01-01T00:00:00.000Z");
+    TEST_ASSERT(CBreadcrumbLog::FormatTime(1368606109123456ULL)=="2013-05-15T08:21:49.123Z");
+    TEST_ASSERT(CBreadcrumbLog::FormatTime(951868799999000ULL)=="2000-02-29T23:59:59.999Z");
+    TEST_ASSERT(CBreadcrumbLog::FormatTime(4107542400000000ULL)=="2100-03-01T00:00:00.000Z");
+
+    __TEST_CLEANUP__;
+}
+
+void BreadcrumbLogTests::Test_ConcurrentRead()
+{
+    // The reader never sees a record being written
+
+    CBreadcrumbLog log;
+    CSyncThread writer;
+    WriterState state;
+    std::vector<BreadcrumbItem> aItems;
+    int nReads = 0;
+    int nBad = 0;
+
+    log.Init(&m_aMem[0]);
+
+    state.m_pLog = &log;
+    state.m_uThreadId = 1;
+    state.m_nCount = 500000;
+    state.m_szMessage = NULL;
+    state.m_nRing = -1;
+    state.m_dMs = 0;
+    state.m_bDone = false;
+    TEST_ASSERT(writer.Start(WriterThread, &state));
+
+    do
+    {
+        log.ReadAll(aItems);
+        nReads++;
+
+        size_t i;
+        for(i=0; i<aItems.size(); i++)
+        {
+            int nFirst = -1;
+            int nSecond = -2;
+            if(aItems[i].m_sCategory!="net" ||
+                sscanf(aItems[i].m_sMessage.c_str(), "%d:%d", &nFirst, &nSecond)!=2 || nFirst!=nSecond)
+                nBad++;
+            if(i>0 && aItems[i].m_uTime<aItems[i-1].m_uTime)
+                nBad++;
+        }
+    }
+    while(!state.m_bDone);
+    writer.Join();
+
+    TEST_ASSERT(state.m_nRing>=0);
+    TEST_ASSERT(nBad==0);
+    TEST_ASSERT(nReads>0);
+
+    __TEST_CLEANUP__;
+}
+
+void BreadcrumbLogTests::Test_Benchmark_Add()
+{
+    // Cost of adding a breadcrumb on one thread and on four threads at once
+
+    const int COUNT = 1000000;
+    CBreadcrumbLog log;
+    CSyncThread aWriters[4];
+    WriterState aStates[4];
+    CPerfTimer timer;
+    int i;
+
+    log.Init(&m_aMem[0]);
+
+    for(i=0; i<4; i++)
+    {
+        aStates[i].m_pLog = &log;
+        aStates[i].m_uThreadId = 100+i;
+        aStates[i].m_nCount = COUNT;
+        aStates[i].m_szMessage = "GET /api/items?page=2 200";
+        aStates[i].m_nRing = -1;
+        aStates[i].m_dMs = 0;
+        aStates[i].m_bDone = false;
+    }
+
+    WriterThread(&aStates[0]);
+    TEST_ASSERT(aStates[0].m_nRing>=0);
+    log.ReleaseRing(aStates[0].m_nRing);
+    printf("\n   1 thread: %.1f ns per breadcrumb", aStates[0].m_dMs*1000000.0/COUNT);
+
+    aStates[0].m_bDone = false;
+    timer.Start();
+    for(i=0; i<4; i++)
+        TEST_ASSERT(aWriters[i].Start(WriterThread, &aStates[i]));
+    for(i=0; i<4; i++)
+    {
+        aWriters[i].Join();
+        TEST_ASSERT(aStates[i].m_nRing>=0);
+    }
+    printf("\n   4 threads: %.1f ns per breadcrumb (all threads)\n   ", timer.GetElapsedMs()*1000000.0/(4*COUNT));
+
+    __TEST_CLEANUP__;
+}
@@ -0,0 +1,241 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: ChunkedUploadServer.h
+// Description: In-process stand-in for the crash report server (reporting/scripts/crashrpt.php)
+// implementing its chunked upload protocol, plus a simulated network that can drop
+// connections. Used as a test fixture for CChunkedUpload.
+
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include "ChunkedUpload.h"
+#include "md5.h"
+
+// class CChunkedUploadServer
+// Keeps the number of bytes stored and a running MD5 hash for each upload, as the
+// script keeps a partial file per upload ID.
+class CChunkedUploadServer
+{
+public:
+
+    CChunkedUploadServer()
+    {
+        m_bLegacy = false;
+        m_bStall = false;
+        m_bRewind = false;
+    }
+
+    // Handles a request. sMD5Hash is the 'md5' field of the request.
+    void Handle(const ChunkRequest& Request, const std::string& sMD5Hash, ChunkResponse& Response)
+    {
+        char szBody[128];
+
+        Response.m_nHttpStatus = 200;
+
+        if(m_bLegacy)
+        {
+            // The old script has no chunk support and looks for the attachment only
+            Done(Response, 452, "File attachment missing");
+            return;
+        }
+
+        PartialUpload& Upload = m_Uploads[Request.m_sUploadId];
+
+        if(strcmp(Request.m_szAction, "query")==0)
+        {
+            sprintf(szBody, "200 offset=%llu", (unsigned long long)Upload.m_uStored);
+            Response.m_sBody = szBody;
+        }
+        else if(strcmp(Request.m_szAction, "chunk")==0)
+        {
+            if(Request.m_uOffset+Request.m_uDataSize>Request.m_uTotalSize)
+            {
+                Done(Response, 450, "Invalid chunk offset.");
+                return;
+            }
+
+            // A chunk at another offset is ignored, the client continues from
+            // the offset returned
+            if(Request.m_uOffset==Upload.m_uStored && !m_bStall)
+            {
+                Upload.m_md5.MD5Update(&Upload.m_md5Ctx,
+                    (unsigned char*)Request.m_pData, (unsigned int)Request.m_uDataSize);
+                Upload.m_uStored += Request.m_uDataSize;
+            }
+
+            sprintf(szBody, "200 offset=%llu", (unsigned long long)Upload.m_uStored);
+            Response.m_sBody = szBody;
+
+            if(m_bRewind)
+            {
+                // Lose the stored data, the next response goes back to zero
+                Upload = PartialUpload();
+            }
+        }
+        else if(strcmp(Request.m_szAction, "commit")==0)
+        {
+            if(Upload.m_uStored!=Request.m_uTotalSize)
+            {
+                Done(Response, 450, "Upload is incomplete.");
+                return;
+            }
+
+            std::string sMyHash = Upload.GetHash();
+            m_Uploads.erase(Request.m_sUploadId);
+
+            if(sMyHash!=sMD5Hash)
+            {
+                Done(Response, 451, "MD5 hash is invalid.");
+                return;
+            }
+
+            m_Committed[Request.m_sUploadId] = sMyHash;
+            Done(Response, 200, "Success.");
+        }
+        else
+        {
+            Done(Response, 450, "Invalid chunk action.");
+        }
+    }
+
+    // Returns the number of bytes stored for the upload
+    uint64_t GetStoredSize(const std::string& sUploadId)
+    {
+        std::map<std::string, PartialUpload>::iterator it = m_Uploads.find(sUploadId);
+        if(it==m_Uploads.end())
+            return 0;
+        return it->second.m_uStored;
+    }
+
+    // Returns true if the upload was committed with the given hash
+    bool IsCommitted(const std::string& sUploadId, const std::string& sMD5Hash)
+    {
+        std::map<std::string, std::string>::iterator it = m_Committed.find(sUploadId);
+        return it!=m_Committed.end() && it->second==sMD5Hash;
+    }
+
+    bool m_bLegacy; // Behave as the script without chunked upload support
+    bool m_bStall;  // Answer chunks without storing them
+    bool m_bRewind; // Lose the stored data after answering each chunk
+
+private:
+
+    // Partial file of an upload
+    struct PartialUpload
+    {
+        PartialUpload()
+        {
+            m_uStored = 0;
+            m_md5.MD5Init(&m_md5Ctx);
+        }
+
+        std::string GetHash()
+        {
+            MD5_CTX ctx = m_md5Ctx;
+            unsigned char md5_hash[16];
+            m_md5.MD5Final(md5_hash, &ctx);
+
+            std::string sHash;
+            int i;
+            for(i=0; i<16; i++)
+            {
+                char szNumber[3];
+                sprintf(szNumber, "%02x", md5_hash[i]);
+                sHash += szNumber;
+            }
+            return sHash;
+        }
+
+        uint64_t m_uStored;
+        MD5 m_md5;
+        MD5_CTX m_md5Ctx;
+    };
+
+    // Writes the response as the script does
+    static void Done(ChunkResponse& Response, int nStatus, const char* szMessage)
+    {
+        char szBody[256];
+        sprintf(szBody, "%d %s", nStatus, szMessage);
+        Response.m_nHttpStatus = nStatus;
+        Response.m_sBody = szBody;
+    }
+
+    std::map<std::string, PartialUpload> m_Uploads;   // Uploads in progress
+    std::map<std::string, std::string> m_Committed;   // Committed uploads and their hashes
+};
+
+// class CSimulatedNetwork
+// Delivers requests to the server. Can drop a connection once the given number of
+// chunk bytes is sent, lose a response, or be down for a number of requests.
+class CSimulatedNetwork
+{
+public:
+
+    CSimulatedNetwork(CChunkedUploadServer* pServer)
+    {
+        m_pServer = pServer;
+        m_uDropAtByte = 0;
+        m_nLoseResponse = -1;
+        m_nDownRequests = 0;
+        m_bDownAfterDrop = false;
+        m_uBytesSent = 0;
+        m_nRequests = 0;
+    }
+
+    // Transport callback for CChunkedUpload (pParam is the network object)
+    static int Transport(const ChunkRequest& Request, ChunkResponse& Response, void* pParam)
+    {
+        CSimulatedNetwork* pThis = (CSimulatedNetwork*)pParam;
+
+        pThis->m_nRequests++;
+
+        if(pThis->m_nDownRequests>0)
+        {
+            pThis->m_nDownRequests--;
+            return CHUNK_NOT_SENT;
+        }
+
+        if(Request.m_uDataSize!=0 && pThis->m_uDropAtByte!=0 &&
+           pThis->m_uBytesSent+Request.m_uDataSize>pThis->m_uDropAtByte)
+        {
+            // The connection is dropped in the middle of the request; the
+            // server doesn't store incomplete requests
+            pThis->m_uBytesSent = pThis->m_uDropAtByte;
+            pThis->m_uDropAtByte = 0;
+            if(pThis->m_bDownAfterDrop)
+                pThis->m_nDownRequests = 0x7fffffff;
+            return CHUNK_NOT_SENT;
+        }
+
+        pThis->m_uBytesSent += Request.m_uDataSize;
+        pThis->m_pServer->Handle(Request, pThis->m_sMD5Hash, Response);
+
+        if(pThis->m_nLoseResponse==pThis->m_nRequests)
+        {
+            // The server has handled the request, but the response is lost
+            Response.m_sBody.clear();
+            return CHUNK_NOT_SENT;
+        }
+
+        return CHUNK_SENT;
+    }
+
+    CChunkedUploadServer* m_pServer; // Server
+    std::string m_sMD5Hash;          // 'md5' field sent with each request
+    uint64_t m_uDropAtByte;          // Drop the connection at this byte of chunk data (0 = never)
+    int m_nLoseResponse;             // Lose the response to this request (1-based, -1 = never)
+    int m_nDownRequests;             // Fail that many requests
+    bool m_bDownAfterDrop;           // Fail all requests after the connection is dropped
+    uint64_t m_uBytesSent;           // Chunk bytes put on the wire
+    int m_nRequests;                 // Requests made
+};
@@ -0,0 +1,372 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "ChunkedUploadServer.h"
+
+class ChunkedUploadTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(ChunkedUploadTests, "CChunkedUpload class tests")
+        REGISTER_TEST(Test_ParseResponse)
+        REGISTER_TEST(Test_Upload)
+        REGISTER_TEST(Test_Resume_Drop)
+        REGISTER_TEST(Test_Resume_LostResponse)
+        REGISTER_TEST(Test_Resume_NextAttempt)
+        REGISTER_TEST(Test_Legacy_Server)
+        REGISTER_TEST(Test_Rejected)
+        REGISTER_TEST(Test_NoProgress)
+        REGISTER_TEST(Test_Benchmark_Resume)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_ParseResponse();
+    void Test_Upload();
+    void Test_Resume_Drop();
+    void Test_Resume_LostResponse();
+    void Test_Resume_NextAttempt();
+    void Test_Legacy_Server();
+    void Test_Rejected();
+    void Test_NoProgress();
+    void Test_Benchmark_Resume();
+
+private:
+
+    // Makes file contents and returns their MD5 hash
+    static std::string MakeFile(std::vector<unsigned char>& aData, size_t uSize);
+};
+
+REGISTER_TEST_SUITE( ChunkedUploadTests );
+
+void ChunkedUploadTests::SetUp()
+{
+}
+
+void ChunkedUploadTests::TearDown()
+{
+}
+
+std::string ChunkedUploadTests::MakeFile(std::vector<unsigned char>& aData, size_t uSize)
+{
+    uint32_t uSeed = 777;
+    size_t i;
+
+    aData.resize(uSize);
+    for(i=0; i<uSize; i++)
+    {
+        uSeed = uSeed*1103515245+12345;
+        aData[i] = (unsigned char)(uSeed>>16);
+    }
+
+    MD5 md5;
+    MD5_CTX ctx;
+    unsigned char md5_hash[16];
+    md5.MD5Init(&ctx);
+    md5.MD5Update(&ctx, &aData[0], (unsigned int)uSize);
+    md5.MD5Final(md5_hash, &ctx);
+
+    std::string sHash;
+    for(i=0; i<16; i++)
+    {
+        char szNumber[3];
+        sprintf(szNumber, "%02x", md5_hash[i]);
+        sHash += szNumber;
+    }
+    return sHash;
+}
+
+// Transport parameter passing both the file and the network
+struct ChunkedUploadContext
+{
+    std::vector<unsigned char>* m_pData;
+    CSimulatedNetwork* m_pNetwork;
+};
+
+static bool ContextRead(uint64_t uOffset, void* pBuf, size_t uSize, void* pParam)
+{
+    ChunkedUploadContext* pCtx = (ChunkedUploadContext*)pParam;
+    if(uOffset+uSize>pCtx->m_pData->size())
+        return false;
+    memcpy(pBuf, &(*pCtx->m_pData)[(size_t)uOffset], uSize);
+    return true;
+}
+
+static int ContextTransport(const ChunkRequest& Request, ChunkResponse& Response, void* pParam)
+{
+    ChunkedUploadContext* pCtx = (ChunkedUploadContext*)pParam;
+    return CSimulatedNetwork::Transport(Request, Response, pCtx->m_pNetwork);
+}
+
+// Uploads the data over the network
+static int UploadData(CChunkedUpload& upload, const std::string& sUploadId,
+    std::vector<unsigned char>& aData, CSimulatedNetwork& network)
+{
+    ChunkedUploadContext ctx;
+    ctx.m_pData = &aData;
+    ctx.m_pNetwork = &network;
+    return upload.Upload(sUploadId, aData.size(), ContextRead, ContextTransport, &ctx);
+}
+
+void ChunkedUploadTests::Test_ParseResponse()
+{
+    int nStatus = 0;
+    bool bHasOffset = false;
+    uint64_t uOffset = 0;
+
+    TEST_ASSERT(CChunkedUpload::ParseResponse("200 offset=1048576", nStatus, bHasOffset, uOffset));
+    TEST_ASSERT(nStatus==200 && bHasOffset && uOffset==1048576);
+
+    TEST_ASSERT(CChunkedUpload::ParseResponse("200 offset=5000000000\n", nStatus, bHasOffset, uOffset));
+    TEST_ASSERT(nStatus==200 && bHasOffset && uOffset==5000000000ULL);
+
+    TEST_ASSERT(CChunkedUpload::ParseResponse("452 File attachment missing", nStatus, bHasOffset, uOffset));
+    TEST_ASSERT(nStatus==452 && !bHasOffset);
+
+    TEST_ASSERT(CChunkedUpload::ParseResponse("200 offset=", nStatus, bHasOffset, uOffset));
+    TEST_ASSERT(nStatus==200 && !bHasOffset);
+
+    TEST_ASSERT(!CChunkedUpload::ParseResponse("<html>", nStatus, bHasOffset, uOffset));
+    TEST_ASSERT(!CChunkedUpload::ParseResponse("", nStatus, bHasOffset, uOffset));
+
+    __TEST_CLEANUP__;
+}
+
+void ChunkedUploadTests::Test_Upload()
+{
+    std::vector<unsigned char> aData;
+    std::string sHash = MakeFile(aData, 1000*1000);
+    CChunkedUploadServer server;
+    CSimulatedNetwork network(&server);
+    CChunkedUpload upload;
+
+    network.m_sMD5Hash = sHash;
+    upload.SetChunkSize(64*1024);
+
+    TEST_ASSERT(UploadData(upload, "guid-" + sHash, aData, network)==CHUNKED_OK);
+    TEST_ASSERT(server.IsCommitted("guid-" + sHash, sHash));
+
+    // Query, 16 chunks, commit
+    TEST_ASSERT(upload.GetRequestCount()==18);
+    TEST_ASSERT(upload.GetResumeOffset()==0);
+    TEST_ASSERT(upload.GetBytesSent()==aData.size());
+
+    // The callback read failure stops the upload
+    {
+        std::vector<unsigned char> aShort(1000);
+        ChunkedUploadContext ctx;
+        ctx.m_pData = &aShort;
+        ctx.m_pNetwork = &network;
+        CChunkedUpload upload2;
+        TEST_ASSERT(upload2.Upload("short", 2000, ContextRead, ContextTransport, &ctx)==CHUNKED_ERR_READ);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void ChunkedUploadTests::Test_Resume_Drop()
+{
+    std::vector<unsigned char> aData;
+    std::string sHash = MakeFile(aData, 1000*1000);
+    CChunkedUploadServer server;
+    CSimulatedNetwork network(&server);
+    CChunkedUpload upload;
+
+    network.m_sMD5Hash = sHash;
+    network.m_uDropAtByte = 950*1000; // Drop at 95%
+    upload.SetChunkSize(64*1024);
+    upload.SetRetryDelay(1);
+
+    TEST_ASSERT(UploadData(upload, "drop", aData, network)==CHUNKED_OK);
+    TEST_ASSERT(server.IsCommitted("drop", sHash));
+
+    // Only the chunk being sent when the connection dropped is sent again
+    TEST_ASSERT(network.m_uBytesSent<=aData.size()+64*1024);
+
+    __TEST_CLEANUP__;
+}
+
+void ChunkedUploadTests::Test_Resume_LostResponse()
+{
+    std::vector<unsigned char> aData;
+    std::string sHash = MakeFile(aData, 300*1000);
+    CChunkedUploadServer server;
+    CSimulatedNetwork network(&server);
+    CChunkedUpload upload;
+
+    network.m_sMD5Hash = sHash;
+    network.m_nLoseResponse = 3; // Second chunk is stored, but its response is lost
+    upload.SetChunkSize(64*1024);
+    upload.SetRetryDelay(1);
+
+    TEST_ASSERT(UploadData(upload, "lost", aData, network)==CHUNKED_OK);
+    TEST_ASSERT(server.IsCommitted("lost", sHash));
+
+    // The client has learned the stored offset instead of sending the chunk again
+    TEST_ASSERT(network.m_uBytesSent==aData.size());
+
+    __TEST_CLEANUP__;
+}
+
+void ChunkedUploadTests::Test_Resume_NextAttempt()
+{
+    std::vector<unsigned char> aData;
+    std::string sHash = MakeFile(aData, 1000*1000);
+    CChunkedUploadServer server;
+    CSimulatedNetwork network(&server);
+
+    network.m_sMD5Hash = sHash;
+
+    // The network goes down at 65% and stays down
+    {
+        CChunkedUpload upload;
+        upload.SetChunkSize(100*1000);
+        upload.SetMaxRetries(3);
+        upload.SetRetryDelay(1);
+        network.m_uDropAtByte = 650*1000;
+        network.m_bDownAfterDrop = true;
+
+        TEST_ASSERT(UploadData(upload, "next", aData, network)==CHUNKED_ERR_TRANSPORT);
+        TEST_ASSERT(server.GetStoredSize("next")==600*1000);
+    }
+
+    network.m_nDownRequests = 0;
+
+    // The next attempt (e.g. the next CrashSender run) continues where the first one stopped
+    {
+        CChunkedUpload upload;
+        upload.SetChunkSize(100*1000);
+        TEST_ASSERT(UploadData(upload, "next", aData, network)==CHUNKED_OK);
+        TEST_ASSERT(upload.GetResumeOffset()==600*1000);
+        TEST_ASSERT(upload.GetBytesSent()==400*1000);
+        TEST_ASSERT(server.IsCommitted("next", sHash));
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void ChunkedUploadTests::Test_Legacy_Server()
+{
+    std::vector<unsigned char> aData;
+    std::string sHash = MakeFile(aData, 100*1000);
+    CChunkedUploadServer server;
+    CSimulatedNetwork network(&server);
+    CChunkedUpload upload;
+
+    server.m_bLegacy = true;
+    network.m_sMD5Hash = sHash;
+
+    // The caller falls back to the single request upload
+    TEST_ASSERT(UploadData(upload, "legacy", aData, network)==CHUNKED_ERR_UNSUPPORTED);
+    TEST_ASSERT(upload.GetRequestCount()==1);
+    TEST_ASSERT(network.m_uBytesSent==0);
+
+    __TEST_CLEANUP__;
+}
+
+void ChunkedUploadTests::Test_Rejected()
+{
+    std::vector<unsigned char> aData;
+    MakeFile(aData, 100*1000);
+    CChunkedUploadServer server;
+    CSimulatedNetwork network(&server);
+    CChunkedUpload upload;
+
+    // Wrong hash: the server refuses to commit
+    network.m_sMD5Hash = "0123456789abcdef0123456789abcdef";
+    upload.SetChunkSize(64*1024);
+
+    TEST_ASSERT(UploadData(upload, "bad", aData, network)==CHUNKED_ERR_REJECTED);
+    TEST_ASSERT(!server.IsCommitted("bad", network.m_sMD5Hash));
+
+    __TEST_CLEANUP__;
+}
+
+void ChunkedUploadTests::Test_NoProgress()
+{
+    std::vector<unsigned char> aData;
+    std::string sHash = MakeFile(aData, 300*1000);
+    CChunkedUploadServer server;
+    CSimulatedNetwork network(&server);
+    CPerfTimer timer;
+    double dMs = 0;
+
+    network.m_sMD5Hash = sHash;
+
+    // The server answers every chunk without storing it: the stalled replies count
+    // as failures and the retries are delayed by 20, 40 and 80 ms
+    {
+        CChunkedUpload upload;
+        upload.SetChunkSize(64*1024);
+        upload.SetMaxRetries(4);
+        upload.SetRetryDelay(20);
+        server.m_bStall = true;
+
+        timer.Start();
+        TEST_ASSERT(UploadData(upload, "stall", aData, network)==CHUNKED_ERR_TRANSPORT);
+        dMs = timer.GetElapsedMs();
+        TEST_ASSERT(upload.GetRequestCount()==5); // Query and 4 chunks
+        TEST_ASSERT(dMs>=130);
+    }
+
+    // The offset returned by the server goes back after every chunk
+    {
+        CChunkedUpload upload;
+        upload.SetChunkSize(64*1024);
+        upload.SetMaxRetries(4);
+        upload.SetRetryDelay(0);
+        server.m_bStall = false;
+        server.m_bRewind = true;
+
+        TEST_ASSERT(UploadData(upload, "rewind", aData, network)==CHUNKED_ERR_TRANSPORT);
+        TEST_ASSERT(upload.GetRequestCount()<=10);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void ChunkedUploadTests::Test_Benchmark_Resume()
+{
+    // Uploads a 64 MB report when the connection drops at 95%, first restarting
+    // the upload from zero (as the single request upload does), then resuming
+    // in 1 MB chunks.
+
+    const size_t FILE_SIZE = 64*1024*1024;
+    std::vector<unsigned char> aData;
+    std::string sHash = MakeFile(aData, FILE_SIZE);
+    uint64_t uDropAt = (uint64_t)FILE_SIZE*95/100;
+    uint64_t uRestartBytes = uDropAt+FILE_SIZE;
+    CChunkedUploadServer server;
+    CSimulatedNetwork network(&server);
+    CChunkedUpload upload;
+    CPerfTimer timer;
+    double dMs = 0;
+
+    network.m_sMD5Hash = sHash;
+    network.m_uDropAtByte = uDropAt;
+    upload.SetRetryDelay(1);
+
+    timer.Start();
+    TEST_ASSERT(UploadData(upload, "bench", aData, network)==CHUNKED_OK);
+    dMs = timer.GetElapsedMs();
+    TEST_ASSERT(server.IsCommitted("bench", sHash));
+
+    printf("\n   %u MB report, drop at 95%%: restart sends %u KB, chunked resume sends %u KB "
+        "(%d requests, %.0f ms)\n   ",
+        (unsigned)(FILE_SIZE/(1024*1024)), (unsigned)(uRestartBytes/1024),
+        (unsigned)(network.m_uBytesSent/1024), upload.GetRequestCount(), dMs);
+
+    TEST_ASSERT(network.m_uBytesSent<=FILE_SIZE+CHUNKED_UPLOAD_DEFAULT_CHUNK_SIZE);
+
+    __TEST_CLEANUP__;
+}
@@ -0,0 +1,307 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include <string.h>
+#include <math.h>
+#include "CompressionPolicy.h"
+#include "ParallelDeflate.h"
+#include "zlib.h"
+
+class CompressionPolicyTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(CompressionPolicyTests, "CCompressionPolicy class tests")
+        REGISTER_TEST(Test_ClassifyByName)
+        REGISTER_TEST(Test_ClassifyBySignature)
+        REGISTER_TEST(Test_CalcEntropy)
+        REGISTER_TEST(Test_GetSampleOffsets)
+        REGISTER_TEST(Test_Choose)
+        REGISTER_TEST(Test_Benchmark_Store)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_ClassifyByName();
+    void Test_ClassifyBySignature();
+    void Test_CalcEntropy();
+    void Test_GetSampleOffsets();
+    void Test_Choose();
+    void Test_Benchmark_Store();
+
+private:
+
+    // Input of a compression
+    struct MemInput
+    {
+        const std::vector<unsigned char>* m_paData;
+        size_t m_uPos;
+    };
+
+    // Makes pseudo-random bytes, which look like compressed data
+    static void MakeRandomData(std::vector<unsigned char>& aData, size_t uSize);
+
+    // Takes the samples the policy asks for
+    static void TakeSamples(const std::vector<unsigned char>& aData, std::vector<unsigned char>& aSamples);
+
+    static bool ReadCallback(void* pBuf, size_t uSize, size_t* puRead, void* pParam);
+    static bool WriteCallback(const void* pData, size_t uSize, void* pParam);
+};
+
+REGISTER_TEST_SUITE( CompressionPolicyTests );
+
+void CompressionPolicyTests::SetUp()
+{
+}
+
+void CompressionPolicyTests::TearDown()
+{
+}
+
+void CompressionPolicyTests::MakeRandomData(std::vector<unsigned char>& aData, size_t uSize)
+{
+    uint32_t uSeed = 54321;
+    size_t i;
+
+    aData.resize(uSize);
+    for(i=0; i<uSize; i++)
+    {
+        uSeed = uSeed*1103515245+12345;
+        aData[i] = (unsigned char)(uSeed>>16);
+    }
+}
+
+void CompressionPolicyTests::TakeSamples(const std::vector<unsigned char>& aData, std::vector<unsigned char>& aSamples)
+{
+    std::vector<uint64_t> aOffsets;
+    size_t i;
+
+    aSamples.clear();
+    CCompressionPolicy::GetSampleOffsets(aData.size(), aOffsets);
+    for(i=0; i<aOffsets.size(); i++)
+    {
+        size_t uOffset = (size_t)aOffsets[i];
+        size_t uSize = aData.size()-uOffset<CPOLICY_SAMPLE_SIZE?aData.size()-uOffset:CPOLICY_SAMPLE_SIZE;
+        aSamples.insert(aSamples.end(), aData.begin()+uOffset, aData.begin()+uOffset+uSize);
+    }
+}
+
+bool CompressionPolicyTests::ReadCallback(void* pBuf, size_t uSize, size_t* puRead, void* pParam)
+{
+    MemInput* pInput = (MemInput*)pParam;
+    size_t uLeft = pInput->m_paData->size()-pInput->m_uPos;
+
+    *puRead = uSize<uLeft?uSize:uLeft;
+    if(*puRead!=0)
+        memcpy(pBuf, &(*pInput->m_paData)[pInput->m_uPos], *puRead);
+    pInput->m_uPos += *puRead;
+    return true;
+}
+
+bool CompressionPolicyTests::WriteCallback(const void* /*pData*/, size_t /*uSize*/, void* /*pParam*/)
+{
+    // Only the time and the sizes counted by CParallelDeflate are of interest
+    return true;
+}
+
+void CompressionPolicyTests::Test_ClassifyByName()
+{
+    // Already compressed formats, case doesn't matter
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("screenshot0.png")==CPOLICY_CLASS_COMPRESSED);
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("screenshot1.JPG")==CPOLICY_CLASS_COMPRESSED);
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("video.ogg")==CPOLICY_CLASS_COMPRESSED);
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("video.webm")==CPOLICY_CLASS_COMPRESSED);
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("logs\\old.Zip")==CPOLICY_CLASS_COMPRESSED);
+
+    // Formats that compress well
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("crashdump.dmp")==CPOLICY_CLASS_COMPRESSIBLE);
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("crashrpt.xml")==CPOLICY_CLASS_COMPRESSIBLE);
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("app.log")==CPOLICY_CLASS_COMPRESSIBLE);
+
+    // Anything else must be sampled
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("data.bin")==CPOLICY_CLASS_UNKNOWN);
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("png")==CPOLICY_CLASS_UNKNOWN);
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("file.pngx")==CPOLICY_CLASS_UNKNOWN);
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("dir.png/file")==CPOLICY_CLASS_UNKNOWN);
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName("")==CPOLICY_CLASS_UNKNOWN);
+    TEST_ASSERT(CCompressionPolicy::ClassifyByName(NULL)==CPOLICY_CLASS_UNKNOWN);
+
+    __TEST_CLEANUP__;
+}
+
+void CompressionPolicyTests::Test_ClassifyBySignature()
+{
+    static const unsigned char s_abPng[] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    static const unsigned char s_abJpeg[] = {0xFF, 0xD8, 0xFF, 0xE0};
+    static const unsigned char s_abOgg[] = {'O', 'g', 'g', 'S', 0};
+    static const unsigned char s_abGzip[] = {0x1F, 0x8B, 0x08};
+    static const unsigned char s_abDump[] = {'M', 'D', 'M', 'P', 0x93, 0xA7};
+
+    TEST_ASSERT(CCompressionPolicy::ClassifyBySignature(s_abPng, sizeof(s_abPng))==CPOLICY_CLASS_COMPRESSED);
+    TEST_ASSERT(CCompressionPolicy::ClassifyBySignature(s_abJpeg, sizeof(s_abJpeg))==CPOLICY_CLASS_COMPRESSED);
+    TEST_ASSERT(CCompressionPolicy::ClassifyBySignature(s_abOgg, sizeof(s_abOgg))==CPOLICY_CLASS_COMPRESSED);
+    TEST_ASSERT(CCompressionPolicy::ClassifyBySignature(s_abGzip, sizeof(s_abGzip))==CPOLICY_CLASS_COMPRESSED);
+    TEST_ASSERT(CCompressionPolicy::ClassifyBySignature(s_abDump, sizeof(s_abDump))==CPOLICY_CLASS_UNKNOWN);
+
+    // Truncated signature
+    TEST_ASSERT(CCompressionPolicy::ClassifyBySignature(s_abPng, 3)==CPOLICY_CLASS_UNKNOWN);
+    TEST_ASSERT(CCompressionPolicy::ClassifyBySignature(NULL, 0)==CPOLICY_CLASS_UNKNOWN);
+
+    __TEST_CLEANUP__;
+}
+
+void CompressionPolicyTests::Test_CalcEntropy()
+{
+    std::vector<unsigned char> aData(4096, 'a');
+    size_t i;
+
+    TEST_ASSERT(CCompressionPolicy::CalcEntropy(NULL, 0)==0);
+    TEST_ASSERT(CCompressionPolicy::CalcEntropy(&aData[0], aData.size())==0);
+
+    // Two equally frequent symbols give one bit per byte
+    for(i=0; i<aData.size(); i+=2)
+        aData[i] = 'b';
+    TEST_ASSERT(fabs(CCompressionPolicy::CalcEntropy(&aData[0], aData.size())-1.0)<1e-9);
+
+    // All byte values equally frequent give eight bits
+    for(i=0; i<aData.size(); i++)
+        aData[i] = (unsigned char)i;
+    TEST_ASSERT(fabs(CCompressionPolicy::CalcEntropy(&aData[0], aData.size())-8.0)<1e-9);
+
+    // Random data are above the limit
+    MakeRandomData(aData, CPOLICY_SAMPLE_SIZE*CPOLICY_MAX_SAMPLES);
+    TEST_ASSERT(CCompressionPolicy::CalcEntropy(&aData[0], aData.size())>CPOLICY_MAX_ENTROPY);
+
+    __TEST_CLEANUP__;
+}
+
+void CompressionPolicyTests::Test_GetSampleOffsets()
+{
+    std::vector<uint64_t> aOffsets;
+    uint64_t uHuge = (uint64_t)5*1024*1024*1024;
+
+    CCompressionPolicy::GetSampleOffsets(0, aOffsets);
+    TEST_ASSERT(aOffsets.empty());
+
+    // Small files are read whole
+    CCompressionPolicy::GetSampleOffsets(CPOLICY_SAMPLE_SIZE+1, aOffsets);
+    TEST_ASSERT(aOffsets.size()==2 && aOffsets[0]==0 && aOffsets[1]==CPOLICY_SAMPLE_SIZE);
+
+    // Samples of large files cover the beginning and the end
+    CCompressionPolicy::GetSampleOffsets(uHuge, aOffsets);
+    TEST_ASSERT(aOffsets.size()==CPOLICY_MAX_SAMPLES);
+    TEST_ASSERT(aOffsets[0]==0);
+    TEST_ASSERT(aOffsets[CPOLICY_MAX_SAMPLES-1]==uHuge-CPOLICY_SAMPLE_SIZE);
+    TEST_ASSERT(aOffsets[1]>aOffsets[0] && aOffsets[2]>aOffsets[1] && aOffsets[3]>aOffsets[2]);
+
+    __TEST_CLEANUP__;
+}
+
+void CompressionPolicyTests::Test_Choose()
+{
+    std::vector<unsigned char> aData;
+    std::vector<unsigned char> aSamples;
+    uint64_t uHuge = (uint64_t)5*1024*1024*1024;
+    const char* szLine = "Exception in thread main at Module.dll+0x1234\r\n";
+    int nMethod = -1;
+    int nLevel = -1;
+    size_t i;
+
+    // Known formats don't need samples
+    CCompressionPolicy::Choose("screenshot0.png", 300000, NULL, 0, nMethod, nLevel);
+    TEST_ASSERT(nMethod==CPOLICY_METHOD_STORE && nLevel==0);
+    CCompressionPolicy::Choose("crashrpt.xml", 3000, NULL, 0, nMethod, nLevel);
+    TEST_ASSERT(nMethod==CPOLICY_METHOD_DEFLATE && nLevel==9);
+
+    // The level goes down as the size goes up
+    CCompressionPolicy::Choose("crashdump.dmp", 10*1024*1024, NULL, 0, nMethod, nLevel);
+    TEST_ASSERT(nMethod==CPOLICY_METHOD_DEFLATE && nLevel==6);
+    CCompressionPolicy::Choose("crashdump.dmp", 200*1024*1024, NULL, 0, nMethod, nLevel);
+    TEST_ASSERT(nMethod==CPOLICY_METHOD_DEFLATE && nLevel==3);
+    CCompressionPolicy::Choose("crashdump.dmp", uHuge, NULL, 0, nMethod, nLevel);
+    TEST_ASSERT(nMethod==CPOLICY_METHOD_DEFLATE && nLevel==1);
+
+    // Unknown file with random contents is stored
+    MakeRandomData(aData, 1024*1024);
+    TakeSamples(aData, aSamples);
+    TEST_ASSERT(aSamples.size()==CPOLICY_SAMPLE_SIZE*CPOLICY_MAX_SAMPLES);
+    CCompressionPolicy::Choose("data.bin", aData.size(), &aSamples[0], aSamples.size(), nMethod, nLevel);
+    TEST_ASSERT(nMethod==CPOLICY_METHOD_STORE);
+
+    // Unknown file with text is deflated
+    aData.assign(100000, 0);
+    for(i=0; i<aData.size(); i++)
+        aData[i] = (unsigned char)szLine[i%strlen(szLine)];
+    TakeSamples(aData, aSamples);
+    CCompressionPolicy::Choose("trace.out", aData.size(), &aSamples[0], aSamples.size(), nMethod, nLevel);
+    TEST_ASSERT(nMethod==CPOLICY_METHOD_DEFLATE && nLevel==9);
+
+    // Unknown file with a PNG signature is stored, whatever the entropy
+    aData[0] = 0x89; aData[1] = 'P'; aData[2] = 'N'; aData[3] = 'G';
+    TakeSamples(aData, aSamples);
+    CCompressionPolicy::Choose("image", aData.size(), &aSamples[0], aSamples.size(), nMethod, nLevel);
+    TEST_ASSERT(nMethod==CPOLICY_METHOD_STORE);
+
+    // Empty files are stored
+    CCompressionPolicy::Choose("empty.txt", 0, NULL, 0, nMethod, nLevel);
+    TEST_ASSERT(nMethod==CPOLICY_METHOD_STORE);
+
+    __TEST_CLEANUP__;
+}
+
+void CompressionPolicyTests::Test_Benchmark_Store()
+{
+    const size_t DATA_SIZE = 32*1024*1024;
+    std::vector<unsigned char> aData;
+    std::vector<unsigned char> aSamples;
+    CParallelDeflate pd;
+    CPerfTimer timer;
+    MemInput input;
+    double dDeflateMs = 0;
+    double dPolicyMs = 0;
+    uint64_t uDeflatedSize = 0;
+    int nMethod = -1;
+    int nLevel = -1;
+
+    // Screenshots and video are as incompressible as random data
+    MakeRandomData(aData, DATA_SIZE);
+    input.m_paData = &aData;
+    TEST_ASSERT(pd.Init(Z_DEFAULT_COMPRESSION, 1)==PDEFLATE_OK);
+
+    // Deflate everything, as before
+    input.m_uPos = 0;
+    timer.Start();
+    TEST_ASSERT(pd.Compress(ReadCallback, WriteCallback, &input)==PDEFLATE_OK);
+    dDeflateMs = timer.GetElapsedMs();
+    uDeflatedSize = pd.GetOutputSize();
+
+    // Sample the data, then store them
+    input.m_uPos = 0;
+    timer.Start();
+    TakeSamples(aData, aSamples);
+    CCompressionPolicy::Choose("video.bin", aData.size(), &aSamples[0], aSamples.size(), nMethod, nLevel);
+    TEST_ASSERT(nMethod==CPOLICY_METHOD_STORE);
+    TEST_ASSERT(pd.Store(ReadCallback, WriteCallback, &input)==PDEFLATE_OK);
+    dPolicyMs = timer.GetElapsedMs();
+
+    printf("\n   %u MB of compressed data, 1 thread: deflate %.0f ms (%u bytes), "
+        "sample and store %.0f ms (%u bytes, %.1fx)\n   ",
+        (unsigned)(DATA_SIZE/(1024*1024)), dDeflateMs, (unsigned)uDeflatedSize,
+        dPolicyMs, (unsigned)pd.GetOutputSize(), dDeflateMs/dPolicyMs);
+
+    // Deflate doesn't shrink such data
+    TEST_ASSERT(uDeflatedSize>=DATA_SIZE);
+    TEST_ASSERT(pd.GetOutputSize()==DATA_SIZE);
+
+    __TEST_CLEANUP__;
+}
@@ -0,0 +1,246 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "CrashBucket.h"
+
+class CrashBucketTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(CrashBucketTests, "CCrashSignature and CBucketIndex class tests")
+        REGISTER_TEST(Test_NormalizeFrame)
+        REGISTER_TEST(Test_Signature)
+        REGISTER_TEST(Test_BucketIndex)
+        REGISTER_TEST(Test_Benchmark_Bucketing)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_NormalizeFrame();
+    void Test_Signature();
+    void Test_BucketIndex();
+    void Test_Benchmark_Bucketing();
+
+private:
+
+    std::string m_sTmpFile; // Temporary index file
+};
+
+REGISTER_TEST_SUITE( CrashBucketTests );
+
+void CrashBucketTests::SetUp()
+{
+    m_sTmpFile = "CrashBucketTests.idx";
+    remove(m_sTmpFile.c_str());
+}
+
+void CrashBucketTests::TearDown()
+{
+    remove(m_sTmpFile.c_str());
+}
+
+void CrashBucketTests::Test_NormalizeFrame()
+{
+    // Path is removed, module name is lowercased
+    TEST_ASSERT(CCrashSignature::NormalizeFrame("C:\\Program Files\\MyApp\\MyApp.EXE", "CMainDlg::OnCrash")==
+        "myapp.exe!CMainDlg::OnCrash");
+
+    // Unknown module or symbol
+    TEST_ASSERT(CCrashSignature::NormalizeFrame("", "main")=="?!main");
+    TEST_ASSERT(CCrashSignature::NormalizeFrame(NULL, NULL)=="?!?");
+    TEST_ASSERT(CCrashSignature::NormalizeFrame("MyLib.dll", "")=="mylib.dll!?");
+
+    // Lambda hashes differ between builds
+    TEST_ASSERT(CCrashSignature::NormalizeFrame("app.exe", "<lambda_5d1a0e44c4a4b1e2>::operator()")==
+        "app.exe!<lambda>::operator()");
+    TEST_ASSERT(CCrashSignature::NormalizeFrame("app.exe", "<lambda_x>")=="app.exe!<lambda_x>");
+
+    TEST_ASSERT(CCrashSignature::IsNoiseFrame("kernelbase.dll!RaiseException"));
+    TEST_ASSERT(CCrashSignature::IsNoiseFrame("crashrpt1403.dll!CCrashHandler::SEHHandler"));
+    TEST_ASSERT(CCrashSignature::IsNoiseFrame("app.exe!_CxxThrowException"));
+    TEST_ASSERT(!CCrashSignature::IsNoiseFrame("app.exe!CMainDlg::OnCrash"));
+    TEST_ASSERT(!CCrashSignature::IsNoiseFrame("app.exe!abortTransaction"));
+
+    __TEST_CLEANUP__;
+}
+
+void CrashBucketTests::Test_Signature()
+{
+    std::string sSignature;
+    std::string sBucketId;
+    std::string sSignature2;
+    std::string sBucketId2;
+
+    {
+        // No frames - no signature
+        CCrashSignature sig;
+        TEST_ASSERT(sig.Build(sSignature, sBucketId)==0);
+        TEST_ASSERT(sSignature.empty() && sBucketId.empty());
+    }
+
+    {
+        CCrashSignature sig(3);
+        sig.AddFrame("KERNELBASE.dll", "RaiseException");
+        sig.AddFrame("C:\\Windows\\System32\\MSVCR100.dll", "_CxxThrowException");
+        sig.AddFrame("app.exe", "Parse");
+        sig.AddFrame("app.exe", "Parse"); // recursion
+        sig.AddFrame("app.exe", "Parse");
+        sig.AddFrame("app.exe", "Load");
+        sig.AddFrame("app.exe", "main");
+        sig.AddFrame("kernel32.dll", "BaseThreadInitThunk");
+        TEST_ASSERT(sig.Build(sSignature, sBucketId)==3);
+        TEST_ASSERT(sSignature=="app.exe!Parse\napp.exe!Load\napp.exe!main");
+        TEST_ASSERT(sBucketId.length()==16);
+    }
+
+    {
+        // Another build: different paths and recursion depth, the same bucket
+        CCrashSignature sig(3);
+        sig.AddFrame("ntdll.dll", "KiUserExceptionDispatcher");
+        sig.AddFrame("D:\\Build\\App.exe", "Parse");
+        sig.AddFrame("D:\\Build\\App.exe", "Load");
+        sig.AddFrame("D:\\Build\\App.exe", "main");
+        TEST_ASSERT(sig.Build(sSignature2, sBucketId2)==3);
+        TEST_ASSERT(sSignature2==sSignature && sBucketId2==sBucketId);
+
+        // Different top frame - different bucket
+        sig.Reset();
+        sig.AddFrame("app.exe", "Save");
+        sig.AddFrame("app.exe", "main");
+        TEST_ASSERT(sig.Build(sSignature2, sBucketId2)==2);
+        TEST_ASSERT(sBucketId2!=sBucketId);
+    }
+
+    {
+        // Only noise frames - they are used
+        CCrashSignature sig;
+        sig.AddFrame("ntdll.dll", "NtWaitForSingleObject");
+        sig.AddFrame("kernelbase.dll", "WaitForSingleObjectEx");
+        TEST_ASSERT(sig.Build(sSignature, sBucketId)==2);
+        TEST_ASSERT(sSignature=="ntdll.dll!NtWaitForSingleObject\nkernelbase.dll!WaitForSingleObjectEx");
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void CrashBucketTests::Test_BucketIndex()
+{
+    CrashBucket b;
+    std::vector<CrashBucket> aBuckets;
+    FILE* f = NULL;
+
+    {
+        CBucketIndex idx;
+        TEST_ASSERT(idx.Open(m_sTmpFile.c_str())==BUCKETIDX_OK);
+        TEST_ASSERT(idx.GetBucketCount()==0);
+
+        TEST_ASSERT(idx.AddReport("aaaa", "app.exe!A", "r1.zip", "2013-03-02T10:00:00Z")==1);
+        TEST_ASSERT(idx.AddReport("bbbb", "app.exe!B", "r2.zip", "2013-03-01T10:00:00Z")==1);
+        TEST_ASSERT(idx.AddReport("bbbb", "app.exe!B", "r3.zip", "2013-02-27T08:00:00Z")==2);
+        TEST_ASSERT(idx.AddReport("bbbb", "app.exe!B", "r4.zip", "")==3);
+        TEST_ASSERT(idx.Save()==BUCKETIDX_OK);
+    }
+
+    {
+        // Buckets persist and are updated
+        CBucketIndex idx;
+        TEST_ASSERT(idx.Open(m_sTmpFile.c_str())==BUCKETIDX_OK);
+        TEST_ASSERT(idx.GetBucketCount()==2);
+        TEST_ASSERT(idx.GetReportCount()==4);
+
+        TEST_ASSERT(idx.Find("bbbb", b));
+        TEST_ASSERT(b.m_uCount==3 && b.m_sReport=="r2.zip" && b.m_sSignature=="app.exe!B");
+        TEST_ASSERT(b.m_sFirstSeen=="2013-02-27T08:00:00Z" && b.m_sLastSeen=="2013-03-01T10:00:00Z");
+        TEST_ASSERT(!idx.Find("cccc", b));
+
+        TEST_ASSERT(idx.AddReport("aaaa", "app.exe!A", "r5.zip", "2013-03-05T10:00:00Z")==2);
+        TEST_ASSERT(idx.AddReport("aaaa", "app.exe!A", "r6.zip", "2013-03-06T10:00:00Z")==3);
+        TEST_ASSERT(idx.AddReport("aaaa", "app.exe!A", "r7.zip", "2013-03-07T10:00:00Z")==4);
+
+        // The largest bucket first
+        idx.GetBuckets(aBuckets);
+        TEST_ASSERT(aBuckets.size()==2);
+        TEST_ASSERT(aBuckets[0].m_sBucketId=="aaaa" && aBuckets[0].m_uCount==4);
+        TEST_ASSERT(aBuckets[0].m_sLastSeen=="2013-03-07T10:00:00Z");
+        TEST_ASSERT(aBuckets[1].m_sBucketId=="bbbb");
+    }
+
+    // Not an index file - ignored
+    f = fopen(m_sTmpFile.c_str(), "wb");
+    TEST_ASSERT(f!=NULL);
+    fprintf(f, "BCKT but not really an index");
+    fclose(f);
+    f = NULL;
+
+    {
+        CBucketIndex idx;
+        TEST_ASSERT(idx.Open(m_sTmpFile.c_str())==BUCKETIDX_ERR_INVALID_FILE);
+        TEST_ASSERT(idx.GetBucketCount()==0);
+        idx.AddReport("aaaa", "app.exe!A", "r1.zip", "");
+        TEST_ASSERT(idx.Save()==BUCKETIDX_OK);
+        TEST_ASSERT(idx.Open(m_sTmpFile.c_str())==BUCKETIDX_OK);
+        TEST_ASSERT(idx.GetReportCount()==1);
+    }
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
+
+void CrashBucketTests::Test_Benchmark_Bucketing()
+{
+    // Buckets 100000 stack traces of 30 frames from 200 distinct crash sites
+    const int REPORT_COUNT = 100000;
+    const int FRAME_COUNT = 30;
+    std::vector<std::string> aSymbols;
+    CCrashSignature sig;
+    CBucketIndex idx;
+    std::string sSignature;
+    std::string sBucketId;
+    CPerfTimer timer;
+    double dMs = 0;
+    int i;
+    int j;
+
+    for(i=0; i<FRAME_COUNT+200; i++)
+    {
+        char szSymbol[64];
+        sprintf(szSymbol, "CDocument::Method%d", i);
+        aSymbols.push_back(szSymbol);
+    }
+
+    remove(m_sTmpFile.c_str());
+    TEST_ASSERT(idx.Open(m_sTmpFile.c_str())==BUCKETIDX_OK);
+
+    timer.Start();
+    for(i=0; i<REPORT_COUNT; i++)
+    {
+        sig.Reset();
+        sig.AddFrame("C:\\Windows\\System32\\KERNELBASE.dll", "RaiseException");
+        for(j=0; j<FRAME_COUNT; j++)
+            sig.AddFrame("D:\\Build\\1.4.3\\MyApp.exe", aSymbols[(i%200)+j].c_str());
+        sig.Build(sSignature, sBucketId);
+        idx.AddReport(sBucketId, sSignature, "report.zip", "2013-03-01T10:00:00Z");
+    }
+    TEST_ASSERT(idx.Save()==BUCKETIDX_OK);
+    dMs = timer.GetElapsedMs();
+
+    printf("\n   %d reports: %.1f ms (%.2f us/report), %u buckets\n   ",
+        REPORT_COUNT, dMs, dMs*1000.0/REPORT_COUNT, (unsigned)idx.GetBucketCount());
+
+    TEST_ASSERT(idx.GetBucketCount()==200);
+    TEST_ASSERT(idx.GetReportCount()==REPORT_COUNT);
+
+    __TEST_CLEANUP__;
+}
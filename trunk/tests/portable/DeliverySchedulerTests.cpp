@@ -0,0 +1,347 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "DeliveryScheduler.h"
+
+class DeliverySchedulerTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(DeliverySchedulerTests, "CDeliveryScheduler class tests")
+        REGISTER_TEST(Test_Pipeline)
+        REGISTER_TEST(Test_Failures)
+        REGISTER_TEST(Test_Cancel)
+        REGISTER_TEST(Test_Benchmark_Flush)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_Pipeline();
+    void Test_Failures();
+    void Test_Cancel();
+    void Test_Benchmark_Flush();
+
+private:
+
+    // Stand-in for the crash report server: each upload takes a fixed round trip.
+    // Counts requests and the maximum number of requests served at once.
+    struct UploadServer
+    {
+        UploadServer()
+        {
+            m_uLatencyMs = 0;
+            m_nActive = 0;
+            m_nPeakActive = 0;
+            m_nRequests = 0;
+        }
+
+        bool Upload(int nReport);
+
+        unsigned m_uLatencyMs;
+        CSyncMutex m_Lock;
+        int m_nActive;
+        int m_nPeakActive;
+        int m_nRequests;
+    };
+
+    // Queue of reports
+    struct ReportQueue
+    {
+        ReportQueue(int nReports)
+        {
+            m_nNext = 0;
+            m_uPrepareMs = 0;
+            m_nFailPrepareEvery = 0;
+            m_nFailDeliverEvery = 0;
+            m_nCancelAfter = -1;
+            m_nDone = 0;
+            m_pServer = NULL;
+            m_pScheduler = NULL;
+            m_aPrepared.resize(nReports, 0);
+            m_aDone.resize(nReports, 0);
+            m_aDelivered.resize(nReports, false);
+        }
+
+        int m_nNext;                       // Next report to take
+        unsigned m_uPrepareMs;             // Time spent compressing a report
+        int m_nFailPrepareEvery;           // Compression fails for every N-th report (0 = never)
+        int m_nFailDeliverEvery;           // Upload fails for every N-th report (0 = never)
+        int m_nCancelAfter;                // Cancel after that many reports are done (-1 = never)
+        int m_nDone;                       // Number of reports done
+        UploadServer* m_pServer;
+        CDeliveryScheduler* m_pScheduler;
+        std::vector<int> m_aPrepared;      // Number of times each report was prepared
+        std::vector<int> m_aDone;          // Number of times each report was finished
+        std::vector<bool> m_aDelivered;    // Result of each report
+    };
+
+    static int NextCallback(void* pParam);
+    static bool PrepareCallback(int nItem, void* pParam);
+    static bool DeliverCallback(int nItem, void* pParam);
+    static void DoneCallback(int nItem, bool bDelivered, void* pParam);
+
+    // Flushes the queue and returns elapsed time
+    static double Flush(ReportQueue& queue, UploadServer& server, int nConcurrency, int& nStatus);
+};
+
+REGISTER_TEST_SUITE( DeliverySchedulerTests );
+
+void DeliverySchedulerTests::SetUp()
+{
+}
+
+void DeliverySchedulerTests::TearDown()
+{
+}
+
+bool DeliverySchedulerTests::UploadServer::Upload(int nReport)
+{
+    m_Lock.Lock();
+    m_nActive++;
+    m_nRequests++;
+    if(m_nActive>m_nPeakActive)
+        m_nPeakActive = m_nActive;
+    m_Lock.Unlock();
+
+    CSyncThread::Sleep(m_uLatencyMs);
+
+    m_Lock.Lock();
+    m_nActive--;
+    m_Lock.Unlock();
+
+    return nReport>=0;
+}
+
+int DeliverySchedulerTests::NextCallback(void* pParam)
+{
+    ReportQueue* pQueue = (ReportQueue*)pParam;
+
+    if(pQueue->m_nNext>=(int)pQueue->m_aPrepared.size())
+        return -1;
+
+    return pQueue->m_nNext++;
+}
+
+bool DeliverySchedulerTests::PrepareCallback(int nItem, void* pParam)
+{
+    ReportQueue* pQueue = (ReportQueue*)pParam;
+
+    pQueue->m_aPrepared[nItem]++;
+    if(pQueue->m_uPrepareMs!=0)
+        CSyncThread::Sleep(pQueue->m_uPrepareMs);
+
+    if(pQueue->m_nFailPrepareEvery!=0 && nItem%pQueue->m_nFailPrepareEvery==0)
+        return false;
+
+    return true;
+}
+
+bool DeliverySchedulerTests::DeliverCallback(int nItem, void* pParam)
+{
+    ReportQueue* pQueue = (ReportQueue*)pParam;
+
+    if(!pQueue->m_pServer->Upload(nItem))
+        return false;
+
+    if(pQueue->m_nFailDeliverEvery!=0 && nItem%pQueue->m_nFailDeliverEvery==1)
+        return false;
+
+    return true;
+}
+
+void DeliverySchedulerTests::DoneCallback(int nItem, bool bDelivered, void* pParam)
+{
+    ReportQueue* pQueue = (ReportQueue*)pParam;
+
+    pQueue->m_aDone[nItem]++;
+    pQueue->m_aDelivered[nItem] = bDelivered;
+    pQueue->m_nDone++;
+
+    if(pQueue->m_nCancelAfter>=0 && pQueue->m_nDone==pQueue->m_nCancelAfter)
+        pQueue->m_pScheduler->Cancel();
+}
+
+double DeliverySchedulerTests::Flush(ReportQueue& queue, UploadServer& server, int nConcurrency, int& nStatus)
+{
+    CDeliveryScheduler scheduler;
+    CPerfTimer timer;
+
+    queue.m_pServer = &server;
+    queue.m_pScheduler = &scheduler;
+
+    timer.Start();
+    nStatus = scheduler.Run(nConcurrency, NextCallback, PrepareCallback,
+        DeliverCallback, DoneCallback, &queue);
+    double dElapsedMs = timer.GetElapsedMs();
+
+    queue.m_pScheduler = NULL;
+    return dElapsedMs;
+}
+
+void DeliverySchedulerTests::Test_Pipeline()
+{
+    ReportQueue queue(20);
+    UploadServer server;
+    int nStatus = -1;
+    size_t i;
+
+    queue.m_uPrepareMs = 1;
+    server.m_uLatencyMs = 10;
+
+    Flush(queue, server, 3, nStatus);
+    TEST_ASSERT(nStatus==DELIVERY_OK);
+
+    // Each report is compressed, uploaded and reported once
+    for(i=0; i<queue.m_aDone.size(); i++)
+    {
+        TEST_ASSERT(queue.m_aPrepared[i]==1);
+        TEST_ASSERT(queue.m_aDone[i]==1);
+        TEST_ASSERT(queue.m_aDelivered[i]);
+    }
+    TEST_ASSERT(server.m_nRequests==20);
+
+    // The number of uploads in flight is bounded
+    TEST_ASSERT(server.m_nPeakActive>=2 && server.m_nPeakActive<=3);
+
+    // Invalid parameters
+    {
+        CDeliveryScheduler scheduler;
+        TEST_ASSERT(scheduler.Run(1, NULL, PrepareCallback, DeliverCallback, DoneCallback, &queue)==DELIVERY_ERR_PARAM);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void DeliverySchedulerTests::Test_Failures()
+{
+    ReportQueue queue(30);
+    UploadServer server;
+    int nStatus = -1;
+    int nFailed = 0;
+    size_t i;
+
+    queue.m_nFailPrepareEvery = 5;
+    queue.m_nFailDeliverEvery = 4;
+
+    Flush(queue, server, 4, nStatus);
+    TEST_ASSERT(nStatus==DELIVERY_OK);
+
+    for(i=0; i<queue.m_aDone.size(); i++)
+    {
+        bool bExpected = i%5!=0 && i%4!=1;
+        TEST_ASSERT(queue.m_aDone[i]==1);
+        TEST_ASSERT(queue.m_aDelivered[i]==bExpected);
+        if(!bExpected)
+            nFailed++;
+    }
+
+    // Reports failed to compress are not uploaded
+    TEST_ASSERT(server.m_nRequests==24);
+    TEST_ASSERT(nFailed==12);
+
+    __TEST_CLEANUP__;
+}
+
+void DeliverySchedulerTests::Test_Cancel()
+{
+    ReportQueue queue(50);
+    UploadServer server;
+    int nStatus = -1;
+    int nTaken = 0;
+    size_t i;
+
+    server.m_uLatencyMs = 5;
+    queue.m_nCancelAfter = 5;
+
+    Flush(queue, server, 2, nStatus);
+    TEST_ASSERT(nStatus==DELIVERY_OK);
+
+    // No more reports are taken after cancellation; at most the ones
+    // in the pipeline at that moment are finished (as failed)
+    nTaken = queue.m_nNext;
+    TEST_ASSERT(nTaken>=5 && nTaken<=5+3);
+    TEST_ASSERT(queue.m_nDone==nTaken);
+
+    for(i=0; i<queue.m_aDone.size(); i++)
+        TEST_ASSERT(queue.m_aDone[i]==((int)i<nTaken?1:0));
+
+    __TEST_CLEANUP__;
+}
+
+void DeliverySchedulerTests::Test_Benchmark_Flush()
+{
+    // Flushes 50 queued reports against the stand-in server: the old way (compress
+    // and upload one report at a time), then with the pipeline keeping 1 and 4
+    // uploads in flight.
+
+    const int REPORT_COUNT = 50;
+    const unsigned COMPRESS_MS = 4;
+    const unsigned ROUND_TRIP_MS = 30;
+    UploadServer server;
+    CPerfTimer timer;
+    double dSerialMs = 0;
+    double dOneMs = 0;
+    double dFourMs = 0;
+    int nStatus = -1;
+    int i;
+
+    server.m_uLatencyMs = ROUND_TRIP_MS;
+
+    // Serial loop
+    {
+        ReportQueue queue(REPORT_COUNT);
+        queue.m_uPrepareMs = COMPRESS_MS;
+        queue.m_pServer = &server;
+
+        timer.Start();
+        for(i=0; i<REPORT_COUNT; i++)
+        {
+            int nItem = NextCallback(&queue);
+            if(PrepareCallback(nItem, &queue))
+                DoneCallback(nItem, DeliverCallback(nItem, &queue), &queue);
+        }
+        dSerialMs = timer.GetElapsedMs();
+        TEST_ASSERT(queue.m_nDone==REPORT_COUNT);
+    }
+
+    // Pipeline, one upload in flight
+    {
+        ReportQueue queue(REPORT_COUNT);
+        queue.m_uPrepareMs = COMPRESS_MS;
+        dOneMs = Flush(queue, server, 1, nStatus);
+        TEST_ASSERT(nStatus==DELIVERY_OK);
+        TEST_ASSERT(queue.m_nDone==REPORT_COUNT);
+    }
+
+    // Pipeline, four uploads in flight
+    server.m_nPeakActive = 0;
+    {
+        ReportQueue queue(REPORT_COUNT);
+        queue.m_uPrepareMs = COMPRESS_MS;
+        dFourMs = Flush(queue, server, 4, nStatus);
+        TEST_ASSERT(nStatus==DELIVERY_OK);
+        TEST_ASSERT(queue.m_nDone==REPORT_COUNT);
+    }
+
+    printf("\n   %d reports (%u ms compress, %u ms round trip): serial %.0f ms, "
+        "1 in flight %.0f ms, 4 in flight %.0f ms (%.1fx)\n   ",
+        REPORT_COUNT, COMPRESS_MS, ROUND_TRIP_MS, dSerialMs, dOneMs, dFourMs,
+        dSerialMs/dFourMs);
+
+    TEST_ASSERT(server.m_nPeakActive<=4);
+    TEST_ASSERT(server.m_nRequests==3*REPORT_COUNT);
+    // Uploads overlap, so flushing the queue takes much less than the sum of round trips
+    TEST_ASSERT(dFourMs<dSerialMs/2);
+
+    __TEST_CLEANUP__;
+}
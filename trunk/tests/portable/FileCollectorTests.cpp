@@ -0,0 +1,493 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "FileCollector.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+class FileCollectorTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(FileCollectorTests, "CFileCollector class tests")
+        REGISTER_TEST(Test_Copy)
+        REGISTER_TEST(Test_Snapshot)
+        REGISTER_TEST(Test_Errors)
+        REGISTER_TEST(Test_Cancel)
+        REGISTER_TEST(Test_ExpandTemplate)
+        REGISTER_TEST(Test_Benchmark_Collect)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_Copy();
+    void Test_Snapshot();
+    void Test_Errors();
+    void Test_Cancel();
+    void Test_ExpandTemplate();
+    void Test_Benchmark_Collect();
+
+private:
+
+    // Progress reported by the collector
+    struct Progress
+    {
+        uint64_t m_uDone;     // Last reported values
+        uint64_t m_uTotal;
+        int m_nCalls;         // Number of calls
+        int m_nCancelAfter;   // Return false on this call
+        bool m_bDecreased;    // Whether the reported value went back
+    };
+
+    static bool OnProgress(uint64_t uDone, uint64_t uTotal, void* pParam);
+
+    // Returns the name of a temporary file. A file left by a previous run is removed
+    // when the name is first used; the file is removed on tear down.
+    std::string TmpFile(const char* szName, int nIndex=0);
+
+    // Writes uSize bytes of pseudo-random data to the file
+    static bool WriteTestFile(const std::string& sPath, size_t uSize, unsigned uSeed, bool bAppend=false);
+
+    // Reads the file
+    static bool ReadTestFile(const std::string& sPath, std::vector<char>& aData);
+
+    static bool FileExists(const std::string& sPath);
+
+    static FileCollectPath MakePath(const std::string& sPath);
+
+    std::vector<std::string> m_aTmpFiles; // Temporary files
+};
+
+REGISTER_TEST_SUITE( FileCollectorTests );
+
+void FileCollectorTests::SetUp()
+{
+}
+
+void FileCollectorTests::TearDown()
+{
+    size_t i;
+    for(i=0; i<m_aTmpFiles.size(); i++)
+        remove(m_aTmpFiles[i].c_str());
+    m_aTmpFiles.clear();
+}
+
+bool FileCollectorTests::OnProgress(uint64_t uDone, uint64_t uTotal, void* pParam)
+{
+    Progress* pProgress = (Progress*)pParam;
+
+    if(uDone<pProgress->m_uDone)
+        pProgress->m_bDecreased = true;
+
+    pProgress->m_uDone = uDone;
+    pProgress->m_uTotal = uTotal;
+    pProgress->m_nCalls++;
+
+    return pProgress->m_nCalls!=pProgress->m_nCancelAfter;
+}
+
+std::string FileCollectorTests::TmpFile(const char* szName, int nIndex)
+{
+    char szPath[64];
+    sprintf(szPath, "FileCollectorTests_%s%d.dat", szName, nIndex);
+    if(std::find(m_aTmpFiles.begin(), m_aTmpFiles.end(), szPath)==m_aTmpFiles.end())
+    {
+        m_aTmpFiles.push_back(szPath);
+        remove(szPath);
+    }
+    return szPath;
+}
+
+bool FileCollectorTests::WriteTestFile(const std::string& sPath, size_t uSize, unsigned uSeed, bool bAppend)
+{
+    FILE* f = fopen(sPath.c_str(), bAppend ? "ab" : "wb");
+    if(f==NULL)
+        return false;
+
+    std::vector<char> aBlock(64*1024);
+    unsigned uState = uSeed;
+    bool bStatus = true;
+
+    while(uSize!=0 && bStatus)
+    {
+        size_t uBlock = uSize<aBlock.size() ? uSize : aBlock.size();
+        size_t i;
+        for(i=0; i<uBlock; i++)
+        {
+            uState = uState*1103515245+12345;
+            aBlock[i] = (char)(uState>>16);
+        }
+
+        bStatus = fwrite(&aBlock[0], 1, uBlock, f)==uBlock;
+        uSize -= uBlock;
+    }
+
+    if(fclose(f)!=0)
+        bStatus = false;
+    return bStatus;
+}
+
+bool FileCollectorTests::ReadTestFile(const std::string& sPath, std::vector<char>& aData)
+{
+    aData.clear();
+
+    FILE* f = fopen(sPath.c_str(), "rb");
+    if(f==NULL)
+        return false;
+
+    char abBuf[65536];
+    size_t uRead;
+    while((uRead=fread(abBuf, 1, sizeof(abBuf), f))!=0)
+        aData.insert(aData.end(), abBuf, abBuf+uRead);
+
+    fclose(f);
+    return true;
+}
+
+bool FileCollectorTests::FileExists(const std::string& sPath)
+{
+    FILE* f = fopen(sPath.c_str(), "rb");
+    if(f==NULL)
+        return false;
+    fclose(f);
+    return true;
+}
+
+FileCollectPath FileCollectorTests::MakePath(const std::string& sPath)
+{
+    return FileCollectPath(sPath.begin(), sPath.end());
+}
+
+void FileCollectorTests::Test_Copy()
+{
+    // Copies files of different sizes with buffers and with the system copy routine
+
+    const int FILES = 6;
+    const size_t auSizes[FILES] = {0, 1, 1000, 3*1024*1024+17, 2*1024*1024, 65536};
+    std::vector<FileCollectItem> aItems(FILES);
+    std::vector<char> aSrc, aDest;
+    Progress progress;
+    uint64_t uTotal = 0;
+    int nPass, i;
+
+    for(i=0; i<FILES; i++)
+    {
+        aItems[i].m_sSrcFile = MakePath(TmpFile("copy_src", i));
+        aItems[i].m_sDestFile = MakePath(TmpFile("copy_dst", i));
+        TEST_ASSERT(WriteTestFile(TmpFile("copy_src", i), auSizes[i], i+1));
+        uTotal += auSizes[i];
+    }
+
+    for(nPass=0; nPass<2; nPass++)
+    {
+        CFileCollector collector;
+        collector.SetSystemCopy(nPass==1);
+        collector.SetThreadCount(3);
+        collector.SetBufferSize(256*1024);
+        collector.SetProgressCallback(OnProgress, &progress);
+        memset(&progress, 0, sizeof(progress));
+
+        TEST_ASSERT(collector.Run(aItems)==0);
+        TEST_ASSERT(collector.GetThreadCount()==3);
+
+        for(i=0; i<FILES; i++)
+        {
+            TEST_ASSERT(aItems[i].m_nResult==FCOLLECT_OK);
+            TEST_ASSERT(aItems[i].m_uSize==auSizes[i]);
+            TEST_ASSERT(ReadTestFile(TmpFile("copy_src", i), aSrc));
+            TEST_ASSERT(ReadTestFile(TmpFile("copy_dst", i), aDest));
+            TEST_ASSERT(aSrc==aDest);
+
+            if(nPass==0)
+            {
+                TEST_ASSERT(aItems[i].m_nMethod==FCOLLECT_METHOD_READ);
+            }
+            else
+            {
+                TEST_ASSERT(aItems[i].m_nMethod==FCOLLECT_METHOD_SYSTEM ||
+                    aItems[i].m_nMethod==FCOLLECT_METHOD_READ);
+            }
+        }
+
+        // Progress is reported per step and once in the end
+        TEST_ASSERT(progress.m_nCalls>=2);
+        TEST_ASSERT(progress.m_uDone==uTotal);
+        TEST_ASSERT(progress.m_uTotal==uTotal);
+        TEST_ASSERT(!progress.m_bDecreased);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void FileCollectorTests::Test_Snapshot()
+{
+    // A snapshot records the file size; data appended later are not part of it
+
+    std::vector<FileCollectItem> aItems(2);
+    std::string sSrc = TmpFile("snap_src");
+    std::string sDest = TmpFile("snap_dst");
+    std::string sCheck = TmpFile("snap_chk");
+    std::vector<char> aDest;
+    CFileCollector collector;
+
+    TEST_ASSERT(WriteTestFile(sSrc, 100000, 7));
+
+    aItems[0].m_sSrcFile = MakePath(sSrc);
+    aItems[0].m_sDestFile = MakePath(sDest);
+    aItems[0].m_nMode = FCOLLECT_MODE_SNAPSHOT;
+
+    // Check mode doesn't create the destination
+    aItems[1].m_sSrcFile = MakePath(sSrc);
+    aItems[1].m_sDestFile = MakePath(sCheck);
+    aItems[1].m_nMode = FCOLLECT_MODE_CHECK;
+
+    TEST_ASSERT(collector.Run(aItems)==0);
+    TEST_ASSERT(aItems[0].m_nResult==FCOLLECT_OK);
+    TEST_ASSERT(aItems[0].m_uSize==100000);
+    TEST_ASSERT(aItems[1].m_nResult==FCOLLECT_OK);
+    TEST_ASSERT(aItems[1].m_nMethod==FCOLLECT_METHOD_NONE);
+    TEST_ASSERT(!FileExists(sCheck));
+
+    // The application appends to its log
+    TEST_ASSERT(WriteTestFile(sSrc, 50000, 8, true));
+
+    if(aItems[0].m_nMethod==FCOLLECT_METHOD_LINK)
+    {
+        // The link shares the data of the source
+        TEST_ASSERT(ReadTestFile(sDest, aDest));
+        TEST_ASSERT(aDest.size()==150000);
+    }
+    else
+    {
+        TEST_ASSERT(aItems[0].m_nMethod==FCOLLECT_METHOD_SIZE);
+        TEST_ASSERT(!FileExists(sDest));
+    }
+
+    // Taking the snapshot again replaces the link
+    TEST_ASSERT(collector.Run(aItems)==0);
+    TEST_ASSERT(aItems[0].m_uSize==150000);
+
+    __TEST_CLEANUP__;
+}
+
+void FileCollectorTests::Test_Errors()
+{
+    std::vector<FileCollectItem> aItems(4);
+    std::string sSrc = TmpFile("err_src");
+    std::string sMissing = TmpFile("err_missing");
+    int nPass;
+
+    TEST_ASSERT(WriteTestFile(sSrc, 1000, 1));
+
+    for(nPass=0; nPass<2; nPass++)
+    {
+        CFileCollector collector;
+        collector.SetSystemCopy(nPass==1);
+
+        // Missing source
+        aItems[0].m_sSrcFile = MakePath(sMissing);
+        aItems[0].m_sDestFile = MakePath(TmpFile("err_dst", 0));
+        aItems[0].m_nMode = FCOLLECT_MODE_COPY;
+
+        // Destination folder doesn't exist
+        aItems[1].m_sSrcFile = MakePath(sSrc);
+        aItems[1].m_sDestFile = MakePath("FileCollectorTests_no_such_dir/dst.dat");
+        aItems[1].m_nMode = FCOLLECT_MODE_COPY;
+
+        // Missing source in check and snapshot modes
+        aItems[2].m_sSrcFile = MakePath(sMissing);
+        aItems[2].m_nMode = FCOLLECT_MODE_CHECK;
+        aItems[3].m_sSrcFile = MakePath(sMissing);
+        aItems[3].m_sDestFile = MakePath(TmpFile("err_dst", 3));
+        aItems[3].m_nMode = FCOLLECT_MODE_SNAPSHOT;
+
+        TEST_ASSERT(collector.Run(aItems)==4);
+        TEST_ASSERT(aItems[0].m_nResult==FCOLLECT_ERR_OPEN);
+        TEST_ASSERT(aItems[0].m_nSysError!=0);
+        TEST_ASSERT(!FileExists(TmpFile("err_dst", 0)));
+        TEST_ASSERT(aItems[1].m_nResult==FCOLLECT_ERR_CREATE);
+        TEST_ASSERT(aItems[1].m_nSysError!=0);
+        TEST_ASSERT(aItems[2].m_nResult==FCOLLECT_ERR_OPEN);
+        TEST_ASSERT(aItems[3].m_nResult==FCOLLECT_ERR_OPEN);
+    }
+
+    // Nothing to do
+    {
+        CFileCollector collector;
+        std::vector<FileCollectItem> aEmpty;
+        TEST_ASSERT(collector.Run(aEmpty)==0);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void FileCollectorTests::Test_Cancel()
+{
+    // The progress callback cancels the run while the first file is copied
+
+    const int FILES = 4;
+    std::vector<FileCollectItem> aItems(FILES);
+    CFileCollector collector;
+    Progress progress;
+    int nCancelled = 0;
+    int i;
+
+    for(i=0; i<FILES; i++)
+    {
+        aItems[i].m_sSrcFile = MakePath(TmpFile("cancel_src", i));
+        aItems[i].m_sDestFile = MakePath(TmpFile("cancel_dst", i));
+        TEST_ASSERT(WriteTestFile(TmpFile("cancel_src", i), 3*1024*1024, i+1));
+    }
+
+    memset(&progress, 0, sizeof(progress));
+    progress.m_nCancelAfter = 1;
+    collector.SetThreadCount(1);
+    collector.SetSystemCopy(false);
+    collector.SetProgressCallback(OnProgress, &progress);
+
+    TEST_ASSERT(collector.Run(aItems)==FILES);
+    TEST_ASSERT(collector.IsCancelled());
+    TEST_ASSERT(progress.m_nCalls==1);
+
+    for(i=0; i<FILES; i++)
+    {
+        if(aItems[i].m_nResult==FCOLLECT_ERR_CANCELLED)
+            nCancelled++;
+
+        // Partial copies are removed
+        TEST_ASSERT(!FileExists(TmpFile("cancel_dst", i)));
+    }
+    TEST_ASSERT(nCancelled==FILES);
+
+    __TEST_CLEANUP__;
+}
+
+void FileCollectorTests::Test_ExpandTemplate()
+{
+    std::vector<FileCollectPath> aFiles;
+    std::string sLog1 = "FileCollectorTests_b.log";
+    std::string sLog2 = "FileCollectorTests_a.log";
+    std::string sText = "FileCollectorTests_c.txt";
+
+    m_aTmpFiles.push_back(sLog1);
+    m_aTmpFiles.push_back(sLog2);
+    m_aTmpFiles.push_back(sText);
+    TEST_ASSERT(WriteTestFile(sLog1, 10, 1));
+    TEST_ASSERT(WriteTestFile(sLog2, 10, 2));
+    TEST_ASSERT(WriteTestFile(sText, 10, 3));
+
+    // Files are added to the list
+    aFiles.push_back(MakePath("first"));
+    TEST_ASSERT(CFileCollector::ExpandTemplate(MakePath("FileCollectorTests_*.log"), aFiles));
+    TEST_ASSERT(aFiles.size()==3);
+    TEST_ASSERT(aFiles[1]==MakePath(sLog2));
+    TEST_ASSERT(aFiles[2]==MakePath(sLog1));
+
+    // Nothing matches
+    aFiles.clear();
+    TEST_ASSERT(!CFileCollector::ExpandTemplate(MakePath("FileCollectorTests_*.none"), aFiles));
+    TEST_ASSERT(aFiles.empty());
+    TEST_ASSERT(!CFileCollector::ExpandTemplate(MakePath("FileCollectorTests_no_such_dir/*.log"), aFiles));
+
+    __TEST_CLEANUP__;
+}
+
+void FileCollectorTests::Test_Benchmark_Collect()
+{
+    // Collects a set of large logs as the report sender did (1 KB reads and writes,
+    // one file after another), with the collector copying them, and as snapshots
+
+    const int FILES = 8;
+    const size_t FILE_SIZE = 16*1024*1024;
+    std::vector<FileCollectItem> aItems(FILES);
+    std::vector<char> aBuffer(1024);
+    CPerfTimer timer;
+    double dSerialMs = 0;
+    double dReadMs = 0;
+    double dSystemMs = 0;
+    double dSnapshotMs = 0;
+    int nThreads = 0;
+    int i;
+
+    for(i=0; i<FILES; i++)
+    {
+        aItems[i].m_sSrcFile = MakePath(TmpFile("bench_log", i));
+        aItems[i].m_sDestFile = MakePath(TmpFile("bench_copy", i));
+        TEST_ASSERT(WriteTestFile(TmpFile("bench_log", i), FILE_SIZE, i+1));
+    }
+
+    // Unbuffered 1 KB reads and writes, as the ReadFile()/WriteFile() loop did
+    timer.Start();
+    for(i=0; i<FILES; i++)
+    {
+        FILE* fSrc = fopen(TmpFile("bench_log", i).c_str(), "rb");
+        FILE* fDest = fopen(TmpFile("bench_copy", i).c_str(), "wb");
+        size_t uRead;
+        bool bOK = fSrc!=NULL && fDest!=NULL;
+        if(bOK)
+        {
+            setvbuf(fSrc, NULL, _IONBF, 0);
+            setvbuf(fDest, NULL, _IONBF, 0);
+            while((uRead=fread(&aBuffer[0], 1, aBuffer.size(), fSrc))!=0)
+            {
+                if(fwrite(&aBuffer[0], 1, uRead, fDest)!=uRead)
+                    bOK = false;
+            }
+        }
+        if(fSrc!=NULL)
+            fclose(fSrc);
+        if(fDest!=NULL)
+            fclose(fDest);
+        TEST_ASSERT(bOK);
+    }
+    dSerialMs = timer.GetElapsedMs();
+
+    {
+        CFileCollector collector;
+        collector.SetSystemCopy(false);
+        timer.Start();
+        TEST_ASSERT(collector.Run(aItems)==0);
+        dReadMs = timer.GetElapsedMs();
+        nThreads = collector.GetThreadCount();
+    }
+
+    {
+        CFileCollector collector;
+        timer.Start();
+        TEST_ASSERT(collector.Run(aItems)==0);
+        dSystemMs = timer.GetElapsedMs();
+    }
+
+    for(i=0; i<FILES; i++)
+    {
+        TEST_ASSERT(aItems[i].m_uSize==FILE_SIZE);
+        aItems[i].m_nMode = FCOLLECT_MODE_SNAPSHOT;
+        remove(TmpFile("bench_copy", i).c_str());
+    }
+
+    {
+        CFileCollector collector;
+        timer.Start();
+        TEST_ASSERT(collector.Run(aItems)==0);
+        dSnapshotMs = timer.GetElapsedMs();
+    }
+
+    printf("\n   %d files of %d MB: 1 KB serial copy %.1f ms, collector with %d threads: "
+        "\n   buffered copy %.1f ms, system copy %.1f ms, snapshot %.2f ms\n   ",
+        FILES, (int)(FILE_SIZE/(1024*1024)), dSerialMs, nThreads, dReadMs, dSystemMs, dSnapshotMs);
+
+    __TEST_CLEANUP__;
+}
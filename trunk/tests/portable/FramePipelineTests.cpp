@@ -0,0 +1,616 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "FramePipeline.h"
+#include "FrameScale.h"
+#include "FrameRingBuffer.h"
+#include "YuvConvert.h"
+#include "ParallelDeflate.h"
+#include <string.h>
+#include <vector>
+
+class FramePipelineTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(FramePipelineTests, "CFramePipeline and CFrameScaler class tests")
+        REGISTER_TEST(Test_Order)
+        REGISTER_TEST(Test_Errors)
+        REGISTER_TEST(Test_MemoryBudget)
+        REGISTER_TEST(Test_ScaleIdentity)
+        REGISTER_TEST(Test_ScaleAverage)
+        REGISTER_TEST(Test_ScaleClip)
+        REGISTER_TEST(Test_Benchmark_Encode)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_Order();
+    void Test_Errors();
+    void Test_MemoryBudget();
+    void Test_ScaleIdentity();
+    void Test_ScaleAverage();
+    void Test_ScaleClip();
+    void Test_Benchmark_Encode();
+
+private:
+
+    // State of a pipeline run checked by the tests
+    struct OrderRun
+    {
+        std::vector<int> m_aSlotFrame;  // Frame read into each slot
+        std::vector<int> m_aSlotValue;  // Value computed for each slot
+        std::vector<int> m_aWritten;    // Values written, in order
+        int m_nRead;                    // Number of frames read
+        int m_nFailRead;                // Frame to fail in a stage, or -1
+        int m_nFailProcess;
+        int m_nFailWrite;
+        bool m_bBadOrder;               // Set if a stage got an unexpected frame
+    };
+
+    static bool OrderRead(int nFrame, int nSlot, void* pParam);
+    static bool OrderProcess(int nFrame, int nSlot, void* pParam);
+    static bool OrderWrite(int nFrame, int nSlot, void* pParam);
+
+    // Video encoding as done by the recorder: restores monitor images from the ring
+    // buffer, composes them into a frame and converts the frame to YV12.
+    struct EncodeRun
+    {
+        CFrameRingBuffer* m_pBuffer;
+        int m_nMonitors;
+        int m_nMonitorWidth;
+        int m_nMonitorHeight;
+        int m_nFrameWidth;
+        int m_nFrameHeight;
+        std::vector< std::vector<unsigned char> > m_aMonitorPixels; // Restored images
+        std::vector< std::vector<unsigned char> > m_aSlotMonitors;  // Images of each slot
+        std::vector< std::vector<unsigned char> > m_aSlotFrame;     // Composed frame of each slot
+        std::vector< std::vector<unsigned char> > m_aSlotYUV;       // YV12 planes of each slot
+        std::vector<CFrameScaler> m_aScalers;                       // Scaler of each slot
+        std::vector<unsigned> m_aChecksums;                         // Checksum of each frame written
+    };
+
+    static void InitEncodeRun(EncodeRun& run, int nSlots);
+    static bool EncodeRead(int nFrame, int nSlot, void* pParam);
+    static bool EncodeProcess(int nFrame, int nSlot, void* pParam);
+    static bool EncodeWrite(int nFrame, int nSlot, void* pParam);
+};
+
+REGISTER_TEST_SUITE( FramePipelineTests );
+
+void FramePipelineTests::SetUp()
+{
+}
+
+void FramePipelineTests::TearDown()
+{
+}
+
+bool FramePipelineTests::OrderRead(int nFrame, int nSlot, void* pParam)
+{
+    OrderRun* pRun = (OrderRun*)pParam;
+
+    if(nFrame!=pRun->m_nRead)
+        pRun->m_bBadOrder = true;
+    pRun->m_nRead++;
+
+    if(nFrame==pRun->m_nFailRead)
+        return false;
+
+    pRun->m_aSlotFrame[nSlot] = nFrame;
+    return true;
+}
+
+bool FramePipelineTests::OrderProcess(int nFrame, int nSlot, void* pParam)
+{
+    OrderRun* pRun = (OrderRun*)pParam;
+
+    if(pRun->m_aSlotFrame[nSlot]!=nFrame)
+        pRun->m_bBadOrder = true;
+
+    // Let frames finish out of order
+    if(nFrame%3==0)
+        CSyncThread::Sleep(2);
+
+    pRun->m_aSlotValue[nSlot] = nFrame*nFrame;
+    return nFrame!=pRun->m_nFailProcess;
+}
+
+bool FramePipelineTests::OrderWrite(int nFrame, int nSlot, void* pParam)
+{
+    OrderRun* pRun = (OrderRun*)pParam;
+
+    if(pRun->m_aSlotFrame[nSlot]!=nFrame || (int)pRun->m_aWritten.size()!=nFrame)
+        pRun->m_bBadOrder = true;
+
+    if(nFrame==pRun->m_nFailWrite)
+        return false;
+
+    pRun->m_aWritten.push_back(pRun->m_aSlotValue[nSlot]);
+    return true;
+}
+
+void FramePipelineTests::Test_Order()
+{
+    // Frames are written in order whatever order workers finish them in
+
+    const int FRAMES = 100;
+    int anThreads[] = {1, 3, 8};
+    int i, j;
+
+    for(i=0; i<(int)(sizeof(anThreads)/sizeof(anThreads[0])); i++)
+    {
+        CFramePipeline pipeline;
+        TEST_ASSERT(pipeline.Init(anThreads[i])==FPIPE_OK);
+        TEST_ASSERT(pipeline.GetThreadCount()==anThreads[i]);
+        TEST_ASSERT(pipeline.GetSlotCount()==2*anThreads[i]);
+
+        // The pipeline is reused between runs
+        int nRun;
+        for(nRun=0; nRun<2; nRun++)
+        {
+            OrderRun run;
+            run.m_aSlotFrame.resize(pipeline.GetSlotCount(), -1);
+            run.m_aSlotValue.resize(pipeline.GetSlotCount(), -1);
+            run.m_nRead = 0;
+            run.m_nFailRead = run.m_nFailProcess = run.m_nFailWrite = -1;
+            run.m_bBadOrder = false;
+
+            TEST_ASSERT(pipeline.Run(FRAMES, OrderRead, OrderProcess, OrderWrite, &run)==FPIPE_OK);
+            TEST_ASSERT(!run.m_bBadOrder);
+            TEST_ASSERT(run.m_nRead==FRAMES);
+            TEST_ASSERT(run.m_aWritten.size()==FRAMES);
+            for(j=0; j<FRAMES; j++)
+            {
+                TEST_ASSERT(run.m_aWritten[j]==j*j);
+            }
+        }
+    }
+
+    // No frames
+    {
+        CFramePipeline pipeline;
+        OrderRun run;
+        run.m_nRead = 0;
+        run.m_bBadOrder = false;
+        TEST_ASSERT(pipeline.Init(2, 3)==FPIPE_OK);
+        TEST_ASSERT(pipeline.GetSlotCount()==3);
+        TEST_ASSERT(pipeline.Run(0, OrderRead, OrderProcess, OrderWrite, &run)==FPIPE_OK);
+        TEST_ASSERT(run.m_nRead==0);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void FramePipelineTests::Test_Errors()
+{
+    // A failed stage stops the run; frames before the failed one are written
+
+    const int FRAMES = 50;
+    const int FAIL_FRAME = 20;
+    int nStage;
+
+    // Not initialized
+    {
+        CFramePipeline pipeline;
+        OrderRun run;
+        TEST_ASSERT(pipeline.Run(FRAMES, OrderRead, OrderProcess, OrderWrite, &run)==FPIPE_ERR_INIT);
+    }
+
+    for(nStage=0; nStage<3; nStage++)
+    {
+        CFramePipeline pipeline;
+        OrderRun run;
+        TEST_ASSERT(pipeline.Init(4)==FPIPE_OK);
+
+        run.m_aSlotFrame.resize(pipeline.GetSlotCount(), -1);
+        run.m_aSlotValue.resize(pipeline.GetSlotCount(), -1);
+        run.m_nRead = 0;
+        run.m_nFailRead = nStage==0 ? FAIL_FRAME : -1;
+        run.m_nFailProcess = nStage==1 ? FAIL_FRAME : -1;
+        run.m_nFailWrite = nStage==2 ? FAIL_FRAME : -1;
+        run.m_bBadOrder = false;
+
+        int nExpected = nStage==0 ? FPIPE_ERR_READ : nStage==1 ? FPIPE_ERR_PROCESS : FPIPE_ERR_WRITE;
+        TEST_ASSERT(pipeline.Run(FRAMES, OrderRead, OrderProcess, OrderWrite, &run)==nExpected);
+        TEST_ASSERT(!run.m_bBadOrder);
+        TEST_ASSERT(run.m_aWritten.size()==FAIL_FRAME);
+
+        // Reading stops soon after the error
+        TEST_ASSERT(run.m_nRead<=FAIL_FRAME+1+pipeline.GetSlotCount());
+
+        // The pipeline may run again
+        run.m_aWritten.clear();
+        run.m_nRead = 0;
+        run.m_nFailRead = run.m_nFailProcess = run.m_nFailWrite = -1;
+        TEST_ASSERT(pipeline.Run(FRAMES, OrderRead, OrderProcess, OrderWrite, &run)==FPIPE_OK);
+        TEST_ASSERT(run.m_aWritten.size()==FRAMES);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void FramePipelineTests::Test_MemoryBudget()
+{
+    // Frames of 2 monitors 3840x2160 (RGB and YUV frame images and monitor images, 
+    // about 120 MB a slot) on 64 processors with 256 MB budget: 2 slots and 2 threads
+    const size_t SLOT_SIZE = (size_t)7680*2160*15/2;
+    const size_t BUDGET = 256*1024*1024;
+    int nThreads = 0;
+    int nSlots = 0;
+
+    CFramePipeline::FitMemoryBudget(SLOT_SIZE, BUDGET, 64, nThreads, nSlots);
+    TEST_ASSERT(nSlots==2 && nThreads==2);
+
+    // Small frames: two slots per thread, a thread per processor (at most FPIPE_MAX_THREADS)
+    CFramePipeline::FitMemoryBudget(640*480*9, BUDGET, 8, nThreads, nSlots);
+    TEST_ASSERT(nSlots==16 && nThreads==8);
+    CFramePipeline::FitMemoryBudget(640*480*9, BUDGET*4, 64, nThreads, nSlots);
+    TEST_ASSERT(nSlots==2*FPIPE_MAX_THREADS && nThreads==FPIPE_MAX_THREADS);
+
+    // Budget allows 5 slots for 4 processors
+    CFramePipeline::FitMemoryBudget(BUDGET/5, BUDGET, 4, nThreads, nSlots);
+    TEST_ASSERT(nSlots==5 && nThreads==4);
+
+    // A slot larger than the budget: the frames are encoded one by one
+    CFramePipeline::FitMemoryBudget(BUDGET*2, BUDGET, 16, nThreads, nSlots);
+    TEST_ASSERT(nSlots==1 && nThreads==1);
+
+    // The counts are accepted by Init()
+    {
+        CFramePipeline pipeline;
+        CFramePipeline::FitMemoryBudget(SLOT_SIZE, BUDGET, 0, nThreads, nSlots);
+        TEST_ASSERT(nSlots>=1 && nThreads>=1 && nThreads<=nSlots);
+        TEST_ASSERT(pipeline.Init(nThreads, nSlots)==FPIPE_OK);
+        TEST_ASSERT(pipeline.GetSlotCount()==nSlots && pipeline.GetThreadCount()==nThreads);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void FramePipelineTests::Test_ScaleIdentity()
+{
+    // An image drawn at its size is copied
+
+    const int WIDTH = 37;
+    const int HEIGHT = 21;
+    const int STRIDE = 120;
+    std::vector<unsigned char> aSrc((size_t)STRIDE*HEIGHT);
+    std::vector<unsigned char> aDst((size_t)WIDTH*3*HEIGHT, 0);
+    CFrameScaler scaler;
+    size_t i;
+    int y;
+
+    for(i=0; i<aSrc.size(); i++)
+        aSrc[i] = (unsigned char)(i*7+i/5);
+
+    scaler.Draw(&aSrc[0], WIDTH, HEIGHT, STRIDE, &aDst[0], WIDTH, HEIGHT, WIDTH*3,
+        0, 0, WIDTH, HEIGHT);
+
+    for(y=0; y<HEIGHT; y++)
+    {
+        TEST_ASSERT(memcmp(&aDst[(size_t)y*WIDTH*3], &aSrc[(size_t)y*STRIDE], WIDTH*3)==0);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void FramePipelineTests::Test_ScaleAverage()
+{
+    // Downscaled pixels are averages of the source areas they cover
+
+    const int WIDTH = 64;
+    const int HEIGHT = 48;
+    std::vector<unsigned char> aSrc((size_t)WIDTH*3*HEIGHT);
+    std::vector<unsigned char> aFlat((size_t)WIDTH*3*HEIGHT, 77);
+    std::vector<unsigned char> aDst;
+    CFrameScaler scaler;
+    int x, y, c;
+
+    for(y=0; y<HEIGHT; y++)
+    {
+        for(x=0; x<WIDTH*3; x++)
+            aSrc[(size_t)y*WIDTH*3+x] = (unsigned char)((x*13+y*29)%256);
+    }
+
+    // Half size: 2x2 blocks
+    aDst.assign((size_t)(WIDTH/2)*3*(HEIGHT/2), 0);
+    scaler.Draw(&aSrc[0], WIDTH, HEIGHT, WIDTH*3, &aDst[0], WIDTH/2, HEIGHT/2, WIDTH/2*3,
+        0, 0, WIDTH/2, HEIGHT/2);
+    for(y=0; y<HEIGHT/2; y++)
+    {
+        for(x=0; x<WIDTH/2; x++)
+        {
+            for(c=0; c<3; c++)
+            {
+                const unsigned char* p = &aSrc[(size_t)(2*y)*WIDTH*3+(2*x)*3+c];
+                int nSum = p[0]+p[3]+p[WIDTH*3]+p[WIDTH*3+3];
+                int nValue = aDst[(size_t)y*(WIDTH/2)*3+x*3+c];
+                TEST_ASSERT(nValue>=nSum/4-1 && nValue<=(nSum+3)/4+1);
+            }
+        }
+    }
+
+    // A third of the width, same height: weights 3 per destination pixel
+    aDst.assign((size_t)(WIDTH/4)*3*HEIGHT, 0);
+    scaler.Draw(&aSrc[0], WIDTH/4*3, HEIGHT, WIDTH*3, &aDst[0], WIDTH/4, HEIGHT, WIDTH/4*3,
+        0, 0, WIDTH/4, HEIGHT);
+    for(y=0; y<HEIGHT; y++)
+    {
+        for(x=0; x<WIDTH/4; x++)
+        {
+            for(c=0; c<3; c++)
+            {
+                const unsigned char* p = &aSrc[(size_t)y*WIDTH*3+(3*x)*3+c];
+                int nSum = p[0]+p[3]+p[6];
+                int nValue = aDst[(size_t)y*(WIDTH/4)*3+x*3+c];
+                TEST_ASSERT(nValue>=nSum/3-1 && nValue<=(nSum+2)/3+1);
+            }
+        }
+    }
+
+    // A flat image stays flat whatever the scale
+    aDst.assign((size_t)29*3*17, 0);
+    scaler.Draw(&aFlat[0], WIDTH, HEIGHT, WIDTH*3, &aDst[0], 29, 17, 29*3, 0, 0, 29, 17);
+    for(x=0; x<(int)aDst.size(); x++)
+    {
+        TEST_ASSERT(aDst[x]==77);
+    }
+
+    // Upscaled twice: every source pixel becomes a 2x2 block
+    aDst.assign((size_t)(WIDTH*2)*3*(HEIGHT*2), 0);
+    scaler.Draw(&aSrc[0], WIDTH, HEIGHT, WIDTH*3, &aDst[0], WIDTH*2, HEIGHT*2, WIDTH*2*3,
+        0, 0, WIDTH*2, HEIGHT*2);
+    for(y=0; y<HEIGHT*2; y++)
+    {
+        for(x=0; x<WIDTH*2*3; x++)
+        {
+            TEST_ASSERT(aDst[(size_t)y*WIDTH*2*3+x]==aSrc[(size_t)(y/2)*WIDTH*3+(x/6)*3+x%3]);
+        }
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void FramePipelineTests::Test_ScaleClip()
+{
+    // Parts of the rectangle outside the destination are clipped; pixels drawn are
+    // the same as in the unclipped image
+
+    const int WIDTH = 50;
+    const int HEIGHT = 40;
+    const int DST_WIDTH = 30;
+    const int DST_HEIGHT = 20;
+    std::vector<unsigned char> aSrc((size_t)WIDTH*3*HEIGHT);
+    std::vector<unsigned char> aFull((size_t)40*3*32, 0);
+    std::vector<unsigned char> aDst((size_t)DST_WIDTH*3*DST_HEIGHT, 1);
+    std::vector<unsigned char> aCopy;
+    CFrameScaler scaler;
+    size_t i;
+    int x, y;
+
+    for(i=0; i<aSrc.size(); i++)
+        aSrc[i] = (unsigned char)(i*11+i/7);
+
+    // Scale to 40x32 unclipped
+    scaler.Draw(&aSrc[0], WIDTH, HEIGHT, WIDTH*3, &aFull[0], 40, 32, 40*3, 0, 0, 40, 32);
+
+    // Same rectangle placed at (-15, 5) in a 30x20 image
+    scaler.Draw(&aSrc[0], WIDTH, HEIGHT, WIDTH*3, &aDst[0], DST_WIDTH, DST_HEIGHT, DST_WIDTH*3,
+        -15, 5, 40, 32);
+
+    for(y=0; y<DST_HEIGHT; y++)
+    {
+        for(x=0; x<DST_WIDTH; x++)
+        {
+            const unsigned char* p = &aDst[(size_t)y*DST_WIDTH*3+x*3];
+            if(y<5 || x>=25)
+            {
+                // Outside the rectangle
+                TEST_ASSERT(p[0]==1 && p[1]==1 && p[2]==1);
+            }
+            else
+            {
+                TEST_ASSERT(memcmp(p, &aFull[(size_t)(y-5)*40*3+(x+15)*3], 3)==0);
+            }
+        }
+    }
+
+    // Rectangles outside the image are not drawn
+    aCopy = aDst;
+    scaler.Draw(&aSrc[0], WIDTH, HEIGHT, WIDTH*3, &aDst[0], DST_WIDTH, DST_HEIGHT, DST_WIDTH*3,
+        DST_WIDTH, 0, 10, 10);
+    scaler.Draw(&aSrc[0], WIDTH, HEIGHT, WIDTH*3, &aDst[0], DST_WIDTH, DST_HEIGHT, DST_WIDTH*3,
+        0, -10, 10, 10);
+    TEST_ASSERT(aCopy==aDst);
+
+    __TEST_CLEANUP__;
+}
+
+void FramePipelineTests::InitEncodeRun(EncodeRun& run, int nSlots)
+{
+    size_t uYSize = (size_t)run.m_nFrameWidth*run.m_nFrameHeight;
+
+    run.m_aMonitorPixels.assign(run.m_nMonitors,
+        std::vector<unsigned char>((size_t)run.m_nMonitorWidth*run.m_nMonitorHeight*3));
+    run.m_aSlotMonitors.assign(nSlots,
+        std::vector<unsigned char>((size_t)run.m_nMonitorWidth*run.m_nMonitorHeight*3*run.m_nMonitors));
+    run.m_aSlotFrame.assign(nSlots, std::vector<unsigned char>(uYSize*3));
+    run.m_aSlotYUV.assign(nSlots, std::vector<unsigned char>(uYSize+2*(uYSize/4)));
+    run.m_aScalers.assign(nSlots, CFrameScaler());
+    run.m_aChecksums.clear();
+}
+
+bool FramePipelineTests::EncodeRead(int nFrame, int nSlot, void* pParam)
+{
+    EncodeRun* pRun = (EncodeRun*)pParam;
+    size_t uImageSize = (size_t)pRun->m_nMonitorWidth*pRun->m_nMonitorHeight*3;
+    int i;
+
+    // Delta images are restored in order over the previous ones
+    for(i=0; i<pRun->m_nMonitors; i++)
+    {
+        if(!pRun->m_pBuffer->ReadImage(pRun->m_pBuffer->GetFrameSlot(nFrame), i,
+            &pRun->m_aMonitorPixels[i][0], pRun->m_nMonitorWidth*3))
+            return false;
+
+        memcpy(&pRun->m_aSlotMonitors[nSlot][i*uImageSize], &pRun->m_aMonitorPixels[i][0], uImageSize);
+    }
+
+    return true;
+}
+
+bool FramePipelineTests::EncodeProcess(int nFrame, int nSlot, void* pParam)
+{
+    EncodeRun* pRun = (EncodeRun*)pParam;
+    size_t uImageSize = (size_t)pRun->m_nMonitorWidth*pRun->m_nMonitorHeight*3;
+    std::vector<unsigned char>& aFrame = pRun->m_aSlotFrame[nSlot];
+    std::vector<unsigned char>& aYUV = pRun->m_aSlotYUV[nSlot];
+    size_t uYSize = (size_t)pRun->m_nFrameWidth*pRun->m_nFrameHeight;
+    int nWidth = pRun->m_nFrameWidth/pRun->m_nMonitors;
+    int i;
+
+    (void)nFrame;
+
+    // Monitors side by side
+    memset(&aFrame[0], 0, aFrame.size());
+    for(i=0; i<pRun->m_nMonitors; i++)
+    {
+        pRun->m_aScalers[nSlot].Draw(&pRun->m_aSlotMonitors[nSlot][i*uImageSize],
+            pRun->m_nMonitorWidth, pRun->m_nMonitorHeight, pRun->m_nMonitorWidth*3,
+            &aFrame[0], pRun->m_nFrameWidth, pRun->m_nFrameHeight, pRun->m_nFrameWidth*3,
+            i*nWidth, 0, nWidth, pRun->m_nFrameHeight);
+    }
+
+    RGB24_To_YV12(&aFrame[0], pRun->m_nFrameWidth, pRun->m_nFrameHeight, pRun->m_nFrameWidth*3,
+        &aYUV[0], pRun->m_nFrameWidth,
+        &aYUV[uYSize], pRun->m_nFrameWidth/2,
+        &aYUV[uYSize+uYSize/4], pRun->m_nFrameWidth/2);
+
+    return true;
+}
+
+bool FramePipelineTests::EncodeWrite(int nFrame, int nSlot, void* pParam)
+{
+    EncodeRun* pRun = (EncodeRun*)pParam;
+    const std::vector<unsigned char>& aYUV = pRun->m_aSlotYUV[nSlot];
+    unsigned uChecksum = 0;
+    size_t i;
+
+    (void)nFrame;
+
+    // Stands in for the encoder
+    for(i=0; i<aYUV.size(); i++)
+        uChecksum = uChecksum*31+aYUV[i];
+
+    pRun->m_aChecksums.push_back(uChecksum);
+    return true;
+}
+
+void FramePipelineTests::Test_Benchmark_Encode()
+{
+    // Encodes frames of two 1080p monitors stored in the ring buffer into 1280x360
+    // YV12 frames: serially, as the recorder did, and through the pipeline with one
+    // worker and a worker per processor. The encoder is replaced with a checksum.
+
+    const int WIDTH = 1920;
+    const int HEIGHT = 1080;
+    const int MONITORS = 2;
+    const int FRAMES = 40;
+    std::vector<unsigned char> aImage((size_t)WIDTH*HEIGHT*3);
+    CFrameRingBuffer buffer;
+    CPerfTimer timer;
+    EncodeRun run;
+    std::vector<unsigned> aSerialChecksums;
+    double dSerialMs = 0;
+    double adPipelineMs[2] = {0, 0};
+    int anThreads[2];
+    int nRuns;
+    int nFrame, nMonitor, i;
+    size_t j;
+
+    TEST_ASSERT(buffer.Init(FRAMES, (size_t)1024*1024*1024, true, 20));
+    for(nFrame=0; nFrame<FRAMES; nFrame++)
+    {
+        buffer.AddFrame();
+        for(nMonitor=0; nMonitor<MONITORS; nMonitor++)
+        {
+            // A window moves every 4 frames
+            int nLeft = 100+(nFrame/4)*37+nMonitor*300;
+            int x, y;
+            for(y=0; y<HEIGHT; y++)
+            {
+                unsigned char* pRow = &aImage[(size_t)y*WIDTH*3];
+                for(x=0; x<WIDTH; x++)
+                {
+                    bool bWindow = x>=nLeft && x<nLeft+800 && y>=200 && y<800;
+                    pRow[x*3] = (unsigned char)(bWindow ? 240 : 120+y/16);
+                    pRow[x*3+1] = (unsigned char)(bWindow ? ((x*7+y*3)%11<3 ? 20 : 240) : 60);
+                    pRow[x*3+2] = (unsigned char)(bWindow ? 240 : x/16);
+                }
+            }
+            TEST_ASSERT(buffer.AddImage(&aImage[0], WIDTH, HEIGHT, WIDTH*3));
+        }
+    }
+
+    run.m_pBuffer = &buffer;
+    run.m_nMonitors = MONITORS;
+    run.m_nMonitorWidth = WIDTH;
+    run.m_nMonitorHeight = HEIGHT;
+    run.m_nFrameWidth = 1280;
+    run.m_nFrameHeight = 360;
+
+    // Serial loop
+    InitEncodeRun(run, 1);
+    timer.Start();
+    for(nFrame=0; nFrame<FRAMES; nFrame++)
+    {
+        TEST_ASSERT(EncodeRead(nFrame, 0, &run));
+        TEST_ASSERT(EncodeProcess(nFrame, 0, &run));
+        TEST_ASSERT(EncodeWrite(nFrame, 0, &run));
+    }
+    dSerialMs = timer.GetElapsedMs();
+    aSerialChecksums = run.m_aChecksums;
+
+    anThreads[0] = 1;
+    anThreads[1] = CParallelDeflate::GetProcessorCount();
+    nRuns = anThreads[1]>1 ? 2 : 1; // No second run on a single processor
+    for(i=0; i<nRuns; i++)
+    {
+        CFramePipeline pipeline;
+        TEST_ASSERT(pipeline.Init(anThreads[i])==FPIPE_OK);
+        InitEncodeRun(run, pipeline.GetSlotCount());
+
+        timer.Start();
+        TEST_ASSERT(pipeline.Run(FRAMES, EncodeRead, EncodeProcess, EncodeWrite, &run)==FPIPE_OK);
+        adPipelineMs[i] = timer.GetElapsedMs();
+
+        // Same frames in the same order
+        TEST_ASSERT(run.m_aChecksums.size()==aSerialChecksums.size());
+        for(j=0; j<aSerialChecksums.size(); j++)
+        {
+            TEST_ASSERT(run.m_aChecksums[j]==aSerialChecksums[j]);
+        }
+    }
+
+    printf("\n   %d frames of %d %dx%d monitors to %dx%d, per frame: serial %.1f ms, "
+        "\n   pipeline with 1 worker %.1f ms",
+        FRAMES, MONITORS, WIDTH, HEIGHT, run.m_nFrameWidth, run.m_nFrameHeight,
+        dSerialMs/FRAMES, adPipelineMs[0]/FRAMES);
+    if(nRuns>1)
+        printf(", with %d workers %.1f ms\n   ", anThreads[1], adPipelineMs[1]/FRAMES);
+    else
+        printf("\n   (single processor, no parallel run to compare)\n   ");
+
+    __TEST_CLEANUP__;
+}
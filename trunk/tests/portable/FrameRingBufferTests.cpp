@@ -0,0 +1,640 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "FrameRingBuffer.h"
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+class FrameRingBufferTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(FrameRingBufferTests, "CFrameRingBuffer class tests")
+        REGISTER_TEST(Test_AddRead)
+        REGISTER_TEST(Test_Wrap)
+        REGISTER_TEST(Test_SizeLimit)
+        REGISTER_TEST(Test_Errors)
+        REGISTER_TEST(Test_DeltaReplay)
+        REGISTER_TEST(Test_DeltaSizeLimit)
+        REGISTER_TEST(Test_Benchmark_Capture)
+        REGISTER_TEST(Test_Benchmark_Delta)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_AddRead();
+    void Test_Wrap();
+    void Test_SizeLimit();
+    void Test_Errors();
+    void Test_DeltaReplay();
+    void Test_DeltaSizeLimit();
+    void Test_Benchmark_Capture();
+    void Test_Benchmark_Delta();
+
+private:
+
+    // An image expected to be restored
+    struct ExpectedImage
+    {
+        int m_nWidth;
+        int m_nHeight;
+        std::vector<unsigned char> m_aPixels; // Rows of m_nWidth*3 bytes
+    };
+
+    // Makes a desktop-like 24-bit image: flat background, windows, text-like details.
+    // nSeed changes the window positions.
+    static void MakeImage(std::vector<unsigned char>& aPixels, int nWidth, int nHeight,
+        int nStride, int nSeed);
+
+    // Returns true if the image stored equals the given pixels
+    static bool CheckImage(CFrameRingBuffer& buffer, int nSlot, int nImage,
+        const std::vector<unsigned char>& aPixels, int nWidth, int nHeight, int nStride);
+
+    // Makes image of a mostly static desktop: windows move every 7 frames and
+    // a caret blinks every frame. Rows are nWidth*3 bytes.
+    static void MakeScene(std::vector<unsigned char>& aPixels, int nWidth, int nHeight, int nFrame);
+
+    // Restores all frames in order, as the video encoder does, and compares them
+    // to the images expected in each slot
+    static bool ReplayFrames(CFrameRingBuffer& buffer,
+        const std::vector< std::vector<ExpectedImage> >& aExpected);
+};
+
+REGISTER_TEST_SUITE( FrameRingBufferTests );
+
+void FrameRingBufferTests::SetUp()
+{
+}
+
+void FrameRingBufferTests::TearDown()
+{
+}
+
+void FrameRingBufferTests::MakeImage(std::vector<unsigned char>& aPixels, int nWidth,
+    int nHeight, int nStride, int nSeed)
+{
+    uint32_t uSeed = 1000+nSeed;
+    int x, y, i;
+
+    aPixels.assign((size_t)nStride*nHeight, 0);
+
+    // Desktop background
+    for(y=0; y<nHeight; y++)
+    {
+        for(x=0; x<nWidth; x++)
+        {
+            unsigned char* p = &aPixels[(size_t)y*nStride+x*3];
+            p[0] = (unsigned char)(160+y*64/nHeight);
+            p[1] = (unsigned char)(100+y*32/nHeight);
+            p[2] = 40;
+        }
+    }
+
+    // Windows with lines of text
+    for(i=0; i<6; i++)
+    {
+        uSeed = uSeed*1103515245+12345;
+        int nLeft = (int)((uSeed>>8)%(nWidth/2+1));
+        int nTop = (int)((uSeed>>4)%(nHeight/2+1));
+        int nRight = nLeft+nWidth/3 < nWidth ? nLeft+nWidth/3 : nWidth;
+        int nBottom = nTop+nHeight/3 < nHeight ? nTop+nHeight/3 : nHeight;
+
+        for(y=nTop; y<nBottom; y++)
+        {
+            for(x=nLeft; x<nRight; x++)
+            {
+                unsigned char* p = &aPixels[(size_t)y*nStride+x*3];
+                bool bText = (y-nTop)%16>4 && (y-nTop)%16<13 && ((x*7+y*3+nSeed)%11)<3;
+                unsigned char c = (y-nTop)<20 ? 200 : (bText ? 30 : 250);
+                p[0] = p[1] = p[2] = c;
+            }
+        }
+    }
+}
+
+bool FrameRingBufferTests::CheckImage(CFrameRingBuffer& buffer, int nSlot, int nImage,
+    const std::vector<unsigned char>& aPixels, int nWidth, int nHeight, int nStride)
+{
+    int nImageWidth = 0;
+    int nImageHeight = 0;
+    if(!buffer.GetImageSize(nSlot, nImage, nImageWidth, nImageHeight) ||
+        nImageWidth!=nWidth || nImageHeight!=nHeight)
+        return false;
+
+    std::vector<unsigned char> aRead((size_t)nStride*nHeight, 0);
+    if(!buffer.ReadImage(nSlot, nImage, &aRead[0], nStride))
+        return false;
+
+    int y;
+    for(y=0; y<nHeight; y++)
+    {
+        if(memcmp(&aRead[(size_t)y*nStride], &aPixels[(size_t)y*nStride], nWidth*3)!=0)
+            return false;
+    }
+
+    return true;
+}
+
+void FrameRingBufferTests::MakeScene(std::vector<unsigned char>& aPixels, int nWidth,
+    int nHeight, int nFrame)
+{
+    MakeImage(aPixels, nWidth, nHeight, nWidth*3, nFrame/7);
+
+    if(nFrame%2)
+    {
+        int x, y;
+        for(y=nHeight/2; y<nHeight/2+12 && y<nHeight; y++)
+        {
+            for(x=nWidth/3; x<nWidth/3+2; x++)
+                memset(&aPixels[(size_t)y*nWidth*3+x*3], 0, 3);
+        }
+    }
+}
+
+bool FrameRingBufferTests::ReplayFrames(CFrameRingBuffer& buffer,
+    const std::vector< std::vector<ExpectedImage> >& aExpected)
+{
+    std::vector< std::vector<unsigned char> > aImages;
+    int nFrame;
+    size_t i;
+
+    if(buffer.GetFrameCount()>0 && !buffer.IsKeyFrame(buffer.GetFrameSlot(0)))
+        return false;
+
+    for(nFrame=0; nFrame<buffer.GetFrameCount(); nFrame++)
+    {
+        int nSlot = buffer.GetFrameSlot(nFrame);
+        const std::vector<ExpectedImage>& aFrame = aExpected[nSlot];
+        if(buffer.GetImageCount(nSlot)!=(int)aFrame.size())
+            return false;
+
+        if(aImages.size()<aFrame.size())
+            aImages.resize(aFrame.size());
+
+        for(i=0; i<aFrame.size(); i++)
+        {
+            const ExpectedImage& image = aFrame[i];
+            int nWidth = 0;
+            int nHeight = 0;
+            if(!buffer.GetImageSize(nSlot, (int)i, nWidth, nHeight) ||
+                nWidth!=image.m_nWidth || nHeight!=image.m_nHeight)
+                return false;
+
+            // Rows are padded, as in DIBs
+            int nStride = (nWidth*3+3)&~3;
+            aImages[i].resize((size_t)nStride*nHeight);
+            if(!buffer.ReadImage(nSlot, (int)i, &aImages[i][0], nStride))
+                return false;
+
+            int y;
+            for(y=0; y<nHeight; y++)
+            {
+                if(memcmp(&aImages[i][(size_t)y*nStride], &image.m_aPixels[(size_t)y*nWidth*3], nWidth*3)!=0)
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void FrameRingBufferTests::Test_AddRead()
+{
+    // Two monitors of odd sizes, rows padded to 4 bytes as in DIBs
+    std::vector<unsigned char> aMonitor1;
+    std::vector<unsigned char> aMonitor2;
+    MakeImage(aMonitor1, 321, 117, 964, 1);
+    MakeImage(aMonitor2, 97, 203, 292, 2);
+
+    int nCompress;
+    for(nCompress=0; nCompress<2; nCompress++)
+    {
+        CFrameRingBuffer buffer;
+        TEST_ASSERT(buffer.Init(4, 64*1024*1024, nCompress!=0));
+        TEST_ASSERT(buffer.GetFrameCount()==0);
+
+        int nSlot = buffer.AddFrame();
+        TEST_ASSERT(nSlot>=0);
+        TEST_ASSERT(buffer.AddImage(&aMonitor1[0], 321, 117, 964));
+
+        // Row by row, as the screen capture adds them
+        TEST_ASSERT(buffer.BeginImage(97, 203));
+        int y;
+        for(y=0; y<203; y++)
+            TEST_ASSERT(buffer.AddImageRow(&aMonitor2[y*292]));
+        TEST_ASSERT(buffer.EndImage());
+
+        TEST_ASSERT(buffer.GetFrameCount()==1);
+        TEST_ASSERT(buffer.GetFrameSlot(0)==nSlot);
+        TEST_ASSERT(buffer.GetImageCount(nSlot)==2);
+        TEST_ASSERT(CheckImage(buffer, nSlot, 0, aMonitor1, 321, 117, 964));
+        TEST_ASSERT(CheckImage(buffer, nSlot, 1, aMonitor2, 97, 203, 292));
+
+        // Compressed images take less memory
+        size_t uRawSize = 321*117*3+97*203*3;
+        if(nCompress)
+        {
+            TEST_ASSERT(buffer.GetDataSize()<uRawSize/4);
+        }
+        else
+        {
+            TEST_ASSERT(buffer.GetDataSize()==uRawSize);
+        }
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void FrameRingBufferTests::Test_Wrap()
+{
+    CFrameRingBuffer buffer;
+    std::vector< std::vector<unsigned char> > aFrames(7);
+    int i;
+
+    TEST_ASSERT(buffer.Init(3, 64*1024*1024, true));
+
+    for(i=0; i<7; i++)
+    {
+        MakeImage(aFrames[i], 64, 48, 192, i);
+        TEST_ASSERT(buffer.AddFrame()==i%3);
+        TEST_ASSERT(buffer.AddImage(&aFrames[i][0], 64, 48, 192));
+        TEST_ASSERT(buffer.GetFrameCount()==(i<3 ? i+1 : 3));
+    }
+
+    // Frames 4, 5 and 6 remain, oldest first
+    for(i=0; i<3; i++)
+    {
+        int nSlot = buffer.GetFrameSlot(i);
+        TEST_ASSERT(nSlot==(4+i)%3);
+        TEST_ASSERT(buffer.GetImageCount(nSlot)==1);
+        TEST_ASSERT(CheckImage(buffer, nSlot, 0, aFrames[4+i], 64, 48, 192));
+    }
+    TEST_ASSERT(buffer.GetFrameSlot(3)==-1);
+
+    // A failed capture is removed
+    buffer.AddFrame();
+    buffer.CancelFrame();
+    TEST_ASSERT(buffer.GetFrameCount()==2);
+    TEST_ASSERT(CheckImage(buffer, buffer.GetFrameSlot(1), 0, aFrames[6], 64, 48, 192));
+
+    __TEST_CLEANUP__;
+}
+
+void FrameRingBufferTests::Test_SizeLimit()
+{
+    CFrameRingBuffer buffer;
+    std::vector<unsigned char> aPixels;
+    const size_t IMAGE_SIZE = 100*100*3;
+    int i;
+
+    MakeImage(aPixels, 100, 100, 300, 0);
+
+    // Room for 2.5 uncompressed frames of 10 slots
+    TEST_ASSERT(buffer.Init(10, IMAGE_SIZE*5/2, false));
+    for(i=0; i<5; i++)
+    {
+        buffer.AddFrame();
+        TEST_ASSERT(buffer.AddImage(&aPixels[0], 100, 100, 300));
+        TEST_ASSERT(buffer.GetDataSize()<=IMAGE_SIZE*5/2);
+    }
+    TEST_ASSERT(buffer.GetFrameCount()==2);
+
+    // The newest frame is kept even if it doesn't fit alone
+    buffer.AddFrame();
+    TEST_ASSERT(buffer.AddImage(&aPixels[0], 100, 100, 300));
+    TEST_ASSERT(buffer.AddImage(&aPixels[0], 100, 100, 300));
+    TEST_ASSERT(buffer.AddImage(&aPixels[0], 100, 100, 300));
+    TEST_ASSERT(buffer.GetFrameCount()==1);
+    TEST_ASSERT(buffer.GetDataSize()==IMAGE_SIZE*3);
+
+    // All memory is released
+    buffer.Destroy();
+    TEST_ASSERT(buffer.GetFrameCount()==0);
+    TEST_ASSERT(buffer.GetDataSize()==0);
+
+    __TEST_CLEANUP__;
+}
+
+void FrameRingBufferTests::Test_Errors()
+{
+    CFrameRingBuffer buffer;
+    unsigned char aRow[30];
+    memset(aRow, 0x55, sizeof(aRow));
+
+    // Not initialized
+    TEST_ASSERT(buffer.AddFrame()==-1);
+    TEST_ASSERT(!buffer.BeginImage(10, 2));
+    TEST_ASSERT(!buffer.Init(0, 1024, true));
+
+    TEST_ASSERT(buffer.Init(2, 1024*1024, true));
+
+    // No frame started
+    TEST_ASSERT(!buffer.BeginImage(10, 2));
+
+    buffer.AddFrame();
+    TEST_ASSERT(!buffer.BeginImage(0, 2));
+    TEST_ASSERT(!buffer.AddImageRow(aRow));
+    TEST_ASSERT(!buffer.EndImage());
+
+    // Missing rows
+    TEST_ASSERT(buffer.BeginImage(10, 2));
+    TEST_ASSERT(buffer.AddImageRow(aRow));
+    TEST_ASSERT(buffer.GetImageCount(buffer.GetFrameSlot(0))==0);
+    TEST_ASSERT(!buffer.EndImage());
+    TEST_ASSERT(buffer.GetImageCount(buffer.GetFrameSlot(0))==0);
+
+    // Extra rows
+    TEST_ASSERT(buffer.BeginImage(10, 1));
+    TEST_ASSERT(buffer.AddImageRow(aRow));
+    TEST_ASSERT(!buffer.AddImageRow(aRow));
+    TEST_ASSERT(buffer.EndImage());
+    TEST_ASSERT(buffer.GetImageCount(buffer.GetFrameSlot(0))==1);
+
+    // An image not finished is discarded with the next frame
+    TEST_ASSERT(buffer.BeginImage(10, 2));
+    TEST_ASSERT(buffer.AddImageRow(aRow));
+    buffer.AddFrame();
+    TEST_ASSERT(buffer.GetImageCount(buffer.GetFrameSlot(0))==1);
+    TEST_ASSERT(buffer.GetImageCount(buffer.GetFrameSlot(1))==0);
+
+    {
+        int nWidth = 0;
+        int nHeight = 0;
+        TEST_ASSERT(!buffer.GetImageSize(buffer.GetFrameSlot(0), 1, nWidth, nHeight));
+        TEST_ASSERT(!buffer.ReadImage(buffer.GetFrameSlot(1), 0, aRow, 30));
+        TEST_ASSERT(!buffer.ReadImage(-1, 0, aRow, 30));
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void FrameRingBufferTests::Test_DeltaReplay()
+{
+    // Replays a sequence of frames of two monitors. The second monitor changes its
+    // size, some captures fail and some images are left unfinished.
+
+    int nCompress;
+    for(nCompress=0; nCompress<2; nCompress++)
+    {
+        CFrameRingBuffer buffer;
+        std::vector< std::vector<ExpectedImage> > aExpected(16);
+        ExpectedImage image1;
+        ExpectedImage image2;
+        int nDeltaFrames = 0;
+        int nFrame;
+
+        TEST_ASSERT(buffer.Init(16, 64*1024*1024, nCompress!=0, 5));
+
+        for(nFrame=0; nFrame<70; nFrame++)
+        {
+            image1.m_nWidth = 200;
+            image1.m_nHeight = 150;
+            MakeScene(image1.m_aPixels, image1.m_nWidth, image1.m_nHeight, nFrame);
+            image2.m_nWidth = nFrame<30 ? 97 : 131;
+            image2.m_nHeight = 61;
+            MakeScene(image2.m_aPixels, image2.m_nWidth, image2.m_nHeight, nFrame+3);
+
+            int nSlot = buffer.AddFrame();
+            TEST_ASSERT(nSlot>=0);
+            aExpected[nSlot].clear();
+            TEST_ASSERT(buffer.AddImage(&image1.m_aPixels[0], image1.m_nWidth, image1.m_nHeight, image1.m_nWidth*3));
+            aExpected[nSlot].push_back(image1);
+            TEST_ASSERT(buffer.AddImage(&image2.m_aPixels[0], image2.m_nWidth, image2.m_nHeight, image2.m_nWidth*3));
+            aExpected[nSlot].push_back(image2);
+
+            if(!buffer.IsKeyFrame(nSlot))
+                nDeltaFrames++;
+
+            if(nFrame%13==12)
+            {
+                // The first monitor is captured, then the capture fails
+                MakeScene(image1.m_aPixels, image1.m_nWidth, image1.m_nHeight, nFrame+7);
+                TEST_ASSERT(buffer.AddFrame()>=0);
+                TEST_ASSERT(buffer.AddImage(&image1.m_aPixels[0], image1.m_nWidth, image1.m_nHeight, image1.m_nWidth*3));
+                TEST_ASSERT(buffer.BeginImage(image2.m_nWidth, image2.m_nHeight));
+                TEST_ASSERT(buffer.AddImageRow(&image2.m_aPixels[0]));
+                buffer.CancelFrame();
+            }
+
+            TEST_ASSERT(ReplayFrames(buffer, aExpected));
+
+            // Frames are dropped in groups of up to 5
+            if(nFrame>=16)
+                TEST_ASSERT(buffer.GetFrameCount()>=12);
+
+            if(nFrame%11==10)
+            {
+                // An unfinished image, discarded by the next frame
+                MakeScene(image1.m_aPixels, image1.m_nWidth, image1.m_nHeight, nFrame+5);
+                TEST_ASSERT(buffer.BeginImage(image1.m_nWidth, image1.m_nHeight));
+                TEST_ASSERT(buffer.AddImageRow(&image1.m_aPixels[0]));
+                TEST_ASSERT(buffer.AddImageRow(&image1.m_aPixels[image1.m_nWidth*3]));
+            }
+        }
+
+        TEST_ASSERT(nDeltaFrames>40);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void FrameRingBufferTests::Test_DeltaSizeLimit()
+{
+    CFrameRingBuffer buffer;
+    std::vector< std::vector<ExpectedImage> > aExpected(50);
+    ExpectedImage image;
+    const size_t IMAGE_SIZE = 100*100*3;
+    int nFrame;
+
+    image.m_nWidth = 100;
+    image.m_nHeight = 100;
+
+    // Room for 3 uncompressed key frames, deltas are about 10 times smaller
+    TEST_ASSERT(buffer.Init(50, IMAGE_SIZE*3, false, 4));
+    for(nFrame=0; nFrame<40; nFrame++)
+    {
+        MakeScene(image.m_aPixels, 100, 100, 1+nFrame%2);
+        int nSlot = buffer.AddFrame();
+        TEST_ASSERT(buffer.AddImage(&image.m_aPixels[0], 100, 100, 300));
+        aExpected[nSlot].clear();
+        aExpected[nSlot].push_back(image);
+
+        TEST_ASSERT(buffer.GetDataSize()<=IMAGE_SIZE*3);
+        TEST_ASSERT(ReplayFrames(buffer, aExpected));
+    }
+
+    // Two groups of a key frame and 3 deltas fit
+    TEST_ASSERT(buffer.GetFrameCount()>=5);
+    TEST_ASSERT(buffer.GetDataSize()<IMAGE_SIZE*3);
+
+    __TEST_CLEANUP__;
+}
+
+void FrameRingBufferTests::Test_Benchmark_Capture()
+{
+    // Records 1080p frames of two monitors the old way (a BMP file per monitor, read
+    // back by the encoder) and to the ring buffer with and without compression.
+
+    const int WIDTH = 1920;
+    const int HEIGHT = 1080;
+    const int STRIDE = WIDTH*3;
+    const int FRAMES = 20;
+    const int MONITORS = 2;
+    std::vector< std::vector<unsigned char> > aImages(4);
+    std::vector<unsigned char> aRead((size_t)STRIDE*HEIGHT);
+    CPerfTimer timer;
+    double dFileMs = 0;
+    double dRawMs = 0;
+    double dCompressedMs = 0;
+    size_t uFileBytes = 0;
+    size_t uRawBytes = 0;
+    size_t uCompressedBytes = 0;
+    std::vector<FILE*> aFiles;
+    int i, nFrame, nMonitor;
+
+    for(i=0; i<(int)aImages.size(); i++)
+        MakeImage(aImages[i], WIDTH, HEIGHT, STRIDE, i);
+
+    timer.Start();
+    for(nFrame=0; nFrame<FRAMES; nFrame++)
+    {
+        for(nMonitor=0; nMonitor<MONITORS; nMonitor++)
+        {
+            FILE* f = tmpfile();
+            TEST_ASSERT(f!=NULL);
+            aFiles.push_back(f);
+            const std::vector<unsigned char>& aImage = aImages[(nFrame+nMonitor)%aImages.size()];
+            TEST_ASSERT(fwrite(&aImage[0], 1, aImage.size(), f)==aImage.size());
+            fflush(f);
+            uFileBytes += aImage.size();
+        }
+    }
+    for(i=0; i<(int)aFiles.size(); i++)
+    {
+        rewind(aFiles[i]);
+        TEST_ASSERT(fread(&aRead[0], 1, aRead.size(), aFiles[i])==aRead.size());
+    }
+    dFileMs = timer.GetElapsedMs();
+
+    int nCompress;
+    for(nCompress=0; nCompress<2; nCompress++)
+    {
+        CFrameRingBuffer buffer;
+        TEST_ASSERT(buffer.Init(FRAMES, (size_t)1024*1024*1024, nCompress!=0));
+
+        timer.Start();
+        for(nFrame=0; nFrame<FRAMES; nFrame++)
+        {
+            buffer.AddFrame();
+            for(nMonitor=0; nMonitor<MONITORS; nMonitor++)
+            {
+                const std::vector<unsigned char>& aImage = aImages[(nFrame+nMonitor)%aImages.size()];
+                TEST_ASSERT(buffer.AddImage(&aImage[0], WIDTH, HEIGHT, STRIDE));
+            }
+        }
+        for(nFrame=0; nFrame<FRAMES; nFrame++)
+        {
+            for(nMonitor=0; nMonitor<MONITORS; nMonitor++)
+                TEST_ASSERT(buffer.ReadImage(buffer.GetFrameSlot(nFrame), nMonitor, &aRead[0], STRIDE));
+        }
+
+        if(nCompress)
+        {
+            dCompressedMs = timer.GetElapsedMs();
+            uCompressedBytes = buffer.GetDataSize();
+        }
+        else
+        {
+            dRawMs = timer.GetElapsedMs();
+            uRawBytes = buffer.GetDataSize();
+        }
+    }
+
+    TEST_ASSERT(memcmp(&aRead[0], &aImages[(FRAMES-1+MONITORS-1)%aImages.size()][0], aRead.size())==0);
+    TEST_ASSERT(uCompressedBytes<uRawBytes/10);
+
+    printf("\n   %d frames of %d %dx%d monitors, per frame: BMP files %.1f ms (%u MB written), "
+        "\n   ring buffer %.1f ms (%u MB in memory), compressed %.1f ms (%u KB in memory)\n   ",
+        FRAMES, MONITORS, WIDTH, HEIGHT,
+        dFileMs/FRAMES, (unsigned)(uFileBytes/(1024*1024)),
+        dRawMs/FRAMES, (unsigned)(uRawBytes/(1024*1024)),
+        dCompressedMs/FRAMES, (unsigned)(uCompressedBytes/1024));
+
+    __TEST_CLEANUP__;
+
+    for(i=0; i<(int)aFiles.size(); i++)
+        fclose(aFiles[i]);
+}
+
+void FrameRingBufferTests::Test_Benchmark_Delta()
+{
+    // Records a mostly static desktop of two 1080p monitors with and without
+    // delta capture, then restores the frames in order as the encoder does.
+
+    const int WIDTH = 1920;
+    const int HEIGHT = 1080;
+    const int FRAMES = 40;
+    const int MONITORS = 2;
+    std::vector<unsigned char> aScene;
+    std::vector< std::vector<unsigned char> > aRead(MONITORS);
+    CPerfTimer timer;
+    double adCaptureMs[2] = {0, 0};
+    double adReadMs[2] = {0, 0};
+    size_t auBytes[2] = {0, 0};
+    int nDelta, nFrame, nMonitor;
+
+    for(nDelta=0; nDelta<2; nDelta++)
+    {
+        CFrameRingBuffer buffer;
+        TEST_ASSERT(buffer.Init(FRAMES, (size_t)1024*1024*1024, true, nDelta ? 20 : 1));
+
+        for(nFrame=0; nFrame<FRAMES; nFrame++)
+        {
+            buffer.AddFrame();
+            for(nMonitor=0; nMonitor<MONITORS; nMonitor++)
+            {
+                MakeScene(aScene, WIDTH, HEIGHT, (nFrame/10)*7+nFrame%2+nMonitor*7);
+
+                timer.Start();
+                TEST_ASSERT(buffer.AddImage(&aScene[0], WIDTH, HEIGHT, WIDTH*3));
+                adCaptureMs[nDelta] += timer.GetElapsedMs();
+            }
+        }
+        auBytes[nDelta] = buffer.GetDataSize();
+
+        timer.Start();
+        for(nFrame=0; nFrame<FRAMES; nFrame++)
+        {
+            for(nMonitor=0; nMonitor<MONITORS; nMonitor++)
+            {
+                aRead[nMonitor].resize((size_t)WIDTH*HEIGHT*3);
+                TEST_ASSERT(buffer.ReadImage(buffer.GetFrameSlot(nFrame), nMonitor, &aRead[nMonitor][0], WIDTH*3));
+            }
+        }
+        adReadMs[nDelta] = timer.GetElapsedMs();
+
+        // The last frame is restored exactly
+        TEST_ASSERT(memcmp(&aRead[MONITORS-1][0], &aScene[0], aScene.size())==0);
+    }
+
+    TEST_ASSERT(auBytes[1]<auBytes[0]/5);
+
+    printf("\n   %d frames of %d %dx%d monitors, per frame: whole frames %.1f ms, %u KB (read %.1f ms), "
+        "\n   delta capture %.1f ms, %u KB (read %.1f ms)\n   ",
+        FRAMES, MONITORS, WIDTH, HEIGHT,
+        adCaptureMs[0]/FRAMES, (unsigned)(auBytes[0]/FRAMES/1024), adReadMs[0]/FRAMES,
+        adCaptureMs[1]/FRAMES, (unsigned)(auBytes[1]/FRAMES/1024), adReadMs[1]/FRAMES);
+
+    __TEST_CLEANUP__;
+}
@@ -0,0 +1,493 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#ifdef __linux__
+
+#include "PortableTests.h"
+#include "LinuxCrashHandler.h"
+#include "LinuxDumpWriter.h"
+#include "MinidumpParser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+
+class LinuxCrashHandlerTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(LinuxCrashHandlerTests, "CLinuxCrashHandler and CLinuxDumpWriter class tests")
+        REGISTER_TEST(Test_WriteDump)
+        REGISTER_TEST(Test_CrashToDump)
+        REGISTER_TEST(Test_ThreadStackOverflow)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_WriteDump();
+    void Test_CrashToDump();
+    void Test_ThreadStackOverflow();
+
+private:
+
+    // Body of a thread of the dumped process, blocks until the process exits
+    static void* IdleThread(void* pParam);
+
+    // Body of a thread that installs its signal stack and overflows its stack
+    static void* OverflowThread(void* pParam);
+
+    // Recurses until the stack overflows
+    static int Recurse(volatile int* pnDepth);
+
+    // Runs a child process that installs the crash handler and crashes with the signal,
+    // in a second thread if bThread is set (SIGSEGV is then a stack overflow).
+    // Returns the time from the crash to the termination of the process (ms), or a
+    // negative value on failure.
+    double RunCrash(int nSignal, bool bThread = false);
+
+    // Returns the report folder made by the helper for the crash, or an empty string
+    std::string FindReportDir();
+
+    // Removes the folder with its contents
+    static void RemoveTree(const std::string& sPath);
+
+    static double GetTimeMs();
+
+    static std::string ReadTextFile(const std::string& sPath);
+
+    std::string m_sFolder;   // Temporary reports folder
+    std::string m_sLogFile;  // File included into reports
+};
+
+REGISTER_TEST_SUITE( LinuxCrashHandlerTests );
+
+void LinuxCrashHandlerTests::SetUp()
+{
+    char szName[64];
+    sprintf(szName, "LinuxCrashHandlerTests_%d", (int)getpid());
+    m_sFolder = szName;
+    m_sLogFile = m_sFolder+".log";
+    RemoveTree(m_sFolder);
+
+    FILE* f = fopen(m_sLogFile.c_str(), "wb");
+    if(f!=NULL)
+    {
+        fputs("Application log\n", f);
+        fclose(f);
+    }
+}
+
+void LinuxCrashHandlerTests::TearDown()
+{
+    RemoveTree(m_sFolder);
+    remove(m_sLogFile.c_str());
+}
+
+void* LinuxCrashHandlerTests::IdleThread(void* pParam)
+{
+    int fd = *(int*)pParam;
+    char ch;
+    while(read(fd, &ch, 1)<0)
+        ;
+    return NULL;
+}
+
+int LinuxCrashHandlerTests::Recurse(volatile int* pnDepth)
+{
+    volatile char achFrame[256];
+    achFrame[0] = (char)*pnDepth;
+    (*pnDepth)++;
+    return Recurse(pnDepth)+achFrame[0];
+}
+
+void* LinuxCrashHandlerTests::OverflowThread(void* pParam)
+{
+    (void)pParam;
+    volatile int nDepth = 0;
+    if(CLinuxCrashHandler::InstallToCurrentThread()!=LCRASH_OK)
+        _exit(5);
+    Recurse(&nDepth);
+    return NULL;
+}
+
+double LinuxCrashHandlerTests::GetTimeMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec*1000.0+(double)ts.tv_nsec/1e6;
+}
+
+std::string LinuxCrashHandlerTests::ReadTextFile(const std::string& sPath)
+{
+    std::string s;
+    FILE* f = fopen(sPath.c_str(), "rb");
+    if(f==NULL)
+        return s;
+
+    char szBuf[4096];
+    size_t uRead;
+    while((uRead=fread(szBuf, 1, sizeof(szBuf), f))!=0)
+        s.append(szBuf, uRead);
+    fclose(f);
+    return s;
+}
+
+void LinuxCrashHandlerTests::RemoveTree(const std::string& sPath)
+{
+    DIR* pDir = opendir(sPath.c_str());
+    if(pDir!=NULL)
+    {
+        struct dirent* pEntry;
+        while((pEntry=readdir(pDir))!=NULL)
+        {
+            if(strcmp(pEntry->d_name, ".")==0 || strcmp(pEntry->d_name, "..")==0)
+                continue;
+            RemoveTree(sPath+"/"+pEntry->d_name);
+        }
+        closedir(pDir);
+        rmdir(sPath.c_str());
+    }
+    else
+        remove(sPath.c_str());
+}
+
+std::string LinuxCrashHandlerTests::FindReportDir()
+{
+    std::string sAppDir = m_sFolder+"/CrashTest_1.0";
+    std::string sReportDir;
+
+    DIR* pDir = opendir(sAppDir.c_str());
+    if(pDir==NULL)
+        return sReportDir;
+
+    struct dirent* pEntry;
+    while((pEntry=readdir(pDir))!=NULL)
+    {
+        if(strlen(pEntry->d_name)==36)
+            sReportDir = sAppDir+"/"+pEntry->d_name;
+    }
+    closedir(pDir);
+    return sReportDir;
+}
+
+double LinuxCrashHandlerTests::RunCrash(int nSignal, bool bThread)
+{
+    int afd[2];
+    if(pipe(afd)!=0)
+        return -1;
+
+    pid_t nPid = fork();
+    if(nPid<0)
+    {
+        close(afd[0]);
+        close(afd[1]);
+        return -1;
+    }
+
+    if(nPid==0)
+    {
+        close(afd[0]);
+
+        // No core file, the minidump is enough
+        struct rlimit rl;
+        rl.rlim_cur = 0;
+        rl.rlim_max = 0;
+        setrlimit(RLIMIT_CORE, &rl);
+
+        LinuxCrashHandlerInfo Info;
+        Info.m_sAppName = "CrashTest";
+        Info.m_sAppVersion = "1.0";
+        Info.m_sReportsFolder = m_sFolder;
+        Info.m_sHelperPath = LCRASH_TEST_HELPER_PATH;
+        LinuxCrashFile LogFile;
+        LogFile.m_sSrcFile = m_sLogFile;
+        LogFile.m_sDestFile = "app.log";
+        LogFile.m_sDesc = "Log <main>";
+        Info.m_aFiles.push_back(LogFile);
+
+        CLinuxCrashHandler Handler;
+        if(Handler.Install(Info)!=LCRASH_OK)
+            _exit(2);
+
+        double dCrashTime = GetTimeMs();
+        if(write(afd[1], &dCrashTime, sizeof(dCrashTime))!=(ssize_t)sizeof(dCrashTime))
+            _exit(3);
+
+        if(bThread)
+        {
+            // A small stack overflows quickly
+            pthread_attr_t Attr;
+            pthread_t th;
+            pthread_attr_init(&Attr);
+            pthread_attr_setstacksize(&Attr, 256*1024);
+            if(pthread_create(&th, &Attr, OverflowThread, NULL)!=0)
+                _exit(4);
+            pthread_join(th, NULL);
+        }
+        else if(nSignal==SIGSEGV)
+            *(volatile int*)NULL = 1;
+        else
+            abort();
+        _exit(4);
+    }
+
+    close(afd[1]);
+
+    double dCrashTime = 0;
+    bool bRead = read(afd[0], &dCrashTime, sizeof(dCrashTime))==(ssize_t)sizeof(dCrashTime);
+    close(afd[0]);
+
+    int nStatus = 0;
+    while(waitpid(nPid, &nStatus, 0)<0)
+        ;
+    double dLatency = GetTimeMs()-dCrashTime;
+
+    if(!bRead || !WIFSIGNALED(nStatus) || WTERMSIG(nStatus)!=nSignal)
+        return -1;
+
+    return dLatency;
+}
+
+void LinuxCrashHandlerTests::Test_WriteDump()
+{
+    // Captures a running process with two extra threads
+
+    int afd[2] = {-1, -1};
+    pid_t nPid = -1;
+    bool bReady = false;
+    int nStatus = 0;
+    CLinuxDumpWriter Writer;
+    LinuxCrashInfo Info;
+    CMiniDumpParser Parser;
+    MdmpSysInfoRecord SysInfo;
+    MdmpExceptionRecord Exception;
+    std::vector<MdmpThreadRecord> aThreads;
+    std::vector<MdmpModuleRecord> aModules;
+    std::string sDumpFile = m_sFolder+".dmp";
+    char szExe[4096];
+    ssize_t nExeLen = readlink("/proc/self/exe", szExe, sizeof(szExe)-1);
+    bool bFoundExe = false;
+    size_t i;
+
+    szExe[nExeLen>0?nExeLen:0] = 0;
+
+    TEST_ASSERT(pipe(afd)==0);
+
+    nPid = fork();
+    TEST_ASSERT(nPid>=0);
+    if(nPid==0)
+    {
+        // Threads wait until the write end is closed
+        close(afd[1]);
+        pthread_t ath[2];
+        pthread_create(&ath[0], NULL, IdleThread, &afd[0]);
+        pthread_create(&ath[1], NULL, IdleThread, &afd[0]);
+        IdleThread(&afd[0]);
+        _exit(0);
+    }
+    close(afd[0]);
+    afd[0] = -1;
+
+    // Wait until the child has three threads
+    for(i=0; i<100; i++)
+    {
+        char szTask[64];
+        sprintf(szTask, "/proc/%d/task", (int)nPid);
+        int nCount = 0;
+        DIR* pDir = opendir(szTask);
+        if(pDir!=NULL)
+        {
+            struct dirent* pEntry;
+            while((pEntry=readdir(pDir))!=NULL)
+                if(pEntry->d_name[0]!='.')
+                    nCount++;
+            closedir(pDir);
+        }
+        if(nCount==3)
+        {
+            bReady = true;
+            break;
+        }
+        usleep(10*1000);
+    }
+    TEST_ASSERT(bReady);
+
+    memset(&Info, 0, sizeof(Info));
+    Info.m_nPid = nPid;
+    Info.m_nTid = nPid;
+    TEST_ASSERT(Writer.WriteDump(Info, sDumpFile.c_str())==LDUMP_OK);
+    TEST_ASSERT(Writer.GetThreadCount()==3);
+
+    // The process runs on after the dump is written
+    close(afd[1]);
+    afd[1] = -1;
+    TEST_ASSERT(waitpid(nPid, &nStatus, 0)==nPid);
+    nPid = -1;
+    TEST_ASSERT(WIFEXITED(nStatus) && WEXITSTATUS(nStatus)==0);
+
+    TEST_ASSERT(Parser.OpenFile(sDumpFile.c_str())==MDMP_OK);
+    TEST_ASSERT(Parser.ReadSysInfoStream(SysInfo)==MDMP_OK);
+    TEST_ASSERT(SysInfo.m_ulPlatformId==LDUMP_PLATFORM_LINUX);
+#if defined(__x86_64__)
+    TEST_ASSERT(SysInfo.m_uProcessorArchitecture==9);
+#endif
+    TEST_ASSERT(SysInfo.m_uchNumberOfProcessors>0);
+
+    // No signal, no exception stream
+    TEST_ASSERT(Parser.ReadExceptionStream(Exception)!=MDMP_OK);
+
+    TEST_ASSERT(Parser.ReadThreadListStream(aThreads)==MDMP_OK);
+    TEST_ASSERT(aThreads.size()==3);
+    TEST_ASSERT(aThreads[0].m_uThreadId==(uint32_t)Info.m_nPid || aThreads[1].m_uThreadId==(uint32_t)Info.m_nPid ||
+        aThreads[2].m_uThreadId==(uint32_t)Info.m_nPid);
+#if defined(__x86_64__)
+    for(i=0; i<aThreads.size(); i++)
+    {
+        TEST_ASSERT(aThreads[i].m_pThreadContext!=NULL);
+        TEST_ASSERT(aThreads[i].m_Stack.m_uDataSize>0);
+    }
+#endif
+
+    TEST_ASSERT(Parser.ReadModuleListStream(aModules)==MDMP_OK);
+    for(i=0; i<aModules.size(); i++)
+    {
+        std::string sName(aModules[i].m_sImageName.begin(), aModules[i].m_sImageName.end());
+        if(sName==szExe)
+        {
+            bFoundExe = true;
+            TEST_ASSERT(aModules[i].m_uImageSize>0);
+        }
+    }
+    TEST_ASSERT(bFoundExe);
+
+    __TEST_CLEANUP__;
+
+    if(afd[0]>=0)
+        close(afd[0]);
+    if(afd[1]>=0)
+        close(afd[1]);
+    if(nPid>0)
+    {
+        kill(nPid, SIGKILL);
+        waitpid(nPid, NULL, 0);
+    }
+    Parser.Close();
+    remove(sDumpFile.c_str());
+}
+
+void LinuxCrashHandlerTests::Test_CrashToDump()
+{
+    // Crashes a child process with SIGSEGV and SIGABRT, checks the report written by
+    // the helper and measures the time from the crash until the process is terminated
+    // (the minidump is written by then)
+
+    const int SIGNALS = 2;
+    const int anSignals[SIGNALS] = {SIGSEGV, SIGABRT};
+    const char* aszExceptionTypes[SIGNALS] = {"<ExceptionType>11</ExceptionType>", "<ExceptionType>7</ExceptionType>"};
+    double adLatency[SIGNALS] = {0, 0};
+    std::string sReportDir;
+    std::string sXml;
+    CMiniDumpParser Parser;
+    MdmpExceptionRecord Exception;
+    std::vector<MdmpThreadRecord> aThreads;
+    int n, i;
+
+    for(n=0; n<SIGNALS; n++)
+    {
+        RemoveTree(m_sFolder);
+
+        adLatency[n] = RunCrash(anSignals[n]);
+        TEST_ASSERT(adLatency[n]>=0);
+
+        // The minidump is written before the process is let go, the description follows
+        sReportDir = FindReportDir();
+        TEST_ASSERT(!sReportDir.empty());
+        for(i=0; i<1000; i++)
+        {
+            sXml = ReadTextFile(sReportDir+"/crashrpt.xml");
+            if(!sXml.empty())
+                break;
+            usleep(10*1000);
+        }
+
+        TEST_ASSERT(sXml.find("<AppName>CrashTest</AppName>")!=std::string::npos);
+        TEST_ASSERT(sXml.find(aszExceptionTypes[n])!=std::string::npos);
+        TEST_ASSERT(sXml.find("<FileItem name=\"crashdump.dmp\"")!=std::string::npos);
+        TEST_ASSERT(sXml.find("<FileItem name=\"app.log\" description=\"Log &lt;main&gt;\"")!=std::string::npos);
+        TEST_ASSERT(ReadTextFile(sReportDir+"/app.log")=="Application log\n");
+
+        TEST_ASSERT(Parser.OpenFile((sReportDir+"/crashdump.dmp").c_str())==MDMP_OK);
+        TEST_ASSERT(Parser.ReadExceptionStream(Exception)==MDMP_OK);
+        TEST_ASSERT(Exception.m_uExceptionCode==(uint32_t)anSignals[n]);
+        aThreads.clear();
+        TEST_ASSERT(Parser.ReadThreadListStream(aThreads)==MDMP_OK);
+        TEST_ASSERT(aThreads.size()==1);
+        TEST_ASSERT(aThreads[0].m_uThreadId==Exception.m_uThreadId);
+#if defined(__x86_64__)
+        TEST_ASSERT(Exception.m_pThreadContext!=NULL);
+        TEST_ASSERT(Exception.m_uExceptionAddress!=0);
+        TEST_ASSERT(sXml.find("<ExceptionModule>")!=std::string::npos);
+#endif
+        Parser.Close();
+    }
+
+    printf("\n   Crash to dump written and process terminated: SIGSEGV %.1f ms, SIGABRT %.1f ms\n   ",
+        adLatency[0], adLatency[1]);
+
+    __TEST_CLEANUP__;
+
+    Parser.Close();
+}
+
+void LinuxCrashHandlerTests::Test_ThreadStackOverflow()
+{
+    // A thread created after Install() overflows its stack; it has called
+    // InstallToCurrentThread(), so the signal handler runs and the report is written
+
+    std::string sReportDir;
+    std::string sXml;
+    CMiniDumpParser Parser;
+    MdmpExceptionRecord Exception;
+    int i;
+
+    RemoveTree(m_sFolder);
+    TEST_ASSERT(RunCrash(SIGSEGV, true)>=0);
+
+    sReportDir = FindReportDir();
+    TEST_ASSERT(!sReportDir.empty());
+    for(i=0; i<1000; i++)
+    {
+        sXml = ReadTextFile(sReportDir+"/crashrpt.xml");
+        if(!sXml.empty())
+            break;
+        usleep(10*1000);
+    }
+    TEST_ASSERT(sXml.find("<ExceptionType>11</ExceptionType>")!=std::string::npos);
+
+    TEST_ASSERT(Parser.OpenFile((sReportDir+"/crashdump.dmp").c_str())==MDMP_OK);
+    TEST_ASSERT(Parser.ReadExceptionStream(Exception)==MDMP_OK);
+    TEST_ASSERT(Exception.m_uExceptionCode==(uint32_t)SIGSEGV);
+
+    __TEST_CLEANUP__;
+
+    Parser.Close();
+}
+
+#endif // __linux__
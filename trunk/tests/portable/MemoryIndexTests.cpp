@@ -0,0 +1,257 @@
+/************************************************************************************* 
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "MinidumpParser.h"
+#include <list>
+
+class MemoryIndexTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(MemoryIndexTests, "CMdmpMemoryIndex class tests")
+        REGISTER_TEST(Test_FindRange)
+        REGISTER_TEST(Test_Read_Stitching)
+        REGISTER_TEST(Test_Build_Overlapping)
+        REGISTER_TEST(Test_Benchmark_Lookup)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_FindRange();
+    void Test_Read_Stitching();
+    void Test_Build_Overlapping();
+    void Test_Benchmark_Lookup();
+
+private:
+
+    // Adds a range whose bytes are filled with the given value
+    void AddRange(std::vector<MdmpMemRangeRecord>& aRanges, uint64_t uStart, 
+        size_t uSize, uint8_t uchFill);
+
+    std::list<std::vector<uint8_t> > m_aBuffers; // Range data
+};
+
+REGISTER_TEST_SUITE( MemoryIndexTests );
+
+void MemoryIndexTests::SetUp()
+{
+}
+
+void MemoryIndexTests::TearDown()
+{
+    m_aBuffers.clear();
+}
+
+void MemoryIndexTests::AddRange(std::vector<MdmpMemRangeRecord>& aRanges, 
+    uint64_t uStart, size_t uSize, uint8_t uchFill)
+{
+    m_aBuffers.push_back(std::vector<uint8_t>(uSize, uchFill));
+
+    MdmpMemRangeRecord mr;
+    mr.m_uStartOfMemoryRange = uStart;
+    mr.m_uDataSize = uSize;
+    mr.m_pStartPtr = &m_aBuffers.back()[0];
+    aRanges.push_back(mr);
+}
+
+void MemoryIndexTests::Test_FindRange()
+{
+    CMdmpMemoryIndex index;
+    std::vector<MdmpMemRangeRecord> aRanges;
+    const MdmpMemRangeRecord* pRange = NULL;
+
+    // Ranges are not sorted
+    AddRange(aRanges, 0x3000, 0x100, 3);
+    AddRange(aRanges, 0x1000, 0x100, 1);
+    AddRange(aRanges, 0x2000, 0x100, 2);
+
+    // Empty index
+    TEST_ASSERT(index.GetRangeCount()==0);
+    TEST_ASSERT(index.FindRange(0x1000)==NULL);
+
+    index.Build(aRanges);
+    TEST_ASSERT(index.GetRangeCount()==3);
+
+    pRange = index.FindRange(0x1000);
+    TEST_ASSERT(pRange!=NULL && pRange->m_uStartOfMemoryRange==0x1000);
+
+    pRange = index.FindRange(0x10FF);
+    TEST_ASSERT(pRange!=NULL && pRange->m_uStartOfMemoryRange==0x1000);
+
+    pRange = index.FindRange(0x3050);
+    TEST_ASSERT(pRange!=NULL && pRange->m_pStartPtr[0]==3);
+
+    // Addresses before, between and after ranges
+    TEST_ASSERT(index.FindRange(0)==NULL);
+    TEST_ASSERT(index.FindRange(0xFFF)==NULL);
+    TEST_ASSERT(index.FindRange(0x1100)==NULL);
+    TEST_ASSERT(index.FindRange(0x3100)==NULL);
+    TEST_ASSERT(index.FindRange((uint64_t)-1)==NULL);
+
+    index.Clear();
+    TEST_ASSERT(index.GetRangeCount()==0);
+
+    __TEST_CLEANUP__;
+}
+
+void MemoryIndexTests::Test_Read_Stitching()
+{
+    CMdmpMemoryIndex index;
+    std::vector<MdmpMemRangeRecord> aRanges;
+    uint8_t buf[0x300];
+    size_t uRead = 0;
+
+    // Two adjacent ranges, then a gap, then one more range
+    AddRange(aRanges, 0x1100, 0x100, 2);
+    AddRange(aRanges, 0x1000, 0x100, 1);
+    AddRange(aRanges, 0x1300, 0x100, 3);
+    index.Build(aRanges);
+
+    // Read inside of a single range
+    memset(buf, 0, sizeof(buf));
+    uRead = index.Read(0x1010, buf, 0x10);
+    TEST_ASSERT(uRead==0x10);
+    TEST_ASSERT(buf[0]==1 && buf[0xF]==1 && buf[0x10]==0);
+
+    // Read crossing the boundary of adjacent ranges is stitched together
+    memset(buf, 0, sizeof(buf));
+    uRead = index.Read(0x10F0, buf, 0x20);
+    TEST_ASSERT(uRead==0x20);
+    TEST_ASSERT(buf[0]==1 && buf[0xF]==1 && buf[0x10]==2 && buf[0x1F]==2);
+
+    // Read running into the gap is truncated at the end of captured memory
+    memset(buf, 0, sizeof(buf));
+    uRead = index.Read(0x1000, buf, 0x300);
+    TEST_ASSERT(uRead==0x200);
+    TEST_ASSERT(buf[0x1FF]==2 && buf[0x200]==0);
+
+    // Read starting in the gap fails
+    uRead = index.Read(0x1250, buf, 0x10);
+    TEST_ASSERT(uRead==0);
+
+    // Read at the very end of the last range
+    uRead = index.Read(0x13FF, buf, 0x10);
+    TEST_ASSERT(uRead==1 && buf[0]==3);
+
+    __TEST_CLEANUP__;
+}
+
+void MemoryIndexTests::Test_Build_Overlapping()
+{
+    CMdmpMemoryIndex index;
+    std::vector<MdmpMemRangeRecord> aRanges;
+    const MdmpMemRangeRecord* pRange = NULL;
+    uint8_t buf[0x200];
+    size_t uRead = 0;
+
+    AddRange(aRanges, 0x1000, 0x100, 1);
+    AddRange(aRanges, 0x1080, 0x100, 2); // Overlaps the tail of the first range
+    AddRange(aRanges, 0x1010, 0x10, 3);  // Completely covered by the first range
+    AddRange(aRanges, 0x2000, 0, 4);     // Empty range
+    index.Build(aRanges);
+
+    TEST_ASSERT(index.GetRangeCount()==2);
+
+    pRange = index.FindRange(0x1010);
+    TEST_ASSERT(pRange!=NULL && pRange->m_pStartPtr[0]==1);
+
+    pRange = index.FindRange(0x1100);
+    TEST_ASSERT(pRange!=NULL && pRange->m_uStartOfMemoryRange==0x1100);
+    TEST_ASSERT(pRange->m_uDataSize==0x80);
+    TEST_ASSERT(pRange->m_pStartPtr[0]==2);
+
+    TEST_ASSERT(index.FindRange(0x2000)==NULL);
+
+    // The trimmed range is adjacent to the first one, so it's stitched
+    memset(buf, 0, sizeof(buf));
+    uRead = index.Read(0x1000, buf, sizeof(buf));
+    TEST_ASSERT(uRead==0x180);
+    TEST_ASSERT(buf[0xFF]==1 && buf[0x100]==2 && buf[0x17F]==2);
+
+    __TEST_CLEANUP__;
+}
+
+void MemoryIndexTests::Test_Benchmark_Lookup()
+{
+    // Compares the linear scan previously done by ReadProcessMemoryProc64 with
+    // the index lookup, on a memory list similar to a full-memory dump.
+    const size_t uRangeCount = 20000;
+    const size_t uLookupCount = 2000;
+    const size_t uRangeSize = 0x1000;
+    std::vector<uint8_t> aData(uRangeSize, 0x5A);
+    std::vector<MdmpMemRangeRecord> aRanges;
+    std::vector<uint64_t> aAddrs;
+    CMdmpMemoryIndex index;
+    CPerfTimer timer;
+    double dBuildTime = 0;
+    double dLinearTime = 0;
+    double dIndexTime = 0;
+    size_t uLinearFound = 0;
+    size_t uIndexFound = 0;
+    size_t i;
+
+    // Ranges with gaps between them, in shuffled order
+    aRanges.resize(uRangeCount);
+    for(i=0; i<uRangeCount; i++)
+    {
+        size_t uSlot = (i*7919)%uRangeCount;
+        aRanges[i].m_uStartOfMemoryRange = 0x10000000+(uint64_t)uSlot*uRangeSize*2;
+        aRanges[i].m_uDataSize = uRangeSize;
+        aRanges[i].m_pStartPtr = &aData[0];
+    }
+
+    // Pseudo-random addresses, about half of them are captured
+    uint32_t uSeed = 12345;
+    for(i=0; i<uLookupCount; i++)
+    {
+        uSeed = uSeed*1103515245+12345;
+        aAddrs.push_back(0x10000000+(uint64_t)(uSeed%(uRangeCount*uRangeSize*2)));
+    }
+
+    timer.Start();
+    for(i=0; i<uLookupCount; i++)
+    {
+        size_t j;
+        for(j=0; j<aRanges.size(); j++)
+        {
+            const MdmpMemRangeRecord& mr = aRanges[j];
+            if(aAddrs[i]>=mr.m_uStartOfMemoryRange &&
+                aAddrs[i]<mr.m_uStartOfMemoryRange+mr.m_uDataSize)
+            {
+                uLinearFound++;
+                break;
+            }
+        }
+    }
+    dLinearTime = timer.GetElapsedMs();
+
+    timer.Start();
+    index.Build(aRanges);
+    dBuildTime = timer.GetElapsedMs();
+
+    timer.Start();
+    for(i=0; i<uLookupCount; i++)
+    {
+        if(index.FindRange(aAddrs[i])!=NULL)
+            uIndexFound++;
+    }
+    dIndexTime = timer.GetElapsedMs();
+
+    printf("\n   %d lookups over %d ranges: linear scan %.2f ms, index build %.2f ms, index lookup %.2f ms\n   ",
+        (int)uLookupCount, (int)uRangeCount, dLinearTime, dBuildTime, dIndexTime);
+
+    TEST_ASSERT(uLinearFound>0);
+    TEST_ASSERT(uLinearFound==uIndexFound);
+
+    __TEST_CLEANUP__;
+}
@@ -0,0 +1,306 @@
+/************************************************************************************* 
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: MinidumpBuilder.h
+// Description: Helper class that composes synthetic minidump images in memory. Used as 
+// a test fixture generator, so tests don't depend on minidumps produced by dbghelp.
+
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "MinidumpParser.h"
+
+// Module description passed to CMinidumpBuilder::AddModuleListStream()
+struct MdmpBuilderModule
+{
+    MdmpBuilderModule()
+    {
+        m_uBaseAddr = 0;
+        m_uImageSize = 0;
+        m_uTimeDateStamp = 0;
+        m_uFileVersionMS = 0;
+        m_uFileVersionLS = 0;
+        memset(m_uchPdbGuid, 0, sizeof(m_uchPdbGuid));
+        m_uPdbAge = 0;
+    }
+
+    uint64_t m_uBaseAddr;       // Base address
+    uint32_t m_uImageSize;      // Size of module
+    uint32_t m_uTimeDateStamp;  // Image time stamp
+    std::wstring m_sImageName;  // Image name
+    uint32_t m_uFileVersionMS;  // File version (high part)
+    uint32_t m_uFileVersionLS;  // File version (low part)
+    std::string m_sPdbName;     // PDB name; if empty, no CodeView record is written
+    uint8_t m_uchPdbGuid[16];   // PDB GUID
+    uint32_t m_uPdbAge;         // PDB age
+};
+
+// Thread description passed to CMinidumpBuilder::AddThreadListStream()
+struct MdmpBuilderThread
+{
+    uint32_t m_uThreadId;              // Thread ID
+    uint64_t m_uStackStart;            // Address of stack memory
+    std::vector<uint8_t> m_aStack;     // Stack memory contents
+    std::vector<uint8_t> m_aContext;   // Thread context bytes
+};
+
+// Memory range description passed to CMinidumpBuilder::AddMemoryListStream()
+struct MdmpBuilderMemRange
+{
+    uint64_t m_uStart;                 // Starting address
+    std::vector<uint8_t> m_aData;      // Memory contents
+};
+
+// class CMinidumpBuilder
+// Composes a minidump image: header, data blocks, streams, and the stream directory
+// (written at the end by GetImage()).
+class CMinidumpBuilder
+{
+public:
+
+    CMinidumpBuilder()
+    {
+        m_aData.resize(32, 0); // Header
+    }
+
+    // Appends a raw data block and returns its RVA.
+    uint32_t AddBlob(const void* pData, size_t uSize)
+    {
+        uint32_t uRva = (uint32_t)m_aData.size();
+        const uint8_t* p = (const uint8_t*)pData;
+        m_aData.insert(m_aData.end(), p, p+uSize);
+        return uRva;
+    }
+
+    // Appends a MINIDUMP_STRING and returns its RVA.
+    uint32_t AddString(const std::wstring& s)
+    {
+        std::vector<uint8_t> a;
+        PutU32(a, (uint32_t)s.length()*2);
+        size_t i;
+        for(i=0; i<s.length(); i++)
+            PutU16(a, (uint16_t)s[i]);
+        PutU16(a, 0);
+        return AddBlob(&a[0], a.size());
+    }
+
+    // Appends a stream body and adds a directory entry for it.
+    void AddStream(uint32_t uStreamType, const std::vector<uint8_t>& aBody)
+    {
+        MdmpDirEntry entry;
+        entry.m_uStreamType = uStreamType;
+        entry.m_Location.m_uDataSize = (uint32_t)aBody.size();
+        entry.m_Location.m_uRva = aBody.empty()?0:AddBlob(&aBody[0], aBody.size());
+        m_aDirectory.push_back(entry);
+    }
+
+    void AddSysInfoStream(uint16_t uArch, uint8_t uchCpuCount, uint32_t uMajor, 
+        uint32_t uMinor, uint32_t uBuild, const std::wstring& sCSDVer)
+    {
+        uint32_t uCSDVerRva = AddString(sCSDVer);
+        std::vector<uint8_t> a(56, 0);
+        SetU16(a, 0, uArch);
+        a[6] = uchCpuCount;
+        a[7] = 1; // VER_NT_WORKSTATION
+        SetU32(a, 8, uMajor);
+        SetU32(a, 12, uMinor);
+        SetU32(a, 16, uBuild);
+        SetU32(a, 20, 2); // VER_PLATFORM_WIN32_NT
+        SetU32(a, 24, uCSDVerRva);
+        AddStream(MDMP_SYSTEM_INFO_STREAM, a);
+    }
+
+    void AddExceptionStream(uint32_t uThreadId, uint32_t uCode, uint64_t uAddress, 
+        const std::vector<uint8_t>& aContext)
+    {
+        uint32_t uContextRva = aContext.empty()?0:AddBlob(&aContext[0], aContext.size());
+        std::vector<uint8_t> a(168, 0);
+        SetU32(a, 0, uThreadId);
+        SetU32(a, 8, uCode);
+        SetU64(a, 24, uAddress);
+        SetU32(a, 160, (uint32_t)aContext.size());
+        SetU32(a, 164, uContextRva);
+        AddStream(MDMP_EXCEPTION_STREAM, a);
+    }
+
+    void AddModuleListStream(const std::vector<MdmpBuilderModule>& aModules)
+    {
+        std::vector<uint8_t> a;
+        PutU32(a, (uint32_t)aModules.size());
+        size_t i;
+        for(i=0; i<aModules.size(); i++)
+        {
+            const MdmpBuilderModule& m = aModules[i];
+            uint32_t uNameRva = AddString(m.m_sImageName);
+
+            MdmpLocation cv;
+            if(!m.m_sPdbName.empty())
+            {
+                std::vector<uint8_t> r;
+                PutU32(r, 0x53445352); // 'RSDS'
+                r.insert(r.end(), m.m_uchPdbGuid, m.m_uchPdbGuid+16);
+                PutU32(r, m.m_uPdbAge);
+                r.insert(r.end(), m.m_sPdbName.begin(), m.m_sPdbName.end());
+                r.push_back(0);
+                cv.m_uDataSize = (uint32_t)r.size();
+                cv.m_uRva = AddBlob(&r[0], r.size());
+            }
+
+            size_t uOffs = a.size();
+            a.resize(uOffs+108, 0);
+            SetU64(a, uOffs, m.m_uBaseAddr);
+            SetU32(a, uOffs+8, m.m_uImageSize);
+            SetU32(a, uOffs+16, m.m_uTimeDateStamp);
+            SetU32(a, uOffs+20, uNameRva);
+            SetU32(a, uOffs+24, 0xFEEF04BD); // VS_FIXEDFILEINFO signature
+            SetU32(a, uOffs+24+8, m.m_uFileVersionMS);
+            SetU32(a, uOffs+24+12, m.m_uFileVersionLS);
+            SetU32(a, uOffs+76, cv.m_uDataSize);
+            SetU32(a, uOffs+80, cv.m_uRva);
+        }
+        AddStream(MDMP_MODULE_LIST_STREAM, a);
+    }
+
+    void AddThreadListStream(const std::vector<MdmpBuilderThread>& aThreads)
+    {
+        std::vector<uint8_t> a;
+        PutU32(a, (uint32_t)aThreads.size());
+        size_t i;
+        for(i=0; i<aThreads.size(); i++)
+        {
+            const MdmpBuilderThread& t = aThreads[i];
+            uint32_t uStackRva = t.m_aStack.empty()?0:AddBlob(&t.m_aStack[0], t.m_aStack.size());
+            uint32_t uContextRva = t.m_aContext.empty()?0:AddBlob(&t.m_aContext[0], t.m_aContext.size());
+
+            size_t uOffs = a.size();
+            a.resize(uOffs+48, 0);
+            SetU32(a, uOffs, t.m_uThreadId);
+            SetU64(a, uOffs+24, t.m_uStackStart);
+            SetU32(a, uOffs+32, (uint32_t)t.m_aStack.size());
+            SetU32(a, uOffs+36, uStackRva);
+            SetU32(a, uOffs+40, (uint32_t)t.m_aContext.size());
+            SetU32(a, uOffs+44, uContextRva);
+        }
+        AddStream(MDMP_THREAD_LIST_STREAM, a);
+    }
+
+    void AddMemoryListStream(const std::vector<MdmpBuilderMemRange>& aRanges)
+    {
+        std::vector<uint8_t> a;
+        PutU32(a, (uint32_t)aRanges.size());
+        size_t i;
+        for(i=0; i<aRanges.size(); i++)
+        {
+            const MdmpBuilderMemRange& r = aRanges[i];
+            uint32_t uRva = r.m_aData.empty()?0:AddBlob(&r.m_aData[0], r.m_aData.size());
+            PutU64(a, r.m_uStart);
+            PutU32(a, (uint32_t)r.m_aData.size());
+            PutU32(a, uRva);
+        }
+        AddStream(MDMP_MEMORY_LIST_STREAM, a);
+    }
+
+    void AddMemory64ListStream(const std::vector<MdmpBuilderMemRange>& aRanges)
+    {
+        // Range data must be contiguous
+        uint64_t uBaseRva = m_aData.size();
+        size_t i;
+        for(i=0; i<aRanges.size(); i++)
+        {
+            if(!aRanges[i].m_aData.empty())
+                AddBlob(&aRanges[i].m_aData[0], aRanges[i].m_aData.size());
+        }
+
+        std::vector<uint8_t> a;
+        PutU64(a, aRanges.size());
+        PutU64(a, uBaseRva);
+        for(i=0; i<aRanges.size(); i++)
+        {
+            PutU64(a, aRanges[i].m_uStart);
+            PutU64(a, aRanges[i].m_aData.size());
+        }
+        AddStream(MDMP_MEMORY64_LIST_STREAM, a);
+    }
+
+    // Writes the stream directory and the header and returns the resulting image.
+    std::vector<uint8_t> GetImage() const
+    {
+        std::vector<uint8_t> aImage = m_aData;
+        uint32_t uDirRva = (uint32_t)aImage.size();
+        size_t i;
+        for(i=0; i<m_aDirectory.size(); i++)
+        {
+            PutU32(aImage, m_aDirectory[i].m_uStreamType);
+            PutU32(aImage, m_aDirectory[i].m_Location.m_uDataSize);
+            PutU32(aImage, m_aDirectory[i].m_Location.m_uRva);
+        }
+
+        SetU32(aImage, 0, 0x504d444d); // 'MDMP'
+        SetU32(aImage, 4, 0xa793);     // MINIDUMP_VERSION
+        SetU32(aImage, 8, (uint32_t)m_aDirectory.size());
+        SetU32(aImage, 12, uDirRva);
+        return aImage;
+    }
+
+    // Writes the image to file. Returns true on success.
+    bool SaveToFile(const char* szFileName) const
+    {
+        std::vector<uint8_t> aImage = GetImage();
+        FILE* f = fopen(szFileName, "wb");
+        if(f==NULL)
+            return false;
+        size_t uWritten = fwrite(&aImage[0], 1, aImage.size(), f);
+        fclose(f);
+        return uWritten==aImage.size();
+    }
+
+    static void PutU16(std::vector<uint8_t>& a, uint16_t v)
+    {
+        a.push_back((uint8_t)v);
+        a.push_back((uint8_t)(v>>8));
+    }
+
+    static void PutU32(std::vector<uint8_t>& a, uint32_t v)
+    {
+        PutU16(a, (uint16_t)v);
+        PutU16(a, (uint16_t)(v>>16));
+    }
+
+    static void PutU64(std::vector<uint8_t>& a, uint64_t v)
+    {
+        PutU32(a, (uint32_t)v);
+        PutU32(a, (uint32_t)(v>>32));
+    }
+
+    static void SetU16(std::vector<uint8_t>& a, size_t uOffs, uint16_t v)
+    {
+        a[uOffs] = (uint8_t)v;
+        a[uOffs+1] = (uint8_t)(v>>8);
+    }
+
+    static void SetU32(std::vector<uint8_t>& a, size_t uOffs, uint32_t v)
+    {
+        SetU16(a, uOffs, (uint16_t)v);
+        SetU16(a, uOffs+2, (uint16_t)(v>>16));
+    }
+
+    static void SetU64(std::vector<uint8_t>& a, size_t uOffs, uint64_t v)
+    {
+        SetU32(a, uOffs, (uint32_t)v);
+        SetU32(a, uOffs+4, (uint32_t)(v>>32));
+    }
+
+private:
+
+    std::vector<uint8_t> m_aData;            // Header and data blocks
+    std::vector<MdmpDirEntry> m_aDirectory;  // Stream directory
+};
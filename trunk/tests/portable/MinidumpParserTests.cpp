@@ -0,0 +1,517 @@
+/************************************************************************************* 
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "MinidumpBuilder.h"
+#include "MinidumpParser.h"
+
+class MinidumpParserTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(MinidumpParserTests, "CMiniDumpParser class tests")
+        REGISTER_TEST(Test_OpenFile)
+        REGISTER_TEST(Test_Attach_InvalidHeader)
+        REGISTER_TEST(Test_SysInfoStream)
+        REGISTER_TEST(Test_ExceptionStream)
+        REGISTER_TEST(Test_ModuleListStream)
+        REGISTER_TEST(Test_ThreadListStream)
+        REGISTER_TEST(Test_MemoryListStreams)
+        REGISTER_TEST(Test_MissingStream)
+        REGISTER_TEST(Test_CorruptedStreams)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_OpenFile();
+    void Test_Attach_InvalidHeader();
+    void Test_SysInfoStream();
+    void Test_ExceptionStream();
+    void Test_ModuleListStream();
+    void Test_ThreadListStream();
+    void Test_MemoryListStreams();
+    void Test_MissingStream();
+    void Test_CorruptedStreams();
+
+private:
+
+    // Composes a minidump containing all supported streams
+    static std::vector<uint8_t> MakeFullImage();
+
+    std::string m_sTmpFile; // Temporary minidump file
+};
+
+REGISTER_TEST_SUITE( MinidumpParserTests );
+
+void MinidumpParserTests::SetUp()
+{
+    m_sTmpFile = "MinidumpParserTests.dmp";
+}
+
+void MinidumpParserTests::TearDown()
+{
+    remove(m_sTmpFile.c_str());
+}
+
+std::vector<uint8_t> MinidumpParserTests::MakeFullImage()
+{
+    CMinidumpBuilder builder;
+
+    // The CSD version contains a character outside of the BMP, stored as a surrogate pair
+    std::wstring sCSDVer = L"Service Pack 1 ";
+    sCSDVer += (wchar_t)0xD83D;
+    sCSDVer += (wchar_t)0xDE00;
+    builder.AddSysInfoStream(9, 4, 6, 1, 7601, sCSDVer);
+
+    std::vector<uint8_t> aContext(64, 0xCC);
+    builder.AddExceptionStream(0x1234, 0xC0000005, 0x401000, aContext);
+
+    std::vector<MdmpBuilderModule> aModules;
+    MdmpBuilderModule m;
+    m.m_uBaseAddr = 0x400000;
+    m.m_uImageSize = 0x10000;
+    m.m_uTimeDateStamp = 0x5000AAAA;
+    m.m_sImageName = L"C:\\Program Files\\App\\app.exe";
+    m.m_uFileVersionMS = 0x00010002;
+    m.m_uFileVersionLS = 0x00030004;
+    m.m_sPdbName = "app.pdb";
+    int i;
+    for(i=0; i<16; i++)
+        m.m_uchPdbGuid[i] = (uint8_t)i;
+    m.m_uPdbAge = 3;
+    aModules.push_back(m);
+
+    MdmpBuilderModule m2;
+    m2.m_uBaseAddr = 0x7FF000000000ULL;
+    m2.m_uImageSize = 0x2000;
+    m2.m_sImageName = L"C:\\Windows\\System32\\ntdll.dll";
+    aModules.push_back(m2);
+    builder.AddModuleListStream(aModules);
+
+    std::vector<MdmpBuilderThread> aThreads;
+    MdmpBuilderThread t;
+    t.m_uThreadId = 0x1234;
+    t.m_uStackStart = 0x12F000;
+    t.m_aStack.assign(256, 0xAB);
+    t.m_aContext = aContext;
+    aThreads.push_back(t);
+    t.m_uThreadId = 0x5678;
+    t.m_uStackStart = 0x22F000;
+    t.m_aStack.assign(128, 0xCD);
+    aThreads.push_back(t);
+    builder.AddThreadListStream(aThreads);
+
+    std::vector<MdmpBuilderMemRange> aRanges;
+    MdmpBuilderMemRange r;
+    r.m_uStart = 0x12F000;
+    r.m_aData.assign(256, 0xAB);
+    aRanges.push_back(r);
+    builder.AddMemoryListStream(aRanges);
+
+    aRanges.clear();
+    r.m_uStart = 0x800000;
+    r.m_aData.assign(4096, 0x11);
+    aRanges.push_back(r);
+    r.m_uStart = 0x801000;
+    r.m_aData.assign(4096, 0x22);
+    aRanges.push_back(r);
+    builder.AddMemory64ListStream(aRanges);
+
+    return builder.GetImage();
+}
+
+void MinidumpParserTests::Test_OpenFile()
+{
+    CMiniDumpParser parser;
+    std::vector<MdmpThreadRecord> aThreads;
+    int nResult = -1;
+
+    // Open not existing file - should fail
+    nResult = parser.OpenFile("NotExistingFile.dmp");
+    TEST_ASSERT(nResult==MDMP_ERR_OPEN_FILE);
+    TEST_ASSERT(!parser.IsOpened());
+
+    // Save fixture to file and open it through memory mapping
+    {
+        std::vector<uint8_t> aImage = MakeFullImage();
+        FILE* f = fopen(m_sTmpFile.c_str(), "wb");
+        TEST_ASSERT(f!=NULL);
+        fwrite(&aImage[0], 1, aImage.size(), f);
+        fclose(f);
+
+        nResult = parser.OpenFile(m_sTmpFile.c_str());
+        TEST_ASSERT(nResult==MDMP_OK);
+        TEST_ASSERT(parser.IsOpened());
+        TEST_ASSERT(parser.GetSize()==aImage.size());
+        TEST_ASSERT(memcmp(parser.GetData(), &aImage[0], aImage.size())==0);
+        TEST_ASSERT(parser.GetDirectory().size()==6);
+    }
+
+    nResult = parser.ReadThreadListStream(aThreads);
+    TEST_ASSERT(nResult==MDMP_OK);
+    TEST_ASSERT(aThreads.size()==2);
+
+    parser.Close();
+    TEST_ASSERT(!parser.IsOpened());
+    TEST_ASSERT(parser.GetDirectory().size()==0);
+
+    // Empty file is not a minidump
+    {
+        FILE* f = fopen(m_sTmpFile.c_str(), "wb");
+        TEST_ASSERT(f!=NULL);
+        fclose(f);
+    }
+    nResult = parser.OpenFile(m_sTmpFile.c_str());
+    TEST_ASSERT(nResult!=MDMP_OK);
+    TEST_ASSERT(!parser.IsOpened());
+
+    __TEST_CLEANUP__;
+
+    parser.Close();
+}
+
+void MinidumpParserTests::Test_Attach_InvalidHeader()
+{
+    CMiniDumpParser parser;
+    std::vector<uint8_t> aImage = MakeFullImage();
+    std::vector<uint8_t> aBad;
+    int nResult = -1;
+
+    // NULL buffer
+    nResult = parser.Attach(NULL, 0);
+    TEST_ASSERT(nResult==MDMP_ERR_INVALID_HEADER);
+
+    // Truncated header
+    nResult = parser.Attach(&aImage[0], 16);
+    TEST_ASSERT(nResult==MDMP_ERR_INVALID_HEADER);
+    TEST_ASSERT(!parser.IsOpened());
+
+    // Wrong signature
+    aBad = aImage;
+    aBad[0] = 'X';
+    nResult = parser.Attach(&aBad[0], aBad.size());
+    TEST_ASSERT(nResult==MDMP_ERR_INVALID_HEADER);
+
+    // Wrong version
+    aBad = aImage;
+    aBad[4] = 0;
+    nResult = parser.Attach(&aBad[0], aBad.size());
+    TEST_ASSERT(nResult==MDMP_ERR_INVALID_HEADER);
+
+    // Directory doesn't fit into the file
+    aBad = aImage;
+    CMinidumpBuilder::SetU32(aBad, 8, 1000000);
+    nResult = parser.Attach(&aBad[0], aBad.size());
+    TEST_ASSERT(nResult==MDMP_ERR_INVALID_HEADER);
+
+    // Truncated directory
+    nResult = parser.Attach(&aImage[0], aImage.size()-1);
+    TEST_ASSERT(nResult==MDMP_ERR_INVALID_HEADER);
+
+    // Valid image
+    nResult = parser.Attach(&aImage[0], aImage.size());
+    TEST_ASSERT(nResult==MDMP_OK);
+    TEST_ASSERT(parser.IsOpened());
+    TEST_ASSERT(parser.GetData()==&aImage[0]);
+
+    __TEST_CLEANUP__;
+
+    parser.Close();
+}
+
+void MinidumpParserTests::Test_SysInfoStream()
+{
+    CMiniDumpParser parser;
+    std::vector<uint8_t> aImage = MakeFullImage();
+    MdmpSysInfoRecord si;
+    std::wstring sExpected = L"Service Pack 1 ";
+    int nResult = -1;
+
+    nResult = parser.Attach(&aImage[0], aImage.size());
+    TEST_ASSERT(nResult==MDMP_OK);
+
+    nResult = parser.ReadSysInfoStream(si);
+    TEST_ASSERT(nResult==MDMP_OK);
+    TEST_ASSERT(si.m_uProcessorArchitecture==9);
+    TEST_ASSERT(si.m_uchNumberOfProcessors==4);
+    TEST_ASSERT(si.m_uchProductType==1);
+    TEST_ASSERT(si.m_ulVerMajor==6);
+    TEST_ASSERT(si.m_ulVerMinor==1);
+    TEST_ASSERT(si.m_ulVerBuild==7601);
+    TEST_ASSERT(si.m_ulPlatformId==2);
+
+    // The surrogate pair should be preserved as is (UTF-16 wchar_t) or decoded
+    // into a single code point (UTF-32 wchar_t)
+    if(sizeof(wchar_t)==2)
+    {
+        sExpected += (wchar_t)0xD83D;
+        sExpected += (wchar_t)0xDE00;
+    }
+    else
+    {
+        sExpected += (wchar_t)0x1F600;
+    }
+    TEST_ASSERT(si.m_sCSDVer==sExpected);
+
+    __TEST_CLEANUP__;
+}
+
+void MinidumpParserTests::Test_ExceptionStream()
+{
+    CMiniDumpParser parser;
+    std::vector<uint8_t> aImage = MakeFullImage();
+    MdmpExceptionRecord exc;
+    int nResult = -1;
+
+    nResult = parser.Attach(&aImage[0], aImage.size());
+    TEST_ASSERT(nResult==MDMP_OK);
+
+    nResult = parser.ReadExceptionStream(exc);
+    TEST_ASSERT(nResult==MDMP_OK);
+    TEST_ASSERT(exc.m_uThreadId==0x1234);
+    TEST_ASSERT(exc.m_uExceptionCode==0xC0000005);
+    TEST_ASSERT(exc.m_uExceptionAddress==0x401000);
+    TEST_ASSERT(exc.m_ThreadContext.m_uDataSize==64);
+    TEST_ASSERT(exc.m_pThreadContext!=NULL);
+    TEST_ASSERT(exc.m_pThreadContext[0]==0xCC && exc.m_pThreadContext[63]==0xCC);
+
+    __TEST_CLEANUP__;
+}
+
+void MinidumpParserTests::Test_ModuleListStream()
+{
+    CMiniDumpParser parser;
+    std::vector<uint8_t> aImage = MakeFullImage();
+    std::vector<MdmpModuleRecord> aModules;
+    int nResult = -1;
+    int i;
+
+    nResult = parser.Attach(&aImage[0], aImage.size());
+    TEST_ASSERT(nResult==MDMP_OK);
+
+    nResult = parser.ReadModuleListStream(aModules);
+    TEST_ASSERT(nResult==MDMP_OK);
+    TEST_ASSERT(aModules.size()==2);
+
+    TEST_ASSERT(aModules[0].m_uBaseAddr==0x400000);
+    TEST_ASSERT(aModules[0].m_uImageSize==0x10000);
+    TEST_ASSERT(aModules[0].m_uTimeDateStamp==0x5000AAAA);
+    TEST_ASSERT(aModules[0].m_sImageName==L"C:\\Program Files\\App\\app.exe");
+    TEST_ASSERT(aModules[0].m_VersionInfo.dwSignature==0xFEEF04BD);
+    TEST_ASSERT(aModules[0].m_VersionInfo.dwFileVersionMS==0x00010002);
+    TEST_ASSERT(aModules[0].m_VersionInfo.dwFileVersionLS==0x00030004);
+    TEST_ASSERT(aModules[0].m_uVersionInfoRva!=0);
+    TEST_ASSERT(memcmp(&aImage[aModules[0].m_uVersionInfoRva+8], "\x02\x00\x01\x00", 4)==0);
+    TEST_ASSERT(aModules[0].m_bHasPdbInfo);
+    TEST_ASSERT(aModules[0].m_uPdbAge==3);
+    TEST_ASSERT(aModules[0].m_sPdbName=="app.pdb");
+    for(i=0; i<16; i++)
+    {
+        TEST_ASSERT(aModules[0].m_uchPdbGuid[i]==i);
+    }
+
+    TEST_ASSERT(aModules[1].m_uBaseAddr==0x7FF000000000ULL);
+    TEST_ASSERT(aModules[1].m_sImageName==L"C:\\Windows\\System32\\ntdll.dll");
+    TEST_ASSERT(!aModules[1].m_bHasPdbInfo);
+    TEST_ASSERT(aModules[1].m_sPdbName.empty());
+
+    __TEST_CLEANUP__;
+}
+
+void MinidumpParserTests::Test_ThreadListStream()
+{
+    CMiniDumpParser parser;
+    std::vector<uint8_t> aImage = MakeFullImage();
+    std::vector<MdmpThreadRecord> aThreads;
+    int nResult = -1;
+
+    nResult = parser.Attach(&aImage[0], aImage.size());
+    TEST_ASSERT(nResult==MDMP_OK);
+
+    nResult = parser.ReadThreadListStream(aThreads);
+    TEST_ASSERT(nResult==MDMP_OK);
+    TEST_ASSERT(aThreads.size()==2);
+
+    TEST_ASSERT(aThreads[0].m_uThreadId==0x1234);
+    TEST_ASSERT(aThreads[0].m_uStackStart==0x12F000);
+    TEST_ASSERT(aThreads[0].m_Stack.m_uDataSize==256);
+    TEST_ASSERT(aImage[aThreads[0].m_Stack.m_uRva]==0xAB);
+    TEST_ASSERT(aThreads[0].m_ThreadContext.m_uDataSize==64);
+    TEST_ASSERT(aThreads[0].m_pThreadContext!=NULL);
+
+    TEST_ASSERT(aThreads[1].m_uThreadId==0x5678);
+    TEST_ASSERT(aThreads[1].m_uStackStart==0x22F000);
+    TEST_ASSERT(aThreads[1].m_Stack.m_uDataSize==128);
+    TEST_ASSERT(aImage[aThreads[1].m_Stack.m_uRva]==0xCD);
+
+    __TEST_CLEANUP__;
+}
+
+void MinidumpParserTests::Test_MemoryListStreams()
+{
+    CMiniDumpParser parser;
+    std::vector<uint8_t> aImage = MakeFullImage();
+    std::vector<MdmpMemRangeRecord> aRanges;
+    int nResult = -1;
+
+    nResult = parser.Attach(&aImage[0], aImage.size());
+    TEST_ASSERT(nResult==MDMP_OK);
+
+    nResult = parser.ReadMemoryListStream(aRanges);
+    TEST_ASSERT(nResult==MDMP_OK);
+    TEST_ASSERT(aRanges.size()==1);
+    TEST_ASSERT(aRanges[0].m_uStartOfMemoryRange==0x12F000);
+    TEST_ASSERT(aRanges[0].m_uDataSize==256);
+    TEST_ASSERT(aRanges[0].m_pStartPtr[0]==0xAB && aRanges[0].m_pStartPtr[255]==0xAB);
+
+    // Memory64 ranges are appended to the same list
+    nResult = parser.ReadMemory64ListStream(aRanges);
+    TEST_ASSERT(nResult==MDMP_OK);
+    TEST_ASSERT(aRanges.size()==3);
+    TEST_ASSERT(aRanges[1].m_uStartOfMemoryRange==0x800000);
+    TEST_ASSERT(aRanges[1].m_uDataSize==4096);
+    TEST_ASSERT(aRanges[1].m_pStartPtr[0]==0x11 && aRanges[1].m_pStartPtr[4095]==0x11);
+    TEST_ASSERT(aRanges[2].m_uStartOfMemoryRange==0x801000);
+    TEST_ASSERT(aRanges[2].m_pStartPtr==aRanges[1].m_pStartPtr+4096);
+    TEST_ASSERT(aRanges[2].m_pStartPtr[0]==0x22);
+
+    __TEST_CLEANUP__;
+}
+
+void MinidumpParserTests::Test_MissingStream()
+{
+    CMiniDumpParser parser;
+    CMinidumpBuilder builder;
+    std::vector<uint8_t> aImage;
+    std::vector<MdmpModuleRecord> aModules;
+    std::vector<MdmpMemRangeRecord> aRanges;
+    MdmpExceptionRecord exc;
+    MdmpSysInfoRecord si;
+    const uint8_t* pStream = NULL;
+    uint32_t uStreamSize = 0;
+    int nResult = -1;
+
+    // Minidump with the system info stream only
+    builder.AddSysInfoStream(0, 1, 5, 1, 2600, L"");
+    aImage = builder.GetImage();
+
+    nResult = parser.Attach(&aImage[0], aImage.size());
+    TEST_ASSERT(nResult==MDMP_OK);
+
+    nResult = parser.ReadSysInfoStream(si);
+    TEST_ASSERT(nResult==MDMP_OK);
+    TEST_ASSERT(si.m_sCSDVer.empty());
+
+    nResult = parser.ReadExceptionStream(exc);
+    TEST_ASSERT(nResult==MDMP_ERR_NO_STREAM);
+
+    nResult = parser.ReadModuleListStream(aModules);
+    TEST_ASSERT(nResult==MDMP_ERR_NO_STREAM);
+    TEST_ASSERT(aModules.size()==0);
+
+    nResult = parser.ReadMemory64ListStream(aRanges);
+    TEST_ASSERT(nResult==MDMP_ERR_NO_STREAM);
+
+    nResult = parser.FindStream(12345, &pStream, &uStreamSize);
+    TEST_ASSERT(nResult==MDMP_ERR_NO_STREAM);
+    TEST_ASSERT(pStream==NULL && uStreamSize==0);
+
+    __TEST_CLEANUP__;
+}
+
+void MinidumpParserTests::Test_CorruptedStreams()
+{
+    CMiniDumpParser parser;
+    CMinidumpBuilder builder;
+    std::vector<uint8_t> aImage;
+    std::vector<uint8_t> aBody;
+    std::vector<MdmpModuleRecord> aModules;
+    std::vector<MdmpThreadRecord> aThreads;
+    std::vector<MdmpMemRangeRecord> aRanges;
+    std::vector<MdmpBuilderMemRange> aMemRanges;
+    MdmpBuilderMemRange r;
+    MdmpExceptionRecord exc;
+    std::wstring sStr;
+    int nResult = -1;
+
+    // Unused directory entry (type 0) must be skipped
+    builder.AddStream(0, std::vector<uint8_t>());
+
+    // Module list claims more modules than the stream holds
+    CMinidumpBuilder::PutU32(aBody, 10);
+    aBody.resize(4+108, 0);
+    builder.AddStream(MDMP_MODULE_LIST_STREAM, aBody);
+
+    // Exception stream is too short
+    aBody.assign(100, 0);
+    builder.AddStream(MDMP_EXCEPTION_STREAM, aBody);
+
+    // Second exception stream is ignored, as dbghelp does
+    builder.AddExceptionStream(1, 2, 3, std::vector<uint8_t>());
+
+    // Memory list with one range pointing outside of the file
+    r.m_uStart = 0x1000;
+    r.m_aData.assign(16, 0x55);
+    aMemRanges.push_back(r);
+    builder.AddMemoryListStream(aMemRanges);
+
+    aImage = builder.GetImage();
+
+    // Patch the RVA of the memory range so it points beyond the end of file
+    {
+        const uint8_t* pStream = NULL;
+        uint32_t uStreamSize = 0;
+        nResult = parser.Attach(&aImage[0], aImage.size());
+        TEST_ASSERT(nResult==MDMP_OK);
+        nResult = parser.FindStream(MDMP_MEMORY_LIST_STREAM, &pStream, &uStreamSize);
+        TEST_ASSERT(nResult==MDMP_OK);
+        CMinidumpBuilder::SetU32(aImage, (pStream-&aImage[0])+4+12, 0xFFFFFFF0);
+    }
+
+    nResult = parser.Attach(&aImage[0], aImage.size());
+    TEST_ASSERT(nResult==MDMP_OK);
+    TEST_ASSERT(parser.GetDirectory().size()==5);
+
+    nResult = parser.ReadModuleListStream(aModules);
+    TEST_ASSERT(nResult==MDMP_ERR_CORRUPTED);
+    TEST_ASSERT(aModules.size()==0);
+
+    nResult = parser.ReadExceptionStream(exc);
+    TEST_ASSERT(nResult==MDMP_ERR_CORRUPTED);
+
+    nResult = parser.ReadMemoryListStream(aRanges);
+    TEST_ASSERT(nResult==MDMP_OK);
+    TEST_ASSERT(aRanges.size()==0);
+
+    nResult = parser.ReadThreadListStream(aThreads);
+    TEST_ASSERT(nResult==MDMP_ERR_NO_STREAM);
+
+    // String RVA out of bounds
+    nResult = parser.ReadString((uint32_t)aImage.size()-2, sStr);
+    TEST_ASSERT(nResult==MDMP_ERR_CORRUPTED);
+    TEST_ASSERT(sStr.empty());
+
+    // Stream location out of bounds
+    {
+        CMinidumpBuilder b2;
+        b2.AddSysInfoStream(0, 1, 5, 1, 2600, L"");
+        aImage = b2.GetImage();
+        // Directory is at the end of image; patch the RVA of the only stream
+        CMinidumpBuilder::SetU32(aImage, aImage.size()-4, 0x7FFFFFFF);
+        MdmpSysInfoRecord si;
+        nResult = parser.Attach(&aImage[0], aImage.size());
+        TEST_ASSERT(nResult==MDMP_OK);
+        nResult = parser.ReadSysInfoStream(si);
+        TEST_ASSERT(nResult==MDMP_ERR_CORRUPTED);
+    }
+
+    __TEST_CLEANUP__;
+}
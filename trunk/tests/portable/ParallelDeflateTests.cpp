@@ -0,0 +1,533 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include <string.h>
+#include "ParallelDeflate.h"
+#include "HashingFileFunc.h"
+#include "zlib.h"
+
+class ParallelDeflateTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(ParallelDeflateTests, "CParallelDeflate and CHashingFileFunc class tests")
+        REGISTER_TEST(Test_RoundTrip)
+        REGISTER_TEST(Test_Errors)
+        REGISTER_TEST(Test_SetLevelAndStore)
+        REGISTER_TEST(Test_HashingFileFunc)
+        REGISTER_TEST(Test_Benchmark_Compress)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_RoundTrip();
+    void Test_Errors();
+    void Test_SetLevelAndStore();
+    void Test_HashingFileFunc();
+    void Test_Benchmark_Compress();
+
+private:
+
+    // Input and output of a compression
+    struct DeflateBuffers
+    {
+        DeflateBuffers()
+        {
+            m_uReadPos = 0;
+            m_nReadCalls = 0;
+            m_nFailReadCall = -1;
+            m_nFailWriteCall = -1;
+            m_nWriteCalls = 0;
+        }
+
+        std::vector<unsigned char> m_aInput;
+        size_t m_uReadPos;
+        int m_nReadCalls;
+        int m_nFailReadCall;  // Read call that fails, or -1
+        std::vector<unsigned char> m_aOutput;
+        int m_nWriteCalls;
+        int m_nFailWriteCall; // Write call that fails, or -1
+    };
+
+    // In-memory file for minizip file functions
+    struct MemFile
+    {
+        std::vector<unsigned char> m_aData;
+        size_t m_uPos;
+    };
+
+    // Makes data that look like a minidump: zero pages, code, text and random bytes
+    static void MakeDumpData(std::vector<unsigned char>& aData, size_t uSize);
+
+    // Compresses buffers with the given object
+    static int Deflate(CParallelDeflate& pd, DeflateBuffers& buf);
+
+    // Decompresses raw deflate data
+    static bool Inflate(const std::vector<unsigned char>& aInput, std::vector<unsigned char>& aOutput);
+
+    static bool ReadCallback(void* pBuf, size_t uSize, size_t* puRead, void* pParam);
+    static bool WriteCallback(const void* pData, size_t uSize, void* pParam);
+
+    static void FillMemFileFunc(zlib_filefunc64_def* pFileFunc, MemFile* pFile);
+    static voidpf ZCALLBACK MemOpen(voidpf opaque, const void* filename, int mode);
+    static uLong ZCALLBACK MemRead(voidpf opaque, voidpf stream, void* buf, uLong size);
+    static uLong ZCALLBACK MemWrite(voidpf opaque, voidpf stream, const void* buf, uLong size);
+    static ZPOS64_T ZCALLBACK MemTell(voidpf opaque, voidpf stream);
+    static long ZCALLBACK MemSeek(voidpf opaque, voidpf stream, ZPOS64_T offset, int origin);
+    static int ZCALLBACK MemClose(voidpf opaque, voidpf stream);
+    static int ZCALLBACK MemError(voidpf opaque, voidpf stream);
+};
+
+REGISTER_TEST_SUITE( ParallelDeflateTests );
+
+void ParallelDeflateTests::SetUp()
+{
+}
+
+void ParallelDeflateTests::TearDown()
+{
+}
+
+void ParallelDeflateTests::MakeDumpData(std::vector<unsigned char>& aData, size_t uSize)
+{
+    static const char* s_szText = "C:\\Windows\\System32\\kernel32.dll ntdll.dll RtlUserThreadStart ";
+    uint32_t uSeed = 12345;
+    size_t uPos = 0;
+
+    aData.resize(uSize);
+    while(uPos<uSize)
+    {
+        size_t uChunk = uSize-uPos<4096?uSize-uPos:4096;
+        size_t i;
+
+        uSeed = uSeed*1103515245+12345;
+        switch((uSeed>>16)%4)
+        {
+        case 0: // Zero page
+            memset(&aData[uPos], 0, uChunk);
+            break;
+        case 1: // Code-like bytes from a small alphabet
+            for(i=0; i<uChunk; i++)
+            {
+                uSeed = uSeed*1103515245+12345;
+                aData[uPos+i] = (unsigned char)(0x40+((uSeed>>16)%24));
+            }
+            break;
+        case 2: // Text
+            for(i=0; i<uChunk; i++)
+                aData[uPos+i] = (unsigned char)s_szText[(i+uPos/4096)%strlen(s_szText)];
+            break;
+        default: // Random bytes
+            for(i=0; i<uChunk; i++)
+            {
+                uSeed = uSeed*1103515245+12345;
+                aData[uPos+i] = (unsigned char)(uSeed>>16);
+            }
+            break;
+        }
+        uPos += uChunk;
+    }
+}
+
+bool ParallelDeflateTests::ReadCallback(void* pBuf, size_t uSize, size_t* puRead, void* pParam)
+{
+    DeflateBuffers* pBuffers = (DeflateBuffers*)pParam;
+
+    if(pBuffers->m_nReadCalls++==pBuffers->m_nFailReadCall)
+        return false;
+
+    // Return odd-sized portions to check that blocks are filled up
+    size_t uLeft = pBuffers->m_aInput.size()-pBuffers->m_uReadPos;
+    *puRead = uSize<uLeft?uSize:uLeft;
+    if(*puRead>100000)
+        *puRead -= 777;
+    if(*puRead!=0)
+        memcpy(pBuf, &pBuffers->m_aInput[pBuffers->m_uReadPos], *puRead);
+    pBuffers->m_uReadPos += *puRead;
+    return true;
+}
+
+bool ParallelDeflateTests::WriteCallback(const void* pData, size_t uSize, void* pParam)
+{
+    DeflateBuffers* pBuffers = (DeflateBuffers*)pParam;
+
+    if(pBuffers->m_nWriteCalls++==pBuffers->m_nFailWriteCall)
+        return false;
+
+    pBuffers->m_aOutput.insert(pBuffers->m_aOutput.end(),
+        (const unsigned char*)pData, (const unsigned char*)pData+uSize);
+    return true;
+}
+
+int ParallelDeflateTests::Deflate(CParallelDeflate& pd, DeflateBuffers& buf)
+{
+    buf.m_uReadPos = 0;
+    buf.m_nReadCalls = 0;
+    buf.m_nWriteCalls = 0;
+    buf.m_aOutput.clear();
+    return pd.Compress(ReadCallback, WriteCallback, &buf);
+}
+
+bool ParallelDeflateTests::Inflate(const std::vector<unsigned char>& aInput, std::vector<unsigned char>& aOutput)
+{
+    z_stream strm;
+    unsigned char buf[65536];
+    int nResult;
+
+    aOutput.clear();
+    memset(&strm, 0, sizeof(strm));
+    if(inflateInit2(&strm, -15)!=Z_OK)
+        return false;
+
+    strm.next_in = aInput.empty()?NULL:(Bytef*)&aInput[0];
+    strm.avail_in = (uInt)aInput.size();
+    do
+    {
+        strm.next_out = buf;
+        strm.avail_out = sizeof(buf);
+        nResult = inflate(&strm, Z_NO_FLUSH);
+        aOutput.insert(aOutput.end(), buf, buf+sizeof(buf)-strm.avail_out);
+    }
+    while(nResult==Z_OK);
+
+    inflateEnd(&strm);
+
+    // The stream must be complete and there must be no trailing bytes
+    return nResult==Z_STREAM_END && strm.avail_in==0;
+}
+
+void ParallelDeflateTests::Test_RoundTrip()
+{
+    CParallelDeflate pd;
+    DeflateBuffers buf;
+    std::vector<unsigned char> aInflated;
+    const size_t BLOCK_SIZE = 64*1024;
+    size_t aSizes[] = {0, 1, 1000, BLOCK_SIZE, 3*BLOCK_SIZE, 5*1024*1024+123};
+    int aThreads[] = {1, 4};
+    size_t i, j;
+
+    for(j=0; j<sizeof(aThreads)/sizeof(int); j++)
+    {
+        TEST_ASSERT(pd.Init(Z_DEFAULT_COMPRESSION, aThreads[j], BLOCK_SIZE)==PDEFLATE_OK);
+        TEST_ASSERT(pd.GetThreadCount()==aThreads[j]);
+
+        for(i=0; i<sizeof(aSizes)/sizeof(size_t); i++)
+        {
+            MakeDumpData(buf.m_aInput, aSizes[i]);
+
+            TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_OK);
+            TEST_ASSERT(pd.GetInputSize()==aSizes[i]);
+            TEST_ASSERT(pd.GetOutputSize()==buf.m_aOutput.size());
+
+            // The blocks form a single deflate stream
+            TEST_ASSERT(Inflate(buf.m_aOutput, aInflated));
+            TEST_ASSERT(aInflated==buf.m_aInput);
+
+            uLong uCrc = crc32(0, NULL, 0);
+            if(!buf.m_aInput.empty())
+                uCrc = crc32(uCrc, &buf.m_aInput[0], (uInt)buf.m_aInput.size());
+            TEST_ASSERT(pd.GetCrc32()==(uint32_t)uCrc);
+        }
+    }
+
+    // Blocks refer to the previous ones: repeated data compress as well as with a single stream
+    buf.m_aInput.clear();
+    MakeDumpData(aInflated, 20000);
+    for(i=0; i<100; i++)
+        buf.m_aInput.insert(buf.m_aInput.end(), aInflated.begin(), aInflated.end());
+    TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_OK);
+    TEST_ASSERT(buf.m_aOutput.size()<buf.m_aInput.size()/20);
+
+    // Store only
+    TEST_ASSERT(pd.Init(0, 2, BLOCK_SIZE)==PDEFLATE_OK);
+    TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_OK);
+    TEST_ASSERT(buf.m_aOutput.size()>buf.m_aInput.size());
+    TEST_ASSERT(Inflate(buf.m_aOutput, aInflated));
+    TEST_ASSERT(aInflated==buf.m_aInput);
+
+    __TEST_CLEANUP__;
+}
+
+void ParallelDeflateTests::Test_Errors()
+{
+    CParallelDeflate pd;
+    DeflateBuffers buf;
+    std::vector<unsigned char> aInflated;
+
+    // Not initialized
+    TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_ERR_INIT);
+
+    TEST_ASSERT(pd.Init(Z_DEFAULT_COMPRESSION, 3, 64*1024)==PDEFLATE_OK);
+    MakeDumpData(buf.m_aInput, 2*1024*1024);
+
+    // Read fails (the operation is cancelled) in the middle, while workers are busy
+    buf.m_nFailReadCall = 20;
+    TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_ERR_READ);
+    buf.m_nFailReadCall = -1;
+
+    // Write fails
+    buf.m_nFailWriteCall = 5;
+    TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_ERR_WRITE);
+    buf.m_nFailWriteCall = -1;
+
+    // The object is usable after errors
+    TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_OK);
+    TEST_ASSERT(Inflate(buf.m_aOutput, aInflated));
+    TEST_ASSERT(aInflated==buf.m_aInput);
+
+    __TEST_CLEANUP__;
+}
+
+void ParallelDeflateTests::Test_SetLevelAndStore()
+{
+    CParallelDeflate pd;
+    DeflateBuffers buf;
+    std::vector<unsigned char> aInflated;
+    size_t uFastSize = 0;
+    uLong uCrc = crc32(0, NULL, 0);
+
+    // Not initialized
+    TEST_ASSERT(pd.Store(ReadCallback, WriteCallback, &buf)==PDEFLATE_ERR_INIT);
+
+    TEST_ASSERT(pd.Init(9, 2, 64*1024)==PDEFLATE_OK);
+    MakeDumpData(buf.m_aInput, 1024*1024+5);
+    uCrc = crc32(uCrc, &buf.m_aInput[0], (uInt)buf.m_aInput.size());
+
+    // The level is changed between streams, workers keep their threads
+    pd.SetLevel(1);
+    TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_OK);
+    uFastSize = buf.m_aOutput.size();
+    TEST_ASSERT(Inflate(buf.m_aOutput, aInflated));
+    TEST_ASSERT(aInflated==buf.m_aInput);
+
+    pd.SetLevel(9);
+    TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_OK);
+    TEST_ASSERT(buf.m_aOutput.size()<uFastSize);
+    TEST_ASSERT(Inflate(buf.m_aOutput, aInflated));
+    TEST_ASSERT(aInflated==buf.m_aInput);
+
+    // Stored data are copied as is
+    buf.m_uReadPos = 0;
+    buf.m_aOutput.clear();
+    TEST_ASSERT(pd.Store(ReadCallback, WriteCallback, &buf)==PDEFLATE_OK);
+    TEST_ASSERT(buf.m_aOutput==buf.m_aInput);
+    TEST_ASSERT(pd.GetInputSize()==buf.m_aInput.size());
+    TEST_ASSERT(pd.GetOutputSize()==buf.m_aInput.size());
+    TEST_ASSERT(pd.GetCrc32()==(uint32_t)uCrc);
+
+    // Write fails
+    buf.m_uReadPos = 0;
+    buf.m_nWriteCalls = 0;
+    buf.m_nFailWriteCall = 3;
+    TEST_ASSERT(pd.Store(ReadCallback, WriteCallback, &buf)==PDEFLATE_ERR_WRITE);
+    buf.m_nFailWriteCall = -1;
+
+    // Compression works after storing
+    TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_OK);
+    TEST_ASSERT(Inflate(buf.m_aOutput, aInflated));
+    TEST_ASSERT(aInflated==buf.m_aInput);
+
+    __TEST_CLEANUP__;
+}
+
+void ParallelDeflateTests::FillMemFileFunc(zlib_filefunc64_def* pFileFunc, MemFile* pFile)
+{
+    pFileFunc->zopen64_file = MemOpen;
+    pFileFunc->zread_file = MemRead;
+    pFileFunc->zwrite_file = MemWrite;
+    pFileFunc->ztell64_file = MemTell;
+    pFileFunc->zseek64_file = MemSeek;
+    pFileFunc->zclose_file = MemClose;
+    pFileFunc->zerror_file = MemError;
+    pFileFunc->opaque = pFile;
+}
+
+voidpf ZCALLBACK ParallelDeflateTests::MemOpen(voidpf opaque, const void* /*filename*/, int /*mode*/)
+{
+    MemFile* pFile = (MemFile*)opaque;
+    pFile->m_aData.clear();
+    pFile->m_uPos = 0;
+    return pFile;
+}
+
+uLong ZCALLBACK ParallelDeflateTests::MemRead(voidpf /*opaque*/, voidpf stream, void* buf, uLong size)
+{
+    MemFile* pFile = (MemFile*)stream;
+    size_t uLeft = pFile->m_aData.size()-pFile->m_uPos;
+    uLong uRead = size<uLeft?size:(uLong)uLeft;
+    if(uRead!=0)
+        memcpy(buf, &pFile->m_aData[pFile->m_uPos], uRead);
+    pFile->m_uPos += uRead;
+    return uRead;
+}
+
+uLong ZCALLBACK ParallelDeflateTests::MemWrite(voidpf /*opaque*/, voidpf stream, const void* buf, uLong size)
+{
+    MemFile* pFile = (MemFile*)stream;
+    if(pFile->m_uPos+size>pFile->m_aData.size())
+        pFile->m_aData.resize(pFile->m_uPos+size);
+    memcpy(&pFile->m_aData[pFile->m_uPos], buf, size);
+    pFile->m_uPos += size;
+    return size;
+}
+
+ZPOS64_T ZCALLBACK ParallelDeflateTests::MemTell(voidpf /*opaque*/, voidpf stream)
+{
+    return ((MemFile*)stream)->m_uPos;
+}
+
+long ZCALLBACK ParallelDeflateTests::MemSeek(voidpf /*opaque*/, voidpf stream, ZPOS64_T offset, int origin)
+{
+    MemFile* pFile = (MemFile*)stream;
+    if(origin==ZLIB_FILEFUNC_SEEK_SET)
+        pFile->m_uPos = (size_t)offset;
+    else if(origin==ZLIB_FILEFUNC_SEEK_CUR)
+        pFile->m_uPos += (size_t)offset;
+    else
+        pFile->m_uPos = pFile->m_aData.size()+(size_t)offset;
+    return 0;
+}
+
+int ZCALLBACK ParallelDeflateTests::MemClose(voidpf /*opaque*/, voidpf /*stream*/)
+{
+    return 0;
+}
+
+int ZCALLBACK ParallelDeflateTests::MemError(voidpf /*opaque*/, voidpf /*stream*/)
+{
+    return 0;
+}
+
+void ParallelDeflateTests::Test_HashingFileFunc()
+{
+    MemFile file;
+    zlib_filefunc64_def base;
+    zlib_filefunc64_def func;
+    CHashingFileFunc hashing;
+    CReportDigest digest;
+    std::string sMD5Hash;
+    voidpf stream;
+
+    FillMemFileFunc(&base, &file);
+    hashing.Wrap(&base, &func);
+
+    // Sequential writes are hashed
+    stream = func.zopen64_file(func.opaque, "test.zip", ZLIB_FILEFUNC_MODE_CREATE|ZLIB_FILEFUNC_MODE_WRITE);
+    TEST_ASSERT(stream==&file);
+    TEST_ASSERT(func.zwrite_file(func.opaque, stream, "a", 1)==1);
+    TEST_ASSERT(func.ztell64_file(func.opaque, stream)==1);
+    TEST_ASSERT(func.zwrite_file(func.opaque, stream, "bc", 2)==2);
+    TEST_ASSERT(func.zclose_file(func.opaque, stream)==0);
+    TEST_ASSERT(hashing.GetMD5Hash(sMD5Hash));
+    TEST_ASSERT(sMD5Hash=="900150983cd24fb0d6963f7d28e17f72");
+    TEST_ASSERT(hashing.GetHashedSize()==3);
+
+    // Seeking to the end doesn't break the hash
+    stream = func.zopen64_file(func.opaque, "test.zip", ZLIB_FILEFUNC_MODE_CREATE|ZLIB_FILEFUNC_MODE_WRITE);
+    TEST_ASSERT(hashing.GetMD5Hash(sMD5Hash));
+    TEST_ASSERT(sMD5Hash=="d41d8cd98f00b204e9800998ecf8427e");
+    TEST_ASSERT(func.zwrite_file(func.opaque, stream, "ab", 2)==2);
+    TEST_ASSERT(func.zseek64_file(func.opaque, stream, 0, ZLIB_FILEFUNC_SEEK_END)==0);
+    TEST_ASSERT(func.zwrite_file(func.opaque, stream, "c", 1)==1);
+    TEST_ASSERT(hashing.GetMD5Hash(sMD5Hash));
+    TEST_ASSERT(sMD5Hash=="900150983cd24fb0d6963f7d28e17f72");
+
+    // Rewriting hashed data makes the hash invalid
+    TEST_ASSERT(func.zseek64_file(func.opaque, stream, 1, ZLIB_FILEFUNC_SEEK_SET)==0);
+    TEST_ASSERT(func.zwrite_file(func.opaque, stream, "B", 1)==1);
+    TEST_ASSERT(func.zseek64_file(func.opaque, stream, 0, ZLIB_FILEFUNC_SEEK_END)==0);
+    TEST_ASSERT(func.zwrite_file(func.opaque, stream, "d", 1)==1);
+    TEST_ASSERT(!hashing.GetMD5Hash(sMD5Hash));
+    TEST_ASSERT(sMD5Hash.empty());
+    TEST_ASSERT(func.zclose_file(func.opaque, stream)==0);
+    TEST_ASSERT(file.m_aData.size()==4 && file.m_aData[1]=='B');
+
+    // Appending to an existing file can't be hashed
+    stream = func.zopen64_file(func.opaque, "test.zip", ZLIB_FILEFUNC_MODE_EXISTING|ZLIB_FILEFUNC_MODE_WRITE);
+    TEST_ASSERT(!hashing.GetMD5Hash(sMD5Hash));
+    TEST_ASSERT(func.zclose_file(func.opaque, stream)==0);
+
+    // SHA-256 hash is calculated along with MD5 hash if requested
+    hashing.SetSHA256(true);
+    stream = func.zopen64_file(func.opaque, "test.zip", ZLIB_FILEFUNC_MODE_CREATE|ZLIB_FILEFUNC_MODE_WRITE);
+    TEST_ASSERT(func.zwrite_file(func.opaque, stream, "abc", 3)==3);
+    TEST_ASSERT(func.zclose_file(func.opaque, stream)==0);
+    TEST_ASSERT(hashing.GetDigest(digest));
+    TEST_ASSERT(digest.GetMD5Hash()=="900150983cd24fb0d6963f7d28e17f72");
+    TEST_ASSERT(digest.GetSHA256Hash()=="ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    __TEST_CLEANUP__;
+}
+
+void ParallelDeflateTests::Test_Benchmark_Compress()
+{
+    // Compresses a synthetic 32 MB crash dump the old way (single zlib stream fed
+    // in 1 KB portions), then with the parallel pipeline with one and all threads.
+
+    const size_t DUMP_SIZE = 32*1024*1024;
+    DeflateBuffers buf;
+    std::vector<unsigned char> aOutput(compressBound((uLong)DUMP_SIZE));
+    std::vector<unsigned char> aInflated;
+    CParallelDeflate pd;
+    CPerfTimer timer;
+    double dSerialMs = 0;
+    double dOneThreadMs = 0;
+    double dParallelMs = 0;
+    size_t uSerialSize = 0;
+    size_t uOneThreadSize = 0;
+    int nThreads = CParallelDeflate::GetProcessorCount();
+    z_stream strm;
+    size_t uPos;
+
+    MakeDumpData(buf.m_aInput, DUMP_SIZE);
+
+    // Single stream, 1 KB reads
+    timer.Start();
+    memset(&strm, 0, sizeof(strm));
+    TEST_ASSERT(deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)==Z_OK);
+    strm.next_out = &aOutput[0];
+    strm.avail_out = (uInt)aOutput.size();
+    for(uPos=0; uPos<DUMP_SIZE; uPos+=1024)
+    {
+        strm.next_in = &buf.m_aInput[uPos];
+        strm.avail_in = 1024;
+        deflate(&strm, uPos+1024<DUMP_SIZE?Z_NO_FLUSH:Z_FINISH);
+    }
+    uSerialSize = strm.total_out;
+    deflateEnd(&strm);
+    dSerialMs = timer.GetElapsedMs();
+
+    TEST_ASSERT(pd.Init(Z_DEFAULT_COMPRESSION, 1)==PDEFLATE_OK);
+    timer.Start();
+    TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_OK);
+    dOneThreadMs = timer.GetElapsedMs();
+    uOneThreadSize = buf.m_aOutput.size();
+
+    TEST_ASSERT(pd.Init(Z_DEFAULT_COMPRESSION, nThreads)==PDEFLATE_OK);
+    timer.Start();
+    TEST_ASSERT(Deflate(pd, buf)==PDEFLATE_OK);
+    dParallelMs = timer.GetElapsedMs();
+
+    printf("\n   %u MB dump: single stream %.0f ms (%u bytes), 1 thread %.0f ms (%u bytes), "
+        "%d threads %.0f ms (%u bytes, %.1fx)\n   ",
+        (unsigned)(DUMP_SIZE/(1024*1024)), dSerialMs, (unsigned)uSerialSize,
+        dOneThreadMs, (unsigned)uOneThreadSize, nThreads, dParallelMs,
+        (unsigned)buf.m_aOutput.size(), dSerialMs/dParallelMs);
+
+    // Output doesn't depend on the number of threads
+    TEST_ASSERT(buf.m_aOutput.size()==uOneThreadSize);
+    TEST_ASSERT(Inflate(buf.m_aOutput, aInflated));
+    TEST_ASSERT(aInflated==buf.m_aInput);
+
+    __TEST_CLEANUP__;
+}
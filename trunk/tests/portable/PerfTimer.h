@@ -0,0 +1,67 @@
+/************************************************************************************* 
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: PerfTimer.h
+// Description: High-resolution timer used by micro-benchmarks.
+
+#pragma once
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// class CPerfTimer
+// Measures elapsed wall-clock time.
+class CPerfTimer
+{
+public:
+
+    CPerfTimer()
+    {
+        Start();
+    }
+
+    // Resets the timer.
+    void Start()
+    {
+        m_dStartTime = GetTime();
+    }
+
+    // Returns time elapsed since Start() in milliseconds.
+    double GetElapsedMs() const
+    {
+        return (GetTime()-m_dStartTime)*1000.0;
+    }
+
+private:
+
+    // Returns current time in seconds.
+    static double GetTime()
+    {
+#ifdef _WIN32
+        LARGE_INTEGER freq;
+        LARGE_INTEGER counter;
+        QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&counter);
+        return (double)counter.QuadPart/(double)freq.QuadPart;
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec+(double)ts.tv_nsec/1e9;
+#endif
+    }
+
+    double m_dStartTime; // Time when the timer was started
+};
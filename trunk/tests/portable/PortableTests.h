@@ -0,0 +1,125 @@
+/************************************************************************************* 
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: PortableTests.h
+// Description: Minimal test framework for the platform-independent parts of CrashRpt. 
+// It mirrors the test suite macros of tests/Tests.h, but has no dependency on Windows 
+// headers, so the suites can be built and run by CTest on any platform.
+
+#pragma once
+#include <stdio.h>
+#include <stdarg.h>
+#include <string>
+#include <vector>
+#include <set>
+
+// What action to perform
+enum eAction
+{
+    GET_NAMES, // Return test names
+    RUN_TESTS  // Run tests
+};
+
+// Test suite class
+class CTestSuite
+{
+public:
+
+    // Constructor
+    CTestSuite()
+    {
+        m_bSuiteSetUpFailed = false;
+        m_bTestFailed = false;
+    }
+
+    virtual ~CTestSuite() {}
+
+    // Allocates resources used by tests in this suite
+    virtual void SetUp() = 0;  
+
+    // Frees resources used by tests in this suite
+    virtual void TearDown() = 0;
+
+    // Returns suite name and description
+    virtual void GetSuiteInfo(std::string& sName, std::string& sDescription) = 0;
+
+    // Returns the list of tests in this suite or runs tests
+    virtual void DoWithMyTests(eAction action, std::vector<std::string>& test_list) = 0;
+
+    // Runs all tests from this test suite. Returns false if any test failed.
+    bool Run();
+
+    // Returns the list of errors
+    const std::vector<std::string>& GetErrorList() const { return m_asErrorMsg; }
+
+    // Adds an error message to the list.
+    void AddErrorMsg(const char* szFunction, const char* szAssertion, const char* szMsg, ...);
+
+protected: 
+
+    bool BeforeTest(const char* szFunction);
+    void AfterTest(const char* szFunction);
+
+private:
+
+    std::vector<std::string> m_asErrorMsg; // The list of error messages
+    bool m_bSuiteSetUpFailed;
+    bool m_bTestFailed;
+};
+
+#define BEGIN_TEST_MAP( TestSuite , Description)\
+    virtual void GetSuiteInfo(std::string& sName, std::string& sDescription)\
+{\
+    sName = std::string( #TestSuite );\
+    sDescription = std::string( Description );\
+}\
+    virtual void DoWithMyTests(eAction action, std::vector<std::string>& test_list)\
+{
+
+#define REGISTER_TEST( Test )\
+    if(action==GET_NAMES)\
+    test_list.push_back( #Test );\
+else\
+{\
+    if(BeforeTest( #Test ))\
+    Test();\
+    AfterTest( #Test);\
+}
+
+#define END_TEST_MAP() }
+
+// The list of registered test suites
+std::vector<CTestSuite*>& GetTestSuites();
+
+extern CTestSuite* g_pCurTestSuite;
+
+#define TEST_ASSERT(expr)\
+    if(!(expr)) { g_pCurTestSuite->AddErrorMsg(__FUNCTION__, #expr, NULL); \
+    goto test_cleanup; }
+
+#define TEST_ASSERT_MSG(expr, ...)\
+	if(!(expr)) { g_pCurTestSuite->AddErrorMsg((__FUNCTION__), (#expr), __VA_ARGS__); \
+    goto test_cleanup; }
+
+#define __TEST_CLEANUP__ test_cleanup:
+
+template <class T>
+class CTestSuiteRegistrator
+{
+public:
+
+    CTestSuiteRegistrator()
+    {		
+        GetTestSuites().push_back(new T());
+    }
+};
+
+#define REGISTER_TEST_SUITE( Suite ) CTestSuiteRegistrator<Suite> __reg_##Suite;
+
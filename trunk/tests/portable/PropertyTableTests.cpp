@@ -0,0 +1,294 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "PropertyTable.h"
+#include "ThreadSync.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+class PropertyTableTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(PropertyTableTests, "CPropertyTable class tests")
+        REGISTER_TEST(Test_SetAndRead)
+        REGISTER_TEST(Test_Limits)
+        REGISTER_TEST(Test_ConcurrentRead)
+        REGISTER_TEST(Test_Benchmark_Updates)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_SetAndRead();
+    void Test_Limits();
+    void Test_ConcurrentRead();
+    void Test_Benchmark_Updates();
+
+private:
+
+    // Sets a property given as C strings
+    static int SetProp(CPropertyTable& table, const char* szName, const std::string& sValue);
+
+    // Reads all properties of the table. Returns false if a slot couldn't be read.
+    static bool ReadAll(const CPropertyTable& table, std::vector<std::string>& aNames,
+        std::vector<std::string>& aValues);
+
+    // Updates a property with values of a single repeated character
+    static void WriterThread(void* pParam);
+
+    // State shared with the writer thread
+    struct WriterState
+    {
+        CPropertyTable* m_pTable; // Table
+        int m_nUpdates;           // Number of updates to make
+        volatile bool m_bDone;    // Set when the writer has finished
+    };
+
+    std::vector<char> m_aMem; // Memory of the table
+};
+
+REGISTER_TEST_SUITE( PropertyTableTests );
+
+void PropertyTableTests::SetUp()
+{
+    m_aMem.assign(CPropertyTable::GetRequiredSize(), (char)0xCC);
+}
+
+void PropertyTableTests::TearDown()
+{
+    m_aMem.clear();
+}
+
+int PropertyTableTests::SetProp(CPropertyTable& table, const char* szName, const std::string& sValue)
+{
+    return table.Set(szName, strlen(szName), sValue.data(), sValue.size());
+}
+
+bool PropertyTableTests::ReadAll(const CPropertyTable& table, std::vector<std::string>& aNames,
+    std::vector<std::string>& aValues)
+{
+    int i;
+
+    aNames.clear();
+    aValues.clear();
+    for(i=0; i<table.GetSlotCount(); i++)
+    {
+        std::string sName;
+        std::string sValue;
+        int nResult = table.Read(i, sName, sValue);
+        if(nResult==PROPTABLE_ERR_EMPTY)
+            continue;
+        if(nResult!=PROPTABLE_OK)
+            return false;
+
+        aNames.push_back(sName);
+        aValues.push_back(sValue);
+    }
+
+    return true;
+}
+
+void PropertyTableTests::WriterThread(void* pParam)
+{
+    WriterState* pState = (WriterState*)pParam;
+    int i;
+
+    for(i=0; i<pState->m_nUpdates; i++)
+    {
+        std::string sValue((size_t)(i%PROPTABLE_MAX_VALUE_SIZE)+1, (char)('a'+i%26));
+        SetProp(*pState->m_pTable, "Document", sValue);
+    }
+
+    pState->m_bDone = true;
+}
+
+void PropertyTableTests::Test_SetAndRead()
+{
+    // Updates keep the property in its slot, other properties are not affected
+
+    CPropertyTable table;
+    CPropertyTable reader;
+    std::vector<std::string> aNames;
+    std::vector<std::string> aValues;
+    char szValue[32];
+    size_t i;
+
+    TEST_ASSERT(!table.IsAttached());
+    TEST_ASSERT(SetProp(table, "Name", "Value")!=PROPTABLE_OK);
+
+    table.Init(&m_aMem[0]);
+    TEST_ASSERT(table.IsAttached());
+    TEST_ASSERT(ReadAll(table, aNames, aValues));
+    TEST_ASSERT(aNames.empty());
+
+    TEST_ASSERT(SetProp(table, "AppState", "Idle")==PROPTABLE_OK);
+    TEST_ASSERT(SetProp(table, "Empty", "")==PROPTABLE_OK);
+    for(i=0; i<1000; i++)
+    {
+        sprintf(szValue, "%d", (int)i);
+        TEST_ASSERT(SetProp(table, "FrameCounter", szValue)==PROPTABLE_OK);
+    }
+
+    // The reader attaches to the memory, as CrashSender does
+    TEST_ASSERT(reader.Attach(&m_aMem[0], m_aMem.size()));
+    TEST_ASSERT(ReadAll(reader, aNames, aValues));
+    TEST_ASSERT(aNames.size()==3);
+    for(i=0; i<aNames.size(); i++)
+    {
+        if(aNames[i]=="AppState")
+        {
+            TEST_ASSERT(aValues[i]=="Idle");
+        }
+        else if(aNames[i]=="Empty")
+        {
+            TEST_ASSERT(aValues[i].empty());
+        }
+        else
+        {
+            TEST_ASSERT(aNames[i]=="FrameCounter");
+            TEST_ASSERT(aValues[i]=="999");
+        }
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void PropertyTableTests::Test_Limits()
+{
+    // Too long names and values, a full table, invalid memory
+
+    CPropertyTable table;
+    CPropertyTable reader;
+    std::vector<std::string> aNames;
+    std::vector<std::string> aValues;
+    std::string sLongName(PROPTABLE_MAX_NAME_SIZE+1, 'n');
+    std::string sLongValue(PROPTABLE_MAX_VALUE_SIZE+1, 'v');
+    std::string sMaxValue(PROPTABLE_MAX_VALUE_SIZE, 'v');
+    char szName[32];
+    int i;
+
+    table.Init(&m_aMem[0]);
+
+    TEST_ASSERT(SetProp(table, sLongName.c_str(), "Value")==PROPTABLE_ERR_TOO_LONG);
+    TEST_ASSERT(ReadAll(table, aNames, aValues));
+    TEST_ASSERT(aNames.empty());
+
+    // A value that doesn't fit hides the previous value
+    TEST_ASSERT(SetProp(table, "Log", sMaxValue)==PROPTABLE_OK);
+    TEST_ASSERT(SetProp(table, "Log", sLongValue)==PROPTABLE_ERR_TOO_LONG);
+    TEST_ASSERT(ReadAll(table, aNames, aValues));
+    TEST_ASSERT(aNames.empty());
+    TEST_ASSERT(SetProp(table, "Log", "Short")==PROPTABLE_OK);
+    TEST_ASSERT(ReadAll(table, aNames, aValues));
+    TEST_ASSERT(aNames.size()==1 && aValues[0]=="Short");
+
+    // Fill the table
+    for(i=1; i<PROPTABLE_SLOT_COUNT; i++)
+    {
+        sprintf(szName, "Prop%d", i);
+        TEST_ASSERT(SetProp(table, szName, szName)==PROPTABLE_OK);
+    }
+    TEST_ASSERT(SetProp(table, "OneMore", "Value")==PROPTABLE_ERR_FULL);
+    TEST_ASSERT(SetProp(table, "Prop7", "Updated")==PROPTABLE_OK);
+    TEST_ASSERT(ReadAll(table, aNames, aValues));
+    TEST_ASSERT((int)aNames.size()==PROPTABLE_SLOT_COUNT);
+
+    // Not a table
+    TEST_ASSERT(!reader.Attach(&m_aMem[0], m_aMem.size()-1));
+    memcpy(&m_aMem[0], "XXXX", 4);
+    TEST_ASSERT(!reader.Attach(&m_aMem[0], m_aMem.size()));
+    TEST_ASSERT(!reader.IsAttached());
+
+    __TEST_CLEANUP__;
+}
+
+void PropertyTableTests::Test_ConcurrentRead()
+{
+    // The reader never sees a value being written: each value is a single repeated
+    // character, a torn read would mix two
+
+    CPropertyTable table;
+    CSyncThread writer;
+    WriterState state;
+    int nReads = 0;
+    int nTorn = 0;
+
+    table.Init(&m_aMem[0]);
+    TEST_ASSERT(SetProp(table, "Document", "a")==PROPTABLE_OK);
+
+    state.m_pTable = &table;
+    state.m_nUpdates = 200000;
+    state.m_bDone = false;
+    TEST_ASSERT(writer.Start(WriterThread, &state));
+
+    do
+    {
+        std::vector<std::string> aNames;
+        std::vector<std::string> aValues;
+        if(!ReadAll(table, aNames, aValues))
+            continue;
+
+        nReads++;
+        if(aNames.size()!=1 || aNames[0]!="Document" || aValues[0].empty() ||
+            aValues[0].find_first_not_of(aValues[0][0])!=std::string::npos)
+            nTorn++;
+    }
+    while(!state.m_bDone);
+    writer.Join();
+
+    TEST_ASSERT(nTorn==0);
+    TEST_ASSERT(nReads>0);
+
+    __TEST_CLEANUP__;
+}
+
+void PropertyTableTests::Test_Benchmark_Updates()
+{
+    // Updates a frame counter property a million times. Appending a record per update
+    // (as property blocks are packed) would need this many bytes of shared memory.
+
+    const int UPDATES = 1000000;
+    CPropertyTable table;
+    CPerfTimer timer;
+    std::vector<std::string> aNames;
+    std::vector<std::string> aValues;
+    char szValue[32];
+    size_t uAppendSize = 0;
+    double dMs = 0;
+    int i;
+
+    table.Init(&m_aMem[0]);
+    SetProp(table, "Document", "C:\\Users\\user\\Documents\\drawing.svg");
+
+    timer.Start();
+    for(i=0; i<UPDATES; i++)
+    {
+        int nLen = sprintf(szValue, "%d", i);
+        if(table.Set("FrameCounter", 12, szValue, nLen)!=PROPTABLE_OK)
+            break;
+        uAppendSize += 3*8+(12+nLen)*2;
+    }
+    dMs = timer.GetElapsedMs();
+    TEST_ASSERT(i==UPDATES);
+
+    printf("\n   %d updates: %.0f ms, %.1f million updates/s (appending would use %.1f MB, "
+        "the table uses %.0f KB)\n   ", UPDATES, dMs, UPDATES/dMs/1000.0,
+        uAppendSize/(1024.0*1024.0), CPropertyTable::GetRequiredSize()/1024.0);
+
+    TEST_ASSERT(ReadAll(table, aNames, aValues));
+    TEST_ASSERT(aNames.size()==2);
+
+    __TEST_CLEANUP__;
+}
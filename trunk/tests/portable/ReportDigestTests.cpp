@@ -0,0 +1,297 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "ReportDigest.h"
+#include <vector>
+
+class ReportDigestTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(ReportDigestTests, "CReportDigest class tests")
+        REGISTER_TEST(Test_SHA256)
+        REGISTER_TEST(Test_Update)
+        REGISTER_TEST(Test_HashFile)
+        REGISTER_TEST(Test_ReadHashFile)
+        REGISTER_TEST(Test_Benchmark_HashFile)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_SHA256();
+    void Test_Update();
+    void Test_HashFile();
+    void Test_ReadHashFile();
+    void Test_Benchmark_HashFile();
+
+private:
+
+    // Writes pseudo-random data to a temporary file and rewinds it
+    static FILE* MakeTempFile(size_t uSize, std::vector<unsigned char>& aData);
+};
+
+REGISTER_TEST_SUITE( ReportDigestTests );
+
+void ReportDigestTests::SetUp()
+{
+}
+
+void ReportDigestTests::TearDown()
+{
+}
+
+FILE* ReportDigestTests::MakeTempFile(size_t uSize, std::vector<unsigned char>& aData)
+{
+    uint32_t uSeed = 12345;
+    size_t i;
+
+    aData.resize(uSize);
+    for(i=0; i<uSize; i++)
+    {
+        uSeed = uSeed*1103515245+12345;
+        aData[i] = (unsigned char)(uSeed>>16);
+    }
+
+    FILE* f = tmpfile();
+    if(f==NULL)
+        return NULL;
+
+    if(uSize!=0 && fwrite(&aData[0], 1, uSize, f)!=uSize)
+    {
+        fclose(f);
+        return NULL;
+    }
+
+    rewind(f);
+    return f;
+}
+
+void ReportDigestTests::Test_SHA256()
+{
+    CReportDigest digest;
+
+    // Test vectors of FIPS 180-2
+    digest.Init(true);
+    digest.Final();
+    TEST_ASSERT(digest.GetSHA256Hash()=="e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    TEST_ASSERT(digest.GetMD5Hash()=="d41d8cd98f00b204e9800998ecf8427e");
+
+    digest.Init(true);
+    digest.Update("abc", 3);
+    digest.Final();
+    TEST_ASSERT(digest.GetSHA256Hash()=="ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    TEST_ASSERT(digest.GetMD5Hash()=="900150983cd24fb0d6963f7d28e17f72");
+
+    digest.Init(true);
+    digest.Update("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56);
+    digest.Final();
+    TEST_ASSERT(digest.GetSHA256Hash()=="248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+    {
+        std::string sMillion(1000000, 'a');
+        digest.Init(true);
+        digest.Update(sMillion.data(), sMillion.length());
+        digest.Final();
+        TEST_ASSERT(digest.GetSHA256Hash()=="cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+        TEST_ASSERT(digest.GetSize()==1000000);
+    }
+
+    // SHA-256 is calculated only if requested
+    digest.Init(false);
+    digest.Update("abc", 3);
+    digest.Final();
+    TEST_ASSERT(digest.GetSHA256Hash().empty());
+    TEST_ASSERT(digest.GetMD5Hash()=="900150983cd24fb0d6963f7d28e17f72");
+
+    __TEST_CLEANUP__;
+}
+
+void ReportDigestTests::Test_Update()
+{
+    std::vector<unsigned char> aData(100000);
+    CReportDigest whole;
+    CReportDigest parts;
+    size_t i;
+
+    for(i=0; i<aData.size(); i++)
+        aData[i] = (unsigned char)(i*7+i/251);
+
+    whole.Init(true);
+    whole.Update(&aData[0], aData.size());
+    whole.Final();
+
+    // Portions of odd sizes cross the 64-byte block boundaries
+    parts.Init(true);
+    size_t uOffset = 0;
+    size_t uPortion = 1;
+    while(uOffset<aData.size())
+    {
+        size_t uSize = uPortion<aData.size()-uOffset ? uPortion : aData.size()-uOffset;
+        parts.Update(&aData[uOffset], uSize);
+        uOffset += uSize;
+        uPortion = uPortion*3%1000+1;
+    }
+
+    // A copy finalizes the digest of the data seen so far
+    CReportDigest copy = parts;
+    copy.Final();
+    parts.Final();
+
+    TEST_ASSERT(parts.GetMD5Hash()==whole.GetMD5Hash());
+    TEST_ASSERT(parts.GetSHA256Hash()==whole.GetSHA256Hash());
+    TEST_ASSERT(copy.GetSHA256Hash()==whole.GetSHA256Hash());
+
+    __TEST_CLEANUP__;
+}
+
+void ReportDigestTests::Test_HashFile()
+{
+    std::vector<unsigned char> aData;
+    CReportDigest expected;
+    CReportDigest digest;
+
+    // Larger than the read buffer and not a multiple of it
+    FILE* f = MakeTempFile(3*REPORT_DIGEST_READ_BUFFER_SIZE+17, aData);
+    TEST_ASSERT(f!=NULL);
+
+    expected.Init(true);
+    expected.Update(&aData[0], aData.size());
+    expected.Final();
+
+    TEST_ASSERT(digest.HashFile(f, true));
+    TEST_ASSERT(digest.GetSize()==aData.size());
+    TEST_ASSERT(digest.GetMD5Hash()==expected.GetMD5Hash());
+    TEST_ASSERT(digest.GetSHA256Hash()==expected.GetSHA256Hash());
+
+    rewind(f);
+    TEST_ASSERT(digest.HashFile(f, false));
+    TEST_ASSERT(digest.GetMD5Hash()==expected.GetMD5Hash());
+    TEST_ASSERT(digest.GetSHA256Hash().empty());
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
+
+void ReportDigestTests::Test_ReadHashFile()
+{
+    std::string sHash;
+    FILE* f = NULL;
+
+    TEST_ASSERT(CReportDigest::IsValidHash("900150983cd24fb0d6963f7d28e17f72", REPORT_DIGEST_MD5_LEN));
+    TEST_ASSERT(CReportDigest::IsValidHash("900150983CD24FB0D6963F7D28E17F72", REPORT_DIGEST_MD5_LEN));
+    TEST_ASSERT(!CReportDigest::IsValidHash("900150983cd24fb0d6963f7d28e17f7", REPORT_DIGEST_MD5_LEN));
+    TEST_ASSERT(!CReportDigest::IsValidHash("900150983cd24fb0d6963f7d28e17f7g", REPORT_DIGEST_MD5_LEN));
+
+    // A hash as saved by CrashSender
+    f = tmpfile();
+    TEST_ASSERT(f!=NULL);
+    fputs("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", f);
+    rewind(f);
+    TEST_ASSERT(CReportDigest::ReadHashFile(f, REPORT_DIGEST_SHA256_LEN, sHash));
+    TEST_ASSERT(sHash=="ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    fclose(f);
+
+    // A hash followed by a line break
+    f = tmpfile();
+    TEST_ASSERT(f!=NULL);
+    fputs("900150983cd24fb0d6963f7d28e17f72\n", f);
+    rewind(f);
+    TEST_ASSERT(CReportDigest::ReadHashFile(f, REPORT_DIGEST_MD5_LEN, sHash));
+    TEST_ASSERT(sHash=="900150983cd24fb0d6963f7d28e17f72");
+
+    // An MD5 hash is not a SHA-256 hash
+    rewind(f);
+    TEST_ASSERT(!CReportDigest::ReadHashFile(f, REPORT_DIGEST_SHA256_LEN, sHash));
+    TEST_ASSERT(sHash.empty());
+    fclose(f);
+
+    // A truncated file
+    f = tmpfile();
+    TEST_ASSERT(f!=NULL);
+    fputs("900150983cd24fb0d6963f7d28e17f72ff", f);
+    rewind(f);
+    TEST_ASSERT(!CReportDigest::ReadHashFile(f, REPORT_DIGEST_MD5_LEN, sHash));
+    fclose(f);
+    f = NULL;
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
+
+void ReportDigestTests::Test_Benchmark_HashFile()
+{
+    // Hashes a 64 MB report archive the old way (512-byte fread loop, repeated when the
+    // archive is compressed and then by each transport) and the new way (one pass in
+    // 1 MB blocks while the archive is written; transports read the saved digest).
+
+    const size_t FILE_SIZE = 64*1024*1024;
+    const int OLD_PASSES = 3; // CompressReportFiles, SendOverHTTP, SendOverSMTP
+    std::vector<unsigned char> aData;
+    std::vector<unsigned char> aBuffer(512);
+    CReportDigest digest;
+    CPerfTimer timer;
+    double dOldMs = 0;
+    double dNewMs = 0;
+    std::string sOldHash;
+
+    FILE* f = MakeTempFile(FILE_SIZE, aData);
+    TEST_ASSERT(f!=NULL);
+
+    timer.Start();
+    int nPass;
+    for(nPass=0; nPass<OLD_PASSES; nPass++)
+    {
+        MD5 md5;
+        MD5_CTX ctx;
+        unsigned char md5_hash[16];
+
+        rewind(f);
+        md5.MD5Init(&ctx);
+        while(!feof(f))
+        {
+            size_t count = fread(&aBuffer[0], 1, 512, f);
+            if(count>0)
+                md5.MD5Update(&ctx, &aBuffer[0], (unsigned int)count);
+        }
+        md5.MD5Final(md5_hash, &ctx);
+
+        int i;
+        sOldHash.clear();
+        for(i=0; i<16; i++)
+        {
+            char szNumber[3];
+            sprintf(szNumber, "%02x", md5_hash[i]);
+            sOldHash += szNumber;
+        }
+    }
+    dOldMs = timer.GetElapsedMs();
+
+    timer.Start();
+    rewind(f);
+    TEST_ASSERT(digest.HashFile(f, false));
+    dNewMs = timer.GetElapsedMs();
+
+    TEST_ASSERT(digest.GetMD5Hash()==sOldHash);
+
+    printf("\n   %u MB archive: %d passes with 512-byte reads %.0f ms, one pass with 1 MB reads %.0f ms\n   ",
+        (unsigned)(FILE_SIZE/(1024*1024)), OLD_PASSES, dOldMs, dNewMs);
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
@@ -0,0 +1,518 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "ReportIndex.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class ReportIndexTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(ReportIndexTests, "CReportIndex class tests")
+        REGISTER_TEST(Test_PutAndFind)
+        REGISTER_TEST(Test_Journal)
+        REGISTER_TEST(Test_TornRecord)
+        REGISTER_TEST(Test_InvalidFile)
+        REGISTER_TEST(Test_Retain)
+        REGISTER_TEST(Test_Benchmark_Open)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_PutAndFind();
+    void Test_Journal();
+    void Test_TornRecord();
+    void Test_InvalidFile();
+    void Test_Retain();
+    void Test_Benchmark_Open();
+
+private:
+
+    // Makes an entry of a report with the given number
+    static ReportIndexEntry MakeEntry(int nReport);
+
+    // Makes the report folder name
+    static std::string MakeName(int nReport);
+
+    // Returns true if the entries are equal
+    static bool IsEqual(const ReportIndexEntry& e1, const ReportIndexEntry& e2);
+
+    // Returns the file size, or -1 if it can't be opened
+    static long GetFileSize(const std::string& sFileName);
+
+    std::string m_sTmpFile; // Temporary index file
+};
+
+REGISTER_TEST_SUITE( ReportIndexTests );
+
+void ReportIndexTests::SetUp()
+{
+    m_sTmpFile = "ReportIndexTests.idx";
+    remove(m_sTmpFile.c_str());
+}
+
+void ReportIndexTests::TearDown()
+{
+    remove(m_sTmpFile.c_str());
+    remove((m_sTmpFile+".tmp").c_str());
+}
+
+ReportIndexEntry ReportIndexTests::MakeEntry(int nReport)
+{
+    char szBuf[64];
+    ReportIndexEntry e;
+
+    e.m_uDirTime = 130000000000000000ULL+(uint64_t)nReport*10000000;
+    sprintf(szBuf, "a1b2c3d4-0000-0000-0000-%012d", nReport);
+    e.m_sCrashGUID = szBuf;
+    e.m_sAppName = "MyApp";
+    e.m_sAppVersion = "1.2.3";
+    e.m_sImageName = "C:\\Program Files\\MyApp\\MyApp.exe";
+    sprintf(szBuf, "2013-05-%02dT10:20:30Z", 1+nReport%28);
+    e.m_sSystemTimeUTC = szBuf;
+    e.m_uTotalSize = 5000000000ULL+nReport;
+    e.m_nStatus = 0;
+
+    int i;
+    for(i=0; i<3+nReport%3; i++)
+    {
+        ReportIndexFile f;
+        sprintf(szBuf, "file%d.log", i);
+        f.m_sName = i==0?"crashdump.dmp":szBuf;
+        f.m_sDesc = i==0?"Crash Minidump":"Log file \xD0\xBB\xD0\xBE\xD0\xB3";
+        f.m_bOptional = i>1;
+        f.m_nSnapshotSize = i==2?(int64_t)nReport*1000:-1;
+        e.m_aFiles.push_back(f);
+    }
+
+    return e;
+}
+
+std::string ReportIndexTests::MakeName(int nReport)
+{
+    return MakeEntry(nReport).m_sCrashGUID;
+}
+
+bool ReportIndexTests::IsEqual(const ReportIndexEntry& e1, const ReportIndexEntry& e2)
+{
+    if(e1.m_uDirTime!=e2.m_uDirTime ||
+        e1.m_sCrashGUID!=e2.m_sCrashGUID ||
+        e1.m_sAppName!=e2.m_sAppName ||
+        e1.m_sAppVersion!=e2.m_sAppVersion ||
+        e1.m_sImageName!=e2.m_sImageName ||
+        e1.m_sSystemTimeUTC!=e2.m_sSystemTimeUTC ||
+        e1.m_uTotalSize!=e2.m_uTotalSize ||
+        e1.m_nStatus!=e2.m_nStatus ||
+        e1.m_aFiles.size()!=e2.m_aFiles.size())
+        return false;
+
+    size_t i;
+    for(i=0; i<e1.m_aFiles.size(); i++)
+    {
+        if(e1.m_aFiles[i].m_sName!=e2.m_aFiles[i].m_sName ||
+            e1.m_aFiles[i].m_sDesc!=e2.m_aFiles[i].m_sDesc ||
+            e1.m_aFiles[i].m_bOptional!=e2.m_aFiles[i].m_bOptional ||
+            e1.m_aFiles[i].m_nSnapshotSize!=e2.m_aFiles[i].m_nSnapshotSize)
+            return false;
+    }
+
+    return true;
+}
+
+long ReportIndexTests::GetFileSize(const std::string& sFileName)
+{
+    FILE* f = fopen(sFileName.c_str(), "rb");
+    if(f==NULL)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    long lSize = ftell(f);
+    fclose(f);
+    return lSize;
+}
+
+void ReportIndexTests::Test_PutAndFind()
+{
+    ReportIndexEntry e;
+    int i;
+
+    // SetUp() is called once per suite, so start from no file in each test
+    remove(m_sTmpFile.c_str());
+
+    {
+        CReportIndex index;
+
+        // A missing file gives an empty index
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+        TEST_ASSERT(index.GetEntryCount()==0);
+        TEST_ASSERT(!index.Find(MakeName(0), e));
+
+        for(i=0; i<10; i++)
+        {
+            TEST_ASSERT(index.Put(MakeName(i), MakeEntry(i))==RINDEX_OK);
+        }
+
+        TEST_ASSERT(index.GetEntryCount()==10);
+        TEST_ASSERT(index.GetRecordCount()==10);
+        TEST_ASSERT(index.Find(MakeName(3), e));
+        TEST_ASSERT(IsEqual(e, MakeEntry(3)));
+    }
+
+    {
+        // Entries are read back from the file
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+        TEST_ASSERT(index.GetEntryCount()==10);
+
+        for(i=0; i<10; i++)
+        {
+            TEST_ASSERT(index.Find(MakeName(i), e));
+            TEST_ASSERT(IsEqual(e, MakeEntry(i)));
+        }
+        TEST_ASSERT(!index.Find(MakeName(10), e));
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void ReportIndexTests::Test_Journal()
+{
+    ReportIndexEntry e;
+    ReportIndexEntry e5 = MakeEntry(5);
+    long lSize = 0;
+    int i;
+
+    remove(m_sTmpFile.c_str());
+
+    {
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+
+        for(i=0; i<8; i++)
+        {
+            TEST_ASSERT(index.Put(MakeName(i), MakeEntry(i))==RINDEX_OK);
+        }
+
+        // Delivery results, a delivered report and a report modified after it was indexed
+        TEST_ASSERT(index.SetStatus(MakeName(1), 3)==RINDEX_OK);
+        TEST_ASSERT(index.SetStatus(MakeName(2), 3)==RINDEX_OK);
+        TEST_ASSERT(index.SetStatus(MakeName(2), 0)==RINDEX_OK);
+        TEST_ASSERT(index.Remove(MakeName(4))==RINDEX_OK);
+        e5.m_uDirTime++;
+        e5.m_uTotalSize = 123;
+        e5.m_aFiles.pop_back();
+        TEST_ASSERT(index.Put(MakeName(5), e5)==RINDEX_OK);
+
+        // Unknown names and unchanged status don't make records
+        lSize = GetFileSize(m_sTmpFile);
+        TEST_ASSERT(index.SetStatus(MakeName(20), 3)==RINDEX_OK);
+        TEST_ASSERT(index.SetStatus(MakeName(1), 3)==RINDEX_OK);
+        TEST_ASSERT(index.Remove(MakeName(20))==RINDEX_OK);
+        TEST_ASSERT(GetFileSize(m_sTmpFile)==lSize);
+
+        TEST_ASSERT(index.GetEntryCount()==7);
+        TEST_ASSERT(index.GetRecordCount()==13);
+    }
+
+    {
+        // The journal is replayed in order
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+        TEST_ASSERT(index.GetEntryCount()==7);
+        TEST_ASSERT(index.GetRecordCount()==13);
+
+        TEST_ASSERT(index.Find(MakeName(1), e));
+        TEST_ASSERT(e.m_nStatus==3);
+        TEST_ASSERT(index.Find(MakeName(2), e));
+        TEST_ASSERT(e.m_nStatus==0);
+        TEST_ASSERT(!index.Find(MakeName(4), e));
+        TEST_ASSERT(index.Find(MakeName(5), e));
+        TEST_ASSERT(IsEqual(e, e5));
+
+        // Compaction leaves one record per entry
+        TEST_ASSERT(index.Compact()==RINDEX_OK);
+        TEST_ASSERT(index.GetRecordCount()==7);
+        TEST_ASSERT(GetFileSize(m_sTmpFile)<lSize);
+    }
+
+    {
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+        TEST_ASSERT(index.GetRecordCount()==7);
+        TEST_ASSERT(index.Find(MakeName(1), e));
+        TEST_ASSERT(e.m_nStatus==3);
+        TEST_ASSERT(index.Find(MakeName(5), e));
+        TEST_ASSERT(IsEqual(e, e5));
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void ReportIndexTests::Test_TornRecord()
+{
+    ReportIndexEntry e;
+    std::vector<char> aData;
+    FILE* f = NULL;
+    int i;
+
+    remove(m_sTmpFile.c_str());
+
+    {
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+        for(i=0; i<5; i++)
+        {
+            TEST_ASSERT(index.Put(MakeName(i), MakeEntry(i))==RINDEX_OK);
+        }
+    }
+
+    // Cut the last record as if the process was terminated while appending it
+    f = fopen(m_sTmpFile.c_str(), "rb");
+    TEST_ASSERT(f!=NULL);
+    fseek(f, 0, SEEK_END);
+    aData.resize(ftell(f));
+    rewind(f);
+    TEST_ASSERT(fread(&aData[0], 1, aData.size(), f)==aData.size());
+    fclose(f);
+    f = fopen(m_sTmpFile.c_str(), "wb");
+    TEST_ASSERT(f!=NULL);
+    TEST_ASSERT(fwrite(&aData[0], 1, aData.size()-10, f)==aData.size()-10);
+    fclose(f);
+    f = NULL;
+
+    {
+        // Complete records are kept, and the tail is dropped from the file
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+        TEST_ASSERT(index.GetEntryCount()==4);
+        TEST_ASSERT(!index.Find(MakeName(4), e));
+        TEST_ASSERT(index.GetRecordCount()==4);
+
+        // New records can be read back after the recovery
+        TEST_ASSERT(index.Put(MakeName(4), MakeEntry(4))==RINDEX_OK);
+    }
+
+    // Damage a byte of the second record; its CRC doesn't match then
+    f = fopen(m_sTmpFile.c_str(), "r+b");
+    TEST_ASSERT(f!=NULL);
+    fseek(f, (long)(aData.size()/5+20), SEEK_SET);
+    fputc(0x5A, f);
+    fclose(f);
+    f = NULL;
+
+    {
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+        TEST_ASSERT(index.GetEntryCount()==1);
+        TEST_ASSERT(index.Find(MakeName(0), e));
+        TEST_ASSERT(IsEqual(e, MakeEntry(0)));
+    }
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
+
+void ReportIndexTests::Test_InvalidFile()
+{
+    ReportIndexEntry e;
+    FILE* f = fopen(m_sTmpFile.c_str(), "wb");
+
+    TEST_ASSERT(f!=NULL);
+    fputs("[General]\nRemindPolicy=RemindLater\n", f);
+    fclose(f);
+    f = NULL;
+
+    {
+        // Not an index file: the index is empty and the file is replaced
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_ERR_INVALID_FILE);
+        TEST_ASSERT(index.GetEntryCount()==0);
+        TEST_ASSERT(index.Put(MakeName(1), MakeEntry(1))==RINDEX_OK);
+    }
+
+    {
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+        TEST_ASSERT(index.GetEntryCount()==1);
+        TEST_ASSERT(index.Find(MakeName(1), e));
+        TEST_ASSERT(IsEqual(e, MakeEntry(1)));
+    }
+
+    {
+        // Not opened: changes are kept in memory
+        CReportIndex index;
+        TEST_ASSERT(index.Put(MakeName(2), MakeEntry(2))==RINDEX_OK);
+        TEST_ASSERT(index.Find(MakeName(2), e));
+        TEST_ASSERT(index.GetRecordCount()==0);
+    }
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
+
+void ReportIndexTests::Test_Retain()
+{
+    ReportIndexEntry e;
+    std::vector<std::string> aNames;
+    int i;
+
+    remove(m_sTmpFile.c_str());
+
+    {
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+        for(i=0; i<10; i++)
+        {
+            TEST_ASSERT(index.Put(MakeName(i), MakeEntry(i))==RINDEX_OK);
+        }
+
+        // Nothing to drop and a short journal: the file is left as is
+        for(i=0; i<10; i++)
+            aNames.push_back(MakeName(i));
+        aNames.push_back(MakeName(100)); // A folder not indexed yet
+        TEST_ASSERT(index.Retain(aNames)==RINDEX_OK);
+        TEST_ASSERT(index.GetRecordCount()==10);
+
+        // Many status changes make the journal long
+        for(i=0; i<100; i++)
+        {
+            TEST_ASSERT(index.SetStatus(MakeName(i%10), 3-(i/10)%2*3)==RINDEX_OK);
+        }
+        TEST_ASSERT(index.GetRecordCount()==110);
+        TEST_ASSERT(index.Retain(aNames)==RINDEX_OK);
+        TEST_ASSERT(index.GetRecordCount()==10);
+
+        // Folders removed while the index wasn't updated are dropped
+        aNames.erase(aNames.begin()+2, aNames.begin()+5);
+        TEST_ASSERT(index.Retain(aNames)==RINDEX_OK);
+        TEST_ASSERT(index.GetEntryCount()==7);
+        TEST_ASSERT(index.GetRecordCount()==7);
+    }
+
+    {
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+        TEST_ASSERT(index.GetEntryCount()==7);
+        TEST_ASSERT(!index.Find(MakeName(3), e));
+        TEST_ASSERT(index.Find(MakeName(9), e));
+        TEST_ASSERT(e.m_nStatus==0);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void ReportIndexTests::Test_Benchmark_Open()
+{
+    // Compares listing a queue of 300 reports from the index with what the full
+    // rescan does: read crashrpt.xml and open every file of every report. The XML is
+    // only read, not parsed, so the rescan time is a lower bound.
+
+    const int REPORT_COUNT = 300;
+    const int FILE_COUNT = 4;
+    CPerfTimer timer;
+    double dIndexMs = 0;
+    double dRescanMs = 0;
+    std::string sXml;
+    std::vector<char> aBuf(64*1024);
+    ReportIndexEntry e;
+    char szFileName[64];
+    int nFound = 0;
+    int i, j;
+
+    remove(m_sTmpFile.c_str());
+
+    sXml = "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n<CrashRpt version=\"1403\">\n";
+    while(sXml.size()<6000)
+        sXml += "  <CustomProp name=\"Property\" value=\"Some value of the property\" />\n";
+    sXml += "</CrashRpt>\n";
+
+    {
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+
+        for(i=0; i<REPORT_COUNT; i++)
+        {
+            TEST_ASSERT(index.Put(MakeName(i), MakeEntry(i))==RINDEX_OK);
+
+            sprintf(szFileName, "rindex_bench_%d.xml", i);
+            FILE* f = fopen(szFileName, "wb");
+            TEST_ASSERT(f!=NULL);
+            fwrite(sXml.data(), 1, sXml.size(), f);
+            fclose(f);
+
+            for(j=0; j<FILE_COUNT; j++)
+            {
+                sprintf(szFileName, "rindex_bench_%d_%d.dat", i, j);
+                f = fopen(szFileName, "wb");
+                TEST_ASSERT(f!=NULL);
+                fwrite(&aBuf[0], 1, 1000*(j+1), f);
+                fclose(f);
+            }
+        }
+    }
+
+    timer.Start();
+    {
+        CReportIndex index;
+        TEST_ASSERT(index.Open(m_sTmpFile.c_str())==RINDEX_OK);
+        for(i=0; i<REPORT_COUNT; i++)
+        {
+            if(index.Find(MakeName(i), e))
+                nFound++;
+        }
+    }
+    dIndexMs = timer.GetElapsedMs();
+    TEST_ASSERT(nFound==REPORT_COUNT);
+
+    timer.Start();
+    for(i=0; i<REPORT_COUNT; i++)
+    {
+        sprintf(szFileName, "rindex_bench_%d.xml", i);
+        FILE* f = fopen(szFileName, "rb");
+        TEST_ASSERT(f!=NULL);
+        while(fread(&aBuf[0], 1, aBuf.size(), f)>0);
+        fclose(f);
+
+        for(j=0; j<FILE_COUNT; j++)
+        {
+            sprintf(szFileName, "rindex_bench_%d_%d.dat", i, j);
+            f = fopen(szFileName, "rb");
+            TEST_ASSERT(f!=NULL);
+            fseek(f, 0, SEEK_END);
+            TEST_ASSERT(ftell(f)==1000*(j+1));
+            fclose(f);
+        }
+    }
+    dRescanMs = timer.GetElapsedMs();
+
+    printf("\n   index: %.2f ms (%ld bytes), rescan: %.2f ms for %d reports\n   ",
+        dIndexMs, GetFileSize(m_sTmpFile), dRescanMs, REPORT_COUNT);
+
+    __TEST_CLEANUP__;
+
+    for(i=0; i<REPORT_COUNT; i++)
+    {
+        sprintf(szFileName, "rindex_bench_%d.xml", i);
+        remove(szFileName);
+        for(j=0; j<FILE_COUNT; j++)
+        {
+            sprintf(szFileName, "rindex_bench_%d_%d.dat", i, j);
+            remove(szFileName);
+        }
+    }
+}
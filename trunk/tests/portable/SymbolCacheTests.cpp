@@ -0,0 +1,339 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "SymbolCache.h"
+
+class SymbolCacheTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(SymbolCacheTests, "CSymbolCache class tests")
+        REGISTER_TEST(Test_ModuleKey)
+        REGISTER_TEST(Test_LookupAndSave)
+        REGISTER_TEST(Test_InvalidFile)
+        REGISTER_TEST(Test_SharedFile)
+        REGISTER_TEST(Test_Benchmark_Lookup)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_ModuleKey();
+    void Test_LookupAndSave();
+    void Test_InvalidFile();
+    void Test_SharedFile();
+    void Test_Benchmark_Lookup();
+
+private:
+
+    // Makes an entry for the given RVA
+    static SymCacheEntry MakeEntry(uint64_t uRva);
+
+    std::string m_sTmpFile; // Temporary cache file
+};
+
+REGISTER_TEST_SUITE( SymbolCacheTests );
+
+void SymbolCacheTests::SetUp()
+{
+    m_sTmpFile = "SymbolCacheTests.symcache";
+    remove(m_sTmpFile.c_str());
+}
+
+void SymbolCacheTests::TearDown()
+{
+    remove(m_sTmpFile.c_str());
+    remove((m_sTmpFile+".lock").c_str());
+}
+
+SymCacheEntry SymbolCacheTests::MakeEntry(uint64_t uRva)
+{
+    char szName[64];
+    sprintf(szName, "CMyClass::Method%u", (unsigned)(uRva/16));
+
+    SymCacheEntry e;
+    e.m_sSymbolName = szName;
+    e.m_uOffsInSymbol = uRva%16;
+    e.m_sSourceFile = (uRva/16)%2==0?"c:\\src\\myclass.cpp":"";
+    e.m_nSourceLine = (uRva/16)%2==0?(int)(uRva/16):-1;
+    return e;
+}
+
+void SymbolCacheTests::Test_ModuleKey()
+{
+    MdmpModuleRecord rec;
+    rec.m_sImageName = L"C:\\Program Files\\My App\\MyApp.exe";
+    rec.m_uTimeDateStamp = 0x4f2a3b1c;
+    rec.m_uImageSize = 0x1a000;
+
+    // Case is ignored, different builds give different keys
+    TEST_ASSERT(CSymbolCache::MakeModuleKey("MyApp.exe|4f2a3b1c|1a000")==
+        CSymbolCache::MakeModuleKey("myapp.EXE|4F2A3B1C|1A000"));
+    TEST_ASSERT(CSymbolCache::MakeModuleKey("MyApp.exe|4f2a3b1c|1a000")!=
+        CSymbolCache::MakeModuleKey("MyApp.exe|4f2a3b1d|1a000"));
+    TEST_ASSERT(CSymbolCache::MakeModuleKey("")!=0);
+
+    // Minidump module without CodeView record: wide image name is converted to
+    // UTF-8 and the directory is removed
+    TEST_ASSERT(CSymbolCache::MakeModuleKey(rec)==
+        CSymbolCache::MakeModuleKey("MyApp.exe|4f2a3b1c|1a000"));
+    rec.m_sImageName = L"/opt/b\u00fcro/Caf\u00e9.dll";
+    TEST_ASSERT(CSymbolCache::MakeModuleKey(rec)==
+        CSymbolCache::MakeModuleKey("Caf\xC3\xA9.dll|4f2a3b1c|1a000"));
+    rec.m_sImageName = L"Caf\u00e9.dll";
+    TEST_ASSERT(CSymbolCache::MakeModuleKey(rec)==
+        CSymbolCache::MakeModuleKey("Caf\xC3\xA9.dll|4f2a3b1c|1a000"));
+
+    // PDB signature and age are used when present, the image name is ignored
+    rec.m_bHasPdbInfo = true;
+    memset(rec.m_uchPdbGuid, 0xab, sizeof(rec.m_uchPdbGuid));
+    rec.m_uPdbAge = 3;
+    TEST_ASSERT(CSymbolCache::MakeModuleKey(rec)==
+        CSymbolCache::MakeModuleKey("abababababababababababababababab|3"));
+
+    __TEST_CLEANUP__;
+}
+
+void SymbolCacheTests::Test_LookupAndSave()
+{
+    uint64_t uKey1 = CSymbolCache::MakeModuleKey("app.exe|1|1000");
+    uint64_t uKey2 = CSymbolCache::MakeModuleKey("app.exe|2|1000");
+    SymCacheEntry e;
+    uint64_t uRva;
+
+    // SetUp() is called once per suite, so start from no file in each test
+    remove(m_sTmpFile.c_str());
+
+    {
+        CSymbolCache cache;
+
+        // There is no file yet - the cache is empty
+        TEST_ASSERT(cache.Open(m_sTmpFile.c_str())==SYMCACHE_OK);
+        TEST_ASSERT(cache.GetEntryCount()==0);
+        TEST_ASSERT(!cache.Lookup(uKey1, 0x1000, e));
+
+        for(uRva=0x1000; uRva<0x2000; uRva+=8)
+            cache.Add(uKey1, uRva, MakeEntry(uRva));
+
+        // New entries are found before saving
+        TEST_ASSERT(cache.Lookup(uKey1, 0x1008, e));
+        TEST_ASSERT(e.m_sSymbolName=="CMyClass::Method256" && e.m_uOffsInSymbol==8);
+        TEST_ASSERT(!cache.Lookup(uKey2, 0x1008, e));
+        TEST_ASSERT(cache.GetHitCount()==1 && cache.GetMissCount()==2);
+
+        TEST_ASSERT(cache.Save()==SYMCACHE_OK);
+        TEST_ASSERT(cache.GetEntryCount()==512);
+
+        // Entries are found in the mapped file after saving
+        TEST_ASSERT(cache.Lookup(uKey1, 0x1010, e));
+        TEST_ASSERT(e.m_sSymbolName=="CMyClass::Method257" && e.m_nSourceLine==-1);
+        TEST_ASSERT(e.m_sSourceFile.empty());
+    }
+
+    {
+        // The cache persists and new entries are merged with the file
+        CSymbolCache cache;
+        TEST_ASSERT(cache.Open(m_sTmpFile.c_str())==SYMCACHE_OK);
+        TEST_ASSERT(cache.GetEntryCount()==512);
+        TEST_ASSERT(cache.GetHitCount()==0);
+
+        TEST_ASSERT(cache.Lookup(uKey1, 0x1FF8, e));
+        TEST_ASSERT(e.m_sSymbolName=="CMyClass::Method511" && e.m_uOffsInSymbol==8);
+        TEST_ASSERT(cache.Lookup(uKey1, 0x1020, e));
+        TEST_ASSERT(e.m_sSourceFile=="c:\\src\\myclass.cpp" && e.m_nSourceLine==258);
+
+        cache.Add(uKey2, 0x1000, MakeEntry(0x1000));
+        TEST_ASSERT(cache.Save()==SYMCACHE_OK);
+        TEST_ASSERT(cache.GetEntryCount()==513);
+        TEST_ASSERT(cache.Lookup(uKey2, 0x1000, e));
+        TEST_ASSERT(cache.Lookup(uKey1, 0x1000, e));
+        TEST_ASSERT(!cache.Lookup(uKey2, 0x1008, e));
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void SymbolCacheTests::Test_InvalidFile()
+{
+    FILE* f = NULL;
+    SymCacheEntry e;
+    uint64_t uKey = CSymbolCache::MakeModuleKey("app.exe|1|1000");
+
+    remove(m_sTmpFile.c_str());
+
+    {
+        CSymbolCache cache;
+        TEST_ASSERT(cache.Open(m_sTmpFile.c_str())==SYMCACHE_OK);
+        cache.Add(uKey, 0x1000, MakeEntry(0x1000));
+        TEST_ASSERT(cache.Save()==SYMCACHE_OK);
+    }
+
+    // Truncate the file
+    {
+        std::vector<char> aData(1024);
+        f = fopen(m_sTmpFile.c_str(), "rb");
+        TEST_ASSERT(f!=NULL);
+        size_t uSize = fread(&aData[0], 1, aData.size(), f);
+        fclose(f);
+        f = fopen(m_sTmpFile.c_str(), "wb");
+        TEST_ASSERT(f!=NULL);
+        fwrite(&aData[0], 1, uSize-1, f);
+        fclose(f);
+        f = NULL;
+    }
+
+    {
+        // The invalid file is ignored and is overwritten on save
+        CSymbolCache cache;
+        TEST_ASSERT(cache.Open(m_sTmpFile.c_str())==SYMCACHE_ERR_INVALID_FILE);
+        TEST_ASSERT(cache.GetEntryCount()==0);
+        TEST_ASSERT(!cache.Lookup(uKey, 0x1000, e));
+        cache.Add(uKey, 0x1000, MakeEntry(0x1000));
+        TEST_ASSERT(cache.Save()==SYMCACHE_OK);
+    }
+
+    {
+        CSymbolCache cache;
+        TEST_ASSERT(cache.Open(m_sTmpFile.c_str())==SYMCACHE_OK);
+        TEST_ASSERT(cache.Lookup(uKey, 0x1000, e));
+    }
+
+    // Not a cache file
+    f = fopen(m_sTmpFile.c_str(), "wb");
+    TEST_ASSERT(f!=NULL);
+    fprintf(f, "This is not a symbol cache file, just some text.\n");
+    fclose(f);
+    f = NULL;
+
+    {
+        CSymbolCache cache;
+        TEST_ASSERT(cache.Open(m_sTmpFile.c_str())==SYMCACHE_ERR_INVALID_FILE);
+    }
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
+
+void SymbolCacheTests::Test_SharedFile()
+{
+    // Two caches (as in two crprober processes) open the same file and save their
+    // own entries. The second save must keep the entries of the first one.
+
+    uint64_t uKey1 = CSymbolCache::MakeModuleKey("app.exe|1|1000");
+    uint64_t uKey2 = CSymbolCache::MakeModuleKey("lib.dll|1|1000");
+    CSymbolCache cache1;
+    CSymbolCache cache2;
+    CSymbolCache cache3;
+    SymCacheEntry e;
+    uint64_t uRva;
+
+    remove(m_sTmpFile.c_str());
+
+    // Both are opened before either has saved
+    TEST_ASSERT(cache1.Open(m_sTmpFile.c_str())==SYMCACHE_OK);
+    TEST_ASSERT(cache2.Open(m_sTmpFile.c_str())==SYMCACHE_OK);
+
+    for(uRva=0x1000; uRva<0x1100; uRva+=8)
+    {
+        cache1.Add(uKey1, uRva, MakeEntry(uRva));
+        cache2.Add(uKey2, uRva, MakeEntry(uRva));
+    }
+    // The same address resolved by both
+    cache1.Add(uKey1, 0x2000, MakeEntry(0x2000));
+    cache2.Add(uKey1, 0x2000, MakeEntry(0x2000));
+
+    TEST_ASSERT(cache1.Save()==SYMCACHE_OK);
+    TEST_ASSERT(cache1.GetEntryCount()==33);
+    TEST_ASSERT(cache2.Save()==SYMCACHE_OK);
+    TEST_ASSERT(cache2.GetEntryCount()==65);
+
+    // The first cache sees the entries of the second one after its next save
+    TEST_ASSERT(!cache1.Lookup(uKey2, 0x1000, e));
+    cache1.Add(uKey1, 0x3000, MakeEntry(0x3000));
+    TEST_ASSERT(cache1.Save()==SYMCACHE_OK);
+    TEST_ASSERT(cache1.Lookup(uKey2, 0x1000, e));
+
+    TEST_ASSERT(cache3.Open(m_sTmpFile.c_str())==SYMCACHE_OK);
+    TEST_ASSERT(cache3.GetEntryCount()==66);
+    TEST_ASSERT(cache3.Lookup(uKey1, 0x10F8, e));
+    TEST_ASSERT(cache3.Lookup(uKey2, 0x10F8, e));
+    TEST_ASSERT(e.m_sSymbolName=="CMyClass::Method271");
+    TEST_ASSERT(cache3.Lookup(uKey1, 0x3000, e));
+
+    __TEST_CLEANUP__;
+}
+
+void SymbolCacheTests::Test_Benchmark_Lookup()
+{
+    // Simulates symbolizing frames of the same module build: 20 modules
+    // with 2000 distinct addresses each are looked up again and again.
+
+    const int MODULE_COUNT = 20;
+    const int RVA_COUNT = 2000;
+    const int LOOKUP_COUNT = 1000000;
+    std::vector<uint64_t> aKeys;
+    SymCacheEntry e;
+    CPerfTimer timer;
+    double dSaveMs = 0;
+    double dOpenMs = 0;
+    double dLookupMs = 0;
+    int nFound = 0;
+    int i;
+
+    for(i=0; i<MODULE_COUNT; i++)
+    {
+        char szIdentity[64];
+        sprintf(szIdentity, "module%d.dll|5a3b%04x|20000", i, i);
+        aKeys.push_back(CSymbolCache::MakeModuleKey(szIdentity));
+    }
+
+    remove(m_sTmpFile.c_str());
+
+    {
+        CSymbolCache cache;
+        TEST_ASSERT(cache.Open(m_sTmpFile.c_str())==SYMCACHE_OK);
+        for(i=0; i<MODULE_COUNT*RVA_COUNT; i++)
+            cache.Add(aKeys[i%MODULE_COUNT], 0x1000+(i/MODULE_COUNT)*16, MakeEntry((i/MODULE_COUNT)*16));
+
+        timer.Start();
+        TEST_ASSERT(cache.Save()==SYMCACHE_OK);
+        dSaveMs = timer.GetElapsedMs();
+    }
+
+    {
+        CSymbolCache cache;
+
+        timer.Start();
+        TEST_ASSERT(cache.Open(m_sTmpFile.c_str())==SYMCACHE_OK);
+        dOpenMs = timer.GetElapsedMs();
+        TEST_ASSERT(cache.GetEntryCount()==(size_t)MODULE_COUNT*RVA_COUNT);
+
+        timer.Start();
+        for(i=0; i<LOOKUP_COUNT; i++)
+        {
+            uint64_t uRva = 0x1000+(((uint64_t)i*7919)%RVA_COUNT)*16;
+            if(cache.Lookup(aKeys[i%MODULE_COUNT], uRva, e))
+                nFound++;
+        }
+        dLookupMs = timer.GetElapsedMs();
+
+        printf("\n   %d entries: save %.1f ms, open %.3f ms, lookup %.3f us/frame (%.1f%% hit rate)\n   ",
+            MODULE_COUNT*RVA_COUNT, dSaveMs, dOpenMs, dLookupMs*1000.0/LOOKUP_COUNT,
+            100.0*cache.GetHitCount()/(cache.GetHitCount()+cache.GetMissCount()));
+    }
+
+    TEST_ASSERT(nFound==LOOKUP_COUNT);
+
+    __TEST_CLEANUP__;
+}
@@ -0,0 +1,290 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "TableExporter.h"
+#include <string.h>
+#include <algorithm>
+
+class TableExporterTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(TableExporterTests, "CTableExporter class tests")
+        REGISTER_TEST(Test_JsonLines)
+        REGISTER_TEST(Test_Csv)
+        REGISTER_TEST(Test_Binary)
+        REGISTER_TEST(Test_WriteFailure)
+        REGISTER_TEST(Test_Benchmark_Export)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_JsonLines();
+    void Test_Csv();
+    void Test_Binary();
+    void Test_WriteFailure();
+    void Test_Benchmark_Export();
+
+private:
+
+    // Export callback that appends data to a std::string
+    static bool WriteToString(const void* pData, size_t uSize, void* pParam);
+
+    // Export callback that counts calls and always fails
+    static bool FailWrite(const void* pData, size_t uSize, void* pParam);
+
+    // Writes a module-like table with the given number of rows
+    static void ExportModules(CTableExporter& exporter, int nRowCount);
+};
+
+REGISTER_TEST_SUITE( TableExporterTests );
+
+void TableExporterTests::SetUp()
+{
+}
+
+void TableExporterTests::TearDown()
+{
+}
+
+bool TableExporterTests::WriteToString(const void* pData, size_t uSize, void* pParam)
+{
+    ((std::string*)pParam)->append((const char*)pData, uSize);
+    return true;
+}
+
+bool TableExporterTests::FailWrite(const void* /*pData*/, size_t /*uSize*/, void* pParam)
+{
+    (*(int*)pParam)++;
+    return false;
+}
+
+void TableExporterTests::ExportModules(CTableExporter& exporter, int nRowCount)
+{
+    std::vector<std::string> asColumns;
+    asColumns.push_back("ModuleName");
+    asColumns.push_back("ModuleBaseAddress");
+    asColumns.push_back("ModuleSize");
+
+    exporter.BeginReport("{3ee4a3a1-7a7e-4d5c-b6b9-0f3d2a1b8c01}");
+    exporter.BeginTable("MdmpModules", asColumns);
+
+    int i;
+    for(i=0; i<nRowCount; i++)
+    {
+        char szName[32];
+        sprintf(szName, "module%d.dll", i);
+
+        exporter.BeginRow(i);
+        exporter.AddString(szName, strlen(szName));
+        exporter.AddInt(0x7FF600000000LL+(int64_t)i*0x10000, false);
+        exporter.AddInt(0x2000, false);
+        exporter.EndRow();
+    }
+}
+
+void TableExporterTests::Test_JsonLines()
+{
+    std::string sOut;
+    std::vector<std::string> asColumns;
+    asColumns.push_back("Name");
+    asColumns.push_back("Value");
+    asColumns.push_back("Line");
+
+    {
+        CTableExporter exporter(EXPORT_FORMAT_JSONL, true, WriteToString, &sOut);
+        exporter.BeginReport("guid");
+        exporter.BeginTable("T", asColumns);
+
+        exporter.BeginRow(0);
+        exporter.AddString("a\"b\\c\n\x01", 7);
+        exporter.AddInt(-5, true);
+        exporter.AddNull();
+        exporter.EndRow();
+
+        exporter.BeginRow(1);
+        exporter.AddString("", 0);
+        exporter.AddInt(-1, false);
+        exporter.AddInt(0, true);
+        exporter.EndRow();
+
+        // Nothing is written until the buffer is flushed
+        TEST_ASSERT(sOut.empty());
+    }
+
+    TEST_ASSERT(sOut==
+        "{\"report\":\"guid\",\"table\":\"T\",\"row\":0,\"Name\":\"a\\\"b\\\\c\\n\\u0001\",\"Value\":-5,\"Line\":null}\n"
+        "{\"report\":\"guid\",\"table\":\"T\",\"row\":1,\"Name\":\"\",\"Value\":18446744073709551615,\"Line\":0}\n");
+
+    __TEST_CLEANUP__;
+}
+
+void TableExporterTests::Test_Csv()
+{
+    std::string sOut;
+    std::vector<std::string> asColumns;
+    asColumns.push_back("Name");
+    asColumns.push_back("Value");
+
+    {
+        CTableExporter exporter(EXPORT_FORMAT_CSV, true, WriteToString, &sOut);
+        exporter.BeginReport("r1");
+        exporter.BeginTable("STACK0", asColumns);
+        exporter.BeginRow(0);
+        exporter.AddString("a,b", 3);
+        exporter.AddInt(10, false);
+        exporter.EndRow();
+
+        // The second table of the same shape doesn't repeat the header
+        exporter.BeginTable("STACK1", asColumns);
+        exporter.BeginRow(0);
+        exporter.AddString("say \"hi\"", 8);
+        exporter.AddNull();
+        exporter.EndRow();
+    }
+
+    TEST_ASSERT(sOut==
+        "Report,Table,Row,Name,Value\r\n"
+        "r1,STACK0,0,\"a,b\",10\r\n"
+        "r1,STACK1,0,\"say \"\"hi\"\"\",\r\n");
+
+    // No header requested
+    sOut.clear();
+    {
+        CTableExporter exporter(EXPORT_FORMAT_CSV, false, WriteToString, &sOut);
+        exporter.BeginReport("r2");
+        exporter.BeginTable("T", asColumns);
+        exporter.BeginRow(3);
+        exporter.AddString("x", 1);
+        exporter.AddInt(-2, true);
+        exporter.EndRow();
+    }
+
+    TEST_ASSERT(sOut=="r2,T,3,x,-2\r\n");
+
+    __TEST_CLEANUP__;
+}
+
+void TableExporterTests::Test_Binary()
+{
+    std::string sOut;
+    std::vector<std::string> asColumns;
+    const unsigned char* p = NULL;
+    asColumns.push_back("N");
+    asColumns.push_back("S");
+
+    {
+        CTableExporter exporter(EXPORT_FORMAT_BINARY, true, WriteToString, &sOut);
+        exporter.BeginReport("id");
+        exporter.BeginTable("T", asColumns);
+        exporter.BeginRow(7);
+        exporter.AddInt(0x0102030405060708LL, false);
+        exporter.AddString("ab", 2);
+        exporter.EndRow();
+        exporter.BeginRow(8);
+        exporter.AddNull();
+        exporter.AddNull();
+        exporter.EndRow();
+    }
+
+    {
+        static const unsigned char expected[] =
+        {
+            // Report record
+            3,0,0,0, 'R', 'i','d',
+            // Table record
+            12,0,0,0, 'T', 1,0,'T', 2,0, 1,0,'N', 1,0,'S',
+            // Row 7
+            21,0,0,0, 'W', 7,0,0,0, 1, 8,7,6,5,4,3,2,1, 2, 2,0,0,0,'a','b',
+            // Row 8
+            7,0,0,0, 'W', 8,0,0,0, 0, 0
+        };
+
+        TEST_ASSERT(sOut.size()==sizeof(expected));
+        p = (const unsigned char*)sOut.data();
+        TEST_ASSERT(memcmp(p, expected, sizeof(expected))==0);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void TableExporterTests::Test_WriteFailure()
+{
+    int nCalls = 0;
+
+    TEST_ASSERT(CTableExporter::IsValidFormat(EXPORT_FORMAT_JSONL));
+    TEST_ASSERT(CTableExporter::IsValidFormat(EXPORT_FORMAT_BINARY));
+    TEST_ASSERT(!CTableExporter::IsValidFormat(0));
+    TEST_ASSERT(!CTableExporter::IsValidFormat(4));
+
+    {
+        // Enough rows to flush several times
+        CTableExporter exporter(EXPORT_FORMAT_JSONL, false, FailWrite, &nCalls);
+        ExportModules(exporter, 10000);
+        TEST_ASSERT(exporter.IsFailed());
+        TEST_ASSERT(!exporter.Flush());
+    }
+
+    // After the first failure the callback is not called anymore
+    TEST_ASSERT(nCalls==1);
+
+    __TEST_CLEANUP__;
+}
+
+void TableExporterTests::Test_Benchmark_Export()
+{
+    const int ROW_COUNT = 200000;
+    std::string sJson;
+    std::string sCsv;
+    std::string sBinary;
+    double dJsonMs = 0;
+    double dCsvMs = 0;
+    double dBinaryMs = 0;
+    CPerfTimer timer;
+
+    sJson.reserve(32*1024*1024);
+    sCsv.reserve(32*1024*1024);
+    sBinary.reserve(32*1024*1024);
+
+    timer.Start();
+    {
+        CTableExporter exporter(EXPORT_FORMAT_JSONL, true, WriteToString, &sJson);
+        ExportModules(exporter, ROW_COUNT);
+    }
+    dJsonMs = timer.GetElapsedMs();
+
+    timer.Start();
+    {
+        CTableExporter exporter(EXPORT_FORMAT_CSV, true, WriteToString, &sCsv);
+        ExportModules(exporter, ROW_COUNT);
+    }
+    dCsvMs = timer.GetElapsedMs();
+
+    timer.Start();
+    {
+        CTableExporter exporter(EXPORT_FORMAT_BINARY, true, WriteToString, &sBinary);
+        ExportModules(exporter, ROW_COUNT);
+    }
+    dBinaryMs = timer.GetElapsedMs();
+
+    printf("\n   %d rows: JSONL %.1f ms (%u KB), CSV %.1f ms (%u KB), binary %.1f ms (%u KB)\n   ",
+        ROW_COUNT, dJsonMs, (unsigned)(sJson.size()/1024), dCsvMs, (unsigned)(sCsv.size()/1024),
+        dBinaryMs, (unsigned)(sBinary.size()/1024));
+
+    // One line per row (plus CSV header)
+    TEST_ASSERT(std::count(sJson.begin(), sJson.end(), '\n')==ROW_COUNT);
+    TEST_ASSERT(std::count(sCsv.begin(), sCsv.end(), '\n')==ROW_COUNT+1);
+    TEST_ASSERT(sBinary.size()<sJson.size());
+
+    __TEST_CLEANUP__;
+}
@@ -0,0 +1,268 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "WebmWriter.h"
+#include <string.h>
+#include <string>
+#include <vector>
+
+class WebmWriterTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(WebmWriterTests, "CWebmWriter class tests")
+        REGISTER_TEST(Test_Structure)
+        REGISTER_TEST(Test_Errors)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_Structure();
+    void Test_Errors();
+
+private:
+
+    // An element read back from the file
+    struct Element
+    {
+        unsigned m_uID;
+        size_t m_uDataPos;   // Position of the element data
+        size_t m_uDataSize;  // Size of the element data
+    };
+
+    // Reads an element header at uPos. Returns false on malformed data.
+    static bool ReadElement(const std::vector<unsigned char>& aFile, size_t uPos, Element& element);
+
+    // Reads an unsigned integer value
+    static uint64_t ReadUInt(const std::vector<unsigned char>& aFile, const Element& element);
+
+    // Finds the first child element with the given ID. Returns false if not found.
+    static bool FindChild(const std::vector<unsigned char>& aFile, const Element& parent,
+        unsigned uID, Element& child);
+};
+
+REGISTER_TEST_SUITE( WebmWriterTests );
+
+void WebmWriterTests::SetUp()
+{
+}
+
+void WebmWriterTests::TearDown()
+{
+}
+
+bool WebmWriterTests::ReadElement(const std::vector<unsigned char>& aFile, size_t uPos, Element& element)
+{
+    if(uPos>=aFile.size())
+        return false;
+
+    // ID: leading zeros give the length, the marker bit is kept
+    int nLength = 1;
+    while(nLength<=4 && !(aFile[uPos]&(0x80>>(nLength-1))))
+        nLength++;
+    if(nLength>4 || uPos+nLength>aFile.size())
+        return false;
+
+    element.m_uID = 0;
+    int i;
+    for(i=0; i<nLength; i++)
+        element.m_uID = (element.m_uID<<8)|aFile[uPos+i];
+    uPos += nLength;
+
+    // Size: the marker bit is removed
+    if(uPos>=aFile.size() || aFile[uPos]==0)
+        return false;
+    nLength = 1;
+    while(!(aFile[uPos]&(0x80>>(nLength-1))))
+        nLength++;
+    if(uPos+nLength>aFile.size())
+        return false;
+
+    uint64_t uSize = aFile[uPos]&(0xFF>>nLength);
+    for(i=1; i<nLength; i++)
+        uSize = (uSize<<8)|aFile[uPos+i];
+    uPos += nLength;
+
+    if(uSize>aFile.size()-uPos)
+        return false;
+
+    element.m_uDataPos = uPos;
+    element.m_uDataSize = (size_t)uSize;
+    return true;
+}
+
+uint64_t WebmWriterTests::ReadUInt(const std::vector<unsigned char>& aFile, const Element& element)
+{
+    uint64_t uValue = 0;
+    size_t i;
+    for(i=0; i<element.m_uDataSize; i++)
+        uValue = (uValue<<8)|aFile[element.m_uDataPos+i];
+    return uValue;
+}
+
+bool WebmWriterTests::FindChild(const std::vector<unsigned char>& aFile, const Element& parent,
+    unsigned uID, Element& child)
+{
+    size_t uPos = parent.m_uDataPos;
+    while(uPos<parent.m_uDataPos+parent.m_uDataSize)
+    {
+        if(!ReadElement(aFile, uPos, child))
+            return false;
+        if(child.m_uID==uID)
+            return true;
+        uPos = child.m_uDataPos+child.m_uDataSize;
+    }
+    return false;
+}
+
+void WebmWriterTests::Test_Structure()
+{
+    // Writes frames and parses the file back
+
+    const int FRAMES = 12;
+    FILE* f = tmpfile();
+    CWebmWriter writer;
+    std::vector<unsigned char> aFile;
+    std::vector< std::vector<unsigned char> > aFrames(FRAMES);
+    uint64_t auTime[FRAMES];
+    bool abKey[FRAMES];
+    Element root, segment, element, track, video, child;
+    int nFrame = 0;
+    int nClusters = 0;
+    int i;
+
+    TEST_ASSERT(f!=NULL);
+    TEST_ASSERT(writer.Open(f, 640, 360, 100));
+
+    for(i=0; i<FRAMES; i++)
+    {
+        // A key frame every 5 frames; a long pause before frame 8 takes a new cluster
+        auTime[i] = (uint64_t)i*100+(i>=8 ? 40000 : 0);
+        abKey[i] = i%5==0;
+        aFrames[i].resize(i==3 ? 20000 : 10+i*17);
+        size_t j;
+        for(j=0; j<aFrames[i].size(); j++)
+            aFrames[i][j] = (unsigned char)(i*31+j);
+
+        TEST_ASSERT(writer.WriteFrame(&aFrames[i][0], aFrames[i].size(), auTime[i], abKey[i]));
+    }
+
+    // Time must not go back
+    TEST_ASSERT(!writer.WriteFrame(&aFrames[0][0], aFrames[0].size(), 0, true));
+
+    TEST_ASSERT(writer.Close());
+
+    fseek(f, 0, SEEK_END);
+    aFile.resize(ftell(f));
+    rewind(f);
+    TEST_ASSERT(fread(&aFile[0], 1, aFile.size(), f)==aFile.size());
+
+    // EBML header
+    TEST_ASSERT(ReadElement(aFile, 0, root));
+    TEST_ASSERT(root.m_uID==0x1A45DFA3);
+    TEST_ASSERT(FindChild(aFile, root, 0x4282, element));
+    TEST_ASSERT(std::string((const char*)&aFile[element.m_uDataPos], element.m_uDataSize)=="webm");
+
+    // The segment spans the rest of the file
+    TEST_ASSERT(ReadElement(aFile, root.m_uDataPos+root.m_uDataSize, segment));
+    TEST_ASSERT(segment.m_uID==0x18538067);
+    TEST_ASSERT(segment.m_uDataPos+segment.m_uDataSize==aFile.size());
+
+    // Duration in milliseconds, including the last frame
+    TEST_ASSERT(FindChild(aFile, segment, 0x1549A966, element));
+    TEST_ASSERT(FindChild(aFile, element, 0x2AD7B1, child));
+    TEST_ASSERT(ReadUInt(aFile, child)==1000000);
+    TEST_ASSERT(FindChild(aFile, element, 0x4489, child));
+    TEST_ASSERT(child.m_uDataSize==8);
+    {
+        uint64_t uBits = ReadUInt(aFile, child);
+        double dDuration;
+        memcpy(&dDuration, &uBits, sizeof(dDuration));
+        TEST_ASSERT(dDuration==(double)(auTime[FRAMES-1]+100));
+    }
+
+    // VP8 track
+    TEST_ASSERT(FindChild(aFile, segment, 0x1654AE6B, element));
+    TEST_ASSERT(FindChild(aFile, element, 0xAE, track));
+    TEST_ASSERT(FindChild(aFile, track, 0x86, child));
+    TEST_ASSERT(std::string((const char*)&aFile[child.m_uDataPos], child.m_uDataSize)=="V_VP8");
+    TEST_ASSERT(FindChild(aFile, track, 0xE0, video));
+    TEST_ASSERT(FindChild(aFile, video, 0xB0, child));
+    TEST_ASSERT(ReadUInt(aFile, child)==640);
+    TEST_ASSERT(FindChild(aFile, video, 0xBA, child));
+    TEST_ASSERT(ReadUInt(aFile, child)==360);
+
+    // Clusters of simple blocks
+    {
+        size_t uPos = segment.m_uDataPos;
+        while(uPos<aFile.size())
+        {
+            TEST_ASSERT(ReadElement(aFile, uPos, element));
+            uPos = element.m_uDataPos+element.m_uDataSize;
+            if(element.m_uID!=0x1F43B675)
+                continue;
+
+            nClusters++;
+
+            Element block;
+            uint64_t uClusterTime = 0;
+            size_t uBlockPos = element.m_uDataPos;
+            TEST_ASSERT(FindChild(aFile, element, 0xE7, child));
+            uClusterTime = ReadUInt(aFile, child);
+
+            while(uBlockPos<element.m_uDataPos+element.m_uDataSize)
+            {
+                TEST_ASSERT(ReadElement(aFile, uBlockPos, block));
+                uBlockPos = block.m_uDataPos+block.m_uDataSize;
+                if(block.m_uID!=0xA3)
+                    continue;
+
+                const unsigned char* p = &aFile[block.m_uDataPos];
+                TEST_ASSERT(nFrame<FRAMES);
+                TEST_ASSERT(p[0]==0x81);
+                TEST_ASSERT(uClusterTime+((p[1]<<8)|p[2])==auTime[nFrame]);
+                TEST_ASSERT(((p[3]&0x80)!=0)==abKey[nFrame]);
+                TEST_ASSERT(block.m_uDataSize==aFrames[nFrame].size()+4);
+                TEST_ASSERT(memcmp(p+4, &aFrames[nFrame][0], aFrames[nFrame].size())==0);
+
+                // A cluster starts with a key frame, except after a long pause
+                if(abKey[nFrame])
+                {
+                    TEST_ASSERT(uClusterTime==auTime[nFrame]);
+                }
+
+                nFrame++;
+            }
+        }
+    }
+
+    TEST_ASSERT(nFrame==FRAMES);
+    TEST_ASSERT(nClusters==4); // Key frames 0, 5, 10 and the pause before frame 8
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
+
+void WebmWriterTests::Test_Errors()
+{
+    CWebmWriter writer;
+    unsigned char abData[4] = {1, 2, 3, 4};
+
+    // Not opened
+    TEST_ASSERT(!writer.WriteFrame(abData, sizeof(abData), 0, true));
+    TEST_ASSERT(!writer.Close());
+    TEST_ASSERT(!writer.Open(NULL, 320, 240, 100));
+
+    __TEST_CLEANUP__;
+}
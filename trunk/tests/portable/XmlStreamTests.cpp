@@ -0,0 +1,630 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "XmlStream.h"
+#include "tinyxml.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+class XmlStreamTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(XmlStreamTests, "CXmlWriter and CXmlPullParser class tests")
+        REGISTER_TEST(Test_WriteLayout)
+        REGISTER_TEST(Test_WriteWide)
+        REGISTER_TEST(Test_ParseValues)
+        REGISTER_TEST(Test_Navigation)
+        REGISTER_TEST(Test_Malformed)
+        REGISTER_TEST(Test_Benchmark_CrashDesc)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_WriteLayout();
+    void Test_WriteWide();
+    void Test_ParseValues();
+    void Test_Navigation();
+    void Test_Malformed();
+    void Test_Benchmark_CrashDesc();
+
+private:
+
+    // Values read from a crash description
+    struct CrashDesc
+    {
+        std::string m_sVersion;
+        std::string m_sAppName;
+        std::string m_sAppVersion;
+        std::string m_sDesc;
+        std::string m_sEmpty;
+        std::vector<std::string> m_aPropNames;
+        std::vector<std::string> m_aPropValues;
+        int m_nFileItems;
+    };
+
+    // Returns the whole content of a temporary file
+    static std::string ReadTempFile(FILE* f);
+
+    // Returns the text of the element if its first child is text, as CrashRpt did with TinyXML
+    static std::string GetTinyXmlText(TiXmlElement* pElem);
+
+    // Reads the crash description with TinyXML
+    static bool ReadWithTinyXml(TiXmlDocument& doc, CrashDesc& desc);
+
+    // Reads the crash description with the pull parser
+    static bool ReadWithPullParser(CXmlPullParser& parser, CrashDesc& desc);
+
+    std::vector<std::string> m_aNames;  // Property names for the benchmark
+    std::vector<std::string> m_aValues; // Property values for the benchmark
+};
+
+REGISTER_TEST_SUITE( XmlStreamTests );
+
+void XmlStreamTests::SetUp()
+{
+}
+
+void XmlStreamTests::TearDown()
+{
+    m_aNames.clear();
+    m_aValues.clear();
+}
+
+std::string XmlStreamTests::ReadTempFile(FILE* f)
+{
+    std::string sData;
+    char buf[4096];
+    size_t uRead;
+
+    fflush(f);
+    rewind(f);
+    while((uRead=fread(buf, 1, sizeof(buf), f))>0)
+        sData.append(buf, uRead);
+
+    return sData;
+}
+
+std::string XmlStreamTests::GetTinyXmlText(TiXmlElement* pElem)
+{
+    if(pElem==NULL || pElem->FirstChild()==NULL || pElem->FirstChild()->ToText()==NULL)
+        return "";
+
+    return pElem->FirstChild()->ToText()->Value();
+}
+
+bool XmlStreamTests::ReadWithTinyXml(TiXmlDocument& doc, CrashDesc& desc)
+{
+    TiXmlHandle hRoot = TiXmlHandle(&doc).FirstChild("CrashRpt");
+    if(hRoot.ToElement()==NULL)
+        return false;
+
+    const char* szVersion = hRoot.ToElement()->Attribute("version");
+    desc.m_sVersion = szVersion!=NULL ? szVersion : "";
+    desc.m_sAppName = GetTinyXmlText(hRoot.FirstChild("AppName").ToElement());
+    desc.m_sAppVersion = GetTinyXmlText(hRoot.FirstChild("AppVersion").ToElement());
+    desc.m_sDesc = GetTinyXmlText(hRoot.FirstChild("Desc").ToElement());
+    desc.m_sEmpty = GetTinyXmlText(hRoot.FirstChild("Empty").ToElement());
+
+    TiXmlHandle hProp = hRoot.FirstChild("CustomProps").FirstChild("Prop");
+    while(hProp.ToElement()!=NULL)
+    {
+        const char* szName = hProp.ToElement()->Attribute("name");
+        const char* szValue = hProp.ToElement()->Attribute("value");
+        desc.m_aPropNames.push_back(szName!=NULL ? szName : "");
+        desc.m_aPropValues.push_back(szValue!=NULL ? szValue : "");
+        hProp = hProp.ToElement()->NextSibling("Prop");
+    }
+
+    desc.m_nFileItems = 0;
+    TiXmlHandle hFileItem = hRoot.FirstChild("FileList").FirstChild("FileItem");
+    while(hFileItem.ToElement()!=NULL)
+    {
+        if(hFileItem.ToElement()->Attribute("name")!=NULL)
+            desc.m_nFileItems++;
+        hFileItem = hFileItem.ToElement()->NextSibling("FileItem");
+    }
+
+    return true;
+}
+
+bool XmlStreamTests::ReadWithPullParser(CXmlPullParser& parser, CrashDesc& desc)
+{
+    desc.m_nFileItems = 0;
+
+    if(!parser.ReadChildElement(-1) || strcmp(parser.GetName(), "CrashRpt")!=0)
+        return false;
+
+    const char* szVersion = parser.GetAttribute("version");
+    desc.m_sVersion = szVersion!=NULL ? szVersion : "";
+
+    int nRootDepth = parser.GetDepth();
+    while(parser.ReadChildElement(nRootDepth))
+    {
+        const char* szName = parser.GetName();
+        if(strcmp(szName, "AppName")==0)
+            desc.m_sAppName = parser.ReadElementText();
+        else if(strcmp(szName, "AppVersion")==0)
+            desc.m_sAppVersion = parser.ReadElementText();
+        else if(strcmp(szName, "Desc")==0)
+            desc.m_sDesc = parser.ReadElementText();
+        else if(strcmp(szName, "Empty")==0)
+            desc.m_sEmpty = parser.ReadElementText();
+        else if(strcmp(szName, "CustomProps")==0)
+        {
+            while(parser.ReadChildElement(nRootDepth+1))
+            {
+                if(strcmp(parser.GetName(), "Prop")!=0)
+                    continue;
+                const char* szPropName = parser.GetAttribute("name");
+                const char* szPropValue = parser.GetAttribute("value");
+                desc.m_aPropNames.push_back(szPropName!=NULL ? szPropName : "");
+                desc.m_aPropValues.push_back(szPropValue!=NULL ? szPropValue : "");
+            }
+        }
+        else if(strcmp(szName, "FileList")==0)
+        {
+            while(parser.ReadChildElement(nRootDepth+1))
+            {
+                if(strcmp(parser.GetName(), "FileItem")==0 && parser.GetAttribute("name")!=NULL)
+                    desc.m_nFileItems++;
+            }
+        }
+    }
+
+    return parser.GetNodeType()!=XML_NODE_ERROR;
+}
+
+void XmlStreamTests::Test_WriteLayout()
+{
+    // The writer produces the same file as TinyXML did for the same document
+
+    FILE* fTiny = tmpfile();
+    FILE* fStream = tmpfile();
+    CXmlWriter writer;
+    TiXmlDocument doc;
+    TiXmlElement* pRoot = NULL;
+    TiXmlElement* pElem = NULL;
+    TiXmlElement* pProps = NULL;
+    std::string sTiny;
+    std::string sStream;
+    const char* szMemExpected =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+        "<A>\n"
+        "    <B x=\"&quot;1&quot;\" />\n"
+        "    <C>t&#x09;</C>\n"
+        "</A>\n";
+
+    TEST_ASSERT(fTiny!=NULL && fStream!=NULL);
+
+    // TinyXML document built as CErrorReportSender::CreateCrashDescriptionXML() did
+    doc.LinkEndChild(new TiXmlDeclaration("1.0", "UTF-8", ""));
+    pRoot = new TiXmlElement("CrashRpt");
+    doc.LinkEndChild(pRoot);
+    pRoot->SetAttribute("version", "1500");
+    pElem = new TiXmlElement("CrashGUID");
+    pElem->LinkEndChild(new TiXmlText("0b4e54ae-9a1c-4c3b-8d3a-6b1f1f4f6a10"));
+    pRoot->LinkEndChild(pElem);
+    pElem = new TiXmlElement("AppName");
+    pElem->LinkEndChild(new TiXmlText("Tom & Jerry's <App>"));
+    pRoot->LinkEndChild(pElem);
+    pElem = new TiXmlElement("GeoLocation");
+    pElem->LinkEndChild(new TiXmlText(""));
+    pRoot->LinkEndChild(pElem);
+    pProps = new TiXmlElement("CustomProps");
+    pRoot->LinkEndChild(pProps);
+    pElem = new TiXmlElement("Prop");
+    pElem->SetAttribute("name", "Log");
+    pElem->SetAttribute("value", "line1\nline2\t\xC3\xA9");
+    pProps->LinkEndChild(pElem);
+    pElem = new TiXmlElement("Prop");
+    pElem->SetAttribute("name", "Empty");
+    pElem->SetAttribute("value", "");
+    pProps->LinkEndChild(pElem);
+    pRoot->LinkEndChild(new TiXmlElement("FileList"));
+    doc.useMicrosoftBOM = true;
+    TEST_ASSERT(doc.SaveFile(fTiny));
+
+    // The same document written by the stream writer
+    writer.Open(fStream, true);
+    writer.BeginElement("CrashRpt");
+    writer.AddAttribute("version", "1500");
+    writer.AddElement("CrashGUID", "0b4e54ae-9a1c-4c3b-8d3a-6b1f1f4f6a10");
+    writer.AddElement("AppName", "Tom & Jerry's <App>");
+    writer.AddElement("GeoLocation", "");
+    writer.BeginElement("CustomProps");
+    writer.BeginElement("Prop");
+    writer.AddAttribute("name", "Log");
+    writer.AddAttribute("value", "line1\nline2\t\xC3\xA9");
+    writer.EndElement();
+    writer.BeginElement("Prop");
+    writer.AddAttribute("name", "Empty");
+    writer.AddAttribute("value", "");
+    writer.EndElement();
+    writer.EndElement();
+    writer.BeginElement("FileList");
+    writer.EndElement();
+    TEST_ASSERT(writer.Close());
+
+    sTiny = ReadTempFile(fTiny);
+    sStream = ReadTempFile(fStream);
+    TEST_ASSERT(!sTiny.empty());
+    TEST_ASSERT(sStream==sTiny);
+
+    // Document in memory, elements left open are ended by Close()
+    writer.Open(NULL, false);
+    writer.BeginElement("A");
+    writer.BeginElement("B");
+    writer.AddAttribute("x", "\"1\"");
+    writer.EndElement();
+    writer.BeginElement("C");
+    writer.AddText("t\t");
+    TEST_ASSERT(writer.Close());
+    TEST_ASSERT(std::string(writer.GetData(), writer.GetSize())==szMemExpected);
+
+    __TEST_CLEANUP__;
+
+    if(fTiny!=NULL)
+        fclose(fTiny);
+    if(fStream!=NULL)
+        fclose(fStream);
+}
+
+void XmlStreamTests::Test_WriteWide()
+{
+    // Wide strings are written as UTF-8 and read back
+
+    CXmlWriter writer;
+    CXmlPullParser parser;
+    std::wstring sValue = L"caf\u00e9 <&> ";
+    std::wstring sText = L"\u4e2d\u6587";
+    int i;
+
+    // A character outside of BMP, as a surrogate pair where wchar_t is 16-bit
+    if(sizeof(wchar_t)==2)
+    {
+        sText += (wchar_t)0xD83D;
+        sText += (wchar_t)0xDE00;
+    }
+    else
+        sText += (wchar_t)0x1F600;
+    // Unpaired surrogate is replaced
+    sValue += (wchar_t)0xD800;
+
+    writer.Open(NULL, true);
+    writer.BeginElement("Root");
+    writer.AddAttribute("value", sValue.c_str());
+    writer.AddElement("Text", sText.c_str());
+    // Elements nested too deep are not written
+    for(i=0; i<XML_WRITER_MAX_DEPTH; i++)
+        writer.BeginElement("Deep");
+    for(i=0; i<XML_WRITER_MAX_DEPTH; i++)
+        writer.EndElement();
+    writer.EndElement();
+    TEST_ASSERT(!writer.Close());
+
+    parser.Open(writer.GetData(), writer.GetSize());
+    TEST_ASSERT(parser.ReadChildElement(-1));
+    TEST_ASSERT(parser.GetAttribute("value")!=NULL);
+    TEST_ASSERT(strcmp(parser.GetAttribute("value"), "caf\xC3\xA9 <&> \xEF\xBF\xBD")==0);
+    TEST_ASSERT(parser.ReadChildElement(0));
+    TEST_ASSERT(strcmp(parser.ReadElementText(), "\xE4\xB8\xAD\xE6\x96\x87\xF0\x9F\x98\x80")==0);
+    TEST_ASSERT(parser.ReadChildElement(0));
+    TEST_ASSERT(strcmp(parser.GetName(), "Deep")==0);
+    TEST_ASSERT(!parser.ReadChildElement(0));
+    TEST_ASSERT(parser.Read()==XML_NODE_EOF);
+
+    __TEST_CLEANUP__;
+}
+
+void XmlStreamTests::Test_ParseValues()
+{
+    // Text and attribute values are the same as TinyXML returns when loading the file
+
+    const char* szXml =
+        "\xEF\xBB\xBF<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\r\n"
+        "<!-- comment <not a tag> -->\r\n"
+        "<CrashRpt version=\"1500\">\r\n"
+        "  <AppName>  My   App\r\n  &amp; &lt;Co&gt; </AppName>\r\n"
+        "  <AppVersion>1.0&#x0A;beta &#233; &#x1F600;</AppVersion>\r\n"
+        "  <Skipped><Deep a='1'>text<AppName>Not this</AppName></Deep></Skipped>\r\n"
+        "  <Desc><![CDATA[ <raw> & text ]]></Desc>\r\n"
+        "  <CustomProps>\r\n"
+        "    <Prop name='single &quot;q&quot;' value=\"line1\r\nline2  x\" />\r\n"
+        "    <Prop name = \"spaced\"\tvalue=\"&apos;&#65;\"/>\r\n"
+        "    <!-- <Prop name=\"commented\" value=\"\"/> -->\r\n"
+        "  </CustomProps>\r\n"
+        "  <FileList><FileItem name=\"crashdump.dmp\" /><FileItem/></FileList>\r\n"
+        "  <Empty></Empty>\r\n"
+        "</CrashRpt>\r\n";
+
+    FILE* f = tmpfile();
+    TiXmlDocument doc;
+    CXmlPullParser parser;
+    CrashDesc tiny;
+    CrashDesc pull;
+
+    TEST_ASSERT(f!=NULL);
+    fwrite(szXml, 1, strlen(szXml), f);
+    rewind(f);
+    TEST_ASSERT(doc.LoadFile(f));
+    rewind(f);
+    TEST_ASSERT(parser.Open(f));
+
+    TEST_ASSERT(ReadWithTinyXml(doc, tiny));
+    TEST_ASSERT(ReadWithPullParser(parser, pull));
+
+    TEST_ASSERT(pull.m_sVersion=="1500");
+    TEST_ASSERT(pull.m_sAppName=="My App & <Co>");
+    TEST_ASSERT(pull.m_sAppVersion=="1.0\nbeta \xC3\xA9 \xF0\x9F\x98\x80");
+    TEST_ASSERT(pull.m_sDesc==" <raw> & text ");
+    TEST_ASSERT(pull.m_sEmpty=="");
+    TEST_ASSERT(pull.m_aPropNames.size()==2);
+    TEST_ASSERT(pull.m_aPropNames[0]=="single \"q\"" && pull.m_aPropValues[0]=="line1\nline2  x");
+    TEST_ASSERT(pull.m_aPropNames[1]=="spaced" && pull.m_aPropValues[1]=="'A");
+    TEST_ASSERT(pull.m_nFileItems==1);
+    TEST_ASSERT(parser.Read()==XML_NODE_EOF);
+
+    TEST_ASSERT(pull.m_sVersion==tiny.m_sVersion);
+    TEST_ASSERT(pull.m_sAppName==tiny.m_sAppName);
+    TEST_ASSERT(pull.m_sAppVersion==tiny.m_sAppVersion);
+    TEST_ASSERT(pull.m_sDesc==tiny.m_sDesc);
+    TEST_ASSERT(pull.m_sEmpty==tiny.m_sEmpty);
+    TEST_ASSERT(pull.m_aPropNames==tiny.m_aPropNames);
+    TEST_ASSERT(pull.m_aPropValues==tiny.m_aPropValues);
+    TEST_ASSERT(pull.m_nFileItems==tiny.m_nFileItems);
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
+
+void XmlStreamTests::Test_Navigation()
+{
+    // Node sequence of a v1.0 crash description (root element named Exception)
+
+    const char* szXml =
+        "<?xml version=\"1.0\" ?>\n"
+        "<!DOCTYPE Exception>\n"
+        "<Exception>\n"
+        "  <ExceptionRecord ModuleName=\"C:\\Program Files\\App\\app.exe\" ExceptionCode=\"0xC0000005\"/>\n"
+        "  text\n"
+        "</Exception>\n";
+
+    CXmlPullParser parser;
+
+    TEST_ASSERT(parser.GetNodeType()==XML_NODE_NONE);
+    TEST_ASSERT(parser.Read()==XML_NODE_EOF);
+
+    parser.Open(szXml, strlen(szXml));
+    TEST_ASSERT(parser.Read()==XML_NODE_ELEMENT);
+    TEST_ASSERT(strcmp(parser.GetName(), "Exception")==0 && parser.GetDepth()==0);
+    TEST_ASSERT(!parser.IsEmptyElement());
+    TEST_ASSERT(parser.Read()==XML_NODE_ELEMENT);
+    TEST_ASSERT(strcmp(parser.GetName(), "ExceptionRecord")==0 && parser.GetDepth()==1);
+    TEST_ASSERT(parser.IsEmptyElement());
+    TEST_ASSERT(strcmp(parser.GetAttribute("ModuleName"), "C:\\Program Files\\App\\app.exe")==0);
+    TEST_ASSERT(strcmp(parser.GetAttribute("ExceptionCode"), "0xC0000005")==0);
+    TEST_ASSERT(parser.GetAttribute("modulename")==NULL);
+    TEST_ASSERT(parser.Read()==XML_NODE_END_ELEMENT);
+    TEST_ASSERT(strcmp(parser.GetName(), "ExceptionRecord")==0 && parser.GetDepth()==1);
+    TEST_ASSERT(parser.Read()==XML_NODE_TEXT);
+    TEST_ASSERT(strcmp(parser.GetText(), "text")==0 && parser.GetDepth()==1);
+    TEST_ASSERT(parser.Read()==XML_NODE_END_ELEMENT);
+    TEST_ASSERT(strcmp(parser.GetName(), "Exception")==0 && parser.GetDepth()==0);
+    TEST_ASSERT(parser.Read()==XML_NODE_EOF);
+    TEST_ASSERT(parser.Read()==XML_NODE_EOF);
+
+    // Reading can be repeated, the data are parsed from a fresh copy; data after
+    // a zero byte are ignored
+    parser.Open(szXml, strlen(szXml)+1);
+    TEST_ASSERT(parser.ReadChildElement(-1));
+    TEST_ASSERT(strcmp(parser.GetName(), "Exception")==0);
+    TEST_ASSERT(parser.ReadChildElement(0));
+    TEST_ASSERT(strcmp(parser.GetAttribute("ModuleName"), "C:\\Program Files\\App\\app.exe")==0);
+    TEST_ASSERT(!parser.ReadChildElement(0));
+    TEST_ASSERT(!parser.ReadChildElement(-1));
+    TEST_ASSERT(parser.GetNodeType()==XML_NODE_EOF);
+
+    __TEST_CLEANUP__;
+}
+
+void XmlStreamTests::Test_Malformed()
+{
+    // Broken documents end with an error, never with a crash or an endless loop
+
+    const char* aszXml[] =
+    {
+        "<a><b></a>",
+        "<a>",
+        "<a x=1/>",
+        "<a x=\"1/>",
+        "<a></b>",
+        "</a>",
+        "<a/ >",
+        "<a><!-- never closed</a>",
+        "<a><![CDATA[never closed</a>",
+        "<a><?pi</a>",
+        "<>"
+    };
+
+    CXmlPullParser parser;
+    size_t i;
+    int nTokens;
+
+    for(i=0; i<sizeof(aszXml)/sizeof(aszXml[0]); i++)
+    {
+        parser.Open(aszXml[i], strlen(aszXml[i]));
+        for(nTokens=0; nTokens<100; nTokens++)
+        {
+            int nType = parser.Read();
+            if(nType==XML_NODE_EOF || nType==XML_NODE_ERROR)
+                break;
+        }
+        TEST_ASSERT_MSG(parser.GetNodeType()==XML_NODE_ERROR, "Document %d", (int)i);
+        TEST_ASSERT(strcmp(parser.ReadElementText(), "")==0);
+        TEST_ASSERT(!parser.ReadChildElement(-1));
+    }
+
+    // Empty documents and documents without elements have no nodes
+    parser.Open(NULL, 0);
+    TEST_ASSERT(parser.Read()==XML_NODE_EOF);
+    parser.Open("  text <!-- c --> ", 18);
+    TEST_ASSERT(parser.Read()==XML_NODE_EOF);
+
+    __TEST_CLEANUP__;
+}
+
+void XmlStreamTests::Test_Benchmark_CrashDesc()
+{
+    // Writes and parses a crash description with many custom properties and file items
+    // with TinyXML DOM (as CrashRpt did before) and with the stream writer and parser
+
+    const int ITEMS = 5000;
+    const int PASSES = 5;
+    FILE* f = tmpfile();
+    CXmlWriter writer;
+    CXmlPullParser parser;
+    CPerfTimer timer;
+    std::string sXml;
+    double dTinyWriteMs = 0;
+    double dStreamWriteMs = 0;
+    double dTinyParseMs = 0;
+    double dStreamParseMs = 0;
+    size_t uSize = 0;
+    int nTinyItems = 0;
+    int nStreamItems = 0;
+    int nPass;
+    int i;
+
+    TEST_ASSERT(f!=NULL);
+
+    for(i=0; i<ITEMS; i++)
+    {
+        char szName[64];
+        char szValue[128];
+        sprintf(szName, "Property%d", i);
+        sprintf(szValue, "Value of property %d, \"quoted\" & <escaped>", i);
+        m_aNames.push_back(szName);
+        m_aValues.push_back(szValue);
+    }
+
+    for(nPass=0; nPass<PASSES; nPass++)
+    {
+        // TinyXML DOM
+        rewind(f);
+        timer.Start();
+        {
+            TiXmlDocument doc;
+            doc.LinkEndChild(new TiXmlDeclaration("1.0", "UTF-8", ""));
+            TiXmlElement* pRoot = new TiXmlElement("CrashRpt");
+            doc.LinkEndChild(pRoot);
+            pRoot->SetAttribute("version", "1500");
+            TiXmlElement* pProps = new TiXmlElement("CustomProps");
+            pRoot->LinkEndChild(pProps);
+            TiXmlElement* pFiles = new TiXmlElement("FileList");
+            for(i=0; i<ITEMS; i++)
+            {
+                TiXmlElement* pProp = new TiXmlElement("Prop");
+                pProp->SetAttribute("name", m_aNames[i].c_str());
+                pProp->SetAttribute("value", m_aValues[i].c_str());
+                pProps->LinkEndChild(pProp);
+
+                TiXmlElement* pFile = new TiXmlElement("FileItem");
+                pFile->SetAttribute("name", m_aNames[i].c_str());
+                pFile->SetAttribute("description", m_aValues[i].c_str());
+                pFiles->LinkEndChild(pFile);
+            }
+            pRoot->LinkEndChild(pFiles);
+            doc.useMicrosoftBOM = true;
+            doc.SaveFile(f);
+            fflush(f);
+        }
+        dTinyWriteMs += timer.GetElapsedMs();
+
+        // Stream writer
+        rewind(f);
+        timer.Start();
+        writer.Open(f, true);
+        writer.BeginElement("CrashRpt");
+        writer.AddAttribute("version", "1500");
+        writer.BeginElement("CustomProps");
+        for(i=0; i<ITEMS; i++)
+        {
+            writer.BeginElement("Prop");
+            writer.AddAttribute("name", m_aNames[i].c_str());
+            writer.AddAttribute("value", m_aValues[i].c_str());
+            writer.EndElement();
+        }
+        writer.EndElement();
+        writer.BeginElement("FileList");
+        for(i=0; i<ITEMS; i++)
+        {
+            writer.BeginElement("FileItem");
+            writer.AddAttribute("name", m_aNames[i].c_str());
+            writer.AddAttribute("description", m_aValues[i].c_str());
+            writer.EndElement();
+        }
+        writer.EndElement();
+        TEST_ASSERT(writer.Close());
+        fflush(f);
+        dStreamWriteMs += timer.GetElapsedMs();
+    }
+
+    sXml = ReadTempFile(f);
+    uSize = sXml.size();
+
+    for(nPass=0; nPass<PASSES; nPass++)
+    {
+        // TinyXML DOM
+        timer.Start();
+        {
+            TiXmlDocument doc;
+            CrashDesc desc;
+            doc.Parse(sXml.c_str(), 0, TIXML_ENCODING_UTF8);
+            ReadWithTinyXml(doc, desc);
+            nTinyItems = (int)desc.m_aPropNames.size()+desc.m_nFileItems;
+        }
+        dTinyParseMs += timer.GetElapsedMs();
+
+        // Pull parser
+        timer.Start();
+        {
+            CrashDesc desc;
+            parser.Open(sXml.data(), sXml.size());
+            ReadWithPullParser(parser, desc);
+            nStreamItems = (int)desc.m_aPropNames.size()+desc.m_nFileItems;
+        }
+        dStreamParseMs += timer.GetElapsedMs();
+    }
+
+    printf("\n   %d properties and %d file items, %.1f KB:\n"
+        "   write: TinyXML %.1f ms, stream writer %.1f ms (%.1f MB/s, %.1fx)\n"
+        "   parse: TinyXML %.1f ms, pull parser %.1f ms (%.1f MB/s, %.1fx)\n   ",
+        ITEMS, ITEMS, uSize/1024.0,
+        dTinyWriteMs/PASSES, dStreamWriteMs/PASSES,
+        uSize*PASSES/(dStreamWriteMs*1000.0), dTinyWriteMs/dStreamWriteMs,
+        dTinyParseMs/PASSES, dStreamParseMs/PASSES,
+        uSize*PASSES/(dStreamParseMs*1000.0), dTinyParseMs/dStreamParseMs);
+
+    TEST_ASSERT(nTinyItems==2*ITEMS);
+    TEST_ASSERT(nStreamItems==2*ITEMS);
+
+    __TEST_CLEANUP__;
+
+    if(f!=NULL)
+        fclose(f);
+}
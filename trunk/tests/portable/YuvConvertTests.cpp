@@ -0,0 +1,476 @@
+/*************************************************************************************
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+#include "PortableTests.h"
+#include "PerfTimer.h"
+#include "YuvConvert.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// A 24-bit image and its YV12 planes
+struct TestFrame
+{
+    TestFrame(int nWidth, int nHeight, int nPadding = 0)
+    {
+        m_nWidth = nWidth;
+        m_nHeight = nHeight;
+        m_nRGBStride = nWidth*3+nPadding;
+        m_nYStride = nWidth+nPadding;
+        m_nUVStride = (nWidth+1)/2+nPadding;
+        m_aRGB.resize(m_nRGBStride*nHeight);
+        m_aY.resize(m_nYStride*nHeight);
+        m_aU.resize(m_nUVStride*((nHeight+1)/2));
+        m_aV.resize(m_nUVStride*((nHeight+1)/2));
+    }
+
+    void ToYV12(YuvConvertMethod Method)
+    {
+        RGB24_To_YV12(&m_aRGB[0], m_nWidth, m_nHeight, m_nRGBStride,
+            &m_aY[0], m_nYStride, &m_aU[0], m_nUVStride, &m_aV[0], m_nUVStride, Method);
+    }
+
+    void ToRGB(YuvConvertMethod Method)
+    {
+        YV12_To_RGB24(&m_aY[0], m_nYStride, &m_aU[0], m_nUVStride, &m_aV[0], m_nUVStride,
+            m_nWidth, m_nHeight, &m_aRGB[0], m_nRGBStride, Method);
+    }
+
+    int m_nWidth;
+    int m_nHeight;
+    int m_nRGBStride;
+    int m_nYStride;
+    int m_nUVStride;
+    std::vector<unsigned char> m_aRGB;
+    std::vector<unsigned char> m_aY;
+    std::vector<unsigned char> m_aU;
+    std::vector<unsigned char> m_aV;
+};
+
+class YuvConvertTests : public CTestSuite
+{
+    BEGIN_TEST_MAP(YuvConvertTests, "RGB24 <-> YV12 conversion tests")
+        REGISTER_TEST(Test_SIMD)
+        REGISTER_TEST(Test_OddSize)
+        REGISTER_TEST(Test_Quality)
+        REGISTER_TEST(Test_Benchmark_Convert)
+    END_TEST_MAP()
+
+public:
+
+    void SetUp();
+    void TearDown();
+
+    void Test_SIMD();
+    void Test_OddSize();
+    void Test_Quality();
+    void Test_Benchmark_Convert();
+
+private:
+
+    // Fills the image with gradients, noise and sharp-edged rectangles, like a desktop screenshot
+    static void MakeImage(TestFrame& frame);
+
+    // Fills the YV12 planes with random values
+    static void MakeRandomPlanes(TestFrame& frame);
+
+    // The conversions CVideoRecorder and CVideo did before (floating point, RGB -> YUV
+    // in-place and chroma of the top-left pixel of every 2x2 block)
+    static void Legacy_RGB_To_YV12(unsigned char *pRGBData, int nFrameWidth,
+        int nFrameHeight, int nRGBStride, unsigned char *pFullYPlane,
+        unsigned char *pDownsampledUPlane, unsigned char *pDownsampledVPlane);
+    static void Legacy_YV12_To_RGB(unsigned char *pRGBData, int nFrameWidth,
+        int nFrameHeight, int nRGBStride, const unsigned char* pY, int nYStride,
+        const unsigned char* pU, const unsigned char* pV, int nUVStride);
+
+    // Peak signal-to-noise ratio of two images, in dB
+    static double CalcPSNR(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b);
+};
+
+REGISTER_TEST_SUITE( YuvConvertTests );
+
+void YuvConvertTests::SetUp()
+{
+}
+
+void YuvConvertTests::TearDown()
+{
+}
+
+void YuvConvertTests::MakeImage(TestFrame& frame)
+{
+    uint32_t uSeed = 777;
+    int x, y, i;
+
+    for(y=0; y<frame.m_nHeight; y++)
+    {
+        for(x=0; x<frame.m_nWidth; x++)
+        {
+            unsigned char* p = &frame.m_aRGB[y*frame.m_nRGBStride+x*3];
+            uSeed = uSeed*1103515245+12345;
+            int nNoise = (int)((uSeed>>16)&15)-8;
+            int nB = x*255/frame.m_nWidth+nNoise;
+            int nG = y*255/frame.m_nHeight+nNoise;
+            int nR = (x+y)*255/(frame.m_nWidth+frame.m_nHeight)-nNoise;
+            p[0] = (unsigned char)(nB<0 ? 0 : nB>255 ? 255 : nB);
+            p[1] = (unsigned char)(nG<0 ? 0 : nG>255 ? 255 : nG);
+            p[2] = (unsigned char)(nR<0 ? 0 : nR>255 ? 255 : nR);
+        }
+    }
+
+    // Windows and text-like details with edges at odd coordinates
+    for(i=0; i<frame.m_nWidth/8; i++)
+    {
+        uSeed = uSeed*1103515245+12345;
+        int nLeft = (int)((uSeed>>8)%frame.m_nWidth);
+        int nTop = (int)((uSeed>>4)%frame.m_nHeight);
+        int nRight = nLeft+1+(int)(uSeed%61);
+        int nBottom = nTop+1+(int)((uSeed>>12)%23);
+        unsigned char aColor[3] = {(unsigned char)(uSeed>>24), (unsigned char)(uSeed>>16), (unsigned char)(uSeed>>20)};
+
+        for(y=nTop; y<nBottom && y<frame.m_nHeight; y++)
+        {
+            for(x=nLeft; x<nRight && x<frame.m_nWidth; x++)
+                memcpy(&frame.m_aRGB[y*frame.m_nRGBStride+x*3], aColor, 3);
+        }
+    }
+}
+
+void YuvConvertTests::MakeRandomPlanes(TestFrame& frame)
+{
+    uint32_t uSeed = 2013;
+    size_t i;
+
+    for(i=0; i<frame.m_aY.size(); i++)
+    {
+        uSeed = uSeed*1103515245+12345;
+        frame.m_aY[i] = (unsigned char)(uSeed>>16);
+    }
+    for(i=0; i<frame.m_aU.size(); i++)
+    {
+        uSeed = uSeed*1103515245+12345;
+        frame.m_aU[i] = (unsigned char)(uSeed>>16);
+        frame.m_aV[i] = (unsigned char)(uSeed>>24);
+    }
+}
+
+void YuvConvertTests::Legacy_RGB_To_YV12(unsigned char *pRGBData, int nFrameWidth,
+    int nFrameHeight, int nRGBStride, unsigned char *pFullYPlane,
+    unsigned char *pDownsampledUPlane, unsigned char *pDownsampledVPlane)
+{
+    unsigned char *pYPlaneOut = (unsigned char*)pFullYPlane;
+    int nYPlaneOut = 0;
+
+    int x, y;
+    for(y=0; y<nFrameHeight;y++)
+    {
+        for (x=0; x < nFrameWidth; x ++)
+        {
+            int nRGBOffs = y*nRGBStride+x*3;
+
+            unsigned char B = pRGBData[nRGBOffs+0];
+            unsigned char G = pRGBData[nRGBOffs+1];
+            unsigned char R = pRGBData[nRGBOffs+2];
+
+            float y = (float)( R*66 + G*129 + B*25 + 128 ) / 256 + 16;
+            float u = (float)( R*-38 + G*-74 + B*112 + 128 ) / 256 + 128;
+            float v = (float)( R*112 + G*-94 + B*-18 + 128 ) / 256 + 128;
+
+            pRGBData[nRGBOffs+0] = (unsigned char)y;
+            pRGBData[nRGBOffs+1] = (unsigned char)u;
+            pRGBData[nRGBOffs+2] = (unsigned char)v;
+
+            pYPlaneOut[nYPlaneOut++] = pRGBData[nRGBOffs+0];
+        }
+    }
+
+    int halfHeight = nFrameHeight/2;
+    int halfWidth = nFrameWidth/2;
+
+    for ( int yPixel=0; yPixel < halfHeight; yPixel++ )
+    {
+        int iBaseSrc = ( (yPixel*2) * nRGBStride );
+
+        for ( int xPixel=0; xPixel < halfWidth; xPixel++ )
+        {
+            pDownsampledVPlane[yPixel * halfWidth + xPixel] = pRGBData[iBaseSrc + 2];
+            pDownsampledUPlane[yPixel * halfWidth + xPixel] = pRGBData[iBaseSrc + 1];
+
+            iBaseSrc += 6;
+        }
+    }
+}
+
+void YuvConvertTests::Legacy_YV12_To_RGB(unsigned char *pRGBData, int nFrameWidth,
+    int nFrameHeight, int nRGBStride, const unsigned char* pY, int nYStride,
+    const unsigned char* pU, const unsigned char* pV, int nUVStride)
+{
+    int x, y;
+    for(y=0; y<nFrameHeight;y++)
+    {
+        for (x=0; x < nFrameWidth; x ++)
+        {
+            int nRGBOffs = y*nRGBStride+x*3;
+
+            float Y = pY[y*nYStride+x];
+            float U = pU[y/2*nUVStride+x/2];
+            float V = pV[y/2*nUVStride+x/2];
+
+            int nB = (int)(1.164*(Y - 16) + 2.018*(U - 128));
+            int nG = (int)(1.164*(Y - 16) - 0.813*(V - 128) - 0.391*(U - 128));
+            int nR = (int)(1.164*(Y - 16) + 1.596*(V - 128));
+            pRGBData[nRGBOffs+0] = (unsigned char)(nB<0 ? 0 : nB>255 ? 255 : nB);
+            pRGBData[nRGBOffs+1] = (unsigned char)(nG<0 ? 0 : nG>255 ? 255 : nG);
+            pRGBData[nRGBOffs+2] = (unsigned char)(nR<0 ? 0 : nR>255 ? 255 : nR);
+        }
+    }
+}
+
+double YuvConvertTests::CalcPSNR(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b)
+{
+    double dSum = 0;
+    size_t i;
+
+    for(i=0; i<a.size(); i++)
+    {
+        double d = (double)a[i]-(double)b[i];
+        dSum += d*d;
+    }
+
+    if(dSum==0)
+        return 99;
+
+    return 10*log10(255.0*255.0/(dSum/a.size()));
+}
+
+void YuvConvertTests::Test_SIMD()
+{
+    // Sizes around the 32-pixel SIMD block, odd sizes and padded strides
+    static const int aSizes[][3] =
+    {
+        {1, 1, 0}, {2, 2, 0}, {3, 5, 1}, {31, 7, 0}, {32, 2, 0}, {33, 3, 5},
+        {63, 9, 3}, {64, 16, 0}, {65, 17, 2}, {97, 11, 7}, {640, 480, 0}, {643, 37, 1}
+    };
+    int i;
+
+    for(i=0; i<(int)(sizeof(aSizes)/sizeof(aSizes[0])); i++)
+    {
+        TestFrame simd(aSizes[i][0], aSizes[i][1], aSizes[i][2]);
+        TestFrame scalar(aSizes[i][0], aSizes[i][1], aSizes[i][2]);
+
+        MakeImage(simd);
+        scalar.m_aRGB = simd.m_aRGB;
+
+        simd.ToYV12(YUV_CONVERT_AUTO);
+        scalar.ToYV12(YUV_CONVERT_SCALAR);
+        TEST_ASSERT(simd.m_aY==scalar.m_aY);
+        TEST_ASSERT(simd.m_aU==scalar.m_aU);
+        TEST_ASSERT(simd.m_aV==scalar.m_aV);
+
+        // Any YUV values, including out of the video range
+        MakeRandomPlanes(simd);
+        MakeRandomPlanes(scalar);
+        simd.ToRGB(YUV_CONVERT_AUTO);
+        scalar.ToRGB(YUV_CONVERT_SCALAR);
+        TEST_ASSERT(simd.m_aRGB==scalar.m_aRGB);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void YuvConvertTests::Test_OddSize()
+{
+    TestFrame frame(5, 3, 2);
+    int x, y;
+
+    // Left 2x2 blocks are white, the blocks of the last column and row are black
+    for(y=0; y<frame.m_nHeight; y++)
+    {
+        for(x=0; x<frame.m_nWidth; x++)
+        {
+            unsigned char c = (x<4 && y<2) ? 255 : 0;
+            memset(&frame.m_aRGB[y*frame.m_nRGBStride+x*3], c, 3);
+        }
+    }
+    std::vector<unsigned char> aSource = frame.m_aRGB;
+
+    frame.ToYV12(YUV_CONVERT_AUTO);
+
+    // The source is not modified
+    TEST_ASSERT(frame.m_aRGB==aSource);
+
+    for(y=0; y<frame.m_nHeight; y++)
+    {
+        for(x=0; x<frame.m_nWidth; x++)
+            TEST_ASSERT(frame.m_aY[y*frame.m_nYStride+x]==((x<4 && y<2) ? 235 : 16));
+    }
+
+    for(y=0; y<2; y++)
+    {
+        for(x=0; x<3; x++)
+        {
+            TEST_ASSERT(frame.m_aU[y*frame.m_nUVStride+x]==128);
+            TEST_ASSERT(frame.m_aV[y*frame.m_nUVStride+x]==128);
+        }
+    }
+
+    // Back to RGB
+    frame.ToRGB(YUV_CONVERT_AUTO);
+    TEST_ASSERT(frame.m_aRGB==aSource);
+
+    __TEST_CLEANUP__;
+}
+
+void YuvConvertTests::Test_Quality()
+{
+    // Compares the conversions with the ones CVideoRecorder and CVideo did before
+    TestFrame frame(640, 480);
+    TestFrame legacy(640, 480);
+    std::vector<unsigned char> aSource;
+    std::vector<unsigned char> aLegacyRGB;
+    int x, y, i;
+    int nMaxDiff = 0;
+
+    MakeImage(frame);
+    aSource = frame.m_aRGB;
+    legacy.m_aRGB = aSource;
+
+    frame.ToYV12(YUV_CONVERT_AUTO);
+    Legacy_RGB_To_YV12(&legacy.m_aRGB[0], 640, 480, legacy.m_nRGBStride,
+        &legacy.m_aY[0], &legacy.m_aU[0], &legacy.m_aV[0]);
+
+    // Luma is the same
+    TEST_ASSERT(frame.m_aY==legacy.m_aY);
+
+    // Chroma is the average of the floating point values of a 2x2 block
+    for(y=0; y<240; y++)
+    {
+        for(x=0; x<320; x++)
+        {
+            double dU = 0;
+            double dV = 0;
+            for(i=0; i<4; i++)
+            {
+                const unsigned char* p = &aSource[(2*y+i/2)*frame.m_nRGBStride+(2*x+i%2)*3];
+                dU += (double)(p[2]*-38 + p[1]*-74 + p[0]*112 + 128)/256 + 128;
+                dV += (double)(p[2]*112 + p[1]*-94 + p[0]*-18 + 128)/256 + 128;
+            }
+            TEST_ASSERT(frame.m_aU[y*frame.m_nUVStride+x]==(int)floor(dU/4));
+            TEST_ASSERT(frame.m_aV[y*frame.m_nUVStride+x]==(int)floor(dV/4));
+        }
+    }
+
+    // YV12 -> RGB is within 2 of the floating point conversion for any YUV values
+    MakeRandomPlanes(frame);
+    aLegacyRGB.resize(frame.m_aRGB.size());
+    frame.ToRGB(YUV_CONVERT_AUTO);
+    Legacy_YV12_To_RGB(&aLegacyRGB[0], 640, 480, frame.m_nRGBStride, &frame.m_aY[0], frame.m_nYStride,
+        &frame.m_aU[0], &frame.m_aV[0], frame.m_nUVStride);
+    for(i=0; i<(int)aLegacyRGB.size(); i++)
+    {
+        int nDiff = abs((int)frame.m_aRGB[i]-(int)aLegacyRGB[i]);
+        if(nDiff>nMaxDiff)
+            nMaxDiff = nDiff;
+    }
+    TEST_ASSERT(nMaxDiff<=2);
+
+    // Round trip: averaged chroma is closer to the source than the top-left pixel's chroma
+    {
+        frame.m_aRGB = aSource;
+        frame.ToYV12(YUV_CONVERT_AUTO);
+        frame.ToRGB(YUV_CONVERT_AUTO);
+        double dPSNR = CalcPSNR(aSource, frame.m_aRGB);
+
+        Legacy_YV12_To_RGB(&legacy.m_aRGB[0], 640, 480, legacy.m_nRGBStride, &legacy.m_aY[0], legacy.m_nYStride,
+            &legacy.m_aU[0], &legacy.m_aV[0], legacy.m_nUVStride);
+        double dLegacyPSNR = CalcPSNR(aSource, legacy.m_aRGB);
+
+        printf("\n   Round trip PSNR: legacy %.2f dB, new %.2f dB; YV12 -> RGB max difference %d\n   ",
+            dLegacyPSNR, dPSNR, nMaxDiff);
+
+        TEST_ASSERT(dPSNR>dLegacyPSNR);
+    }
+
+    __TEST_CLEANUP__;
+}
+
+void YuvConvertTests::Test_Benchmark_Convert()
+{
+    // Per-frame time of the conversions at 1080p and 4K
+    static const int aSizes[][2] = {{1920, 1080}, {3840, 2160}};
+    const int FRAMES = 5;
+    int i, nFrame;
+
+    for(i=0; i<2; i++)
+    {
+        TestFrame frame(aSizes[i][0], aSizes[i][1]);
+        std::vector<unsigned char> aSource;
+        CPerfTimer timer;
+        double dLegacyMs = 0;
+        double dScalarMs = 0;
+        double dSIMDMs = 0;
+        double dLegacyBackMs = 0;
+        double dScalarBackMs = 0;
+        double dSIMDBackMs = 0;
+
+        MakeImage(frame);
+        aSource = frame.m_aRGB;
+
+        timer.Start();
+        for(nFrame=0; nFrame<FRAMES; nFrame++)
+        {
+            // The legacy conversion overwrites the source
+            memcpy(&frame.m_aRGB[0], &aSource[0], aSource.size());
+            Legacy_RGB_To_YV12(&frame.m_aRGB[0], frame.m_nWidth, frame.m_nHeight, frame.m_nRGBStride,
+                &frame.m_aY[0], &frame.m_aU[0], &frame.m_aV[0]);
+        }
+        dLegacyMs = timer.GetElapsedMs()/FRAMES;
+
+        frame.m_aRGB = aSource;
+        timer.Start();
+        for(nFrame=0; nFrame<FRAMES; nFrame++)
+            frame.ToYV12(YUV_CONVERT_SCALAR);
+        dScalarMs = timer.GetElapsedMs()/FRAMES;
+
+        timer.Start();
+        for(nFrame=0; nFrame<FRAMES; nFrame++)
+            frame.ToYV12(YUV_CONVERT_AUTO);
+        dSIMDMs = timer.GetElapsedMs()/FRAMES;
+
+        timer.Start();
+        for(nFrame=0; nFrame<FRAMES; nFrame++)
+        {
+            Legacy_YV12_To_RGB(&frame.m_aRGB[0], frame.m_nWidth, frame.m_nHeight, frame.m_nRGBStride,
+                &frame.m_aY[0], frame.m_nYStride, &frame.m_aU[0], &frame.m_aV[0], frame.m_nUVStride);
+        }
+        dLegacyBackMs = timer.GetElapsedMs()/FRAMES;
+
+        timer.Start();
+        for(nFrame=0; nFrame<FRAMES; nFrame++)
+            frame.ToRGB(YUV_CONVERT_SCALAR);
+        dScalarBackMs = timer.GetElapsedMs()/FRAMES;
+
+        timer.Start();
+        for(nFrame=0; nFrame<FRAMES; nFrame++)
+            frame.ToRGB(YUV_CONVERT_AUTO);
+        dSIMDBackMs = timer.GetElapsedMs()/FRAMES;
+
+        TEST_ASSERT(CalcPSNR(aSource, frame.m_aRGB)>30);
+
+        printf("\n   %dx%d per frame: RGB -> YV12 legacy %.1f ms, scalar %.1f ms, %s %.1f ms;"
+            "\n   YV12 -> RGB legacy %.1f ms, scalar %.1f ms, %s %.1f ms\n   ",
+            frame.m_nWidth, frame.m_nHeight,
+            dLegacyMs, dScalarMs, YuvConvertHasSIMD() ? "SSE2" : "no SIMD", dSIMDMs,
+            dLegacyBackMs, dScalarBackMs, YuvConvertHasSIMD() ? "SSE2" : "no SIMD", dSIMDBackMs);
+    }
+
+    __TEST_CLEANUP__;
+}
@@ -0,0 +1,155 @@
+/************************************************************************************* 
+This file is a part of CrashRpt library.
+Copyright (c) 2003-2013 The CrashRpt project authors. All Rights Reserved.
+
+Use of this source code is governed by a BSD-style license
+that can be found in the License.txt file in the root of the source
+tree. All contributing project authors may
+be found in the Authors.txt file in the root of the source tree.
+***************************************************************************************/
+
+// File: main.cpp
+// Description: Runner for portable unit tests. Runs all registered test suites, or only 
+// the suites whose names are passed in the command line. Returns non-zero on failure.
+
+#include "PortableTests.h"
+
+CTestSuite* g_pCurTestSuite = NULL;
+
+std::vector<CTestSuite*>& GetTestSuites()
+{
+    static std::vector<CTestSuite*> aSuites;
+    return aSuites;
+}
+
+int main(int argc, char** argv)
+{
+    std::set<std::string> aSuitesToRun;
+    int i;
+    for(i=1; i<argc; i++)
+        aSuitesToRun.insert(argv[i]);
+
+    printf("\n=== Portable unit tests for CrashRpt ===\n\n");
+
+    std::vector<std::string> error_list;
+    size_t nTestCount = 0;
+    size_t j;
+    for(j=0; j<GetTestSuites().size(); j++)
+    {
+        CTestSuite* pSuite = GetTestSuites()[j];
+
+        std::string sSuiteName;
+        std::string sDescription;
+        pSuite->GetSuiteInfo(sSuiteName, sDescription);
+        if(aSuitesToRun.size()!=0 && aSuitesToRun.find(sSuiteName)==aSuitesToRun.end())
+            continue; // This suite is not in list
+
+        std::vector<std::string> test_list;
+        pSuite->DoWithMyTests(GET_NAMES, test_list);
+        nTestCount += test_list.size();
+
+        pSuite->Run();
+
+        const std::vector<std::string>& suite_errors = pSuite->GetErrorList();
+        error_list.insert(error_list.end(), suite_errors.begin(), suite_errors.end());
+    }
+
+    printf("\n=== Summary ===\n\n");
+
+    if(error_list.size()>0)
+    {
+        printf("Error list:\n");
+        for(j=0; j<error_list.size(); j++)
+            printf("%d: %s\n", (int)j+1, error_list[j].c_str());
+    }
+
+    printf("   Test count: %d\n", (int)nTestCount);
+    printf(" Tests failed: %d\n", (int)error_list.size());
+
+    // Return non-zero value if there were errors
+    return error_list.size()==0?0:1;
+}
+
+//--------------------------------------------------------
+// CTestSuite impl
+//--------------------------------------------------------
+
+bool CTestSuite::Run()
+{
+    m_asErrorMsg.clear();
+    m_bSuiteSetUpFailed = false;
+
+    g_pCurTestSuite = this;
+
+    BeforeTest("SetUp");
+    SetUp();
+    AfterTest("SetUp");
+
+    if(m_bTestFailed)
+        m_bSuiteSetUpFailed = true;
+
+    std::vector<std::string> test_list;
+    DoWithMyTests(RUN_TESTS, test_list);
+
+    if(BeforeTest("TearDown"))
+        TearDown();
+    AfterTest("TearDown");
+
+    g_pCurTestSuite = NULL;
+
+    return m_asErrorMsg.size()==0;
+}
+
+bool CTestSuite::BeforeTest(const char* szFunction)
+{
+    m_bTestFailed = false;
+    std::string sSuiteName;
+    std::string sSuiteDescription;
+    GetSuiteInfo(sSuiteName, sSuiteDescription);
+
+    printf(" - %s::%s... ", sSuiteName.c_str(), szFunction);
+    fflush(stdout);
+
+    if(m_bSuiteSetUpFailed)
+    {
+        AddErrorMsg(szFunction, "SetUp Failure", NULL);
+        return false; // Prevent running test
+    }
+
+    return true;
+}
+
+void CTestSuite::AfterTest(const char* /*szFunction*/)
+{
+    if(!m_bTestFailed)
+        printf("OK.\n");
+    else
+        printf("Failed.\n");
+}
+
+void CTestSuite::AddErrorMsg(const char* szFunction, const char* szAssertion, const char* szMsg, ...)
+{
+    m_bTestFailed = true;
+    char szBuffer[4096] = "";
+    if(szMsg!=NULL)
+    {
+        va_list arg_list;
+        va_start(arg_list, szMsg);
+        vsnprintf(szBuffer, sizeof(szBuffer), szMsg, arg_list);
+        va_end(arg_list);
+    }
+
+    std::string sMsg = "In test: ";
+    sMsg += szFunction;
+    sMsg += " Expr: ";
+    sMsg += szAssertion;
+    if(szMsg!=NULL)
+    {
+        sMsg += " Msg: ";
+        sMsg += szBuffer;
+    }
+    m_asErrorMsg.push_back(sMsg);
+
+    printf("\n!!! %s\n", sMsg.c_str());
+    fflush(stdout);
+}
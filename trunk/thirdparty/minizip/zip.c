@@ -105,6 +105,7 @@ const char zip_copyright[] =" zip 1.01 Copyright 1998-2004 Gilles Vollant - http
 #define ENDHEADERMAGIC      (0x06054b50)
 #define ZIP64ENDHEADERMAGIC      (0x6064b50)
 #define ZIP64ENDLOCHEADERMAGIC   (0x7064b50)
+#define DATADESCRIPTORMAGIC      (0x08074b50)
 
 #define FLAG_LOCALHEADER_OFFSET (0x06)
 #define CRC_LOCALHEADER_OFFSET  (0x0e)
@@ -1410,7 +1411,10 @@ extern int ZEXPORT zipWriteInFileInZip (zipFile file,const void* buf,unsigned in
     if (zi->in_opened_file_inzip == 0)
         return ZIP_PARAMERROR;
 
-    zi->ci.crc32 = crc32(zi->ci.crc32,buf,(uInt)len);
+    // CrashRpt: in raw mode the caller passes the CRC of uncompressed data to
+    // zipCloseFileInZipRaw(), don't waste time on the CRC of compressed data
+    if (!zi->ci.raw)
+        zi->ci.crc32 = crc32(zi->ci.crc32,buf,(uInt)len);
 
 #ifdef HAVE_BZIP2
     if(zi->ci.method == Z_BZIP2ED && (!zi->ci.raw))
@@ -1698,7 +1702,22 @@ extern int ZEXPORT zipCloseFileInZipRaw64 (zipFile file, ZPOS64_T uncompressed_s
 
     free(zi->ci.central_header);
 
-    if (err==ZIP_OK)
+    if ((err==ZIP_OK) && (zi->ci.flag & 8))
+    {
+        // CrashRpt: CRC and sizes are written in the data descriptor following the
+        // data, so the archive is written sequentially without seeking back
+        err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)DATADESCRIPTORMAGIC,4);
+
+        if (err==ZIP_OK)
+            err = zip64local_putValue(&zi->z_filefunc,zi->filestream,crc32,4);
+
+        if (err==ZIP_OK)
+            err = zip64local_putValue(&zi->z_filefunc,zi->filestream,compressed_size,zi->ci.zip64?8:4);
+
+        if (err==ZIP_OK)
+            err = zip64local_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,zi->ci.zip64?8:4);
+    }
+    else if (err==ZIP_OK)
     {
         // Update the LocalFileHeader with the new values.
 